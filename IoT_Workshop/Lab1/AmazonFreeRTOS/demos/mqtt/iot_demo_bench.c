@@ -0,0 +1,412 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_bench.c
+ * @brief Throughput and latency benchmark of the MQTT demo pipeline.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_bench.h"
+
+#if IOT_DEMO_MQTT_BENCHMARK == 1
+
+/* Standard includes. */
+    #include <stdio.h>
+    #include <string.h>
+
+/* Set up logging for this demo. */
+    #include "iot_demo_logging.h"
+
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+
+    #include "iot_demo_loopback_broker.h"
+
+/**
+ * @brief Latency histogram: 16 linear buckets per power of two microseconds.
+ */
+    #define HISTOGRAM_SUB_BITS    ( 4 )
+    #define HISTOGRAM_SUB         ( 1 << HISTOGRAM_SUB_BITS )
+    #define HISTOGRAM_BUCKETS     ( 25 * HISTOGRAM_SUB )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Cost of one stage over a rate step.
+ */
+    typedef struct _stageStats
+    {
+        uint32_t count;
+        uint64_t cycles;
+        uint32_t maxCycles;
+    } _stageStats_t;
+
+/**
+ * @brief A publish awaiting completion.
+ */
+    typedef struct _inflight
+    {
+        intptr_t publishCount;
+        uint32_t enqueueTimeUs;
+        bool valid;
+    } _inflight_t;
+
+/**
+ * @brief Counts of the current rate step. The completion counters and the
+ * histogram are updated from the MQTT library's task pool.
+ */
+    typedef struct _stepStats
+    {
+        uint32_t completed;
+        uint32_t failed;
+        uint32_t untimed;
+        uint32_t maxLatencyUs;
+        uint32_t latency[ HISTOGRAM_BUCKETS ];
+        _stageStats_t stages[ IOT_DEMO_BENCH_STAGE_COUNT ];
+    } _stepStats_t;
+
+    static const uint32_t _rates[] = IOT_DEMO_BENCH_RATES;
+
+    static const char * const _stageNames[ IOT_DEMO_BENCH_STAGE_COUNT ] =
+    {
+        "sample",
+        "enqueue",
+        "format",
+        "publish",
+        "cork",
+        "send"
+    };
+
+    static _stepStats_t _step = { 0 };
+
+    static _inflight_t _inflight[ IOT_DEMO_BENCH_MAX_INFLIGHT ] = { { 0 } };
+
+/*-----------------------------------------------------------*/
+
+    static size_t _histogramIndex( uint32_t value )
+    {
+        int msb = 0;
+        size_t index = 0;
+
+        if( value < HISTOGRAM_SUB )
+        {
+            return ( size_t ) value;
+        }
+
+        msb = 31 - __builtin_clz( value );
+        index = ( size_t ) ( msb - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB +
+                ( ( value >> ( msb - HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB - 1 ) );
+
+        return ( index < HISTOGRAM_BUCKETS ) ? index : HISTOGRAM_BUCKETS - 1;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Upper bound of a histogram bucket.
+ */
+    static uint32_t _histogramValue( size_t index )
+    {
+        size_t shift = 0;
+
+        if( index < HISTOGRAM_SUB )
+        {
+            return ( uint32_t ) index;
+        }
+
+        shift = index / HISTOGRAM_SUB - 1;
+
+        return ( ( ( uint32_t ) HISTOGRAM_SUB + index % HISTOGRAM_SUB + 1 ) << shift ) - 1;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t _percentile( uint32_t total,
+                                 uint32_t perMille )
+    {
+        uint32_t target = ( uint32_t ) ( ( ( uint64_t ) total * perMille + 999 ) / 1000 );
+        uint32_t seen = 0;
+        size_t i = 0;
+
+        if( total == 0 )
+        {
+            return 0;
+        }
+
+        for( i = 0; i < HISTOGRAM_BUCKETS; i++ )
+        {
+            seen += _step.latency[ i ];
+
+            if( seen >= target )
+            {
+                break;
+            }
+        }
+
+        return _histogramValue( ( i < HISTOGRAM_BUCKETS ) ? i : HISTOGRAM_BUCKETS - 1 );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _printStep( uint32_t rate,
+                            uint32_t offered,
+                            uint32_t queued,
+                            uint32_t elapsedMs,
+                            uint32_t drainMs,
+                            const IotDemoLoopbackBrokerStats_t * pBroker )
+    {
+        uint32_t timed = _step.completed - _step.untimed;
+        size_t i = 0;
+
+        printf( "{\"bench\":\"mqtt_pipeline\",\"rate\":%lu,\"offered\":%lu,\"queued\":%lu,"
+                "\"dropped\":%lu,\"completed\":%lu,\"failed\":%lu,\"untimed\":%lu,"
+                "\"completed_per_s\":%lu,\"drain_ms\":%lu,"
+                "\"latency_us\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu},"
+                "\"broker\":{\"publishes\":%lu,\"bytes\":%lu,\"sends\":%lu,\"wire_bytes\":%lu},\"cycles\":{",
+                ( unsigned long ) rate,
+                ( unsigned long ) offered,
+                ( unsigned long ) queued,
+                ( unsigned long ) ( offered - queued ),
+                ( unsigned long ) _step.completed,
+                ( unsigned long ) _step.failed,
+                ( unsigned long ) _step.untimed,
+                ( unsigned long ) ( ( uint64_t ) _step.completed * 1000 / ( elapsedMs + drainMs ) ),
+                ( unsigned long ) drainMs,
+                ( unsigned long ) _percentile( timed, 500 ),
+                ( unsigned long ) _percentile( timed, 900 ),
+                ( unsigned long ) _percentile( timed, 990 ),
+                ( unsigned long ) _step.maxLatencyUs,
+                ( unsigned long ) pBroker->publishes,
+                ( unsigned long ) pBroker->publishBytes,
+                ( unsigned long ) pBroker->sends,
+                ( unsigned long ) pBroker->wireBytes );
+
+        for( i = 0; i < IOT_DEMO_BENCH_STAGE_COUNT; i++ )
+        {
+            /* Per publish as well as per call, since the stages below the
+             * MQTT library may handle several publishes in one call. */
+            printf( "%s\"%s\":{\"mean\":%lu,\"max\":%lu,\"per_publish\":%lu}",
+                    ( i == 0 ) ? "" : ",",
+                    _stageNames[ i ],
+                    ( unsigned long ) ( ( _step.stages[ i ].count > 0 ) ?
+                                        ( _step.stages[ i ].cycles / _step.stages[ i ].count ) : 0 ),
+                    ( unsigned long ) _step.stages[ i ].maxCycles,
+                    ( unsigned long ) ( ( pBroker->publishes > 0 ) ?
+                                        ( _step.stages[ i ].cycles / pBroker->publishes ) : 0 ) );
+        }
+
+        printf( "}}\n" );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _benchmarkTask( void * pArgument )
+    {
+        IotDemoBenchProduce_t produce = ( IotDemoBenchProduce_t ) pArgument;
+        IotDemoLoopbackBrokerStats_t brokerBefore = { 0 }, brokerAfter = { 0 };
+        uint32_t rate = 0, offered = 0, queued = 0, target = 0, elapsedMs = 0, drainMs = 0;
+        uint32_t maxSustained = 0, dropOnset = 0, unsustained = 0;
+        TickType_t startTicks = 0, wakeTicks = 0;
+        size_t step = 0;
+        bool sustained = false;
+
+        printf( "{\"bench\":\"mqtt_pipeline\",\"event\":\"start\",\"step_ms\":%lu,\"cpu_mhz\":%lu}\n",
+                ( unsigned long ) IOT_DEMO_BENCH_STEP_MS,
+                ( unsigned long ) ( configCPU_CLOCK_HZ / 1000000UL ) );
+
+        for( step = 0; step < sizeof( _rates ) / sizeof( _rates[ 0 ] ); step++ )
+        {
+            rate = _rates[ step ];
+            offered = 0;
+            queued = 0;
+            ( void ) memset( &_step, 0x00, sizeof( _step ) );
+            IotDemoLoopbackBroker_GetStats( &brokerBefore );
+
+            /* Offer events open loop: every tick catches up with the number
+             * due by then, so rates above the tick rate arrive in bursts. */
+            startTicks = xTaskGetTickCount();
+            wakeTicks = startTicks;
+
+            do
+            {
+                vTaskDelayUntil( &wakeTicks, 1 );
+                elapsedMs = ( uint32_t ) ( ( wakeTicks - startTicks ) * portTICK_PERIOD_MS );
+
+                if( elapsedMs > IOT_DEMO_BENCH_STEP_MS )
+                {
+                    elapsedMs = IOT_DEMO_BENCH_STEP_MS;
+                }
+
+                target = ( uint32_t ) ( ( uint64_t ) rate * elapsedMs / 1000 );
+
+                while( offered < target )
+                {
+                    offered++;
+
+                    if( produce() == true )
+                    {
+                        queued++;
+                    }
+                }
+            } while( elapsedMs < IOT_DEMO_BENCH_STEP_MS );
+
+            /* Wait for the queue to drain and every publish to complete. */
+            startTicks = xTaskGetTickCount();
+
+            while( ( __atomic_load_n( &_step.completed, __ATOMIC_RELAXED ) +
+                     __atomic_load_n( &_step.failed, __ATOMIC_RELAXED ) < queued ) &&
+                   ( ( xTaskGetTickCount() - startTicks ) * portTICK_PERIOD_MS < IOT_DEMO_BENCH_DRAIN_MS ) )
+            {
+                vTaskDelay( pdMS_TO_TICKS( 10 ) );
+            }
+
+            drainMs = ( uint32_t ) ( ( xTaskGetTickCount() - startTicks ) * portTICK_PERIOD_MS );
+
+            IotDemoLoopbackBroker_GetStats( &brokerAfter );
+            brokerAfter.publishes -= brokerBefore.publishes;
+            brokerAfter.publishBytes -= brokerBefore.publishBytes;
+            brokerAfter.sends -= brokerBefore.sends;
+            brokerAfter.wireBytes -= brokerBefore.wireBytes;
+
+            _printStep( rate, offered, queued, elapsedMs, drainMs, &brokerAfter );
+
+            sustained = ( queued == offered ) &&
+                        ( _step.failed == 0 ) &&
+                        ( _step.completed == queued );
+
+            if( ( queued < offered ) && ( dropOnset == 0 ) )
+            {
+                dropOnset = rate;
+            }
+
+            if( sustained == true )
+            {
+                maxSustained = rate;
+                unsustained = 0;
+            }
+            else if( ++unsustained >= IOT_DEMO_BENCH_STOP_AFTER )
+            {
+                break;
+            }
+        }
+
+        printf( "{\"bench\":\"mqtt_pipeline\",\"event\":\"summary\","
+                "\"max_sustained_rate\":%lu,\"drop_onset_rate\":%lu}\n",
+                ( unsigned long ) maxSustained,
+                ( unsigned long ) dropOnset );
+
+        IotLogInfo( "Benchmark complete." );
+
+        vTaskDelete( NULL );
+    }
+
+/*-----------------------------------------------------------*/
+
+    bool IotDemoBench_Start( IotDemoBenchProduce_t produce )
+    {
+        return xTaskCreatePinnedToCore( _benchmarkTask,
+                                        "DemoBench",
+                                        IOT_DEMO_BENCH_TASK_STACK_SIZE,
+                                        ( void * ) produce,
+                                        IOT_DEMO_BENCH_TASK_PRIORITY,
+                                        NULL,
+                                        IOT_DEMO_BENCH_TASK_CORE ) == pdPASS;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoBench_StageEnd( IotDemoBenchStage_t stage,
+                                uint32_t startCycles )
+    {
+        uint32_t cycles = IotDemoBench_Cycles() - startCycles;
+        _stageStats_t * pStage = &( _step.stages[ stage ] );
+
+        /* Each stage runs in a single task, or under the send mutex of its
+         * module, so no locking is needed. */
+        pStage->count++;
+        pStage->cycles += cycles;
+
+        if( cycles > pStage->maxCycles )
+        {
+            pStage->maxCycles = cycles;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoBench_Dequeued( intptr_t publishCount,
+                                uint32_t enqueueTimeUs )
+    {
+        _inflight_t * pInflight = &( _inflight[ ( size_t ) publishCount % IOT_DEMO_BENCH_MAX_INFLIGHT ] );
+
+        pInflight->publishCount = publishCount;
+        pInflight->enqueueTimeUs = enqueueTimeUs;
+        pInflight->valid = true;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoBench_Completed( intptr_t publishCount,
+                                 bool success )
+    {
+        _inflight_t * pInflight = &( _inflight[ ( size_t ) publishCount % IOT_DEMO_BENCH_MAX_INFLIGHT ] );
+        uint32_t latencyUs = 0, maxLatencyUs = 0;
+
+        if( success == false )
+        {
+            ( void ) __atomic_add_fetch( &_step.failed, 1, __ATOMIC_RELAXED );
+
+            return;
+        }
+
+        if( ( pInflight->valid == true ) && ( pInflight->publishCount == publishCount ) )
+        {
+            pInflight->valid = false;
+            latencyUs = IotDemoBench_TimeUs() - pInflight->enqueueTimeUs;
+
+            ( void ) __atomic_add_fetch( &_step.latency[ _histogramIndex( latencyUs ) ], 1, __ATOMIC_RELAXED );
+
+            maxLatencyUs = __atomic_load_n( &_step.maxLatencyUs, __ATOMIC_RELAXED );
+
+            while( ( latencyUs > maxLatencyUs ) &&
+                   ( __atomic_compare_exchange_n( &_step.maxLatencyUs, &maxLatencyUs, latencyUs,
+                                                  false, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) == false ) )
+            {
+            }
+        }
+        else
+        {
+            ( void ) __atomic_add_fetch( &_step.untimed, 1, __ATOMIC_RELAXED );
+        }
+
+        ( void ) __atomic_add_fetch( &_step.completed, 1, __ATOMIC_RELAXED );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if IOT_DEMO_MQTT_BENCHMARK == 1 */
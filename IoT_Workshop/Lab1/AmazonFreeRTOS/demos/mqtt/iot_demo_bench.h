@@ -0,0 +1,197 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_bench.h
+ * @brief Throughput and latency benchmark of the MQTT demo pipeline.
+ *
+ * With `IOT_DEMO_MQTT_BENCHMARK` set to 1 in iot_config.h, the MQTT demo
+ * connects to the loopback broker (iot_demo_loopback_broker.h) and, instead
+ * of sampling on its timer, is fed by a producer task that steps through
+ * increasing event rates. Every event takes the normal path: sensor read,
+ * `xDemoRing`, payload formatting, `IotMqtt_Publish` and the completion
+ * callback. One JSON line is printed per rate step and a summary line at the
+ * end, so the console output can be collected and compared between releases.
+ * Build with DHT22_SIMULATED, since the real sensor cannot be read faster
+ * than every two seconds.
+ *
+ * `make lab1-bench` in host/ builds the same benchmark as a Linux program,
+ * which compares releases without a board; cycle counts there are host
+ * time scaled to configCPU_CLOCK_HZ.
+ *
+ * With the benchmark disabled every hook used by the demo compiles to
+ * nothing.
+ */
+
+#ifndef IOT_DEMO_BENCH_H_
+#define IOT_DEMO_BENCH_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Set to 1 to run the MQTT demo as a benchmark.
+ */
+#ifndef IOT_DEMO_MQTT_BENCHMARK
+    #define IOT_DEMO_MQTT_BENCHMARK    ( 0 )
+#endif
+
+/**
+ * @brief Stages of the pipeline whose cost is measured.
+ */
+typedef enum IotDemoBenchStage
+{
+    IOT_DEMO_BENCH_STAGE_SAMPLE = 0, /**< Sensor read into a queue message. */
+    IOT_DEMO_BENCH_STAGE_ENQUEUE,    /**< Pushing to `xDemoRing`. */
+    IOT_DEMO_BENCH_STAGE_FORMAT,     /**< Formatting the payload. */
+    IOT_DEMO_BENCH_STAGE_PUBLISH,    /**< `IotMqtt_Publish`, up to its return. */
+    IOT_DEMO_BENCH_STAGE_CORK,       /**< Holding packets back (iot_demo_cork.h), sends excluded. */
+    IOT_DEMO_BENCH_STAGE_SEND,       /**< A send to the loopback broker: TLS record and packet handling. */
+    IOT_DEMO_BENCH_STAGE_COUNT
+} IotDemoBenchStage_t;
+
+#if IOT_DEMO_MQTT_BENCHMARK == 1
+
+    #include "esp_timer.h"
+    #include "xtensa/hal.h"
+
+/**
+ * @brief Event rates stepped through, in events per second.
+ */
+    #ifndef IOT_DEMO_BENCH_RATES
+        #define IOT_DEMO_BENCH_RATES    { 1, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 }
+    #endif
+
+/**
+ * @brief How long each rate is offered.
+ */
+    #ifndef IOT_DEMO_BENCH_STEP_MS
+        #define IOT_DEMO_BENCH_STEP_MS    ( 5000 )
+    #endif
+
+/**
+ * @brief How long completions are awaited after each step.
+ */
+    #ifndef IOT_DEMO_BENCH_DRAIN_MS
+        #define IOT_DEMO_BENCH_DRAIN_MS    ( 5000 )
+    #endif
+
+/**
+ * @brief The run stops after this many consecutive steps that could not be
+ * sustained.
+ */
+    #ifndef IOT_DEMO_BENCH_STOP_AFTER
+        #define IOT_DEMO_BENCH_STOP_AFTER    ( 2 )
+    #endif
+
+/**
+ * @brief Publishes whose enqueue time is remembered until completion.
+ * Completions of older publishes are counted but not timed.
+ */
+    #ifndef IOT_DEMO_BENCH_MAX_INFLIGHT
+        #define IOT_DEMO_BENCH_MAX_INFLIGHT    ( 128 )
+    #endif
+
+    #ifndef IOT_DEMO_BENCH_TASK_STACK_SIZE
+        #define IOT_DEMO_BENCH_TASK_STACK_SIZE    ( 3072 )
+    #endif
+
+/**
+ * @brief Priority of the producer; above the demo task so that events are
+ * offered at the set rate whether or not the pipeline keeps up.
+ */
+    #ifndef IOT_DEMO_BENCH_TASK_PRIORITY
+        #define IOT_DEMO_BENCH_TASK_PRIORITY    ( tskIDLE_PRIORITY + 6 )
+    #endif
+
+/**
+ * @brief Core of the producer; the demo's sampling core, so that events
+ * cross between cores as readings do.
+ */
+    #ifndef IOT_DEMO_BENCH_TASK_CORE
+        #define IOT_DEMO_BENCH_TASK_CORE    ( 1 )
+    #endif
+
+/**
+ * @brief Cycle counter of the calling core, for the cost of stages that
+ * start and end in the same task.
+ */
+    #define IotDemoBench_Cycles()    xthal_get_ccount()
+
+/**
+ * @brief Microsecond time shared by both cores, for latencies between tasks.
+ */
+    #define IotDemoBench_TimeUs()    ( ( uint32_t ) esp_timer_get_time() )
+
+/**
+ * @brief Produce one event: sample and send it to the queue.
+ *
+ * @return `true` if the event was queued; `false` if it was dropped.
+ */
+    typedef bool ( * IotDemoBenchProduce_t )( void );
+
+/**
+ * @brief Start the producer task that runs the benchmark.
+ *
+ * @return `true` if the task was created.
+ */
+    bool IotDemoBench_Start( IotDemoBenchProduce_t produce );
+
+/**
+ * @brief Account the cost of a stage that started at `startCycles`.
+ */
+    void IotDemoBench_StageEnd( IotDemoBenchStage_t stage,
+                                uint32_t startCycles );
+
+/**
+ * @brief Note that the demo task took a message off the queue and will
+ * publish it with number `publishCount`.
+ *
+ * @param[in] enqueueTimeUs #IotDemoBench_TimeUs when the message was queued.
+ */
+    void IotDemoBench_Dequeued( intptr_t publishCount,
+                                uint32_t enqueueTimeUs );
+
+/**
+ * @brief Note the completion of publish `publishCount`.
+ */
+    void IotDemoBench_Completed( intptr_t publishCount,
+                                 bool success );
+
+#else /* if IOT_DEMO_MQTT_BENCHMARK == 1 */
+
+    #define IotDemoBench_Cycles()                             ( 0 )
+    #define IotDemoBench_TimeUs()                             ( 0 )
+    #define IotDemoBench_StageEnd( stage, startCycles )       ( ( void ) ( startCycles ) )
+    #define IotDemoBench_Dequeued( publishCount, enqueueTimeUs )
+    #define IotDemoBench_Completed( publishCount, success )
+
+#endif /* if IOT_DEMO_MQTT_BENCHMARK == 1 */
+
+#endif /* ifndef IOT_DEMO_BENCH_H_ */
@@ -0,0 +1,481 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file iot_demo_cork.c
+ * @brief Coalescing of outgoing MQTT packets into fewer network sends.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_cork.h"
+
+#if IOT_DEMO_MQTT_CORK == 1
+
+/* Standard includes. */
+    #include <stdbool.h>
+    #include <stdio.h>
+    #include <string.h>
+
+/* Set up logging for this demo. */
+    #include "iot_demo_logging.h"
+
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+
+    #include "driver/stack_budget.h"
+
+    #include "iot_demo_bench.h"
+
+/**
+ * @brief MQTT control packet type of PUBLISH.
+ */
+    #define MQTT_PACKET_PUBLISH    ( 3 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Why held packets were sent.
+ */
+    typedef enum _corkSend
+    {
+        CORK_SEND_WINDOW,
+        CORK_SEND_THRESHOLD,
+        CORK_SEND_CONTROL,
+        CORK_SEND_CLOSE
+    } _corkSend_t;
+
+/**
+ * @brief The one wrapped connection. Everything but the task handle is
+ * guarded by #_mutex.
+ */
+    typedef struct _corkConnection
+    {
+        void * pUnderlying;       /**< NULL while there is no connection. */
+        uint8_t buffer[ IOT_DEMO_CORK_BUFFER_SIZE ];
+        size_t length;            /**< Bytes held. */
+        uint32_t packets;         /**< Packets held. */
+        TickType_t heldTicks;     /**< When the first packet held arrived. */
+        bool failed;              /**< A send of held packets failed. */
+    } _corkConnection_t;
+
+    static const IotNetworkInterface_t * _pUnderlyingInterface = NULL;
+
+    static _corkConnection_t _connection = { 0 };
+    static IotDemoCorkStats_t _stats = { 0 };
+
+    static SemaphoreHandle_t _mutex = NULL;
+    static TaskHandle_t _task = NULL;
+
+    #if democonfigSTATIC_ALLOCATION == 1
+        static StaticSemaphore_t _mutexBuffer;
+        static StaticTask_t _taskBuffer;
+        static StackType_t _taskStack[ IOT_DEMO_CORK_TASK_STACK_SIZE ];
+    #endif
+
+/*-----------------------------------------------------------*/
+
+    static void _count( uint32_t packets,
+                        size_t bytes )
+    {
+        _stats.sends++;
+        _stats.packets += packets;
+        _stats.bytes += ( uint32_t ) bytes;
+        _stats.histogram[ ( packets < IOT_DEMO_CORK_HISTOGRAM_BUCKETS ) ? packets - 1 :
+                          IOT_DEMO_CORK_HISTOGRAM_BUCKETS - 1 ]++;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send through the underlying interface; a short send breaks the
+ * stream, so it fails the connection.
+ *
+ * @return Cycles spent in the underlying interface, left out of the cost of
+ * the wrapper.
+ */
+    static uint32_t _sendUnderlying( const uint8_t * pMessage,
+                                     size_t messageLength,
+                                     uint32_t packets )
+    {
+        uint32_t startCycles = IotDemoBench_Cycles();
+
+        if( _pUnderlyingInterface->send( _connection.pUnderlying, pMessage, messageLength ) == messageLength )
+        {
+            _count( packets, messageLength );
+        }
+        else
+        {
+            _stats.failures++;
+            _connection.failed = true;
+        }
+
+        return IotDemoBench_Cycles() - startCycles;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send the packets held, if any.
+ */
+    static uint32_t _sendHeld( _corkSend_t reason )
+    {
+        uint32_t cycles = 0;
+
+        if( ( _connection.length == 0 ) || ( _connection.failed == true ) )
+        {
+            return 0;
+        }
+
+        cycles = _sendUnderlying( _connection.buffer, _connection.length, _connection.packets );
+
+        switch( reason )
+        {
+            case CORK_SEND_WINDOW:
+                _stats.windowSends++;
+                break;
+
+            case CORK_SEND_THRESHOLD:
+                _stats.thresholdSends++;
+                break;
+
+            case CORK_SEND_CONTROL:
+                _stats.controlSends++;
+                break;
+
+            default:
+                break;
+        }
+
+        _connection.length = 0;
+        _connection.packets = 0;
+
+        return cycles;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send held packets once the window of the first one closes.
+ */
+    static void _corkTask( void * pArgument )
+    {
+        const TickType_t window = pdMS_TO_TICKS( IOT_DEMO_CORK_WINDOW_MS );
+        TickType_t wait = portMAX_DELAY, elapsed = 0;
+        uint32_t startCycles = 0;
+
+        ( void ) pArgument;
+
+        StackBudget_Register( NULL, "IOT_DEMO_CORK_TASK_STACK_SIZE", IOT_DEMO_CORK_TASK_STACK_SIZE );
+
+        for( ; ; )
+        {
+            /* Notified when a packet is held in an empty buffer. */
+            ( void ) ulTaskNotifyTake( pdTRUE, wait );
+
+            ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+            startCycles = IotDemoBench_Cycles();
+            wait = portMAX_DELAY;
+
+            if( _connection.length > 0 )
+            {
+                elapsed = xTaskGetTickCount() - _connection.heldTicks;
+
+                if( elapsed >= window )
+                {
+                    startCycles += _sendHeld( CORK_SEND_WINDOW );
+                }
+                else
+                {
+                    wait = window - elapsed;
+                }
+            }
+
+            IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_CORK, startCycles );
+            ( void ) xSemaphoreGive( _mutex );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _create( void * pConnectionInfo,
+                                      void * pCredentialInfo,
+                                      void ** pConnection )
+    {
+        IotNetworkError_t status = IOT_NETWORK_SUCCESS;
+
+        ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+
+        if( _connection.pUnderlying != NULL )
+        {
+            IotLogError( "Corking supports one connection at a time." );
+
+            status = IOT_NETWORK_FAILURE;
+        }
+        else
+        {
+            status = _pUnderlyingInterface->create( pConnectionInfo,
+                                                    pCredentialInfo,
+                                                    &( _connection.pUnderlying ) );
+
+            if( status == IOT_NETWORK_SUCCESS )
+            {
+                _connection.length = 0;
+                _connection.packets = 0;
+                _connection.failed = false;
+
+                /* The MQTT library only uses the handle to call back into
+                 * this interface, so the underlying one is passed on. */
+                *pConnection = _connection.pUnderlying;
+            }
+            else
+            {
+                _connection.pUnderlying = NULL;
+            }
+        }
+
+        ( void ) xSemaphoreGive( _mutex );
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _close( void * pConnection )
+    {
+        ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+        ( void ) _sendHeld( CORK_SEND_CLOSE );
+        ( void ) xSemaphoreGive( _mutex );
+
+        return _pUnderlyingInterface->close( pConnection );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _send( void * pConnection,
+                         const uint8_t * pMessage,
+                         size_t messageLength )
+    {
+        bool publish = ( messageLength > 0 ) && ( ( pMessage[ 0 ] >> 4 ) == MQTT_PACKET_PUBLISH );
+        size_t sent = messageLength;
+        uint32_t startCycles = 0;
+
+        ( void ) pConnection;
+
+        ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+        startCycles = IotDemoBench_Cycles();
+
+        /* Make room, keeping the packets in order. */
+        if( _connection.length + messageLength > IOT_DEMO_CORK_BUFFER_SIZE )
+        {
+            startCycles += _sendHeld( CORK_SEND_THRESHOLD );
+        }
+
+        if( _connection.failed == true )
+        {
+            sent = 0;
+        }
+        else if( messageLength > IOT_DEMO_CORK_BUFFER_SIZE )
+        {
+            startCycles += _sendUnderlying( pMessage, messageLength, 1 );
+        }
+        else
+        {
+            ( void ) memcpy( &( _connection.buffer[ _connection.length ] ), pMessage, messageLength );
+            _connection.length += messageLength;
+            _connection.packets++;
+
+            if( publish == false )
+            {
+                startCycles += _sendHeld( CORK_SEND_CONTROL );
+            }
+            else if( _connection.length >= IOT_DEMO_CORK_FLUSH_BYTES )
+            {
+                startCycles += _sendHeld( CORK_SEND_THRESHOLD );
+            }
+            else if( _connection.packets == 1 )
+            {
+                /* The window starts with the first packet held. */
+                _connection.heldTicks = xTaskGetTickCount();
+                ( void ) xTaskNotifyGive( _task );
+            }
+        }
+
+        if( _connection.failed == true )
+        {
+            sent = 0;
+        }
+
+        IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_CORK, startCycles );
+        ( void ) xSemaphoreGive( _mutex );
+
+        return sent;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _receive( void * pConnection,
+                            uint8_t * pBuffer,
+                            size_t bytesRequested )
+    {
+        return _pUnderlyingInterface->receive( pConnection, pBuffer, bytesRequested );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _setReceiveCallback( void * pConnection,
+                                                  IotNetworkReceiveCallback_t receiveCallback,
+                                                  void * pContext )
+    {
+        return _pUnderlyingInterface->setReceiveCallback( pConnection, receiveCallback, pContext );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _destroy( void * pConnection )
+    {
+        ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+
+        /* Anything still held has nowhere to go. */
+        _connection.pUnderlying = NULL;
+        _connection.length = 0;
+        _connection.packets = 0;
+
+        ( void ) xSemaphoreGive( _mutex );
+
+        return _pUnderlyingInterface->destroy( pConnection );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static const IotNetworkInterface_t _corkInterface =
+    {
+        .create             = _create,
+        .close              = _close,
+        .send               = _send,
+        .receive            = _receive,
+        .setReceiveCallback = _setReceiveCallback,
+        .destroy            = _destroy
+    };
+
+/*-----------------------------------------------------------*/
+
+    const IotNetworkInterface_t * IotDemoCork_WrapInterface( const IotNetworkInterface_t * pNetworkInterface )
+    {
+        if( _mutex == NULL )
+        {
+            #if democonfigSTATIC_ALLOCATION == 1
+                _mutex = xSemaphoreCreateMutexStatic( &_mutexBuffer );
+            #else
+                _mutex = xSemaphoreCreateMutex();
+            #endif
+        }
+
+        if( ( _mutex != NULL ) && ( _task == NULL ) )
+        {
+            #if democonfigSTATIC_ALLOCATION == 1
+                _task = xTaskCreateStaticPinnedToCore( _corkTask,
+                                                       "MqttCork",
+                                                       IOT_DEMO_CORK_TASK_STACK_SIZE,
+                                                       NULL,
+                                                       IOT_DEMO_CORK_TASK_PRIORITY,
+                                                       _taskStack,
+                                                       &_taskBuffer,
+                                                       IOT_DEMO_CORK_TASK_CORE );
+            #else
+                ( void ) xTaskCreatePinnedToCore( _corkTask,
+                                                  "MqttCork",
+                                                  IOT_DEMO_CORK_TASK_STACK_SIZE,
+                                                  NULL,
+                                                  IOT_DEMO_CORK_TASK_PRIORITY,
+                                                  &_task,
+                                                  IOT_DEMO_CORK_TASK_CORE );
+            #endif
+        }
+
+        if( _task == NULL )
+        {
+            IotLogError( "Failed to start the cork task; packets are sent as they come." );
+
+            return pNetworkInterface;
+        }
+
+        /* Only swapped while there is no connection. */
+        _pUnderlyingInterface = pNetworkInterface;
+
+        return &_corkInterface;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoCork_GetStats( IotDemoCorkStats_t * pStats )
+    {
+        ( void ) xSemaphoreTake( _mutex, portMAX_DELAY );
+        *pStats = _stats;
+        ( void ) xSemaphoreGive( _mutex );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoCork_Print( void )
+    {
+        IotDemoCorkStats_t stats = { 0 };
+        char histogram[ IOT_DEMO_CORK_HISTOGRAM_BUCKETS * 16 ] = { 0 };
+        size_t length = 0, i = 0;
+
+        if( _mutex == NULL )
+        {
+            return;
+        }
+
+        IotDemoCork_GetStats( &stats );
+
+        for( i = 0; ( i < IOT_DEMO_CORK_HISTOGRAM_BUCKETS ) && ( length < sizeof( histogram ) ); i++ )
+        {
+            length += ( size_t ) snprintf( &( histogram[ length ] ),
+                                           sizeof( histogram ) - length,
+                                           ( i + 1 < IOT_DEMO_CORK_HISTOGRAM_BUCKETS ) ? " %u:%lu" : " %u+:%lu",
+                                           ( unsigned ) ( i + 1 ),
+                                           ( unsigned long ) stats.histogram[ i ] );
+        }
+
+        IotLogInfo( "Cork: %lu packets, %lu bytes in %lu sends (window %lu, size %lu, control %lu), "
+                    "%lu failed. Packets per send:%s",
+                    ( unsigned long ) stats.packets,
+                    ( unsigned long ) stats.bytes,
+                    ( unsigned long ) stats.sends,
+                    ( unsigned long ) stats.windowSends,
+                    ( unsigned long ) stats.thresholdSends,
+                    ( unsigned long ) stats.controlSends,
+                    ( unsigned long ) stats.failures,
+                    histogram );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if IOT_DEMO_MQTT_CORK == 1 */
@@ -0,0 +1,172 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file iot_demo_cork.h
+ * @brief Coalescing of outgoing MQTT packets into fewer network sends.
+ *
+ * The MQTT library hands every packet to the network interface in a call of
+ * its own, and every call becomes a TLS record of its own: a record header,
+ * an authentication tag, an encryption and a MAC pass, and usually a TCP
+ * segment. When several readings are ready at once, most of that is paid
+ * once per reading.
+ *
+ * With `IOT_DEMO_MQTT_CORK` set to 1 in iot_config.h, the interface used by
+ * the MQTT demo is wrapped by one that holds PUBLISH packets back (corks
+ * them) in a buffer and writes the buffer with a single send, and so a
+ * single TLS record, when:
+ * - #IOT_DEMO_CORK_WINDOW_MS have passed since the first packet held,
+ * - #IOT_DEMO_CORK_FLUSH_BYTES are held, or the next packet does not fit,
+ * - any other packet is sent; it goes out in the same send, after the
+ *   PUBLISH packets held, so the order on the wire is unchanged.
+ *
+ * The MQTT library sends from its task pool, not from the task that called
+ * `IotMqtt_Publish`, so the window is kept by a task of the wrapper. A held
+ * packet counts as sent. If a send of held packets then fails, every later
+ * send fails too until the next connection, so the MQTT library sees the
+ * broken connection, and QoS 1 packets are sent again.
+ *
+ * With corking disabled the wrapper compiles to nothing.
+ */
+
+#ifndef IOT_DEMO_CORK_H_
+#define IOT_DEMO_CORK_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* Platform layer includes. */
+#include "platform/iot_network.h"
+
+/* Demo configuration, for the static allocation setting and the stack
+ * sizes derived by driver/stack_budget.h. */
+#include "aws_demo_config.h"
+
+/**
+ * @brief Set to 1 to coalesce the packets of the MQTT demo.
+ */
+#ifndef IOT_DEMO_MQTT_CORK
+    #define IOT_DEMO_MQTT_CORK    ( 0 )
+#endif
+
+/**
+ * @brief Longest a PUBLISH packet is held. Rounded down to whole ticks; 0
+ * sends as soon as the task of the wrapper runs.
+ */
+#ifndef IOT_DEMO_CORK_WINDOW_MS
+    #define IOT_DEMO_CORK_WINDOW_MS           ( 5 )
+#endif
+
+/**
+ * @brief Bytes held at most: one TLS record that, with its 29 bytes of
+ * AES-GCM overhead, fits a 1436 byte TCP segment. Longer packets are sent
+ * on their own.
+ */
+#ifndef IOT_DEMO_CORK_BUFFER_SIZE
+    #define IOT_DEMO_CORK_BUFFER_SIZE         ( 1400 )
+#endif
+
+/**
+ * @brief Bytes held that trigger a send without waiting for the window.
+ */
+#ifndef IOT_DEMO_CORK_FLUSH_BYTES
+    #define IOT_DEMO_CORK_FLUSH_BYTES         ( 1024 )
+#endif
+
+/**
+ * @brief Buckets of the packets per send histogram; the last one counts
+ * sends of that many packets or more.
+ */
+#ifndef IOT_DEMO_CORK_HISTOGRAM_BUCKETS
+    #define IOT_DEMO_CORK_HISTOGRAM_BUCKETS    ( 8 )
+#endif
+
+#ifndef IOT_DEMO_CORK_TASK_STACK_SIZE
+    #define IOT_DEMO_CORK_TASK_STACK_SIZE     ( 4096 )
+#endif
+
+#ifndef IOT_DEMO_CORK_TASK_PRIORITY
+    #define IOT_DEMO_CORK_TASK_PRIORITY       ( tskIDLE_PRIORITY + 5 )
+#endif
+
+/**
+ * @brief Core of the task of the wrapper; the network core of the demo.
+ */
+#ifndef IOT_DEMO_CORK_TASK_CORE
+    #define IOT_DEMO_CORK_TASK_CORE           ( 0 )
+#endif
+
+#if IOT_DEMO_CORK_FLUSH_BYTES > IOT_DEMO_CORK_BUFFER_SIZE
+    #error "IOT_DEMO_CORK_FLUSH_BYTES must not exceed IOT_DEMO_CORK_BUFFER_SIZE."
+#endif
+
+/**
+ * @brief Sends made by the wrapper, and why.
+ */
+typedef struct IotDemoCorkStats
+{
+    uint32_t sends;            /**< Sends to the underlying interface. */
+    uint32_t packets;          /**< MQTT packets in those sends. */
+    uint32_t bytes;            /**< Bytes in those sends. */
+    uint32_t windowSends;      /**< Sends made as the window closed. */
+    uint32_t thresholdSends;   /**< Sends made at #IOT_DEMO_CORK_FLUSH_BYTES or a full buffer. */
+    uint32_t controlSends;     /**< Sends made for a packet other than PUBLISH. */
+    uint32_t failures;         /**< Sends that did not take every byte. */
+    uint32_t histogram[ IOT_DEMO_CORK_HISTOGRAM_BUCKETS ]; /**< Bucket n: sends of n + 1 packets. */
+} IotDemoCorkStats_t;
+
+#if IOT_DEMO_MQTT_CORK == 1
+
+/**
+ * @brief Return a network interface that coalesces the packets sent on the
+ * connections of `pNetworkInterface`. One connection at a time.
+ *
+ * Starts the task of the wrapper on the first call. If it cannot be
+ * started, `pNetworkInterface` is returned and nothing is coalesced.
+ */
+    const IotNetworkInterface_t * IotDemoCork_WrapInterface( const IotNetworkInterface_t * pNetworkInterface );
+
+/**
+ * @brief Copy the statistics.
+ */
+    void IotDemoCork_GetStats( IotDemoCorkStats_t * pStats );
+
+/**
+ * @brief Log the statistics.
+ */
+    void IotDemoCork_Print( void );
+
+#else /* if IOT_DEMO_MQTT_CORK == 1 */
+
+    #define IotDemoCork_WrapInterface( pNetworkInterface )    ( pNetworkInterface )
+    #define IotDemoCork_Print()
+
+#endif /* if IOT_DEMO_MQTT_CORK == 1 */
+
+#endif /* ifndef IOT_DEMO_CORK_H_ */
@@ -0,0 +1,618 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_fault.c
+ * @brief Network fault injection below the MQTT library.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_fault.h"
+
+#if IOT_DEMO_MQTT_FAULT_INJECTION == 1
+
+/* Standard includes. */
+    #include <string.h>
+
+/* Set up logging for this demo. */
+    #include "iot_demo_logging.h"
+
+/* Platform layer includes. */
+    #include "platform/iot_clock.h"
+
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/semphr.h"
+    #include "freertos/timers.h"
+
+/**
+ * @brief Fixed header byte of a PUBACK.
+ */
+    #define MQTT_PUBACK_HEADER    ( 0x40 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The one wrapped connection.
+ */
+    typedef struct _faultConnection
+    {
+        void * pUnderlying;
+        IotNetworkReceiveCallback_t receiveCallback;
+        void * pCallbackContext;
+
+        /* The incoming packet being handed to the MQTT library. */
+        uint8_t pending[ IOT_DEMO_FAULT_MAX_PACKET_SIZE ];
+        size_t pendingLength;
+        size_t pendingOffset;
+        size_t passthroughLength;  /**< Bytes of a long packet still in the underlying connection. */
+        bool readFailed;
+
+        size_t appliedPhase;       /**< Phase whose start has been acted on. */
+        bool forcedClosed;
+        bool inUse;
+    } _faultConnection_t;
+
+    static const IotDemoFaultPhase_t _defaultSchedule[] = IOT_DEMO_FAULT_SCHEDULE;
+
+    static const IotNetworkInterface_t * _pUnderlyingInterface = NULL;
+    static const IotDemoFaultPhase_t * _pSchedule = _defaultSchedule;
+    static size_t _phaseCount = sizeof( _defaultSchedule ) / sizeof( _defaultSchedule[ 0 ] );
+    static uint32_t _seed = IOT_DEMO_FAULT_SEED;
+
+    static uint64_t _epochMs = 0;
+    static bool _started = false;
+    static uint64_t _faultMs = 0;      /**< Time of the unrecovered fault, 0 if none. */
+
+    /* One generator per direction keeps each deterministic regardless of
+     * how sends and receives interleave. */
+    static uint32_t _sendRandom = 1;
+    static uint32_t _receiveRandom = 1;
+
+    static _faultConnection_t _connection = { 0 };
+    static IotDemoFaultStats_t _stats = { 0 };
+
+    /* Held while the MQTT library is told of a forced close, and while the
+     * connection is destroyed; the generation tells a late notice from one
+     * for the current connection. */
+    static StaticSemaphore_t _notifyMutexBuffer;
+    static SemaphoreHandle_t _notifyMutex = NULL;
+    static uint32_t _generation = 0;
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t _nextRandom( uint32_t * pState )
+    {
+        uint32_t x = *pState;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *pState = x;
+
+        return x;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static bool _chance( uint32_t * pState,
+                         uint16_t perMille )
+    {
+        return ( perMille > 0 ) && ( ( _nextRandom( pState ) % 1000 ) < perMille );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _currentPhase( void )
+    {
+        uint64_t elapsedMs = IotClock_GetTimeMs() - _epochMs;
+        size_t phase = 0;
+
+        while( ( phase + 1 < _phaseCount ) && ( _pSchedule[ phase + 1 ].startMs <= elapsedMs ) )
+        {
+            phase++;
+        }
+
+        return phase;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Sleep for the latency and throughput cap of a phase.
+ */
+    static void _delay( const IotDemoFaultPhase_t * pPhase,
+                        uint32_t * pRandom,
+                        size_t bytes )
+    {
+        uint32_t delayMs = pPhase->latencyMs;
+
+        if( pPhase->jitterMs > 0 )
+        {
+            delayMs += _nextRandom( pRandom ) % ( pPhase->jitterMs + 1 );
+        }
+
+        if( pPhase->bytesPerSecond > 0 )
+        {
+            delayMs += ( uint32_t ) ( ( uint64_t ) bytes * 1000 / pPhase->bytesPerSecond );
+        }
+
+        if( delayMs > 0 )
+        {
+            IotClock_SleepMs( delayMs );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tell the MQTT library of a forced close, from the timer task. It
+ * reads nothing, takes the connection as lost, and closes it.
+ */
+    static void _notifyClosed( void * pParameter,
+                               uint32_t generation )
+    {
+        _faultConnection_t * pConnection = ( _faultConnection_t * ) pParameter;
+
+        ( void ) xSemaphoreTake( _notifyMutex, portMAX_DELAY );
+
+        if( ( pConnection->inUse == true ) &&
+            ( generation == _generation ) &&
+            ( pConnection->receiveCallback != NULL ) )
+        {
+            pConnection->receiveCallback( pConnection, pConnection->pCallbackContext );
+        }
+
+        ( void ) xSemaphoreGive( _notifyMutex );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Act on the start of a new phase.
+ *
+ * @return The current phase.
+ */
+    static const IotDemoFaultPhase_t * _applyPhase( _faultConnection_t * pConnection )
+    {
+        size_t phase = _currentPhase();
+
+        if( phase != pConnection->appliedPhase )
+        {
+            pConnection->appliedPhase = phase;
+
+            if( ( _pSchedule[ phase ].disconnect == true ) && ( pConnection->forcedClosed == false ) )
+            {
+                IotLogWarn( "Fault: closing the connection." );
+
+                pConnection->forcedClosed = true;
+                _stats.disconnects++;
+                _faultMs = IotClock_GetTimeMs();
+                ( void ) _pUnderlyingInterface->close( pConnection->pUnderlying );
+
+                /* The underlying connection does not report a close it was
+                 * asked for; report it as a peer close would be. */
+                pConnection->readFailed = true;
+                ( void ) xTimerPendFunctionCall( _notifyClosed, pConnection, _generation, 0 );
+            }
+        }
+
+        return &( _pSchedule[ phase ] );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Read exactly `length` bytes from the underlying connection.
+ */
+    static bool _readUnderlying( _faultConnection_t * pConnection,
+                                 uint8_t * pBuffer,
+                                 size_t length )
+    {
+        return _pUnderlyingInterface->receive( pConnection->pUnderlying, pBuffer, length ) == length;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Called by the underlying connection when data arrives. Reads one
+ * packet, decides its fate, and hands it on.
+ */
+    static void _receiveCallback( void * pUnderlying,
+                                  void * pContext )
+    {
+        _faultConnection_t * pConnection = ( _faultConnection_t * ) pContext;
+        const IotDemoFaultPhase_t * pPhase = _applyPhase( pConnection );
+        size_t remainingLength = 0, multiplier = 1;
+        bool ok = true;
+
+        ( void ) pUnderlying;
+
+        pConnection->pendingLength = 0;
+        pConnection->pendingOffset = 0;
+        pConnection->passthroughLength = 0;
+
+        if( pConnection->forcedClosed == true )
+        {
+            return;
+        }
+
+        /* Fixed header. */
+        ok = _readUnderlying( pConnection, pConnection->pending, 1 );
+        pConnection->pendingLength = 1;
+
+        while( ( ok == true ) && ( pConnection->pendingLength < 5 ) )
+        {
+            ok = _readUnderlying( pConnection, &( pConnection->pending[ pConnection->pendingLength ] ), 1 );
+
+            if( ok == true )
+            {
+                remainingLength += ( pConnection->pending[ pConnection->pendingLength ] & 0x7F ) * multiplier;
+                multiplier *= 128;
+
+                if( ( pConnection->pending[ pConnection->pendingLength++ ] & 0x80 ) == 0 )
+                {
+                    break;
+                }
+            }
+        }
+
+        /* Body, held whole when it fits. */
+        if( ok == true )
+        {
+            if( pConnection->pendingLength + remainingLength <= IOT_DEMO_FAULT_MAX_PACKET_SIZE )
+            {
+                ok = ( remainingLength == 0 ) ||
+                     _readUnderlying( pConnection, &( pConnection->pending[ pConnection->pendingLength ] ), remainingLength );
+                pConnection->pendingLength += remainingLength;
+            }
+            else
+            {
+                pConnection->passthroughLength = remainingLength;
+            }
+        }
+
+        if( ok == false )
+        {
+            /* Let the MQTT library see the failure on its next read. */
+            pConnection->readFailed = true;
+        }
+        else if( pConnection->pending[ 0 ] == MQTT_PUBACK_HEADER )
+        {
+            _stats.pubacksReceived++;
+
+            if( _chance( &_receiveRandom, pPhase->pubackDropPerMille ) == true )
+            {
+                _stats.pubacksDropped++;
+                pConnection->pendingLength = 0;
+
+                return;
+            }
+        }
+
+        if( ok == true )
+        {
+            _delay( pPhase, &_receiveRandom, pConnection->pendingLength + pConnection->passthroughLength );
+        }
+
+        if( pConnection->receiveCallback != NULL )
+        {
+            pConnection->receiveCallback( pConnection, pConnection->pCallbackContext );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _create( void * pConnectionInfo,
+                                      void * pCredentialInfo,
+                                      void ** pConnection )
+    {
+        _faultConnection_t * pNewConnection = &_connection;
+        IotNetworkError_t status = IOT_NETWORK_SUCCESS;
+        size_t phase = 0;
+        uint64_t now = 0;
+
+        if( _started == false )
+        {
+            _started = true;
+            _epochMs = IotClock_GetTimeMs();
+            _sendRandom = ( _seed != 0 ) ? _seed : 1;
+            _receiveRandom = _sendRandom ^ 0x9E3779B9UL;
+        }
+
+        if( pNewConnection->inUse == true )
+        {
+            IotLogError( "Fault injection supports one connection at a time." );
+
+            return IOT_NETWORK_FAILURE;
+        }
+
+        phase = _currentPhase();
+
+        if( _pSchedule[ phase ].refuseConnections == true )
+        {
+            IotLogWarn( "Fault: refusing a connection." );
+
+            _stats.refusals++;
+
+            if( _faultMs == 0 )
+            {
+                _faultMs = IotClock_GetTimeMs();
+            }
+
+            return IOT_NETWORK_FAILURE;
+        }
+
+        ( void ) memset( pNewConnection, 0x00, sizeof( _faultConnection_t ) );
+
+        status = _pUnderlyingInterface->create( pConnectionInfo,
+                                                pCredentialInfo,
+                                                &( pNewConnection->pUnderlying ) );
+
+        if( status == IOT_NETWORK_SUCCESS )
+        {
+            pNewConnection->inUse = true;
+            pNewConnection->appliedPhase = phase;
+            *pConnection = pNewConnection;
+
+            if( _faultMs != 0 )
+            {
+                now = IotClock_GetTimeMs();
+                _stats.recoveries++;
+                _stats.lastRecoveryMs = ( uint32_t ) ( now - _faultMs );
+
+                if( _stats.lastRecoveryMs > _stats.maxRecoveryMs )
+                {
+                    _stats.maxRecoveryMs = _stats.lastRecoveryMs;
+                }
+
+                _faultMs = 0;
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _close( void * pConnection )
+    {
+        _faultConnection_t * pFault = ( _faultConnection_t * ) pConnection;
+
+        if( pFault->forcedClosed == true )
+        {
+            return IOT_NETWORK_SUCCESS;
+        }
+
+        return _pUnderlyingInterface->close( pFault->pUnderlying );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _send( void * pConnection,
+                         const uint8_t * pMessage,
+                         size_t messageLength )
+    {
+        _faultConnection_t * pFault = ( _faultConnection_t * ) pConnection;
+        const IotDemoFaultPhase_t * pPhase = _applyPhase( pFault );
+
+        if( pFault->forcedClosed == true )
+        {
+            return 0;
+        }
+
+        _stats.packetsSent++;
+
+        /* A call holds whole packets: one from the MQTT library, or several
+         * coalesced by iot_demo_cork.h. Dropping it leaves the stream
+         * intact. */
+        if( _chance( &_sendRandom, pPhase->lossPerMille ) == true )
+        {
+            _stats.packetsLost++;
+
+            return messageLength;
+        }
+
+        _delay( pPhase, &_sendRandom, messageLength );
+
+        return _pUnderlyingInterface->send( pFault->pUnderlying, pMessage, messageLength );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _receive( void * pConnection,
+                            uint8_t * pBuffer,
+                            size_t bytesRequested )
+    {
+        _faultConnection_t * pFault = ( _faultConnection_t * ) pConnection;
+        size_t bytesReceived = 0, length = 0;
+
+        if( ( pFault->readFailed == true ) || ( pFault->forcedClosed == true ) )
+        {
+            return 0;
+        }
+
+        length = pFault->pendingLength - pFault->pendingOffset;
+
+        if( length > bytesRequested )
+        {
+            length = bytesRequested;
+        }
+
+        ( void ) memcpy( pBuffer, &( pFault->pending[ pFault->pendingOffset ] ), length );
+        pFault->pendingOffset += length;
+        bytesReceived = length;
+
+        if( ( bytesReceived < bytesRequested ) && ( pFault->passthroughLength > 0 ) )
+        {
+            length = bytesRequested - bytesReceived;
+
+            if( length > pFault->passthroughLength )
+            {
+                length = pFault->passthroughLength;
+            }
+
+            length = _pUnderlyingInterface->receive( pFault->pUnderlying, pBuffer + bytesReceived, length );
+            pFault->passthroughLength -= length;
+            bytesReceived += length;
+        }
+
+        return bytesReceived;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _setReceiveCallback( void * pConnection,
+                                                  IotNetworkReceiveCallback_t receiveCallback,
+                                                  void * pContext )
+    {
+        _faultConnection_t * pFault = ( _faultConnection_t * ) pConnection;
+
+        pFault->pCallbackContext = pContext;
+        pFault->receiveCallback = receiveCallback;
+
+        return _pUnderlyingInterface->setReceiveCallback( pFault->pUnderlying,
+                                                          _receiveCallback,
+                                                          pFault );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotNetworkError_t _destroy( void * pConnection )
+    {
+        _faultConnection_t * pFault = ( _faultConnection_t * ) pConnection;
+        IotNetworkError_t status = _pUnderlyingInterface->destroy( pFault->pUnderlying );
+
+        ( void ) xSemaphoreTake( _notifyMutex, portMAX_DELAY );
+        pFault->inUse = false;
+        _generation++;
+        ( void ) xSemaphoreGive( _notifyMutex );
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static const IotNetworkInterface_t _faultInterface =
+    {
+        .create             = _create,
+        .close              = _close,
+        .send               = _send,
+        .receive            = _receive,
+        .setReceiveCallback = _setReceiveCallback,
+        .destroy            = _destroy
+    };
+
+/*-----------------------------------------------------------*/
+
+    const IotNetworkInterface_t * IotDemoFault_WrapInterface( const IotNetworkInterface_t * pNetworkInterface )
+    {
+        _pUnderlyingInterface = pNetworkInterface;
+
+        if( _notifyMutex == NULL )
+        {
+            _notifyMutex = xSemaphoreCreateMutexStatic( &_notifyMutexBuffer );
+        }
+
+        return &_faultInterface;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_SetSchedule( const IotDemoFaultPhase_t * pPhases,
+                                   size_t phaseCount,
+                                   uint32_t seed )
+    {
+        _pSchedule = pPhases;
+        _phaseCount = phaseCount;
+        _seed = seed;
+        _started = false;
+        _faultMs = 0;
+        ( void ) memset( &_stats, 0x00, sizeof( _stats ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_GetStats( IotDemoFaultStats_t * pStats )
+    {
+        *pStats = _stats;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_Print( void )
+    {
+        IotLogInfo( "Faults: %lu/%lu packets lost, %lu/%lu PUBACKs dropped, "
+                    "%lu disconnects, %lu refusals, %lu recoveries (last %lu ms, max %lu ms).",
+                    ( unsigned long ) _stats.packetsLost,
+                    ( unsigned long ) _stats.packetsSent,
+                    ( unsigned long ) _stats.pubacksDropped,
+                    ( unsigned long ) _stats.pubacksReceived,
+                    ( unsigned long ) _stats.disconnects,
+                    ( unsigned long ) _stats.refusals,
+                    ( unsigned long ) _stats.recoveries,
+                    ( unsigned long ) _stats.lastRecoveryMs,
+                    ( unsigned long ) _stats.maxRecoveryMs );
+        IotLogInfo( "Readings: %lu produced (%lu dropped), %lu published, %lu published again, "
+                    "%lu acknowledged, %lu lost.",
+                    ( unsigned long ) _stats.readingsProduced,
+                    ( unsigned long ) _stats.readingsDropped,
+                    ( unsigned long ) _stats.readingsPublished,
+                    ( unsigned long ) _stats.readingsRepublished,
+                    ( unsigned long ) _stats.readingsAcked,
+                    ( unsigned long ) ( _stats.readingsProduced - _stats.readingsAcked ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_ReadingProduced( bool queued )
+    {
+        ( void ) __atomic_add_fetch( &( _stats.readingsProduced ), 1, __ATOMIC_RELAXED );
+
+        if( queued == false )
+        {
+            ( void ) __atomic_add_fetch( &( _stats.readingsDropped ), 1, __ATOMIC_RELAXED );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_ReadingPublished( bool again )
+    {
+        ( void ) __atomic_add_fetch( ( again == true ) ? &( _stats.readingsRepublished ) : &( _stats.readingsPublished ),
+                                     1, __ATOMIC_RELAXED );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoFault_ReadingAcked( void )
+    {
+        ( void ) __atomic_add_fetch( &( _stats.readingsAcked ), 1, __ATOMIC_RELAXED );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if IOT_DEMO_MQTT_FAULT_INJECTION == 1 */
@@ -0,0 +1,193 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_fault.h
+ * @brief Network fault injection below the MQTT library.
+ *
+ * With `IOT_DEMO_MQTT_FAULT_INJECTION` set to 1 in iot_config.h, the network
+ * interface used by the MQTT demo is wrapped by one that follows a schedule
+ * of phases. Each phase can add latency, cap throughput, discard outgoing
+ * packets, discard incoming PUBACKs, close the connection or refuse new
+ * connections. The wrapper sits above TLS, so it works on whole MQTT packets
+ * whether the server is the real broker or the loopback stand-in
+ * (iot_demo_loopback_broker.h).
+ *
+ * Random decisions come from seeded generators, one per direction, so a
+ * schedule run against the loopback broker injects the same faults into the
+ * same packets every time. Phase changes are applied at the next send or
+ * receive, and keep-alive traffic bounds how late that is. A forced close
+ * is reported to the MQTT library as a failed read, as a peer close would
+ * be, so the demo goes through its reconnect path.
+ *
+ * The demo also reports each reading it produces, publishes and has
+ * acknowledged, so that a run can tell how many readings the faults cost.
+ *
+ * With fault injection disabled the wrapper compiles to nothing.
+ */
+
+#ifndef IOT_DEMO_FAULT_H_
+#define IOT_DEMO_FAULT_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Platform layer includes. */
+#include "platform/iot_network.h"
+
+/**
+ * @brief Set to 1 to inject network faults into the MQTT demo.
+ */
+#ifndef IOT_DEMO_MQTT_FAULT_INJECTION
+    #define IOT_DEMO_MQTT_FAULT_INJECTION    ( 0 )
+#endif
+
+/**
+ * @brief Network conditions from a point in time until the next phase.
+ */
+typedef struct IotDemoFaultPhase
+{
+    uint32_t startMs;             /**< Start, relative to the first connection attempt. */
+    uint32_t latencyMs;           /**< Added to every send and every received packet. */
+    uint32_t jitterMs;            /**< Up to this much more latency, uniformly drawn. */
+    uint32_t bytesPerSecond;      /**< Throughput cap each way, 0 for none. */
+    uint16_t lossPerMille;        /**< Outgoing packets discarded as if sent. */
+    uint16_t pubackDropPerMille;  /**< Incoming PUBACKs discarded. */
+    bool disconnect;              /**< Close the connection as the phase starts. */
+    bool refuseConnections;       /**< New connections fail during the phase. */
+} IotDemoFaultPhase_t;
+
+/**
+ * @brief What was injected, and how long recovery took.
+ */
+typedef struct IotDemoFaultStats
+{
+    uint32_t packetsSent;
+    uint32_t packetsLost;
+    uint32_t pubacksReceived;
+    uint32_t pubacksDropped;
+    uint32_t disconnects;
+    uint32_t refusals;
+    uint32_t recoveries;          /**< Connections made after a disconnect or refusal. */
+    uint32_t lastRecoveryMs;      /**< From the fault to the next connection. */
+    uint32_t maxRecoveryMs;
+    uint32_t readingsProduced;    /**< Messages the demo had to publish. */
+    uint32_t readingsDropped;     /**< Of those, discarded as the ring was full. */
+    uint32_t readingsPublished;   /**< PUBLISHes accepted the first time. */
+    uint32_t readingsRepublished; /**< PUBLISHes made again after a failure. */
+    uint32_t readingsAcked;       /**< Acknowledged, or sent at QoS 0. */
+} IotDemoFaultStats_t;
+
+#if IOT_DEMO_MQTT_FAULT_INJECTION == 1
+
+/**
+ * @brief Phases used unless #IotDemoFault_SetSchedule is called: a clean
+ * minute, then latency, loss, lost PUBACKs, a disconnect with ten seconds
+ * of refused connections, a slow link, and back to clean.
+ */
+    #ifndef IOT_DEMO_FAULT_SCHEDULE
+        #define IOT_DEMO_FAULT_SCHEDULE                                          \
+    {                                                                            \
+        { .startMs = 0 },                                                        \
+        { .startMs = 60000, .latencyMs = 300, .jitterMs = 200 },                 \
+        { .startMs = 120000, .lossPerMille = 100 },                              \
+        { .startMs = 180000, .pubackDropPerMille = 500 },                        \
+        { .startMs = 240000, .disconnect = true, .refuseConnections = true },    \
+        { .startMs = 250000, .bytesPerSecond = 200 },                            \
+        { .startMs = 310000 }                                                    \
+    }
+    #endif
+
+/**
+ * @brief Seed of the default schedule's random decisions.
+ */
+    #ifndef IOT_DEMO_FAULT_SEED
+        #define IOT_DEMO_FAULT_SEED    ( 1 )
+    #endif
+
+/**
+ * @brief Largest incoming packet held whole; longer packets are passed
+ * through as they are read.
+ */
+    #ifndef IOT_DEMO_FAULT_MAX_PACKET_SIZE
+        #define IOT_DEMO_FAULT_MAX_PACKET_SIZE    ( 512 )
+    #endif
+
+/**
+ * @brief Return a network interface that injects faults into the
+ * connections of `pNetworkInterface`. One connection at a time.
+ */
+    const IotNetworkInterface_t * IotDemoFault_WrapInterface( const IotNetworkInterface_t * pNetworkInterface );
+
+/**
+ * @brief Replace the schedule and restart it at the next connection
+ * attempt. `pPhases` must stay valid and start with a phase at 0 ms.
+ */
+    void IotDemoFault_SetSchedule( const IotDemoFaultPhase_t * pPhases,
+                                   size_t phaseCount,
+                                   uint32_t seed );
+
+/**
+ * @brief Copy the statistics.
+ */
+    void IotDemoFault_GetStats( IotDemoFaultStats_t * pStats );
+
+/**
+ * @brief Log the statistics.
+ */
+    void IotDemoFault_Print( void );
+
+/**
+ * @brief Count a message produced; `queued` is false if it was dropped.
+ */
+    void IotDemoFault_ReadingProduced( bool queued );
+
+/**
+ * @brief Count a PUBLISH accepted by the MQTT library; `again` when it
+ * repeats one that failed.
+ */
+    void IotDemoFault_ReadingPublished( bool again );
+
+/**
+ * @brief Count a reading the broker acknowledged.
+ */
+    void IotDemoFault_ReadingAcked( void );
+
+#else /* if IOT_DEMO_MQTT_FAULT_INJECTION == 1 */
+
+    #define IotDemoFault_WrapInterface( pNetworkInterface )    ( pNetworkInterface )
+    #define IotDemoFault_Print()
+    #define IotDemoFault_ReadingProduced( queued )
+    #define IotDemoFault_ReadingPublished( again )
+    #define IotDemoFault_ReadingAcked()
+
+#endif /* if IOT_DEMO_MQTT_FAULT_INJECTION == 1 */
+
+#endif /* ifndef IOT_DEMO_FAULT_H_ */
@@ -0,0 +1,409 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_latency.c
+ * @brief Per-stage latency of every message, from sensor sample to PUBACK.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_latency.h"
+
+#if IOT_DEMO_MQTT_LATENCY == 1
+
+/* Standard includes. */
+    #include <stdio.h>
+    #include <string.h>
+
+/* Set up logging for this demo. */
+    #include "iot_demo_logging.h"
+
+    #include "esp_attr.h"
+    #include "esp_timer.h"
+
+/**
+ * @brief Histogram: 8 linear buckets per power of two microseconds, about
+ * 12% resolution up to an hour.
+ */
+    #define HISTOGRAM_SUB_BITS    ( 3 )
+    #define HISTOGRAM_SUB         ( 1 << HISTOGRAM_SUB_BITS )
+    #define HISTOGRAM_BUCKETS     ( 30 * HISTOGRAM_SUB )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Counters of one stage. Updated with atomic operations only.
+ */
+    typedef struct _stageHistogram
+    {
+        uint32_t maxUs;
+        uint32_t buckets[ HISTOGRAM_BUCKETS ];
+    } _stageHistogram_t;
+
+/**
+ * @brief Stamps of a publish awaiting its PUBACK.
+ *
+ * Written by the demo task only while `tag` is 0. `tag` is then set to the
+ * publish number plus one, and the completion callback claims the slot by
+ * swapping it back to 0.
+ */
+    typedef struct _inflight
+    {
+        uint32_t tag;
+        uint32_t traceId;
+        uint32_t sampleUs;
+        uint32_t enqueueUs;
+        uint32_t dequeueUs;
+        uint32_t serializedUs;
+        uint32_t publishUs;
+    } _inflight_t;
+
+    static const char * const _stageNames[ IOT_DEMO_LATENCY_STAGE_COUNT ] =
+    {
+        "sample",
+        "queue",
+        "serialize",
+        "publish",
+        "ack",
+        "total"
+    };
+
+    static _stageHistogram_t _stages[ IOT_DEMO_LATENCY_STAGE_COUNT ] = { { 0 } };
+
+    static _inflight_t _inflight[ IOT_DEMO_LATENCY_MAX_INFLIGHT ] = { { 0 } };
+
+    static uint32_t _nextTraceId = 0;
+
+/*-----------------------------------------------------------*/
+
+    static inline uint32_t _nowUs( void )
+    {
+        return ( uint32_t ) esp_timer_get_time();
+    }
+
+/*-----------------------------------------------------------*/
+
+    static inline _inflight_t * _slot( intptr_t publishCount )
+    {
+        return &( _inflight[ ( size_t ) publishCount % IOT_DEMO_LATENCY_MAX_INFLIGHT ] );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t _histogramIndex( uint32_t value )
+    {
+        int msb = 0;
+        size_t index = 0;
+
+        if( value < HISTOGRAM_SUB )
+        {
+            return ( size_t ) value;
+        }
+
+        msb = 31 - __builtin_clz( value );
+        index = ( size_t ) ( msb - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB +
+                ( ( value >> ( msb - HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB - 1 ) );
+
+        return ( index < HISTOGRAM_BUCKETS ) ? index : HISTOGRAM_BUCKETS - 1;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Upper bound of a histogram bucket.
+ */
+    static uint32_t _histogramValue( size_t index )
+    {
+        size_t shift = 0;
+
+        if( index < HISTOGRAM_SUB )
+        {
+            return ( uint32_t ) index;
+        }
+
+        shift = index / HISTOGRAM_SUB - 1;
+
+        return ( ( ( uint32_t ) HISTOGRAM_SUB + index % HISTOGRAM_SUB + 1 ) << shift ) - 1;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _record( IotDemoLatencyStage_t stage,
+                         uint32_t latencyUs )
+    {
+        _stageHistogram_t * pStage = &( _stages[ stage ] );
+        uint32_t maxUs = __atomic_load_n( &( pStage->maxUs ), __ATOMIC_RELAXED );
+
+        ( void ) __atomic_add_fetch( &( pStage->buckets[ _histogramIndex( latencyUs ) ] ), 1, __ATOMIC_RELAXED );
+
+        while( ( latencyUs > maxUs ) &&
+               ( __atomic_compare_exchange_n( &( pStage->maxUs ), &maxUs, latencyUs,
+                                              false, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) == false ) )
+        {
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IRAM_ATTR IotDemoLatency_Sampled( IotDemoLatencyStamp_t * pStamp )
+    {
+        pStamp->sampleUs = _nowUs();
+        pStamp->enqueueUs = pStamp->sampleUs;
+        pStamp->traceId = __atomic_fetch_add( &_nextTraceId, 1, __ATOMIC_RELAXED );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IRAM_ATTR IotDemoLatency_Enqueued( IotDemoLatencyStamp_t * pStamp )
+    {
+        pStamp->enqueueUs = _nowUs();
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Dequeued( intptr_t publishCount,
+                                  const IotDemoLatencyStamp_t * pStamp )
+    {
+        _inflight_t * pSlot = _slot( publishCount );
+
+        /* A publish that has waited longer than the table allows loses its
+         * slot and will not be timed to its PUBACK. */
+        ( void ) __atomic_exchange_n( &( pSlot->tag ), 0, __ATOMIC_ACQ_REL );
+
+        pSlot->traceId = pStamp->traceId;
+        pSlot->sampleUs = pStamp->sampleUs;
+        pSlot->enqueueUs = pStamp->enqueueUs;
+        pSlot->dequeueUs = _nowUs();
+
+        _record( IOT_DEMO_LATENCY_SAMPLE, pSlot->enqueueUs - pSlot->sampleUs );
+        _record( IOT_DEMO_LATENCY_QUEUE, pSlot->dequeueUs - pSlot->enqueueUs );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Serialized( intptr_t publishCount )
+    {
+        _inflight_t * pSlot = _slot( publishCount );
+
+        pSlot->serializedUs = _nowUs();
+
+        _record( IOT_DEMO_LATENCY_SERIALIZE, pSlot->serializedUs - pSlot->dequeueUs );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Publishing( intptr_t publishCount )
+    {
+        _inflight_t * pSlot = _slot( publishCount );
+
+        pSlot->publishUs = _nowUs();
+
+        /* From here on the completion callback may claim the slot. */
+        __atomic_store_n( &( pSlot->tag ), ( uint32_t ) publishCount + 1, __ATOMIC_RELEASE );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Published( intptr_t publishCount )
+    {
+        /* Only the demo task writes publishUs, so it can be read whether or
+         * not the PUBACK already arrived. */
+        _record( IOT_DEMO_LATENCY_PUBLISH, _nowUs() - _slot( publishCount )->publishUs );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Completed( intptr_t publishCount,
+                                   bool success )
+    {
+        _inflight_t * pSlot = _slot( publishCount );
+        _inflight_t record = { 0 };
+        uint32_t tag = ( uint32_t ) publishCount + 1;
+        uint32_t nowUs = _nowUs();
+
+        if( __atomic_load_n( &( pSlot->tag ), __ATOMIC_ACQUIRE ) != tag )
+        {
+            return;
+        }
+
+        record = *pSlot;
+
+        /* The copy is only valid if the slot was not reused meanwhile. */
+        if( __atomic_compare_exchange_n( &( pSlot->tag ), &tag, 0,
+                                         false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) == false )
+        {
+            return;
+        }
+
+        if( success == false )
+        {
+            return;
+        }
+
+        _record( IOT_DEMO_LATENCY_ACK, nowUs - record.publishUs );
+        _record( IOT_DEMO_LATENCY_TOTAL, nowUs - record.sampleUs );
+
+        IotLogDebug( "Trace %lu: sample %lu, queue %lu, serialize %lu, ack %lu, total %lu us.",
+                     ( unsigned long ) record.traceId,
+                     ( unsigned long ) ( record.enqueueUs - record.sampleUs ),
+                     ( unsigned long ) ( record.dequeueUs - record.enqueueUs ),
+                     ( unsigned long ) ( record.serializedUs - record.dequeueUs ),
+                     ( unsigned long ) ( nowUs - record.publishUs ),
+                     ( unsigned long ) ( nowUs - record.sampleUs ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    #if IOT_DEMO_LATENCY_TRACE_ID == 1
+
+        int IotDemoLatency_TagPayload( char * pPayload,
+                                       size_t bufferLength,
+                                       int payloadLength,
+                                       const IotDemoLatencyStamp_t * pStamp )
+        {
+            int status = 0;
+
+            /* Reopen the JSON object to add the ID as its last key. */
+            if( ( payloadLength < 2 ) || ( pPayload[ payloadLength - 1 ] != '}' ) )
+            {
+                return payloadLength;
+            }
+
+            status = snprintf( pPayload + payloadLength - 1,
+                               bufferLength - ( size_t ) payloadLength + 1,
+                               ",\"TraceId\":%lu}",
+                               ( unsigned long ) pStamp->traceId );
+
+            if( ( status < 0 ) || ( ( size_t ) status >= bufferLength - ( size_t ) payloadLength + 1 ) )
+            {
+                return -1;
+            }
+
+            return payloadLength - 1 + status;
+        }
+
+    #endif
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_GetSummary( IotDemoLatencyStage_t stage,
+                                    IotDemoLatencySummary_t * pSummary )
+    {
+        const _stageHistogram_t * pStage = &( _stages[ stage ] );
+        uint32_t counts[ 3 ] = { 0 }, perMille[ 3 ] = { 500, 900, 990 };
+        uint32_t * pPercentiles[ 3 ] = { &( pSummary->p50Us ), &( pSummary->p90Us ), &( pSummary->p99Us ) };
+        uint32_t total = 0, seen = 0;
+        size_t i = 0, p = 0;
+
+        ( void ) memset( pSummary, 0x00, sizeof( IotDemoLatencySummary_t ) );
+
+        /* The buckets may be updated while they are read, so the total is
+         * taken from the same reads as the percentiles. */
+        for( i = 0; i < HISTOGRAM_BUCKETS; i++ )
+        {
+            total += __atomic_load_n( &( pStage->buckets[ i ] ), __ATOMIC_RELAXED );
+        }
+
+        pSummary->count = total;
+        pSummary->maxUs = __atomic_load_n( &( pStage->maxUs ), __ATOMIC_RELAXED );
+
+        if( total == 0 )
+        {
+            return;
+        }
+
+        for( p = 0; p < 3; p++ )
+        {
+            counts[ p ] = ( uint32_t ) ( ( ( uint64_t ) total * perMille[ p ] + 999 ) / 1000 );
+        }
+
+        for( i = 0, p = 0; ( i < HISTOGRAM_BUCKETS ) && ( p < 3 ); i++ )
+        {
+            seen += __atomic_load_n( &( pStage->buckets[ i ] ), __ATOMIC_RELAXED );
+
+            while( ( p < 3 ) && ( seen >= counts[ p ] ) )
+            {
+                /* A bucket's upper bound can exceed the largest value seen. */
+                *pPercentiles[ p++ ] = ( _histogramValue( i ) < pSummary->maxUs ) ?
+                                       _histogramValue( i ) : pSummary->maxUs;
+            }
+        }
+
+        /* Updates between the two passes can leave the top percentiles
+         * unreached; the maximum bounds them. */
+        while( p < 3 )
+        {
+            *pPercentiles[ p++ ] = pSummary->maxUs;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Print( void )
+    {
+        IotDemoLatencySummary_t summary = { 0 };
+        size_t i = 0;
+
+        printf( "{\"latency_us\":{" );
+
+        for( i = 0; i < IOT_DEMO_LATENCY_STAGE_COUNT; i++ )
+        {
+            IotDemoLatency_GetSummary( ( IotDemoLatencyStage_t ) i, &summary );
+
+            printf( "%s\"%s\":{\"n\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}",
+                    ( i == 0 ) ? "" : ",",
+                    _stageNames[ i ],
+                    ( unsigned long ) summary.count,
+                    ( unsigned long ) summary.p50Us,
+                    ( unsigned long ) summary.p90Us,
+                    ( unsigned long ) summary.p99Us,
+                    ( unsigned long ) summary.maxUs );
+        }
+
+        printf( "}}\n" );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoLatency_Reset( void )
+    {
+        size_t i = 0, j = 0;
+
+        for( i = 0; i < IOT_DEMO_LATENCY_STAGE_COUNT; i++ )
+        {
+            for( j = 0; j < HISTOGRAM_BUCKETS; j++ )
+            {
+                __atomic_store_n( &( _stages[ i ].buckets[ j ] ), 0, __ATOMIC_RELAXED );
+            }
+
+            __atomic_store_n( &( _stages[ i ].maxUs ), 0, __ATOMIC_RELAXED );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if IOT_DEMO_MQTT_LATENCY == 1 */
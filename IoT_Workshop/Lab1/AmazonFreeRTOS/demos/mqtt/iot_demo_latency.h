@@ -0,0 +1,241 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_latency.h
+ * @brief Per-stage latency of every message, from sensor sample to PUBACK.
+ *
+ * With `IOT_DEMO_MQTT_LATENCY` set to 1 in iot_config.h, each message of the
+ * MQTT demo is stamped when the sensor read returns, when it is queued, when
+ * the demo task takes it off the queue, when its payload is formatted, and
+ * around the call to `IotMqtt_Publish`. The completion callback closes the
+ * record when the PUBACK arrives. Each interval goes into a fixed-size
+ * histogram updated with atomic increments, so any task can read them while
+ * the pipeline runs. #IotDemoLatency_Print prints the percentiles as one
+ * JSON line, and the demo calls it every `IOT_DEMO_LATENCY_REPORT_EVERY`
+ * publishes.
+ *
+ * With `IOT_DEMO_LATENCY_TRACE_ID` also set to 1, each payload carries a
+ * `"TraceId"` key. The same ID is logged with the message's stage times at
+ * debug level, so cloud-side receive times can be joined to them.
+ *
+ * With latency tracing disabled every hook compiles to nothing.
+ */
+
+#ifndef IOT_DEMO_LATENCY_H_
+#define IOT_DEMO_LATENCY_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set to 1 to measure the latency of every message.
+ */
+#ifndef IOT_DEMO_MQTT_LATENCY
+    #define IOT_DEMO_MQTT_LATENCY    ( 0 )
+#endif
+
+/**
+ * @brief Set to 1 to add a trace ID to every payload.
+ */
+#ifndef IOT_DEMO_LATENCY_TRACE_ID
+    #define IOT_DEMO_LATENCY_TRACE_ID    ( 0 )
+#endif
+
+#if ( IOT_DEMO_LATENCY_TRACE_ID == 1 ) && ( IOT_DEMO_MQTT_LATENCY == 0 )
+    #error "IOT_DEMO_LATENCY_TRACE_ID requires IOT_DEMO_MQTT_LATENCY."
+#endif
+
+/**
+ * @brief Intervals measured for every message.
+ */
+typedef enum IotDemoLatencyStage
+{
+    IOT_DEMO_LATENCY_SAMPLE = 0, /**< Sensor read returned to queued. */
+    IOT_DEMO_LATENCY_QUEUE,      /**< Queued to taken by the demo task. */
+    IOT_DEMO_LATENCY_SERIALIZE,  /**< Taken to payload formatted. */
+    IOT_DEMO_LATENCY_PUBLISH,    /**< `IotMqtt_Publish`, up to its return. */
+    IOT_DEMO_LATENCY_ACK,        /**< `IotMqtt_Publish` called to PUBACK. */
+    IOT_DEMO_LATENCY_TOTAL,      /**< Sensor read returned to PUBACK. */
+    IOT_DEMO_LATENCY_STAGE_COUNT
+} IotDemoLatencyStage_t;
+
+/**
+ * @brief Times carried by a message through the queue, in microseconds
+ * since boot modulo 2^32.
+ */
+typedef struct IotDemoLatencyStamp
+{
+    uint32_t sampleUs;
+    uint32_t enqueueUs;
+    uint32_t traceId;
+} IotDemoLatencyStamp_t;
+
+/**
+ * @brief Percentiles of one stage.
+ */
+typedef struct IotDemoLatencySummary
+{
+    uint32_t count;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+} IotDemoLatencySummary_t;
+
+#if IOT_DEMO_MQTT_LATENCY == 1
+
+/**
+ * @brief Publishes whose stamps are kept until their PUBACK. A publish
+ * still unacknowledged after this many more is not timed to its PUBACK.
+ */
+    #ifndef IOT_DEMO_LATENCY_MAX_INFLIGHT
+        #define IOT_DEMO_LATENCY_MAX_INFLIGHT    ( 32 )
+    #endif
+
+/**
+ * @brief Publishes between two reports, 0 for none.
+ */
+    #ifndef IOT_DEMO_LATENCY_REPORT_EVERY
+        #define IOT_DEMO_LATENCY_REPORT_EVERY    ( 100 )
+    #endif
+
+/**
+ * @brief Stamp a message whose sensor read just returned. Safe to call from
+ * an interrupt.
+ */
+    void IotDemoLatency_Sampled( IotDemoLatencyStamp_t * pStamp );
+
+/**
+ * @brief Stamp a message about to be queued. Safe to call from an
+ * interrupt.
+ */
+    void IotDemoLatency_Enqueued( IotDemoLatencyStamp_t * pStamp );
+
+/**
+ * @brief Note that the demo task took a message off the queue and will
+ * publish it with number `publishCount`.
+ */
+    void IotDemoLatency_Dequeued( intptr_t publishCount,
+                                  const IotDemoLatencyStamp_t * pStamp );
+
+/**
+ * @brief Note that the payload of publish `publishCount` is formatted.
+ */
+    void IotDemoLatency_Serialized( intptr_t publishCount );
+
+/**
+ * @brief Note that publish `publishCount` is about to be handed to the MQTT
+ * library. Its PUBACK may arrive before `IotMqtt_Publish` returns.
+ */
+    void IotDemoLatency_Publishing( intptr_t publishCount );
+
+/**
+ * @brief Note that `IotMqtt_Publish` returned for publish `publishCount`.
+ */
+    void IotDemoLatency_Published( intptr_t publishCount );
+
+/**
+ * @brief Note the completion of publish `publishCount`. Only successful
+ * completions are timed.
+ */
+    void IotDemoLatency_Completed( intptr_t publishCount,
+                                   bool success );
+
+/**
+ * @brief Read the percentiles of a stage. Safe to call from any task.
+ */
+    void IotDemoLatency_GetSummary( IotDemoLatencyStage_t stage,
+                                    IotDemoLatencySummary_t * pSummary );
+
+/**
+ * @brief Print the percentiles of every stage as one JSON line.
+ */
+    void IotDemoLatency_Print( void );
+
+/**
+ * @brief Clear the histograms.
+ */
+    void IotDemoLatency_Reset( void );
+
+/**
+ * @brief Print if `publishCount` completes a report interval.
+ */
+    #if IOT_DEMO_LATENCY_REPORT_EVERY > 0
+        #define IotDemoLatency_Report( publishCount )                                 \
+    do {                                                                              \
+        if( ( ( publishCount ) + 1 ) % IOT_DEMO_LATENCY_REPORT_EVERY == 0 )           \
+        {                                                                             \
+            IotDemoLatency_Print();                                                   \
+        }                                                                             \
+    } while( 0 )
+    #else
+        #define IotDemoLatency_Report( publishCount )
+    #endif
+
+#else /* if IOT_DEMO_MQTT_LATENCY == 1 */
+
+    #define IotDemoLatency_Sampled( pStamp )
+    #define IotDemoLatency_Enqueued( pStamp )
+    #define IotDemoLatency_Dequeued( publishCount, pStamp )
+    #define IotDemoLatency_Serialized( publishCount )
+    #define IotDemoLatency_Publishing( publishCount )
+    #define IotDemoLatency_Published( publishCount )
+    #define IotDemoLatency_Completed( publishCount, success )
+    #define IotDemoLatency_Report( publishCount )
+    #define IotDemoLatency_Print()
+
+#endif /* if IOT_DEMO_MQTT_LATENCY == 1 */
+
+#if IOT_DEMO_LATENCY_TRACE_ID == 1
+
+/**
+ * @brief Room taken by the trace ID in a payload.
+ */
+    #define IOT_DEMO_LATENCY_PAYLOAD_EXTRA    ( sizeof( ",\"TraceId\":4294967295" ) - 1 )
+
+/**
+ * @brief Append the trace ID to a JSON object payload.
+ *
+ * @return The new payload length, or a negative value if it does not fit.
+ */
+    int IotDemoLatency_TagPayload( char * pPayload,
+                                   size_t bufferLength,
+                                   int payloadLength,
+                                   const IotDemoLatencyStamp_t * pStamp );
+
+#else
+
+    #define IOT_DEMO_LATENCY_PAYLOAD_EXTRA    ( 0 )
+    #define IotDemoLatency_TagPayload( pPayload, bufferLength, payloadLength, pStamp )    ( payloadLength )
+
+#endif
+
+#endif /* ifndef IOT_DEMO_LATENCY_H_ */
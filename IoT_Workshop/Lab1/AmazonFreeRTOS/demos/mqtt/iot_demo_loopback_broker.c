@@ -0,0 +1,603 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_loopback_broker.c
+ * @brief An in-process MQTT broker stand-in behind the network interface.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* Set up logging for this demo. */
+#include "iot_demo_logging.h"
+
+/* Platform layer includes. */
+#include "platform/iot_network_freertos.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+#include "iot_demo_loopback_broker.h"
+#include "iot_demo_bench.h"
+
+#if IOT_DEMO_LOOPBACK_BROKER_TLS == 1
+    #include "mbedtls/gcm.h"
+#endif
+
+/**
+ * @brief MQTT control packet types handled by the stand-in.
+ */
+#define MQTT_PACKET_CONNECT        ( 1 )
+#define MQTT_PACKET_PUBLISH        ( 3 )
+#define MQTT_PACKET_SUBSCRIBE      ( 8 )
+#define MQTT_PACKET_UNSUBSCRIBE    ( 10 )
+#define MQTT_PACKET_PINGREQ        ( 12 )
+
+/**
+ * @brief Longest response: a SUBACK for this many topic filters.
+ */
+#define MAX_SUBACK_FILTERS         ( 8 )
+
+/**
+ * @brief Bytes added to every TLS 1.2 record with AES-GCM: the record
+ * header, the explicit nonce and the tag.
+ */
+#define TLS_RECORD_OVERHEAD        ( 5 + 8 + 16 )
+
+/**
+ * @brief Bytes added to every TCP segment: IPv4 and TCP headers without
+ * options.
+ */
+#define TCP_IP_OVERHEAD            ( 20 + 20 )
+
+/**
+ * @brief Bytes sealed per call of mbedTLS; a multiple of the AES block.
+ */
+#define SEAL_CHUNK_SIZE            ( 256 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The one connection of the stand-in.
+ */
+typedef struct _loopbackConnection
+{
+    StreamBufferHandle_t responses;    /**< Bytes waiting to be received. */
+    SemaphoreHandle_t sendMutex;       /**< Serializes writers of #responses. */
+    SemaphoreHandle_t taskExited;      /**< Given by the receive task when it ends. */
+    TaskHandle_t receiveTask;
+    IotNetworkReceiveCallback_t receiveCallback;
+    void * pCallbackContext;
+    volatile bool closed;
+} _loopbackConnection_t;
+
+static _loopbackConnection_t _connection = { 0 };
+
+static IotDemoLoopbackBrokerStats_t _stats = { 0 };
+
+#if IOT_DEMO_LOOPBACK_BROKER_TLS == 1
+    static mbedtls_gcm_context _gcm;
+    static bool _gcmReady = false;
+    static uint64_t _recordSequence = 0;
+
+/* Any key will do; only the work of using it counts. */
+    static const uint8_t _key[ 16 ] = { 0 };
+#endif
+
+static const IotNetworkServerInfo_t _serverInfo =
+{
+    .pHostName = "loopback",
+    .port      = 1883
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Bytes one send would take on the wire.
+ */
+static uint32_t _wireBytes( size_t messageLength )
+{
+    size_t records = ( messageLength + IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE - 1 ) /
+                     IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE;
+    size_t tlsLength = messageLength + records * TLS_RECORD_OVERHEAD;
+    size_t segments = ( tlsLength + IOT_DEMO_LOOPBACK_BROKER_TCP_MSS - 1 ) / IOT_DEMO_LOOPBACK_BROKER_TCP_MSS;
+
+    return ( uint32_t ) ( tlsLength + segments * TCP_IP_OVERHEAD );
+}
+
+/*-----------------------------------------------------------*/
+
+#if IOT_DEMO_LOOPBACK_BROKER_TLS == 1
+
+/**
+ * @brief Encrypt and authenticate one send as TLS 1.2 application data
+ * records. The result is thrown away; only the work counts.
+ */
+    static void _sealRecords( const uint8_t * pMessage,
+                              size_t messageLength )
+    {
+        uint8_t iv[ 12 ] = { 0 }, additional[ 13 ] = { 0 }, tag[ 16 ];
+        uint8_t sealed[ SEAL_CHUNK_SIZE ];
+        size_t offset = 0, recordLength = 0, recordOffset = 0, chunk = 0;
+
+        for( offset = 0; offset < messageLength; offset += recordLength )
+        {
+            recordLength = messageLength - offset;
+
+            if( recordLength > IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE )
+            {
+                recordLength = IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE;
+            }
+
+            /* Nonce and additional data as TLS builds them: the sequence
+             * number, then the record type, version and length. */
+            ( void ) memcpy( &( iv[ 4 ] ), &_recordSequence, 8 );
+            ( void ) memcpy( additional, &_recordSequence, 8 );
+            additional[ 8 ] = 23;
+            additional[ 9 ] = 3;
+            additional[ 10 ] = 3;
+            additional[ 11 ] = ( uint8_t ) ( recordLength >> 8 );
+            additional[ 12 ] = ( uint8_t ) ( recordLength & 0xFF );
+            _recordSequence++;
+
+            ( void ) mbedtls_gcm_starts( &_gcm, MBEDTLS_GCM_ENCRYPT, iv, sizeof( iv ),
+                                         additional, sizeof( additional ) );
+
+            for( recordOffset = 0; recordOffset < recordLength; recordOffset += chunk )
+            {
+                chunk = recordLength - recordOffset;
+
+                if( chunk > SEAL_CHUNK_SIZE )
+                {
+                    chunk = SEAL_CHUNK_SIZE;
+                }
+
+                ( void ) mbedtls_gcm_update( &_gcm, chunk, pMessage + offset + recordOffset, sealed );
+            }
+
+            ( void ) mbedtls_gcm_finish( &_gcm, tag, sizeof( tag ) );
+        }
+    }
+
+#endif /* if IOT_DEMO_LOOPBACK_BROKER_TLS == 1 */
+
+/*-----------------------------------------------------------*/
+
+static void _receiveTask( void * pArgument )
+{
+    _loopbackConnection_t * pConnection = ( _loopbackConnection_t * ) pArgument;
+    size_t available = 0;
+
+    while( pConnection->closed == false )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        /* The MQTT library reads one packet per call of the callback. */
+        available = xStreamBufferBytesAvailable( pConnection->responses );
+
+        while( ( available > 0 ) &&
+               ( pConnection->closed == false ) &&
+               ( pConnection->receiveCallback != NULL ) )
+        {
+            pConnection->receiveCallback( pConnection, pConnection->pCallbackContext );
+
+            /* Stop if the library did not consume anything. */
+            if( xStreamBufferBytesAvailable( pConnection->responses ) == available )
+            {
+                break;
+            }
+
+            available = xStreamBufferBytesAvailable( pConnection->responses );
+        }
+    }
+
+    xSemaphoreGive( pConnection->taskExited );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _respond( _loopbackConnection_t * pConnection,
+                      const uint8_t * pResponse,
+                      size_t responseLength )
+{
+    if( xStreamBufferSend( pConnection->responses,
+                           pResponse,
+                           responseLength,
+                           0 ) == responseLength )
+    {
+        _stats.responses++;
+    }
+    else
+    {
+        _stats.overflows++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Answer one packet received from the MQTT library.
+ *
+ * @return `false` if the packet is malformed.
+ */
+static bool _handlePacket( _loopbackConnection_t * pConnection,
+                           const uint8_t * pPacket,
+                           size_t headerLength,
+                           size_t remainingLength )
+{
+    const uint8_t * pBody = pPacket + headerLength;
+    uint8_t response[ 4 + MAX_SUBACK_FILTERS ] = { 0 };
+    size_t offset = 0, topicLength = 0, filters = 0;
+
+    switch( pPacket[ 0 ] >> 4 )
+    {
+        case MQTT_PACKET_CONNECT:
+            response[ 0 ] = 0x20;
+            response[ 1 ] = 2;
+            _respond( pConnection, response, 4 );
+            break;
+
+        case MQTT_PACKET_PUBLISH:
+            _stats.publishes++;
+            _stats.publishBytes += ( uint32_t ) ( headerLength + remainingLength );
+
+            /* Only QoS 1 is acknowledged; the library does not send QoS 2. */
+            if( ( ( pPacket[ 0 ] >> 1 ) & 0x03 ) == 1 )
+            {
+                if( remainingLength < 2 )
+                {
+                    return false;
+                }
+
+                topicLength = ( ( size_t ) pBody[ 0 ] << 8 ) | pBody[ 1 ];
+
+                if( remainingLength < topicLength + 4 )
+                {
+                    return false;
+                }
+
+                response[ 0 ] = 0x40;
+                response[ 1 ] = 2;
+                response[ 2 ] = pBody[ 2 + topicLength ];
+                response[ 3 ] = pBody[ 3 + topicLength ];
+                _respond( pConnection, response, 4 );
+            }
+
+            break;
+
+        case MQTT_PACKET_SUBSCRIBE:
+
+            if( remainingLength < 2 )
+            {
+                return false;
+            }
+
+            /* Grant every filter at most QoS 1. */
+            for( offset = 2; offset < remainingLength; filters++ )
+            {
+                if( ( offset + 2 > remainingLength ) || ( filters == MAX_SUBACK_FILTERS ) )
+                {
+                    return false;
+                }
+
+                topicLength = ( ( size_t ) pBody[ offset ] << 8 ) | pBody[ offset + 1 ];
+                offset += 2 + topicLength;
+
+                if( offset >= remainingLength )
+                {
+                    return false;
+                }
+
+                response[ 4 + filters ] = ( pBody[ offset ] > 1 ) ? 1 : pBody[ offset ];
+                offset++;
+            }
+
+            response[ 0 ] = 0x90;
+            response[ 1 ] = ( uint8_t ) ( 2 + filters );
+            response[ 2 ] = pBody[ 0 ];
+            response[ 3 ] = pBody[ 1 ];
+            _respond( pConnection, response, 4 + filters );
+            break;
+
+        case MQTT_PACKET_UNSUBSCRIBE:
+
+            if( remainingLength < 2 )
+            {
+                return false;
+            }
+
+            response[ 0 ] = 0xB0;
+            response[ 1 ] = 2;
+            response[ 2 ] = pBody[ 0 ];
+            response[ 3 ] = pBody[ 1 ];
+            _respond( pConnection, response, 4 );
+            break;
+
+        case MQTT_PACKET_PINGREQ:
+            response[ 0 ] = 0xD0;
+            _respond( pConnection, response, 2 );
+            break;
+
+        default:
+
+            /* DISCONNECT and acknowledgements of incoming PUBLISHes need no
+             * answer. */
+            break;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _create( void * pConnectionInfo,
+                                  void * pCredentialInfo,
+                                  void ** pConnection )
+{
+    _loopbackConnection_t * pNewConnection = &_connection;
+
+    ( void ) pConnectionInfo;
+    ( void ) pCredentialInfo;
+
+    #if IOT_DEMO_LOOPBACK_BROKER_TLS == 1
+        if( _gcmReady == false )
+        {
+            mbedtls_gcm_init( &_gcm );
+            _gcmReady = ( mbedtls_gcm_setkey( &_gcm, MBEDTLS_CIPHER_ID_AES, _key, 128 ) == 0 );
+
+            if( _gcmReady == false )
+            {
+                IotLogError( "Failed to set up the TLS cost of the loopback broker." );
+
+                return IOT_NETWORK_SYSTEM_ERROR;
+            }
+        }
+    #endif
+
+    if( pNewConnection->responses != NULL )
+    {
+        IotLogError( "The loopback broker supports one connection at a time." );
+
+        return IOT_NETWORK_FAILURE;
+    }
+
+    ( void ) memset( &_stats, 0x00, sizeof( _stats ) );
+    ( void ) memset( pNewConnection, 0x00, sizeof( _loopbackConnection_t ) );
+
+    pNewConnection->responses = xStreamBufferCreate( IOT_DEMO_LOOPBACK_BROKER_BUFFER_SIZE, 1 );
+    pNewConnection->sendMutex = xSemaphoreCreateMutex();
+    pNewConnection->taskExited = xSemaphoreCreateBinary();
+
+    if( ( pNewConnection->responses == NULL ) ||
+        ( pNewConnection->sendMutex == NULL ) ||
+        ( pNewConnection->taskExited == NULL ) ||
+        ( xTaskCreate( _receiveTask,
+                       "LoopbackRx",
+                       IOT_DEMO_LOOPBACK_BROKER_TASK_STACK_SIZE,
+                       pNewConnection,
+                       IOT_DEMO_LOOPBACK_BROKER_TASK_PRIORITY,
+                       &( pNewConnection->receiveTask ) ) != pdPASS ) )
+    {
+        if( pNewConnection->responses != NULL )
+        {
+            vStreamBufferDelete( pNewConnection->responses );
+        }
+
+        if( pNewConnection->sendMutex != NULL )
+        {
+            vSemaphoreDelete( pNewConnection->sendMutex );
+        }
+
+        if( pNewConnection->taskExited != NULL )
+        {
+            vSemaphoreDelete( pNewConnection->taskExited );
+        }
+
+        ( void ) memset( pNewConnection, 0x00, sizeof( _loopbackConnection_t ) );
+
+        return IOT_NETWORK_SYSTEM_ERROR;
+    }
+
+    *pConnection = pNewConnection;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _close( void * pConnection )
+{
+    _loopbackConnection_t * pLoopback = ( _loopbackConnection_t * ) pConnection;
+
+    /* Closed once: by then the receive task may have exited. */
+    if( __atomic_exchange_n( &( pLoopback->closed ), true, __ATOMIC_ACQ_REL ) == false )
+    {
+        xTaskNotifyGive( pLoopback->receiveTask );
+    }
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _send( void * pConnection,
+                     const uint8_t * pMessage,
+                     size_t messageLength )
+{
+    _loopbackConnection_t * pLoopback = ( _loopbackConnection_t * ) pConnection;
+    size_t offset = 0, headerLength = 0, remainingLength = 0, multiplier = 1;
+    bool complete = false;
+    uint32_t startCycles = 0;
+
+    if( pLoopback->closed == true )
+    {
+        return 0;
+    }
+
+    ( void ) xSemaphoreTake( pLoopback->sendMutex, portMAX_DELAY );
+    startCycles = IotDemoBench_Cycles();
+
+    _stats.sends++;
+    _stats.wireBytes += _wireBytes( messageLength );
+
+    #if IOT_DEMO_LOOPBACK_BROKER_TLS == 1
+        _sealRecords( pMessage, messageLength );
+    #endif
+
+    while( offset < messageLength )
+    {
+        /* Decode the fixed header. */
+        headerLength = 1;
+        remainingLength = 0;
+        multiplier = 1;
+        complete = false;
+
+        while( ( offset + headerLength < messageLength ) && ( headerLength <= 4 ) )
+        {
+            remainingLength += ( pMessage[ offset + headerLength ] & 0x7F ) * multiplier;
+            multiplier *= 128;
+
+            if( ( pMessage[ offset + headerLength++ ] & 0x80 ) == 0 )
+            {
+                complete = ( offset + headerLength + remainingLength <= messageLength );
+                break;
+            }
+        }
+
+        if( ( complete == false ) ||
+            ( _handlePacket( pLoopback,
+                             pMessage + offset,
+                             headerLength,
+                             remainingLength ) == false ) )
+        {
+            _stats.malformed++;
+            break;
+        }
+
+        offset += headerLength + remainingLength;
+    }
+
+    IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_SEND, startCycles );
+    ( void ) xSemaphoreGive( pLoopback->sendMutex );
+
+    xTaskNotifyGive( pLoopback->receiveTask );
+
+    /* Everything counts as sent, as it would on a socket. */
+    return messageLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _receive( void * pConnection,
+                        uint8_t * pBuffer,
+                        size_t bytesRequested )
+{
+    _loopbackConnection_t * pLoopback = ( _loopbackConnection_t * ) pConnection;
+    size_t bytesReceived = 0;
+
+    /* Responses are written whole, so a started packet is always complete. */
+    while( ( bytesReceived < bytesRequested ) && ( pLoopback->closed == false ) )
+    {
+        bytesReceived += xStreamBufferReceive( pLoopback->responses,
+                                               pBuffer + bytesReceived,
+                                               bytesRequested - bytesReceived,
+                                               pdMS_TO_TICKS( 100 ) );
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _setReceiveCallback( void * pConnection,
+                                              IotNetworkReceiveCallback_t receiveCallback,
+                                              void * pContext )
+{
+    _loopbackConnection_t * pLoopback = ( _loopbackConnection_t * ) pConnection;
+
+    pLoopback->pCallbackContext = pContext;
+    pLoopback->receiveCallback = receiveCallback;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _destroy( void * pConnection )
+{
+    _loopbackConnection_t * pLoopback = ( _loopbackConnection_t * ) pConnection;
+
+    /* Wait for the receive task to leave the MQTT library. */
+    ( void ) _close( pLoopback );
+    ( void ) xSemaphoreTake( pLoopback->taskExited, portMAX_DELAY );
+
+    vStreamBufferDelete( pLoopback->responses );
+    vSemaphoreDelete( pLoopback->sendMutex );
+    vSemaphoreDelete( pLoopback->taskExited );
+    ( void ) memset( pLoopback, 0x00, sizeof( _loopbackConnection_t ) );
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static const IotNetworkInterface_t _loopbackInterface =
+{
+    .create             = _create,
+    .close              = _close,
+    .send               = _send,
+    .receive            = _receive,
+    .setReceiveCallback = _setReceiveCallback,
+    .destroy            = _destroy
+};
+
+/*-----------------------------------------------------------*/
+
+const IotNetworkInterface_t * IotDemoLoopbackBroker_GetInterface( void )
+{
+    return &_loopbackInterface;
+}
+
+/*-----------------------------------------------------------*/
+
+void * IotDemoLoopbackBroker_GetServerInfo( void )
+{
+    return ( void * ) &_serverInfo;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotDemoLoopbackBroker_GetStats( IotDemoLoopbackBrokerStats_t * pStats )
+{
+    *pStats = _stats;
+}
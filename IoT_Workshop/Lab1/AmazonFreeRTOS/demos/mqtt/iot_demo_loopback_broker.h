@@ -0,0 +1,142 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_loopback_broker.h
+ * @brief An in-process MQTT broker stand-in behind the network interface.
+ *
+ * The interface answers the packets the MQTT library sends as a broker
+ * would (CONNACK, SUBACK, UNSUBACK, PUBACK, PINGRESP) without any network,
+ * so the demo pipeline can be measured without the cost and variance of
+ * Wi-Fi and TLS. A packet must not be split between calls of `send`, which
+ * the MQTT library never does; a call may hold several, as with corking
+ * (iot_demo_cork.h).
+ *
+ * Every call of `send` stands for the TLS records and TCP segments a real
+ * connection would write for it, and the bytes they would take on the wire
+ * are counted. With #IOT_DEMO_LOOPBACK_BROKER_TLS set, each call is also
+ * sealed as those records would be, so that the CPU cost of a send is close
+ * to that of a TLS connection.
+ */
+
+#ifndef IOT_DEMO_LOOPBACK_BROKER_H_
+#define IOT_DEMO_LOOPBACK_BROKER_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* Platform layer includes. */
+#include "platform/iot_network.h"
+
+#include "iot_demo_bench.h"
+
+/**
+ * @brief Set to 1 to run the MQTT demo against the stand-in instead of the
+ * configured broker, as the benchmark always does.
+ */
+#ifndef IOT_DEMO_MQTT_LOOPBACK
+    #define IOT_DEMO_MQTT_LOOPBACK    IOT_DEMO_MQTT_BENCHMARK
+#endif
+
+/**
+ * @brief Bytes of responses buffered for the receive task.
+ */
+#ifndef IOT_DEMO_LOOPBACK_BROKER_BUFFER_SIZE
+    #define IOT_DEMO_LOOPBACK_BROKER_BUFFER_SIZE    ( 1024 )
+#endif
+
+/**
+ * @brief Stack size of the task that delivers responses to the MQTT library.
+ */
+#ifndef IOT_DEMO_LOOPBACK_BROKER_TASK_STACK_SIZE
+    #define IOT_DEMO_LOOPBACK_BROKER_TASK_STACK_SIZE    ( 4096 )
+#endif
+
+#ifndef IOT_DEMO_LOOPBACK_BROKER_TASK_PRIORITY
+    #define IOT_DEMO_LOOPBACK_BROKER_TASK_PRIORITY    ( tskIDLE_PRIORITY + 5 )
+#endif
+
+/**
+ * @brief Set to 1 to encrypt and authenticate every send as TLS records
+ * (AES-128-GCM through mbedTLS), for the CPU cost of a TLS connection.
+ */
+#ifndef IOT_DEMO_LOOPBACK_BROKER_TLS
+    #define IOT_DEMO_LOOPBACK_BROKER_TLS    ( 0 )
+#endif
+
+/**
+ * @brief Largest TLS record payload; mbedTLS's default
+ * MBEDTLS_SSL_MAX_CONTENT_LEN. A longer send is written as several records.
+ */
+#ifndef IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE
+    #define IOT_DEMO_LOOPBACK_BROKER_TLS_RECORD_SIZE    ( 16384 )
+#endif
+
+/**
+ * @brief TCP maximum segment size; lwIP's TCP_MSS on ESP-IDF.
+ */
+#ifndef IOT_DEMO_LOOPBACK_BROKER_TCP_MSS
+    #define IOT_DEMO_LOOPBACK_BROKER_TCP_MSS    ( 1436 )
+#endif
+
+/**
+ * @brief Packet counts of the broker stand-in since the last connection was
+ * created.
+ */
+typedef struct IotDemoLoopbackBrokerStats
+{
+    uint32_t publishes;      /**< PUBLISH packets received. */
+    uint32_t publishBytes;   /**< Bytes of those packets, header included. */
+    uint32_t sends;          /**< Calls of `send`, each its own TLS records. */
+    uint32_t wireBytes;      /**< Bytes those calls would take in TLS records
+                              * and TCP/IPv4 segments, each call starting a
+                              * segment of its own as with Nagle disabled. */
+    uint32_t responses;      /**< Packets sent back. */
+    uint32_t overflows;      /**< Responses lost because the buffer was full. */
+    uint32_t malformed;      /**< Sends that did not hold whole packets. */
+} IotDemoLoopbackBrokerStats_t;
+
+/**
+ * @brief Return the network interface of the broker stand-in.
+ *
+ * Only one connection may exist at a time.
+ */
+const IotNetworkInterface_t * IotDemoLoopbackBroker_GetInterface( void );
+
+/**
+ * @brief Return server information to pass to `create` of the interface,
+ * naming the stand-in for connection metrics and logs.
+ */
+void * IotDemoLoopbackBroker_GetServerInfo( void );
+
+/**
+ * @brief Copy the packet counts of the current or last connection.
+ */
+void IotDemoLoopbackBroker_GetStats( IotDemoLoopbackBrokerStats_t * pStats );
+
+#endif /* ifndef IOT_DEMO_LOOPBACK_BROKER_H_ */
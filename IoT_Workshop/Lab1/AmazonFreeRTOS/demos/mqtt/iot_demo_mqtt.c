@@ -31,6 +31,9 @@
 /* The config header is always included first. */
 #include "iot_config.h"
 
+/* Demo configuration: static allocation and stack budget. */
+#include "aws_demo_config.h"
+
 /* Standard includes. */
 #include <stdbool.h>
 #include <stdio.h>
@@ -49,11 +52,49 @@
 
 #include "driver/gpio.h"
 #include "driver/DHT22.h"
+#include "driver/dlog.h"
+#include "driver/boot_profile.h"
+#include "driver/spsc_ring.h"
+#include "driver/alloc_watch.h"
+#include "driver/stack_budget.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Scheduler trace spans; a no-op unless enabled in FreeRTOSConfig.h. */
+#include "driver/sched_trace.h"
+
+/* Commands on the subscription topics. */
+#include "driver/cmd_dispatch.h"
+#include "driver/topic_router.h"
+#include "driver/rule_engine.h"
+#include "driver/adaptive_period.h"
+#include "driver/stream_stats.h"
+
+/* Connection setup timing, and TLS sessions resumed on reconnect. */
+#include "iot_demo_tls_metrics.h"
+#include "driver/tls_session_cache.h"
+
+/* Pipeline benchmark. */
+#include "iot_demo_bench.h"
+
+/* Input and response recording. */
+#include "iot_demo_trace.h"
+
+/* Network fault injection. */
+#include "iot_demo_fault.h"
 
-#include "freertos/queue.h"
+/* Pre-serialized PUBLISH packets. */
+#include "iot_demo_publish_template.h"
 
-/* JSON utilities include. */
-#include "iot_json_utils.h"
+/* Coalescing of outgoing packets. */
+#include "iot_demo_cork.h"
+
+/* Per-message latency tracing. */
+#include "iot_demo_latency.h"
+
+/* The in-process broker stand-in. */
+#include "iot_demo_loopback_broker.h"
 
 /**
  * @cond DOXYGEN_IGNORE
@@ -70,6 +111,96 @@
 #ifndef IOT_DEMO_MQTT_PUBLISH_BURST_COUNT
     #define IOT_DEMO_MQTT_PUBLISH_BURST_COUNT    ( 10 )
 #endif
+#ifndef IOT_DEMO_MQTT_SENSOR_WARMUP_MS
+    #define IOT_DEMO_MQTT_SENSOR_WARMUP_MS       ( 2000 )
+#endif
+#ifndef IOT_DEMO_MQTT_SAMPLING_CORE
+    #define IOT_DEMO_MQTT_SAMPLING_CORE          ( 1 )
+#endif
+#ifndef IOT_DEMO_MQTT_NETWORK_CORE
+    #define IOT_DEMO_MQTT_NETWORK_CORE           ( 0 )
+#endif
+#ifndef IOT_DEMO_MQTT_SAMPLING_STACK_SIZE
+    #define IOT_DEMO_MQTT_SAMPLING_STACK_SIZE    ( 4096 )
+#endif
+#ifndef IOT_DEMO_MQTT_SAMPLING_PRIORITY
+    #define IOT_DEMO_MQTT_SAMPLING_PRIORITY      ( tskIDLE_PRIORITY + 6 )
+#endif
+#ifndef IOT_DEMO_MQTT_NETWORK_STACK_SIZE
+    #define IOT_DEMO_MQTT_NETWORK_STACK_SIZE     ( configMINIMAL_STACK_SIZE * 8 )
+#endif
+#ifndef IOT_DEMO_MQTT_RING_LENGTH
+    #define IOT_DEMO_MQTT_RING_LENGTH            ( 16 )
+#endif
+#ifndef IOT_DEMO_MQTT_RING_BATCH
+    #define IOT_DEMO_MQTT_RING_BATCH             ( 4 )
+#endif
+#ifndef IOT_DEMO_MQTT_INFLIGHT_LENGTH
+    #define IOT_DEMO_MQTT_INFLIGHT_LENGTH        ( 8 )
+#endif
+#ifndef IOT_DEMO_MQTT_ALLOC_CHECK_PUBLISHES
+    #define IOT_DEMO_MQTT_ALLOC_CHECK_PUBLISHES  ( 20 )
+#endif
+#ifndef IOT_DEMO_MQTT_STACK_BUDGET_PUBLISHES
+    #define IOT_DEMO_MQTT_STACK_BUDGET_PUBLISHES ( 20 )
+#endif
+#ifndef IOT_DEMO_MQTT_STACK_BUDGET_PROBE_SIZE
+    #define IOT_DEMO_MQTT_STACK_BUDGET_PROBE_SIZE    ( 1024 )
+#endif
+#ifndef IOT_DEMO_MQTT_SAMPLE_PERIOD_MS
+    #define IOT_DEMO_MQTT_SAMPLE_PERIOD_MS       ( 3000 )
+#endif
+#ifndef IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS
+    #define IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS   ( 2000 )
+#endif
+#ifndef IOT_DEMO_MQTT_MAX_SAMPLE_PERIOD_MS
+    #define IOT_DEMO_MQTT_MAX_SAMPLE_PERIOD_MS   ( 3600000 )
+#endif
+#ifndef IOT_DEMO_MQTT_DEADBAND_TENTHS
+    #define IOT_DEMO_MQTT_DEADBAND_TENTHS        ( 0 )
+#endif
+#ifndef IOT_DEMO_MQTT_ACK_BUFFER_LENGTH
+    #define IOT_DEMO_MQTT_ACK_BUFFER_LENGTH      ( 256 )
+#endif
+#ifndef IOT_DEMO_MQTT_GROUP
+    #define IOT_DEMO_MQTT_GROUP                  "default"
+#endif
+#ifndef IOT_DEMO_MQTT_RULES
+    #define IOT_DEMO_MQTT_RULES                  "vibration -> led = on"
+#endif
+#ifndef IOT_DEMO_MQTT_VIBRATION_WINDOW_MS
+    #define IOT_DEMO_MQTT_VIBRATION_WINDOW_MS    ( 1000 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE
+    #define IOT_DEMO_MQTT_ADAPTIVE               ( 1 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS
+    #define IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS ( 30000 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS
+    #define IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS        ( 3 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS
+    #define IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS    ( 10 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS
+    #define IOT_DEMO_MQTT_STATS                  ( 1 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_WINDOW
+    #define IOT_DEMO_MQTT_STATS_WINDOW           ( 20 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_Z_THRESHOLD
+    #define IOT_DEMO_MQTT_STATS_Z_THRESHOLD      ( 4.0f )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS
+    #define IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS       ( 2 )
+#endif
+#ifndef IOT_DEMO_MQTT_RECONNECT_LIMIT
+    #define IOT_DEMO_MQTT_RECONNECT_LIMIT        ( 10 )
+#endif
+#ifndef IOT_DEMO_MQTT_RECONNECT_DELAY_MS
+    #define IOT_DEMO_MQTT_RECONNECT_DELAY_MS     ( 2000 )
+#endif
 /** @endcond */
 
 /* Validate MQTT demo configuration settings. */
@@ -79,6 +210,21 @@
 #if IOT_DEMO_MQTT_PUBLISH_BURST_COUNT <= 0
     #error "IOT_DEMO_MQTT_PUBLISH_BURST_COUNT cannot be 0 or negative."
 #endif
+#if ( IOT_DEMO_MQTT_RING_LENGTH & ( IOT_DEMO_MQTT_RING_LENGTH - 1 ) ) != 0
+    #error "IOT_DEMO_MQTT_RING_LENGTH must be a power of two."
+#endif
+#if ( IOT_DEMO_MQTT_SAMPLE_PERIOD_MS < IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS ) || \
+    ( IOT_DEMO_MQTT_SAMPLE_PERIOD_MS > IOT_DEMO_MQTT_MAX_SAMPLE_PERIOD_MS )
+    #error "IOT_DEMO_MQTT_SAMPLE_PERIOD_MS is out of range."
+#endif
+#if democonfigSTATIC_ALLOCATION == 1
+    #if !defined( IOT_STATIC_MEMORY_ONLY ) || ( IOT_STATIC_MEMORY_ONLY == 0 )
+        #error "democonfigSTATIC_ALLOCATION needs IOT_STATIC_MEMORY_ONLY set to 1 in iot_config.h."
+    #endif
+    #if configSUPPORT_STATIC_ALLOCATION == 0
+        #error "democonfigSTATIC_ALLOCATION needs CONFIG_SUPPORT_STATIC_ALLOCATION in menuconfig."
+    #endif
+#endif
 
 /**
  * @brief The first characters in the client identifier. A timestamp is appended
@@ -134,12 +280,12 @@
 /**
  * @brief How many topic filters will be used in this demo.
  */
-#define TOPIC_FILTER_COUNT                       ( 1 )
+#define TOPIC_FILTER_COUNT                       ( 2 )
 
 /**
- * @brief The length of each topic filter.
+ * @brief The length of the demo topic names.
  *
- * For convenience, all topic filters are the same length.
+ * For convenience, the topics published and subscribed to are the same length.
  */
 #define TOPIC_FILTER_LENGTH                      ( ( uint16_t ) ( sizeof( IOT_DEMO_MQTT_TOPIC_PREFIX "/topic/XXX" ) - 1 ) )
 
@@ -157,10 +303,33 @@
                              "\"Detect\":%s"             \
                              "}"
 
+#define PUBLISH_PERIOD_PAYLOAD_FORMAT                    \
+                             "{"                         \
+                             "\"SamplePeriodMs\":%lu"    \
+                             "}"
+
+#define PUBLISH_SUMMARY_PAYLOAD_FORMAT                   \
+                             "{"                         \
+                             "\"Window\":\"%s\","         \
+                             "\"Count\":%lu,"            \
+                             "\"Mean\":%.2f,"            \
+                             "\"Variance\":%.3f,"        \
+                             "\"Min\":%.1f,"             \
+                             "\"Max\":%.1f"              \
+                             "}"
+
+#define PUBLISH_ANOMALY_PAYLOAD_FORMAT                   \
+                             "{"                         \
+                             "\"Anomaly\":\"%s\","        \
+                             "\"Value\":%.1f,"           \
+                             "\"Z\":%.1f"                \
+                             "}"
+
 /**
- * @brief Size of the buffer that holds the PUBLISH messages in this demo.
+ * @brief Size of the buffer that holds the PUBLISH messages in this demo:
+ * a window summary, the longest, with room for the widest numbers.
  */
-#define PUBLISH_PAYLOAD_BUFFER_LENGTH            ( sizeof( PUBLISH_DHT_PAYLOAD_FORMAT ) + 2 )
+#define PUBLISH_PAYLOAD_BUFFER_LENGTH            ( sizeof( PUBLISH_SUMMARY_PAYLOAD_FORMAT ) + 64 + IOT_DEMO_LATENCY_PAYLOAD_EXTRA )
 
 /**
  * @brief The maximum number of times each PUBLISH in this demo will be retried.
@@ -175,21 +344,59 @@
 
 
 /**
- * @brief The JSON key used to represent tokens in a SUBSCRIBE message.
+ * @brief The start of the command topics: "all" for every device,
+ * "group/<IOT_DEMO_MQTT_GROUP>" for the group, and "device/<identifier>"
+ * for this device alone.
+ */
+#define COMMAND_TOPIC_PREFIX                     IOT_DEMO_MQTT_TOPIC_PREFIX "/cmd/"
+
+/**
+ * @brief Longest MQTT client identifier given to the demo that gets a
+ * command topic of its own.
+ */
+#define COMMAND_IDENTIFIER_MAX_LENGTH            ( 128 )
+
+/**
+ * @brief The topic on which commands are acknowledged.
+ */
+#define ACK_TOPIC_NAME                           IOT_DEMO_MQTT_TOPIC_PREFIX "/topic/ack"
+
+/**
+ * @brief The length of #ACK_TOPIC_NAME.
  */
-#define SUBSCRIBE_TOKEN_KEY                      "led"
+#define ACK_TOPIC_NAME_LENGTH                    ( ( uint16_t ) ( sizeof( ACK_TOPIC_NAME ) - 1 ) )
 
 /**
- * @brief The length of #SUBSCRIBE_TOKEN_KEY.
+ * @brief Notification bits of the sampling task.
  */
-#define SUBSCRIBE_TOKEN_KEY_LENGTH               ( sizeof( SUBSCRIBE_TOKEN_KEY ) - 1 )
+#define SAMPLING_NOTIFY_READ                     ( 1UL << 0 ) /* Read the DHT22. */
+#define SAMPLING_NOTIFY_EDGE                     ( 1UL << 1 ) /* Vibration edges are pending. */
+#define SAMPLING_NOTIFY_RULES                    ( 1UL << 2 ) /* New local rules are pending. */
+#define SAMPLING_NOTIFY_START                    ( 1UL << 3 ) /* The task handle is stored. */
 
 /*-----------------------------------------------------------*/
 
-static xQueueHandle xDemoQueue = NULL;
+/* Arguments of RunMqttDemo, passed to the task that runs it on the network
+ * core. */
+typedef struct _demoArguments
+{
+    bool awsIotMqttMode;
+    const char * pIdentifier;
+    void * pNetworkServerInfo;
+    void * pNetworkCredentialInfo;
+    const IotNetworkInterface_t * pNetworkInterface;
+    TaskHandle_t caller;
+    int status;
+} _demoArguments_t;
 
 static const char pcTimerName[] = "DemoTimer";
 TimerHandle_t xRequestTimer = NULL;
+
+/* Takes the first reading once the sensor has warmed up, while the
+ * connection is still being made. */
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+    static TimerHandle_t xWarmupTimer = NULL;
+#endif
 BaseType_t xTimerStarted = pdFALSE;
 
 typedef enum
@@ -197,15 +404,150 @@ typedef enum
     eEventTypeNone,
     eEventTypeGpio,
     eEventTypeTemp,
+    eEventTypePeriod,
+    eEventTypeSummary,
+    eEventTypeAnomaly,
 } DemoEventType_t;
 
+/* Channels of the running statistics, in the order of the rule inputs. */
+enum
+{
+    STATS_CHANNEL_TEMP = 0,
+    STATS_CHANNEL_HUMIDITY,
+    STATS_CHANNEL_COUNT
+};
+
+static const char * const _statsChannels[ STATS_CHANNEL_COUNT ] = { "Temperature", "Humidity" };
+
 typedef struct DemoTaskMessage
 {
     DemoEventType_t type;
     float humidity;
     float temperature;
+    uint32_t periodMs;           /* The new sampling period, for eEventTypePeriod. */
+    uint32_t channel;            /* STATS_CHANNEL_*, for eEventTypeSummary and eEventTypeAnomaly. */
+    StreamStatsSummary_t summary; /* The window closed, in tenths, for eEventTypeSummary. */
+    float zScore;                /* How far the reading is out, for eEventTypeAnomaly. */
+    IotDemoLatencyStamp_t stamp; /* Sample and enqueue times, for latency tracing and the benchmark. */
 } DemoTaskMessage_t;
 
+/* Readings cross from the sampling core to the network core through this
+ * ring. The sampling task (or the benchmark task) is its only producer and
+ * the demo task its only consumer. */
+static SpscRing_t xDemoRing;
+static DemoTaskMessage_t xDemoRingItems[ IOT_DEMO_MQTT_RING_LENGTH ];
+
+/* Readings taken from the ring but not yet published. They are kept across
+ * connections, so that a lost link does not lose them. */
+static DemoTaskMessage_t xDemoBatch[ IOT_DEMO_MQTT_RING_BATCH ];
+static size_t xDemoBatchCount = 0;
+static size_t xDemoBatchNext = 0;
+
+/* Number of the next PUBLISH. It goes on across connections, so that a late
+ * completion from a lost connection is not taken for a new publish. */
+static intptr_t _publishCount = 0;
+
+/* States of an in-flight slot. */
+enum
+{
+    INFLIGHT_FREE = 0,
+    INFLIGHT_SENT,  /* Waiting for the PUBACK. */
+    INFLIGHT_FAILED /* To be published again, as when the connection was lost. */
+};
+
+/* A reading published at QoS 1, kept until its PUBACK. The demo task fills
+ * a free or failed slot; the completion callback frees or fails it. */
+typedef struct _inflight
+{
+    DemoTaskMessage_t message;
+    intptr_t publishCount; /* Of the last PUBLISH of the reading. */
+    uint32_t state;        /* INFLIGHT_*. */
+} _inflight_t;
+
+static _inflight_t _inflight[ IOT_DEMO_MQTT_INFLIGHT_LENGTH ];
+
+/* The producer notifies the consumer after each push. */
+static TaskHandle_t xConsumerTask = NULL;
+
+/* Samples the sensors on IOT_DEMO_MQTT_SAMPLING_CORE. The timers and the
+ * GPIO interrupt only wake it. */
+static TaskHandle_t xSamplingTask = NULL;
+
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+    static uint32_t ulPendingEdges = 0;
+#endif
+
+/* Settings that commands on the subscription topic change at run time.
+ * The MQTT callback writes them, and the local rules write ledOn; the
+ * sampling and demo tasks read them, a word at a time. */
+typedef struct _demoSettings
+{
+    uint32_t ledOn;          /* GPIO13 drives the LED, active low. */
+    uint32_t periodMs;       /* Period of xRequestTimer. */
+    uint32_t batch;          /* Messages gathered in the ring before publishing. */
+    uint32_t deadbandTenths; /* Smallest change of a reading that is published. */
+    uint32_t qos;            /* QoS of the readings. */
+    uint32_t adaptive;       /* The sampling task adapts periodMs to the readings. */
+} _demoSettings_t;
+
+static _demoSettings_t _settings =
+{
+    .ledOn          = 0,
+    .periodMs       = IOT_DEMO_MQTT_SAMPLE_PERIOD_MS,
+    .batch          = 1,
+    .deadbandTenths = IOT_DEMO_MQTT_DEADBAND_TENTHS,
+    .qos            = IOT_MQTT_QOS_1,
+    .adaptive       = IOT_DEMO_MQTT_ADAPTIVE
+};
+
+/* Hands incoming messages to the handlers of their topics. Routes are added
+ * before subscribing; the subscription callback only reads it. */
+static TopicRouter_t _router;
+
+/**
+ * @brief Set when the MQTT connection is lost rather than closed by the
+ * demo, which then connects again.
+ */
+static bool _connectionLost = false;
+
+/* The command topic of this device, which the router refers to. */
+static char _deviceCommandTopic[ sizeof( COMMAND_TOPIC_PREFIX "device/" ) + COMMAND_IDENTIFIER_MAX_LENGTH ];
+
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+
+    /* Inputs of the local rules, in tenths, and the outputs they drive. */
+    enum
+    {
+        RULE_INPUT_TEMP = 0,
+        RULE_INPUT_HUMIDITY,
+        RULE_INPUT_VIBRATION, /* 1 while edges come less than IOT_DEMO_MQTT_VIBRATION_WINDOW_MS apart. */
+        RULE_INPUT_COUNT
+    };
+
+    static const char * const _ruleInputs[ RULE_INPUT_COUNT ] = { "temp", "humidity", "vibration" };
+    static const char * const _ruleOutputs[] = { "led" };
+
+    /* Rules compiled by the MQTT callback, waiting for the sampling task,
+     * which evaluates them, to take them. One update waits at a time. */
+    static RuleProgram_t _pendingRules;
+    static uint32_t _rulesPending = 0;
+    static uint32_t _ruleCount = 0;
+#endif
+
+/* Storage of the tasks and timers above, so that once the demo has started
+ * it does not use the heap. The MQTT library draws on its own static pools
+ * (IOT_STATIC_MEMORY_ONLY). */
+#if democonfigSTATIC_ALLOCATION == 1
+    static StaticTimer_t xRequestTimerBuffer;
+    static StaticTask_t xNetworkTaskBuffer;
+    static StackType_t xNetworkTaskStack[ IOT_DEMO_MQTT_NETWORK_STACK_SIZE ];
+
+    #if IOT_DEMO_MQTT_BENCHMARK == 0
+        static StaticTimer_t xWarmupTimerBuffer;
+        static StaticTask_t xSamplingTaskBuffer;
+        static StackType_t xSamplingTaskStack[ IOT_DEMO_MQTT_SAMPLING_STACK_SIZE ];
+    #endif
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -218,6 +560,104 @@ int RunMqttDemo( bool awsIotMqttMode,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Called by the MQTT library when the connection is closed.
+ *
+ * @param[in] param1 Not used.
+ * @param[in] pDisconnect Why the connection was closed.
+ */
+static void _mqttDisconnectCallback( void * param1,
+                                     IotMqttCallbackParam_t * const pDisconnect )
+{
+    ( void ) param1;
+
+    if( pDisconnect->u.disconnectReason != IOT_MQTT_DISCONNECT_CALLED )
+    {
+        IotLogWarn( "MQTT connection lost." );
+        __atomic_store_n( &_connectionLost, true, __ATOMIC_RELEASE );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Free the in-flight slot of a completed PUBLISH, or mark it to be
+ * published again, and wake the demo task.
+ */
+static void _inflightCompleted( intptr_t publishCount,
+                                bool success )
+{
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( ( __atomic_load_n( &( _inflight[ i ].state ), __ATOMIC_ACQUIRE ) == INFLIGHT_SENT ) &&
+            ( _inflight[ i ].publishCount == publishCount ) )
+        {
+            __atomic_store_n( &( _inflight[ i ].state ),
+                              ( success == true ) ? INFLIGHT_FREE : INFLIGHT_FAILED,
+                              __ATOMIC_RELEASE );
+
+            if( success == true )
+            {
+                IotDemoFault_ReadingAcked();
+            }
+
+            break;
+        }
+    }
+
+    if( xConsumerTask != NULL )
+    {
+        xTaskNotifyGive( xConsumerTask );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The in-flight slot to publish again first, the one published
+ * longest ago, or NULL.
+ */
+static _inflight_t * _nextResend( void )
+{
+    _inflight_t * pOldest = NULL;
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( ( __atomic_load_n( &( _inflight[ i ].state ), __ATOMIC_ACQUIRE ) == INFLIGHT_FAILED ) &&
+            ( ( pOldest == NULL ) || ( _inflight[ i ].publishCount < pOldest->publishCount ) ) )
+        {
+            pOldest = &( _inflight[ i ] );
+        }
+    }
+
+    return pOldest;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A free in-flight slot, or NULL.
+ */
+static _inflight_t * _freeInflight( void )
+{
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( __atomic_load_n( &( _inflight[ i ].state ), __ATOMIC_ACQUIRE ) == INFLIGHT_FREE )
+        {
+            return &( _inflight[ i ] );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Called by the MQTT library when an operation completes.
  *
@@ -235,13 +675,26 @@ static void _operationCompleteCallback( void * param1,
      * logging is disabled. */
     ( void ) publishCount;
 
+    IotDemoBench_Completed( publishCount,
+                            ( pOperation->u.operation.result == IOT_MQTT_SUCCESS ) );
+    IotDemoLatency_Completed( publishCount,
+                              ( pOperation->u.operation.result == IOT_MQTT_SUCCESS ) );
+    IotDemoTrace_Complete( publishCount, ( int ) pOperation->u.operation.result );
+    _inflightCompleted( publishCount, ( pOperation->u.operation.result == IOT_MQTT_SUCCESS ) );
+
+    BootProfile_Mark( "first_ack" );
+    BootProfile_Report();
+
     /* Print the status of the completed operation. A PUBLISH operation is
      * successful when transmitted over the network. */
     if( pOperation->u.operation.result == IOT_MQTT_SUCCESS )
     {
-        IotLogInfo( "MQTT %s %d successfully sent.",
-                    IotMqtt_OperationType( pOperation->u.operation.type ),
-                    ( int ) publishCount );
+        /* A line per message would dominate the benchmark. */
+        #if IOT_DEMO_MQTT_BENCHMARK == 0
+            IotLogInfo( "MQTT %s %d successfully sent.",
+                        IotMqtt_OperationType( pOperation->u.operation.type ),
+                        ( int ) publishCount );
+        #endif
     }
     else
     {
@@ -254,73 +707,449 @@ static void _operationCompleteCallback( void * param1,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Switch the LED, for a command or a local rule.
+ */
+static void _setLed( uint32_t ledOn )
+{
+    __atomic_store_n( &( _settings.ledOn ), ledOn, __ATOMIC_RELAXED );
+    gpio_set_level( GPIO_NUM_13, ( ledOn == 1 ) ? 0 : 1 );
+}
+
+static bool _applyLed( const CmdValue_t * pValue )
+{
+    uint32_t ledOn = 0;
+
+    if( CmdDispatch_IsString( pValue, "on" ) == true )
+    {
+        ledOn = 1;
+    }
+    else if( CmdDispatch_IsString( pValue, "off" ) == false )
+    {
+        return false;
+    }
+
+    _setLed( ledOn );
+
+    return true;
+}
+
+static int _reportLed( char * pBuffer,
+                       size_t length )
+{
+    return snprintf( pBuffer, length, "\"%s\"",
+                     ( __atomic_load_n( &( _settings.ledOn ), __ATOMIC_RELAXED ) == 1 ) ? "on" : "off" );
+}
+
+static bool _applyPeriod( const CmdValue_t * pValue )
+{
+    int32_t periodMs = 0;
+
+    /* The DHT22 cannot be read more often than every 2 seconds. */
+    if( ( CmdDispatch_ToFixed( pValue, 1, &periodMs ) == false ) ||
+        ( periodMs < IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS ) ||
+        ( periodMs > IOT_DEMO_MQTT_MAX_SAMPLE_PERIOD_MS ) )
+    {
+        return false;
+    }
+
+    /* The timer is created with the setting before the subscription is
+     * made. A timer that is not running yet is started by the change, as
+     * the publish loop would do anyway. */
+    if( ( xRequestTimer != NULL ) &&
+        ( xTimerChangePeriod( xRequestTimer, pdMS_TO_TICKS( periodMs ), 0 ) != pdPASS ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( _settings.periodMs ), ( uint32_t ) periodMs, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int _reportPeriod( char * pBuffer,
+                          size_t length )
+{
+    return snprintf( pBuffer, length, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( _settings.periodMs ), __ATOMIC_RELAXED ) );
+}
+
+static bool _applyBatch( const CmdValue_t * pValue )
+{
+    int32_t batch = 0;
+
+    if( ( CmdDispatch_ToFixed( pValue, 1, &batch ) == false ) ||
+        ( batch < 1 ) ||
+        ( batch > IOT_DEMO_MQTT_RING_BATCH ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( _settings.batch ), ( uint32_t ) batch, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int _reportBatch( char * pBuffer,
+                         size_t length )
+{
+    return snprintf( pBuffer, length, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( _settings.batch ), __ATOMIC_RELAXED ) );
+}
+
+static bool _applyDeadband( const CmdValue_t * pValue )
+{
+    int32_t deadbandTenths = 0;
+
+    if( ( CmdDispatch_ToFixed( pValue, 10, &deadbandTenths ) == false ) ||
+        ( deadbandTenths < 0 ) ||
+        ( deadbandTenths > 1000 ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( _settings.deadbandTenths ), ( uint32_t ) deadbandTenths, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int _reportDeadband( char * pBuffer,
+                            size_t length )
+{
+    uint32_t deadbandTenths = __atomic_load_n( &( _settings.deadbandTenths ), __ATOMIC_RELAXED );
+
+    return snprintf( pBuffer, length, "%lu.%lu",
+                     ( unsigned long ) ( deadbandTenths / 10 ),
+                     ( unsigned long ) ( deadbandTenths % 10 ) );
+}
+
+static bool _applyQos( const CmdValue_t * pValue )
+{
+    int32_t qos = 0;
+
+    if( ( CmdDispatch_ToFixed( pValue, 1, &qos ) == false ) ||
+        ( ( qos != IOT_MQTT_QOS_0 ) && ( qos != IOT_MQTT_QOS_1 ) ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( _settings.qos ), ( uint32_t ) qos, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int _reportQos( char * pBuffer,
+                       size_t length )
+{
+    return snprintf( pBuffer, length, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( _settings.qos ), __ATOMIC_RELAXED ) );
+}
+
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+
+    static bool _applyRules( const CmdValue_t * pValue )
+    {
+        size_t errorOffset = 0;
+
+        /* The sampling task has not taken the last rules yet. */
+        if( ( pValue->xType != eCmdValueString ) ||
+            ( __atomic_load_n( &_rulesPending, __ATOMIC_ACQUIRE ) != 0 ) )
+        {
+            return false;
+        }
+
+        if( Rules_Compile( _ruleInputs, RULE_INPUT_COUNT,
+                           _ruleOutputs, sizeof( _ruleOutputs ) / sizeof( _ruleOutputs[ 0 ] ),
+                           pValue->pcText, pValue->xLength,
+                           &_pendingRules, &errorOffset ) == false )
+        {
+            IotLogWarn( "Rules not compiled; error at character %lu.", ( unsigned long ) errorOffset );
+
+            return false;
+        }
+
+        __atomic_store_n( &_ruleCount, _pendingRules.ucRules, __ATOMIC_RELAXED );
+        __atomic_store_n( &_rulesPending, 1, __ATOMIC_RELEASE );
+
+        if( xSamplingTask != NULL )
+        {
+            ( void ) xTaskNotify( xSamplingTask, SAMPLING_NOTIFY_RULES, eSetBits );
+        }
+
+        return true;
+    }
+
+    static int _reportRules( char * pBuffer,
+                             size_t length )
+    {
+        return snprintf( pBuffer, length, "%lu",
+                         ( unsigned long ) __atomic_load_n( &_ruleCount, __ATOMIC_RELAXED ) );
+    }
+
+    static bool _applyAdaptive( const CmdValue_t * pValue )
+    {
+        uint32_t adaptive = 0;
+
+        if( CmdDispatch_IsString( pValue, "on" ) == true )
+        {
+            adaptive = 1;
+        }
+        else if( CmdDispatch_IsString( pValue, "off" ) == false )
+        {
+            return false;
+        }
+
+        __atomic_store_n( &( _settings.adaptive ), adaptive, __ATOMIC_RELAXED );
+
+        return true;
+    }
+
+    static int _reportAdaptive( char * pBuffer,
+                                size_t length )
+    {
+        return snprintf( pBuffer, length, "\"%s\"",
+                         ( __atomic_load_n( &( _settings.adaptive ), __ATOMIC_RELAXED ) == 1 ) ? "on" : "off" );
+    }
+
+#endif
+
+/**
+ * @brief The commands taken on the subscription topic.
+ *
+ * - led: "on" or "off".
+ * - period_ms: sampling period, from IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS to
+ *   IOT_DEMO_MQTT_MAX_SAMPLE_PERIOD_MS.
+ * - batch: messages gathered before publishing, up to
+ *   IOT_DEMO_MQTT_RING_BATCH. A vibration event may then wait for the next
+ *   readings.
+ * - deadband: a temperature and humidity reading is only published once
+ *   either has moved by this much since the last one published, in steps
+ *   of 0.1. 0 publishes every reading.
+ * - qos: QoS of the readings, 0 or 1. At QoS 0 the library reports no
+ *   completion, so the latency trace and the benchmark see no ack; the
+ *   PUBLISH template is only used at QoS 1.
+ * - rules: local rules that drive the LED, replacing those in force, in
+ *   the syntax of driver/rule_engine.h; the inputs are temp, humidity and
+ *   vibration. "" removes them all. The ack gives the number of rules.
+ * - adaptive: "on" or "off". While on, the sampling task shortens the
+ *   period while the readings change and stretches it while they are
+ *   steady, between IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS and
+ *   IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS, starting from period_ms. Each
+ *   change is published as {"SamplePeriodMs":...}. Off keeps the period
+ *   where it is.
+ */
+static const CmdEntry_t _commands[] =
+{
+    cmddispatchENTRY( "led",       _applyLed,      _reportLed      ),
+    cmddispatchENTRY( "period_ms", _applyPeriod,   _reportPeriod   ),
+    cmddispatchENTRY( "batch",     _applyBatch,    _reportBatch    ),
+    cmddispatchENTRY( "deadband",  _applyDeadband, _reportDeadband ),
+    cmddispatchENTRY( "qos",       _applyQos,      _reportQos      ),
+    #if IOT_DEMO_MQTT_BENCHMARK == 0
+        cmddispatchENTRY( "rules",    _applyRules,    _reportRules    ),
+        cmddispatchENTRY( "adaptive", _applyAdaptive, _reportAdaptive )
+    #endif
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Route handler that applies the commands in a message, and publishes
+ * an acknowledgement with the settings now in force to #ACK_TOPIC_NAME.
+ *
+ * @param[in] pContext Not used.
+ * @param[in] pTopic The topic name.
+ * @param[in] topicLength The length of pTopic.
+ * @param[in] pMessage The #IotMqttCallbackParam_t of the message.
+ */
+static void _commandHandler( void * pContext,
+                             const char * pTopic,
+                             size_t topicLength,
+                             void * pMessage )
+{
+    IotMqttCallbackParam_t * const pPublish = ( IotMqttCallbackParam_t * ) pMessage;
+    const char * pPayload = pPublish->u.message.info.pPayload;
+    CmdResult_t result;
+    char pAck[ IOT_DEMO_MQTT_ACK_BUFFER_LENGTH ];
+    IotMqttPublishInfo_t ackInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttError_t ackStatus = IOT_MQTT_SUCCESS;
+
+    ( void ) pContext;
+    ( void ) pTopic;
+    ( void ) topicLength;
+
+    /* Apply every key of the message, in one pass over it. */
+    if( CmdDispatch_Run( _commands,
+                         sizeof( _commands ) / sizeof( _commands[ 0 ] ),
+                         pPayload,
+                         pPublish->u.message.info.payloadLength,
+                         &result ) == false )
+    {
+        IotLogWarn( "No command found in Json document." );
+    }
+
+    /* Acknowledge with the settings now in force. The payload is copied
+     * into the packet before IotMqtt_Publish returns, and at QoS 0 nothing
+     * waits for the server. */
+    ackInfo.payloadLength = CmdDispatch_FormatAck( _commands,
+                                                   sizeof( _commands ) / sizeof( _commands[ 0 ] ),
+                                                   &result,
+                                                   pAck,
+                                                   sizeof( pAck ) );
+
+    if( ackInfo.payloadLength > 0 )
+    {
+        ackInfo.qos = IOT_MQTT_QOS_0;
+        ackInfo.pTopicName = ACK_TOPIC_NAME;
+        ackInfo.topicNameLength = ACK_TOPIC_NAME_LENGTH;
+        ackInfo.pPayload = pAck;
+
+        ackStatus = IotMqtt_Publish( pPublish->mqttConnection,
+                                     &ackInfo,
+                                     0,
+                                     NULL,
+                                     NULL );
+
+        if( ( ackStatus != IOT_MQTT_SUCCESS ) && ( ackStatus != IOT_MQTT_STATUS_PENDING ) )
+        {
+            IotLogWarn( "Failed to acknowledge the command. Error %s.",
+                        IotMqtt_strerror( ackStatus ) );
+        }
+    }
+    else
+    {
+        IotLogWarn( "The command ack does not fit in %d bytes.",
+                    IOT_DEMO_MQTT_ACK_BUFFER_LENGTH );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Route handler that counts the messages received.
+ *
+ * @param[in] pContext Counts the total number of received PUBLISH messages.
+ * This handler will increment this counter.
+ * @param[in] pTopic The topic name.
+ * @param[in] topicLength The length of pTopic.
+ * @param[in] pMessage The #IotMqttCallbackParam_t of the message.
+ */
+static void _receivedHandler( void * pContext,
+                              const char * pTopic,
+                              size_t topicLength,
+                              void * pMessage )
+{
+    IotSemaphore_t * pPublishesReceived = ( IotSemaphore_t * ) pContext;
+
+    ( void ) pTopic;
+    ( void ) topicLength;
+    ( void ) pMessage;
+
+    /* Increment the number of PUBLISH messages received. */
+    IotSemaphore_Post( pPublishesReceived );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Called by the MQTT library when an incoming PUBLISH message is received.
  *
  * The demo uses this callback to handle incoming PUBLISH messages. This callback
- * prints the contents of an incoming message and publishes an acknowledgement
- * to the MQTT server.
- * @param[in] param1 Counts the total number of received PUBLISH messages. This
- * callback will increment this counter.
+ * prints the contents of an incoming message and passes it to the handlers
+ * whose topic filters match its topic.
+ * @param[in] param1 The #TopicRouter_t of the demo.
  * @param[in] pPublish Information about the incoming PUBLISH message passed by
  * the MQTT library.
  */
 static void _mqttSubscriptionCallback( void * param1,
                                        IotMqttCallbackParam_t * const pPublish )
 {
-    IotSemaphore_t * pPublishesReceived = ( IotSemaphore_t * ) param1;
-    const char * pPayload = pPublish->u.message.info.pPayload;
-    bool keyFound = false;
-    const char * pJsonValue = NULL;
-    size_t jsonValueLength = 0;
-
-    /* Print information about the incoming PUBLISH message. */
-    IotLogInfo( "Incoming PUBLISH received:\r\n"
-                "Subscription topic filter: %.*s\r\n"
-                "Publish topic name: %.*s\r\n"
-                "Publish retain flag: %d\r\n"
-                "Publish QoS: %d\r\n"
-                "Publish payload: %.*s",
-                pPublish->u.message.topicFilterLength,
-                pPublish->u.message.pTopicFilter,
-                pPublish->u.message.info.topicNameLength,
-                pPublish->u.message.info.pTopicName,
-                pPublish->u.message.info.retain,
-                pPublish->u.message.info.qos,
-                pPublish->u.message.info.payloadLength,
-                pPayload );
-
-
-    /* Find the given section in the updated document. */
-    keyFound = IotJsonUtils_FindJsonValue( pPublish->u.message.info.pPayload,
-                                               pPublish->u.message.info.payloadLength,
-                                               SUBSCRIBE_TOKEN_KEY,
-                                               SUBSCRIBE_TOKEN_KEY_LENGTH,
-                                               &pJsonValue,
-                                               &jsonValueLength );
-
-    if( keyFound == true )
-    {
-        IotLogInfo( "Turn Led %.*s\r\n",
-                    jsonValueLength,
-                    pJsonValue );
-        if ( strncmp( pJsonValue, "\"on\"", 4 ) == 0 )
-        {
-            gpio_set_level(GPIO_NUM_13, 0);
+    const TopicRouter_t * pRouter = ( const TopicRouter_t * ) param1;
+
+    /* Print information about the incoming PUBLISH message. The callback
+     * runs on the MQTT receive path, so only the arguments are copied here. */
+    dlogPRINTF( ( "Incoming PUBLISH received:\r\n"
+                  "Subscription topic filter: %.*s\r\n"
+                  "Publish topic name: %.*s\r\n"
+                  "Publish retain flag: %d\r\n"
+                  "Publish QoS: %d\r\n"
+                  "Publish payload: %.*s\r\n",
+                  ( int ) pPublish->u.message.topicFilterLength,
+                  pPublish->u.message.pTopicFilter,
+                  ( int ) pPublish->u.message.info.topicNameLength,
+                  pPublish->u.message.info.pTopicName,
+                  ( int ) pPublish->u.message.info.retain,
+                  ( int ) pPublish->u.message.info.qos,
+                  ( int ) pPublish->u.message.info.payloadLength,
+                  ( const char * ) pPublish->u.message.info.pPayload ) );
+
+    if( TopicRouter_Dispatch( pRouter,
+                              pPublish->u.message.info.pTopicName,
+                              pPublish->u.message.info.topicNameLength,
+                              pPublish ) == 0 )
+    {
+        IotLogWarn( "No handler for topic %.*s.",
+                    ( int ) pPublish->u.message.info.topicNameLength,
+                    pPublish->u.message.info.pTopicName );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Register the handlers of the demo topics with #_router.
+ *
+ * Commands are taken on the subscription topic and on the command topics of
+ * all devices, of the group and of this device; every message received is
+ * counted.
+ *
+ * @param[in] pIdentifier NULL-terminated MQTT client identifier, or NULL if
+ * one is generated; there is then no command topic for this device.
+ * @param[in] pSubscribeTopic The subscription topic.
+ * @param[in] pPublishesReceived Counts the number of messages received.
+ *
+ * @return `EXIT_SUCCESS` if every route was added; `EXIT_FAILURE` otherwise.
+ */
+static int _addRoutes( const char * pIdentifier,
+                       const char * pSubscribeTopic,
+                       IotSemaphore_t * pPublishesReceived )
+{
+    static const char pAllTopic[] = COMMAND_TOPIC_PREFIX "all";
+    static const char pGroupTopic[] = COMMAND_TOPIC_PREFIX "group/" IOT_DEMO_MQTT_GROUP;
+    static const char pReceivedFilter[] = IOT_DEMO_MQTT_TOPIC_PREFIX "/#";
+    int length = 0;
+    bool added = false;
+
+    TopicRouter_Init( &_router );
+
+    added = TopicRouter_Add( &_router, pSubscribeTopic, strlen( pSubscribeTopic ), _commandHandler, NULL ) &&
+            TopicRouter_Add( &_router, pAllTopic, sizeof( pAllTopic ) - 1, _commandHandler, NULL ) &&
+            TopicRouter_Add( &_router, pGroupTopic, sizeof( pGroupTopic ) - 1, _commandHandler, NULL ) &&
+            TopicRouter_Add( &_router, pReceivedFilter, sizeof( pReceivedFilter ) - 1, _receivedHandler, pPublishesReceived );
+
+    if( ( added == true ) && ( pIdentifier != NULL ) )
+    {
+        length = snprintf( _deviceCommandTopic,
+                           sizeof( _deviceCommandTopic ),
+                           COMMAND_TOPIC_PREFIX "device/%s",
+                           pIdentifier );
+
+        if( ( length > 0 ) && ( ( size_t ) length < sizeof( _deviceCommandTopic ) ) )
+        {
+            added = TopicRouter_Add( &_router, _deviceCommandTopic, ( size_t ) length, _commandHandler, NULL );
         }
         else
         {
-            gpio_set_level(GPIO_NUM_13, 1);
+            IotLogWarn( "No command topic for a client identifier this long." );
         }
     }
-    else
+
+    if( added == false )
     {
-        IotLogWarn( "Failed to find key %s in Json document.",
-                    "led" );
+        IotLogError( "Failed to add the topic routes." );
     }
 
-    /* Increment the number of PUBLISH messages received. */
-    IotSemaphore_Post( pPublishesReceived );
+    return ( added == true ) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 /*-----------------------------------------------------------*/
@@ -394,10 +1223,16 @@ static int _establishMqttConnection( bool awsIotMqttMode,
     networkInfo.createNetworkConnection = true;
     networkInfo.u.setup.pNetworkServerInfo = pNetworkServerInfo;
     networkInfo.u.setup.pNetworkCredentialInfo = pNetworkCredentialInfo;
-    networkInfo.pNetworkInterface = pNetworkInterface;
+    /* Packets are coalesced above fault injection, so that faults hit whole
+     * sends as they would on the network. */
+    networkInfo.pNetworkInterface =
+        IotDemoTlsMetrics_WrapInterface( IotDemoCork_WrapInterface( IotDemoFault_WrapInterface( pNetworkInterface ) ) );
+    networkInfo.disconnectCallback.function = _mqttDisconnectCallback;
 
     #if ( IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1 ) && defined( IOT_DEMO_MQTT_SERIALIZER )
         networkInfo.pMqttSerializer = IOT_DEMO_MQTT_SERIALIZER;
+    #elif ( IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1 )
+        networkInfo.pMqttSerializer = IotDemoPublishTemplate_Serializer();
     #endif
 
     /* Set the members of the connection info not set by the initializer. */
@@ -455,6 +1290,10 @@ static int _establishMqttConnection( bool awsIotMqttMode,
                     connectInfo.pClientIdentifier,
                     connectInfo.clientIdentifierLength );
 
+        /* A connection made again resumes the TLS session of the last one,
+         * which the TLS layer keeps per endpoint. */
+        __atomic_store_n( &_connectionLost, false, __ATOMIC_RELEASE );
+
         connectStatus = IotMqtt_Connect( &networkInfo,
                                          &connectInfo,
                                          MQTT_TIMEOUT_MS,
@@ -467,6 +1306,8 @@ static int _establishMqttConnection( bool awsIotMqttMode,
 
             status = EXIT_FAILURE;
         }
+
+        IotDemoTlsMetrics_Print();
     }
 
     return status;
@@ -479,7 +1320,8 @@ static int _establishMqttConnection( bool awsIotMqttMode,
  *
  * @param[in] mqttConnection The MQTT connection to use for subscriptions.
  * @param[in] operation Either #IOT_MQTT_SUBSCRIBE or #IOT_MQTT_UNSUBSCRIBE.
- * @param[in] pTopicFilters Array of topic filters for subscriptions.
+ * @param[in] pTopicFilters Array of #TOPIC_FILTER_COUNT NULL-terminated topic
+ * filters for subscriptions.
  * @param[in] pCallbackParameter The parameter to pass to the subscription
  * callback.
  *
@@ -488,25 +1330,29 @@ static int _establishMqttConnection( bool awsIotMqttMode,
  */
 static int _modifySubscriptions( IotMqttConnection_t mqttConnection,
                                  IotMqttOperationType_t operation,
-                                 const char * pTopicFilters,
+                                 const char * const * pTopicFilters,
                                  void * pCallbackParameter )
 {
     int status = EXIT_SUCCESS;
+    int i = 0;
     IotMqttError_t subscriptionStatus = IOT_MQTT_STATUS_PENDING;
-    IotMqttSubscription_t subscriptions = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    IotMqttSubscription_t subscriptions[ TOPIC_FILTER_COUNT ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
 
     /* Set the members of the subscription list. */
-    subscriptions.qos = IOT_MQTT_QOS_1;
-    subscriptions.pTopicFilter = pTopicFilters;
-    subscriptions.topicFilterLength = TOPIC_FILTER_LENGTH;
-    subscriptions.callback.pCallbackContext = pCallbackParameter;
-    subscriptions.callback.function = _mqttSubscriptionCallback;
+    for( i = 0; i < TOPIC_FILTER_COUNT; i++ )
+    {
+        subscriptions[ i ].qos = IOT_MQTT_QOS_1;
+        subscriptions[ i ].pTopicFilter = pTopicFilters[ i ];
+        subscriptions[ i ].topicFilterLength = ( uint16_t ) strlen( pTopicFilters[ i ] );
+        subscriptions[ i ].callback.pCallbackContext = pCallbackParameter;
+        subscriptions[ i ].callback.function = _mqttSubscriptionCallback;
+    }
 
     /* Modify subscriptions by either subscribing or unsubscribing. */
     if( operation == IOT_MQTT_SUBSCRIBE )
     {
         subscriptionStatus = IotMqtt_TimedSubscribe( mqttConnection,
-                                                     &subscriptions,
+                                                     subscriptions,
                                                      TOPIC_FILTER_COUNT,
                                                      0,
                                                      MQTT_TIMEOUT_MS );
@@ -521,20 +1367,23 @@ static int _modifySubscriptions( IotMqttConnection_t mqttConnection,
             case IOT_MQTT_SERVER_REFUSED:
 
                 /* Check which subscriptions were rejected before exiting the demo. */
-                if( IotMqtt_IsSubscribed( mqttConnection,
-                                          subscriptions.pTopicFilter,
-                                          subscriptions.topicFilterLength,
-                                          NULL ) == true )
-                {
-                    IotLogInfo( "Topic filter %.*s was accepted.",
-                                subscriptions.topicFilterLength,
-                                subscriptions.pTopicFilter );
-                }
-                else
+                for( i = 0; i < TOPIC_FILTER_COUNT; i++ )
                 {
-                    IotLogError( "Topic filter %.*s was rejected.",
-                                 subscriptions.topicFilterLength,
-                                 subscriptions.pTopicFilter );
+                    if( IotMqtt_IsSubscribed( mqttConnection,
+                                              subscriptions[ i ].pTopicFilter,
+                                              subscriptions[ i ].topicFilterLength,
+                                              NULL ) == true )
+                    {
+                        IotLogInfo( "Topic filter %.*s was accepted.",
+                                    subscriptions[ i ].topicFilterLength,
+                                    subscriptions[ i ].pTopicFilter );
+                    }
+                    else
+                    {
+                        IotLogError( "Topic filter %.*s was rejected.",
+                                     subscriptions[ i ].topicFilterLength,
+                                     subscriptions[ i ].pTopicFilter );
+                    }
                 }
 
                 status = EXIT_FAILURE;
@@ -549,54 +1398,497 @@ static int _modifySubscriptions( IotMqttConnection_t mqttConnection,
     else if( operation == IOT_MQTT_UNSUBSCRIBE )
     {
         subscriptionStatus = IotMqtt_TimedUnsubscribe( mqttConnection,
-                                                       &subscriptions,
+                                                       subscriptions,
                                                        TOPIC_FILTER_COUNT,
                                                        0,
                                                        MQTT_TIMEOUT_MS );
 
-        /* Check the status of UNSUBSCRIBE. */
-        if( subscriptionStatus != IOT_MQTT_SUCCESS )
+        /* Check the status of UNSUBSCRIBE. */
+        if( subscriptionStatus != IOT_MQTT_SUCCESS )
+        {
+            status = EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        /* Only SUBSCRIBE and UNSUBSCRIBE are valid for modifying subscriptions. */
+        IotLogError( "MQTT operation %s is not valid for modifying subscriptions.",
+                     IotMqtt_OperationType( operation ) );
+
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+
+static void IRAM_ATTR gpio_isr_handler(void* arg)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    SchedTrace_IsrEnter( GPIO_NUM_14 );
+
+    IotDemoTrace_EdgeFromISR();
+
+    /* The ring has a single producer, the sampling task. Edges are counted
+     * so that it still queues one message per edge. */
+    ( void ) __atomic_add_fetch( &ulPendingEdges, 1, __ATOMIC_RELAXED );
+
+    if( xSamplingTask != NULL )
+    {
+        ( void ) xTaskNotifyFromISR( xSamplingTask,
+                                     SAMPLING_NOTIFY_EDGE,
+                                     eSetBits,
+                                     &xHigherPriorityTaskWoken );
+    }
+
+    SchedTrace_IsrExit( GPIO_NUM_14 );
+
+    if( xHigherPriorityTaskWoken == pdTRUE )
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+#endif
+
+/**
+ * @brief Hand a message to the demo task. Called by the ring's producer only.
+ */
+static bool _pushMessage( const DemoTaskMessage_t * pMessage )
+{
+    if( SpscRing_Push( &xDemoRing, pMessage ) == false )
+    {
+        IotDemoFault_ReadingProduced( false );
+
+        return false;
+    }
+
+    IotDemoFault_ReadingProduced( true );
+    xTaskNotifyGive( xConsumerTask );
+
+    return true;
+}
+
+static int _sampleSensor( DemoTaskMessage_t * pMessage )
+{
+    int ret;
+
+    ( void ) memset( &( pMessage->stamp ), 0x00, sizeof( pMessage->stamp ) );
+
+    SchedTrace_SpanBegin( "readDHT" );
+    ret = readDHT();
+    SchedTrace_SpanEnd( "readDHT" );
+    IotDemoLatency_Sampled( &( pMessage->stamp ) );
+	errorHandler(ret);
+
+    pMessage->type = eEventTypeTemp;
+    pMessage->humidity = getHumidity();
+    pMessage->temperature = getTemperature();
+
+    return ret;
+}
+
+static void prvRequestTimer_Callback( TimerHandle_t xTimer )
+{
+    ( void ) xTimer;
+
+    /* The timer task runs on the network core; the reading is taken on
+     * the sampling core. */
+    if( xSamplingTask != NULL )
+    {
+        ( void ) xTaskNotify( xSamplingTask, SAMPLING_NOTIFY_READ, eSetBits );
+    }
+}
+
+#if IOT_DEMO_MQTT_BENCHMARK == 0
+
+/**
+ * @brief A reading in tenths, the resolution of the DHT22.
+ */
+static int32_t _toTenths( float value )
+{
+    return ( int32_t ) ( ( value * 10.0f ) + ( ( value < 0.0f ) ? -0.5f : 0.5f ) );
+}
+
+/**
+ * @brief Whether a reading has moved far enough from the last one queued
+ * to be published. Called by the sampling task only.
+ */
+static bool _outsideDeadband( const DemoTaskMessage_t * pMessage )
+{
+    static bool queued = false;
+    static int32_t lastHumidity = 0, lastTemperature = 0;
+    int32_t humidity = _toTenths( pMessage->humidity );
+    int32_t temperature = _toTenths( pMessage->temperature );
+    int32_t deadband = ( int32_t ) __atomic_load_n( &( _settings.deadbandTenths ), __ATOMIC_RELAXED );
+
+    if( ( queued == true ) &&
+        ( abs( humidity - lastHumidity ) < deadband ) &&
+        ( abs( temperature - lastTemperature ) < deadband ) )
+    {
+        return false;
+    }
+
+    queued = true;
+    lastHumidity = humidity;
+    lastTemperature = temperature;
+
+    return true;
+}
+
+/**
+ * @brief Set an output of the local rules.
+ */
+static void _ruleAction( void * pContext,
+                         size_t output,
+                         int32_t level )
+{
+    ( void ) pContext;
+    ( void ) output;
+
+    /* The LED is the only output. */
+    _setLed( ( uint32_t ) level );
+}
+
+/**
+ * @brief Evaluate the local rules on the latest inputs, taking new rules
+ * first. Called by the sampling task only, which owns the rules in force.
+ */
+static void _evaluateRules( const int32_t * pInputs )
+{
+    static RuleProgram_t rules;
+    static RuleState_t state;
+
+    if( __atomic_load_n( &_rulesPending, __ATOMIC_ACQUIRE ) != 0 )
+    {
+        rules = _pendingRules;
+        Rules_Reset( &state );
+        __atomic_store_n( &_rulesPending, 0, __ATOMIC_RELEASE );
+    }
+
+    Rules_Evaluate( &rules,
+                    &state,
+                    pInputs,
+                    ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ),
+                    _ruleAction,
+                    NULL );
+}
+
+/**
+ * @brief Adapt the sampling period to a good reading, and publish the new
+ * period when it changes. Called by the sampling task only.
+ *
+ * Nothing is done before the demo starts xRequestTimer, since changing the
+ * period of a timer starts it.
+ *
+ * @param[in] pValues The temperature and humidity in tenths, in that order,
+ * as the rule inputs hold them.
+ */
+static void _adaptPeriod( const int32_t * pValues )
+{
+    static AdaptivePeriod_t controller;
+    static bool initialized = false;
+    static const AdaptivePeriodConfig_t config =
+    {
+        .ulMinMs    = IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS,
+        .ulMaxMs    = IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS,
+        .uxChannels = 2,
+        .lStep      = { IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS, IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS }
+    };
+    uint32_t periodMs = __atomic_load_n( &( _settings.periodMs ), __ATOMIC_RELAXED );
+    uint32_t nextMs;
+    DemoTaskMessage_t xMessage;
+
+    if( initialized == false )
+    {
+        if( AdaptivePeriod_Init( &controller, &config ) == false )
+        {
+            IotLogError( "The adaptive sampling period is not configured correctly." );
+            __atomic_store_n( &( _settings.adaptive ), 0, __ATOMIC_RELAXED );
+
+            return;
+        }
+
+        initialized = true;
+    }
+
+    if( ( __atomic_load_n( &( _settings.adaptive ), __ATOMIC_RELAXED ) == 0 ) ||
+        ( xTimerIsTimerActive( xRequestTimer ) == pdFALSE ) )
+    {
+        return;
+    }
+
+    nextMs = AdaptivePeriod_Next( &controller, periodMs, pValues );
+
+    if( ( nextMs == periodMs ) ||
+        ( xTimerChangePeriod( xRequestTimer, pdMS_TO_TICKS( nextMs ), 0 ) != pdPASS ) )
+    {
+        return;
+    }
+
+    __atomic_store_n( &( _settings.periodMs ), nextMs, __ATOMIC_RELAXED );
+
+    ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+    xMessage.type = eEventTypePeriod;
+    xMessage.periodMs = nextMs;
+    IotDemoLatency_Sampled( &( xMessage.stamp ) );
+    IotDemoLatency_Enqueued( &( xMessage.stamp ) );
+    ( void ) _pushMessage( &xMessage );
+}
+
+#if IOT_DEMO_MQTT_STATS == 1
+
+/**
+ * @brief Add a good reading to the running statistics, and queue the
+ * anomalies it raises and the summaries of the windows it closes. Called by
+ * the sampling task only.
+ *
+ * @param[in] pReading The reading.
+ * @param[in] pValues Its temperature and humidity in tenths, in that order,
+ * as the rule inputs hold them.
+ */
+static void _updateStats( const DemoTaskMessage_t * pReading,
+                          const int32_t * pValues )
+{
+    static StreamStats_t stats;
+    static bool initialized = false, usable = false;
+    static const StreamStatsConfig_t config =
+    {
+        .uxChannels    = STATS_CHANNEL_COUNT,
+        .ulWindow      = IOT_DEMO_MQTT_STATS_WINDOW,
+        .fZThreshold   = IOT_DEMO_MQTT_STATS_Z_THRESHOLD,
+        .lMinDeviation = { IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS, IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS }
+    };
+    float zScores[ STATS_CHANNEL_COUNT ];
+    uint32_t anomalies = 0, channel;
+    bool closed;
+    DemoTaskMessage_t xMessage;
+
+    if( initialized == false )
+    {
+        initialized = true;
+        usable = StreamStats_Init( &stats, &config );
+
+        if( usable == false )
+        {
+            IotLogError( "The running statistics are not configured correctly." );
+        }
+    }
+
+    if( usable == false )
+    {
+        return;
+    }
+
+    closed = StreamStats_Add( &stats, pValues, zScores, &anomalies );
+
+    for( channel = 0; channel < STATS_CHANNEL_COUNT; channel++ )
+    {
+        if( ( anomalies & ( 1UL << channel ) ) != 0 )
+        {
+            ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+            xMessage.type = eEventTypeAnomaly;
+            xMessage.channel = channel;
+            xMessage.humidity = pReading->humidity;
+            xMessage.temperature = pReading->temperature;
+            xMessage.zScore = zScores[ channel ];
+            IotDemoLatency_Sampled( &( xMessage.stamp ) );
+            IotDemoLatency_Enqueued( &( xMessage.stamp ) );
+            ( void ) _pushMessage( &xMessage );
+        }
+
+        if( closed == true )
+        {
+            ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+            xMessage.type = eEventTypeSummary;
+            xMessage.channel = channel;
+            StreamStats_Tumbling( &stats, channel, &( xMessage.summary ) );
+            IotDemoLatency_Sampled( &( xMessage.stamp ) );
+            IotDemoLatency_Enqueued( &( xMessage.stamp ) );
+            ( void ) _pushMessage( &xMessage );
+        }
+    }
+}
+
+#endif
+
+/**
+ * @brief Take readings when the timers or the GPIO interrupt ask for them.
+ *
+ * Pinned to IOT_DEMO_MQTT_SAMPLING_CORE, so that WiFi and TLS work on the
+ * other core does not disturb the DHT22 bit timing.
+ */
+static void _samplingTask( void * pArgument )
+{
+    int ret;
+    uint32_t notified = 0, edges = 0;
+    DemoTaskMessage_t xMessage;
+    int32_t ruleInputs[ RULE_INPUT_COUNT ] = { 0 };
+    TickType_t lastEdge = 0;
+    bool sampled = false;
+
+    ( void ) pArgument;
+
+    /* The rules in force at start; a command may replace them. They drive
+     * the LED from here instead of from the GPIO interrupt. */
+    if( Rules_Compile( _ruleInputs, RULE_INPUT_COUNT,
+                       _ruleOutputs, sizeof( _ruleOutputs ) / sizeof( _ruleOutputs[ 0 ] ),
+                       IOT_DEMO_MQTT_RULES, sizeof( IOT_DEMO_MQTT_RULES ) - 1,
+                       &_pendingRules, NULL ) == true )
+    {
+        __atomic_store_n( &_ruleCount, _pendingRules.ucRules, __ATOMIC_RELAXED );
+        __atomic_store_n( &_rulesPending, 1, __ATOMIC_RELEASE );
+    }
+    else
+    {
+        IotLogError( "IOT_DEMO_MQTT_RULES could not be compiled." );
+    }
+
+    /* xTaskCreateStaticPinnedToCore() returns the handle only once this
+     * task may already be running on the other core. The interrupt uses the
+     * handle, so wait until the creator has stored it. */
+    do
+    {
+        ( void ) xTaskNotifyWait( 0, SAMPLING_NOTIFY_START, &notified, portMAX_DELAY );
+    } while( ( notified & SAMPLING_NOTIFY_START ) == 0 );
+
+    /* The GPIO interrupt is allocated on the core that installs it. */
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(GPIO_NUM_14, gpio_isr_handler, (void*) GPIO_NUM_14);
+
+    for( ; ; )
+    {
+        ( void ) xTaskNotifyWait( 0, UINT32_MAX, &notified, portMAX_DELAY );
+
+        if( ( notified & SAMPLING_NOTIFY_EDGE ) != 0 )
+        {
+            lastEdge = xTaskGetTickCount();
+            ruleInputs[ RULE_INPUT_VIBRATION ] = 1;
+
+            for( edges = __atomic_exchange_n( &ulPendingEdges, 0, __ATOMIC_RELAXED ); edges > 0; edges-- )
+            {
+                ( void ) memset( &( xMessage.stamp ), 0x00, sizeof( xMessage.stamp ) );
+                xMessage.type = eEventTypeGpio;
+                IotDemoLatency_Sampled( &( xMessage.stamp ) );
+                IotDemoLatency_Enqueued( &( xMessage.stamp ) );
+                ( void ) _pushMessage( &xMessage );
+            }
+        }
+
+        if( ( notified & SAMPLING_NOTIFY_READ ) != 0 )
+        {
+            ret = _sampleSensor( &xMessage );
+            BootProfile_Mark( "first_sample" );
+
+            IotDemoTrace_Sample( xMessage.humidity, xMessage.temperature, ret );
+            IotDemoTrace_Flush();
+
+            dlogPRINTF( ( "Hum %.1f\n", xMessage.humidity ) );
+            dlogPRINTF( ( "Tmp %.1f\n", xMessage.temperature ) );
+
+            /* A failed reading leaves the rules on the last good one. */
+            if( ret == DHT_OK )
+            {
+                ruleInputs[ RULE_INPUT_TEMP ] = _toTenths( xMessage.temperature );
+                ruleInputs[ RULE_INPUT_HUMIDITY ] = _toTenths( xMessage.humidity );
+            }
+
+            sampled = true;
+
+            /* Readings within the deadband are traced but not sent. */
+            if( _outsideDeadband( &xMessage ) == true )
+            {
+                IotDemoLatency_Enqueued( &( xMessage.stamp ) );
+                ( void ) _pushMessage( &xMessage );
+            }
+
+            /* The next period, and the statistics, follow from the good
+             * readings only. */
+            if( ret == DHT_OK )
+            {
+                _adaptPeriod( ruleInputs );
+
+                #if IOT_DEMO_MQTT_STATS == 1
+                    _updateStats( &xMessage, ruleInputs );
+                #endif
+            }
+        }
+
+        /* Vibration ends once no edge has come for a window; that is seen
+         * at the next edge or reading. */
+        if( ( xTaskGetTickCount() - lastEdge ) >= pdMS_TO_TICKS( IOT_DEMO_MQTT_VIBRATION_WINDOW_MS ) )
         {
-            status = EXIT_FAILURE;
+            ruleInputs[ RULE_INPUT_VIBRATION ] = 0;
         }
-    }
-    else
-    {
-        /* Only SUBSCRIBE and UNSUBSCRIBE are valid for modifying subscriptions. */
-        IotLogError( "MQTT operation %s is not valid for modifying subscriptions.",
-                     IotMqtt_OperationType( operation ) );
 
-        status = EXIT_FAILURE;
+        /* The rules wait for the first reading, so that a rule on the
+         * temperature does not act on a reading of 0. */
+        if( sampled == true )
+        {
+            _evaluateRules( ruleInputs );
+        }
     }
-
-    return status;
 }
 
-static void IRAM_ATTR gpio_isr_handler(void* arg)
-{
-    DemoTaskMessage_t xMessage;
-    gpio_set_level(GPIO_NUM_13, 0);
+#endif
 
-    xMessage.type = eEventTypeGpio;
-    xQueueSendFromISR(xDemoQueue, &xMessage, pdFALSE );
-}
+#if IOT_DEMO_MQTT_BENCHMARK == 1
 
-static void prvRequestTimer_Callback( TimerHandle_t xTimer )
+/**
+ * @brief Produce one benchmark event the way #_samplingTask does.
+ *
+ * The benchmark task takes the place of the sampling task as the only
+ * producer of the ring.
+ */
+static bool _benchmarkProduce( void )
 {
-    int ret;
     DemoTaskMessage_t xMessage;
+    uint32_t stageStart = IotDemoBench_Cycles();
+    bool queued = false;
 
-    ret = readDHT();
-	errorHandler(ret);
+    _sampleSensor( &xMessage );
+    IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_SAMPLE, stageStart );
+
+    xMessage.stamp.enqueueUs = IotDemoBench_TimeUs();
+    stageStart = IotDemoBench_Cycles();
+    queued = _pushMessage( &xMessage );
+    IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_ENQUEUE, stageStart );
+
+    return queued;
+}
+
+#endif
 
-    xMessage.type = eEventTypeTemp;
-    xMessage.humidity = getHumidity();
-    xMessage.temperature = getTemperature();
+/*-----------------------------------------------------------*/
 
-    printf( "Hum %.1f\n", xMessage.humidity );
-    printf( "Tmp %.1f\n", xMessage.temperature );
+/**
+ * @brief Start producing readings, once: the request timer, or in the
+ * benchmark the benchmark task, which must be the ring's only producer.
+ */
+static void _startProducer( void )
+{
+    #if IOT_DEMO_MQTT_BENCHMARK == 1
+        /* The benchmark producer takes the place of the timer. */
+        if( IotDemoBench_Start( _benchmarkProduce ) == false )
+        {
+            IotLogError( "ERROR: failed to start the benchmark.\r\n" );
+        }
+    #else
+        if( xRequestTimer != NULL )
+        {
+            xTimerStarted = xTimerStart( xRequestTimer, 0 );
+        }
 
-    xQueueSend(xDemoQueue, &xMessage, ( TickType_t ) 0 );
+        if( xTimerStarted == pdTRUE )
+        {
+            IotLogInfo( "Starting %s timer.\r\n", pcTimerName );
+        }
+        else
+        {
+            IotLogError( "ERROR: failed to start %s timer.\r\n", pcTimerName );
+        }
+    #endif
 }
 
 /*-----------------------------------------------------------*/
@@ -604,6 +1896,11 @@ static void prvRequestTimer_Callback( TimerHandle_t xTimer )
 /**
  * @brief Transmit all messages and wait for them to be received on topic filters.
  *
+ * No reading is dropped when the connection is lost. One whose PUBLISH
+ * returns an error stays in xDemoBatch, with the rest of its batch; one
+ * whose QoS 1 PUBLISH fails later, waiting for its PUBACK, stays in
+ * _inflight. Both are published first on the next call.
+ *
  * @param[in] mqttConnection The MQTT connection to use for publishing.
  * @param[in] pTopicNames Array of topic names for publishing. These were previously
  * subscribed to as topic filters.
@@ -623,104 +1920,260 @@ static int _publishAllMessages( IotMqttConnection_t mqttConnection,
     IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
     IotMqttCallbackInfo_t publishComplete = IOT_MQTT_CALLBACK_INFO_INITIALIZER;
     char pPublishPayload[ PUBLISH_PAYLOAD_BUFFER_LENGTH ] = { 0 };
-
-    DemoTaskMessage_t xMessage;
+    uint32_t stageStart = 0;
+    const DemoTaskMessage_t * pMessage = NULL;
+    _inflight_t * pInflight = NULL;
+    bool fromBatch = true;
+    uint32_t batch = 1;
 
     /* The MQTT library should invoke this callback when a PUBLISH message
      * is successfully transmitted. */
     publishComplete.function = _operationCompleteCallback;
 
-    /* Set the common members of the publish info. */
-    publishInfo.qos = IOT_MQTT_QOS_1;
+    /* Set the common members of the publish info. The QoS is set for each
+     * PUBLISH, as a command may change it. */
     publishInfo.topicNameLength = TOPIC_FILTER_LENGTH;
     publishInfo.pPayload = pPublishPayload;
     publishInfo.retryMs = PUBLISH_RETRY_MS;
     publishInfo.retryLimit = PUBLISH_RETRY_LIMIT;
     publishInfo.pTopicName = pTopicNames;
 
-    if( xRequestTimer != NULL )
-    {
-        xTimerStarted = xTimerStart( xRequestTimer, 0 );
-    }
-
-    if( xTimerStarted == pdTRUE )
+    /* Loop to PUBLISH all messages of this demo. Readings whose PUBLISH
+     * failed after it was sent go first; the others are taken from the ring
+     * a batch at a time, once the last batch is all published. */
+    while( status == EXIT_SUCCESS )
     {
-        IotLogInfo( "Starting %s timer.\r\n", pcTimerName );
-    }
-    else
-    {
-        IotLogError( "ERROR: failed to start %s timer.\r\n", pcTimerName );
-    }
+        pInflight = _nextResend();
+        fromBatch = ( pInflight == NULL );
 
-    /* Loop to PUBLISH all messages of this demo. */
-    for(;;publishCount++)
-    {
-        if(pdTRUE == xQueueReceive(xDemoQueue, &xMessage, portMAX_DELAY))
+        if( ( fromBatch == true ) && ( xDemoBatchNext == xDemoBatchCount ) )
         {
-            /* Pass the PUBLISH number to the operation complete callback. */
-            publishComplete.pCallbackContext = ( void * ) publishCount;
+            /* With a batch set by command, wait until it has been gathered,
+             * so that it goes out in one go. */
+            batch = __atomic_load_n( &( _settings.batch ), __ATOMIC_RELAXED );
 
-            /* Generate the payload for the PUBLISH. */
-            if (xMessage.type == eEventTypeGpio)
+            if( ( batch > 1 ) && ( SpscRing_Count( &xDemoRing ) < batch ) )
             {
-                status = snprintf( pPublishPayload,
-                                PUBLISH_PAYLOAD_BUFFER_LENGTH,
-                                PUBLISH_VIB_PAYLOAD_FORMAT,
-                                "\"Vibrating\"" );
+                ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+                continue;
             }
-            else if(xMessage.type == eEventTypeTemp)
+
+            xDemoBatchCount = SpscRing_PopBatch( &xDemoRing, xDemoBatch, IOT_DEMO_MQTT_RING_BATCH );
+            xDemoBatchNext = 0;
+
+            if( xDemoBatchCount == 0 )
             {
-                status = snprintf( pPublishPayload,
-                                PUBLISH_PAYLOAD_BUFFER_LENGTH,
-                                PUBLISH_DHT_PAYLOAD_FORMAT,
-                                xMessage.humidity, xMessage.temperature );
+                /* Every push is followed by a notification, so one made
+                 * after the ring was found empty is not missed. The
+                 * completion callback notifies too. */
+                ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+                continue;
             }
-            else
+        }
+
+        if( fromBatch == true )
+        {
+            pMessage = &( xDemoBatch[ xDemoBatchNext ] );
+            publishInfo.qos = ( IotMqttQos_t ) __atomic_load_n( &( _settings.qos ), __ATOMIC_RELAXED );
+
+            /* At QoS 1 the reading is kept until its PUBACK. With every
+             * slot in flight, wait for a completion. */
+            if( publishInfo.qos != IOT_MQTT_QOS_0 )
             {
-                /* Generate the payload for the PUBLISH. */
-                status = snprintf( pPublishPayload,
-                                PUBLISH_PAYLOAD_BUFFER_LENGTH,
-                                "Failed to get event type." );
+                pInflight = _freeInflight();
+
+                if( pInflight == NULL )
+                {
+                    ( void ) ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( PUBLISH_RETRY_MS ) );
+                    continue;
+                }
+
+                pInflight->message = *pMessage;
             }
+        }
+        else
+        {
+            /* Published at QoS 1 before, so again. */
+            pMessage = &( pInflight->message );
+            publishInfo.qos = IOT_MQTT_QOS_1;
+        }
 
-            /* Check for errors from snprintf. */
-            if( status < 0 )
-            {
-                IotLogError( "Failed to generate MQTT PUBLISH payload for PUBLISH %d.",
-                            ( int ) publishCount );
-                status = EXIT_FAILURE;
+        publishCount = _publishCount++;
 
-                break;
+        /* Pass the PUBLISH number to the operation complete callback. */
+        publishComplete.pCallbackContext = ( void * ) publishCount;
+        IotDemoBench_Dequeued( publishCount, pMessage->stamp.enqueueUs );
+        IotDemoLatency_Dequeued( publishCount, &( pMessage->stamp ) );
+        stageStart = IotDemoBench_Cycles();
+
+        /* Generate the payload for the PUBLISH. */
+        if (pMessage->type == eEventTypeGpio)
+        {
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            PUBLISH_VIB_PAYLOAD_FORMAT,
+                            "\"Vibrating\"" );
+        }
+        else if(pMessage->type == eEventTypeTemp)
+        {
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            PUBLISH_DHT_PAYLOAD_FORMAT,
+                            pMessage->humidity, pMessage->temperature );
+        }
+        else if( pMessage->type == eEventTypePeriod )
+        {
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            PUBLISH_PERIOD_PAYLOAD_FORMAT,
+                            ( unsigned long ) pMessage->periodMs );
+        }
+        else if( pMessage->type == eEventTypeSummary )
+        {
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            PUBLISH_SUMMARY_PAYLOAD_FORMAT,
+                            _statsChannels[ pMessage->channel ],
+                            ( unsigned long ) pMessage->summary.ulCount,
+                            pMessage->summary.fMean / 10.0f,
+                            pMessage->summary.fVariance / 100.0f,
+                            ( float ) pMessage->summary.lMin / 10.0f,
+                            ( float ) pMessage->summary.lMax / 10.0f );
+        }
+        else if( pMessage->type == eEventTypeAnomaly )
+        {
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            PUBLISH_ANOMALY_PAYLOAD_FORMAT,
+                            _statsChannels[ pMessage->channel ],
+                            ( pMessage->channel == STATS_CHANNEL_TEMP ) ? pMessage->temperature : pMessage->humidity,
+                            pMessage->zScore );
+        }
+        else
+        {
+            /* Generate the payload for the PUBLISH. */
+            status = snprintf( pPublishPayload,
+                            PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                            "Failed to get event type." );
+        }
+
+        /* Add the trace ID, if enabled, so that the message can be
+         * followed in the cloud. */
+        if( status > 0 )
+        {
+            status = IotDemoLatency_TagPayload( pPublishPayload,
+                                                PUBLISH_PAYLOAD_BUFFER_LENGTH,
+                                                status,
+                                                &( pMessage->stamp ) );
+        }
+
+        IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_FORMAT, stageStart );
+        IotDemoLatency_Serialized( publishCount );
+
+        /* Check for errors from snprintf. */
+        if( status < 0 )
+        {
+            IotLogError( "Failed to generate MQTT PUBLISH payload for PUBLISH %d.",
+                        ( int ) publishCount );
+
+            if( pInflight != NULL )
+            {
+                __atomic_store_n( &( pInflight->state ), INFLIGHT_FREE, __ATOMIC_RELEASE );
             }
-            else
+
+            if( fromBatch == true )
             {
-                publishInfo.payloadLength = ( size_t ) status;
-                status = EXIT_SUCCESS;
+                xDemoBatchNext++;
             }
 
-            /* PUBLISH a message. This is an asynchronous function that notifies of
-            * completion through a callback. */
-            publishStatus = IotMqtt_Publish( mqttConnection,
-                                            &publishInfo,
-                                            0,
-                                            &publishComplete,
-                                            NULL );
+            status = EXIT_FAILURE;
+
+            break;
+        }
+        else
+        {
+            publishInfo.payloadLength = ( size_t ) status;
+            status = EXIT_SUCCESS;
+        }
+
+        /* The completion callback looks the reading up by this number. */
+        if( pInflight != NULL )
+        {
+            pInflight->publishCount = publishCount;
+            __atomic_store_n( &( pInflight->state ), INFLIGHT_SENT, __ATOMIC_RELEASE );
+        }
+
+        /* PUBLISH a message. This is an asynchronous function that notifies of
+        * completion through a callback; at QoS 0 there is nothing to notify. */
+        stageStart = IotDemoBench_Cycles();
+        IotDemoLatency_Publishing( publishCount );
+        SchedTrace_SpanBegin( "publish" );
+        publishStatus = IotMqtt_Publish( mqttConnection,
+                                        &publishInfo,
+                                        0,
+                                        ( publishInfo.qos == IOT_MQTT_QOS_0 ) ? NULL : &publishComplete,
+                                        NULL );
+        SchedTrace_SpanEnd( "publish" );
+        BootProfile_Mark( "first_publish" );
+
+        /* Startup is over; from here on the heap should be left alone. */
+        AllocWatch_Start();
+
+        if( publishCount == IOT_DEMO_MQTT_ALLOC_CHECK_PUBLISHES )
+        {
+            AllocWatch_Report();
+        }
 
-            if( publishStatus != IOT_MQTT_STATUS_PENDING )
+        #if democonfigSTACK_BUDGET == 1
+            if( publishCount == IOT_DEMO_MQTT_STACK_BUDGET_PUBLISHES )
             {
-                IotLogError( "MQTT PUBLISH %d returned error %s.",
-                            ( int ) publishCount,
-                            IotMqtt_strerror( publishStatus ) );
-                status = EXIT_FAILURE;
+                StackBudget_Report();
+            }
+        #endif
 
-                break;
+        IotDemoLatency_Published( publishCount );
+        IotDemoBench_StageEnd( IOT_DEMO_BENCH_STAGE_PUBLISH, stageStart );
+        IotDemoLatency_Report( publishCount );
+        IotDemoTrace_Publish( publishCount, publishInfo.payloadLength );
+        SchedTrace_Poll();
+
+        if( ( publishStatus != IOT_MQTT_STATUS_PENDING ) && ( publishStatus != IOT_MQTT_SUCCESS ) )
+        {
+            /* The reading stays in the batch, or in flight, for the next
+             * connection. */
+            IotLogError( "MQTT PUBLISH %d returned error %s.",
+                        ( int ) publishCount,
+                        IotMqtt_strerror( publishStatus ) );
+
+            if( pInflight != NULL )
+            {
+                __atomic_store_n( &( pInflight->state ),
+                                  ( fromBatch == true ) ? INFLIGHT_FREE : INFLIGHT_FAILED,
+                                  __ATOMIC_RELEASE );
             }
 
-            /* Stop publishing if there was an error. */
-            if( status == EXIT_FAILURE )
+            /* The disconnect callback may not have run yet. */
+            if( publishStatus == IOT_MQTT_NETWORK_ERROR )
             {
-                break;
+                __atomic_store_n( &_connectionLost, true, __ATOMIC_RELEASE );
             }
+
+            status = EXIT_FAILURE;
+
+            break;
+        }
+
+        IotDemoFault_ReadingPublished( fromBatch == false );
+
+        /* Nothing more will be heard of a PUBLISH at QoS 0. */
+        if( pInflight == NULL )
+        {
+            IotDemoFault_ReadingAcked();
+        }
+
+        if( fromBatch == true )
+        {
+            xDemoBatchNext++;
         }
     }
 
@@ -753,8 +2206,54 @@ static int _publishAllMessages( IotMqttConnection_t mqttConnection,
 
 /*-----------------------------------------------------------*/
 
+#if democonfigSTACK_BUDGET == 1
+
 /**
- * @brief The function that runs the MQTT demo, called by the demo runner.
+ * @brief Send a message of IOT_DEMO_MQTT_STACK_BUDGET_PROBE_SIZE bytes to
+ * the demo's own subscription, so that the stack budget covers the receive
+ * path with a large payload.
+ *
+ * The "led" key comes last, so that the command dispatcher walks the whole
+ * payload, and the ack is sent from the receive path.
+ *
+ * @param[in] mqttConnection The MQTT connection to use for publishing.
+ * @param[in] pSubscribeTopic The topic the demo subscribed to.
+ */
+    static void _publishStackBudgetProbe( IotMqttConnection_t mqttConnection,
+                                          const char * pSubscribeTopic )
+    {
+        /* Static, so that the buffer does not count against the stack. */
+        static char pProbePayload[ IOT_DEMO_MQTT_STACK_BUDGET_PROBE_SIZE ];
+        static const char pProbeHead[] = "{\"pad\":\"";
+        static const char pProbeTail[] = "\",\"led\":\"off\"}";
+        IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+        size_t padLength = sizeof( pProbePayload ) - ( sizeof( pProbeHead ) - 1 ) - ( sizeof( pProbeTail ) - 1 );
+
+        memcpy( pProbePayload, pProbeHead, sizeof( pProbeHead ) - 1 );
+        memset( pProbePayload + sizeof( pProbeHead ) - 1, 'x', padLength );
+        memcpy( pProbePayload + sizeof( pProbeHead ) - 1 + padLength, pProbeTail, sizeof( pProbeTail ) - 1 );
+
+        publishInfo.qos = IOT_MQTT_QOS_0;
+        publishInfo.pTopicName = pSubscribeTopic;
+        publishInfo.topicNameLength = TOPIC_FILTER_LENGTH;
+        publishInfo.pPayload = pProbePayload;
+        publishInfo.payloadLength = sizeof( pProbePayload );
+
+        if( IotMqtt_TimedPublish( mqttConnection,
+                                  &publishInfo,
+                                  0,
+                                  MQTT_TIMEOUT_MS ) != IOT_MQTT_SUCCESS )
+        {
+            IotLogWarn( "Stack budget: the large message could not be sent." );
+        }
+    }
+
+#endif /* if democonfigSTACK_BUDGET == 1 */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the MQTT demo, in a task on the network core.
  *
  * @param[in] awsIotMqttMode Specify if this demo is running with the AWS IoT
  * MQTT server. Set this to `false` if using another MQTT server.
@@ -767,11 +2266,11 @@ static int _publishAllMessages( IotMqttConnection_t mqttConnection,
  *
  * @return `EXIT_SUCCESS` if the demo completes successfully; `EXIT_FAILURE` otherwise.
  */
-int RunMqttDemo( bool awsIotMqttMode,
-                 const char * pIdentifier,
-                 void * pNetworkServerInfo,
-                 void * pNetworkCredentialInfo,
-                 const IotNetworkInterface_t * pNetworkInterface )
+static int _runMqttDemo( bool awsIotMqttMode,
+                        const char * pIdentifier,
+                        void * pNetworkServerInfo,
+                        void * pNetworkCredentialInfo,
+                        const IotNetworkInterface_t * pNetworkInterface )
 {
     /* Return value of this function and the exit status of this program. */
     int status = EXIT_SUCCESS;
@@ -787,11 +2286,52 @@ int RunMqttDemo( bool awsIotMqttMode,
 
     const char * pSubscribeTopic = IOT_DEMO_MQTT_TOPIC_PREFIX "/topic/sub";
 
+    /* The filters subscribed to. The router passes what arrives to the
+     * handlers of its topic. */
+    const char * const pSubscribeFilters[ TOPIC_FILTER_COUNT ] =
+    {
+        pSubscribeTopic,
+        COMMAND_TOPIC_PREFIX "#"
+    };
+
     /* Flags for tracking which cleanup functions must be called. */
     bool librariesInitialized = false, connectionEstablished = false;
 
+    /* Reconnects since the last one that got as far as publishing. */
+    int reconnectAttempts = 0;
+
+    #if IOT_DEMO_MQTT_LOOPBACK == 1
+        /* Measure the pipeline, or its response to faults, against the
+         * in-process broker stand-in. */
+        pNetworkInterface = IotDemoLoopbackBroker_GetInterface();
+        pNetworkServerInfo = IotDemoLoopbackBroker_GetServerInfo();
+        pNetworkCredentialInfo = NULL;
+    #endif
+
+    BootProfile_Mark( "demo_start" );
+
     /* Initialize the libraries required for this demo. */
     status = _initializeDemo();
+    BootProfile_Mark( "libraries" );
+
+    TlsSessionCache_Init();
+
+    if( DLog_Init() != 0 )
+    {
+        IotLogWarn( "Failed to start the deferred log task." );
+    }
+
+    #if IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1
+        /* Every reading goes to the same topic, with the QoS and retain flag
+         * set in _publishAllMessages. */
+        if( IotDemoPublishTemplate_Add( pPublishTopic,
+                                        TOPIC_FILTER_LENGTH,
+                                        IOT_MQTT_QOS_1,
+                                        false ) == false )
+        {
+            IotLogWarn( "No PUBLISH template; publishes are serialized in full." );
+        }
+    #endif
 
     gpio_config_t gpio14_conf = {
         .pin_bit_mask = GPIO_SEL_14,
@@ -802,8 +2342,6 @@ int RunMqttDemo( bool awsIotMqttMode,
     };
     gpio_config(&gpio14_conf);
     gpio_set_intr_type(GPIO_NUM_14, GPIO_INTR_POSEDGE);
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(GPIO_NUM_14, gpio_isr_handler, (void*) GPIO_NUM_14);
 
 	setDHTgpio(25);
 
@@ -817,17 +2355,98 @@ int RunMqttDemo( bool awsIotMqttMode,
     gpio_config(&gpio13_conf);
     gpio_set_level(GPIO_NUM_13, 1);
 
-    xDemoQueue = xQueueCreate(10, sizeof(DemoTaskMessage_t));
+    /* This task consumes the ring; it must be known before the first push. */
+    ( void ) SpscRing_Init( &xDemoRing,
+                            xDemoRingItems,
+                            sizeof( DemoTaskMessage_t ),
+                            IOT_DEMO_MQTT_RING_LENGTH );
+    xConsumerTask = xTaskGetCurrentTaskHandle();
+
+    /* In the benchmark, the benchmark task is the producer instead; the
+     * vibration interrupt is not installed. */
+    #if IOT_DEMO_MQTT_BENCHMARK == 0
+        if( xSamplingTask == NULL )
+        {
+            #if democonfigSTATIC_ALLOCATION == 1
+                xSamplingTask = xTaskCreateStaticPinnedToCore( _samplingTask,
+                                                               "DemoSampling",
+                                                               IOT_DEMO_MQTT_SAMPLING_STACK_SIZE,
+                                                               NULL,
+                                                               IOT_DEMO_MQTT_SAMPLING_PRIORITY,
+                                                               xSamplingTaskStack,
+                                                               &xSamplingTaskBuffer,
+                                                               IOT_DEMO_MQTT_SAMPLING_CORE );
+            #else
+                ( void ) xTaskCreatePinnedToCore( _samplingTask,
+                                                  "DemoSampling",
+                                                  IOT_DEMO_MQTT_SAMPLING_STACK_SIZE,
+                                                  NULL,
+                                                  IOT_DEMO_MQTT_SAMPLING_PRIORITY,
+                                                  &xSamplingTask,
+                                                  IOT_DEMO_MQTT_SAMPLING_CORE );
+            #endif
+
+            if( xSamplingTask == NULL )
+            {
+                IotLogError( "Failed to create the sampling task." );
+                status = EXIT_FAILURE;
+            }
+            else
+            {
+                StackBudget_Register( xSamplingTask, "IOT_DEMO_MQTT_SAMPLING_STACK_SIZE", IOT_DEMO_MQTT_SAMPLING_STACK_SIZE );
+                ( void ) xTaskNotify( xSamplingTask, SAMPLING_NOTIFY_START, eSetBits );
+            }
+        }
+    #endif
 
     if( xRequestTimer == NULL )
     {
-        xRequestTimer = xTimerCreate( pcTimerName,
-                                      pdMS_TO_TICKS( 3000 ),
-                                      pdTRUE,
-                                      NULL,
-                                      prvRequestTimer_Callback );
+        #if democonfigSTATIC_ALLOCATION == 1
+            xRequestTimer = xTimerCreateStatic( pcTimerName,
+                                                pdMS_TO_TICKS( _settings.periodMs ),
+                                                pdTRUE,
+                                                NULL,
+                                                prvRequestTimer_Callback,
+                                                &xRequestTimerBuffer );
+        #else
+            xRequestTimer = xTimerCreate( pcTimerName,
+                                          pdMS_TO_TICKS( _settings.periodMs ),
+                                          pdTRUE,
+                                          NULL,
+                                          prvRequestTimer_Callback );
+        #endif
     }
 
+    BootProfile_Mark( "gpio" );
+
+    /* The DHT22 needs time after power-up before its first reading. That
+     * wait overlaps the connection, and the reading is queued so that it is
+     * published as soon as the connection is ready. */
+    #if IOT_DEMO_MQTT_BENCHMARK == 0
+        if( xWarmupTimer == NULL )
+        {
+            #if democonfigSTATIC_ALLOCATION == 1
+                xWarmupTimer = xTimerCreateStatic( "DemoWarmup",
+                                                   pdMS_TO_TICKS( IOT_DEMO_MQTT_SENSOR_WARMUP_MS ),
+                                                   pdFALSE,
+                                                   NULL,
+                                                   prvRequestTimer_Callback,
+                                                   &xWarmupTimerBuffer );
+            #else
+                xWarmupTimer = xTimerCreate( "DemoWarmup",
+                                             pdMS_TO_TICKS( IOT_DEMO_MQTT_SENSOR_WARMUP_MS ),
+                                             pdFALSE,
+                                             NULL,
+                                             prvRequestTimer_Callback );
+            #endif
+        }
+
+        if( ( xWarmupTimer == NULL ) || ( xTimerStart( xWarmupTimer, 0 ) != pdPASS ) )
+        {
+            IotLogWarn( "First reading waits for the %s timer.", pcTimerName );
+        }
+    #endif
+
     if( status == EXIT_SUCCESS )
     {
         /* Mark the libraries as initialized. */
@@ -846,12 +2465,19 @@ int RunMqttDemo( bool awsIotMqttMode,
     {
         /* Mark the MQTT connection as established. */
         connectionEstablished = true;
+        BootProfile_Mark( "connected" );
 
         /* Add the topic filter subscriptions used in this demo. */
+        status = _addRoutes( pIdentifier, pSubscribeTopic, &publishesReceived );
+    }
+
+    if( status == EXIT_SUCCESS )
+    {
         status = _modifySubscriptions( mqttConnection,
                                        IOT_MQTT_SUBSCRIBE,
-                                       pSubscribeTopic,
-                                       &publishesReceived );
+                                       pSubscribeFilters,
+                                       &_router );
+        BootProfile_Mark( "subscribed" );
     }
 
     if( status == EXIT_SUCCESS )
@@ -861,11 +2487,72 @@ int RunMqttDemo( bool awsIotMqttMode,
                                  0,
                                  IOT_DEMO_MQTT_PUBLISH_BURST_SIZE ) == true )
         {
+            #if democonfigSTACK_BUDGET == 1
+                _publishStackBudgetProbe( mqttConnection, pSubscribeTopic );
+            #endif
+
             /* PUBLISH (and wait) for all messages. */
+            _startProducer();
             status = _publishAllMessages( mqttConnection,
                                           pPublishTopic,
                                           &publishesReceived );
 
+            /* When the connection is lost, or connecting again failed,
+             * connect again and go on from the first reading not published.
+             * The TLS session is resumed, so a reconnect skips the full
+             * handshake. Only attempts in a row count against the limit. */
+            while( ( status == EXIT_FAILURE ) &&
+                   ( reconnectAttempts < IOT_DEMO_MQTT_RECONNECT_LIMIT ) &&
+                   ( ( connectionEstablished == false ) ||
+                     ( __atomic_load_n( &_connectionLost, __ATOMIC_ACQUIRE ) == true ) ) )
+            {
+                reconnectAttempts++;
+                IotLogWarn( "Reconnecting in %d ms, attempt %d of %d.",
+                            IOT_DEMO_MQTT_RECONNECT_DELAY_MS,
+                            reconnectAttempts,
+                            IOT_DEMO_MQTT_RECONNECT_LIMIT );
+
+                if( connectionEstablished == true )
+                {
+                    IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+                    connectionEstablished = false;
+                }
+
+                vTaskDelay( pdMS_TO_TICKS( IOT_DEMO_MQTT_RECONNECT_DELAY_MS ) );
+
+                status = _establishMqttConnection( awsIotMqttMode,
+                                                   pIdentifier,
+                                                   pNetworkServerInfo,
+                                                   pNetworkCredentialInfo,
+                                                   pNetworkInterface,
+                                                   &mqttConnection );
+
+                if( status == EXIT_SUCCESS )
+                {
+                    connectionEstablished = true;
+                    status = _modifySubscriptions( mqttConnection,
+                                                   IOT_MQTT_SUBSCRIBE,
+                                                   pSubscribeFilters,
+                                                   &_router );
+
+                    /* Without its subscriptions the connection is no use;
+                     * drop it so that the next attempt starts afresh. */
+                    if( status == EXIT_FAILURE )
+                    {
+                        IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+                        connectionEstablished = false;
+                    }
+                }
+
+                if( status == EXIT_SUCCESS )
+                {
+                    reconnectAttempts = 0;
+                    status = _publishAllMessages( mqttConnection,
+                                                  pPublishTopic,
+                                                  &publishesReceived );
+                }
+            }
+
             /* Destroy the incoming PUBLISH counter. */
             IotSemaphore_Destroy( &publishesReceived );
         }
@@ -881,7 +2568,7 @@ int RunMqttDemo( bool awsIotMqttMode,
         /* Remove the topic subscription filters used in this demo. */
         status = _modifySubscriptions( mqttConnection,
                                        IOT_MQTT_UNSUBSCRIBE,
-                                       pSubscribeTopic,
+                                       pSubscribeFilters,
                                        NULL );
     }
 
@@ -891,6 +2578,10 @@ int RunMqttDemo( bool awsIotMqttMode,
         IotMqtt_Disconnect( mqttConnection, 0 );
     }
 
+    IotDemoFault_Print();
+    IotDemoCork_Print();
+    SchedTrace_Dump();
+
     /* Clean up libraries if they were initialized. */
     if( librariesInitialized == true )
     {
@@ -901,3 +2592,107 @@ int RunMqttDemo( bool awsIotMqttMode,
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Entry point of #_networkTask.
+ */
+static void _networkTask( void * pArgument )
+{
+    _demoArguments_t * pArguments = ( _demoArguments_t * ) pArgument;
+
+    StackBudget_Register( NULL, "IOT_DEMO_MQTT_NETWORK_STACK_SIZE", IOT_DEMO_MQTT_NETWORK_STACK_SIZE );
+
+    pArguments->status = _runMqttDemo( pArguments->awsIotMqttMode,
+                                       pArguments->pIdentifier,
+                                       pArguments->pNetworkServerInfo,
+                                       pArguments->pNetworkCredentialInfo,
+                                       pArguments->pNetworkInterface );
+
+    StackBudget_TaskExit();
+    xTaskNotifyGive( pArguments->caller );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The function that runs the MQTT demo, called by the demo runner.
+ *
+ * The demo runner task has no core affinity. The demo, and with it MQTT
+ * and TLS, runs in a task pinned to IOT_DEMO_MQTT_NETWORK_CORE, where the
+ * WiFi and TCP/IP tasks of ESP-IDF already are. The runner waits for it.
+ *
+ * @param[in] awsIotMqttMode Specify if this demo is running with the AWS IoT
+ * MQTT server. Set this to `false` if using another MQTT server.
+ * @param[in] pIdentifier NULL-terminated MQTT client identifier.
+ * @param[in] pNetworkServerInfo Passed to the MQTT connect function when
+ * establishing the MQTT connection.
+ * @param[in] pNetworkCredentialInfo Passed to the MQTT connect function when
+ * establishing the MQTT connection.
+ * @param[in] pNetworkInterface The network interface to use for this demo.
+ *
+ * @return `EXIT_SUCCESS` if the demo completes successfully; `EXIT_FAILURE` otherwise.
+ */
+int RunMqttDemo( bool awsIotMqttMode,
+                 const char * pIdentifier,
+                 void * pNetworkServerInfo,
+                 void * pNetworkCredentialInfo,
+                 const IotNetworkInterface_t * pNetworkInterface )
+{
+    _demoArguments_t arguments =
+    {
+        .awsIotMqttMode         = awsIotMqttMode,
+        .pIdentifier            = pIdentifier,
+        .pNetworkServerInfo     = pNetworkServerInfo,
+        .pNetworkCredentialInfo = pNetworkCredentialInfo,
+        .pNetworkInterface      = pNetworkInterface,
+        .caller                 = xTaskGetCurrentTaskHandle(),
+        .status                 = EXIT_FAILURE
+    };
+
+    TaskHandle_t networkTask = NULL;
+
+    /* The runner was created with democonfigDEMO_STACKSIZE. */
+    StackBudget_Register( NULL, "democonfigDEMO_STACKSIZE", democonfigDEMO_STACKSIZE );
+
+    #if democonfigSTATIC_ALLOCATION == 1
+        networkTask = xTaskCreateStaticPinnedToCore( _networkTask,
+                                                     "MqttDemo",
+                                                     IOT_DEMO_MQTT_NETWORK_STACK_SIZE,
+                                                     &arguments,
+                                                     uxTaskPriorityGet( NULL ),
+                                                     xNetworkTaskStack,
+                                                     &xNetworkTaskBuffer,
+                                                     IOT_DEMO_MQTT_NETWORK_CORE );
+    #else
+        ( void ) xTaskCreatePinnedToCore( _networkTask,
+                                          "MqttDemo",
+                                          IOT_DEMO_MQTT_NETWORK_STACK_SIZE,
+                                          &arguments,
+                                          uxTaskPriorityGet( NULL ),
+                                          &networkTask,
+                                          IOT_DEMO_MQTT_NETWORK_CORE );
+    #endif
+
+    if( networkTask == NULL )
+    {
+        IotLogWarn( "Failed to create the network task; running on any core." );
+
+        arguments.status = _runMqttDemo( awsIotMqttMode,
+                                         pIdentifier,
+                                         pNetworkServerInfo,
+                                         pNetworkCredentialInfo,
+                                         pNetworkInterface );
+    }
+    else
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+    }
+
+    /* The runner may delete itself once the demo returns. */
+    StackBudget_TaskExit();
+
+    return arguments.status;
+}
+
+/*-----------------------------------------------------------*/
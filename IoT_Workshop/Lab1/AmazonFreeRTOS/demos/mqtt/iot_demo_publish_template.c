@@ -0,0 +1,328 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file iot_demo_publish_template.c
+ * @brief Pre-serialized PUBLISH packets for fixed topics.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_publish_template.h"
+
+#if IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1
+
+/* Standard includes. */
+    #include <string.h>
+
+/* The library's own serializer, for the packets templates do not cover. */
+    #include "private/iot_mqtt_internal.h"
+
+    #if ( IOT_DEMO_PUBLISH_TEMPLATE_PACKETS < 1 ) || ( IOT_DEMO_PUBLISH_TEMPLATE_PACKETS > 32 )
+        #error "IOT_DEMO_PUBLISH_TEMPLATE_PACKETS must be between 1 and 32."
+    #endif
+
+/**
+ * @brief Where the topic name starts in a pooled packet: after the fixed
+ * header byte and the longest remaining length (4 bytes). A shorter
+ * remaining length moves the start of the packet, not the topic.
+ */
+    #define TOPIC_OFFSET    ( 5 )
+
+/**
+ * @brief Packet identifiers are ( generation << SLOT_BITS | slot ) << 1,
+ * where slot numbers the packet across all pools.
+ */
+    #define SLOT_BITS       ( 6 )
+
+    #if IOT_DEMO_PUBLISH_TEMPLATE_MAX * IOT_DEMO_PUBLISH_TEMPLATE_PACKETS > ( 1 << SLOT_BITS )
+        #error "At most 64 packets in all template pools."
+    #endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A topic with its pool of packets.
+ */
+    typedef struct _publishTemplate
+    {
+        const char * pTopicName;
+        uint16_t topicNameLength;
+        IotMqttQos_t qos;
+        bool retain;
+        uint8_t fixedHeader;     /**< PUBLISH type, QoS and retain bits. */
+        size_t variableLength;   /**< Topic name, its length and the packet identifier. */
+        size_t payloadCapacity;  /**< Largest payload that fits a packet. */
+        uint32_t firstSlot;      /**< Slot of packet 0. */
+        uint32_t freePackets;    /**< Bit n is set while packet n is free. */
+        uint16_t generation[ IOT_DEMO_PUBLISH_TEMPLATE_PACKETS ]; /**< Uses of packet n; only its holder touches it. */
+        uint8_t packets[ IOT_DEMO_PUBLISH_TEMPLATE_PACKETS ][ IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE ];
+    } _publishTemplate_t;
+
+    static _publishTemplate_t _templates[ IOT_DEMO_PUBLISH_TEMPLATE_MAX ];
+    static uint32_t _templateCount = 0;
+
+/*-----------------------------------------------------------*/
+
+    static _publishTemplate_t * _findTemplate( const IotMqttPublishInfo_t * pPublishInfo )
+    {
+        uint32_t count = __atomic_load_n( &_templateCount, __ATOMIC_ACQUIRE ), i = 0;
+        _publishTemplate_t * pTemplate = NULL;
+
+        for( i = 0; i < count; i++ )
+        {
+            pTemplate = &( _templates[ i ] );
+
+            if( ( pTemplate->qos == pPublishInfo->qos ) &&
+                ( pTemplate->retain == pPublishInfo->retain ) &&
+                ( pTemplate->topicNameLength == pPublishInfo->topicNameLength ) &&
+                ( ( pTemplate->pTopicName == pPublishInfo->pTopicName ) ||
+                  ( memcmp( pTemplate->pTopicName, pPublishInfo->pTopicName, pTemplate->topicNameLength ) == 0 ) ) )
+            {
+                return pTemplate;
+            }
+        }
+
+        return NULL;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint8_t * _takePacket( _publishTemplate_t * pTemplate,
+                                  uint32_t * pIndex )
+    {
+        uint32_t freePackets = __atomic_load_n( &( pTemplate->freePackets ), __ATOMIC_ACQUIRE );
+        uint32_t index = 0;
+
+        do
+        {
+            if( freePackets == 0 )
+            {
+                return NULL;
+            }
+
+            index = ( uint32_t ) __builtin_ctz( freePackets );
+        } while( __atomic_compare_exchange_n( &( pTemplate->freePackets ), &freePackets, freePackets & ~( 1UL << index ),
+                                              false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) == false );
+
+        *pIndex = index;
+
+        return pTemplate->packets[ index ];
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint16_t _packetIdentifier( _publishTemplate_t * pTemplate,
+                                       uint32_t index )
+    {
+        uint16_t packetIdentifier = 0;
+
+        /* Even, and never 0. A packet stays taken until the library frees
+         * it, after its PUBACK for QoS 1, so the slot alone keeps the
+         * identifier unique while in use; the generation only varies it
+         * from one use of the packet to the next. No lock is needed as the
+         * holder of the packet is the only one to touch its generation. */
+        do
+        {
+            pTemplate->generation[ index ]++;
+            packetIdentifier = ( uint16_t ) ( ( ( ( uint32_t ) pTemplate->generation[ index ] << SLOT_BITS ) |
+                                                ( pTemplate->firstSlot + index ) ) << 1 );
+        } while( packetIdentifier == 0 );
+
+        return packetIdentifier;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static IotMqttError_t _serializePublish( const IotMqttPublishInfo_t * pPublishInfo,
+                                             uint8_t ** pPublishPacket,
+                                             size_t * pPacketSize,
+                                             uint16_t * pPacketIdentifier,
+                                             uint8_t ** pPacketIdentifierHigh )
+    {
+        _publishTemplate_t * pTemplate = _findTemplate( pPublishInfo );
+        uint8_t * pPacket = NULL, * pStart = NULL, * pIdentifier = NULL;
+        uint8_t remainingLengthBytes[ 4 ];
+        size_t remainingLength = 0, remainingLengthSize = 0;
+        uint32_t index = 0;
+        uint16_t packetIdentifier = 0;
+
+        if( ( pTemplate != NULL ) && ( pPublishInfo->payloadLength <= pTemplate->payloadCapacity ) )
+        {
+            pPacket = _takePacket( pTemplate, &index );
+        }
+
+        if( pPacket == NULL )
+        {
+            return _IotMqtt_SerializePublish( pPublishInfo,
+                                              pPublishPacket,
+                                              pPacketSize,
+                                              pPacketIdentifier,
+                                              pPacketIdentifierHigh );
+        }
+
+        /* Remaining length, 7 bits per byte, low bits first. */
+        remainingLength = pTemplate->variableLength + pPublishInfo->payloadLength;
+
+        do
+        {
+            remainingLengthBytes[ remainingLengthSize ] = ( uint8_t ) ( remainingLength & 0x7f );
+            remainingLength >>= 7;
+
+            if( remainingLength > 0 )
+            {
+                remainingLengthBytes[ remainingLengthSize ] |= 0x80;
+            }
+
+            remainingLengthSize++;
+        } while( remainingLength > 0 );
+
+        pStart = pPacket + TOPIC_OFFSET - 1 - remainingLengthSize;
+        pStart[ 0 ] = pTemplate->fixedHeader;
+        memcpy( pStart + 1, remainingLengthBytes, remainingLengthSize );
+
+        /* The topic name and its length were written by IotDemoPublishTemplate_Add. */
+        pIdentifier = pPacket + TOPIC_OFFSET + 2 + pTemplate->topicNameLength;
+
+        if( pTemplate->qos != IOT_MQTT_QOS_0 )
+        {
+            packetIdentifier = _packetIdentifier( pTemplate, index );
+            pIdentifier[ 0 ] = ( uint8_t ) ( packetIdentifier >> 8 );
+            pIdentifier[ 1 ] = ( uint8_t ) ( packetIdentifier & 0xff );
+
+            if( pPacketIdentifierHigh != NULL )
+            {
+                *pPacketIdentifierHigh = pIdentifier;
+            }
+
+            pIdentifier += 2;
+        }
+
+        memcpy( pIdentifier, pPublishInfo->pPayload, pPublishInfo->payloadLength );
+
+        *pPublishPacket = pStart;
+        *pPacketSize = ( size_t ) ( pIdentifier + pPublishInfo->payloadLength - pStart );
+        *pPacketIdentifier = packetIdentifier;
+
+        return IOT_MQTT_SUCCESS;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _freePacket( uint8_t * pPacket )
+    {
+        uint32_t count = __atomic_load_n( &_templateCount, __ATOMIC_ACQUIRE ), i = 0, index = 0;
+        _publishTemplate_t * pTemplate = NULL;
+
+        for( i = 0; i < count; i++ )
+        {
+            pTemplate = &( _templates[ i ] );
+
+            if( ( pPacket >= pTemplate->packets[ 0 ] ) &&
+                ( pPacket < pTemplate->packets[ IOT_DEMO_PUBLISH_TEMPLATE_PACKETS - 1 ] + IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE ) )
+            {
+                index = ( uint32_t ) ( ( size_t ) ( pPacket - pTemplate->packets[ 0 ] ) / IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE );
+                ( void ) __atomic_fetch_or( &( pTemplate->freePackets ), 1UL << index, __ATOMIC_RELEASE );
+
+                return;
+            }
+        }
+
+        _IotMqtt_FreePacket( pPacket );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static const IotMqttSerializer_t _serializer =
+    {
+        .freePacket        = _freePacket,
+        .serialize.publish = _serializePublish
+    };
+
+/*-----------------------------------------------------------*/
+
+    bool IotDemoPublishTemplate_Add( const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     IotMqttQos_t qos,
+                                     bool retain )
+    {
+        IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+        _publishTemplate_t * pTemplate = NULL;
+        size_t headerLength = 0;
+        uint32_t i = 0;
+
+        publishInfo.qos = qos;
+        publishInfo.retain = retain;
+        publishInfo.pTopicName = pTopicName;
+        publishInfo.topicNameLength = topicNameLength;
+
+        if( _findTemplate( &publishInfo ) != NULL )
+        {
+            return true;
+        }
+
+        headerLength = TOPIC_OFFSET + 2 + topicNameLength + ( ( qos == IOT_MQTT_QOS_0 ) ? 0 : 2 );
+
+        if( ( _templateCount >= IOT_DEMO_PUBLISH_TEMPLATE_MAX ) ||
+            ( headerLength >= IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE ) )
+        {
+            return false;
+        }
+
+        pTemplate = &( _templates[ _templateCount ] );
+        pTemplate->pTopicName = pTopicName;
+        pTemplate->topicNameLength = topicNameLength;
+        pTemplate->qos = qos;
+        pTemplate->retain = retain;
+        pTemplate->fixedHeader = ( uint8_t ) ( 0x30 | ( ( uint8_t ) qos << 1 ) | ( retain ? 0x01 : 0x00 ) );
+        pTemplate->variableLength = headerLength - TOPIC_OFFSET;
+        pTemplate->payloadCapacity = IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE - headerLength;
+        pTemplate->firstSlot = _templateCount * IOT_DEMO_PUBLISH_TEMPLATE_PACKETS;
+
+        for( i = 0; i < IOT_DEMO_PUBLISH_TEMPLATE_PACKETS; i++ )
+        {
+            pTemplate->packets[ i ][ TOPIC_OFFSET ] = ( uint8_t ) ( topicNameLength >> 8 );
+            pTemplate->packets[ i ][ TOPIC_OFFSET + 1 ] = ( uint8_t ) ( topicNameLength & 0xff );
+            memcpy( &( pTemplate->packets[ i ][ TOPIC_OFFSET + 2 ] ), pTopicName, topicNameLength );
+        }
+
+        pTemplate->freePackets = ( uint32_t ) ( 0xFFFFFFFFULL >> ( 32 - IOT_DEMO_PUBLISH_TEMPLATE_PACKETS ) );
+
+        /* Publish the template only once it is complete. */
+        __atomic_store_n( &_templateCount, _templateCount + 1, __ATOMIC_RELEASE );
+
+        return true;
+    }
+
+/*-----------------------------------------------------------*/
+
+    const IotMqttSerializer_t * IotDemoPublishTemplate_Serializer( void )
+    {
+        return &_serializer;
+    }
+
+#endif /* if IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1 */
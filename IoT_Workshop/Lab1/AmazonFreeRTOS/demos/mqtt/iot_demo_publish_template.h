@@ -0,0 +1,133 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file iot_demo_publish_template.h
+ * @brief Pre-serialized PUBLISH packets for fixed topics.
+ *
+ * The MQTT library serializes every PUBLISH from scratch: it sizes the
+ * packet, allocates it, and encodes the fixed header, the topic name and a
+ * packet identifier before copying the payload. For a topic that never
+ * changes, all of that but the remaining length and the packet identifier
+ * is the same every time.
+ *
+ * A template encodes its topic name once into each packet of a small pool
+ * of its own. Its PUBLISH serializer, installed through the serializer
+ * overrides of the MQTT library, then only writes the fixed header, the
+ * remaining length and the packet identifier around the topic, and copies
+ * the payload after it. Any other PUBLISH (another topic or QoS, a payload
+ * too large for the pool, or no free packet) is left to the library's own
+ * serializer, as are all other packet types.
+ *
+ * The library numbers its packets with odd identifiers; templates use even
+ * ones, so that the two never collide.
+ *
+ * Needs `IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES` set to 1 in iot_config.h.
+ * tools/publish_template_bench.c compares the cost per message of the two
+ * serializers on a host.
+ */
+
+#ifndef IOT_DEMO_PUBLISH_TEMPLATE_H_
+#define IOT_DEMO_PUBLISH_TEMPLATE_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+/**
+ * @brief Set to 1 to publish to the demo topic through a template.
+ *
+ * Off by default: the templates take over packet identifiers from the
+ * library, and have only been timed against a model of its serializer
+ * (tools/publish_template_bench.c), with no gain on glibc. Turn them on
+ * once they measure faster than the library's serializer on the device.
+ */
+#ifndef IOT_DEMO_MQTT_PUBLISH_TEMPLATE
+    #define IOT_DEMO_MQTT_PUBLISH_TEMPLATE    ( 0 )
+#endif
+
+#if ( IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1 ) && \
+    ( !defined( IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES ) || ( IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 0 ) )
+    #error "IOT_DEMO_MQTT_PUBLISH_TEMPLATE requires IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES."
+#endif
+
+#if IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1
+
+/**
+ * @brief Templates kept; later ones are refused.
+ */
+    #ifndef IOT_DEMO_PUBLISH_TEMPLATE_MAX
+        #define IOT_DEMO_PUBLISH_TEMPLATE_MAX            ( 1 )
+    #endif
+
+/**
+ * @brief Packets in the pool of each template, at most 32. A QoS 1 packet
+ * stays in use until its PUBACK.
+ */
+    #ifndef IOT_DEMO_PUBLISH_TEMPLATE_PACKETS
+        #define IOT_DEMO_PUBLISH_TEMPLATE_PACKETS        ( 8 )
+    #endif
+
+/**
+ * @brief Size of each packet, headers included.
+ */
+    #ifndef IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE
+        #define IOT_DEMO_PUBLISH_TEMPLATE_PACKET_SIZE    ( 256 )
+    #endif
+
+/**
+ * @brief Add a template for PUBLISH packets with these topic and options.
+ *
+ * Must be called before the first PUBLISH it applies to, while no other
+ * task publishes.
+ *
+ * @param[in] pTopicName Topic name; must stay valid while connected.
+ * @param[in] topicNameLength Length of pTopicName.
+ * @param[in] qos QoS of the packets.
+ * @param[in] retain Retain flag of the packets.
+ *
+ * @return `true` if the template was added or already existed; `false` if
+ * there is no room for it, or the topic leaves no room for a payload.
+ */
+    bool IotDemoPublishTemplate_Add( const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     IotMqttQos_t qos,
+                                     bool retain );
+
+/**
+ * @brief The serializer to set in `IotMqttNetworkInfo_t.pMqttSerializer`.
+ */
+    const IotMqttSerializer_t * IotDemoPublishTemplate_Serializer( void );
+
+#endif /* if IOT_DEMO_MQTT_PUBLISH_TEMPLATE == 1 */
+
+#endif /* ifndef IOT_DEMO_PUBLISH_TEMPLATE_H_ */
@@ -0,0 +1,309 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_tls_metrics.c
+ * @brief Connection setup timing for the network interface used by the demos.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* Set up logging for this demo. */
+#include "iot_demo_logging.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_network_freertos.h"
+
+#include "iot_demo_tls_metrics.h"
+
+/* Driver includes. */
+#include "driver/tls_session_cache.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The interface whose connections are timed.
+ */
+static const IotNetworkInterface_t * _pUnderlyingInterface = NULL;
+
+/**
+ * @brief Statistics of every tracked server.
+ */
+static IotDemoTlsMetrics_t _metrics[ IOT_DEMO_TLS_METRICS_MAX_SERVERS ] = { 0 };
+
+/**
+ * @brief Entry of #_metrics reused next when an untracked server is seen.
+ */
+static size_t _nextEviction = 0;
+
+/*-----------------------------------------------------------*/
+
+static IotDemoTlsMetrics_t * _findServer( const char * pHostName,
+                                          uint16_t port )
+{
+    size_t i = 0;
+
+    for( i = 0; i < IOT_DEMO_TLS_METRICS_MAX_SERVERS; i++ )
+    {
+        if( ( _metrics[ i ].attempts > 0 ) &&
+            ( _metrics[ i ].port == port ) &&
+            ( strncmp( _metrics[ i ].pHostName, pHostName, IOT_DEMO_TLS_METRICS_MAX_HOST_LENGTH - 1 ) == 0 ) )
+        {
+            return &( _metrics[ i ] );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _addTime( IotDemoTlsTimes_t * pTimes,
+                      uint32_t durationMs )
+{
+    if( ( pTimes->count == 0 ) || ( durationMs < pTimes->minMs ) )
+    {
+        pTimes->minMs = durationMs;
+    }
+
+    if( durationMs > pTimes->maxMs )
+    {
+        pTimes->maxMs = durationMs;
+    }
+
+    pTimes->count++;
+    pTimes->totalMs += durationMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _printTimes( const char * pKind,
+                         const IotDemoTlsTimes_t * pTimes )
+{
+    if( pTimes->count > 0 )
+    {
+        IotLogInfo( "    %s %lu: min %lu ms, mean %lu, max %lu.",
+                    pKind,
+                    ( unsigned long ) pTimes->count,
+                    ( unsigned long ) pTimes->minMs,
+                    ( unsigned long ) ( pTimes->totalMs / pTimes->count ),
+                    ( unsigned long ) pTimes->maxMs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _record( const char * pHostName,
+                     uint16_t port,
+                     bool success,
+                     uint32_t durationMs )
+{
+    IotDemoTlsMetrics_t * pMetrics = _findServer( pHostName, port );
+    TlsSessionStats_t sessionStats = { 0 };
+    bool resumed = false;
+
+    if( success == true )
+    {
+        resumed = ( TlsSessionCache_GetStats( pHostName, port, &sessionStats ) == pdPASS ) &&
+                  ( sessionStats.xLastResumed == pdTRUE );
+    }
+
+    if( pMetrics == NULL )
+    {
+        pMetrics = &( _metrics[ _nextEviction ] );
+        _nextEviction = ( _nextEviction + 1 ) % IOT_DEMO_TLS_METRICS_MAX_SERVERS;
+
+        ( void ) memset( pMetrics, 0x00, sizeof( IotDemoTlsMetrics_t ) );
+        ( void ) strncpy( pMetrics->pHostName, pHostName, sizeof( pMetrics->pHostName ) - 1 );
+        pMetrics->port = port;
+    }
+
+    pMetrics->attempts++;
+
+    if( success == true )
+    {
+        pMetrics->lastMs = durationMs;
+        pMetrics->lastResumed = resumed;
+        _addTime( ( resumed == true ) ? &( pMetrics->resumed ) : &( pMetrics->full ), durationMs );
+
+        IotLogInfo( "Connected to %s:%hu in %lu ms, TLS session %s.",
+                    pHostName,
+                    port,
+                    ( unsigned long ) durationMs,
+                    ( resumed == true ) ? "resumed" : "new" );
+    }
+    else
+    {
+        pMetrics->failures++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _timedCreate( void * pConnectionInfo,
+                                       void * pCredentialInfo,
+                                       void ** pConnection )
+{
+    const IotNetworkServerInfo_t * pServerInfo = ( const IotNetworkServerInfo_t * ) pConnectionInfo;
+    IotNetworkError_t status = IOT_NETWORK_SUCCESS;
+    uint64_t startTime = IotClock_GetTimeMs();
+
+    /* The FreeRTOS network create completes the TLS handshake before it
+     * returns, so this is TCP connect plus handshake. */
+    status = _pUnderlyingInterface->create( pConnectionInfo,
+                                            pCredentialInfo,
+                                            pConnection );
+
+    _record( pServerInfo->pHostName,
+             pServerInfo->port,
+             ( status == IOT_NETWORK_SUCCESS ),
+             ( uint32_t ) ( IotClock_GetTimeMs() - startTime ) );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _close( void * pConnection )
+{
+    return _pUnderlyingInterface->close( pConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _send( void * pConnection,
+                     const uint8_t * pMessage,
+                     size_t messageLength )
+{
+    return _pUnderlyingInterface->send( pConnection, pMessage, messageLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _receive( void * pConnection,
+                        uint8_t * pBuffer,
+                        size_t bytesRequested )
+{
+    return _pUnderlyingInterface->receive( pConnection, pBuffer, bytesRequested );
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _setReceiveCallback( void * pConnection,
+                                              IotNetworkReceiveCallback_t receiveCallback,
+                                              void * pContext )
+{
+    return _pUnderlyingInterface->setReceiveCallback( pConnection, receiveCallback, pContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _destroy( void * pConnection )
+{
+    return _pUnderlyingInterface->destroy( pConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The wrapping interface handed to the MQTT library.
+ */
+static const IotNetworkInterface_t _timedInterface =
+{
+    .create             = _timedCreate,
+    .close              = _close,
+    .send               = _send,
+    .receive            = _receive,
+    .setReceiveCallback = _setReceiveCallback,
+    .destroy            = _destroy
+};
+
+/*-----------------------------------------------------------*/
+
+const IotNetworkInterface_t * IotDemoTlsMetrics_WrapInterface( const IotNetworkInterface_t * pNetworkInterface )
+{
+    _pUnderlyingInterface = pNetworkInterface;
+
+    return &_timedInterface;
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotDemoTlsMetrics_Get( const char * pHostName,
+                            uint16_t port,
+                            IotDemoTlsMetrics_t * pMetrics )
+{
+    const IotDemoTlsMetrics_t * pFound = _findServer( pHostName, port );
+
+    if( pFound != NULL )
+    {
+        *pMetrics = *pFound;
+    }
+
+    return ( pFound != NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotDemoTlsMetrics_Print( void )
+{
+    size_t i = 0;
+    uint32_t successes = 0;
+
+    for( i = 0; i < IOT_DEMO_TLS_METRICS_MAX_SERVERS; i++ )
+    {
+        if( _metrics[ i ].attempts == 0 )
+        {
+            continue;
+        }
+
+        successes = _metrics[ i ].attempts - _metrics[ i ].failures;
+
+        if( successes > 0 )
+        {
+            IotLogInfo( "TLS %s:%hu: %lu/%lu ok, last %lu ms %s.",
+                        _metrics[ i ].pHostName,
+                        _metrics[ i ].port,
+                        ( unsigned long ) successes,
+                        ( unsigned long ) _metrics[ i ].attempts,
+                        ( unsigned long ) _metrics[ i ].lastMs,
+                        ( _metrics[ i ].lastResumed == true ) ? "resumed" : "full" );
+            _printTimes( "full", &( _metrics[ i ].full ) );
+            _printTimes( "resumed", &( _metrics[ i ].resumed ) );
+        }
+        else
+        {
+            IotLogInfo( "TLS %s:%hu: 0/%lu ok.",
+                        _metrics[ i ].pHostName,
+                        _metrics[ i ].port,
+                        ( unsigned long ) _metrics[ i ].attempts );
+        }
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_tls_metrics.h
+ * @brief Connection setup timing for the network interface used by the demos.
+ *
+ * The network interface is wrapped so that every `create` (TCP connect plus
+ * TLS handshake) is timed and accounted per server. A full handshake costs
+ * the ESP32 hundreds of milliseconds of public key arithmetic, which these
+ * numbers make visible whenever the demo reconnects. Connections that
+ * resumed a TLS session (driver/tls_session_cache.h) are timed apart from
+ * those that did the full handshake.
+ */
+
+#ifndef IOT_DEMO_TLS_METRICS_H_
+#define IOT_DEMO_TLS_METRICS_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Platform layer includes. */
+#include "platform/iot_network.h"
+
+/**
+ * @brief Number of servers tracked. The oldest entry is reused when full.
+ */
+#ifndef IOT_DEMO_TLS_METRICS_MAX_SERVERS
+    #define IOT_DEMO_TLS_METRICS_MAX_SERVERS    ( 4 )
+#endif
+
+/**
+ * @brief Longest host name tracked, including the NUL terminator.
+ */
+#ifndef IOT_DEMO_TLS_METRICS_MAX_HOST_LENGTH
+    #define IOT_DEMO_TLS_METRICS_MAX_HOST_LENGTH    ( 64 )
+#endif
+
+/**
+ * @brief Durations of one kind of successful setup.
+ */
+typedef struct IotDemoTlsTimes
+{
+    uint32_t count;
+    uint32_t minMs;
+    uint32_t maxMs;
+    uint64_t totalMs; /**< Sum, for the mean. */
+} IotDemoTlsTimes_t;
+
+/**
+ * @brief Connection setup statistics of one server.
+ */
+typedef struct IotDemoTlsMetrics
+{
+    char pHostName[ IOT_DEMO_TLS_METRICS_MAX_HOST_LENGTH ];
+    uint16_t port;
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t lastMs;           /**< Duration of the last successful setup. */
+    bool lastResumed;          /**< Whether it resumed a TLS session. */
+    IotDemoTlsTimes_t full;    /**< Setups with a full handshake. */
+    IotDemoTlsTimes_t resumed; /**< Setups that resumed a session. */
+} IotDemoTlsMetrics_t;
+
+/**
+ * @brief Return a network interface that times connection setup and
+ * otherwise forwards every call to `pNetworkInterface`.
+ *
+ * `pConnectionInfo` passed to `create` must be an `IotNetworkServerInfo_t`.
+ * Whether a connection resumed a session is asked of the session cache
+ * under its host name and port, which is where the TLS layer keeps it as
+ * long as the name is sent in the handshake (no `disableSni`).
+ * Only one underlying interface is wrapped at a time, and the statistics are
+ * updated without locking, so connections must be created from one task.
+ */
+const IotNetworkInterface_t * IotDemoTlsMetrics_WrapInterface( const IotNetworkInterface_t * pNetworkInterface );
+
+/**
+ * @brief Copy the statistics of one server.
+ *
+ * @return `true` if the server is tracked.
+ */
+bool IotDemoTlsMetrics_Get( const char * pHostName,
+                            uint16_t port,
+                            IotDemoTlsMetrics_t * pMetrics );
+
+/**
+ * @brief Log the statistics of every tracked server.
+ */
+void IotDemoTlsMetrics_Print( void );
+
+#endif /* ifndef IOT_DEMO_TLS_METRICS_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_trace.c
+ * @brief Recording of the MQTT demo's inputs and broker responses.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "iot_demo_trace.h"
+
+#if IOT_DEMO_MQTT_TRACE == 1
+
+/* Standard includes. */
+    #include <stdio.h>
+
+    #include "freertos/FreeRTOS.h"
+    #include "esp_attr.h"
+    #include "esp_timer.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Times of vibration edges not yet printed. Written by the GPIO
+ * interrupt only and read by #IotDemoTrace_Flush only.
+ */
+    static int64_t _edges[ IOT_DEMO_TRACE_EDGE_BUFFER_SIZE ] = { 0 };
+    static uint32_t _edgeHead = 0;
+    static uint32_t _edgeTail = 0;
+    static uint32_t _edgesLost = 0;
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoTrace_Sample( float humidity,
+                              float temperature,
+                              int status )
+    {
+        printf( "TRACE,%lld,S,%.1f,%.1f,%d\n",
+                ( long long ) esp_timer_get_time(),
+                humidity,
+                temperature,
+                status );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IRAM_ATTR IotDemoTrace_EdgeFromISR( void )
+    {
+        uint32_t head = _edgeHead;
+
+        if( head - __atomic_load_n( &_edgeTail, __ATOMIC_ACQUIRE ) < IOT_DEMO_TRACE_EDGE_BUFFER_SIZE )
+        {
+            _edges[ head % IOT_DEMO_TRACE_EDGE_BUFFER_SIZE ] = esp_timer_get_time();
+            __atomic_store_n( &_edgeHead, head + 1, __ATOMIC_RELEASE );
+        }
+        else
+        {
+            _edgesLost++;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoTrace_Flush( void )
+    {
+        uint32_t tail = _edgeTail;
+        uint32_t lost = 0;
+
+        while( tail != __atomic_load_n( &_edgeHead, __ATOMIC_ACQUIRE ) )
+        {
+            printf( "TRACE,%lld,V\n", ( long long ) _edges[ tail % IOT_DEMO_TRACE_EDGE_BUFFER_SIZE ] );
+            tail++;
+            __atomic_store_n( &_edgeTail, tail, __ATOMIC_RELEASE );
+        }
+
+        lost = __atomic_exchange_n( &_edgesLost, 0, __ATOMIC_RELAXED );
+
+        if( lost > 0 )
+        {
+            printf( "Trace lost %lu vibration edges.\n", ( unsigned long ) lost );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoTrace_Publish( intptr_t publishCount,
+                               size_t payloadLength )
+    {
+        printf( "TRACE,%lld,P,%d,%u\n",
+                ( long long ) esp_timer_get_time(),
+                ( int ) publishCount,
+                ( unsigned ) payloadLength );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotDemoTrace_Complete( intptr_t publishCount,
+                                int result )
+    {
+        printf( "TRACE,%lld,A,%d,%d\n",
+                ( long long ) esp_timer_get_time(),
+                ( int ) publishCount,
+                result );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if IOT_DEMO_MQTT_TRACE == 1 */
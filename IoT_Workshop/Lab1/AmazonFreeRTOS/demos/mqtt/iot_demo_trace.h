@@ -0,0 +1,114 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_demo_trace.h
+ * @brief Recording of the MQTT demo's inputs and broker responses.
+ *
+ * With `IOT_DEMO_MQTT_TRACE` set to 1 in iot_config.h the demo prints one
+ * console line per sensor reading, vibration edge, PUBLISH and PUBLISH
+ * completion:
+ *
+ *     TRACE,<us>,S,<humidity>,<temperature>,<status>
+ *     TRACE,<us>,V
+ *     TRACE,<us>,P,<publish number>,<payload bytes>
+ *     TRACE,<us>,A,<publish number>,<result>
+ *
+ * Times are microseconds since boot; `status` is the return of readDHT()
+ * and `result` an #IotMqttError_t, 0 for success. A captured console log is
+ * a trace that tools/trace_replay.c can play back through a model of the
+ * pipeline; other lines in the log are ignored.
+ *
+ * With tracing disabled every hook compiles to nothing.
+ */
+
+#ifndef IOT_DEMO_TRACE_H_
+#define IOT_DEMO_TRACE_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set to 1 to record a trace on the console.
+ */
+#ifndef IOT_DEMO_MQTT_TRACE
+    #define IOT_DEMO_MQTT_TRACE    ( 0 )
+#endif
+
+#if IOT_DEMO_MQTT_TRACE == 1
+
+/**
+ * @brief Vibration edges held between two flushes. Edges beyond this are
+ * counted and reported by the next flush.
+ */
+    #ifndef IOT_DEMO_TRACE_EDGE_BUFFER_SIZE
+        #define IOT_DEMO_TRACE_EDGE_BUFFER_SIZE    ( 32 )
+    #endif
+
+/**
+ * @brief Record a sensor reading.
+ */
+    void IotDemoTrace_Sample( float humidity,
+                              float temperature,
+                              int status );
+
+/**
+ * @brief Record a vibration edge. Safe to call from an interrupt; the edge
+ * is printed by the next #IotDemoTrace_Flush.
+ */
+    void IotDemoTrace_EdgeFromISR( void );
+
+/**
+ * @brief Print the vibration edges recorded since the last flush.
+ */
+    void IotDemoTrace_Flush( void );
+
+/**
+ * @brief Record a PUBLISH handed to the MQTT library.
+ */
+    void IotDemoTrace_Publish( intptr_t publishCount,
+                               size_t payloadLength );
+
+/**
+ * @brief Record the completion of a PUBLISH.
+ */
+    void IotDemoTrace_Complete( intptr_t publishCount,
+                                int result );
+
+#else /* if IOT_DEMO_MQTT_TRACE == 1 */
+
+    #define IotDemoTrace_Sample( humidity, temperature, status )
+    #define IotDemoTrace_EdgeFromISR()
+    #define IotDemoTrace_Flush()
+    #define IotDemoTrace_Publish( publishCount, payloadLength )
+    #define IotDemoTrace_Complete( publishCount, result )
+
+#endif /* if IOT_DEMO_MQTT_TRACE == 1 */
+
+#endif /* ifndef IOT_DEMO_TRACE_H_ */
@@ -47,6 +47,22 @@
 #define democonfigDEMO_PRIORITY                ( tskIDLE_PRIORITY + 5 )
 #define democonfigNETWORK_TYPES                ( AWSIOT_NETWORK_TYPE_WIFI )
 
+/* Set to 1 to allocate every demo task, queue, timer and payload buffer
+ * statically, so that the demo no longer uses the heap once started. Also
+ * set IOT_STATIC_MEMORY_ONLY to 1 in iot_config.h, so that the MQTT library
+ * takes its operations and packets from fixed pools, and
+ * CONFIG_SUPPORT_STATIC_ALLOCATION in menuconfig. */
+#define democonfigSTATIC_ALLOCATION            ( 0 )
+
+/* Set to 1 to measure the peak stack use of the demo tasks. After the demo
+ * has connected, discovered and published for a while, it prints a header
+ * with the measured sizes plus a margin; see driver/stack_budget.h. */
+#define democonfigSTACK_BUDGET                 ( 0 )
+
+/* Set to 1 to size the demo stacks from aws_demo_stack_budget.h, the header
+ * printed by a democonfigSTACK_BUDGET run, saved next to this file. */
+#define democonfigUSE_STACK_BUDGET             ( 0 )
+
 #if defined( CONFIG_MQTT_DEMO_ENABLED )
     #undef democonfigNETWORK_TYPES
     #define democonfigNETWORK_TYPES                          (  AWSIOT_NETWORK_TYPE_WIFI|AWSIOT_NETWORK_TYPE_BLE )
@@ -62,4 +78,9 @@
     #define democonfigDEMO_STACKSIZE          ( 9000)
 #endif
 
+/* Measured sizes override the defaults above. */
+#if ( democonfigUSE_STACK_BUDGET == 1 )
+    #include "aws_demo_stack_budget.h"
+#endif
+
 #endif /* _AWS_DEMO_CONFIG_H_ */
@@ -0,0 +1,125 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file alloc_watch.c
+ * @brief Steady state allocation counter, on top of ESP-IDF heap tracing.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "driver/alloc_watch.h"
+
+#if ( allocwatchENABLED == 1 )
+    #include "esp_heap_trace.h"
+
+    static heap_trace_record_t xRecords[ allocwatchMAX_RECORDS ];
+#endif
+
+static bool xStarted = false;
+static bool xReported = false;
+
+/*-----------------------------------------------------------*/
+
+void AllocWatch_Start( void )
+{
+    if( __atomic_exchange_n( &xStarted, true, __ATOMIC_ACQ_REL ) == true )
+    {
+        return;
+    }
+
+    #if ( allocwatchENABLED == 1 )
+        /* Every allocation is kept, freed or not: a malloc followed by a
+         * free still fragments the heap over time. */
+        if( ( heap_trace_init_standalone( xRecords, allocwatchMAX_RECORDS ) != ESP_OK ) ||
+            ( heap_trace_start( HEAP_TRACE_ALL ) != ESP_OK ) )
+        {
+            printf( "alloc_watch: heap tracing could not be started\n" );
+        }
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t AllocWatch_Count( void )
+{
+    #if ( allocwatchENABLED == 1 )
+        if( __atomic_load_n( &xStarted, __ATOMIC_ACQUIRE ) == false )
+        {
+            return 0;
+        }
+
+        return ( int32_t ) heap_trace_get_count();
+    #else
+        return -1;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void AllocWatch_Report( void )
+{
+    int32_t lCount = AllocWatch_Count();
+
+    if( __atomic_exchange_n( &xReported, true, __ATOMIC_ACQ_REL ) == true )
+    {
+        return;
+    }
+
+    if( lCount < 0 )
+    {
+        printf( "{\"steady_state_allocs\":null}\n" );
+        printf( "alloc_watch: enable CONFIG_HEAP_TRACING to count allocations\n" );
+
+        return;
+    }
+
+    printf( "{\"steady_state_allocs\":%ld%s}\n",
+            ( long ) lCount,
+            ( lCount >= allocwatchMAX_RECORDS ) ? ",\"saturated\":true" : "" );
+
+    #if ( allocwatchENABLED == 1 )
+        {
+            heap_trace_record_t xRecord;
+            int32_t lIndex;
+
+            /* Stop so that the records do not move while printed. */
+            ( void ) heap_trace_stop();
+
+            for( lIndex = 0; lIndex < lCount; lIndex++ )
+            {
+                if( heap_trace_get( ( size_t ) lIndex, &xRecord ) == ESP_OK )
+                {
+                    printf( "ALLOC,%u,%p\n", ( unsigned ) xRecord.size, xRecord.alloced_by[ 0 ] );
+                }
+            }
+
+            ( void ) heap_trace_resume();
+        }
+    #endif
+}
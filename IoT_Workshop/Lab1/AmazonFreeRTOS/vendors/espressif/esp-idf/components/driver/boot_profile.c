@@ -0,0 +1,123 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file boot_profile.c
+ * @brief Timestamps of the startup phases.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "driver/boot_profile.h"
+
+/*-----------------------------------------------------------*/
+
+typedef struct BootPhase
+{
+    const char * pcName; /**< NULL until the slot is taken. */
+    uint32_t ulTimeMs;
+} BootPhase_t;
+
+static BootPhase_t xPhases[ bootprofileMAX_PHASES ];
+static uint32_t ulPhaseCount = 0;
+static bool xReported = false;
+
+/*-----------------------------------------------------------*/
+
+void BootProfile_Mark( const char * pcPhase )
+{
+    uint32_t ulTimeMs = ( uint32_t ) ( esp_timer_get_time() / 1000 );
+    uint32_t ulCount = __atomic_load_n( &ulPhaseCount, __ATOMIC_ACQUIRE );
+    uint32_t ulSlot;
+    const char * pcName;
+
+    /* Two tasks marking the same phase at the same instant may both be
+     * kept; that is rare and harmless. */
+    for( ulSlot = 0; ulSlot < ulCount; ulSlot++ )
+    {
+        pcName = __atomic_load_n( &( xPhases[ ulSlot ].pcName ), __ATOMIC_ACQUIRE );
+
+        if( ( pcName != NULL ) && ( strcmp( pcName, pcPhase ) == 0 ) )
+        {
+            return;
+        }
+    }
+
+    if( ulCount >= bootprofileMAX_PHASES )
+    {
+        return;
+    }
+
+    ulSlot = __atomic_fetch_add( &ulPhaseCount, 1, __ATOMIC_ACQ_REL );
+
+    if( ulSlot < bootprofileMAX_PHASES )
+    {
+        xPhases[ ulSlot ].ulTimeMs = ulTimeMs;
+        __atomic_store_n( &( xPhases[ ulSlot ].pcName ), pcPhase, __ATOMIC_RELEASE );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void BootProfile_Report( void )
+{
+    uint32_t ulCount, ulSlot;
+    bool xFirst = true;
+
+    if( __atomic_exchange_n( &xReported, true, __ATOMIC_ACQ_REL ) == true )
+    {
+        return;
+    }
+
+    ulCount = __atomic_load_n( &ulPhaseCount, __ATOMIC_ACQUIRE );
+
+    if( ulCount > bootprofileMAX_PHASES )
+    {
+        ulCount = bootprofileMAX_PHASES;
+    }
+
+    printf( "{\"startup_ms\":{" );
+
+    for( ulSlot = 0; ulSlot < ulCount; ulSlot++ )
+    {
+        /* Skip a slot still being filled by another task. */
+        if( __atomic_load_n( &( xPhases[ ulSlot ].pcName ), __ATOMIC_ACQUIRE ) != NULL )
+        {
+            printf( "%s\"%s\":%lu",
+                    ( xFirst == true ) ? "" : ",",
+                    xPhases[ ulSlot ].pcName,
+                    ( unsigned long ) xPhases[ ulSlot ].ulTimeMs );
+            xFirst = false;
+        }
+    }
+
+    printf( "}}\n" );
+}
@@ -0,0 +1,519 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file cmd_dispatch.c
+ * @brief Dispatch of JSON command messages, checked before applied.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+#include "driver/cmd_dispatch.h"
+
+/*-----------------------------------------------------------*/
+
+/* Position in the payload being scanned. */
+typedef struct CmdScanner
+{
+    const char * pcText;
+    size_t xLength;
+    size_t xIndex;
+} CmdScanner_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvSkipSpace( CmdScanner_t * pxScanner )
+{
+    char c;
+
+    while( pxScanner->xIndex < pxScanner->xLength )
+    {
+        c = pxScanner->pcText[ pxScanner->xIndex ];
+
+        if( ( c != ' ' ) && ( c != '\t' ) && ( c != '\r' ) && ( c != '\n' ) )
+        {
+            break;
+        }
+
+        pxScanner->xIndex++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take the next character if it is c. */
+static bool prvAccept( CmdScanner_t * pxScanner,
+                       char c )
+{
+    prvSkipSpace( pxScanner );
+
+    if( ( pxScanner->xIndex < pxScanner->xLength ) &&
+        ( pxScanner->pcText[ pxScanner->xIndex ] == c ) )
+    {
+        pxScanner->xIndex++;
+
+        return true;
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Scan a string whose opening quote was taken; the closing one is taken
+ * too, and left out of the text. */
+static bool prvScanString( CmdScanner_t * pxScanner,
+                           CmdValue_t * pxValue )
+{
+    size_t xStart = pxScanner->xIndex;
+    char c;
+
+    while( pxScanner->xIndex < pxScanner->xLength )
+    {
+        c = pxScanner->pcText[ pxScanner->xIndex++ ];
+
+        if( c == '"' )
+        {
+            pxValue->xType = eCmdValueString;
+            pxValue->pcText = pxScanner->pcText + xStart;
+            pxValue->xLength = pxScanner->xIndex - xStart - 1;
+
+            return true;
+        }
+
+        if( c == '\\' )
+        {
+            /* The escaped character cannot end the string. */
+            pxScanner->xIndex++;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Skip an object or an array whose opening bracket was taken. Only the
+ * brackets are matched; what is between them is not checked. */
+static bool prvScanNested( CmdScanner_t * pxScanner,
+                           CmdValue_t * pxValue )
+{
+    size_t xStart = pxScanner->xIndex - 1;
+    uint32_t ulDepth = 1;
+    CmdValue_t xString;
+    char c;
+
+    while( ( ulDepth > 0 ) && ( pxScanner->xIndex < pxScanner->xLength ) )
+    {
+        c = pxScanner->pcText[ pxScanner->xIndex++ ];
+
+        if( ( c == '{' ) || ( c == '[' ) )
+        {
+            ulDepth++;
+        }
+        else if( ( c == '}' ) || ( c == ']' ) )
+        {
+            ulDepth--;
+        }
+        else if( c == '"' )
+        {
+            /* Brackets inside strings do not count. */
+            if( prvScanString( pxScanner, &xString ) == false )
+            {
+                return false;
+            }
+        }
+    }
+
+    pxValue->xType = eCmdValueNested;
+    pxValue->pcText = pxScanner->pcText + xStart;
+    pxValue->xLength = pxScanner->xIndex - xStart;
+
+    return ( ulDepth == 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Scan a number or a literal, up to the next separator. */
+static bool prvScanScalar( CmdScanner_t * pxScanner,
+                           CmdValue_t * pxValue )
+{
+    size_t xStart = pxScanner->xIndex;
+    char c;
+
+    while( pxScanner->xIndex < pxScanner->xLength )
+    {
+        c = pxScanner->pcText[ pxScanner->xIndex ];
+
+        if( ( c == ',' ) || ( c == '}' ) || ( c == ']' ) ||
+            ( c == ' ' ) || ( c == '\t' ) || ( c == '\r' ) || ( c == '\n' ) )
+        {
+            break;
+        }
+
+        pxScanner->xIndex++;
+    }
+
+    if( pxScanner->xIndex == xStart )
+    {
+        return false;
+    }
+
+    c = pxScanner->pcText[ xStart ];
+    pxValue->xType = ( ( c == '-' ) || ( ( c >= '0' ) && ( c <= '9' ) ) ) ? eCmdValueNumber : eCmdValueLiteral;
+    pxValue->pcText = pxScanner->pcText + xStart;
+    pxValue->xLength = pxScanner->xIndex - xStart;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvScanValue( CmdScanner_t * pxScanner,
+                          CmdValue_t * pxValue )
+{
+    prvSkipSpace( pxScanner );
+
+    if( pxScanner->xIndex >= pxScanner->xLength )
+    {
+        return false;
+    }
+
+    switch( pxScanner->pcText[ pxScanner->xIndex ] )
+    {
+        case '"':
+            pxScanner->xIndex++;
+
+            return prvScanString( pxScanner, pxValue );
+
+        case '{':
+        case '[':
+            pxScanner->xIndex++;
+
+            return prvScanNested( pxScanner, pxValue );
+
+        default:
+
+            return prvScanScalar( pxScanner, pxValue );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Scan the object whose opening brace was taken. Without a table, only
+ * the syntax is checked; with one, each key is applied as it comes. */
+static bool prvScanObject( CmdScanner_t * pxScanner,
+                           const CmdEntry_t * pxTable,
+                           size_t uxEntries,
+                           CmdResult_t * pxResult )
+{
+    CmdValue_t xKey, xValue;
+    size_t uxEntry;
+
+    /* An empty object. */
+    if( prvAccept( pxScanner, '}' ) == true )
+    {
+        return true;
+    }
+
+    for( ; ; )
+    {
+        if( ( prvAccept( pxScanner, '"' ) == false ) ||
+            ( prvScanString( pxScanner, &xKey ) == false ) ||
+            ( prvAccept( pxScanner, ':' ) == false ) ||
+            ( prvScanValue( pxScanner, &xValue ) == false ) )
+        {
+            return false;
+        }
+
+        if( pxTable != NULL )
+        {
+            for( uxEntry = 0; uxEntry < uxEntries; uxEntry++ )
+            {
+                if( ( pxTable[ uxEntry ].xKeyLength == xKey.xLength ) &&
+                    ( memcmp( pxTable[ uxEntry ].pcKey, xKey.pcText, xKey.xLength ) == 0 ) )
+                {
+                    break;
+                }
+            }
+
+            if( uxEntry == uxEntries )
+            {
+                pxResult->ulUnknown++;
+            }
+            else if( pxTable[ uxEntry ].xApply( &xValue ) == true )
+            {
+                pxResult->ulApplied |= ( 1UL << uxEntry );
+                pxResult->ulRejected &= ~( 1UL << uxEntry );
+            }
+            else
+            {
+                pxResult->ulRejected |= ( 1UL << uxEntry );
+                pxResult->ulApplied &= ~( 1UL << uxEntry );
+            }
+        }
+
+        if( prvAccept( pxScanner, '}' ) == true )
+        {
+            return true;
+        }
+
+        if( prvAccept( pxScanner, ',' ) == false )
+        {
+            return false;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool CmdDispatch_Run( const CmdEntry_t * pxTable,
+                      size_t uxEntries,
+                      const char * pcPayload,
+                      size_t xLength,
+                      CmdResult_t * pxResult )
+{
+    CmdScanner_t xScanner = { pcPayload, xLength, 0 };
+    bool xValid = false;
+
+    ( void ) memset( pxResult, 0x00, sizeof( CmdResult_t ) );
+
+    if( uxEntries > cmddispatchMAX_ENTRIES )
+    {
+        uxEntries = cmddispatchMAX_ENTRIES;
+    }
+
+    /* The whole object is checked before any key is applied, so that a
+     * truncated command changes nothing; only blanks may follow it. */
+    if( ( prvAccept( &xScanner, '{' ) == true ) &&
+        ( prvScanObject( &xScanner, NULL, 0, NULL ) == true ) )
+    {
+        prvSkipSpace( &xScanner );
+        xValid = ( xScanner.xIndex == xScanner.xLength );
+    }
+
+    if( xValid == false )
+    {
+        pxResult->xMalformed = true;
+
+        return false;
+    }
+
+    xScanner.xIndex = 0;
+    ( void ) prvAccept( &xScanner, '{' );
+    ( void ) prvScanObject( &xScanner, pxTable, uxEntries, pxResult );
+
+    return ( ( pxResult->ulApplied | pxResult->ulRejected ) != 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Count what snprintf() appended to the ack; false once it no longer
+ * fits. */
+static bool prvAppend( size_t xLength,
+                       size_t * pxUsed,
+                       int lWritten )
+{
+    if( ( lWritten < 0 ) || ( ( size_t ) lWritten >= xLength - *pxUsed ) )
+    {
+        return false;
+    }
+
+    *pxUsed += ( size_t ) lWritten;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Append the keys of the entries set in ulMask, as a JSON array. */
+static bool prvAppendKeys( const CmdEntry_t * pxTable,
+                           size_t uxEntries,
+                           uint32_t ulMask,
+                           char * pcBuffer,
+                           size_t xLength,
+                           size_t * pxUsed )
+{
+    const char * pcSeparator = "";
+    size_t uxEntry;
+    bool xFits = prvAppend( xLength, pxUsed, snprintf( pcBuffer + *pxUsed, xLength - *pxUsed, "[" ) );
+
+    for( uxEntry = 0; ( uxEntry < uxEntries ) && ( xFits == true ); uxEntry++ )
+    {
+        if( ( ulMask & ( 1UL << uxEntry ) ) != 0 )
+        {
+            xFits = prvAppend( xLength, pxUsed,
+                               snprintf( pcBuffer + *pxUsed, xLength - *pxUsed, "%s\"%s\"",
+                                         pcSeparator, pxTable[ uxEntry ].pcKey ) );
+            pcSeparator = ",";
+        }
+    }
+
+    return xFits && prvAppend( xLength, pxUsed, snprintf( pcBuffer + *pxUsed, xLength - *pxUsed, "]" ) );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t CmdDispatch_FormatAck( const CmdEntry_t * pxTable,
+                              size_t uxEntries,
+                              const CmdResult_t * pxResult,
+                              char * pcBuffer,
+                              size_t xLength )
+{
+    const char * pcSeparator = "";
+    size_t xUsed = 0, uxEntry;
+    bool xFits;
+
+    if( xLength == 0 )
+    {
+        return 0;
+    }
+
+    if( uxEntries > cmddispatchMAX_ENTRIES )
+    {
+        uxEntries = cmddispatchMAX_ENTRIES;
+    }
+
+    xFits = prvAppend( xLength, &xUsed, snprintf( pcBuffer, xLength, "{\"applied\":" ) ) &&
+            prvAppendKeys( pxTable, uxEntries, pxResult->ulApplied, pcBuffer, xLength, &xUsed ) &&
+            prvAppend( xLength, &xUsed, snprintf( pcBuffer + xUsed, xLength - xUsed, ",\"rejected\":" ) ) &&
+            prvAppendKeys( pxTable, uxEntries, pxResult->ulRejected, pcBuffer, xLength, &xUsed ) &&
+            prvAppend( xLength, &xUsed,
+                       snprintf( pcBuffer + xUsed, xLength - xUsed, ",\"unknown\":%lu,%s\"settings\":{",
+                                 ( unsigned long ) pxResult->ulUnknown,
+                                 ( pxResult->xMalformed == true ) ? "\"error\":\"malformed\"," : "" ) );
+
+    for( uxEntry = 0; ( uxEntry < uxEntries ) && ( xFits == true ); uxEntry++ )
+    {
+        if( pxTable[ uxEntry ].xReport != NULL )
+        {
+            xFits = prvAppend( xLength, &xUsed,
+                               snprintf( pcBuffer + xUsed, xLength - xUsed, "%s\"%s\":",
+                                         pcSeparator, pxTable[ uxEntry ].pcKey ) ) &&
+                    prvAppend( xLength, &xUsed,
+                               pxTable[ uxEntry ].xReport( pcBuffer + xUsed, xLength - xUsed ) );
+            pcSeparator = ",";
+        }
+    }
+
+    if( ( xFits == false ) ||
+        ( prvAppend( xLength, &xUsed, snprintf( pcBuffer + xUsed, xLength - xUsed, "}}" ) ) == false ) )
+    {
+        pcBuffer[ 0 ] = '\0';
+
+        return 0;
+    }
+
+    return xUsed;
+}
+
+/*-----------------------------------------------------------*/
+
+bool CmdDispatch_ToFixed( const CmdValue_t * pxValue,
+                          uint32_t ulScale,
+                          int32_t * plResult )
+{
+    size_t xIndex = 0;
+    bool xNegative = false, xFraction = false, xDigits = false;
+    int64_t llResult = 0;
+    uint32_t ulPlace = 1;
+    char c;
+
+    if( pxValue->xType != eCmdValueNumber )
+    {
+        return false;
+    }
+
+    if( pxValue->pcText[ 0 ] == '-' )
+    {
+        xNegative = true;
+        xIndex++;
+    }
+
+    for( ; xIndex < pxValue->xLength; xIndex++ )
+    {
+        c = pxValue->pcText[ xIndex ];
+
+        if( ( c == '.' ) && ( xFraction == false ) )
+        {
+            xFraction = true;
+        }
+        else if( ( c < '0' ) || ( c > '9' ) )
+        {
+            return false;
+        }
+        else if( xFraction == false )
+        {
+            llResult = ( llResult * 10 ) + ( c - '0' );
+            xDigits = true;
+
+            if( llResult * ulScale > INT32_MAX )
+            {
+                return false;
+            }
+        }
+        else
+        {
+            /* Digits below the scale are dropped. */
+            if( ulPlace * 10 <= ulScale )
+            {
+                ulPlace *= 10;
+                llResult = ( llResult * 10 ) + ( c - '0' );
+            }
+
+            xDigits = true;
+        }
+    }
+
+    if( xDigits == false )
+    {
+        return false;
+    }
+
+    llResult = llResult * ( ulScale / ulPlace );
+
+    if( llResult > INT32_MAX )
+    {
+        return false;
+    }
+
+    *plResult = ( int32_t ) ( xNegative ? -llResult : llResult );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool CmdDispatch_IsString( const CmdValue_t * pxValue,
+                           const char * pcString )
+{
+    size_t xLength = strlen( pcString );
+
+    return ( pxValue->xType == eCmdValueString ) &&
+           ( pxValue->xLength == xLength ) &&
+           ( memcmp( pxValue->pcText, pcString, xLength ) == 0 );
+}
@@ -7,6 +7,8 @@
 #ifndef DHT22_H_  
 #define DHT22_H_
 
+#include <stdbool.h>
+
 #define DHT_OK 0
 #define DHT_CHECKSUM_ERROR -1
 #define DHT_TIMEOUT_ERROR -2
@@ -20,4 +22,6 @@ float 	getHumidity();
 float 	getTemperature();
 int 	getSignalLevel( int usTimeOut, bool state );
 
+void 	setDHTsimSeed( unsigned int seed );	// simulated sensor only: restart its sequence
+
 #endif
@@ -0,0 +1,113 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file adaptive_period.h
+ * @brief Sampling period that follows how fast the readings change.
+ *
+ * A fixed period wastes readings, and publishes, while the room is steady,
+ * and may be too slow while it heats up. AdaptivePeriod_Next() is called
+ * after each reading with the period it was taken at, and gives the period
+ * until the next one:
+ *
+ * - If a channel moved by more than its step since the last reading, the
+ *   period is shortened in proportion, so that at the same rate it would
+ *   move by about one step. It is cut by 4 at most in one go, so that a
+ *   single outlier does not reset it.
+ * - If every channel moved by less than half its step, the period grows
+ *   by a quarter.
+ * - Otherwise it is kept.
+ *
+ * A new period is rounded to 100 ms, and any period is kept between the
+ * bounds of the configuration. A noisy channel shows as large moves as
+ * well, so a rising variance also shortens the period. The step is the
+ * largest error accepted between readings; it should be above the noise
+ * of a steady sensor, or the period never grows.
+ *
+ * Values are integers in whatever unit the steps are given in; the demos
+ * use tenths, the resolution of the DHT22. The controller keeps the last
+ * reading and nothing else.
+ */
+
+#ifndef _ADAPTIVE_PERIOD_H_
+#define _ADAPTIVE_PERIOD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Channels a controller may follow.
+ */
+#ifndef adaptiveperiodMAX_CHANNELS
+    #define adaptiveperiodMAX_CHANNELS    ( 4 )
+#endif
+
+/**
+ * @brief Bounds and steps of a controller.
+ */
+typedef struct AdaptivePeriodConfig
+{
+    uint32_t ulMinMs;                             /**< Shortest period. */
+    uint32_t ulMaxMs;                             /**< Longest period. */
+    size_t uxChannels;                            /**< Channels in use. */
+    int32_t lStep[ adaptiveperiodMAX_CHANNELS ]; /**< Change of each channel aimed for between readings, above 0. */
+} AdaptivePeriodConfig_t;
+
+/**
+ * @brief A controller.
+ */
+typedef struct AdaptivePeriod
+{
+    AdaptivePeriodConfig_t xConfig;
+    int32_t lLast[ adaptiveperiodMAX_CHANNELS ];
+    bool xHaveLast;
+} AdaptivePeriod_t;
+
+/**
+ * @brief Set up a controller.
+ *
+ * @return false if the configuration is not valid.
+ */
+bool AdaptivePeriod_Init( AdaptivePeriod_t * pxController,
+                          const AdaptivePeriodConfig_t * pxConfig );
+
+/**
+ * @brief Take a reading and give the period until the next one.
+ *
+ * @param[in] pxController The controller.
+ * @param[in] ulPeriodMs The period the reading was taken at. It may have
+ * been changed by other means since the last call.
+ * @param[in] plValues One value for each channel.
+ *
+ * @return The next period, in ms. The first reading only sets the
+ * starting point; the period is then only brought within the bounds.
+ */
+uint32_t AdaptivePeriod_Next( AdaptivePeriod_t * pxController,
+                              uint32_t ulPeriodMs,
+                              const int32_t * plValues );
+
+#endif /* _ADAPTIVE_PERIOD_H_ */
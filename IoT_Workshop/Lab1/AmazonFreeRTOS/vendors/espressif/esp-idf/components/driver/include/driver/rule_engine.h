@@ -0,0 +1,193 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file rule_engine.h
+ * @brief Local rules that drive outputs from the latest readings, without
+ * a round trip to the cloud.
+ *
+ * Rules are written as text, one condition and one action each, separated
+ * by semicolons:
+ *
+ *     temp > 30 -> led = on; held(vibration) > 5 -> led = on
+ *
+ * A condition compares inputs and numbers with > >= < <= == !=, adds and
+ * subtracts them, and combines the results with and, or and not (&&, ||
+ * and ! are accepted too). Numbers are read in tenths, the resolution of
+ * the DHT22, so inputs are given to Rules_Evaluate() in tenths as well;
+ * an input that is a condition, such as vibration, is 0 or not. held(c)
+ * is the time for which c has been true without a break, in tenths of a
+ * second, so the second rule above fires after 5 seconds of vibration.
+ *
+ * The action of a rule sets an output to on (1) or off (0) when its
+ * condition becomes true, and to the other level when it becomes false.
+ * Nothing is done while the condition stays the same, so a command may
+ * still change the output in between. The first evaluation of a rule acts
+ * either way.
+ *
+ * Rules_Compile() turns the text into bytecode for a small stack machine,
+ * checking names, syntax and stack depth, so that Rules_Evaluate() does no
+ * checks of its own: it runs through the code once, in a few microseconds,
+ * and does not allocate. Every term is evaluated, and held() timers are
+ * kept up to date, whatever the result of and and or.
+ *
+ * A program and its state belong to the task that evaluates them. Programs
+ * compiled in another task are handed over whole, as with any other
+ * message.
+ */
+
+#ifndef _RULE_ENGINE_H_
+#define _RULE_ENGINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Rules a program may hold.
+ */
+#ifndef rulesMAX_RULES
+    #define rulesMAX_RULES    ( 8 )
+#endif
+
+/**
+ * @brief Bytes of bytecode of a program.
+ */
+#ifndef rulesMAX_CODE
+    #define rulesMAX_CODE     ( 128 )
+#endif
+
+/**
+ * @brief Values a condition may stack while it is evaluated.
+ */
+#ifndef rulesMAX_STACK
+    #define rulesMAX_STACK    ( 8 )
+#endif
+
+/**
+ * @brief held() terms a program may use; one bit each in #RuleState_t.
+ */
+#ifndef rulesMAX_HELD
+    #define rulesMAX_HELD     ( 8 )
+#endif
+
+/**
+ * @brief Terms that may be nested in parentheses, held() and not, counting
+ * the innermost one. Bounds the recursion of Rules_Compile(), which may run
+ * on the small stack of the MQTT task.
+ */
+#ifndef rulesMAX_NESTING
+    #define rulesMAX_NESTING    ( 4 )
+#endif
+
+#if ( rulesMAX_RULES > 32 ) || ( rulesMAX_CODE > 65535 ) || ( rulesMAX_HELD > 32 )
+    #error "rulesMAX_RULES, rulesMAX_CODE or rulesMAX_HELD is too large."
+#endif
+
+/**
+ * @brief Compiled rules.
+ */
+typedef struct RuleProgram
+{
+    uint8_t ucCode[ rulesMAX_CODE ];
+    uint16_t usLength; /**< Bytes of ucCode in use. */
+    uint8_t ucRules;   /**< Rules in the program. */
+    uint8_t ucHeld;    /**< held() terms in the program. */
+} RuleProgram_t;
+
+/**
+ * @brief What the evaluation of a program remembers from one call to the
+ * next. Reset it whenever a new program is loaded.
+ */
+typedef struct RuleState
+{
+    uint32_t ulSince[ rulesMAX_HELD ]; /**< When each held() term became true, in ms. */
+    uint32_t ulHeld;                   /**< held() terms that are true. */
+    uint32_t ulKnown;                  /**< Rules evaluated at least once. */
+    uint32_t ulTrue;                   /**< Rules whose condition was true. */
+} RuleState_t;
+
+/**
+ * @brief Set output uxOutput, an index into the output names given to
+ * Rules_Compile(), to lLevel, 1 or 0.
+ */
+typedef void ( * RuleAction_t )( void * pvContext,
+                                 size_t uxOutput,
+                                 int32_t lLevel );
+
+/**
+ * @brief Compile rules.
+ *
+ * Input and output names are looked up in the tables given; an input
+ * stands for the value of the same index in the array passed to
+ * Rules_Evaluate(). Empty text gives a program without rules.
+ *
+ * @param[in] ppcInputs Names of the inputs.
+ * @param[in] uxInputs Number of inputs, at most 256.
+ * @param[in] ppcOutputs Names of the outputs.
+ * @param[in] uxOutputs Number of outputs, at most 256.
+ * @param[in] pcSource The rules; they need not be terminated.
+ * @param[in] xLength Length of pcSource.
+ * @param[out] pxProgram The program. It is left in an unspecified state on
+ * failure, so compile into a spare one.
+ * @param[out] pxErrorOffset Where in pcSource compilation stopped, on
+ * failure. May be NULL.
+ *
+ * @return true if the rules were compiled.
+ */
+bool Rules_Compile( const char * const * ppcInputs,
+                    size_t uxInputs,
+                    const char * const * ppcOutputs,
+                    size_t uxOutputs,
+                    const char * pcSource,
+                    size_t xLength,
+                    RuleProgram_t * pxProgram,
+                    size_t * pxErrorOffset );
+
+/**
+ * @brief Forget the conditions and held() timers of the last program.
+ */
+void Rules_Reset( RuleState_t * pxState );
+
+/**
+ * @brief Evaluate every rule of a program, in order, and act on those
+ * whose condition changed.
+ *
+ * @param[in] pxProgram A program made by Rules_Compile().
+ * @param[in,out] pxState State of the program.
+ * @param[in] plInputs Current value of each input.
+ * @param[in] ulNowMs Current time in ms; it may wrap.
+ * @param[in] xAction Called for each output to set.
+ * @param[in] pvContext Passed to xAction.
+ */
+void Rules_Evaluate( const RuleProgram_t * pxProgram,
+                     RuleState_t * pxState,
+                     const int32_t * plInputs,
+                     uint32_t ulNowMs,
+                     RuleAction_t xAction,
+                     void * pvContext );
+
+#endif /* _RULE_ENGINE_H_ */
@@ -0,0 +1,107 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file stack_budget.h
+ * @brief Measure the peak stack use of tasks and derive their stack sizes.
+ *
+ * FreeRTOS fills every new stack with a known byte, so the untouched part
+ * left at the far end gives the deepest point a task has reached. The demos
+ * register each task they create, with the name of the macro that sizes its
+ * stack. Once they have been through their worst paths (connect, TLS,
+ * discovery, publish bursts, a large incoming message), they call
+ * StackBudget_Report(). It prints a header that redefines each macro as the
+ * peak use of its tasks plus stackbudgetMARGIN_PERCENT, with the peak and
+ * the old size of every task in a comment. The header starts and ends with
+ * a "stack_budget begin" and a "stack_budget end" comment line. Save it
+ * from a console capture with:
+ *
+ *     sed -n '/stack_budget begin/,/stack_budget end/p' console.log > aws_demo_stack_budget.h
+ *
+ * Sizes are in the unit of the stack depth passed to xTaskCreate(), which is
+ * bytes on ESP-IDF. A path that did not run during the measurement is not
+ * covered, so the margin should not be cut further.
+ */
+
+#ifndef _STACK_BUDGET_H_
+#define _STACK_BUDGET_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @brief Tasks kept; later registrations are ignored.
+ */
+#ifndef stackbudgetMAX_TASKS
+    #define stackbudgetMAX_TASKS          ( 12 )
+#endif
+
+/**
+ * @brief Headroom added to the peak use.
+ */
+#ifndef stackbudgetMARGIN_PERCENT
+    #define stackbudgetMARGIN_PERCENT     ( 25 )
+#endif
+
+/**
+ * @brief Derived sizes are rounded up to a multiple of this.
+ */
+#ifndef stackbudgetGRANULE
+    #define stackbudgetGRANULE            ( 64 )
+#endif
+
+/**
+ * @brief Start measuring a task.
+ *
+ * Registering a task twice updates its entry. A task that ended with
+ * StackBudget_TaskExit() and is created again under the same name and macro
+ * takes its old entry back, keeping its peak.
+ *
+ * @param[in] xTask The task; NULL for the calling task.
+ * @param[in] pcMacro Name of the macro that sizes its stack; must be a
+ * string literal.
+ * @param[in] ulStackSize Stack depth the task was created with.
+ */
+void StackBudget_Register( TaskHandle_t xTask,
+                           const char * pcMacro,
+                           uint32_t ulStackSize );
+
+/**
+ * @brief Take the final reading of the calling task.
+ *
+ * A registered task must call this before it deletes itself.
+ */
+void StackBudget_TaskExit( void );
+
+/**
+ * @brief Read every task still running and print the header. Only the
+ * first call prints.
+ */
+void StackBudget_Report( void );
+
+#endif /* _STACK_BUDGET_H_ */
@@ -0,0 +1,168 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file stream_stats.h
+ * @brief Running statistics of readings, and anomalies among them, kept on
+ * the device so that the cloud need not see every reading.
+ *
+ * Each channel is followed over two windows of the same span, counted in
+ * readings rather than in time, since the sampling period may change:
+ *
+ * - A tumbling window gathers the mean and variance, by Welford's method,
+ *   and the minimum and maximum of the next ulWindow readings, then closes
+ *   and starts again. StreamStats_Add() says when it closed, and
+ *   StreamStats_Tumbling() gives what it gathered.
+ * - A sliding window weighs readings exponentially, with the weight of a
+ *   simple mean of ulWindow readings (alpha = 2 / (ulWindow + 1)). Until it
+ *   has seen that many, it weighs them all equally, which is Welford's
+ *   method again. Its minimum and maximum are those of the open tumbling
+ *   window and of the last one closed, so of the last ulWindow readings at
+ *   least and 2 * ulWindow at most.
+ *
+ * Once the sliding window is full, each reading is scored against it,
+ * before being added, as z = ( value - mean ) / deviation. The deviation is
+ * never taken below lMinDeviation, so that a steady sensor does not turn a
+ * step of its resolution into an anomaly. A channel is reported once when
+ * |z| reaches fZThreshold, and again only after it has fallen below half
+ * of it.
+ *
+ * Memory is fixed per channel whatever the span. Sums are kept in double
+ * about the running mean, never as raw sums of squares, and the tumbling
+ * window starts afresh at each close, so rounding does not build up over
+ * long runs; tools/stream_stats_check.c checks this against exact sums.
+ * Values are integers in whatever unit the configuration uses; the demos
+ * use tenths, the resolution of the DHT22.
+ */
+
+#ifndef _STREAM_STATS_H_
+#define _STREAM_STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Channels that may be followed, at most 32.
+ */
+#ifndef streamstatsMAX_CHANNELS
+    #define streamstatsMAX_CHANNELS    ( 4 )
+#endif
+
+#if ( streamstatsMAX_CHANNELS > 32 )
+    #error "streamstatsMAX_CHANNELS is too large."
+#endif
+
+/**
+ * @brief Span and thresholds of the statistics.
+ */
+typedef struct StreamStatsConfig
+{
+    size_t uxChannels;                                 /**< Channels in use. */
+    uint32_t ulWindow;                                 /**< Readings in a window, at least 2. */
+    float fZThreshold;                                 /**< |z| of an anomaly, above 0. */
+    int32_t lMinDeviation[ streamstatsMAX_CHANNELS ]; /**< Smallest deviation of each channel, above 0. */
+} StreamStatsConfig_t;
+
+/**
+ * @brief What a window holds.
+ */
+typedef struct StreamStatsSummary
+{
+    uint32_t ulCount; /**< Readings in the window; 0 if there are none yet. */
+    float fMean;
+    float fVariance;
+    int32_t lMin;
+    int32_t lMax;
+} StreamStatsSummary_t;
+
+/**
+ * @brief State of one channel.
+ */
+typedef struct StreamStatsChannel
+{
+    uint32_t ulCount;               /**< Readings in the open tumbling window. */
+    double dMean;                   /**< Its mean. */
+    double dM2;                     /**< Its sum of squared deviations from the mean. */
+    int32_t lMin;
+    int32_t lMax;
+    StreamStatsSummary_t xClosed;   /**< The last tumbling window closed. */
+    uint32_t ulSeen;                /**< Readings in the sliding window, up to ulWindow. */
+    double dSlidingMean;
+    double dSlidingVariance;
+    bool xAnomalous;                /**< Reported, and |z| not below half the threshold since. */
+} StreamStatsChannel_t;
+
+/**
+ * @brief Statistics of a set of channels.
+ */
+typedef struct StreamStats
+{
+    StreamStatsConfig_t xConfig;
+    double dAlpha;
+    StreamStatsChannel_t xChannels[ streamstatsMAX_CHANNELS ];
+} StreamStats_t;
+
+/**
+ * @brief Set up statistics with no readings.
+ *
+ * @return false if the configuration is not valid.
+ */
+bool StreamStats_Init( StreamStats_t * pxStats,
+                       const StreamStatsConfig_t * pxConfig );
+
+/**
+ * @brief Add a reading of every channel.
+ *
+ * @param[in] pxStats The statistics.
+ * @param[in] plValues One value for each channel.
+ * @param[out] pfZScores The z-score of each value, 0 while the sliding
+ * window is not full. May be NULL.
+ * @param[out] pulAnomalies Bit i is set if channel i has just become
+ * anomalous. May be NULL.
+ *
+ * @return true if the tumbling windows closed with this reading.
+ */
+bool StreamStats_Add( StreamStats_t * pxStats,
+                      const int32_t * plValues,
+                      float * pfZScores,
+                      uint32_t * pulAnomalies );
+
+/**
+ * @brief The last tumbling window closed of a channel.
+ */
+void StreamStats_Tumbling( const StreamStats_t * pxStats,
+                           size_t uxChannel,
+                           StreamStatsSummary_t * pxSummary );
+
+/**
+ * @brief The sliding window of a channel as it stands.
+ */
+void StreamStats_Sliding( const StreamStats_t * pxStats,
+                          size_t uxChannel,
+                          StreamStatsSummary_t * pxSummary );
+
+#endif /* _STREAM_STATS_H_ */
@@ -0,0 +1,147 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file tls_session_cache.h
+ * @brief TLS sessions kept per endpoint, so that a reconnect resumes them.
+ *
+ * A full TLS handshake costs the ESP32 hundreds of milliseconds of public
+ * key arithmetic; an abbreviated one, resuming the session of an earlier
+ * connection to the same server, skips it and a round trip. The TLS layer
+ * of the secure sockets calls TlsSessionCache_Begin() between
+ * mbedtls_ssl_setup() and mbedtls_ssl_handshake(), which offers the session
+ * last agreed with the endpoint (mbedtls_ssl_set_session()), and
+ * TlsSessionCache_End() after the handshake, which keeps the session agreed
+ * (mbedtls_ssl_get_session()). A session ID and a session ticket both work:
+ * the ticket, when the server gives one, is part of the session.
+ *
+ * An endpoint is a host name, or an address when no name is sent, and a
+ * port. A session is only offered under the CA it was first verified with,
+ * since a resumed handshake does not verify the server's certificate again.
+ * A handshake is counted as resumed when it completed without the server
+ * sending a certificate.
+ */
+
+#ifndef _TLS_SESSION_CACHE_H_
+#define _TLS_SESSION_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "mbedtls/ssl.h"
+
+/**
+ * @brief Endpoints kept. The oldest entry is reused when full.
+ */
+#ifndef tlssessionMAX_ENDPOINTS
+    #define tlssessionMAX_ENDPOINTS       ( 4 )
+#endif
+
+/**
+ * @brief Longest host name kept, including the NUL terminator.
+ */
+#ifndef tlssessionMAX_HOST_LENGTH
+    #define tlssessionMAX_HOST_LENGTH     ( 64 )
+#endif
+
+/**
+ * @brief Handshakes with one endpoint since it was first seen.
+ */
+typedef struct TlsSessionStats
+{
+    uint32_t ulFull;
+    uint32_t ulResumed;
+    BaseType_t xLastResumed; /**< pdTRUE if the last handshake resumed. */
+} TlsSessionStats_t;
+
+/**
+ * @brief State of one handshake, owned by the TLS layer from
+ * TlsSessionCache_Begin() to TlsSessionCache_End().
+ */
+typedef struct TlsSessionHandshake
+{
+    const char * pcHost;
+    uint16_t usPort;
+    uint32_t ulTrustHash;            /**< Of the CA the server is verified with. */
+    BaseType_t xOffered;             /**< A cached session was offered. */
+    BaseType_t xCertificateVerified; /**< The server sent its certificate. */
+} TlsSessionHandshake_t;
+
+/**
+ * @brief Create the lock of the cache. Call once before any connection is
+ * made; until then the cache stays empty and every handshake is full.
+ */
+void TlsSessionCache_Init( void );
+
+/**
+ * @brief Offer the cached session of an endpoint, if any.
+ *
+ * Installs a verify callback on `pxConfig`, which must belong to this
+ * handshake alone.
+ *
+ * @param[out] pxHandshake State of this handshake; must outlive it.
+ * @param[in] pxConfig Configuration of `pxSsl`.
+ * @param[in] pxSsl Context after mbedtls_ssl_setup().
+ * @param[in] pcHost Host name, or address, of the endpoint; NULL to not
+ * cache this connection.
+ * @param[in] usPort Port of the endpoint.
+ * @param[in] pcTrustedCa PEM of the CA the server is verified with.
+ * @param[in] xTrustedCaLength Length of `pcTrustedCa`.
+ */
+void TlsSessionCache_Begin( TlsSessionHandshake_t * pxHandshake,
+                            mbedtls_ssl_config * pxConfig,
+                            mbedtls_ssl_context * pxSsl,
+                            const char * pcHost,
+                            uint16_t usPort,
+                            const char * pcTrustedCa,
+                            size_t xTrustedCaLength );
+
+/**
+ * @brief Keep the session agreed, or forget the one offered if the
+ * handshake failed.
+ *
+ * @param[in] pxHandshake State given to TlsSessionCache_Begin().
+ * @param[in] pxSsl The context of the handshake.
+ * @param[in] lResult What mbedtls_ssl_handshake() returned.
+ *
+ * @return pdTRUE if the handshake completed and resumed a session.
+ */
+BaseType_t TlsSessionCache_End( TlsSessionHandshake_t * pxHandshake,
+                                const mbedtls_ssl_context * pxSsl,
+                                int lResult );
+
+/**
+ * @brief Copy the handshake counts of one endpoint.
+ *
+ * @return pdPASS if the endpoint is kept.
+ */
+BaseType_t TlsSessionCache_GetStats( const char * pcHost,
+                                     uint16_t usPort,
+                                     TlsSessionStats_t * pxStats );
+
+#endif /* _TLS_SESSION_CACHE_H_ */
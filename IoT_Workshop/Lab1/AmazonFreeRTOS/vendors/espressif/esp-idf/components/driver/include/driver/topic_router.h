@@ -0,0 +1,184 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file topic_router.h
+ * @brief Route incoming MQTT messages to handlers by topic filter.
+ *
+ * The demos subscribe to a few broad filters and route what arrives to the
+ * handlers registered here, which take any number of filters with the `+`
+ * and `#` wildcards of MQTT 3.1.1. A topic may match several filters, and a
+ * filter may have several handlers; each is called once per match.
+ *
+ * Filters are kept in a trie with one node per level. The children of all
+ * nodes share one open-addressed hash table keyed by parent and level, and
+ * each node holds its `+` child and its `#` handlers directly. Matching
+ * walks the topic a level at a time, with one hash lookup for each node
+ * still in the running, however many filters there are. It copies nothing
+ * and takes no lock. The nodes in the running are distinct nodes of one
+ * level, so they are followed in two arrays of topicrouterMAX_NODES on the
+ * stack and no match is ever dropped.
+ *
+ * All storage is inside #TopicRouter_t. Routes are added before messages
+ * arrive; from then on the router is only read, from any number of tasks.
+ * Filter strings are not copied and must stay valid.
+ *
+ * A topic starting with '$' does not match a filter starting with a
+ * wildcard, as MQTT requires.
+ */
+
+#ifndef _TOPIC_ROUTER_H_
+#define _TOPIC_ROUTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Trie nodes, the root included. Each distinct level of a filter,
+ * other than a trailing `#`, takes one.
+ */
+#ifndef topicrouterMAX_NODES
+    #define topicrouterMAX_NODES       ( 32 )
+#endif
+
+/**
+ * @brief Handlers registered, over all filters.
+ */
+#ifndef topicrouterMAX_ROUTES
+    #define topicrouterMAX_ROUTES      ( 16 )
+#endif
+
+/**
+ * @brief Slots of the child hash table; a power of two above
+ * topicrouterMAX_NODES.
+ */
+#ifndef topicrouterHASH_SLOTS
+    #define topicrouterHASH_SLOTS      ( 64 )
+#endif
+
+#if ( topicrouterHASH_SLOTS & ( topicrouterHASH_SLOTS - 1 ) ) != 0
+    #error "topicrouterHASH_SLOTS must be a power of two."
+#endif
+#if topicrouterHASH_SLOTS <= topicrouterMAX_NODES
+    #error "topicrouterHASH_SLOTS must be larger than topicrouterMAX_NODES."
+#endif
+#if ( topicrouterMAX_NODES > 65535 ) || ( topicrouterMAX_ROUTES > 65534 )
+    #error "Nodes and routes are numbered on 16 bits."
+#endif
+
+/**
+ * @brief A handler.
+ *
+ * @param[in] pvContext As registered.
+ * @param[in] pcTopic The topic name, not terminated.
+ * @param[in] xTopicLength Length of pcTopic.
+ * @param[in] pvMessage As passed to TopicRouter_Dispatch().
+ */
+typedef void ( * TopicHandler_t )( void * pvContext,
+                                   const char * pcTopic,
+                                   size_t xTopicLength,
+                                   void * pvMessage );
+
+/**
+ * @brief A level of a filter.
+ */
+typedef struct TopicRouterNode
+{
+    const char * pcLevel;  /**< Text of the level, in the filter it was added with. */
+    uint32_t ulHash;       /**< Hash of the parent and the level. */
+    uint16_t usLevelLength;
+    uint16_t usParent;
+    uint16_t usPlus;       /**< Child for `+`; 0 if none. */
+    uint16_t usRoutes;     /**< First handler of the filter ending here; 0 if none. */
+    uint16_t usHashRoutes; /**< First handler of the filter ending with `#` here. */
+} TopicRouterNode_t;
+
+/**
+ * @brief A handler of a filter.
+ */
+typedef struct TopicRouterRoute
+{
+    TopicHandler_t xHandler;
+    void * pvContext;
+    uint16_t usNext; /**< Next handler of the same filter; 0 if none. */
+} TopicRouterRoute_t;
+
+/**
+ * @brief A router. Members are private; use the functions below.
+ */
+typedef struct TopicRouter
+{
+    TopicRouterNode_t xNodes[ topicrouterMAX_NODES ];       /**< Node 0 is the root. */
+    TopicRouterRoute_t xRoutes[ topicrouterMAX_ROUTES + 1 ]; /**< Route 0 is unused. */
+    uint16_t usSlots[ topicrouterHASH_SLOTS ];               /**< Children by hash; 0 if empty. */
+    uint16_t usNodeCount;
+    uint16_t usRouteCount;
+} TopicRouter_t;
+
+/**
+ * @brief Remove every route.
+ */
+void TopicRouter_Init( TopicRouter_t * pxRouter );
+
+/**
+ * @brief Call a handler for the messages on topics that match a filter.
+ *
+ * Handlers of one filter are called in the order they were added. The same
+ * handler may be added to several filters, and is then called once for
+ * each of them that matches.
+ *
+ * @param[in] pxRouter The router.
+ * @param[in] pcFilter The filter; must stay valid.
+ * @param[in] xFilterLength Length of pcFilter.
+ * @param[in] xHandler The handler.
+ * @param[in] pvContext Passed to the handler.
+ *
+ * @return false if the filter is not valid, or there is no room. The levels
+ * already added then stay, without a handler.
+ */
+bool TopicRouter_Add( TopicRouter_t * pxRouter,
+                      const char * pcFilter,
+                      size_t xFilterLength,
+                      TopicHandler_t xHandler,
+                      void * pvContext );
+
+/**
+ * @brief Call the handlers of every filter that matches a topic name.
+ *
+ * @param[in] pxRouter The router.
+ * @param[in] pcTopic The topic name; it need not be terminated.
+ * @param[in] xTopicLength Length of pcTopic.
+ * @param[in] pvMessage Passed to the handlers.
+ *
+ * @return Number of handlers called.
+ */
+size_t TopicRouter_Dispatch( const TopicRouter_t * pxRouter,
+                             const char * pcTopic,
+                             size_t xTopicLength,
+                             void * pvMessage );
+
+#endif /* _TOPIC_ROUTER_H_ */
@@ -0,0 +1,222 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file stream_stats.c
+ * @brief Running statistics and anomalies of readings.
+ */
+
+/* Standard includes. */
+#include <math.h>
+#include <string.h>
+
+#include "driver/stream_stats.h"
+
+/*-----------------------------------------------------------*/
+
+bool StreamStats_Init( StreamStats_t * pxStats,
+                       const StreamStatsConfig_t * pxConfig )
+{
+    size_t i;
+
+    if( ( pxConfig->uxChannels == 0 ) ||
+        ( pxConfig->uxChannels > streamstatsMAX_CHANNELS ) ||
+        ( pxConfig->ulWindow < 2 ) ||
+        ( !( pxConfig->fZThreshold > 0.0f ) ) )
+    {
+        return false;
+    }
+
+    for( i = 0; i < pxConfig->uxChannels; i++ )
+    {
+        if( pxConfig->lMinDeviation[ i ] <= 0 )
+        {
+            return false;
+        }
+    }
+
+    ( void ) memset( pxStats, 0x00, sizeof( *pxStats ) );
+    pxStats->xConfig = *pxConfig;
+    pxStats->dAlpha = 2.0 / ( ( double ) pxConfig->ulWindow + 1.0 );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool StreamStats_Add( StreamStats_t * pxStats,
+                      const int32_t * plValues,
+                      float * pfZScores,
+                      uint32_t * pulAnomalies )
+{
+    const StreamStatsConfig_t * pxConfig = &( pxStats->xConfig );
+    StreamStatsChannel_t * pxChannel;
+    uint32_t ulAnomalies = 0;
+    bool xClosed = false;
+    double dValue, dDelta, dDeviation, dAlpha, dZ;
+    size_t i;
+
+    for( i = 0; i < pxConfig->uxChannels; i++ )
+    {
+        pxChannel = &( pxStats->xChannels[ i ] );
+        dValue = ( double ) plValues[ i ];
+        dZ = 0.0;
+
+        /* Score the value against the readings before it. */
+        if( pxChannel->ulSeen >= pxConfig->ulWindow )
+        {
+            dDeviation = sqrt( pxChannel->dSlidingVariance );
+
+            if( dDeviation < ( double ) pxConfig->lMinDeviation[ i ] )
+            {
+                dDeviation = ( double ) pxConfig->lMinDeviation[ i ];
+            }
+
+            dZ = ( dValue - pxChannel->dSlidingMean ) / dDeviation;
+
+            if( fabs( dZ ) >= ( double ) pxConfig->fZThreshold )
+            {
+                if( pxChannel->xAnomalous == false )
+                {
+                    ulAnomalies |= ( 1UL << i );
+                }
+
+                pxChannel->xAnomalous = true;
+            }
+            else if( fabs( dZ ) < ( double ) pxConfig->fZThreshold / 2.0 )
+            {
+                /* Noise about the threshold does not repeat the event. */
+                pxChannel->xAnomalous = false;
+            }
+        }
+        else
+        {
+            pxChannel->ulSeen++;
+        }
+
+        if( pfZScores != NULL )
+        {
+            pfZScores[ i ] = ( float ) dZ;
+        }
+
+        /* The sliding window. Weighing the first readings by 1 / n gives
+         * their plain mean and variance. The variance is updated about the
+         * old and new means, so that it cannot go negative. */
+        dAlpha = 1.0 / ( double ) pxChannel->ulSeen;
+
+        if( dAlpha < pxStats->dAlpha )
+        {
+            dAlpha = pxStats->dAlpha;
+        }
+
+        dDelta = dValue - pxChannel->dSlidingMean;
+        pxChannel->dSlidingMean += dAlpha * dDelta;
+        pxChannel->dSlidingVariance = ( 1.0 - dAlpha ) * ( pxChannel->dSlidingVariance + ( dAlpha * dDelta * dDelta ) );
+
+        /* The tumbling window, by Welford's method. */
+        if( pxChannel->ulCount == 0 )
+        {
+            pxChannel->lMin = plValues[ i ];
+            pxChannel->lMax = plValues[ i ];
+        }
+        else if( plValues[ i ] < pxChannel->lMin )
+        {
+            pxChannel->lMin = plValues[ i ];
+        }
+        else if( plValues[ i ] > pxChannel->lMax )
+        {
+            pxChannel->lMax = plValues[ i ];
+        }
+
+        pxChannel->ulCount++;
+        dDelta = dValue - pxChannel->dMean;
+        pxChannel->dMean += dDelta / ( double ) pxChannel->ulCount;
+        pxChannel->dM2 += dDelta * ( dValue - pxChannel->dMean );
+
+        if( pxChannel->ulCount >= pxConfig->ulWindow )
+        {
+            pxChannel->xClosed.ulCount = pxChannel->ulCount;
+            pxChannel->xClosed.fMean = ( float ) pxChannel->dMean;
+            pxChannel->xClosed.fVariance = ( float ) ( pxChannel->dM2 / ( double ) pxChannel->ulCount );
+            pxChannel->xClosed.lMin = pxChannel->lMin;
+            pxChannel->xClosed.lMax = pxChannel->lMax;
+            pxChannel->ulCount = 0;
+            pxChannel->dMean = 0.0;
+            pxChannel->dM2 = 0.0;
+            xClosed = true;
+        }
+    }
+
+    if( pulAnomalies != NULL )
+    {
+        *pulAnomalies = ulAnomalies;
+    }
+
+    return xClosed;
+}
+
+/*-----------------------------------------------------------*/
+
+void StreamStats_Tumbling( const StreamStats_t * pxStats,
+                           size_t uxChannel,
+                           StreamStatsSummary_t * pxSummary )
+{
+    *pxSummary = pxStats->xChannels[ uxChannel ].xClosed;
+}
+
+/*-----------------------------------------------------------*/
+
+void StreamStats_Sliding( const StreamStats_t * pxStats,
+                          size_t uxChannel,
+                          StreamStatsSummary_t * pxSummary )
+{
+    const StreamStatsChannel_t * pxChannel = &( pxStats->xChannels[ uxChannel ] );
+
+    pxSummary->ulCount = pxChannel->ulSeen;
+    pxSummary->fMean = ( float ) pxChannel->dSlidingMean;
+    pxSummary->fVariance = ( float ) pxChannel->dSlidingVariance;
+    pxSummary->lMin = pxChannel->lMin;
+    pxSummary->lMax = pxChannel->lMax;
+
+    /* The open window is empty just after a close. */
+    if( pxChannel->ulCount == 0 )
+    {
+        pxSummary->lMin = pxChannel->xClosed.lMin;
+        pxSummary->lMax = pxChannel->xClosed.lMax;
+    }
+    else if( pxChannel->xClosed.ulCount > 0 )
+    {
+        if( pxChannel->xClosed.lMin < pxSummary->lMin )
+        {
+            pxSummary->lMin = pxChannel->xClosed.lMin;
+        }
+
+        if( pxChannel->xClosed.lMax > pxSummary->lMax )
+        {
+            pxSummary->lMax = pxChannel->xClosed.lMax;
+        }
+    }
+}
@@ -0,0 +1,347 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file topic_router.c
+ * @brief Trie of MQTT topic filters.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "driver/topic_router.h"
+
+/*-----------------------------------------------------------*/
+
+/* FNV-1a of a level, mixed with its parent. */
+static uint32_t prvHash( uint16_t usParent,
+                         const char * pcLevel,
+                         size_t xLength )
+{
+    uint32_t ulHash = 2166136261UL ^ ( ( uint32_t ) usParent * 0x9E3779B1UL );
+    size_t x;
+
+    for( x = 0; x < xLength; x++ )
+    {
+        ulHash = ( ulHash ^ ( uint8_t ) pcLevel[ x ] ) * 16777619UL;
+    }
+
+    return ulHash;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The child of a node for a level, or the empty slot it would go in. */
+static uint32_t prvFindSlot( const TopicRouter_t * pxRouter,
+                             uint16_t usParent,
+                             const char * pcLevel,
+                             size_t xLength,
+                             uint32_t ulHash )
+{
+    uint32_t ulSlot = ulHash & ( topicrouterHASH_SLOTS - 1 );
+    const TopicRouterNode_t * pxNode;
+
+    /* There is always an empty slot, as there are more slots than nodes. */
+    while( pxRouter->usSlots[ ulSlot ] != 0 )
+    {
+        pxNode = &( pxRouter->xNodes[ pxRouter->usSlots[ ulSlot ] ] );
+
+        if( ( pxNode->ulHash == ulHash ) &&
+            ( pxNode->usParent == usParent ) &&
+            ( pxNode->usLevelLength == xLength ) &&
+            ( memcmp( pxNode->pcLevel, pcLevel, xLength ) == 0 ) )
+        {
+            break;
+        }
+
+        ulSlot = ( ulSlot + 1 ) & ( topicrouterHASH_SLOTS - 1 );
+    }
+
+    return ulSlot;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t prvNewNode( TopicRouter_t * pxRouter,
+                            uint16_t usParent,
+                            const char * pcLevel,
+                            size_t xLength,
+                            uint32_t ulHash )
+{
+    TopicRouterNode_t * pxNode;
+
+    if( ( pxRouter->usNodeCount >= topicrouterMAX_NODES ) || ( xLength > UINT16_MAX ) )
+    {
+        return 0;
+    }
+
+    pxNode = &( pxRouter->xNodes[ pxRouter->usNodeCount ] );
+    ( void ) memset( pxNode, 0x00, sizeof( TopicRouterNode_t ) );
+    pxNode->pcLevel = pcLevel;
+    pxNode->usLevelLength = ( uint16_t ) xLength;
+    pxNode->usParent = usParent;
+    pxNode->ulHash = ulHash;
+
+    return pxRouter->usNodeCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Append a route to a list, keeping the order of registration. */
+static bool prvAppendRoute( TopicRouter_t * pxRouter,
+                            uint16_t * pusList,
+                            TopicHandler_t xHandler,
+                            void * pvContext )
+{
+    uint16_t usRoute;
+
+    if( pxRouter->usRouteCount >= topicrouterMAX_ROUTES )
+    {
+        return false;
+    }
+
+    usRoute = ++( pxRouter->usRouteCount );
+    pxRouter->xRoutes[ usRoute ].xHandler = xHandler;
+    pxRouter->xRoutes[ usRoute ].pvContext = pvContext;
+    pxRouter->xRoutes[ usRoute ].usNext = 0;
+
+    while( *pusList != 0 )
+    {
+        pusList = &( pxRouter->xRoutes[ *pusList ].usNext );
+    }
+
+    *pusList = usRoute;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void TopicRouter_Init( TopicRouter_t * pxRouter )
+{
+    ( void ) memset( pxRouter, 0x00, sizeof( TopicRouter_t ) );
+
+    /* The root. */
+    pxRouter->usNodeCount = 1;
+}
+
+/*-----------------------------------------------------------*/
+
+bool TopicRouter_Add( TopicRouter_t * pxRouter,
+                      const char * pcFilter,
+                      size_t xFilterLength,
+                      TopicHandler_t xHandler,
+                      void * pvContext )
+{
+    uint16_t usNode = 0, usChild;
+    size_t xStart = 0, xEnd;
+    uint32_t ulHash, ulSlot;
+    const char * pcWildcard;
+
+    if( ( xFilterLength == 0 ) || ( xHandler == NULL ) )
+    {
+        return false;
+    }
+
+    for( ; ; )
+    {
+        for( xEnd = xStart; ( xEnd < xFilterLength ) && ( pcFilter[ xEnd ] != '/' ); xEnd++ )
+        {
+        }
+
+        /* A wildcard must be a whole level, and `#` the last one. */
+        pcWildcard = memchr( pcFilter + xStart, '+', xEnd - xStart );
+
+        if( pcWildcard == NULL )
+        {
+            pcWildcard = memchr( pcFilter + xStart, '#', xEnd - xStart );
+        }
+
+        if( pcWildcard != NULL )
+        {
+            if( xEnd - xStart != 1 )
+            {
+                return false;
+            }
+
+            if( *pcWildcard == '#' )
+            {
+                return ( xEnd == xFilterLength ) &&
+                       prvAppendRoute( pxRouter, &( pxRouter->xNodes[ usNode ].usHashRoutes ), xHandler, pvContext );
+            }
+
+            usChild = pxRouter->xNodes[ usNode ].usPlus;
+
+            if( usChild == 0 )
+            {
+                usChild = prvNewNode( pxRouter, usNode, pcWildcard, 1, 0 );
+                pxRouter->xNodes[ usNode ].usPlus = usChild;
+            }
+        }
+        else
+        {
+            ulHash = prvHash( usNode, pcFilter + xStart, xEnd - xStart );
+            ulSlot = prvFindSlot( pxRouter, usNode, pcFilter + xStart, xEnd - xStart, ulHash );
+            usChild = pxRouter->usSlots[ ulSlot ];
+
+            if( usChild == 0 )
+            {
+                usChild = prvNewNode( pxRouter, usNode, pcFilter + xStart, xEnd - xStart, ulHash );
+                pxRouter->usSlots[ ulSlot ] = usChild;
+            }
+        }
+
+        if( usChild == 0 )
+        {
+            return false;
+        }
+
+        usNode = usChild;
+
+        if( xEnd == xFilterLength )
+        {
+            break;
+        }
+
+        xStart = xEnd + 1;
+    }
+
+    return prvAppendRoute( pxRouter, &( pxRouter->xNodes[ usNode ].usRoutes ), xHandler, pvContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvCallRoutes( const TopicRouter_t * pxRouter,
+                             uint16_t usRoute,
+                             const char * pcTopic,
+                             size_t xTopicLength,
+                             void * pvMessage )
+{
+    size_t xCalled = 0;
+
+    for( ; usRoute != 0; usRoute = pxRouter->xRoutes[ usRoute ].usNext )
+    {
+        pxRouter->xRoutes[ usRoute ].xHandler( pxRouter->xRoutes[ usRoute ].pvContext,
+                                               pcTopic,
+                                               xTopicLength,
+                                               pvMessage );
+        xCalled++;
+    }
+
+    return xCalled;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t TopicRouter_Dispatch( const TopicRouter_t * pxRouter,
+                             const char * pcTopic,
+                             size_t xTopicLength,
+                             void * pvMessage )
+{
+    /* Each node has one parent, so a level never holds a node twice and
+     * the nodes of a level always fit. */
+    uint16_t usFrontier[ 2 ][ topicrouterMAX_NODES ];
+    size_t xCount = 1, xNextCount, x;
+    size_t xStart = 0, xEnd, xCalled = 0;
+    uint16_t * pusNodes = usFrontier[ 0 ];
+    uint16_t * pusNext = usFrontier[ 1 ];
+    uint16_t * pusSwap;
+    uint16_t usNode, usChild;
+    uint32_t ulHash, ulSlot;
+    bool xDollar;
+
+    if( xTopicLength == 0 )
+    {
+        return 0;
+    }
+
+    xDollar = ( pcTopic[ 0 ] == '$' );
+    pusNodes[ 0 ] = 0;
+
+    for( ; ; )
+    {
+        for( xEnd = xStart; ( xEnd < xTopicLength ) && ( pcTopic[ xEnd ] != '/' ); xEnd++ )
+        {
+        }
+
+        xNextCount = 0;
+
+        for( x = 0; x < xCount; x++ )
+        {
+            usNode = pusNodes[ x ];
+
+            /* Wildcards at the first level do not match "$" topics. */
+            if( ( usNode == 0 ) && ( xDollar == true ) )
+            {
+                usChild = 0;
+            }
+            else
+            {
+                /* A `#` below this node matches this level and the rest. */
+                xCalled += prvCallRoutes( pxRouter, pxRouter->xNodes[ usNode ].usHashRoutes,
+                                          pcTopic, xTopicLength, pvMessage );
+                usChild = pxRouter->xNodes[ usNode ].usPlus;
+            }
+
+            if( usChild != 0 )
+            {
+                pusNext[ xNextCount++ ] = usChild;
+            }
+
+            ulHash = prvHash( usNode, pcTopic + xStart, xEnd - xStart );
+            ulSlot = prvFindSlot( pxRouter, usNode, pcTopic + xStart, xEnd - xStart, ulHash );
+            usChild = pxRouter->usSlots[ ulSlot ];
+
+            if( usChild != 0 )
+            {
+                pusNext[ xNextCount++ ] = usChild;
+            }
+        }
+
+        pusSwap = pusNodes;
+        pusNodes = pusNext;
+        pusNext = pusSwap;
+        xCount = xNextCount;
+
+        if( ( xCount == 0 ) || ( xEnd == xTopicLength ) )
+        {
+            break;
+        }
+
+        xStart = xEnd + 1;
+    }
+
+    /* The topic ends at these nodes; "a/#" also matches "a". */
+    for( x = 0; x < xCount; x++ )
+    {
+        usNode = pusNodes[ x ];
+        xCalled += prvCallRoutes( pxRouter, pxRouter->xNodes[ usNode ].usRoutes,
+                                  pcTopic, xTopicLength, pvMessage );
+        xCalled += prvCallRoutes( pxRouter, pxRouter->xNodes[ usNode ].usHashRoutes,
+                                  pcTopic, xTopicLength, pvMessage );
+    }
+
+    return xCalled;
+}
@@ -0,0 +1,361 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_fanout.c
+ * @brief Publish one serialized message to several brokers.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* MQTT includes. */
+#include "aws_mqtt_agent.h"
+#include "aws_clientcredential.h"
+
+#include "aws_fanout.h"
+#include "aws_tls_metrics.h"
+
+#include "driver/stack_budget.h"
+
+/* Consecutive publish failures taken as a dead link. */
+#define fanoutMAX_PUBLISH_FAILURES    ( 3 )
+
+#if ( democonfigSTATIC_ALLOCATION == 1 )
+    #if ( fanoutPOOL_MESSAGES < 1 ) || ( fanoutPOOL_MESSAGES > 32 )
+        #error "fanoutPOOL_MESSAGES must be between 1 and 32."
+    #endif
+
+    /* Words per pooled message, so that each one stays word aligned. */
+    #define fanoutPOOL_MESSAGE_WORDS \
+    ( ( sizeof( FanoutMessage_t ) + fanoutPOOL_PAYLOAD_SIZE + sizeof( uint32_t ) - 1 ) / sizeof( uint32_t ) )
+
+    static uint32_t ulPool[ fanoutPOOL_MESSAGES ][ fanoutPOOL_MESSAGE_WORDS ];
+
+    /* Bit n is set while message n of the pool is free. */
+    static uint32_t ulPoolFree = ( uint32_t ) ( 0xFFFFFFFFULL >> ( 32 - fanoutPOOL_MESSAGES ) );
+
+    static StaticQueue_t xCloudQueueBuffer;
+    static uint8_t ucCloudQueueStorage[ fanoutCLOUD_QUEUE_LENGTH * sizeof( FanoutMessage_t * ) ];
+    static StaticTask_t xCloudTaskBuffer;
+    static StackType_t xCloudTaskStack[ fanoutCLOUD_TASK_STACK_SIZE ];
+#endif
+
+static QueueHandle_t xCloudQueue = NULL;
+static volatile BaseType_t xCloudLinkUp = pdFALSE;
+static const TickType_t xCloudCommandTime = pdMS_TO_TICKS( 20000UL );
+
+/*-----------------------------------------------------------*/
+
+#if ( democonfigSTATIC_ALLOCATION == 1 )
+
+    static FanoutMessage_t * prvPoolTake( void )
+    {
+        uint32_t ulFree = __atomic_load_n( &ulPoolFree, __ATOMIC_ACQUIRE );
+        uint32_t ulIndex;
+
+        do
+        {
+            if( ulFree == 0 )
+            {
+                return NULL;
+            }
+
+            ulIndex = ( uint32_t ) __builtin_ctz( ulFree );
+        } while( __atomic_compare_exchange_n( &ulPoolFree, &ulFree, ulFree & ~( 1UL << ulIndex ),
+                                              false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) == false );
+
+        return ( FanoutMessage_t * ) ulPool[ ulIndex ];
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvPoolGive( FanoutMessage_t * pxMessage )
+    {
+        uint32_t ulIndex = ( uint32_t ) ( ( ( uint32_t * ) pxMessage - ulPool[ 0 ] ) / fanoutPOOL_MESSAGE_WORDS );
+
+        ( void ) __atomic_fetch_or( &ulPoolFree, 1UL << ulIndex, __ATOMIC_RELEASE );
+    }
+
+#endif /* if ( democonfigSTATIC_ALLOCATION == 1 ) */
+
+/*-----------------------------------------------------------*/
+
+FanoutMessage_t * Fanout_Alloc( const char * pcTopic,
+                                size_t xCapacity )
+{
+    FanoutMessage_t * pxMessage;
+
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        pxMessage = ( xCapacity <= fanoutPOOL_PAYLOAD_SIZE ) ? prvPoolTake() : NULL;
+    #else
+        pxMessage = pvPortMalloc( sizeof( FanoutMessage_t ) + xCapacity );
+    #endif
+
+    if( pxMessage != NULL )
+    {
+        pxMessage->ulReferences = 1;
+        pxMessage->pcTopic = pcTopic;
+        pxMessage->ulLength = 0;
+        pxMessage->ulCapacity = ( uint32_t ) xCapacity;
+    }
+
+    return pxMessage;
+}
+
+/*-----------------------------------------------------------*/
+
+void Fanout_Retain( FanoutMessage_t * pxMessage )
+{
+    ( void ) __atomic_add_fetch( &( pxMessage->ulReferences ), 1, __ATOMIC_ACQ_REL );
+}
+
+/*-----------------------------------------------------------*/
+
+void Fanout_Release( FanoutMessage_t * pxMessage )
+{
+    if( __atomic_sub_fetch( &( pxMessage->ulReferences ), 1, __ATOMIC_ACQ_REL ) == 0 )
+    {
+        #if ( democonfigSTATIC_ALLOCATION == 1 )
+            prvPoolGive( pxMessage );
+        #else
+            vPortFree( pxMessage );
+        #endif
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCloudEventCallback( void * pvUserData,
+                                         const MQTTAgentCallbackParams_t * const pxCallbackParams )
+{
+    ( void ) pvUserData;
+
+    if( pxCallbackParams->xMQTTEvent == eMQTTAgentDisconnect )
+    {
+        xCloudLinkUp = pdFALSE;
+    }
+
+    /* The agent keeps ownership of any buffer. */
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCloudConnect( MQTTAgentHandle_t xClient )
+{
+    MQTTAgentConnectParams_t xConnectParams;
+    MQTTAgentReturnCode_t xReturnCode;
+    TickType_t xStart;
+
+    memset( &xConnectParams, 0, sizeof( xConnectParams ) );
+    xConnectParams.pcURL = clientcredentialMQTT_BROKER_ENDPOINT;
+    xConnectParams.xFlags = mqttagentREQUIRE_TLS;
+    xConnectParams.xURLIsIPAddress = pdFALSE; /* Deprecated. */
+    xConnectParams.usPort = clientcredentialMQTT_BROKER_PORT;
+    xConnectParams.pucClientId = ( const uint8_t * ) clientcredentialIOT_THING_NAME;
+    xConnectParams.usClientIdLength = ( uint16_t ) strlen( clientcredentialIOT_THING_NAME );
+    xConnectParams.xSecuredConnection = pdTRUE; /* Deprecated. */
+    xConnectParams.pvUserData = NULL;
+    xConnectParams.pxCallback = prvCloudEventCallback;
+
+    /* No certificate given: the default root CA authenticates IoT Core. */
+    xConnectParams.pcCertificate = NULL;
+    xConnectParams.ulCertificateSize = 0;
+
+    xStart = xTaskGetTickCount();
+    xReturnCode = MQTT_AGENT_Connect( xClient, &xConnectParams, xCloudCommandTime );
+    TLSMetrics_Record( clientcredentialMQTT_BROKER_ENDPOINT,
+                       clientcredentialMQTT_BROKER_PORT,
+                       ( xReturnCode == eMQTTAgentSuccess ) ? pdTRUE : pdFALSE,
+                       xTaskGetTickCount() - xStart );
+
+    return ( xReturnCode == eMQTTAgentSuccess ) ? pdPASS : pdFAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCloudLinkTask( void * pvParameters )
+{
+    MQTTAgentHandle_t xClient = ( MQTTAgentHandle_t ) pvParameters;
+    MQTTAgentPublishParams_t xPublishParams;
+    FanoutMessage_t * pxMessage = NULL;
+    uint32_t ulPublishFailures = 0;
+
+    StackBudget_Register( NULL, "fanoutCLOUD_TASK_STACK_SIZE", fanoutCLOUD_TASK_STACK_SIZE );
+
+    for( ; ; )
+    {
+        if( xCloudLinkUp == pdFALSE )
+        {
+            /* A connection that IoT Core dropped is closed before the next
+             * one, as the agent does not connect over it; there is none the
+             * first time. */
+            ( void ) MQTT_AGENT_Disconnect( xClient, xCloudCommandTime );
+
+            if( prvCloudConnect( xClient ) == pdPASS )
+            {
+                configPRINTF( ( "Connected to AWS IoT Core.\r\n" ) );
+                ulPublishFailures = 0;
+                xCloudLinkUp = pdTRUE;
+            }
+            else
+            {
+                configPRINTF( ( "Could not connect to AWS IoT Core, retrying.\r\n" ) );
+                vTaskDelay( pdMS_TO_TICKS( fanoutCLOUD_RECONNECT_DELAY_MS ) );
+                continue;
+            }
+        }
+
+        /* A message that was not acknowledged is published again before
+         * the next one is taken. */
+        if( ( pxMessage == NULL ) &&
+            ( xQueueReceive( xCloudQueue, &pxMessage, pdMS_TO_TICKS( fanoutCLOUD_RECONNECT_DELAY_MS ) ) != pdTRUE ) )
+        {
+            pxMessage = NULL;
+            continue;
+        }
+
+        memset( &xPublishParams, 0, sizeof( xPublishParams ) );
+        xPublishParams.pucTopic = ( const uint8_t * ) pxMessage->pcTopic;
+        xPublishParams.usTopicLength = ( uint16_t ) strlen( pxMessage->pcTopic );
+        xPublishParams.pvData = pxMessage->cPayload;
+        xPublishParams.ulDataLength = pxMessage->ulLength;
+        xPublishParams.xQoS = eMQTTQoS1;
+
+        /* At QoS 1 the agent returns once IoT Core has acknowledged the
+         * message, which is only then released. */
+        if( MQTT_AGENT_Publish( xClient, &xPublishParams, xCloudCommandTime ) == eMQTTAgentSuccess )
+        {
+            ulPublishFailures = 0;
+            Fanout_Release( pxMessage );
+            pxMessage = NULL;
+        }
+        else if( ++ulPublishFailures >= fanoutMAX_PUBLISH_FAILURES )
+        {
+            configPRINTF( ( "Lost connection to AWS IoT Core.\r\n" ) );
+            xCloudLinkUp = pdFALSE;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Fanout_StartCloudLink( void )
+{
+    MQTTAgentHandle_t xClient;
+    QueueHandle_t xQueue;
+    TaskHandle_t xTask = NULL;
+
+    if( xCloudQueue != NULL )
+    {
+        return pdPASS;
+    }
+
+    /* The agent must be configured for more than one broker
+     * (mqttconfigMAX_BROKERS) for this second client to exist. */
+    if( MQTT_AGENT_Create( &xClient ) != eMQTTAgentSuccess )
+    {
+        configPRINTF( ( "ERROR: no MQTT client left for the AWS IoT Core link.\r\n" ) );
+
+        return pdFAIL;
+    }
+
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        xQueue = xQueueCreateStatic( fanoutCLOUD_QUEUE_LENGTH,
+                                     sizeof( FanoutMessage_t * ),
+                                     ucCloudQueueStorage,
+                                     &xCloudQueueBuffer );
+    #else
+        xQueue = xQueueCreate( fanoutCLOUD_QUEUE_LENGTH, sizeof( FanoutMessage_t * ) );
+    #endif
+
+    if( xQueue == NULL )
+    {
+        ( void ) MQTT_AGENT_Delete( xClient );
+
+        return pdFAIL;
+    }
+
+    /* Publish the queue before the task starts receiving from it. */
+    xCloudQueue = xQueue;
+
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        xTask = xTaskCreateStaticPinnedToCore( prvCloudLinkTask,
+                                               "CloudLink",
+                                               fanoutCLOUD_TASK_STACK_SIZE,
+                                               xClient,
+                                               fanoutCLOUD_TASK_PRIORITY,
+                                               xCloudTaskStack,
+                                               &xCloudTaskBuffer,
+                                               fanoutCLOUD_TASK_CORE );
+    #else
+        ( void ) xTaskCreatePinnedToCore( prvCloudLinkTask,
+                                          "CloudLink",
+                                          fanoutCLOUD_TASK_STACK_SIZE,
+                                          xClient,
+                                          fanoutCLOUD_TASK_PRIORITY,
+                                          &xTask,
+                                          fanoutCLOUD_TASK_CORE );
+    #endif
+
+    if( xTask == NULL )
+    {
+        xCloudQueue = NULL;
+        vQueueDelete( xQueue );
+        ( void ) MQTT_AGENT_Delete( xClient );
+
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Fanout_SendToCloud( FanoutMessage_t * pxMessage )
+{
+    if( xCloudQueue == NULL )
+    {
+        return pdFAIL;
+    }
+
+    Fanout_Retain( pxMessage );
+
+    if( xQueueSend( xCloudQueue, &pxMessage, 0 ) != pdTRUE )
+    {
+        Fanout_Release( pxMessage );
+
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
@@ -0,0 +1,157 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_fanout.h
+ * @brief Publish one serialized message to several brokers.
+ *
+ * A message is formatted once into a reference counted buffer. Every
+ * destination it is routed to holds a reference, and the buffer is freed
+ * when the last one has published it. Besides the Greengrass core that the
+ * demo already talks to, a second connection to AWS IoT Core is kept by a
+ * task of its own so that a slow or broken cloud link never delays local
+ * traffic. That link publishes at QoS 1 and keeps each message until IoT
+ * Core acknowledges it, publishing it again after a reconnect.
+ *
+ * With democonfigSTATIC_ALLOCATION set, messages come from a fixed pool
+ * instead of the heap, and the queue and task of the cloud link are
+ * allocated statically.
+ */
+
+#ifndef _AWS_FANOUT_H_
+#define _AWS_FANOUT_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Demo includes. */
+#include "aws_demo_config.h"
+
+/**
+ * @brief Destinations a message can be routed to; combine as a bit mask.
+ */
+#define fanoutROUTE_GGC                   ( 1UL << 0 )
+#define fanoutROUTE_CLOUD                 ( 1UL << 1 )
+
+/**
+ * @brief Messages waiting for the cloud link, besides the one it is
+ * publishing. Further messages are dropped while the queue is full, e.g.
+ * during a reconnect.
+ */
+#ifndef fanoutCLOUD_QUEUE_LENGTH
+    #define fanoutCLOUD_QUEUE_LENGTH      ( 8 )
+#endif
+
+#ifndef fanoutCLOUD_TASK_STACK_SIZE
+    #define fanoutCLOUD_TASK_STACK_SIZE   ( 6144 )
+#endif
+
+#ifndef fanoutCLOUD_TASK_PRIORITY
+    #define fanoutCLOUD_TASK_PRIORITY     ( tskIDLE_PRIORITY + 3 )
+#endif
+
+/**
+ * @brief Core of the cloud link task; the network core, away from sampling.
+ */
+#ifndef fanoutCLOUD_TASK_CORE
+    #define fanoutCLOUD_TASK_CORE         ( 0 )
+#endif
+
+/**
+ * @brief Pause between attempts to (re)connect to AWS IoT Core.
+ */
+#ifndef fanoutCLOUD_RECONNECT_DELAY_MS
+    #define fanoutCLOUD_RECONNECT_DELAY_MS    ( 10000UL )
+#endif
+
+/**
+ * @brief Messages in the pool when democonfigSTATIC_ALLOCATION is set:
+ * enough for a full cloud queue, the one being published to the core and a
+ * telemetry report. At most 32.
+ */
+#ifndef fanoutPOOL_MESSAGES
+    #define fanoutPOOL_MESSAGES           ( fanoutCLOUD_QUEUE_LENGTH + 2 )
+#endif
+
+/**
+ * @brief Payload capacity of a pooled message; the largest xCapacity
+ * passed to Fanout_Alloc().
+ */
+#ifndef fanoutPOOL_PAYLOAD_SIZE
+    #define fanoutPOOL_PAYLOAD_SIZE       ( 768 )
+#endif
+
+/**
+ * @brief A serialized message shared by all its destinations.
+ */
+typedef struct FanoutMessage
+{
+    uint32_t ulReferences;
+    const char * pcTopic;  /**< Must be a string with static storage. */
+    uint32_t ulLength;     /**< Bytes of cPayload in use. */
+    uint32_t ulCapacity;   /**< Bytes allocated for cPayload. */
+    char cPayload[];
+} FanoutMessage_t;
+
+/**
+ * @brief Allocate a message with room for xCapacity payload bytes. The
+ * caller holds the only reference.
+ *
+ * @return NULL if out of memory; from the pool, if it is empty or
+ * xCapacity exceeds fanoutPOOL_PAYLOAD_SIZE.
+ */
+FanoutMessage_t * Fanout_Alloc( const char * pcTopic,
+                                size_t xCapacity );
+
+/**
+ * @brief Take another reference to a message.
+ */
+void Fanout_Retain( FanoutMessage_t * pxMessage );
+
+/**
+ * @brief Drop a reference; the last one frees the message or returns it
+ * to the pool.
+ */
+void Fanout_Release( FanoutMessage_t * pxMessage );
+
+/**
+ * @brief Start the task that keeps the AWS IoT Core connection.
+ *
+ * @return pdPASS if the task was created.
+ */
+BaseType_t Fanout_StartCloudLink( void );
+
+/**
+ * @brief Queue a message for AWS IoT Core without waiting.
+ *
+ * A reference is taken only if the message was queued; the caller keeps
+ * its own either way.
+ *
+ * @return pdPASS if queued; pdFAIL if the cloud link is not running or its
+ * queue is full.
+ */
+BaseType_t Fanout_SendToCloud( FanoutMessage_t * pxMessage );
+
+#endif /* _AWS_FANOUT_H_ */
@@ -0,0 +1,337 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_cache.c
+ * @brief Persistent cache of the Greengrass core selected by discovery.
+ *
+ * The entry is a single NVS blob: a fixed header followed by the NUL
+ * terminated host address and the certificate. A SHA-256 over both strings
+ * detects corruption and lets a refresh skip the flash write when discovery
+ * returned the same core. The boots left of the time to live are a u16 of
+ * their own, so that counting a boot writes two bytes rather than the blob.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* ESP-IDF includes. */
+#include "nvs.h"
+
+/* mbedTLS includes. */
+#include "mbedtls/sha256.h"
+
+#include "aws_ggd_cache.h"
+
+#define ggdcacheMAGIC          ( 0x47474443UL ) /* "GGDC" */
+#define ggdcacheVERSION        ( 3 )
+#define ggdcacheHASH_LENGTH    ( 32 )
+
+/* Upper bound on a sane entry, to reject corrupt headers before allocating. */
+#define ggdcacheMAX_BLOB_SIZE  ( 8192UL )
+
+typedef struct GGDCacheHeader
+{
+    uint32_t ulMagic;
+    uint16_t usVersion;
+    uint16_t usPort;
+    uint32_t ulHostAddressSize;    /**< Including the NUL terminator. */
+    uint32_t ulCertificateSize;    /**< As reported by discovery. */
+    uint8_t ucHash[ ggdcacheHASH_LENGTH ];
+} GGDCacheHeader_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvHashEntry( const char * pcHostAddress,
+                          uint32_t ulHostAddressSize,
+                          const char * pcCertificate,
+                          uint32_t ulCertificateSize,
+                          uint8_t * pucHash )
+{
+    mbedtls_sha256_context xContext;
+
+    mbedtls_sha256_init( &xContext );
+    ( void ) mbedtls_sha256_starts_ret( &xContext, 0 );
+    ( void ) mbedtls_sha256_update_ret( &xContext, ( const unsigned char * ) pcHostAddress, ulHostAddressSize );
+    ( void ) mbedtls_sha256_update_ret( &xContext, ( const unsigned char * ) pcCertificate, ulCertificateSize );
+    ( void ) mbedtls_sha256_finish_ret( &xContext, pucHash );
+    mbedtls_sha256_free( &xContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvGetBlobSize( nvs_handle xHandle,
+                                  size_t * pxBlobSize )
+{
+    BaseType_t xResult = pdFAIL;
+    size_t xLength = 0;
+
+    if( ( nvs_get_blob( xHandle, ggdcacheNVS_KEY, NULL, &xLength ) == ESP_OK ) &&
+        ( xLength >= sizeof( GGDCacheHeader_t ) ) &&
+        ( xLength <= ggdcacheMAX_BLOB_SIZE ) )
+    {
+        *pxBlobSize = xLength;
+        xResult = pdPASS;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+GGDCacheStatus_t GGDCache_Load( GGD_HostAddressData_t * pxHostAddressData,
+                                uint16_t * pusPort )
+{
+    GGDCacheStatus_t xStatus = eGGDCacheMiss;
+    GGDCacheHeader_t xHeader;
+    nvs_handle xHandle;
+    size_t xBlobSize = 0;
+    uint8_t * pucBlob = NULL;
+    uint8_t ucHash[ ggdcacheHASH_LENGTH ];
+    uint16_t usBootsRemaining = 0;
+    char * pcHostAddress;
+    char * pcCertificate;
+
+    memset( pxHostAddressData, 0, sizeof( GGD_HostAddressData_t ) );
+
+    if( nvs_open( ggdcacheNVS_NAMESPACE, NVS_READWRITE, &xHandle ) != ESP_OK )
+    {
+        return eGGDCacheMiss;
+    }
+
+    if( prvGetBlobSize( xHandle, &xBlobSize ) == pdPASS )
+    {
+        /* One spare byte keeps the certificate NUL terminated even if the
+         * size reported by discovery did not include the terminator. */
+        pucBlob = pvPortMalloc( xBlobSize + 1 );
+    }
+
+    if( ( pucBlob != NULL ) &&
+        ( nvs_get_blob( xHandle, ggdcacheNVS_KEY, pucBlob, &xBlobSize ) == ESP_OK ) )
+    {
+        memcpy( &xHeader, pucBlob, sizeof( xHeader ) );
+        pcHostAddress = ( char * ) ( pucBlob + sizeof( xHeader ) );
+        pcCertificate = pcHostAddress + xHeader.ulHostAddressSize;
+        pucBlob[ xBlobSize ] = '\0';
+
+        if( ( xHeader.ulMagic == ggdcacheMAGIC ) &&
+            ( xHeader.usVersion == ggdcacheVERSION ) &&
+            ( xHeader.ulHostAddressSize > 0 ) &&
+            ( xHeader.ulHostAddressSize <= xBlobSize ) &&
+            ( xHeader.ulCertificateSize <= xBlobSize ) &&
+            ( sizeof( xHeader ) + xHeader.ulHostAddressSize + xHeader.ulCertificateSize == xBlobSize ) &&
+            ( pcHostAddress[ xHeader.ulHostAddressSize - 1 ] == '\0' ) )
+        {
+            prvHashEntry( pcHostAddress, xHeader.ulHostAddressSize,
+                          pcCertificate, xHeader.ulCertificateSize, ucHash );
+
+            if( memcmp( ucHash, xHeader.ucHash, sizeof( ucHash ) ) == 0 )
+            {
+                pxHostAddressData->pcHostAddress = pcHostAddress;
+                pxHostAddressData->pcCertificate = pcCertificate;
+                pxHostAddressData->ulCertificateSize = xHeader.ulCertificateSize;
+                *pusPort = xHeader.usPort;
+
+                /* A missing counter leaves the entry stale. */
+                ( void ) nvs_get_u16( xHandle, ggdcacheNVS_TTL_KEY, &usBootsRemaining );
+
+                if( usBootsRemaining > 0 )
+                {
+                    xStatus = eGGDCacheFresh;
+
+                    /* Consume one boot of the time to live. */
+                    if( nvs_set_u16( xHandle, ggdcacheNVS_TTL_KEY, usBootsRemaining - 1 ) == ESP_OK )
+                    {
+                        ( void ) nvs_commit( xHandle );
+                    }
+                }
+                else
+                {
+                    xStatus = eGGDCacheStale;
+                }
+            }
+        }
+
+        if( xStatus == eGGDCacheMiss )
+        {
+            configPRINTF( ( "Discarding corrupt Greengrass cache entry.\r\n" ) );
+            ( void ) nvs_erase_key( xHandle, ggdcacheNVS_TTL_KEY );
+
+            if( nvs_erase_key( xHandle, ggdcacheNVS_KEY ) == ESP_OK )
+            {
+                ( void ) nvs_commit( xHandle );
+            }
+        }
+    }
+
+    nvs_close( xHandle );
+
+    if( ( xStatus == eGGDCacheMiss ) && ( pucBlob != NULL ) )
+    {
+        vPortFree( pucBlob );
+        memset( pxHostAddressData, 0, sizeof( GGD_HostAddressData_t ) );
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void GGDCache_Release( GGD_HostAddressData_t * pxHostAddressData )
+{
+    if( pxHostAddressData->pcHostAddress != NULL )
+    {
+        /* The strings live right after the header in the loaded blob. */
+        vPortFree( ( uint8_t * ) pxHostAddressData->pcHostAddress - sizeof( GGDCacheHeader_t ) );
+    }
+
+    memset( pxHostAddressData, 0, sizeof( GGD_HostAddressData_t ) );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t GGDCache_Store( const GGD_HostAddressData_t * pxHostAddressData,
+                           uint16_t usPort )
+{
+    BaseType_t xResult = pdFAIL;
+    GGDCacheHeader_t xHeader;
+    GGDCacheHeader_t xStoredHeader;
+    nvs_handle xHandle;
+    size_t xBlobSize;
+    size_t xStoredSize = sizeof( xStoredHeader );
+    uint8_t * pucBlob;
+    uint16_t usBootsRemaining = 0;
+
+    if( ( pxHostAddressData->pcHostAddress == NULL ) ||
+        ( pxHostAddressData->pcCertificate == NULL ) )
+    {
+        return pdFAIL;
+    }
+
+    memset( &xHeader, 0, sizeof( xHeader ) );
+    xHeader.ulMagic = ggdcacheMAGIC;
+    xHeader.usVersion = ggdcacheVERSION;
+    xHeader.usPort = usPort;
+    xHeader.ulHostAddressSize = ( uint32_t ) strlen( pxHostAddressData->pcHostAddress ) + 1;
+    xHeader.ulCertificateSize = pxHostAddressData->ulCertificateSize;
+    prvHashEntry( pxHostAddressData->pcHostAddress, xHeader.ulHostAddressSize,
+                  pxHostAddressData->pcCertificate, xHeader.ulCertificateSize,
+                  xHeader.ucHash );
+
+    xBlobSize = sizeof( xHeader ) + xHeader.ulHostAddressSize + xHeader.ulCertificateSize;
+
+    if( xBlobSize > ggdcacheMAX_BLOB_SIZE )
+    {
+        configPRINTF( ( "Greengrass cache entry of %u bytes is too large.\r\n", ( unsigned ) xBlobSize ) );
+        return pdFAIL;
+    }
+
+    if( nvs_open( ggdcacheNVS_NAMESPACE, NVS_READWRITE, &xHandle ) != ESP_OK )
+    {
+        return pdFAIL;
+    }
+
+    pucBlob = pvPortMalloc( xBlobSize );
+
+    if( pucBlob != NULL )
+    {
+        memcpy( pucBlob, &xHeader, sizeof( xHeader ) );
+
+        /* A partial read of an existing entry yields ESP_ERR_NVS_INVALID_LENGTH,
+         * so read the whole blob and compare its hash. */
+        if( ( nvs_get_blob( xHandle, ggdcacheNVS_KEY, NULL, &xStoredSize ) == ESP_OK ) &&
+            ( xStoredSize == xBlobSize ) &&
+            ( nvs_get_blob( xHandle, ggdcacheNVS_KEY, pucBlob, &xStoredSize ) == ESP_OK ) )
+        {
+            memcpy( &xStoredHeader, pucBlob, sizeof( xStoredHeader ) );
+
+            if( ( memcmp( xStoredHeader.ucHash, xHeader.ucHash, sizeof( xHeader.ucHash ) ) == 0 ) &&
+                ( xStoredHeader.usPort == xHeader.usPort ) )
+            {
+                /* Same core: the entry is left as it is. */
+                xResult = pdPASS;
+            }
+        }
+
+        if( xResult != pdPASS )
+        {
+            memcpy( pucBlob, &xHeader, sizeof( xHeader ) );
+            memcpy( pucBlob + sizeof( xHeader ),
+                    pxHostAddressData->pcHostAddress,
+                    xHeader.ulHostAddressSize );
+            memcpy( pucBlob + sizeof( xHeader ) + xHeader.ulHostAddressSize,
+                    pxHostAddressData->pcCertificate,
+                    xHeader.ulCertificateSize );
+
+            if( nvs_set_blob( xHandle, ggdcacheNVS_KEY, pucBlob, xBlobSize ) == ESP_OK )
+            {
+                xResult = pdPASS;
+            }
+        }
+
+        /* Reset the time to live, unless it is already full. */
+        if( ( xResult == pdPASS ) &&
+            ( ( nvs_get_u16( xHandle, ggdcacheNVS_TTL_KEY, &usBootsRemaining ) != ESP_OK ) ||
+              ( usBootsRemaining != ggdcacheTTL_BOOTS ) ) &&
+            ( nvs_set_u16( xHandle, ggdcacheNVS_TTL_KEY, ggdcacheTTL_BOOTS ) != ESP_OK ) )
+        {
+            xResult = pdFAIL;
+        }
+
+        if( ( xResult == pdPASS ) &&
+            ( nvs_commit( xHandle ) != ESP_OK ) )
+        {
+            xResult = pdFAIL;
+        }
+
+        vPortFree( pucBlob );
+    }
+
+    nvs_close( xHandle );
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void GGDCache_Invalidate( void )
+{
+    nvs_handle xHandle;
+
+    if( nvs_open( ggdcacheNVS_NAMESPACE, NVS_READWRITE, &xHandle ) == ESP_OK )
+    {
+        ( void ) nvs_erase_key( xHandle, ggdcacheNVS_TTL_KEY );
+
+        if( nvs_erase_key( xHandle, ggdcacheNVS_KEY ) == ESP_OK )
+        {
+            ( void ) nvs_commit( xHandle );
+        }
+
+        nvs_close( xHandle );
+    }
+}
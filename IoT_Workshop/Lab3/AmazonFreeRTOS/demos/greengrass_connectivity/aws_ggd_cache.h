@@ -0,0 +1,119 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_cache.h
+ * @brief Persistent cache of the Greengrass core selected by discovery.
+ *
+ * The core address and its group CA certificate are kept in NVS so that the
+ * demo can connect to the core on boot without waiting for (or depending on)
+ * the HTTPS discovery round trip.
+ */
+
+#ifndef _AWS_GGD_CACHE_H_
+#define _AWS_GGD_CACHE_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Greengrass includes. */
+#include "aws_greengrass_discovery.h"
+
+/**
+ * @brief Number of boots a cache entry may be used for before discovery must
+ * run again in the foreground.
+ *
+ * The device has no trusted wall clock before it is online, so the time to
+ * live is counted in boots. Every successful background refresh resets it.
+ */
+#ifndef ggdcacheTTL_BOOTS
+    #define ggdcacheTTL_BOOTS    ( 20 )
+#endif
+
+/**
+ * @brief NVS namespace and keys holding the cache entry and the boots left
+ * of its time to live.
+ *
+ * The boots left change on every boot, so they are kept apart from the
+ * entry, which holds the certificate and is only written when the core
+ * changes.
+ */
+#ifndef ggdcacheNVS_NAMESPACE
+    #define ggdcacheNVS_NAMESPACE    "ggd_cache"
+#endif
+#ifndef ggdcacheNVS_KEY
+    #define ggdcacheNVS_KEY          "core"
+#endif
+#ifndef ggdcacheNVS_TTL_KEY
+    #define ggdcacheNVS_TTL_KEY      "ttl"
+#endif
+
+/**
+ * @brief Result of looking up the cache.
+ */
+typedef enum
+{
+    eGGDCacheMiss = 0, /**< No usable entry (absent or corrupt). */
+    eGGDCacheFresh,    /**< Entry is valid and within its time to live. */
+    eGGDCacheStale     /**< Entry is valid but expired; only use it if discovery fails. */
+} GGDCacheStatus_t;
+
+/**
+ * @brief Load the cached core into pxHostAddressData.
+ *
+ * On a hit, pcHostAddress and pcCertificate point into a single heap block
+ * owned by the cache; release it with GGDCache_Release(). Loading a fresh
+ * entry consumes one boot of its time to live.
+ *
+ * @param[out] pxHostAddressData Receives the cached address and certificate.
+ * @param[out] pusPort Receives the cached port.
+ *
+ * @return The state of the cache entry.
+ */
+GGDCacheStatus_t GGDCache_Load( GGD_HostAddressData_t * pxHostAddressData,
+                                uint16_t * pusPort );
+
+/**
+ * @brief Free the storage allocated by GGDCache_Load().
+ */
+void GGDCache_Release( GGD_HostAddressData_t * pxHostAddressData );
+
+/**
+ * @brief Store a discovered core, resetting the time to live.
+ *
+ * The entry is only rewritten when its content hash or port changed;
+ * otherwise just the time to live is refreshed, and only if it went down.
+ *
+ * @return pdPASS if the entry was persisted; pdFAIL otherwise.
+ */
+BaseType_t GGDCache_Store( const GGD_HostAddressData_t * pxHostAddressData,
+                           uint16_t usPort );
+
+/**
+ * @brief Remove the cache entry, e.g. after the cached core refused a connection.
+ */
+void GGDCache_Invalidate( void );
+
+#endif /* _AWS_GGD_CACHE_H_ */
@@ -0,0 +1,712 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_parser.c
+ * @brief Incremental parser for the Greengrass discovery document.
+ *
+ * A small JSON tokenizer keeps a stack of the open containers and gives each
+ * one a role in the discovery schema:
+ *
+ *   { "GGGroups": [ { "Cores": [ { "Connectivity": [ { "HostAddress": ..,
+ *                                                      "PortNumber": .. } ] } ],
+ *                     "CAs": [ "<PEM>", .. ] } ] }
+ *
+ * Characters of a token are routed straight to their destination (a key
+ * buffer, the endpoint being built, or the certificate of the current group)
+ * as they arrive, so no token ever needs to be buffered whole.
+ */
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "aws_ggd_parser.h"
+
+#ifndef ggdparserMALLOC
+    #define ggdparserMALLOC    pvPortMalloc
+#endif
+#ifndef ggdparserFREE
+    #define ggdparserFREE      vPortFree
+#endif
+
+/* Tokenizer states. */
+#define ggdparserSTATE_VALUE           ( 0 )
+#define ggdparserSTATE_STRING          ( 1 )
+#define ggdparserSTATE_ESCAPE          ( 2 )
+#define ggdparserSTATE_UNICODE         ( 3 )
+#define ggdparserSTATE_PRIMITIVE       ( 4 )
+#define ggdparserSTATE_DONE            ( 5 )
+
+/* Destinations of token characters. */
+#define ggdparserSINK_NONE             ( 0 )
+#define ggdparserSINK_KEY              ( 1 )
+#define ggdparserSINK_HOST             ( 2 )
+#define ggdparserSINK_PORT             ( 3 )
+#define ggdparserSINK_CERTIFICATE      ( 4 )
+
+/* Container roles. */
+#define ggdparserROLE_OTHER            ( 0 )
+#define ggdparserROLE_ROOT             ( 1 )
+#define ggdparserROLE_GROUPS           ( 2 )
+#define ggdparserROLE_GROUP            ( 3 )
+#define ggdparserROLE_CORES            ( 4 )
+#define ggdparserROLE_CORE             ( 5 )
+#define ggdparserROLE_CONNECTIVITY     ( 6 )
+#define ggdparserROLE_ENDPOINT         ( 7 )
+#define ggdparserROLE_CAS              ( 8 )
+
+/* Keys of interest. */
+#define ggdparserKEY_OTHER             ( 0 )
+#define ggdparserKEY_GROUPS            ( 1 )
+#define ggdparserKEY_CORES             ( 2 )
+#define ggdparserKEY_CONNECTIVITY      ( 3 )
+#define ggdparserKEY_HOST_ADDRESS      ( 4 )
+#define ggdparserKEY_PORT_NUMBER       ( 5 )
+#define ggdparserKEY_CAS               ( 6 )
+
+static const char * const pcKeys[] =
+{
+    NULL,
+    "GGGroups",
+    "Cores",
+    "Connectivity",
+    "HostAddress",
+    "PortNumber",
+    "CAs"
+};
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsWhitespace( char cChar )
+{
+    return ( ( cChar == ' ' ) || ( cChar == '\t' ) || ( cChar == '\r' ) || ( cChar == '\n' ) ) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvLookupKey( const GGDParser_t * pxParser )
+{
+    uint8_t ucKey;
+
+    if( pxParser->xTokenOverflow == pdFALSE )
+    {
+        for( ucKey = 1; ucKey < ( sizeof( pcKeys ) / sizeof( pcKeys[ 0 ] ) ); ucKey++ )
+        {
+            if( strcmp( pxParser->cKey, pcKeys[ ucKey ] ) == 0 )
+            {
+                return ucKey;
+            }
+        }
+    }
+
+    return ggdparserKEY_OTHER;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAppendCertificate( GGDParser_t * pxParser,
+                                  char cChar )
+{
+    size_t xCapacity;
+    char * pcGrown;
+
+    /* Keep room for the NUL terminator. */
+    if( pxParser->xCertificateLength + 1 >= pxParser->xCertificateCapacity )
+    {
+        xCapacity = ( pxParser->xCertificateCapacity == 0 ) ?
+                    ggdparserCERTIFICATE_CHUNK_SIZE : 2 * pxParser->xCertificateCapacity;
+
+        if( xCapacity > ggdparserMAX_CERTIFICATE_SIZE )
+        {
+            xCapacity = ggdparserMAX_CERTIFICATE_SIZE;
+        }
+
+        if( pxParser->xCertificateLength + 1 >= xCapacity )
+        {
+            pxParser->xError = pdTRUE;
+            return;
+        }
+
+        pcGrown = ggdparserMALLOC( xCapacity );
+
+        if( pcGrown == NULL )
+        {
+            pxParser->xError = pdTRUE;
+            return;
+        }
+
+        if( pxParser->pcCertificate != NULL )
+        {
+            memcpy( pcGrown, pxParser->pcCertificate, pxParser->xCertificateLength );
+            ggdparserFREE( pxParser->pcCertificate );
+        }
+
+        pxParser->pcCertificate = pcGrown;
+        pxParser->xCertificateCapacity = xCapacity;
+    }
+
+    pxParser->pcCertificate[ pxParser->xCertificateLength++ ] = cChar;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAppend( GGDParser_t * pxParser,
+                       char cChar )
+{
+    char * pcBuffer = NULL;
+    size_t xSize = 0;
+
+    switch( pxParser->ucSink )
+    {
+        case ggdparserSINK_KEY:
+            pcBuffer = pxParser->cKey;
+            xSize = sizeof( pxParser->cKey );
+            break;
+
+        case ggdparserSINK_HOST:
+            pcBuffer = pxParser->cHost;
+            xSize = sizeof( pxParser->cHost );
+            break;
+
+        case ggdparserSINK_PORT:
+            pcBuffer = pxParser->cPort;
+            xSize = sizeof( pxParser->cPort );
+            break;
+
+        case ggdparserSINK_CERTIFICATE:
+            prvAppendCertificate( pxParser, cChar );
+            break;
+
+        default:
+            break;
+    }
+
+    if( pcBuffer != NULL )
+    {
+        if( pxParser->xTokenLength + 1 < xSize )
+        {
+            pcBuffer[ pxParser->xTokenLength++ ] = cChar;
+            pcBuffer[ pxParser->xTokenLength ] = '\0';
+        }
+        else
+        {
+            pxParser->xTokenOverflow = pdTRUE;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvValueSink( const GGDParser_t * pxParser,
+                             BaseType_t xIsString )
+{
+    const GGDParserFrame_t * pxTop;
+
+    if( pxParser->ucDepth == 0 )
+    {
+        return ggdparserSINK_NONE;
+    }
+
+    pxTop = &( pxParser->xFrames[ pxParser->ucDepth - 1 ] );
+
+    if( pxTop->ucRole == ggdparserROLE_ENDPOINT )
+    {
+        if( ( pxTop->ucKey == ggdparserKEY_HOST_ADDRESS ) && ( xIsString == pdTRUE ) )
+        {
+            return ggdparserSINK_HOST;
+        }
+
+        if( pxTop->ucKey == ggdparserKEY_PORT_NUMBER )
+        {
+            return ggdparserSINK_PORT;
+        }
+    }
+    else if( ( pxTop->ucRole == ggdparserROLE_CAS ) &&
+             ( xIsString == pdTRUE ) &&
+             ( pxParser->cGroup >= 0 ) )
+    {
+        return ggdparserSINK_CERTIFICATE;
+    }
+
+    return ggdparserSINK_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStartToken( GGDParser_t * pxParser,
+                           uint8_t ucSink )
+{
+    pxParser->ucSink = ucSink;
+    pxParser->xTokenLength = 0;
+    pxParser->xTokenOverflow = pdFALSE;
+
+    if( ucSink == ggdparserSINK_KEY )
+    {
+        pxParser->cKey[ 0 ] = '\0';
+    }
+    else if( ucSink == ggdparserSINK_HOST )
+    {
+        pxParser->cHost[ 0 ] = '\0';
+    }
+    else if( ucSink == ggdparserSINK_PORT )
+    {
+        pxParser->cPort[ 0 ] = '\0';
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvEndToken( GGDParser_t * pxParser )
+{
+    GGDParserFrame_t * pxTop = &( pxParser->xFrames[ pxParser->ucDepth - 1 ] );
+
+    switch( pxParser->ucSink )
+    {
+        case ggdparserSINK_KEY:
+            pxTop->ucKey = prvLookupKey( pxParser );
+            break;
+
+        case ggdparserSINK_HOST:
+            pxParser->xHaveHost = ( ( pxParser->xTokenOverflow == pdFALSE ) &&
+                                    ( pxParser->xTokenLength > 0 ) ) ? pdTRUE : pdFALSE;
+            pxParser->xHostLength = pxParser->xTokenLength;
+            break;
+
+        case ggdparserSINK_PORT:
+            pxParser->xHavePort = ( ( pxParser->xTokenOverflow == pdFALSE ) &&
+                                    ( pxParser->xTokenLength > 0 ) ) ? pdTRUE : pdFALSE;
+            break;
+
+        default:
+            /* Certificates are appended in place; consecutive CAs of a group
+             * simply form a PEM bundle. */
+            break;
+    }
+
+    pxParser->ucSink = ggdparserSINK_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAddEndpoint( GGDParser_t * pxParser )
+{
+    GGDCandidateList_t * pxList = pxParser->pxList;
+    GGDCandidate_t * pxCandidate;
+    unsigned long ulPort;
+
+    if( ( pxParser->xHaveHost == pdFALSE ) ||
+        ( pxParser->xHavePort == pdFALSE ) ||
+        ( pxParser->cGroup < 0 ) ||
+        ( pxList->xCount >= ggdprobeMAX_CANDIDATES ) )
+    {
+        return;
+    }
+
+    ulPort = strtoul( pxParser->cPort, NULL, 10 );
+
+    if( ( ulPort == 0 ) || ( ulPort > 0xFFFFUL ) )
+    {
+        return;
+    }
+
+    pxCandidate = &( pxList->xCandidates[ pxList->xCount ] );
+    memset( pxCandidate, 0, sizeof( GGDCandidate_t ) );
+    /* cHost is no longer than cHostAddress, terminator included. */
+    memcpy( pxCandidate->cHostAddress, pxParser->cHost, pxParser->xHostLength );
+    pxCandidate->cHostAddress[ pxParser->xHostLength ] = '\0';
+    pxCandidate->usPort = ( uint16_t ) ulPort;
+    pxCandidate->ucGroup = ( uint8_t ) pxParser->cGroup;
+    pxList->xCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvEndGroup( GGDParser_t * pxParser )
+{
+    GGDCandidateList_t * pxList = pxParser->pxList;
+    char * pcCertificate;
+
+    if( pxParser->pcCertificate != NULL )
+    {
+        /* Move the certificate into storage of exactly its size. */
+        pcCertificate = ggdparserMALLOC( pxParser->xCertificateLength + 1 );
+
+        if( pcCertificate != NULL )
+        {
+            memcpy( pcCertificate, pxParser->pcCertificate, pxParser->xCertificateLength );
+            pcCertificate[ pxParser->xCertificateLength ] = '\0';
+            pxList->pcCertificates[ pxParser->cGroup ] = pcCertificate;
+            pxList->ulCertificateSizes[ pxParser->cGroup ] = ( uint32_t ) pxParser->xCertificateLength + 1;
+        }
+        else
+        {
+            pxParser->xError = pdTRUE;
+        }
+
+        ggdparserFREE( pxParser->pcCertificate );
+        pxParser->pcCertificate = NULL;
+        pxParser->xCertificateLength = 0;
+        pxParser->xCertificateCapacity = 0;
+    }
+
+    pxParser->cGroup = -1;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvOpen( GGDParser_t * pxParser,
+                     char cType )
+{
+    GGDParserFrame_t * pxFrame;
+    uint8_t ucParentRole = ggdparserROLE_OTHER;
+    uint8_t ucKey = ggdparserKEY_OTHER;
+    uint8_t ucRole = ggdparserROLE_OTHER;
+
+    if( pxParser->ucDepth >= ggdparserMAX_DEPTH )
+    {
+        pxParser->xError = pdTRUE;
+        return;
+    }
+
+    if( pxParser->ucDepth > 0 )
+    {
+        ucParentRole = pxParser->xFrames[ pxParser->ucDepth - 1 ].ucRole;
+        ucKey = pxParser->xFrames[ pxParser->ucDepth - 1 ].ucKey;
+    }
+
+    if( pxParser->ucDepth == 0 )
+    {
+        ucRole = ( cType == '{' ) ? ggdparserROLE_ROOT : ggdparserROLE_OTHER;
+    }
+    else if( cType == '[' )
+    {
+        if( ( ucParentRole == ggdparserROLE_ROOT ) && ( ucKey == ggdparserKEY_GROUPS ) )
+        {
+            ucRole = ggdparserROLE_GROUPS;
+        }
+        else if( ( ucParentRole == ggdparserROLE_GROUP ) && ( ucKey == ggdparserKEY_CORES ) )
+        {
+            ucRole = ggdparserROLE_CORES;
+        }
+        else if( ( ucParentRole == ggdparserROLE_GROUP ) && ( ucKey == ggdparserKEY_CAS ) )
+        {
+            ucRole = ggdparserROLE_CAS;
+        }
+        else if( ( ucParentRole == ggdparserROLE_CORE ) && ( ucKey == ggdparserKEY_CONNECTIVITY ) )
+        {
+            ucRole = ggdparserROLE_CONNECTIVITY;
+        }
+    }
+    else
+    {
+        if( ( ucParentRole == ggdparserROLE_GROUPS ) && ( pxParser->ucGroupCount < ggdprobeMAX_GROUPS ) )
+        {
+            ucRole = ggdparserROLE_GROUP;
+            pxParser->cGroup = ( int8_t ) pxParser->ucGroupCount++;
+        }
+        else if( ucParentRole == ggdparserROLE_CORES )
+        {
+            ucRole = ggdparserROLE_CORE;
+        }
+        else if( ucParentRole == ggdparserROLE_CONNECTIVITY )
+        {
+            ucRole = ggdparserROLE_ENDPOINT;
+            pxParser->xHaveHost = pdFALSE;
+            pxParser->xHavePort = pdFALSE;
+        }
+    }
+
+    pxFrame = &( pxParser->xFrames[ pxParser->ucDepth++ ] );
+    pxFrame->ucType = ( uint8_t ) cType;
+    pxFrame->ucRole = ucRole;
+    pxFrame->ucKey = ggdparserKEY_OTHER;
+    pxParser->xExpectKey = ( cType == '{' ) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvClose( GGDParser_t * pxParser,
+                      char cType )
+{
+    GGDParserFrame_t * pxFrame;
+
+    if( pxParser->ucDepth == 0 )
+    {
+        pxParser->xError = pdTRUE;
+        return;
+    }
+
+    pxFrame = &( pxParser->xFrames[ pxParser->ucDepth - 1 ] );
+
+    if( ( ( cType == '}' ) && ( pxFrame->ucType != '{' ) ) ||
+        ( ( cType == ']' ) && ( pxFrame->ucType != '[' ) ) )
+    {
+        pxParser->xError = pdTRUE;
+        return;
+    }
+
+    if( pxFrame->ucRole == ggdparserROLE_ENDPOINT )
+    {
+        prvAddEndpoint( pxParser );
+    }
+    else if( pxFrame->ucRole == ggdparserROLE_GROUP )
+    {
+        prvEndGroup( pxParser );
+    }
+
+    pxParser->ucDepth--;
+    pxParser->xExpectKey = pdFALSE;
+
+    if( pxParser->ucDepth == 0 )
+    {
+        pxParser->ucState = ggdparserSTATE_DONE;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void GGDParser_Init( GGDParser_t * pxParser,
+                     GGDCandidateList_t * pxList )
+{
+    memset( pxParser, 0, sizeof( GGDParser_t ) );
+    memset( pxList, 0, sizeof( GGDCandidateList_t ) );
+    pxParser->pxList = pxList;
+    pxParser->ucState = ggdparserSTATE_VALUE;
+    pxParser->cGroup = -1;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t GGDParser_Feed( GGDParser_t * pxParser,
+                           const char * pcChunk,
+                           size_t xLength )
+{
+    size_t x = 0;
+    char cChar;
+
+    while( ( x < xLength ) && ( pxParser->xError == pdFALSE ) )
+    {
+        cChar = pcChunk[ x ];
+
+        switch( pxParser->ucState )
+        {
+            case ggdparserSTATE_STRING:
+
+                if( cChar == '\\' )
+                {
+                    pxParser->ucState = ggdparserSTATE_ESCAPE;
+                }
+                else if( cChar == '"' )
+                {
+                    prvEndToken( pxParser );
+                    pxParser->ucState = ggdparserSTATE_VALUE;
+                }
+                else
+                {
+                    prvAppend( pxParser, cChar );
+                }
+
+                break;
+
+            case ggdparserSTATE_ESCAPE:
+                pxParser->ucState = ggdparserSTATE_STRING;
+
+                switch( cChar )
+                {
+                    case 'n':
+                        prvAppend( pxParser, '\n' );
+                        break;
+
+                    case 'r':
+                        prvAppend( pxParser, '\r' );
+                        break;
+
+                    case 't':
+                        prvAppend( pxParser, '\t' );
+                        break;
+
+                    case 'u':
+                        /* Nothing we extract uses non-ASCII characters. */
+                        pxParser->ucEscapeDigits = 4;
+                        pxParser->ucState = ggdparserSTATE_UNICODE;
+                        break;
+
+                    default:
+                        /* \/, \\ and \" stand for themselves. */
+                        prvAppend( pxParser, cChar );
+                        break;
+                }
+
+                break;
+
+            case ggdparserSTATE_UNICODE:
+
+                if( --pxParser->ucEscapeDigits == 0 )
+                {
+                    prvAppend( pxParser, '?' );
+                    pxParser->ucState = ggdparserSTATE_STRING;
+                }
+
+                break;
+
+            case ggdparserSTATE_PRIMITIVE:
+
+                if( ( cChar == ',' ) || ( cChar == '}' ) || ( cChar == ']' ) ||
+                    ( prvIsWhitespace( cChar ) == pdTRUE ) )
+                {
+                    prvEndToken( pxParser );
+                    pxParser->ucState = ggdparserSTATE_VALUE;
+
+                    /* The delimiter is handled as structure below. */
+                    continue;
+                }
+
+                prvAppend( pxParser, cChar );
+                break;
+
+            case ggdparserSTATE_DONE:
+
+                if( prvIsWhitespace( cChar ) == pdFALSE )
+                {
+                    pxParser->xError = pdTRUE;
+                }
+
+                break;
+
+            default:
+
+                if( prvIsWhitespace( cChar ) == pdTRUE )
+                {
+                    /* Skip. */
+                }
+                else if( ( cChar == '{' ) || ( cChar == '[' ) )
+                {
+                    prvOpen( pxParser, cChar );
+                }
+                else if( ( cChar == '}' ) || ( cChar == ']' ) )
+                {
+                    prvClose( pxParser, cChar );
+                }
+                else if( pxParser->ucDepth == 0 )
+                {
+                    /* Only a container may be the document root. */
+                    pxParser->xError = pdTRUE;
+                }
+                else if( cChar == ',' )
+                {
+                    pxParser->xExpectKey =
+                        ( pxParser->xFrames[ pxParser->ucDepth - 1 ].ucType == '{' ) ? pdTRUE : pdFALSE;
+                }
+                else if( cChar == ':' )
+                {
+                    pxParser->xExpectKey = pdFALSE;
+                }
+                else if( cChar == '"' )
+                {
+                    prvStartToken( pxParser,
+                                   ( pxParser->xExpectKey == pdTRUE ) ?
+                                   ggdparserSINK_KEY : prvValueSink( pxParser, pdTRUE ) );
+                    pxParser->ucState = ggdparserSTATE_STRING;
+                }
+                else
+                {
+                    prvStartToken( pxParser, prvValueSink( pxParser, pdFALSE ) );
+                    prvAppend( pxParser, cChar );
+                    pxParser->ucState = ggdparserSTATE_PRIMITIVE;
+                }
+
+                break;
+        }
+
+        x++;
+    }
+
+    return ( pxParser->xError == pdFALSE ) ? pdPASS : pdFAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t GGDParser_Finish( GGDParser_t * pxParser )
+{
+    GGDCandidateList_t * pxList = pxParser->pxList;
+    size_t xRead, xWrite = 0;
+
+    if( pxParser->pcCertificate != NULL )
+    {
+        /* Truncated inside a group. */
+        ggdparserFREE( pxParser->pcCertificate );
+        pxParser->pcCertificate = NULL;
+    }
+
+    if( ( pxParser->xError == pdTRUE ) || ( pxParser->ucState != ggdparserSTATE_DONE ) )
+    {
+        GGDParser_FreeList( pxList );
+        pxList->xCount = 0;
+
+        return pdFAIL;
+    }
+
+    /* Drop endpoints of groups that came without a CA; they cannot be
+     * authenticated. */
+    for( xRead = 0; xRead < pxList->xCount; xRead++ )
+    {
+        if( pxList->pcCertificates[ pxList->xCandidates[ xRead ].ucGroup ] != NULL )
+        {
+            pxList->xCandidates[ xWrite++ ] = pxList->xCandidates[ xRead ];
+        }
+    }
+
+    pxList->xCount = xWrite;
+    pxList->xNext = 0;
+
+    /* Until probed, rank in document order. */
+    for( xRead = 0; xRead < pxList->xCount; xRead++ )
+    {
+        pxList->ucRanked[ xRead ] = ( uint8_t ) xRead;
+    }
+
+    return ( pxList->xCount > 0 ) ? pdPASS : pdFAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+void GGDParser_FreeList( GGDCandidateList_t * pxList )
+{
+    size_t x;
+
+    for( x = 0; x < ggdprobeMAX_GROUPS; x++ )
+    {
+        if( pxList->pcCertificates[ x ] != NULL )
+        {
+            ggdparserFREE( pxList->pcCertificates[ x ] );
+            pxList->pcCertificates[ x ] = NULL;
+            pxList->ulCertificateSizes[ x ] = 0;
+        }
+    }
+}
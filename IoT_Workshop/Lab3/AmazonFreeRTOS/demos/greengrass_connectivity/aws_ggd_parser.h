@@ -0,0 +1,148 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_parser.h
+ * @brief Incremental parser for the Greengrass discovery document.
+ *
+ * The document is consumed in chunks of any size as it arrives from the
+ * network. Only the endpoints of each core and the CA certificates of each
+ * group are kept, so memory use depends on what is extracted rather than on
+ * the size of the document. The parser itself has no dependency on sockets
+ * and can be fed from a file or a test buffer.
+ */
+
+#ifndef _AWS_GGD_PARSER_H_
+#define _AWS_GGD_PARSER_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "aws_ggd_probe.h"
+
+/**
+ * @brief Deepest JSON nesting followed. The discovery document needs 7.
+ */
+#ifndef ggdparserMAX_DEPTH
+    #define ggdparserMAX_DEPTH               ( 12 )
+#endif
+
+/**
+ * @brief Upper bound on the CA certificates kept for one group.
+ */
+#ifndef ggdparserMAX_CERTIFICATE_SIZE
+    #define ggdparserMAX_CERTIFICATE_SIZE    ( 16384UL )
+#endif
+
+/**
+ * @brief Initial capacity of a certificate being collected; doubled on demand.
+ */
+#ifndef ggdparserCERTIFICATE_CHUNK_SIZE
+    #define ggdparserCERTIFICATE_CHUNK_SIZE  ( 1024UL )
+#endif
+
+/**
+ * @brief Longest object key that is compared; longer keys are skipped.
+ */
+#define ggdparserMAX_KEY_LENGTH              ( 16 )
+
+/**
+ * @brief One open object or array.
+ */
+typedef struct GGDParserFrame
+{
+    uint8_t ucType;  /**< '{' or '['. */
+    uint8_t ucRole;  /**< What this container is in the discovery schema. */
+    uint8_t ucKey;   /**< For objects, the key whose value comes next. */
+} GGDParserFrame_t;
+
+/**
+ * @brief Working state of one parse. Kept by the caller, typically on the
+ * stack of the task doing discovery, and discarded afterwards.
+ */
+typedef struct GGDParser
+{
+    GGDCandidateList_t * pxList;
+    GGDParserFrame_t xFrames[ ggdparserMAX_DEPTH ];
+    uint8_t ucDepth;
+    uint8_t ucState;
+    uint8_t ucSink;            /**< Where the characters of the current token go. */
+    uint8_t ucEscapeDigits;    /**< Remaining hex digits of a \\u escape. */
+    BaseType_t xExpectKey;     /**< Inside an object, the next string is a key. */
+    BaseType_t xError;
+    int8_t cGroup;             /**< Index of the group being parsed, or -1. */
+    uint8_t ucGroupCount;
+
+    /* Token collection. */
+    char cKey[ ggdparserMAX_KEY_LENGTH + 1 ];
+    char cHost[ ggdprobeMAX_HOST_ADDRESS_LENGTH ];
+    size_t xHostLength;        /**< Of cHost, once xHaveHost is set. */
+    char cPort[ 8 ];
+    size_t xTokenLength;
+    BaseType_t xTokenOverflow;
+    BaseType_t xHaveHost;
+    BaseType_t xHavePort;
+
+    /* Certificate being collected for the current group. */
+    char * pcCertificate;
+    size_t xCertificateLength;
+    size_t xCertificateCapacity;
+} GGDParser_t;
+
+/**
+ * @brief Start a parse that fills pxList.
+ *
+ * Any certificates already owned by pxList must have been released with
+ * GGDParser_FreeList() first.
+ */
+void GGDParser_Init( GGDParser_t * pxParser,
+                     GGDCandidateList_t * pxList );
+
+/**
+ * @brief Consume the next chunk of the document.
+ *
+ * @return pdPASS to continue; pdFAIL once the document is malformed or a
+ * limit was exceeded. Further input is then ignored.
+ */
+BaseType_t GGDParser_Feed( GGDParser_t * pxParser,
+                           const char * pcChunk,
+                           size_t xLength );
+
+/**
+ * @brief Complete the parse and shrink the extracted certificates to size.
+ *
+ * Endpoints of groups without a CA are dropped. On failure every allocation
+ * made by the parse is released.
+ *
+ * @return pdPASS if the document was complete and yielded a candidate.
+ */
+BaseType_t GGDParser_Finish( GGDParser_t * pxParser );
+
+/**
+ * @brief Release the certificates owned by a list filled by the parser.
+ */
+void GGDParser_FreeList( GGDCandidateList_t * pxList );
+
+#endif /* _AWS_GGD_PARSER_H_ */
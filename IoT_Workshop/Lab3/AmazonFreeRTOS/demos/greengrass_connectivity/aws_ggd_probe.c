@@ -0,0 +1,369 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_probe.c
+ * @brief Latency based selection among the cores of a discovery document.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Secure sockets includes. */
+#include "aws_secure_sockets.h"
+
+#include "aws_ggd_probe.h"
+#include "aws_tls_metrics.h"
+
+#include "driver/stack_budget.h"
+
+/**
+ * @brief Everything the probe tasks of one round need.
+ *
+ * The job holds its own copies of the endpoints and certificates so that a
+ * probe still running after the round timed out never touches the caller's
+ * list. The last probe task to finish frees it.
+ */
+typedef struct GGDProbeJob
+{
+    uint32_t ulRound;
+    uint32_t ulNextIndex;       /**< Next candidate to probe; taken atomically. */
+    uint32_t ulReferences;      /**< Probe tasks still running. */
+    size_t xCount;
+    GGDCandidate_t xCandidates[ ggdprobeMAX_CANDIDATES ];
+    char * pcCertificates[ ggdprobeMAX_GROUPS ];
+    uint32_t ulCertificateSizes[ ggdprobeMAX_GROUPS ];
+} GGDProbeJob_t;
+
+typedef struct GGDProbeResult
+{
+    uint32_t ulRound;
+    uint8_t ucIndex;
+    BaseType_t xHealthy;
+    TickType_t xProbeTicks;
+} GGDProbeResult_t;
+
+/* Results outlive a round so that late probes always have somewhere to post;
+ * the round number lets the collector ignore them. */
+static QueueHandle_t xResultQueue = NULL;
+static uint32_t ulProbeRound = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvReleaseJob( GGDProbeJob_t * pxJob )
+{
+    size_t x;
+
+    if( __atomic_sub_fetch( &( pxJob->ulReferences ), 1, __ATOMIC_ACQ_REL ) == 0 )
+    {
+        for( x = 0; x < ggdprobeMAX_GROUPS; x++ )
+        {
+            if( pxJob->pcCertificates[ x ] != NULL )
+            {
+                vPortFree( pxJob->pcCertificates[ x ] );
+            }
+        }
+
+        vPortFree( pxJob );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvProbeEndpoint( const GGDCandidate_t * pxCandidate,
+                                    const char * pcCertificate,
+                                    uint32_t ulCertificateSize,
+                                    TickType_t * pxProbeTicks )
+{
+    BaseType_t xHealthy = pdFALSE;
+    Socket_t xSocket;
+    SocketsSockaddr_t xServerAddress = { 0 };
+    TickType_t xTimeout = pdMS_TO_TICKS( ggdprobeROUND_TIMEOUT_MS );
+    TickType_t xStart;
+
+    xServerAddress.ulAddress = SOCKETS_GetHostByName( pxCandidate->cHostAddress );
+
+    if( xServerAddress.ulAddress == 0 )
+    {
+        return pdFALSE;
+    }
+
+    xServerAddress.usPort = SOCKETS_htons( pxCandidate->usPort );
+    xServerAddress.ucSocketDomain = SOCKETS_AF_INET;
+
+    xSocket = SOCKETS_Socket( SOCKETS_AF_INET, SOCKETS_SOCK_STREAM, SOCKETS_IPPROTO_TCP );
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        return pdFALSE;
+    }
+
+    if( ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_REQUIRE_TLS, NULL, 0 ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE,
+                              pcCertificate, ulCertificateSize ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) ) == SOCKETS_ERROR_NONE ) )
+    {
+        /* The secure sockets connect completes the TLS handshake, so this
+         * measures TCP connect plus handshake, which is what a reconnect costs. */
+        xStart = xTaskGetTickCount();
+
+        if( SOCKETS_Connect( xSocket, &xServerAddress, sizeof( xServerAddress ) ) == SOCKETS_ERROR_NONE )
+        {
+            *pxProbeTicks = xTaskGetTickCount() - xStart;
+            xHealthy = pdTRUE;
+            ( void ) SOCKETS_Shutdown( xSocket, SOCKETS_SHUT_RDWR );
+        }
+    }
+
+    ( void ) SOCKETS_Close( xSocket );
+
+    return xHealthy;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvProbeTask( void * pvParameters )
+{
+    GGDProbeJob_t * pxJob = ( GGDProbeJob_t * ) pvParameters;
+    GGDProbeResult_t xResult;
+    const GGDCandidate_t * pxCandidate;
+    uint32_t ulIndex;
+
+    StackBudget_Register( NULL, "ggdprobeTASK_STACK_SIZE", ggdprobeTASK_STACK_SIZE );
+
+    /* Each task keeps taking the next unprobed candidate until none remain. */
+    while( ( ulIndex = __atomic_fetch_add( &( pxJob->ulNextIndex ), 1, __ATOMIC_ACQ_REL ) ) < pxJob->xCount )
+    {
+        pxCandidate = &( pxJob->xCandidates[ ulIndex ] );
+
+        xResult.ulRound = pxJob->ulRound;
+        xResult.ucIndex = ( uint8_t ) ulIndex;
+        xResult.xProbeTicks = 0;
+        xResult.xHealthy = prvProbeEndpoint( pxCandidate,
+                                             pxJob->pcCertificates[ pxCandidate->ucGroup ],
+                                             pxJob->ulCertificateSizes[ pxCandidate->ucGroup ],
+                                             &( xResult.xProbeTicks ) );
+
+        ( void ) xQueueSend( xResultQueue, &xResult, 0 );
+    }
+
+    prvReleaseJob( pxJob );
+    StackBudget_TaskExit();
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static GGDProbeJob_t * prvCreateJob( const GGDCandidateList_t * pxList )
+{
+    GGDProbeJob_t * pxJob;
+    size_t x;
+
+    pxJob = pvPortMalloc( sizeof( GGDProbeJob_t ) );
+
+    if( pxJob == NULL )
+    {
+        return NULL;
+    }
+
+    memset( pxJob, 0, sizeof( GGDProbeJob_t ) );
+    pxJob->ulRound = ++ulProbeRound;
+    pxJob->xCount = pxList->xCount;
+    memcpy( pxJob->xCandidates, pxList->xCandidates, sizeof( pxJob->xCandidates ) );
+
+    for( x = 0; x < ggdprobeMAX_GROUPS; x++ )
+    {
+        if( pxList->pcCertificates[ x ] != NULL )
+        {
+            pxJob->pcCertificates[ x ] = pvPortMalloc( pxList->ulCertificateSizes[ x ] );
+
+            if( pxJob->pcCertificates[ x ] == NULL )
+            {
+                pxJob->ulReferences = 1;
+                prvReleaseJob( pxJob );
+                return NULL;
+            }
+
+            memcpy( pxJob->pcCertificates[ x ], pxList->pcCertificates[ x ], pxList->ulCertificateSizes[ x ] );
+            pxJob->ulCertificateSizes[ x ] = pxList->ulCertificateSizes[ x ];
+        }
+    }
+
+    return pxJob;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t GGDProbe_Rank( GGDCandidateList_t * pxList )
+{
+    GGDProbeJob_t * pxJob;
+    GGDProbeResult_t xResult;
+    size_t x, xProbes, xReceived = 0, xHealthy = 0, xRank = 0;
+    TickType_t xDeadline = xTaskGetTickCount() + pdMS_TO_TICKS( ggdprobeROUND_TIMEOUT_MS );
+    TickType_t xNow;
+    uint8_t ucIndex;
+    const GGDCandidate_t * pxCandidate;
+
+    pxList->xNext = 0;
+
+    for( x = 0; x < pxList->xCount; x++ )
+    {
+        pxList->xCandidates[ x ].xHealthy = pdFALSE;
+        pxList->xCandidates[ x ].xProbeTicks = portMAX_DELAY;
+    }
+
+    if( xResultQueue == NULL )
+    {
+        xResultQueue = xQueueCreate( 2 * ggdprobeMAX_CANDIDATES, sizeof( GGDProbeResult_t ) );
+    }
+
+    pxJob = ( xResultQueue != NULL ) ? prvCreateJob( pxList ) : NULL;
+
+    if( pxJob != NULL )
+    {
+        xProbes = ( pxList->xCount < ggdprobePARALLEL_PROBES ) ? pxList->xCount : ggdprobePARALLEL_PROBES;
+
+        /* Hold a reference while starting tasks so none can free the job early. */
+        pxJob->ulReferences = 1;
+
+        for( x = 0; x < xProbes; x++ )
+        {
+            __atomic_add_fetch( &( pxJob->ulReferences ), 1, __ATOMIC_ACQ_REL );
+
+            if( xTaskCreate( prvProbeTask, "GgdProbe", ggdprobeTASK_STACK_SIZE,
+                             pxJob, ggdprobeTASK_PRIORITY, NULL ) != pdPASS )
+            {
+                prvReleaseJob( pxJob );
+            }
+        }
+
+        prvReleaseJob( pxJob );
+
+        while( xReceived < pxList->xCount )
+        {
+            xNow = xTaskGetTickCount();
+
+            if( ( TickType_t ) ( xDeadline - xNow ) > pdMS_TO_TICKS( ggdprobeROUND_TIMEOUT_MS ) )
+            {
+                /* Deadline passed; stragglers stay unhealthy. */
+                break;
+            }
+
+            if( xQueueReceive( xResultQueue, &xResult, xDeadline - xNow ) != pdTRUE )
+            {
+                break;
+            }
+
+            if( ( xResult.ulRound == ulProbeRound ) && ( xResult.ucIndex < pxList->xCount ) )
+            {
+                xReceived++;
+                pxList->xCandidates[ xResult.ucIndex ].xHealthy = xResult.xHealthy;
+                TLSMetrics_Record( pxList->xCandidates[ xResult.ucIndex ].cHostAddress,
+                                   pxList->xCandidates[ xResult.ucIndex ].usPort,
+                                   xResult.xHealthy,
+                                   xResult.xProbeTicks );
+
+                if( xResult.xHealthy == pdTRUE )
+                {
+                    pxList->xCandidates[ xResult.ucIndex ].xProbeTicks = xResult.xProbeTicks;
+                    xHealthy++;
+                }
+            }
+        }
+    }
+
+    /* Insertion sort: healthy first by probe time, the rest in document order.
+     * Unhealthy candidates all carry portMAX_DELAY, and the sort is stable. */
+    for( x = 0; x < pxList->xCount; x++ )
+    {
+        ucIndex = ( uint8_t ) x;
+
+        for( xRank = x; xRank > 0; xRank-- )
+        {
+            if( pxList->xCandidates[ pxList->ucRanked[ xRank - 1 ] ].xProbeTicks <=
+                pxList->xCandidates[ ucIndex ].xProbeTicks )
+            {
+                break;
+            }
+
+            pxList->ucRanked[ xRank ] = pxList->ucRanked[ xRank - 1 ];
+        }
+
+        pxList->ucRanked[ xRank ] = ucIndex;
+    }
+
+    for( x = 0; x < pxList->xCount; x++ )
+    {
+        pxCandidate = &( pxList->xCandidates[ pxList->ucRanked[ x ] ] );
+
+        if( pxCandidate->xHealthy == pdTRUE )
+        {
+            configPRINTF( ( "Greengrass candidate %u: %s:%u, %u ms.\r\n",
+                            ( unsigned ) x,
+                            pxCandidate->cHostAddress,
+                            pxCandidate->usPort,
+                            ( unsigned ) ( pxCandidate->xProbeTicks * portTICK_PERIOD_MS ) ) );
+        }
+        else
+        {
+            configPRINTF( ( "Greengrass candidate %u: %s:%u, unreachable.\r\n",
+                            ( unsigned ) x,
+                            pxCandidate->cHostAddress,
+                            pxCandidate->usPort ) );
+        }
+    }
+
+    return xHealthy;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t GGDProbe_Next( GGDCandidateList_t * pxList,
+                          GGD_HostAddressData_t * pxHostAddressData,
+                          uint16_t * pusPort )
+{
+    GGDCandidate_t * pxCandidate;
+
+    if( pxList->xNext >= pxList->xCount )
+    {
+        return pdFAIL;
+    }
+
+    pxCandidate = &( pxList->xCandidates[ pxList->ucRanked[ pxList->xNext ] ] );
+    pxList->xNext++;
+
+    pxHostAddressData->pcHostAddress = pxCandidate->cHostAddress;
+    pxHostAddressData->pcCertificate = pxList->pcCertificates[ pxCandidate->ucGroup ];
+    pxHostAddressData->ulCertificateSize = pxList->ulCertificateSizes[ pxCandidate->ucGroup ];
+    *pusPort = pxCandidate->usPort;
+
+    return pdPASS;
+}
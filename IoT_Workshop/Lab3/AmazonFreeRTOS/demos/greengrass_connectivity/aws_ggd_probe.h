@@ -0,0 +1,150 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ggd_probe.h
+ * @brief Latency based selection among the cores of a discovery document.
+ *
+ * Every connectivity entry of every core is a candidate. The candidates are
+ * probed concurrently with a TCP connect plus TLS handshake, ranked by how
+ * long that took, and then handed out best first so that a lost connection
+ * can fail over to the next endpoint without probing again.
+ */
+
+#ifndef _AWS_GGD_PROBE_H_
+#define _AWS_GGD_PROBE_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Greengrass includes. */
+#include "aws_greengrass_discovery.h"
+
+/* Demo includes. */
+#include "aws_demo_config.h"
+
+/**
+ * @brief Most endpoints kept from one discovery document.
+ */
+#ifndef ggdprobeMAX_CANDIDATES
+    #define ggdprobeMAX_CANDIDATES         ( 8 )
+#endif
+
+/**
+ * @brief Most groups (and so group CA certificates) kept from one document.
+ */
+#ifndef ggdprobeMAX_GROUPS
+    #define ggdprobeMAX_GROUPS             ( 2 )
+#endif
+
+/**
+ * @brief Longest host address kept, including the NUL terminator.
+ */
+#ifndef ggdprobeMAX_HOST_ADDRESS_LENGTH
+    #define ggdprobeMAX_HOST_ADDRESS_LENGTH    ( 64 )
+#endif
+
+/**
+ * @brief Number of probe tasks run at once.
+ *
+ * Each in-flight probe holds a TLS context, so this bounds the transient
+ * heap cost of probing rather than the number of candidates.
+ */
+#ifndef ggdprobePARALLEL_PROBES
+    #define ggdprobePARALLEL_PROBES        ( 2 )
+#endif
+
+/**
+ * @brief Stack size of a probe task. The TLS handshake runs on this stack.
+ */
+#ifndef ggdprobeTASK_STACK_SIZE
+    #define ggdprobeTASK_STACK_SIZE        ( 6144 )
+#endif
+
+#ifndef ggdprobeTASK_PRIORITY
+    #define ggdprobeTASK_PRIORITY          ( tskIDLE_PRIORITY + 4 )
+#endif
+
+/**
+ * @brief Time allowed for all probes of one round to finish.
+ */
+#ifndef ggdprobeROUND_TIMEOUT_MS
+    #define ggdprobeROUND_TIMEOUT_MS       ( 10000UL )
+#endif
+
+/**
+ * @brief One core endpoint taken from the discovery document.
+ */
+typedef struct GGDCandidate
+{
+    char cHostAddress[ ggdprobeMAX_HOST_ADDRESS_LENGTH ];
+    uint16_t usPort;
+    uint8_t ucGroup;          /**< Index of the group whose CA signs this core. */
+    BaseType_t xHealthy;      /**< pdTRUE if the last probe completed the handshake. */
+    TickType_t xProbeTicks;   /**< Duration of the last successful probe. */
+} GGDCandidate_t;
+
+/**
+ * @brief All endpoints of one discovery document, ranked after probing.
+ *
+ * The list is filled by the discovery parser (aws_ggd_parser.h), which
+ * allocates the certificates; they are owned by the list and released with
+ * GGDParser_FreeList().
+ */
+typedef struct GGDCandidateList
+{
+    GGDCandidate_t xCandidates[ ggdprobeMAX_CANDIDATES ];
+    uint8_t ucRanked[ ggdprobeMAX_CANDIDATES ]; /**< Candidate indices, best first. */
+    size_t xCount;                              /**< Number of valid candidates. */
+    size_t xNext;                               /**< Failover cursor into ucRanked. */
+    char * pcCertificates[ ggdprobeMAX_GROUPS ];
+    uint32_t ulCertificateSizes[ ggdprobeMAX_GROUPS ];
+} GGDCandidateList_t;
+
+/**
+ * @brief Probe all candidates concurrently and rank them.
+ *
+ * Healthy candidates are ranked by probe time, fastest first, followed by
+ * the unhealthy ones in document order as a last resort. Resets the
+ * failover cursor.
+ *
+ * @return The number of healthy candidates.
+ */
+size_t GGDProbe_Rank( GGDCandidateList_t * pxList );
+
+/**
+ * @brief Hand out the next ranked candidate.
+ *
+ * @param[out] pxHostAddressData Address and certificate of the candidate.
+ * Points into the list; no copies are made.
+ * @param[out] pusPort Port of the candidate.
+ *
+ * @return pdPASS if a candidate was returned; pdFAIL once the list is exhausted.
+ */
+BaseType_t GGDProbe_Next( GGDCandidateList_t * pxList,
+                          GGD_HostAddressData_t * pxHostAddressData,
+                          uint16_t * pusPort );
+
+#endif /* _AWS_GGD_PROBE_H_ */
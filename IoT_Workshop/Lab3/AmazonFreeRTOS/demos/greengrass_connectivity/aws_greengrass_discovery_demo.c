@@ -34,6 +34,7 @@
 
 /* Standard includes. */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* FreeRTOS includes. */
@@ -46,6 +47,16 @@
 #include "aws_ggd_config.h"
 #include "aws_ggd_config_defaults.h"
 #include "aws_greengrass_discovery.h"
+#include "aws_ggd_cache.h"
+#include "aws_ggd_probe.h"
+#include "aws_ggd_parser.h"
+#include "aws_tls_metrics.h"
+#include "aws_fanout.h"
+#include "aws_telemetry.h"
+
+/* Secure sockets includes. */
+#include "aws_secure_sockets.h"
+#include "aws_clientcredential.h"
 
 /* MQTT includes. */
 #include "aws_mqtt_agent.h"
@@ -58,17 +69,89 @@
 
 #include "driver/gpio.h"
 #include "driver/DHT22.h"
+#include "driver/dlog.h"
+#include "driver/boot_profile.h"
+#include "driver/spsc_ring.h"
+#include "driver/alloc_watch.h"
+#include "driver/stack_budget.h"
+
+/* Scheduler trace spans; a no-op unless enabled in FreeRTOSConfig.h. */
+#include "driver/sched_trace.h"
+
+/* Commands on the subscription topic. */
+#include "driver/cmd_dispatch.h"
+
+/* Handlers of the topics subscribed to. */
+#include "driver/topic_router.h"
 
-#include "freertos/queue.h"
+/* Local rules that drive the LED. */
+#include "driver/rule_engine.h"
 
-/* JSON utilities include. */
-#include "iot_json_utils.h"
+/* Sampling period that follows the readings. */
+#include "driver/adaptive_period.h"
+
+/* Running statistics and anomalies of the readings. */
+#include "driver/stream_stats.h"
+
+/* TLS sessions resumed on reconnect. */
+#include "driver/tls_session_cache.h"
 
 #define ggdDEMO_MAX_MQTT_MESSAGES      3
 #define ggdDEMO_MAX_MQTT_MSG_SIZE      500
-#define ggdDEMO_DISCOVERY_FILE_SIZE    2500
+#define ggdDEMO_DISCOVERY_CHUNK_SIZE   256
+#define ggdDEMO_DISCOVERY_TIMEOUT_MS   ( 10000UL )
+#define ggdDEMO_DISCOVERY_REQUEST                        \
+    "GET /greengrass/discover/thing/"                    \
+    clientcredentialIOT_THING_NAME                       \
+    " HTTP/1.1\r\n"                                      \
+    "Host: " clientcredentialMQTT_BROKER_ENDPOINT "\r\n" \
+    "Connection: close\r\n\r\n"
+#define ggdDEMO_REFRESH_TASK_PRIORITY  ( tskIDLE_PRIORITY + 1 )
+#define ggdDEMO_MAX_PUBLISH_FAILURES   3
+#define ggdDEMO_REDISCOVERY_DELAY_MS   ( 5000UL )
+#define ggdDEMO_SENSOR_WARMUP_MS       ( 2000UL )
+#define ggdDEMO_SAMPLING_CORE          ( 1 )
+#define ggdDEMO_NETWORK_CORE           ( 0 )
+#ifndef ggdDEMO_SAMPLING_STACK_SIZE
+    #define ggdDEMO_SAMPLING_STACK_SIZE    ( 3072 )
+#endif
+#define ggdDEMO_SAMPLING_PRIORITY      ( tskIDLE_PRIORITY + 6 )
+#define ggdDEMO_RING_LENGTH            16
+#define ggdDEMO_RING_BATCH             4
+#define ggdDEMO_NOTIFY_READ            ( 1UL << 0 )
+#define ggdDEMO_NOTIFY_EDGE            ( 1UL << 1 )
+#define ggdDEMO_NOTIFY_RULES           ( 1UL << 2 )
+#define ggdDEMO_NOTIFY_START           ( 1UL << 3 )
+#define ggdDEMO_ALLOC_CHECK_PUBLISHES  20
+#define ggdDEMO_STACK_BUDGET_PUBLISHES 20
 #define ggdDEMO_MQTT_MSG_TOPIC         "freertos/demos/ggd"
 #define ggdDEMO_MQTT_SUB_TOPIC         "freertos/demos/led"
+#define ggdDEMO_MQTT_ACK_TOPIC         "freertos/demos/ack"
+#define ggdDEMO_MQTT_CMD_PREFIX        "freertos/demos/cmd/"
+#ifndef ggdDEMO_GROUP
+    #define ggdDEMO_GROUP              "default"
+#endif
+#define ggdDEMO_SAMPLE_PERIOD_MS       ( 3000UL )
+#define ggdDEMO_MIN_SAMPLE_PERIOD_MS   ( 2000 )
+#define ggdDEMO_MAX_SAMPLE_PERIOD_MS   ( 3600000 )
+#define ggdDEMO_MAX_DEADBAND_TENTHS    ( 1000 )
+#define ggdDEMO_ACK_BUFFER_LENGTH      256
+#ifndef ggdDEMO_RULES
+    #define ggdDEMO_RULES              "vibration -> led = on"
+#endif
+#define ggdDEMO_VIBRATION_WINDOW_MS    ( 1000UL )
+#ifndef ggdDEMO_ADAPTIVE
+    #define ggdDEMO_ADAPTIVE           ( 1 )
+#endif
+#define ggdDEMO_ADAPTIVE_MAX_PERIOD_MS ( 30000 )
+#define ggdDEMO_ADAPTIVE_STEP_TEMP     ( 3 )  /* Tenths of a degree. */
+#define ggdDEMO_ADAPTIVE_STEP_HUMIDITY ( 10 ) /* Tenths of a percent. */
+#ifndef ggdDEMO_STATS
+    #define ggdDEMO_STATS              ( 1 )
+#endif
+#define ggdDEMO_STATS_WINDOW           ( 20 )   /* Readings. */
+#define ggdDEMO_STATS_Z_THRESHOLD      ( 4.0f )
+#define ggdDEMO_STATS_MIN_DEVIATION    ( 2 )    /* Tenths. */
 #define ggdDEMO_MQTT_MSG_TEMPERATURE                               \
                                        "{"                         \
                                        "\"Humidity\":%.1f,"        \
@@ -79,29 +162,188 @@
                                        "{"                         \
                                        "\"Detect\":%s"             \
                                        "}"
-#define SUBSCRIBE_TOKEN_KEY            "led"
-#define SUBSCRIBE_TOKEN_KEY_LENGTH     ( sizeof( SUBSCRIBE_TOKEN_KEY ) - 1 )
 
-static xQueueHandle xDemoQueue = NULL;
+#define ggdDEMO_MQTT_MSG_PERIOD                                    \
+                                       "{"                         \
+                                       "\"SamplePeriodMs\":%lu"    \
+                                       "}"
+
+#define ggdDEMO_MQTT_MSG_SUMMARY                                   \
+                                       "{"                         \
+                                       "\"Window\":\"%s\","         \
+                                       "\"Count\":%lu,"            \
+                                       "\"Mean\":%.2f,"            \
+                                       "\"Variance\":%.3f,"        \
+                                       "\"Min\":%.1f,"             \
+                                       "\"Max\":%.1f"              \
+                                       "}"
+
+#define ggdDEMO_MQTT_MSG_ANOMALY                                   \
+                                       "{"                         \
+                                       "\"Anomaly\":\"%s\","        \
+                                       "\"Value\":%.1f,"           \
+                                       "\"Z\":%.1f"                \
+                                       "}"
+
+#if ( democonfigSTATIC_ALLOCATION == 1 )
+    #if !defined( IOT_STATIC_MEMORY_ONLY ) || ( IOT_STATIC_MEMORY_ONLY == 0 )
+        #error "democonfigSTATIC_ALLOCATION needs IOT_STATIC_MEMORY_ONLY set to 1 in iot_config.h."
+    #endif
+    #if ( configSUPPORT_STATIC_ALLOCATION == 0 )
+        #error "democonfigSTATIC_ALLOCATION needs CONFIG_SUPPORT_STATIC_ALLOCATION in menuconfig."
+    #endif
+#endif
 
 static const char pcGgdTimerName[] = "GgdDemoTimer";
 TimerHandle_t xGgdRequestTimer = NULL;
 BaseType_t xGgdTimerStarted = pdFALSE;
 
+/* Takes the first reading once the sensor has warmed up, while discovery
+ * and the connection are still in progress. */
+static TimerHandle_t xGgdWarmupTimer = NULL;
+
 typedef enum
 {
     eEventTypeNone,
     eEventTypeGpio,
     eEventTypeTemp,
+    eEventTypePeriod,
+    eEventTypeSummary,
+    eEventTypeAnomaly,
 } DemoEventType_t;
 
+/* Channels of the running statistics, in the order of the rule inputs. */
+typedef enum
+{
+    eStatsChannelTemp = 0,
+    eStatsChannelHumidity,
+    eStatsChannelCount
+} DemoStatsChannel_t;
+
+static const char * const pcStatsChannels[ eStatsChannelCount ] = { "Temperature", "Humidity" };
+
 typedef struct DemoTaskMessage
 {
     DemoEventType_t type;
     float humidity;
     float temperature;
+    uint32_t ulPeriodMs;            /* The new sampling period, for eEventTypePeriod. */
+    uint32_t ulChannel;             /* A DemoStatsChannel_t, for eEventTypeSummary and eEventTypeAnomaly. */
+    StreamStatsSummary_t xSummary;  /* The window closed, in tenths, for eEventTypeSummary. */
+    float fZScore;                  /* How far the reading is out, for eEventTypeAnomaly. */
 } DemoTaskMessage_t;
 
+/* Readings cross from the sampling core to the network core through this
+ * ring. prvSamplingTask() is its only producer and the demo task its only
+ * consumer. */
+static SpscRing_t xDemoRing;
+static DemoTaskMessage_t xDemoRingItems[ ggdDEMO_RING_LENGTH ];
+
+/* Readings taken from the ring but not yet published. They are kept across
+ * connections, so that a lost link does not lose them. */
+static DemoTaskMessage_t xDemoBatch[ ggdDEMO_RING_BATCH ];
+static size_t xDemoBatchCount = 0;
+static size_t xDemoBatchNext = 0;
+
+/* The producer notifies the consumer after each push; so does the MQTT
+ * agent when the link drops. */
+static TaskHandle_t xConsumerTask = NULL;
+static uint32_t ulLinkDown = 0;
+
+/* The timers and the GPIO interrupt only wake the sampling task. */
+static TaskHandle_t xSamplingTask = NULL;
+static uint32_t ulPendingEdges = 0;
+
+/* Inputs of the local rules, in tenths, and the outputs they drive. */
+typedef enum
+{
+    eRuleInputTemp = 0,
+    eRuleInputHumidity,
+    eRuleInputVibration, /* 1 while edges come less than ggdDEMO_VIBRATION_WINDOW_MS apart. */
+    eRuleInputCount
+} DemoRuleInput_t;
+
+static const char * const pcRuleInputs[ eRuleInputCount ] = { "temp", "humidity", "vibration" };
+static const char * const pcRuleOutputs[] = { "led" };
+
+/* Rules compiled by the MQTT agent task, waiting for the sampling task,
+ * which evaluates them, to take them. One update waits at a time. */
+static RuleProgram_t xPendingRules;
+static uint32_t ulRulesPending = 0;
+static uint32_t ulRuleCount = 0;
+
+/* Settings that commands on the subscription topic change at run time.
+ * The MQTT agent task writes them, and the local rules write ulLedOn; the
+ * sampling and demo tasks read them, a word at a time. */
+typedef struct DemoSettings
+{
+    uint32_t ulLedOn;          /* GPIO13 drives the LED, active low. */
+    uint32_t ulPeriodMs;       /* Period of xGgdRequestTimer. */
+    uint32_t ulBatch;          /* Readings gathered in the ring before publishing. */
+    uint32_t ulDeadbandTenths; /* Smallest change of a reading that is published. */
+    uint32_t ulQoS;            /* QoS of the publishes to the core. */
+    uint32_t ulAdaptive;       /* The sampling task adapts ulPeriodMs to the readings. */
+} DemoSettings_t;
+
+static DemoSettings_t xDemoSettings =
+{
+    .ulLedOn          = 0,
+    .ulPeriodMs       = ggdDEMO_SAMPLE_PERIOD_MS,
+    .ulBatch          = 1,
+    .ulDeadbandTenths = 0,
+    .ulQoS            = eMQTTQoS0,
+    .ulAdaptive       = ggdDEMO_ADAPTIVE
+};
+
+/* The ack of the last command, written by the MQTT callback and sent by
+ * the publish loop. The length is 0 while no ack waits. */
+static char cAckPayload[ ggdDEMO_ACK_BUFFER_LENGTH ];
+static uint32_t ulAckLength = 0;
+
+/* Handlers of the topics subscribed to, filled in once at start. */
+static TopicRouter_t xTopicRouter;
+
+/* Set while background discovery runs. It talks TLS to the cloud, so the
+ * heap is only watched once it is over. */
+static uint32_t ulRefreshRunning = 0;
+
+/* Storage of the demo tasks and timers, so that the demo does not use the
+ * heap once started. */
+#if ( democonfigSTATIC_ALLOCATION == 1 )
+    static StaticTimer_t xGgdRequestTimerBuffer;
+    static StaticTimer_t xGgdWarmupTimerBuffer;
+    static StaticTask_t xSamplingTaskBuffer;
+    static StackType_t xSamplingTaskStack[ ggdDEMO_SAMPLING_STACK_SIZE ];
+    static StaticTask_t xDemoTaskBuffer;
+    static StackType_t xDemoTaskStack[ democonfigDEMO_STACKSIZE ];
+    static StaticTask_t xRefreshTaskBuffer;
+    static StackType_t xRefreshTaskStack[ democonfigDEMO_STACKSIZE ];
+    static GGDCandidateList_t xRefreshList;
+#endif
+
+/**
+ * @brief Destinations of each event class.
+ *
+ * The local core gets everything for low latency control; IoT Core keeps
+ * the readings as a durable archive, with the changes of period that tell
+ * how far apart they are, the window summaries and the anomalies. Event
+ * classes not listed go to the core only.
+ */
+typedef struct DemoRoute
+{
+    DemoEventType_t type;
+    uint32_t ulDestinations;
+} DemoRoute_t;
+
+static const DemoRoute_t xDemoRoutes[] =
+{
+    { eEventTypeTemp,    fanoutROUTE_GGC | fanoutROUTE_CLOUD },
+    { eEventTypeGpio,    fanoutROUTE_GGC                     },
+    { eEventTypePeriod,  fanoutROUTE_GGC | fanoutROUTE_CLOUD },
+    { eEventTypeSummary, fanoutROUTE_GGC | fanoutROUTE_CLOUD },
+    { eEventTypeAnomaly, fanoutROUTE_GGC | fanoutROUTE_CLOUD },
+};
+
 /**
  * @brief Contains the user data for callback processing.
  */
@@ -119,273 +361,1573 @@ typedef struct
 /* The maximum time to wait for an MQTT operation to complete.  Needs to be
  * long enough for the TLS negotiation to complete. */
 static const TickType_t xMaxCommandTime = pdMS_TO_TICKS( 20000UL );
-static const TickType_t xTimeBetweenPublish = pdMS_TO_TICKS( 1500UL );
-static char pcJSONFile[ ggdDEMO_DISCOVERY_FILE_SIZE ];
+static GGDCandidateList_t xCandidateList;
 
 /*
  * The MQTT client used for all the publish and subscribes.
  */
 static MQTTAgentHandle_t xMQTTClientHandle;
-static BaseType_t prvMQTTConnect( GGD_HostAddressData_t * pxHostAddressData );
-static void prvSendMessageToGGC( GGD_HostAddressData_t * pxHostAddressData );
+static BaseType_t prvMQTTConnect( GGD_HostAddressData_t * pxHostAddressData,
+                                  uint16_t usPort );
+static BaseType_t prvSendMessageToGGC( GGD_HostAddressData_t * pxHostAddressData,
+                                       uint16_t usPort );
+static BaseType_t prvFetchCandidates( GGDCandidateList_t * pxList );
+static void prvRefreshDiscoveryTask( void * pvParameters );
 static void prvDiscoverGreenGrassCore( void * pvParameters );
+static void prvSamplingTask( void * pvParameters );
+static void prvWatchSteadyState( void );
 
 
 static void IRAM_ATTR gpio_isr_handler(void* arg)
 {
-    DemoTaskMessage_t xMessage;
-    gpio_set_level(GPIO_NUM_13, 0);
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    SchedTrace_IsrEnter( GPIO_NUM_14 );
+
+    /* The ring has a single producer, the sampling task. Edges are counted
+     * so that it still queues one message per edge. */
+    ( void ) __atomic_add_fetch( &ulPendingEdges, 1, __ATOMIC_RELAXED );
+
+    if( xSamplingTask != NULL )
+    {
+        ( void ) xTaskNotifyFromISR( xSamplingTask,
+                                     ggdDEMO_NOTIFY_EDGE,
+                                     eSetBits,
+                                     &xHigherPriorityTaskWoken );
+    }
 
-    xMessage.type = eEventTypeGpio;
-    xQueueSendFromISR(xDemoQueue, &xMessage, pdFALSE );
+    SchedTrace_IsrExit( GPIO_NUM_14 );
+
+    if( xHigherPriorityTaskWoken == pdTRUE )
+    {
+        portYIELD_FROM_ISR();
+    }
 }
 
 static void prvRequestTimer_Callback( TimerHandle_t xTimer )
 {
-    int ret;
-    DemoTaskMessage_t xMessage;
+    ( void ) xTimer;
 
-    ret = readDHT();
-	errorHandler(ret);
+    /* The timer task runs on the network core; the reading is taken on
+     * the sampling core. */
+    if( xSamplingTask != NULL )
+    {
+        ( void ) xTaskNotify( xSamplingTask, ggdDEMO_NOTIFY_READ, eSetBits );
+    }
+}
 
-    xMessage.type = eEventTypeTemp;
-    xMessage.humidity = getHumidity();
-    xMessage.temperature = getTemperature();
+/*-----------------------------------------------------------*/
 
-    printf( "Hum %.1f\n", xMessage.humidity );
-    printf( "Tmp %.1f\n", xMessage.temperature );
+static void prvPushMessage( const DemoTaskMessage_t * pxMessage )
+{
+    TaskHandle_t xConsumer;
 
-    xQueueSend(xDemoQueue, &xMessage, ( TickType_t ) 0 );
-}
+    if( SpscRing_Push( &xDemoRing, pxMessage ) == false )
+    {
+        Telemetry_Count( eTelemetryDropped );
+    }
+    else
+    {
+        /* Before the demo task first looks at the ring there is no one
+         * to wake. */
+        xConsumer = __atomic_load_n( &xConsumerTask, __ATOMIC_ACQUIRE );
 
-static MQTTBool_t prvMQTTCallback( void * pvUserData,
-                                   const MQTTPublishData_t * const pxPublishParameters )
-{
-    bool keyFound = false;
-    const char * pJsonValue = NULL;
-    size_t jsonValueLength = 0;
-
-    /* Print information about the incoming PUBLISH message. */
-    configPRINTF(( "Incoming PUBLISH received:\r\n"
-                "Publish payload: %.*s\r\n",
-                pxPublishParameters->ulDataLength,
-                pxPublishParameters->pvData ));
-
-    /* Find the given section in the updated document. */
-    keyFound = IotJsonUtils_FindJsonValue( pxPublishParameters->pvData,
-                                               pxPublishParameters->ulDataLength,
-                                               SUBSCRIBE_TOKEN_KEY,
-                                               SUBSCRIBE_TOKEN_KEY_LENGTH,
-                                               &pJsonValue,
-                                               &jsonValueLength );
-
-    if( keyFound == true )
-    {
-        configPRINTF(( "Turn Led %.*s\r\n",
-                    jsonValueLength,
-                    pJsonValue ));
-        if ( strncmp( pJsonValue, "\"on\"", 4 ) == 0 )
+        if( xConsumer != NULL )
         {
-            gpio_set_level(GPIO_NUM_13, 0);
-        }
-        else
-        {
-            gpio_set_level(GPIO_NUM_13, 1);
+            xTaskNotifyGive( xConsumer );
         }
     }
-    else
+}
+
+/*-----------------------------------------------------------*/
+
+/* A reading in tenths, the resolution of the DHT22. */
+static int32_t prvToTenths( float fValue )
+{
+    return ( int32_t ) ( ( fValue * 10.0f ) + ( ( fValue < 0.0f ) ? -0.5f : 0.5f ) );
+}
+
+/**
+ * @brief Whether a reading has moved far enough from the last one queued
+ * to be published. Called by the sampling task only.
+ */
+static BaseType_t prvOutsideDeadband( const DemoTaskMessage_t * pxMessage )
+{
+    static BaseType_t xQueued = pdFALSE;
+    static int32_t lLastHumidity = 0, lLastTemperature = 0;
+    int32_t lHumidity = prvToTenths( pxMessage->humidity );
+    int32_t lTemperature = prvToTenths( pxMessage->temperature );
+    int32_t lDeadband = ( int32_t ) __atomic_load_n( &( xDemoSettings.ulDeadbandTenths ), __ATOMIC_RELAXED );
+
+    if( ( xQueued == pdTRUE ) &&
+        ( abs( lHumidity - lLastHumidity ) < lDeadband ) &&
+        ( abs( lTemperature - lLastTemperature ) < lDeadband ) )
     {
-        configPRINTF(( "Failed to find key %s in Json document.",
-                      "led" ));
+        return pdFALSE;
     }
 
-    return eMQTTFalse;
+    xQueued = pdTRUE;
+    lLastHumidity = lHumidity;
+    lLastTemperature = lTemperature;
+
+    return pdTRUE;
 }
 
 /*-----------------------------------------------------------*/
 
-static void prvSendMessageToGGC( GGD_HostAddressData_t * pxHostAddressData )
+/**
+ * @brief Switch the LED, for a command or a local rule.
+ */
+static void prvSetLed( uint32_t ulLedOn )
 {
-    const char * pcTopic = ggdDEMO_MQTT_MSG_TOPIC;
-    MQTTAgentSubscribeParams_t xSubscribeParams;
-    MQTTAgentPublishParams_t xPublishParams;
-    MQTTAgentReturnCode_t xReturnCode;
-    uint32_t ulMessageCounter;
-    char cBuffer[ ggdDEMO_MAX_MQTT_MSG_SIZE ];
+    __atomic_store_n( &( xDemoSettings.ulLedOn ), ulLedOn, __ATOMIC_RELAXED );
+    gpio_set_level( GPIO_NUM_13, ( ulLedOn == 1 ) ? 0 : 1 );
+}
 
-    DemoTaskMessage_t xMessage;
+/*-----------------------------------------------------------*/
+
+static void prvRuleAction( void * pvContext,
+                           size_t uxOutput,
+                           int32_t lLevel )
+{
+    ( void ) pvContext;
+    ( void ) uxOutput;
+
+    /* The LED is the only output. */
+    prvSetLed( ( uint32_t ) lLevel );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Evaluate the local rules on the latest inputs, taking new rules
+ * first. Called by the sampling task only, which owns the rules in force.
+ */
+static void prvEvaluateRules( const int32_t * plInputs )
+{
+    static RuleProgram_t xRules;
+    static RuleState_t xState;
 
-    if( prvMQTTConnect( pxHostAddressData ) == pdPASS )
+    if( __atomic_load_n( &ulRulesPending, __ATOMIC_ACQUIRE ) != 0 )
     {
-        /* Setup subscribe parameters to subscribe to echo topic. */
-        xSubscribeParams.pucTopic = ( const uint8_t * )ggdDEMO_MQTT_SUB_TOPIC;
-        xSubscribeParams.pxPublishCallback = prvMQTTCallback;
-        xSubscribeParams.usTopicLength = ( uint16_t ) strlen( ( const char * ) ggdDEMO_MQTT_SUB_TOPIC );
-        xSubscribeParams.xQoS = eMQTTQoS1;
+        xRules = xPendingRules;
+        Rules_Reset( &xState );
+        __atomic_store_n( &ulRulesPending, 0, __ATOMIC_RELEASE );
+    }
+
+    Rules_Evaluate( &xRules,
+                    &xState,
+                    plInputs,
+                    ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ),
+                    prvRuleAction,
+                    NULL );
+}
+
+/**
+ * @brief Adapt the sampling period to a good reading, and publish the new
+ * period when it changes. Called by the sampling task only.
+ *
+ * Nothing is done before the demo starts xGgdRequestTimer, since changing
+ * the period of a timer starts it.
+ *
+ * @param[in] plValues The temperature and humidity in tenths, in that
+ * order, as the rule inputs hold them.
+ */
+static void prvAdaptPeriod( const int32_t * plValues )
+{
+    static AdaptivePeriod_t xController;
+    static BaseType_t xInitialized = pdFALSE;
+    static const AdaptivePeriodConfig_t xConfig =
+    {
+        .ulMinMs    = ggdDEMO_MIN_SAMPLE_PERIOD_MS,
+        .ulMaxMs    = ggdDEMO_ADAPTIVE_MAX_PERIOD_MS,
+        .uxChannels = 2,
+        .lStep      = { ggdDEMO_ADAPTIVE_STEP_TEMP, ggdDEMO_ADAPTIVE_STEP_HUMIDITY }
+    };
+    uint32_t ulPeriodMs = __atomic_load_n( &( xDemoSettings.ulPeriodMs ), __ATOMIC_RELAXED );
+    uint32_t ulNextMs;
+    DemoTaskMessage_t xMessage;
 
-        /* Subscribe to the topic. */
-        xReturnCode = MQTT_AGENT_Subscribe( xMQTTClientHandle,
-                                          &xSubscribeParams,
-                                          xMaxCommandTime );
-        if( xReturnCode != eMQTTAgentSuccess )
+    if( xInitialized == pdFALSE )
+    {
+        if( AdaptivePeriod_Init( &xController, &xConfig ) == false )
         {
-            configPRINTF(( "%s: Could not subscribe to topic.\r\n", __FUNCTION__ ));
+            configPRINTF( ( "ERROR: the adaptive sampling period is not configured correctly.\r\n" ) );
+            __atomic_store_n( &( xDemoSettings.ulAdaptive ), 0, __ATOMIC_RELAXED );
+
             return;
         }
 
-        /* Publish to the topic to which this task is subscribed in order
-         * to receive back the data that was published. */
-        xPublishParams.xQoS = eMQTTQoS0;
-        xPublishParams.pucTopic = ( const uint8_t * ) pcTopic;
-        xPublishParams.usTopicLength = ( uint16_t ) ( strlen( pcTopic ) );
+        xInitialized = pdTRUE;
+    }
 
-        if( xGgdRequestTimer != NULL )
+    if( ( __atomic_load_n( &( xDemoSettings.ulAdaptive ), __ATOMIC_RELAXED ) == 0 ) ||
+        ( xTimerIsTimerActive( xGgdRequestTimer ) == pdFALSE ) )
+    {
+        return;
+    }
+
+    ulNextMs = AdaptivePeriod_Next( &xController, ulPeriodMs, plValues );
+
+    if( ( ulNextMs == ulPeriodMs ) ||
+        ( xTimerChangePeriod( xGgdRequestTimer, pdMS_TO_TICKS( ulNextMs ), 0 ) != pdPASS ) )
+    {
+        return;
+    }
+
+    __atomic_store_n( &( xDemoSettings.ulPeriodMs ), ulNextMs, __ATOMIC_RELAXED );
+
+    ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+    xMessage.type = eEventTypePeriod;
+    xMessage.ulPeriodMs = ulNextMs;
+    prvPushMessage( &xMessage );
+}
+
+#if ( ggdDEMO_STATS == 1 )
+
+/**
+ * @brief Add a good reading to the running statistics, and queue the
+ * anomalies it raises and the summaries of the windows it closes. Called by
+ * the sampling task only.
+ *
+ * @param[in] pxReading The reading.
+ * @param[in] plValues Its temperature and humidity in tenths, in that
+ * order, as the rule inputs hold them.
+ */
+static void prvUpdateStats( const DemoTaskMessage_t * pxReading,
+                            const int32_t * plValues )
+{
+    static StreamStats_t xStats;
+    static BaseType_t xInitialized = pdFALSE, xUsable = pdFALSE;
+    static const StreamStatsConfig_t xConfig =
+    {
+        .uxChannels    = eStatsChannelCount,
+        .ulWindow      = ggdDEMO_STATS_WINDOW,
+        .fZThreshold   = ggdDEMO_STATS_Z_THRESHOLD,
+        .lMinDeviation = { ggdDEMO_STATS_MIN_DEVIATION, ggdDEMO_STATS_MIN_DEVIATION }
+    };
+    float fZScores[ eStatsChannelCount ];
+    uint32_t ulAnomalies = 0, ulChannel;
+    bool xClosed;
+    DemoTaskMessage_t xMessage;
+
+    if( xInitialized == pdFALSE )
+    {
+        xInitialized = pdTRUE;
+        xUsable = ( StreamStats_Init( &xStats, &xConfig ) == true ) ? pdTRUE : pdFALSE;
+
+        if( xUsable == pdFALSE )
         {
-            xGgdTimerStarted = xTimerStart( xGgdRequestTimer, 0 );
+            configPRINTF( ( "ERROR: the running statistics are not configured correctly.\r\n" ) );
         }
+    }
 
-        if( xGgdTimerStarted == pdTRUE )
+    if( xUsable == pdFALSE )
+    {
+        return;
+    }
+
+    xClosed = StreamStats_Add( &xStats, plValues, fZScores, &ulAnomalies );
+
+    for( ulChannel = 0; ulChannel < eStatsChannelCount; ulChannel++ )
+    {
+        if( ( ulAnomalies & ( 1UL << ulChannel ) ) != 0 )
         {
-            configPRINTF(( "Starting %s timer.\r\n", pcGgdTimerName ));
+            ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+            xMessage.type = eEventTypeAnomaly;
+            xMessage.ulChannel = ulChannel;
+            xMessage.humidity = pxReading->humidity;
+            xMessage.temperature = pxReading->temperature;
+            xMessage.fZScore = fZScores[ ulChannel ];
+            prvPushMessage( &xMessage );
         }
-        else
+
+        if( xClosed == true )
         {
-            configPRINTF(( "ERROR: failed to start %s timer.\r\n", pcGgdTimerName ));
+            ( void ) memset( &xMessage, 0x00, sizeof( xMessage ) );
+            xMessage.type = eEventTypeSummary;
+            xMessage.ulChannel = ulChannel;
+            StreamStats_Tumbling( &xStats, ulChannel, &( xMessage.xSummary ) );
+            prvPushMessage( &xMessage );
         }
+    }
+}
 
-        for( ulMessageCounter = 0;; ulMessageCounter++ )
-        {
-            if(pdTRUE == xQueueReceive(xDemoQueue, &xMessage, portMAX_DELAY))
-            {
-                /* Generate the payload for the PUBLISH. */
-                if (xMessage.type == eEventTypeGpio)
-                {
-                    xPublishParams.ulDataLength = sprintf( cBuffer,
-                                    ggdDEMO_MQTT_MSG_VIBRATE,
-                                    "\"Vibrating\"" );
-                }
-                else if(xMessage.type == eEventTypeTemp)
-                {
-                    xPublishParams.ulDataLength = sprintf( cBuffer,
-                                    ggdDEMO_MQTT_MSG_TEMPERATURE,
-                                    xMessage.humidity, xMessage.temperature );
-                }
-                else
-                {
-                    /* Generate the payload for the PUBLISH. */
-                    xPublishParams.ulDataLength = sprintf( cBuffer,
-                                    "%s",
-                                    "Failed to get event type." );
-                }
-                xPublishParams.pvData = cBuffer;
-                xReturnCode = MQTT_AGENT_Publish( xMQTTClientHandle,
-                                                &xPublishParams,
-                                                xMaxCommandTime );
+#endif
 
-                if( xReturnCode != eMQTTAgentSuccess )
-                {
-                    configPRINTF( ( "mqtt_client - Failure to publish \n" ) );
-                }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take readings when the timers or the GPIO interrupt ask for them.
+ *
+ * Pinned to ggdDEMO_SAMPLING_CORE, so that WiFi and TLS work on the other
+ * core does not disturb the DHT22 bit timing.
+ */
+static void prvSamplingTask( void * pvParameters )
+{
+    int ret;
+    uint32_t ulNotified = 0, ulEdges = 0;
+    DemoTaskMessage_t xMessage;
+    int32_t lRuleInputs[ eRuleInputCount ] = { 0 };
+    TickType_t xLastEdge = 0;
+    BaseType_t xSampled = pdFALSE;
+
+    ( void ) pvParameters;
 
-                vTaskDelay( xTimeBetweenPublish );
+    /* The rules in force at start; a command may replace them. They drive
+     * the LED from here instead of from the GPIO interrupt. */
+    if( Rules_Compile( pcRuleInputs, eRuleInputCount,
+                       pcRuleOutputs, sizeof( pcRuleOutputs ) / sizeof( pcRuleOutputs[ 0 ] ),
+                       ggdDEMO_RULES, sizeof( ggdDEMO_RULES ) - 1,
+                       &xPendingRules, NULL ) == true )
+    {
+        __atomic_store_n( &ulRuleCount, xPendingRules.ucRules, __ATOMIC_RELAXED );
+        __atomic_store_n( &ulRulesPending, 1, __ATOMIC_RELEASE );
+    }
+    else
+    {
+        configPRINTF( ( "ERROR: ggdDEMO_RULES could not be compiled.\r\n" ) );
+    }
+
+    /* xTaskCreateStaticPinnedToCore() returns the handle only once this
+     * task may already be running on the other core. The interrupt uses the
+     * handle, so wait until the creator has stored it. */
+    do
+    {
+        ( void ) xTaskNotifyWait( 0, ggdDEMO_NOTIFY_START, &ulNotified, portMAX_DELAY );
+    } while( ( ulNotified & ggdDEMO_NOTIFY_START ) == 0 );
+
+    /* The GPIO interrupt is allocated on the core that installs it. */
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(GPIO_NUM_14, gpio_isr_handler, (void*) GPIO_NUM_14);
+
+    for( ; ; )
+    {
+        ( void ) xTaskNotifyWait( 0, UINT32_MAX, &ulNotified, portMAX_DELAY );
+
+        if( ( ulNotified & ggdDEMO_NOTIFY_EDGE ) != 0 )
+        {
+            xLastEdge = xTaskGetTickCount();
+            lRuleInputs[ eRuleInputVibration ] = 1;
+            xMessage.type = eEventTypeGpio;
+
+            for( ulEdges = __atomic_exchange_n( &ulPendingEdges, 0, __ATOMIC_RELAXED ); ulEdges > 0; ulEdges-- )
+            {
+                prvPushMessage( &xMessage );
             }
         }
 
-        configPRINTF( ( "Disconnecting from broker.\r\n" ) );
-
-        if( MQTT_AGENT_Disconnect( xMQTTClientHandle,
-                                   xMaxCommandTime ) == eMQTTAgentSuccess )
+        if( ( ulNotified & ggdDEMO_NOTIFY_READ ) != 0 )
         {
-            configPRINTF( ( "Disconnected from the broker.\r\n" ) );
+            SchedTrace_SpanBegin( "readDHT" );
+            ret = readDHT();
+            SchedTrace_SpanEnd( "readDHT" );
+            BootProfile_Mark( "first_sample" );
+            errorHandler(ret);
+
+            xMessage.type = eEventTypeTemp;
+            xMessage.humidity = getHumidity();
+            xMessage.temperature = getTemperature();
 
-            if( MQTT_AGENT_Delete( xMQTTClientHandle ) == eMQTTAgentSuccess )
+            dlogPRINTF( ( "Hum %.1f\n", xMessage.humidity ) );
+            dlogPRINTF( ( "Tmp %.1f\n", xMessage.temperature ) );
+
+            /* A failed reading leaves the rules on the last good one. */
+            if( ret == DHT_OK )
             {
-                configPRINTF( ( "Deleted Client.\r\n" ) );
+                lRuleInputs[ eRuleInputTemp ] = prvToTenths( xMessage.temperature );
+                lRuleInputs[ eRuleInputHumidity ] = prvToTenths( xMessage.humidity );
             }
-            else
+
+            xSampled = pdTRUE;
+
+            /* Readings within the deadband are not sent. */
+            if( prvOutsideDeadband( &xMessage ) == pdTRUE )
+            {
+                prvPushMessage( &xMessage );
+            }
+
+            /* The next period, and the statistics, follow from the good
+             * readings only. */
+            if( ret == DHT_OK )
             {
-                configPRINTF( ( "ERROR:  MQTT_AGENT_Delete() Failed.\r\n" ) );
+                prvAdaptPeriod( lRuleInputs );
+
+                #if ( ggdDEMO_STATS == 1 )
+                    prvUpdateStats( &xMessage, lRuleInputs );
+                #endif
             }
         }
-        else
+
+        /* Vibration ends once no edge has come for a window; that is seen
+         * at the next edge or reading. */
+        if( ( xTaskGetTickCount() - xLastEdge ) >= pdMS_TO_TICKS( ggdDEMO_VIBRATION_WINDOW_MS ) )
         {
-            configPRINTF( ( "ERROR:  Did not disconnected from the broker.\r\n" ) );
+            lRuleInputs[ eRuleInputVibration ] = 0;
+        }
+
+        /* The rules wait for the first reading, so that a rule on the
+         * temperature does not act on a reading of 0. */
+        if( xSampled == pdTRUE )
+        {
+            prvEvaluateRules( lRuleInputs );
         }
     }
 }
 
-/*-----------------------------------------------------------*/
-
-static BaseType_t prvMQTTConnect( GGD_HostAddressData_t * pxHostAddressData )
+static bool prvApplyLed( const CmdValue_t * pxValue )
 {
-    MQTTAgentConnectParams_t xConnectParams;
-    BaseType_t xResult = pdPASS;
-
-    /* Connect to the broker. */
-    xConnectParams.pucClientId = ( const uint8_t * ) ( clientcredentialIOT_THING_NAME );
-    xConnectParams.usClientIdLength = ( uint16_t ) ( strlen( clientcredentialIOT_THING_NAME ) );
-    xConnectParams.pcURL = pxHostAddressData->pcHostAddress;
-    xConnectParams.usPort = clientcredentialMQTT_BROKER_PORT;
-    xConnectParams.xFlags = mqttagentREQUIRE_TLS | mqttagentURL_IS_IP_ADDRESS;
-    xConnectParams.xURLIsIPAddress = pdTRUE; /* Deprecated. */
-    xConnectParams.pcCertificate = pxHostAddressData->pcCertificate;
-    xConnectParams.ulCertificateSize = pxHostAddressData->ulCertificateSize;
-    xConnectParams.pvUserData = NULL;
-    xConnectParams.pxCallback = NULL;
-    xConnectParams.xSecuredConnection = pdTRUE; /* Deprecated. */
+    uint32_t ulLedOn = 0;
 
-    if( MQTT_AGENT_Connect( xMQTTClientHandle,
-                            &xConnectParams,
-                            xMaxCommandTime ) != eMQTTAgentSuccess )
+    if( CmdDispatch_IsString( pxValue, "on" ) == true )
     {
-        configPRINTF( ( "ERROR: Could not connect to the Broker.\r\n" ) );
-        xResult = pdFAIL;
+        ulLedOn = 1;
+    }
+    else if( CmdDispatch_IsString( pxValue, "off" ) == false )
+    {
+        return false;
     }
 
-    return xResult;
+    prvSetLed( ulLedOn );
+
+    return true;
 }
 
-/*-----------------------------------------------------------*/
+static int prvReportLed( char * pcBuffer,
+                         size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "\"%s\"",
+                     ( __atomic_load_n( &( xDemoSettings.ulLedOn ), __ATOMIC_RELAXED ) == 1 ) ? "on" : "off" );
+}
 
-static void prvDiscoverGreenGrassCore( void * pvParameters )
+static bool prvApplyPeriod( const CmdValue_t * pxValue )
 {
-    GGD_HostAddressData_t xHostAddressData;
+    int32_t lPeriodMs = 0;
 
-    ( void ) pvParameters;
+    /* The DHT22 cannot be read more often than every 2 seconds. */
+    if( ( CmdDispatch_ToFixed( pxValue, 1, &lPeriodMs ) == false ) ||
+        ( lPeriodMs < ggdDEMO_MIN_SAMPLE_PERIOD_MS ) ||
+        ( lPeriodMs > ggdDEMO_MAX_SAMPLE_PERIOD_MS ) )
+    {
+        return false;
+    }
 
-    /* Create MQTT Client. */
-    if( MQTT_AGENT_Create( &( xMQTTClientHandle ) ) == eMQTTAgentSuccess )
+    /* A timer that is not running yet is started by the change, as the
+     * publish loop would do anyway. */
+    if( ( xGgdRequestTimer != NULL ) &&
+        ( xTimerChangePeriod( xGgdRequestTimer, pdMS_TO_TICKS( lPeriodMs ), 0 ) != pdPASS ) )
     {
-        memset( &xHostAddressData, 0, sizeof( xHostAddressData ) );
+        return false;
+    }
 
-        /* Demonstrate automated connection. */
-        configPRINTF( ( "Attempting automated selection of Greengrass device\r\n" ) );
+    __atomic_store_n( &( xDemoSettings.ulPeriodMs ), ( uint32_t ) lPeriodMs, __ATOMIC_RELAXED );
 
-        if( GGD_GetGGCIPandCertificate( pcJSONFile,
-                                        ggdDEMO_DISCOVERY_FILE_SIZE,
-                                        &xHostAddressData )
-            == pdPASS )
-        {
-            configPRINTF( ( "Greengrass device discovered.\r\n" ) );
-            configPRINTF( ( "Establishing MQTT communication to Greengrass...\r\n" ) );
-            prvSendMessageToGGC( &xHostAddressData );
+    return true;
+}
 
-            /* Report on space efficiency of this demo task. */
-            #if ( INCLUDE_uxTaskGetStackHighWaterMark == 1 )
-                {
-                    configPRINTF( ( "Heap low watermark: %u. Stack high watermark: %u.\r\n",
-                                    xPortGetMinimumEverFreeHeapSize(),
-                                    uxTaskGetStackHighWaterMark( NULL ) ) );
-                }
-            #endif
-        }
-        else
-        {
-            configPRINTF( ( "Auto-connect: Failed to retrieve Greengrass address and certificate.\r\n" ) );
-        }
+static int prvReportPeriod( char * pcBuffer,
+                            size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( xDemoSettings.ulPeriodMs ), __ATOMIC_RELAXED ) );
+}
+
+static bool prvApplyBatch( const CmdValue_t * pxValue )
+{
+    int32_t lBatch = 0;
+
+    if( ( CmdDispatch_ToFixed( pxValue, 1, &lBatch ) == false ) ||
+        ( lBatch < 1 ) ||
+        ( lBatch > ggdDEMO_RING_BATCH ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( xDemoSettings.ulBatch ), ( uint32_t ) lBatch, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int prvReportBatch( char * pcBuffer,
+                           size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( xDemoSettings.ulBatch ), __ATOMIC_RELAXED ) );
+}
+
+static bool prvApplyDeadband( const CmdValue_t * pxValue )
+{
+    int32_t lDeadbandTenths = 0;
+
+    if( ( CmdDispatch_ToFixed( pxValue, 10, &lDeadbandTenths ) == false ) ||
+        ( lDeadbandTenths < 0 ) ||
+        ( lDeadbandTenths > ggdDEMO_MAX_DEADBAND_TENTHS ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( xDemoSettings.ulDeadbandTenths ), ( uint32_t ) lDeadbandTenths, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int prvReportDeadband( char * pcBuffer,
+                              size_t xLength )
+{
+    uint32_t ulDeadbandTenths = __atomic_load_n( &( xDemoSettings.ulDeadbandTenths ), __ATOMIC_RELAXED );
+
+    return snprintf( pcBuffer, xLength, "%lu.%lu",
+                     ( unsigned long ) ( ulDeadbandTenths / 10 ),
+                     ( unsigned long ) ( ulDeadbandTenths % 10 ) );
+}
+
+static bool prvApplyQoS( const CmdValue_t * pxValue )
+{
+    int32_t lQoS = 0;
+
+    if( ( CmdDispatch_ToFixed( pxValue, 1, &lQoS ) == false ) ||
+        ( ( lQoS != eMQTTQoS0 ) && ( lQoS != eMQTTQoS1 ) ) )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( xDemoSettings.ulQoS ), ( uint32_t ) lQoS, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int prvReportQoS( char * pcBuffer,
+                         size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "%lu",
+                     ( unsigned long ) __atomic_load_n( &( xDemoSettings.ulQoS ), __ATOMIC_RELAXED ) );
+}
+
+static bool prvApplyRules( const CmdValue_t * pxValue )
+{
+    size_t xErrorOffset = 0;
+
+    /* The sampling task has not taken the last rules yet. */
+    if( ( pxValue->xType != eCmdValueString ) ||
+        ( __atomic_load_n( &ulRulesPending, __ATOMIC_ACQUIRE ) != 0 ) )
+    {
+        return false;
+    }
+
+    if( Rules_Compile( pcRuleInputs, eRuleInputCount,
+                       pcRuleOutputs, sizeof( pcRuleOutputs ) / sizeof( pcRuleOutputs[ 0 ] ),
+                       pxValue->pcText, pxValue->xLength,
+                       &xPendingRules, &xErrorOffset ) == false )
+    {
+        configPRINTF(( "Rules not compiled; error at character %lu.\r\n", ( unsigned long ) xErrorOffset ));
+
+        return false;
+    }
+
+    __atomic_store_n( &ulRuleCount, xPendingRules.ucRules, __ATOMIC_RELAXED );
+    __atomic_store_n( &ulRulesPending, 1, __ATOMIC_RELEASE );
+
+    if( xSamplingTask != NULL )
+    {
+        ( void ) xTaskNotify( xSamplingTask, ggdDEMO_NOTIFY_RULES, eSetBits );
+    }
+
+    return true;
+}
+
+static int prvReportRules( char * pcBuffer,
+                           size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "%lu",
+                     ( unsigned long ) __atomic_load_n( &ulRuleCount, __ATOMIC_RELAXED ) );
+}
+
+static bool prvApplyAdaptive( const CmdValue_t * pxValue )
+{
+    uint32_t ulAdaptive = 0;
+
+    if( CmdDispatch_IsString( pxValue, "on" ) == true )
+    {
+        ulAdaptive = 1;
+    }
+    else if( CmdDispatch_IsString( pxValue, "off" ) == false )
+    {
+        return false;
+    }
+
+    __atomic_store_n( &( xDemoSettings.ulAdaptive ), ulAdaptive, __ATOMIC_RELAXED );
+
+    return true;
+}
+
+static int prvReportAdaptive( char * pcBuffer,
+                              size_t xLength )
+{
+    return snprintf( pcBuffer, xLength, "\"%s\"",
+                     ( __atomic_load_n( &( xDemoSettings.ulAdaptive ), __ATOMIC_RELAXED ) == 1 ) ? "on" : "off" );
+}
+
+/**
+ * @brief The commands taken on ggdDEMO_MQTT_SUB_TOPIC.
+ *
+ * - led: "on" or "off".
+ * - period_ms: sampling period, from ggdDEMO_MIN_SAMPLE_PERIOD_MS to
+ *   ggdDEMO_MAX_SAMPLE_PERIOD_MS.
+ * - batch: readings gathered before publishing, up to ggdDEMO_RING_BATCH.
+ *   A vibration event may then wait for the next readings.
+ * - deadband: a temperature and humidity reading is only published once
+ *   either has moved by this much since the last one published, in steps
+ *   of 0.1. 0 publishes every reading.
+ * - qos: QoS of the publishes to the core, 0 or 1. The copy sent to the
+ *   cloud is not affected.
+ * - rules: local rules that drive the LED, replacing those in force, in
+ *   the syntax of driver/rule_engine.h; the inputs are temp, humidity and
+ *   vibration. "" removes them all. The ack gives the number of rules.
+ * - adaptive: "on" or "off". While on, the sampling task shortens the
+ *   period while the readings change and stretches it while they are
+ *   steady, between ggdDEMO_MIN_SAMPLE_PERIOD_MS and
+ *   ggdDEMO_ADAPTIVE_MAX_PERIOD_MS, starting from period_ms. Each change
+ *   is published as {"SamplePeriodMs":...}. Off keeps the period where it
+ *   is.
+ */
+static const CmdEntry_t xDemoCommands[] =
+{
+    cmddispatchENTRY( "led",       prvApplyLed,      prvReportLed      ),
+    cmddispatchENTRY( "period_ms", prvApplyPeriod,   prvReportPeriod   ),
+    cmddispatchENTRY( "batch",     prvApplyBatch,    prvReportBatch    ),
+    cmddispatchENTRY( "deadband",  prvApplyDeadband, prvReportDeadband ),
+    cmddispatchENTRY( "qos",       prvApplyQoS,      prvReportQoS      ),
+    cmddispatchENTRY( "rules",     prvApplyRules,    prvReportRules    ),
+    cmddispatchENTRY( "adaptive",  prvApplyAdaptive, prvReportAdaptive )
+};
+
+/**
+ * @brief Apply the commands of a message and queue its ack.
+ *
+ * Routed from ggdDEMO_MQTT_SUB_TOPIC and from the command topics of every
+ * device, of the group of the device and of the device itself.
+ */
+static void prvCommandHandler( void * pvContext,
+                               const char * pcTopic,
+                               size_t xTopicLength,
+                               void * pvMessage )
+{
+    const MQTTPublishData_t * const pxPublishParameters = ( const MQTTPublishData_t * ) pvMessage;
+    CmdResult_t xResult;
+    TaskHandle_t xConsumer;
+    size_t xAckLength;
+
+    ( void ) pvContext;
+    ( void ) pcTopic;
+    ( void ) xTopicLength;
+
+    /* Apply every key of the message, in one pass over it. */
+    if( CmdDispatch_Run( xDemoCommands,
+                         sizeof( xDemoCommands ) / sizeof( xDemoCommands[ 0 ] ),
+                         ( const char * ) pxPublishParameters->pvData,
+                         pxPublishParameters->ulDataLength,
+                         &xResult ) == false )
+    {
+        configPRINTF(( "No command found in Json document.\r\n" ));
+    }
+
+    /* The agent cannot publish from its own callback; the publish loop
+     * sends the ack. One ack waits at a time. */
+    if( __atomic_load_n( &ulAckLength, __ATOMIC_ACQUIRE ) == 0 )
+    {
+        xAckLength = CmdDispatch_FormatAck( xDemoCommands,
+                                            sizeof( xDemoCommands ) / sizeof( xDemoCommands[ 0 ] ),
+                                            &xResult,
+                                            cAckPayload,
+                                            sizeof( cAckPayload ) );
+        __atomic_store_n( &ulAckLength, ( uint32_t ) xAckLength, __ATOMIC_RELEASE );
+        xConsumer = __atomic_load_n( &xConsumerTask, __ATOMIC_ACQUIRE );
+
+        if( ( xAckLength > 0 ) && ( xConsumer != NULL ) )
+        {
+            xTaskNotifyGive( xConsumer );
+        }
+    }
+    else
+    {
+        configPRINTF(( "The ack of the previous command is still waiting.\r\n" ));
+    }
+}
+
+/**
+ * @brief Count every message received on the demo topics.
+ */
+static void prvCountHandler( void * pvContext,
+                             const char * pcTopic,
+                             size_t xTopicLength,
+                             void * pvMessage )
+{
+    ( void ) pvContext;
+    ( void ) pcTopic;
+    ( void ) xTopicLength;
+    ( void ) pvMessage;
+
+    Telemetry_Count( eTelemetryReceived );
+}
+
+/**
+ * @brief Register the handlers of the demo topics with xTopicRouter.
+ *
+ * Called once, before the first subscription, as the MQTT agent task
+ * reads the router without a lock.
+ */
+static BaseType_t prvAddRoutes( void )
+{
+    static const char cSubTopic[] = ggdDEMO_MQTT_SUB_TOPIC;
+    static const char cAllTopic[] = ggdDEMO_MQTT_CMD_PREFIX "all";
+    static const char cGroupTopic[] = ggdDEMO_MQTT_CMD_PREFIX "group/" ggdDEMO_GROUP;
+    static const char cDeviceTopic[] = ggdDEMO_MQTT_CMD_PREFIX "device/" clientcredentialIOT_THING_NAME;
+    static const char cDemoFilter[] = "freertos/demos/#";
+    bool xAdded;
+
+    TopicRouter_Init( &xTopicRouter );
+
+    xAdded = TopicRouter_Add( &xTopicRouter, cSubTopic, sizeof( cSubTopic ) - 1, prvCommandHandler, NULL ) &&
+             TopicRouter_Add( &xTopicRouter, cAllTopic, sizeof( cAllTopic ) - 1, prvCommandHandler, NULL ) &&
+             TopicRouter_Add( &xTopicRouter, cGroupTopic, sizeof( cGroupTopic ) - 1, prvCommandHandler, NULL ) &&
+             TopicRouter_Add( &xTopicRouter, cDeviceTopic, sizeof( cDeviceTopic ) - 1, prvCommandHandler, NULL ) &&
+             TopicRouter_Add( &xTopicRouter, cDemoFilter, sizeof( cDemoFilter ) - 1, prvCountHandler, NULL );
+
+    return ( xAdded == true ) ? pdPASS : pdFAIL;
+}
+
+static MQTTBool_t prvMQTTCallback( void * pvUserData,
+                                   const MQTTPublishData_t * const pxPublishParameters )
+{
+    ( void ) pvUserData;
+
+    /* Print information about the incoming PUBLISH message. The callback
+     * runs in the MQTT agent task, so only the arguments are copied here. */
+    dlogPRINTF( ( "Incoming PUBLISH received:\r\n"
+                  "Publish topic: %.*s\r\n"
+                  "Publish payload: %.*s\r\n",
+                  ( int ) pxPublishParameters->usTopicLength,
+                  ( const char * ) pxPublishParameters->pucTopic,
+                  ( int ) pxPublishParameters->ulDataLength,
+                  ( const char * ) pxPublishParameters->pvData ) );
+
+    /* One walk of the trie finds every handler of the topic, however many
+     * filters are registered. */
+    if( TopicRouter_Dispatch( &xTopicRouter,
+                              ( const char * ) pxPublishParameters->pucTopic,
+                              pxPublishParameters->usTopicLength,
+                              ( void * ) pxPublishParameters ) == 0 )
+    {
+        configPRINTF(( "No handler for topic %.*s.\r\n",
+                       ( int ) pxPublishParameters->usTopicLength,
+                       ( const char * ) pxPublishParameters->pucTopic ));
+    }
+
+    return eMQTTFalse;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvMQTTEventCallback( void * pvUserData,
+                                        const MQTTAgentCallbackParams_t * const pxCallbackParams )
+{
+    TaskHandle_t xConsumer;
+
+    ( void ) pvUserData;
+
+    if( pxCallbackParams->xMQTTEvent == eMQTTAgentDisconnect )
+    {
+        /* Wake the publish loop so that it fails over straight away instead
+         * of waiting for the next reading to fail. The agent task is not the
+         * ring's producer, so it raises a flag instead of queueing. */
+        __atomic_store_n( &ulLinkDown, 1, __ATOMIC_RELEASE );
+        xConsumer = __atomic_load_n( &xConsumerTask, __ATOMIC_ACQUIRE );
+
+        if( xConsumer != NULL )
+        {
+            xTaskNotifyGive( xConsumer );
+        }
+    }
+
+    /* The agent keeps ownership of any buffer. */
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect to the core and run the publish loop until the link drops.
+ *
+ * @return pdFAIL if the core could not be connected to; pdPASS once the
+ * connection was made, whatever happened afterwards.
+ */
+static BaseType_t prvSendMessageToGGC( GGD_HostAddressData_t * pxHostAddressData,
+                                       uint16_t usPort )
+{
+    const char * pcTopic = ggdDEMO_MQTT_MSG_TOPIC;
+    const char * const pcSubscribeFilters[] =
+    {
+        ggdDEMO_MQTT_SUB_TOPIC,
+        ggdDEMO_MQTT_CMD_PREFIX "#"
+    };
+    size_t xFilter;
+    MQTTAgentSubscribeParams_t xSubscribeParams;
+    MQTTAgentPublishParams_t xPublishParams;
+    MQTTAgentPublishParams_t xAckParams;
+    MQTTAgentReturnCode_t xReturnCode;
+    uint32_t ulPublishFailures = 0;
+    BaseType_t xLinkUp = pdTRUE;
+    FanoutMessage_t * pxFanoutMessage;
+    uint32_t ulDestinations;
+    size_t xRoute;
+    int lLength;
+    const DemoTaskMessage_t * pxMessage;
+    uint32_t ulBatch;
+
+    /* A disconnect of an earlier connection does not concern this one. */
+    __atomic_store_n( &ulLinkDown, 0, __ATOMIC_RELEASE );
+
+    if( prvMQTTConnect( pxHostAddressData, usPort ) != pdPASS )
+    {
+        return pdFAIL;
+    }
+    else
+    {
+        /* Setup subscribe parameters to subscribe to the command topics.
+         * Both filters share one callback, which hands each message to the
+         * handlers of its topic. */
+        xSubscribeParams.pxPublishCallback = prvMQTTCallback;
+        xSubscribeParams.pvPublishCallbackContext = NULL;
+        xSubscribeParams.xQoS = eMQTTQoS1;
+
+        for( xFilter = 0; ( xFilter < sizeof( pcSubscribeFilters ) / sizeof( pcSubscribeFilters[ 0 ] ) ) && ( xLinkUp == pdTRUE ); xFilter++ )
+        {
+            xSubscribeParams.pucTopic = ( const uint8_t * ) pcSubscribeFilters[ xFilter ];
+            xSubscribeParams.usTopicLength = ( uint16_t ) strlen( pcSubscribeFilters[ xFilter ] );
+
+            /* Subscribe to the topic. */
+            xReturnCode = MQTT_AGENT_Subscribe( xMQTTClientHandle,
+                                                &xSubscribeParams,
+                                                xMaxCommandTime );
+            if( xReturnCode != eMQTTAgentSuccess )
+            {
+                configPRINTF(( "%s: Could not subscribe to %s.\r\n", __FUNCTION__, pcSubscribeFilters[ xFilter ] ));
+                xLinkUp = pdFALSE;
+            }
+        }
+
+        if( xLinkUp == pdTRUE )
+        {
+            BootProfile_Mark( "subscribed" );
+        }
+
+        /* Publish to the topic to which this task is subscribed in order
+         * to receive back the data that was published. The QoS is set for
+         * each PUBLISH, as a command may change it. */
+        xPublishParams.pucTopic = ( const uint8_t * ) pcTopic;
+        xPublishParams.usTopicLength = ( uint16_t ) ( strlen( pcTopic ) );
+
+        xAckParams.xQoS = eMQTTQoS0;
+        xAckParams.pucTopic = ( const uint8_t * ) ggdDEMO_MQTT_ACK_TOPIC;
+        xAckParams.usTopicLength = ( uint16_t ) ( sizeof( ggdDEMO_MQTT_ACK_TOPIC ) - 1 );
+        xAckParams.pvData = cAckPayload;
+
+        if( xGgdRequestTimer != NULL )
+        {
+            xGgdTimerStarted = xTimerStart( xGgdRequestTimer, 0 );
+        }
+
+        if( xGgdTimerStarted == pdTRUE )
+        {
+            configPRINTF(( "Starting %s timer.\r\n", pcGgdTimerName ));
+        }
+        else
+        {
+            configPRINTF(( "ERROR: failed to start %s timer.\r\n", pcGgdTimerName ));
+        }
+
+        while( xLinkUp == pdTRUE )
+        {
+            if( __atomic_exchange_n( &ulLinkDown, 0, __ATOMIC_ACQ_REL ) != 0 )
+            {
+                configPRINTF( ( "Lost connection to Greengrass core %s.\r\n",
+                                pxHostAddressData->pcHostAddress ) );
+                xLinkUp = pdFALSE;
+                break;
+            }
+
+            /* Acknowledge the last command. The callback does not write the
+             * payload again until the length is cleared. */
+            xAckParams.ulDataLength = __atomic_load_n( &ulAckLength, __ATOMIC_ACQUIRE );
+
+            if( xAckParams.ulDataLength != 0 )
+            {
+                if( MQTT_AGENT_Publish( xMQTTClientHandle,
+                                        &xAckParams,
+                                        xMaxCommandTime ) != eMQTTAgentSuccess )
+                {
+                    configPRINTF( ( "ERROR: failed to acknowledge the command.\r\n" ) );
+                }
+
+                __atomic_store_n( &ulAckLength, 0, __ATOMIC_RELEASE );
+            }
+
+            /* Readings are taken from the ring a batch at a time. */
+            if( xDemoBatchNext == xDemoBatchCount )
+            {
+                /* With a batch set by command, wait until it has been
+                 * gathered, so that it goes out in one go. */
+                ulBatch = __atomic_load_n( &( xDemoSettings.ulBatch ), __ATOMIC_RELAXED );
+
+                if( ( ulBatch > 1 ) && ( SpscRing_Count( &xDemoRing ) < ulBatch ) )
+                {
+                    ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+                    continue;
+                }
+
+                xDemoBatchCount = SpscRing_PopBatch( &xDemoRing, xDemoBatch, ggdDEMO_RING_BATCH );
+                xDemoBatchNext = 0;
+
+                if( xDemoBatchCount == 0 )
+                {
+                    /* Every push is followed by a notification, so one made
+                     * after the ring was found empty is not missed. */
+                    ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+                    continue;
+                }
+
+                Telemetry_NoteQueueDepth( ( UBaseType_t ) ( SpscRing_Count( &xDemoRing ) + xDemoBatchCount ) );
+            }
+
+            pxMessage = &( xDemoBatch[ xDemoBatchNext++ ] );
+
+            /* The payload is formatted once and shared by every
+             * destination it is routed to. */
+            pxFanoutMessage = Fanout_Alloc( pcTopic, ggdDEMO_MAX_MQTT_MSG_SIZE );
+
+            if( pxFanoutMessage == NULL )
+            {
+                configPRINTF( ( "ERROR: no memory for the PUBLISH payload.\r\n" ) );
+                continue;
+            }
+
+            /* Generate the payload for the PUBLISH. */
+            if (pxMessage->type == eEventTypeGpio)
+            {
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                ggdDEMO_MQTT_MSG_VIBRATE,
+                                "\"Vibrating\"" );
+            }
+            else if(pxMessage->type == eEventTypeTemp)
+            {
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                ggdDEMO_MQTT_MSG_TEMPERATURE,
+                                pxMessage->humidity, pxMessage->temperature );
+            }
+            else if( pxMessage->type == eEventTypePeriod )
+            {
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                ggdDEMO_MQTT_MSG_PERIOD,
+                                ( unsigned long ) pxMessage->ulPeriodMs );
+            }
+            else if( pxMessage->type == eEventTypeSummary )
+            {
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                ggdDEMO_MQTT_MSG_SUMMARY,
+                                pcStatsChannels[ pxMessage->ulChannel ],
+                                ( unsigned long ) pxMessage->xSummary.ulCount,
+                                pxMessage->xSummary.fMean / 10.0f,
+                                pxMessage->xSummary.fVariance / 100.0f,
+                                ( float ) pxMessage->xSummary.lMin / 10.0f,
+                                ( float ) pxMessage->xSummary.lMax / 10.0f );
+            }
+            else if( pxMessage->type == eEventTypeAnomaly )
+            {
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                ggdDEMO_MQTT_MSG_ANOMALY,
+                                pcStatsChannels[ pxMessage->ulChannel ],
+                                ( pxMessage->ulChannel == eStatsChannelTemp ) ? pxMessage->temperature : pxMessage->humidity,
+                                pxMessage->fZScore );
+            }
+            else
+            {
+                /* Generate the payload for the PUBLISH. */
+                lLength = snprintf( pxFanoutMessage->cPayload,
+                                pxFanoutMessage->ulCapacity,
+                                "%s",
+                                "Failed to get event type." );
+            }
+
+            pxFanoutMessage->ulLength = ( lLength > 0 ) ? ( uint32_t ) lLength : 0;
+
+            ulDestinations = fanoutROUTE_GGC;
+
+            for( xRoute = 0; xRoute < sizeof( xDemoRoutes ) / sizeof( xDemoRoutes[ 0 ] ); xRoute++ )
+            {
+                if( xDemoRoutes[ xRoute ].type == pxMessage->type )
+                {
+                    ulDestinations = xDemoRoutes[ xRoute ].ulDestinations;
+                    break;
+                }
+            }
+
+            /* Hand the cloud its reference first; its task publishes
+             * while this one talks to the core. */
+            if( ( ulDestinations & fanoutROUTE_CLOUD ) != 0 )
+            {
+                ( void ) Fanout_SendToCloud( pxFanoutMessage );
+            }
+
+            xReturnCode = eMQTTAgentSuccess;
+
+            if( ( ulDestinations & fanoutROUTE_GGC ) != 0 )
+            {
+                xPublishParams.xQoS = ( MQTTQoS_t ) __atomic_load_n( &( xDemoSettings.ulQoS ), __ATOMIC_RELAXED );
+                xPublishParams.pvData = pxFanoutMessage->cPayload;
+                xPublishParams.ulDataLength = pxFanoutMessage->ulLength;
+                SchedTrace_SpanBegin( "publish" );
+                xReturnCode = MQTT_AGENT_Publish( xMQTTClientHandle,
+                                                &xPublishParams,
+                                                xMaxCommandTime );
+                SchedTrace_SpanEnd( "publish" );
+            }
+
+            Fanout_Release( pxFanoutMessage );
+
+            if( xReturnCode != eMQTTAgentSuccess )
+            {
+                configPRINTF( ( "mqtt_client - Failure to publish \n" ) );
+                Telemetry_Count( eTelemetryPublishFailed );
+
+                /* Treat a run of failures as a dead link even if the
+                 * agent never reported the disconnect. */
+                if( ++ulPublishFailures >= ggdDEMO_MAX_PUBLISH_FAILURES )
+                {
+                    xLinkUp = pdFALSE;
+                }
+            }
+            else
+            {
+                ulPublishFailures = 0;
+
+                if( ( ulDestinations & fanoutROUTE_GGC ) != 0 )
+                {
+                    Telemetry_Count( eTelemetryPublished );
+                    BootProfile_Mark( "first_publish" );
+                    BootProfile_Report();
+                    prvWatchSteadyState();
+                }
+            }
+
+            /* No delay here: the sampling period already paces the
+             * readings, and a batch goes out back to back. */
+            SchedTrace_Poll();
+        }
+
+        configPRINTF( ( "Disconnecting from broker.\r\n" ) );
+
+        /* The client is kept so that the next candidate can reuse it. */
+        if( MQTT_AGENT_Disconnect( xMQTTClientHandle,
+                                   xMaxCommandTime ) == eMQTTAgentSuccess )
+        {
+            configPRINTF( ( "Disconnected from the broker.\r\n" ) );
+        }
+        else
+        {
+            configPRINTF( ( "ERROR:  Did not disconnected from the broker.\r\n" ) );
+        }
+    }
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvMQTTConnect( GGD_HostAddressData_t * pxHostAddressData,
+                                  uint16_t usPort )
+{
+    MQTTAgentConnectParams_t xConnectParams;
+    TlsSessionStats_t xSessionStats = { 0 };
+    BaseType_t xResult = pdPASS;
+    TickType_t xStart;
+
+    /* Connect to the broker. */
+    xConnectParams.pucClientId = ( const uint8_t * ) ( clientcredentialIOT_THING_NAME );
+    xConnectParams.usClientIdLength = ( uint16_t ) ( strlen( clientcredentialIOT_THING_NAME ) );
+    xConnectParams.pcURL = pxHostAddressData->pcHostAddress;
+    xConnectParams.usPort = usPort;
+    xConnectParams.xFlags = mqttagentREQUIRE_TLS | mqttagentURL_IS_IP_ADDRESS;
+    xConnectParams.xURLIsIPAddress = pdTRUE; /* Deprecated. */
+    xConnectParams.pcCertificate = pxHostAddressData->pcCertificate;
+    xConnectParams.ulCertificateSize = pxHostAddressData->ulCertificateSize;
+    xConnectParams.pvUserData = NULL;
+    xConnectParams.pxCallback = prvMQTTEventCallback;
+    xConnectParams.xSecuredConnection = pdTRUE; /* Deprecated. */
+
+    /* The agent connect is TCP connect, TLS handshake and MQTT CONNECT; the
+     * handshake dominates. The TLS layer resumes the session of the last
+     * connection to this core, from the probe or from before a failover,
+     * so that only the first connection pays for the full handshake. */
+    xStart = xTaskGetTickCount();
+
+    if( MQTT_AGENT_Connect( xMQTTClientHandle,
+                            &xConnectParams,
+                            xMaxCommandTime ) != eMQTTAgentSuccess )
+    {
+        configPRINTF( ( "ERROR: Could not connect to the Broker.\r\n" ) );
+        xResult = pdFAIL;
+    }
+    else
+    {
+        Telemetry_Count( eTelemetryConnected );
+        BootProfile_Mark( "connected" );
+        ( void ) TlsSessionCache_GetStats( pxHostAddressData->pcHostAddress, usPort, &xSessionStats );
+        configPRINTF( ( "Connected to %s:%u in %u ms, TLS session %s.\r\n",
+                        pxHostAddressData->pcHostAddress,
+                        usPort,
+                        ( unsigned ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS ),
+                        ( xSessionStats.xLastResumed == pdTRUE ) ? "resumed" : "new" ) );
+    }
+
+    TLSMetrics_Record( pxHostAddressData->pcHostAddress,
+                       usPort,
+                       ( xResult == pdPASS ) ? pdTRUE : pdFALSE,
+                       xTaskGetTickCount() - xStart );
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect to the discovery endpoint and send the request.
+ */
+static Socket_t prvDiscoveryConnect( void )
+{
+    Socket_t xSocket;
+    SocketsSockaddr_t xServerAddress = { 0 };
+    TickType_t xTimeout = pdMS_TO_TICKS( ggdDEMO_DISCOVERY_TIMEOUT_MS );
+    TickType_t xStart;
+    BaseType_t xConnected = pdFALSE;
+    static const char cRequest[] = ggdDEMO_DISCOVERY_REQUEST;
+
+    xServerAddress.ulAddress = SOCKETS_GetHostByName( clientcredentialMQTT_BROKER_ENDPOINT );
+
+    if( xServerAddress.ulAddress == 0 )
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    xServerAddress.usPort = SOCKETS_htons( clientcredentialGREENGRASS_DISCOVERY_PORT );
+    xServerAddress.ucSocketDomain = SOCKETS_AF_INET;
+
+    xSocket = SOCKETS_Socket( SOCKETS_AF_INET, SOCKETS_SOCK_STREAM, SOCKETS_IPPROTO_TCP );
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    /* The device certificate authenticates the request; the default root CA
+     * authenticates the endpoint. */
+    if( ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_REQUIRE_TLS, NULL, 0 ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_SERVER_NAME_INDICATION,
+                              clientcredentialMQTT_BROKER_ENDPOINT,
+                              sizeof( clientcredentialMQTT_BROKER_ENDPOINT ) ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) ) == SOCKETS_ERROR_NONE ) &&
+        ( SOCKETS_SetSockOpt( xSocket, 0, SOCKETS_SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) ) == SOCKETS_ERROR_NONE ) )
+    {
+        xStart = xTaskGetTickCount();
+        xConnected = ( SOCKETS_Connect( xSocket, &xServerAddress, sizeof( xServerAddress ) ) == SOCKETS_ERROR_NONE ) ? pdTRUE : pdFALSE;
+        TLSMetrics_Record( clientcredentialMQTT_BROKER_ENDPOINT,
+                           clientcredentialGREENGRASS_DISCOVERY_PORT,
+                           xConnected,
+                           xTaskGetTickCount() - xStart );
+    }
+
+    if( ( xConnected == pdFALSE ) ||
+        ( SOCKETS_Send( xSocket, cRequest, sizeof( cRequest ) - 1, 0 ) != ( int32_t ) ( sizeof( cRequest ) - 1 ) ) )
+    {
+        ( void ) SOCKETS_Close( xSocket );
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    return xSocket;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check one line of the HTTP response header.
+ *
+ * @return pdFAIL if the status is not 200.
+ */
+static BaseType_t prvParseHeaderLine( const char * pcLine,
+                                      BaseType_t xStatusLine,
+                                      uint32_t * pulContentLength )
+{
+    static const char cContentLength[] = "content-length:";
+    size_t x;
+
+    if( xStatusLine == pdTRUE )
+    {
+        /* "HTTP/1.1 200 OK" */
+        return ( ( strncmp( pcLine, "HTTP/1.", 7 ) == 0 ) &&
+                 ( strncmp( pcLine + 8, " 200", 4 ) == 0 ) ) ? pdPASS : pdFAIL;
+    }
+
+    for( x = 0; x < sizeof( cContentLength ) - 1; x++ )
+    {
+        if( ( pcLine[ x ] | 0x20 ) != cContentLength[ x ] )
+        {
+            return pdPASS;
+        }
+    }
+
+    *pulContentLength = ( uint32_t ) strtoul( pcLine + x, NULL, 10 );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Download the discovery document and rank every core endpoint in it.
+ *
+ * The response is read in small chunks and each chunk of the body is handed
+ * to the parser as it arrives, so the document is never held in memory.
+ * Certificates in the returned list are owned by it; release them with
+ * GGDParser_FreeList().
+ */
+static BaseType_t prvFetchCandidates( GGDCandidateList_t * pxList )
+{
+    BaseType_t xStatus = pdPASS;
+    BaseType_t xInHeader = pdTRUE;
+    BaseType_t xStatusLine = pdTRUE;
+    Socket_t xSocket;
+    GGDParser_t * pxParser;
+    char cChunk[ ggdDEMO_DISCOVERY_CHUNK_SIZE ];
+    char cLine[ 48 ];
+    size_t xLineLength = 0;
+    uint32_t ulContentLength = UINT32_MAX;
+    uint32_t ulBodyReceived = 0;
+    int32_t lReceived;
+    int32_t x;
+
+    /* The parser is a few hundred bytes; keep it off the task stack. */
+    pxParser = pvPortMalloc( sizeof( GGDParser_t ) );
+
+    if( pxParser == NULL )
+    {
+        return pdFAIL;
+    }
+
+    GGDParser_Init( pxParser, pxList );
+
+    xSocket = prvDiscoveryConnect();
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        configPRINTF( ( "Failed to reach the discovery endpoint.\r\n" ) );
+        xStatus = pdFAIL;
+    }
+
+    while( ( xStatus == pdPASS ) && ( ulBodyReceived < ulContentLength ) )
+    {
+        lReceived = SOCKETS_Recv( xSocket, cChunk, sizeof( cChunk ), 0 );
+
+        if( lReceived <= 0 )
+        {
+            /* Without a Content-Length the body ends with the connection. */
+            if( ( xInHeader == pdTRUE ) || ( ulContentLength != UINT32_MAX ) )
+            {
+                xStatus = pdFAIL;
+            }
+
+            break;
+        }
+
+        x = 0;
+
+        /* Header lines are inspected one at a time; only their start matters. */
+        while( ( xInHeader == pdTRUE ) && ( x < lReceived ) && ( xStatus == pdPASS ) )
+        {
+            if( cChunk[ x ] == '\n' )
+            {
+                cLine[ xLineLength ] = '\0';
+
+                if( ( xLineLength == 0 ) || ( ( xLineLength == 1 ) && ( cLine[ 0 ] == '\r' ) ) )
+                {
+                    xInHeader = pdFALSE;
+                }
+                else
+                {
+                    xStatus = prvParseHeaderLine( cLine, xStatusLine, &ulContentLength );
+                    xStatusLine = pdFALSE;
+                }
+
+                xLineLength = 0;
+            }
+            else if( xLineLength < sizeof( cLine ) - 1 )
+            {
+                cLine[ xLineLength++ ] = cChunk[ x ];
+            }
+
+            x++;
+        }
+
+        if( ( xInHeader == pdFALSE ) && ( x < lReceived ) && ( xStatus == pdPASS ) )
+        {
+            ulBodyReceived += ( uint32_t ) ( lReceived - x );
+            xStatus = GGDParser_Feed( pxParser, &cChunk[ x ], ( size_t ) ( lReceived - x ) );
+        }
+    }
+
+    if( xSocket != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) SOCKETS_Shutdown( xSocket, SOCKETS_SHUT_RDWR );
+        ( void ) SOCKETS_Close( xSocket );
+    }
+
+    /* Always finish so that a failed parse releases what it allocated. */
+    if( GGDParser_Finish( pxParser ) != pdPASS )
+    {
+        xStatus = pdFAIL;
+    }
+
+    vPortFree( pxParser );
+
+    if( xStatus == pdPASS )
+    {
+        ( void ) GGDProbe_Rank( pxList );
+    }
+    else
+    {
+        GGDParser_FreeList( pxList );
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Cache the best endpoint of a freshly ranked list.
+ */
+static void prvCacheBestCandidate( GGDCandidateList_t * pxList )
+{
+    GGD_HostAddressData_t xHostAddressData;
+    uint16_t usPort;
+
+    if( ( GGDProbe_Next( pxList, &xHostAddressData, &usPort ) == pdPASS ) &&
+        ( pxList->xCandidates[ pxList->ucRanked[ 0 ] ].xHealthy == pdTRUE ) )
+    {
+        if( GGDCache_Store( &xHostAddressData, usPort ) == pdPASS )
+        {
+            configPRINTF( ( "Cached Greengrass core %s:%u.\r\n",
+                            xHostAddressData.pcHostAddress, usPort ) );
+        }
+    }
+
+    /* Hand the best candidate out again on the next call. */
+    pxList->xNext = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Re-run discovery while the demo talks to a cached core.
+ *
+ * Runs at low priority with its own list so that it never delays
+ * the publish loop. The cache is only rewritten if discovery picked a
+ * different core; otherwise its time to live is simply reset.
+ */
+static void prvRefreshDiscoveryTask( void * pvParameters )
+{
+    GGDCandidateList_t * pxList;
+
+    ( void ) pvParameters;
+
+    StackBudget_Register( NULL, "democonfigDEMO_STACKSIZE", democonfigDEMO_STACKSIZE );
+
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        pxList = &xRefreshList;
+    #else
+        pxList = pvPortMalloc( sizeof( GGDCandidateList_t ) );
+    #endif
+
+    if( pxList != NULL )
+    {
+        if( prvFetchCandidates( pxList ) == pdPASS )
+        {
+            prvCacheBestCandidate( pxList );
+            GGDParser_FreeList( pxList );
+        }
+        else
+        {
+            configPRINTF( ( "Background discovery failed, keeping cached core.\r\n" ) );
+        }
+
+        #if ( democonfigSTATIC_ALLOCATION == 0 )
+            vPortFree( pxList );
+        #endif
+    }
+
+    StackBudget_TaskExit();
+    __atomic_store_n( &ulRefreshRunning, 0, __ATOMIC_RELEASE );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Count heap allocations from the first publish to the core on,
+ * and report them after ggdDEMO_ALLOC_CHECK_PUBLISHES publishes. With
+ * democonfigSTACK_BUDGET set, the stack budget is printed after
+ * ggdDEMO_STACK_BUDGET_PUBLISHES, once discovery has run.
+ */
+static void prvWatchSteadyState( void )
+{
+    static uint32_t ulPublishes = 0;
+
+    if( __atomic_load_n( &ulRefreshRunning, __ATOMIC_ACQUIRE ) != 0 )
+    {
+        return;
+    }
+
+    AllocWatch_Start();
+
+    if( ++ulPublishes == ggdDEMO_ALLOC_CHECK_PUBLISHES )
+    {
+        AllocWatch_Report();
+    }
+
+    #if ( democonfigSTACK_BUDGET == 1 )
+        if( ulPublishes == ggdDEMO_STACK_BUDGET_PUBLISHES )
+        {
+            StackBudget_Report();
+        }
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDiscoverGreenGrassCore( void * pvParameters )
+{
+    GGD_HostAddressData_t xHostAddressData;
+    GGD_HostAddressData_t xCachedHostAddressData;
+    GGDCacheStatus_t xCacheStatus;
+    uint16_t usCachedPort = 0;
+    uint16_t usPort;
+    TaskHandle_t xRefreshTask = NULL;
+
+    StackBudget_Register( NULL, "democonfigDEMO_STACKSIZE", democonfigDEMO_STACKSIZE );
+
+    /* This task consumes the ring from here on. */
+    __atomic_store_n( &xConsumerTask, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE );
+
+    /* Create MQTT Client. */
+    if( MQTT_AGENT_Create( &( xMQTTClientHandle ) ) == eMQTTAgentSuccess )
+    {
+        /* A fresh cache entry lets us skip the discovery round trip on boot.
+         * Discovery still runs in the background to pick up group changes. */
+        xCacheStatus = GGDCache_Load( &xCachedHostAddressData, &usCachedPort );
+
+        if( xCacheStatus == eGGDCacheFresh )
+        {
+            BootProfile_Mark( "core_cached" );
+            configPRINTF( ( "Connecting to cached Greengrass core %s:%u.\r\n",
+                            xCachedHostAddressData.pcHostAddress, usCachedPort ) );
+
+            __atomic_store_n( &ulRefreshRunning, 1, __ATOMIC_RELEASE );
+
+            #if ( democonfigSTATIC_ALLOCATION == 1 )
+                xRefreshTask = xTaskCreateStaticPinnedToCore( prvRefreshDiscoveryTask,
+                                                              "GgdRefresh",
+                                                              democonfigDEMO_STACKSIZE,
+                                                              NULL,
+                                                              ggdDEMO_REFRESH_TASK_PRIORITY,
+                                                              xRefreshTaskStack,
+                                                              &xRefreshTaskBuffer,
+                                                              ggdDEMO_NETWORK_CORE );
+            #else
+                ( void ) xTaskCreatePinnedToCore( prvRefreshDiscoveryTask,
+                                                  "GgdRefresh",
+                                                  democonfigDEMO_STACKSIZE,
+                                                  NULL,
+                                                  ggdDEMO_REFRESH_TASK_PRIORITY,
+                                                  &xRefreshTask,
+                                                  ggdDEMO_NETWORK_CORE );
+            #endif
+
+            if( xRefreshTask == NULL )
+            {
+                __atomic_store_n( &ulRefreshRunning, 0, __ATOMIC_RELEASE );
+                configPRINTF( ( "ERROR: failed to start background discovery.\r\n" ) );
+            }
+
+            if( prvSendMessageToGGC( &xCachedHostAddressData, usCachedPort ) == pdFAIL )
+            {
+                configPRINTF( ( "Cached Greengrass core unreachable, rediscovering.\r\n" ) );
+                GGDCache_Invalidate();
+            }
+        }
+
+        for( ; ; )
+        {
+            /* Demonstrate automated connection. */
+            configPRINTF( ( "Attempting automated selection of Greengrass device\r\n" ) );
+
+            /* Release the certificates of the previous document. */
+            GGDParser_FreeList( &xCandidateList );
+
+            if( prvFetchCandidates( &xCandidateList ) == pdPASS )
+            {
+                BootProfile_Mark( "discovered" );
+                configPRINTF( ( "Greengrass device discovered.\r\n" ) );
+                prvCacheBestCandidate( &xCandidateList );
+
+                /* Walk the ranked list: a lost link moves straight on to the
+                 * next endpoint, which was already probed. */
+                while( GGDProbe_Next( &xCandidateList, &xHostAddressData, &usPort ) == pdPASS )
+                {
+                    configPRINTF( ( "Establishing MQTT communication to Greengrass %s:%u...\r\n",
+                                    xHostAddressData.pcHostAddress, usPort ) );
+                    ( void ) prvSendMessageToGGC( &xHostAddressData, usPort );
+                }
+            }
+            else if( xCacheStatus == eGGDCacheStale )
+            {
+                /* The cloud is unreachable but the local core may well be up. */
+                configPRINTF( ( "Discovery failed, trying expired cached core %s:%u.\r\n",
+                                xCachedHostAddressData.pcHostAddress, usCachedPort ) );
+                ( void ) prvSendMessageToGGC( &xCachedHostAddressData, usCachedPort );
+            }
+            else
+            {
+                configPRINTF( ( "Auto-connect: Failed to retrieve Greengrass address and certificate.\r\n" ) );
+            }
+
+            /* Every endpoint failed; probe again after a pause. */
+            TLSMetrics_Print();
+            vTaskDelay( pdMS_TO_TICKS( ggdDEMO_REDISCOVERY_DELAY_MS ) );
+        }
     }
 
+    SchedTrace_Dump();
     configPRINTF( ( "----Demo finished----\r\n" ) );
+
+    /* Release the demo runner, which waits in vStartGreenGrassDiscoveryTask(). */
+    if( pvParameters != NULL )
+    {
+        xTaskNotifyGive( ( TaskHandle_t ) pvParameters );
+    }
+
+    StackBudget_TaskExit();
     vTaskDelete( NULL );
 }
 
@@ -397,6 +1939,8 @@ int vStartGreenGrassDiscoveryTask( bool awsIotMqttMode,
                  void * pNetworkCredentialInfo,
                  const IotNetworkInterface_t * pNetworkInterface )
 {
+    TaskHandle_t xDemoTask = NULL;
+
 	/* Unused parameters */
 	( void )awsIotMqttMode;
 	( void )pIdentifier;
@@ -404,6 +1948,11 @@ int vStartGreenGrassDiscoveryTask( bool awsIotMqttMode,
 	( void )pNetworkCredentialInfo;
 	( void )pNetworkInterface;
 
+    BootProfile_Mark( "demo_start" );
+
+    /* The runner was created with democonfigDEMO_STACKSIZE. */
+    StackBudget_Register( NULL, "democonfigDEMO_STACKSIZE", democonfigDEMO_STACKSIZE );
+
     gpio_config_t gpio14_conf = {
         .pin_bit_mask = GPIO_SEL_14,
         .mode = GPIO_MODE_INPUT,
@@ -413,8 +1962,6 @@ int vStartGreenGrassDiscoveryTask( bool awsIotMqttMode,
     };
     gpio_config(&gpio14_conf);
     gpio_set_intr_type(GPIO_NUM_14, GPIO_INTR_POSEDGE);
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(GPIO_NUM_14, gpio_isr_handler, (void*) GPIO_NUM_14);
 
 	setDHTgpio(25);
 
@@ -428,17 +1975,146 @@ int vStartGreenGrassDiscoveryTask( bool awsIotMqttMode,
     gpio_config(&gpio13_conf);
     gpio_set_level(GPIO_NUM_13, 1);
 
-    xDemoQueue = xQueueCreate(10, sizeof(DemoTaskMessage_t));
+    ( void ) SpscRing_Init( &xDemoRing,
+                            xDemoRingItems,
+                            sizeof( DemoTaskMessage_t ),
+                            ggdDEMO_RING_LENGTH );
+
+    if( prvAddRoutes() != pdPASS )
+    {
+        configPRINTF( ( "ERROR: failed to add the topic routes.\r\n" ) );
+    }
+
+    if( xSamplingTask == NULL )
+    {
+        #if ( democonfigSTATIC_ALLOCATION == 1 )
+            xSamplingTask = xTaskCreateStaticPinnedToCore( prvSamplingTask,
+                                                           "GgdSampling",
+                                                           ggdDEMO_SAMPLING_STACK_SIZE,
+                                                           NULL,
+                                                           ggdDEMO_SAMPLING_PRIORITY,
+                                                           xSamplingTaskStack,
+                                                           &xSamplingTaskBuffer,
+                                                           ggdDEMO_SAMPLING_CORE );
+        #else
+            ( void ) xTaskCreatePinnedToCore( prvSamplingTask,
+                                              "GgdSampling",
+                                              ggdDEMO_SAMPLING_STACK_SIZE,
+                                              NULL,
+                                              ggdDEMO_SAMPLING_PRIORITY,
+                                              &xSamplingTask,
+                                              ggdDEMO_SAMPLING_CORE );
+        #endif
+
+        if( xSamplingTask == NULL )
+        {
+            configPRINTF( ( "ERROR: failed to create the sampling task.\r\n" ) );
+        }
+        else
+        {
+            StackBudget_Register( xSamplingTask, "ggdDEMO_SAMPLING_STACK_SIZE", ggdDEMO_SAMPLING_STACK_SIZE );
+            ( void ) xTaskNotify( xSamplingTask, ggdDEMO_NOTIFY_START, eSetBits );
+        }
+    }
 
     if( xGgdRequestTimer == NULL )
     {
-        xGgdRequestTimer = xTimerCreate( pcGgdTimerName,
-                                      pdMS_TO_TICKS( 3000 ),
-                                      pdTRUE,
-                                      NULL,
-                                      prvRequestTimer_Callback );
+        #if ( democonfigSTATIC_ALLOCATION == 1 )
+            xGgdRequestTimer = xTimerCreateStatic( pcGgdTimerName,
+                                                   pdMS_TO_TICKS( xDemoSettings.ulPeriodMs ),
+                                                   pdTRUE,
+                                                   NULL,
+                                                   prvRequestTimer_Callback,
+                                                   &xGgdRequestTimerBuffer );
+        #else
+            xGgdRequestTimer = xTimerCreate( pcGgdTimerName,
+                                             pdMS_TO_TICKS( xDemoSettings.ulPeriodMs ),
+                                             pdTRUE,
+                                             NULL,
+                                             prvRequestTimer_Callback );
+        #endif
+    }
+
+    BootProfile_Mark( "gpio" );
+
+    /* The DHT22 needs time after power-up before its first reading. That
+     * wait overlaps discovery and the connection, and the reading is
+     * queued so that it is published as soon as the core is connected. */
+    if( xGgdWarmupTimer == NULL )
+    {
+        #if ( democonfigSTATIC_ALLOCATION == 1 )
+            xGgdWarmupTimer = xTimerCreateStatic( "GgdDemoWarmup",
+                                                  pdMS_TO_TICKS( ggdDEMO_SENSOR_WARMUP_MS ),
+                                                  pdFALSE,
+                                                  NULL,
+                                                  prvRequestTimer_Callback,
+                                                  &xGgdWarmupTimerBuffer );
+        #else
+            xGgdWarmupTimer = xTimerCreate( "GgdDemoWarmup",
+                                            pdMS_TO_TICKS( ggdDEMO_SENSOR_WARMUP_MS ),
+                                            pdFALSE,
+                                            NULL,
+                                            prvRequestTimer_Callback );
+        #endif
+    }
+
+    if( ( xGgdWarmupTimer == NULL ) || ( xTimerStart( xGgdWarmupTimer, 0 ) != pdPASS ) )
+    {
+        configPRINTF( ( "First reading waits for the %s timer.\r\n", pcGgdTimerName ) );
+    }
+
+    TLSMetrics_Init();
+    TlsSessionCache_Init();
+
+    if( DLog_Init() != 0 )
+    {
+        configPRINTF( ( "ERROR: failed to start the deferred log task.\r\n" ) );
+    }
+
+    /* Readings are archived in IoT Core alongside the local core. */
+    if( Fanout_StartCloudLink() != pdPASS )
+    {
+        configPRINTF( ( "AWS IoT Core link not started; publishing to the core only.\r\n" ) );
+    }
+
+    if( Telemetry_Start( &xDemoRing ) != pdPASS )
+    {
+        configPRINTF( ( "ERROR: failed to start the telemetry task.\r\n" ) );
+    }
+
+    /* The demo runner task has no core affinity. Discovery, MQTT and TLS
+     * run in a task pinned to the network core, where the WiFi and TCP/IP
+     * tasks of ESP-IDF already are; the runner waits for it. */
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        xDemoTask = xTaskCreateStaticPinnedToCore( prvDiscoverGreenGrassCore,
+                                                   "GgdDemo",
+                                                   democonfigDEMO_STACKSIZE,
+                                                   ( void * ) xTaskGetCurrentTaskHandle(),
+                                                   uxTaskPriorityGet( NULL ),
+                                                   xDemoTaskStack,
+                                                   &xDemoTaskBuffer,
+                                                   ggdDEMO_NETWORK_CORE );
+    #else
+        ( void ) xTaskCreatePinnedToCore( prvDiscoverGreenGrassCore,
+                                          "GgdDemo",
+                                          democonfigDEMO_STACKSIZE,
+                                          ( void * ) xTaskGetCurrentTaskHandle(),
+                                          uxTaskPriorityGet( NULL ),
+                                          &xDemoTask,
+                                          ggdDEMO_NETWORK_CORE );
+    #endif
+
+    if( xDemoTask != NULL )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
     }
+    else
+    {
+        configPRINTF( ( "Failed to create the demo task; running on any core.\r\n" ) );
+        prvDiscoverGreenGrassCore( NULL );
+    }
+
+    StackBudget_TaskExit();
 
-    prvDiscoverGreenGrassCore( NULL );
     return 0;
 }
@@ -0,0 +1,346 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_telemetry.c
+ * @brief Periodic report of the device's own resource use.
+ */
+
+/* Standard includes. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "esp_attr.h"
+
+#include "aws_telemetry.h"
+#include "aws_fanout.h"
+
+#include "driver/alloc_watch.h"
+#include "driver/stack_budget.h"
+
+/**
+ * @brief Room kept at the end of a report for the fields after the tasks.
+ */
+#define telemetryTRAILER_SIZE    ( 48 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run time of a task at the previous report, to turn the cumulative
+ * counters of FreeRTOS into a share of the last period.
+ */
+typedef struct TelemetryRunTime
+{
+    UBaseType_t uxTaskNumber;
+    uint32_t ulRunTime;
+} TelemetryRunTime_t;
+
+static uint32_t ulCounters[ eTelemetryCounterCount ] = { 0 };
+static uint32_t ulQueueHighWater = 0;
+static const SpscRing_t * pxTelemetryRing = NULL;
+
+#if ( configUSE_TRACE_FACILITY == 1 )
+    static TaskStatus_t xTaskStatus[ telemetryMAX_TASKS ];
+#endif
+
+#if ( configUSE_TRACE_FACILITY == 1 ) && ( configGENERATE_RUN_TIME_STATS == 1 )
+    static TelemetryRunTime_t xPreviousRunTime[ telemetryMAX_TASKS ];
+    static UBaseType_t uxPreviousTasks = 0;
+    static uint32_t ulPreviousTotalRunTime = 0;
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append to a report.
+ *
+ * @return pdFAIL, leaving the report unchanged, if the text does not fit
+ * in front of xReserve bytes.
+ */
+static BaseType_t prvAppend( char * pcBuffer,
+                             size_t * pxLength,
+                             size_t xReserve,
+                             const char * pcFormat,
+                             ... )
+{
+    va_list xArgs;
+    size_t xSpace = telemetryMAX_MESSAGE_SIZE - *pxLength;
+    int lWritten;
+
+    if( xSpace <= xReserve )
+    {
+        return pdFAIL;
+    }
+
+    va_start( xArgs, pcFormat );
+    lWritten = vsnprintf( pcBuffer + *pxLength, xSpace - xReserve, pcFormat, xArgs );
+    va_end( xArgs );
+
+    if( ( lWritten < 0 ) || ( ( size_t ) lWritten >= xSpace - xReserve ) )
+    {
+        pcBuffer[ *pxLength ] = '\0';
+        return pdFAIL;
+    }
+
+    *pxLength += ( size_t ) lWritten;
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TRACE_FACILITY == 1 ) && ( configGENERATE_RUN_TIME_STATS == 1 )
+
+/**
+ * @brief Share of all cores a task used since the previous report, in
+ * tenths of a percent.
+ */
+    static uint32_t prvCpuShare( const TaskStatus_t * pxTask,
+                                 uint32_t ulTotalDelta )
+    {
+        uint32_t ulPrevious = 0;
+        UBaseType_t x;
+
+        if( ulTotalDelta == 0 )
+        {
+            return 0;
+        }
+
+        for( x = 0; x < uxPreviousTasks; x++ )
+        {
+            if( xPreviousRunTime[ x ].uxTaskNumber == pxTask->xTaskNumber )
+            {
+                ulPrevious = xPreviousRunTime[ x ].ulRunTime;
+                break;
+            }
+        }
+
+        /* The total is wall time; every core adds its own run time. */
+        return ( uint32_t ) ( ( uint64_t ) ( pxTask->ulRunTimeCounter - ulPrevious ) * 1000 /
+                              ( ( uint64_t ) ulTotalDelta * portNUM_PROCESSORS ) );
+    }
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write the per-task part of a report.
+ *
+ * @return Number of tasks left out for lack of room.
+ */
+static UBaseType_t prvAppendTasks( char * pcBuffer,
+                                   size_t * pxLength )
+{
+    UBaseType_t uxOmitted = 0;
+
+    #if ( configUSE_TRACE_FACILITY == 1 )
+        UBaseType_t uxTasks, x;
+        uint32_t ulTotalRunTime = 0;
+        uint32_t ulShare = 0;
+
+        uxTasks = uxTaskGetSystemState( xTaskStatus, telemetryMAX_TASKS, &ulTotalRunTime );
+
+        /* Zero means the snapshot was too small for every task. */
+        if( uxTasks == 0 )
+        {
+            uxOmitted = uxTaskGetNumberOfTasks();
+        }
+
+        ( void ) prvAppend( pcBuffer, pxLength, telemetryTRAILER_SIZE, ",\"tasks\":[" );
+
+        for( x = 0; x < uxTasks; x++ )
+        {
+            #if ( configGENERATE_RUN_TIME_STATS == 1 )
+                ulShare = prvCpuShare( &( xTaskStatus[ x ] ), ulTotalRunTime - ulPreviousTotalRunTime );
+            #endif
+
+            if( prvAppend( pcBuffer, pxLength, telemetryTRAILER_SIZE,
+                           "%s{\"name\":\"%s\",\"stack\":%u,\"cpu\":%u.%u}",
+                           ( x == 0 ) ? "" : ",",
+                           xTaskStatus[ x ].pcTaskName,
+                           ( unsigned ) xTaskStatus[ x ].usStackHighWaterMark,
+                           ( unsigned ) ( ulShare / 10 ),
+                           ( unsigned ) ( ulShare % 10 ) ) != pdPASS )
+            {
+                uxOmitted += uxTasks - x;
+                break;
+            }
+        }
+
+        ( void ) prvAppend( pcBuffer, pxLength, 0, "]" );
+
+        #if ( configGENERATE_RUN_TIME_STATS == 1 )
+            for( x = 0; x < uxTasks; x++ )
+            {
+                xPreviousRunTime[ x ].uxTaskNumber = xTaskStatus[ x ].xTaskNumber;
+                xPreviousRunTime[ x ].ulRunTime = xTaskStatus[ x ].ulRunTimeCounter;
+            }
+
+            uxPreviousTasks = uxTasks;
+            ulPreviousTotalRunTime = ulTotalRunTime;
+        #endif
+    #else /* if ( configUSE_TRACE_FACILITY == 1 ) */
+        ( void ) pcBuffer;
+        ( void ) pxLength;
+    #endif /* if ( configUSE_TRACE_FACILITY == 1 ) */
+
+    return uxOmitted;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTelemetryTask( void * pvParameters )
+{
+    TickType_t xLastWake = xTaskGetTickCount();
+    TickType_t xLastReport = xLastWake;
+    uint32_t ulPublished = 0;
+    uint32_t ulLastPublished = 0;
+    uint32_t ulConnected = 0;
+    uint32_t ulHeldBack = 0;
+    uint32_t ulElapsedMs = 0;
+    UBaseType_t uxOmitted = 0;
+    FanoutMessage_t * pxMessage;
+    size_t xLength;
+
+    ( void ) pvParameters;
+
+    StackBudget_Register( NULL, "telemetryTASK_STACK_SIZE", telemetryTASK_STACK_SIZE );
+
+    for( ; ; )
+    {
+        vTaskDelayUntil( &xLastWake, pdMS_TO_TICKS( telemetryPERIOD_MS ) );
+
+        /* A backed up ring means readings are waiting; a report now
+         * would only add to the delay. */
+        if( SpscRing_Count( pxTelemetryRing ) * 2 > SpscRing_Capacity( pxTelemetryRing ) )
+        {
+            ulHeldBack++;
+            continue;
+        }
+
+        pxMessage = Fanout_Alloc( telemetryTOPIC, telemetryMAX_MESSAGE_SIZE );
+
+        if( pxMessage == NULL )
+        {
+            ulHeldBack++;
+            continue;
+        }
+
+        ulElapsedMs = ( uint32_t ) ( ( xLastWake - xLastReport ) * portTICK_PERIOD_MS );
+        ulPublished = __atomic_load_n( &( ulCounters[ eTelemetryPublished ] ), __ATOMIC_RELAXED );
+        ulConnected = __atomic_load_n( &( ulCounters[ eTelemetryConnected ] ), __ATOMIC_RELAXED );
+        xLength = 0;
+
+        ( void ) prvAppend( pxMessage->cPayload, &xLength, telemetryTRAILER_SIZE,
+                            "{\"uptime\":%lu,"
+                            "\"heap\":{\"free\":%u,\"min\":%u,\"allocs\":%ld},"
+                            "\"queue\":{\"depth\":%u,\"max\":%lu,\"dropped\":%lu},"
+                            "\"mqtt\":{\"published\":%lu,\"per_min\":%lu,\"failed\":%lu,\"reconnects\":%lu,\"received\":%lu}",
+                            ( unsigned long ) ( xLastWake * portTICK_PERIOD_MS / 1000 ),
+                            ( unsigned ) xPortGetFreeHeapSize(),
+                            ( unsigned ) xPortGetMinimumEverFreeHeapSize(),
+                            ( long ) AllocWatch_Count(),
+                            ( unsigned ) SpscRing_Count( pxTelemetryRing ),
+                            ( unsigned long ) __atomic_load_n( &ulQueueHighWater, __ATOMIC_RELAXED ),
+                            ( unsigned long ) __atomic_load_n( &( ulCounters[ eTelemetryDropped ] ), __ATOMIC_RELAXED ),
+                            ( unsigned long ) ulPublished,
+                            ( unsigned long ) ( ( ulElapsedMs > 0 ) ?
+                                                ( uint64_t ) ( ulPublished - ulLastPublished ) * 60000 / ulElapsedMs : 0 ),
+                            ( unsigned long ) __atomic_load_n( &( ulCounters[ eTelemetryPublishFailed ] ), __ATOMIC_RELAXED ),
+                            ( unsigned long ) ( ( ulConnected > 0 ) ? ulConnected - 1 : 0 ),
+                            ( unsigned long ) __atomic_load_n( &( ulCounters[ eTelemetryReceived ] ), __ATOMIC_RELAXED ) );
+
+        uxOmitted = prvAppendTasks( pxMessage->cPayload, &xLength );
+
+        ( void ) prvAppend( pxMessage->cPayload, &xLength, 0,
+                            ",\"omitted\":%u,\"held_back\":%lu}",
+                            ( unsigned ) uxOmitted,
+                            ( unsigned long ) ulHeldBack );
+
+        pxMessage->ulLength = ( uint32_t ) xLength;
+
+        if( Fanout_SendToCloud( pxMessage ) != pdPASS )
+        {
+            configPRINTF( ( "Telemetry: %s\r\n", pxMessage->cPayload ) );
+        }
+
+        Fanout_Release( pxMessage );
+
+        ulLastPublished = ulPublished;
+        xLastReport = xLastWake;
+        ulHeldBack = 0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Telemetry_Start( const SpscRing_t * pxRing )
+{
+    pxTelemetryRing = pxRing;
+
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        static StaticTask_t xTaskBuffer;
+        static StackType_t xTaskStack[ telemetryTASK_STACK_SIZE ];
+
+        return ( xTaskCreateStatic( prvTelemetryTask,
+                                    "Telemetry",
+                                    telemetryTASK_STACK_SIZE,
+                                    NULL,
+                                    telemetryTASK_PRIORITY,
+                                    xTaskStack,
+                                    &xTaskBuffer ) != NULL ) ? pdPASS : pdFAIL;
+    #else
+        return xTaskCreate( prvTelemetryTask,
+                            "Telemetry",
+                            telemetryTASK_STACK_SIZE,
+                            NULL,
+                            telemetryTASK_PRIORITY,
+                            NULL );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void IRAM_ATTR Telemetry_Count( TelemetryCounter_t xCounter )
+{
+    ( void ) __atomic_add_fetch( &( ulCounters[ xCounter ] ), 1, __ATOMIC_RELAXED );
+}
+
+/*-----------------------------------------------------------*/
+
+void Telemetry_NoteQueueDepth( UBaseType_t uxDepth )
+{
+    /* Only the demo task writes the watermark. */
+    if( uxDepth > __atomic_load_n( &ulQueueHighWater, __ATOMIC_RELAXED ) )
+    {
+        __atomic_store_n( &ulQueueHighWater, ( uint32_t ) uxDepth, __ATOMIC_RELAXED );
+    }
+}
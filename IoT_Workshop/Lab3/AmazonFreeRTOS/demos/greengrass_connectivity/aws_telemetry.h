@@ -0,0 +1,135 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_telemetry.h
+ * @brief Periodic report of the device's own resource use.
+ *
+ * A low priority task wakes every telemetryPERIOD_MS. Each time it reads:
+ * - free heap, its low watermark and the allocations counted by
+ *   driver/alloc_watch.h since the first publish (-1 if not counted)
+ * - the stack high watermark and CPU share of every task
+ * - the depth and high watermark of the demo ring
+ * - the publish, failure, reconnect and drop counters kept by the demo
+ *
+ * The report is one JSON message on its own topic, sent through the AWS IoT
+ * Core link of aws_fanout.h so that it never occupies the connection to the
+ * Greengrass core. Reports are capped in size and frequency, and are held
+ * back while the demo ring is backed up, so they never compete with the
+ * readings. A report that cannot be sent is printed on the console instead.
+ */
+
+#ifndef _AWS_TELEMETRY_H_
+#define _AWS_TELEMETRY_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Demo includes. */
+#include "aws_demo_config.h"
+
+#include "driver/spsc_ring.h"
+
+/**
+ * @brief Topic of the reports.
+ */
+#ifndef telemetryTOPIC
+    #define telemetryTOPIC                 "freertos/demos/ggd/telemetry"
+#endif
+
+/**
+ * @brief Time between two reports.
+ */
+#ifndef telemetryPERIOD_MS
+    #define telemetryPERIOD_MS             ( 60000UL )
+#endif
+
+/**
+ * @brief Shortest period allowed, so that reports stay a small fraction of
+ * the traffic whatever the configuration.
+ */
+#define telemetryMIN_PERIOD_MS             ( 10000UL )
+
+#if telemetryPERIOD_MS < telemetryMIN_PERIOD_MS
+    #error "telemetryPERIOD_MS must be at least telemetryMIN_PERIOD_MS."
+#endif
+
+/**
+ * @brief Largest report. Tasks that do not fit are left out and counted.
+ */
+#ifndef telemetryMAX_MESSAGE_SIZE
+    #define telemetryMAX_MESSAGE_SIZE      ( 768 )
+#endif
+
+/**
+ * @brief Tasks reported; also the size of the snapshot taken each period.
+ */
+#ifndef telemetryMAX_TASKS
+    #define telemetryMAX_TASKS             ( 24 )
+#endif
+
+#ifndef telemetryTASK_STACK_SIZE
+    #define telemetryTASK_STACK_SIZE       ( 3072 )
+#endif
+
+#ifndef telemetryTASK_PRIORITY
+    #define telemetryTASK_PRIORITY         ( tskIDLE_PRIORITY + 1 )
+#endif
+
+/**
+ * @brief Events counted by the demo.
+ */
+typedef enum
+{
+    eTelemetryPublished = 0, /**< PUBLISH accepted by the Greengrass core link. */
+    eTelemetryPublishFailed, /**< PUBLISH to the core failed. */
+    eTelemetryConnected,     /**< MQTT connection to a core made. */
+    eTelemetryDropped,       /**< Reading lost because the demo ring was full. */
+    eTelemetryReceived,      /**< PUBLISH received on a demo topic. */
+    eTelemetryCounterCount
+} TelemetryCounter_t;
+
+/**
+ * @brief Start the reporting task.
+ *
+ * @param[in] pxRing The demo ring, whose depth is reported.
+ *
+ * @return pdPASS if the task was created.
+ */
+BaseType_t Telemetry_Start( const SpscRing_t * pxRing );
+
+/**
+ * @brief Count one event. Safe to call from any task or interrupt.
+ */
+void Telemetry_Count( TelemetryCounter_t xCounter );
+
+/**
+ * @brief Note the depth of the demo ring, including the messages just
+ * taken. The demo ring only grows between two pops, so calling this after
+ * every pop gives the exact high watermark.
+ */
+void Telemetry_NoteQueueDepth( UBaseType_t uxDepth );
+
+#endif /* _AWS_TELEMETRY_H_ */
@@ -0,0 +1,250 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_tls_metrics.c
+ * @brief Per endpoint statistics of TLS connection setup time.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "aws_tls_metrics.h"
+
+/* Driver includes. */
+#include "driver/tls_session_cache.h"
+
+/* Demo includes. */
+#include "aws_demo_config.h"
+
+static TLSMetricsEndpoint_t xEndpoints[ tlsmetricsMAX_ENDPOINTS ];
+static size_t xNextEviction = 0;
+static SemaphoreHandle_t xMetricsMutex = NULL;
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the lock held. */
+static TLSMetricsEndpoint_t * prvFindEndpoint( const char * pcHost,
+                                               uint16_t usPort )
+{
+    size_t x;
+
+    for( x = 0; x < tlsmetricsMAX_ENDPOINTS; x++ )
+    {
+        if( ( xEndpoints[ x ].ulAttempts > 0 ) &&
+            ( xEndpoints[ x ].usPort == usPort ) &&
+            ( strncmp( xEndpoints[ x ].cHost, pcHost, tlsmetricsMAX_HOST_LENGTH - 1 ) == 0 ) )
+        {
+            return &( xEndpoints[ x ] );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAddTime( TLSMetricsTimes_t * pxTimes,
+                        uint32_t ulMs )
+{
+    if( ( pxTimes->ulCount == 0 ) || ( ulMs < pxTimes->ulMinMs ) )
+    {
+        pxTimes->ulMinMs = ulMs;
+    }
+
+    if( ulMs > pxTimes->ulMaxMs )
+    {
+        pxTimes->ulMaxMs = ulMs;
+    }
+
+    pxTimes->ulCount++;
+    pxTimes->ulTotalMs += ulMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintTimes( const char * pcKind,
+                           const TLSMetricsTimes_t * pxTimes )
+{
+    if( pxTimes->ulCount > 0 )
+    {
+        configPRINTF( ( "    %s %u: min %u ms, mean %u, max %u.\r\n",
+                        pcKind,
+                        ( unsigned ) pxTimes->ulCount,
+                        ( unsigned ) pxTimes->ulMinMs,
+                        ( unsigned ) ( pxTimes->ulTotalMs / pxTimes->ulCount ),
+                        ( unsigned ) pxTimes->ulMaxMs ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void TLSMetrics_Init( void )
+{
+    #if ( democonfigSTATIC_ALLOCATION == 1 )
+        static StaticSemaphore_t xMetricsMutexBuffer;
+    #endif
+
+    if( xMetricsMutex == NULL )
+    {
+        #if ( democonfigSTATIC_ALLOCATION == 1 )
+            xMetricsMutex = xSemaphoreCreateMutexStatic( &xMetricsMutexBuffer );
+        #else
+            xMetricsMutex = xSemaphoreCreateMutex();
+        #endif
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void TLSMetrics_Record( const char * pcHost,
+                        uint16_t usPort,
+                        BaseType_t xSuccess,
+                        TickType_t xTicks )
+{
+    TLSMetricsEndpoint_t * pxEndpoint;
+    TlsSessionStats_t xSessionStats;
+    BaseType_t xResumed = pdFALSE;
+    uint32_t ulMs = ( uint32_t ) ( xTicks * portTICK_PERIOD_MS );
+
+    /* Read before taking the lock; the handshake has ended by now. */
+    if( ( xSuccess == pdTRUE ) &&
+        ( TlsSessionCache_GetStats( pcHost, usPort, &xSessionStats ) == pdPASS ) )
+    {
+        xResumed = xSessionStats.xLastResumed;
+    }
+
+    if( ( xMetricsMutex == NULL ) ||
+        ( xSemaphoreTake( xMetricsMutex, portMAX_DELAY ) != pdTRUE ) )
+    {
+        return;
+    }
+
+    pxEndpoint = prvFindEndpoint( pcHost, usPort );
+
+    if( pxEndpoint == NULL )
+    {
+        pxEndpoint = &( xEndpoints[ xNextEviction ] );
+        xNextEviction = ( xNextEviction + 1 ) % tlsmetricsMAX_ENDPOINTS;
+
+        memset( pxEndpoint, 0, sizeof( TLSMetricsEndpoint_t ) );
+        strncpy( pxEndpoint->cHost, pcHost, sizeof( pxEndpoint->cHost ) - 1 );
+        pxEndpoint->usPort = usPort;
+    }
+
+    pxEndpoint->ulAttempts++;
+
+    if( xSuccess == pdTRUE )
+    {
+        pxEndpoint->ulLastMs = ulMs;
+        pxEndpoint->xLastResumed = xResumed;
+        prvAddTime( ( xResumed == pdTRUE ) ? &( pxEndpoint->xResumed ) : &( pxEndpoint->xFull ), ulMs );
+    }
+    else
+    {
+        pxEndpoint->ulFailures++;
+    }
+
+    ( void ) xSemaphoreGive( xMetricsMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLSMetrics_Get( const char * pcHost,
+                           uint16_t usPort,
+                           TLSMetricsEndpoint_t * pxEndpoint )
+{
+    const TLSMetricsEndpoint_t * pxFound;
+
+    if( ( xMetricsMutex == NULL ) ||
+        ( xSemaphoreTake( xMetricsMutex, portMAX_DELAY ) != pdTRUE ) )
+    {
+        return pdFAIL;
+    }
+
+    pxFound = prvFindEndpoint( pcHost, usPort );
+
+    if( pxFound != NULL )
+    {
+        *pxEndpoint = *pxFound;
+    }
+
+    ( void ) xSemaphoreGive( xMetricsMutex );
+
+    return ( pxFound != NULL ) ? pdPASS : pdFAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLSMetrics_Print( void )
+{
+    TLSMetricsEndpoint_t xEndpoint;
+    uint32_t ulSuccesses;
+    size_t x;
+
+    for( x = 0; x < tlsmetricsMAX_ENDPOINTS; x++ )
+    {
+        /* Copy under the lock, print outside it. */
+        if( ( xMetricsMutex == NULL ) ||
+            ( xSemaphoreTake( xMetricsMutex, portMAX_DELAY ) != pdTRUE ) )
+        {
+            return;
+        }
+
+        xEndpoint = xEndpoints[ x ];
+        ( void ) xSemaphoreGive( xMetricsMutex );
+
+        if( xEndpoint.ulAttempts == 0 )
+        {
+            continue;
+        }
+
+        ulSuccesses = xEndpoint.ulAttempts - xEndpoint.ulFailures;
+
+        if( ulSuccesses > 0 )
+        {
+            configPRINTF( ( "TLS %s:%u: %u/%u ok, last %u ms %s.\r\n",
+                            xEndpoint.cHost,
+                            xEndpoint.usPort,
+                            ( unsigned ) ulSuccesses,
+                            ( unsigned ) xEndpoint.ulAttempts,
+                            ( unsigned ) xEndpoint.ulLastMs,
+                            ( xEndpoint.xLastResumed == pdTRUE ) ? "resumed" : "full" ) );
+            prvPrintTimes( "full", &( xEndpoint.xFull ) );
+            prvPrintTimes( "resumed", &( xEndpoint.xResumed ) );
+        }
+        else
+        {
+            configPRINTF( ( "TLS %s:%u: 0/%u ok.\r\n",
+                            xEndpoint.cHost,
+                            xEndpoint.usPort,
+                            ( unsigned ) xEndpoint.ulAttempts ) );
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_tls_metrics.h
+ * @brief Per endpoint statistics of TLS connection setup time.
+ *
+ * Every full TLS handshake costs the ESP32 hundreds of milliseconds of
+ * public key arithmetic. These counters make that cost visible per endpoint,
+ * with the setups that resumed a TLS session (driver/tls_session_cache.h)
+ * counted apart from those that did the full handshake, so that reconnect
+ * behaviour can be measured on the device.
+ */
+
+#ifndef _AWS_TLS_METRICS_H_
+#define _AWS_TLS_METRICS_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Number of endpoints tracked. The oldest entry is reused when full.
+ */
+#ifndef tlsmetricsMAX_ENDPOINTS
+    #define tlsmetricsMAX_ENDPOINTS          ( 8 )
+#endif
+
+/**
+ * @brief Longest host name tracked, including the NUL terminator.
+ */
+#ifndef tlsmetricsMAX_HOST_LENGTH
+    #define tlsmetricsMAX_HOST_LENGTH        ( 64 )
+#endif
+
+/**
+ * @brief Durations of one kind of successful setup.
+ */
+typedef struct TLSMetricsTimes
+{
+    uint32_t ulCount;
+    uint32_t ulMinMs;
+    uint32_t ulMaxMs;
+    uint32_t ulTotalMs; /**< Sum, for the mean. */
+} TLSMetricsTimes_t;
+
+/**
+ * @brief Connection setup statistics of one endpoint.
+ */
+typedef struct TLSMetricsEndpoint
+{
+    char cHost[ tlsmetricsMAX_HOST_LENGTH ];
+    uint16_t usPort;
+    uint32_t ulAttempts;
+    uint32_t ulFailures;
+    uint32_t ulLastMs;          /**< Duration of the last successful setup. */
+    BaseType_t xLastResumed;    /**< pdTRUE if it resumed a TLS session. */
+    TLSMetricsTimes_t xFull;    /**< Setups with a full handshake. */
+    TLSMetricsTimes_t xResumed; /**< Setups that resumed a session. */
+} TLSMetricsEndpoint_t;
+
+/**
+ * @brief Create the lock protecting the statistics. Call once before any
+ * task that records them is started.
+ */
+void TLSMetrics_Init( void );
+
+/**
+ * @brief Account one connection attempt.
+ *
+ * @param[in] pcHost Host name or address of the endpoint.
+ * @param[in] usPort Port of the endpoint.
+ * @param[in] xSuccess pdTRUE if the handshake completed.
+ * @param[in] xTicks Time the connection setup took.
+ *
+ * Whether a successful setup resumed a session is taken from the session
+ * cache, which keeps the endpoint under the same host and port when the
+ * host is the name sent in the handshake, or the address when none is.
+ */
+void TLSMetrics_Record( const char * pcHost,
+                        uint16_t usPort,
+                        BaseType_t xSuccess,
+                        TickType_t xTicks );
+
+/**
+ * @brief Copy the statistics of one endpoint.
+ *
+ * @return pdPASS if the endpoint is tracked.
+ */
+BaseType_t TLSMetrics_Get( const char * pcHost,
+                           uint16_t usPort,
+                           TLSMetricsEndpoint_t * pxEndpoint );
+
+/**
+ * @brief Print the statistics of every tracked endpoint.
+ */
+void TLSMetrics_Print( void );
+
+#endif /* _AWS_TLS_METRICS_H_ */
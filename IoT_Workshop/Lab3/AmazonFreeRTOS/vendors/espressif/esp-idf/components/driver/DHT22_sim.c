@@ -0,0 +1,129 @@
+/*------------------------------------------------------------------------------
+
+	Simulated DHT22 (AM2302) for running the demos without the sensor,
+	on a bare devkit or in a host build.
+
+	Implements the API of DHT22.h without touching any GPIO. Every readDHT()
+	is one sample of a slow daily-like swing plus a little noise, quantized to
+	the 0.1 resolution of the real sensor. The sequence only depends on the
+	seed, so two runs with the same seed produce the same readings.
+
+	Build with DHT22_SIMULATED set (see CMakeLists.txt) to use this file in
+	place of DHT22.c.
+
+---------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "driver/DHT22.h"
+
+// == simulation parameters ======================================
+
+#ifndef DHT_SIM_PERIOD
+	#define DHT_SIM_PERIOD			1200	// samples per full swing
+#endif
+
+#ifndef DHT_SIM_ERROR_PERIOD
+	#define DHT_SIM_ERROR_PERIOD	0		// every Nth read times out, 0 = never
+#endif
+
+#define DHT_SIM_PI					3.14159265f
+
+int DHTgpio = 4;
+float humidity = 0.;
+float temperature = 0.;
+
+static uint32_t simState = 0x2545F491;	// xorshift32 state, never 0
+static uint32_t simSample = 0;
+
+// == set the DHT used pin=========================================
+
+void setDHTgpio( int gpio )
+{
+	DHTgpio = gpio;
+}
+
+void setDHTsimSeed( unsigned int seed )
+{
+	simState = ( seed != 0 ) ? seed : 0x2545F491;
+	simSample = 0;
+}
+
+// == get temp & hum =============================================
+
+float getHumidity() { return humidity; }
+float getTemperature() { return temperature; }
+
+// == error handler ===============================================
+
+void errorHandler(int response)
+{
+	switch(response) {
+
+		case DHT_TIMEOUT_ERROR :
+			printf( "DHT: Sensor Timeout\n" );
+			break;
+
+		case DHT_CHECKSUM_ERROR:
+			printf( "DHT: CheckSum error\n" );
+			break;
+
+		case DHT_OK:
+			break;
+
+		default :
+			printf( "DHT: Unknown error\n" );
+	}
+}
+
+// == no line to sample ===========================================
+
+int getSignalLevel( int usTimeOut, bool state )
+{
+	(void) usTimeOut;
+	(void) state;
+
+	return -1;
+}
+
+// == noise in [-0.5, 0.5) =======================================
+
+static float simNoise()
+{
+	simState ^= simState << 13;
+	simState ^= simState >> 17;
+	simState ^= simState << 5;
+
+	return (float)( simState >> 8 ) / (float)( 1UL << 24 ) - 0.5f;
+}
+
+// == read simulated sensor =======================================
+
+int readDHT()
+{
+float phase;
+int rawHum, rawTemp;
+
+	simSample++;
+
+	#if DHT_SIM_ERROR_PERIOD > 0
+		if( simSample % DHT_SIM_ERROR_PERIOD == 0 ) {
+			return DHT_TIMEOUT_ERROR;		// values keep the last reading
+		}
+	#endif
+
+	phase = 2.0f * DHT_SIM_PI * (float)( simSample % DHT_SIM_PERIOD ) / DHT_SIM_PERIOD;
+
+	// warmest when driest, as indoors
+	rawTemp = (int) lroundf( 10.0f * ( 22.0f + 3.0f * sinf( phase ) + 0.4f * simNoise() ) );
+	rawHum  = (int) lroundf( 10.0f * ( 45.0f - 8.0f * sinf( phase ) + 1.0f * simNoise() ) );
+
+	// same 0.1 resolution as the 16 bit words of the real sensor
+	humidity = rawHum / 10.0f;
+	temperature = rawTemp / 10.0f;
+
+	return DHT_OK;
+}
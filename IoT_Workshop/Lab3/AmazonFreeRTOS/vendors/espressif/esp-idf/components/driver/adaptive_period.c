@@ -0,0 +1,144 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file adaptive_period.c
+ * @brief Controller of the sampling period.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "driver/adaptive_period.h"
+
+/* The period grows by 1 / adaptiveperiodGROWTH of itself at a time. */
+#define adaptiveperiodGROWTH        ( 4 )
+
+/* The period shrinks by this factor at most at a time. */
+#define adaptiveperiodMAX_SHRINK    ( 4 )
+
+/* Periods are rounded to this many ms. */
+#define adaptiveperiodROUNDING_MS   ( 100 )
+
+/*-----------------------------------------------------------*/
+
+bool AdaptivePeriod_Init( AdaptivePeriod_t * pxController,
+                          const AdaptivePeriodConfig_t * pxConfig )
+{
+    size_t i;
+
+    if( ( pxConfig->uxChannels == 0 ) ||
+        ( pxConfig->uxChannels > adaptiveperiodMAX_CHANNELS ) ||
+        ( pxConfig->ulMinMs == 0 ) ||
+        ( pxConfig->ulMinMs > pxConfig->ulMaxMs ) )
+    {
+        return false;
+    }
+
+    for( i = 0; i < pxConfig->uxChannels; i++ )
+    {
+        if( pxConfig->lStep[ i ] <= 0 )
+        {
+            return false;
+        }
+    }
+
+    ( void ) memset( pxController, 0x00, sizeof( *pxController ) );
+    pxController->xConfig = *pxConfig;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t AdaptivePeriod_Next( AdaptivePeriod_t * pxController,
+                              uint32_t ulPeriodMs,
+                              const int32_t * plValues )
+{
+    const AdaptivePeriodConfig_t * pxConfig = &( pxController->xConfig );
+    uint64_t ullNext = ulPeriodMs, ullCandidate;
+    uint32_t ulMove;
+    bool xSteady = true;
+    size_t i;
+
+    for( i = 0; ( i < pxConfig->uxChannels ) && ( pxController->xHaveLast == true ); i++ )
+    {
+        ulMove = ( plValues[ i ] >= pxController->lLast[ i ] ) ?
+                 ( uint32_t ) plValues[ i ] - ( uint32_t ) pxController->lLast[ i ] :
+                 ( uint32_t ) pxController->lLast[ i ] - ( uint32_t ) plValues[ i ];
+
+        /* At the same rate, this period would move the channel by a step. */
+        if( ulMove > ( uint32_t ) pxConfig->lStep[ i ] )
+        {
+            ullCandidate = ( ( uint64_t ) ulPeriodMs * ( uint64_t ) pxConfig->lStep[ i ] ) / ulMove;
+
+            if( ullCandidate < ullNext )
+            {
+                ullNext = ullCandidate;
+            }
+        }
+
+        if( ( ( uint64_t ) ulMove * 2 ) >= ( uint64_t ) pxConfig->lStep[ i ] )
+        {
+            xSteady = false;
+        }
+    }
+
+    if( ullNext < ulPeriodMs )
+    {
+        if( ullNext < ( ulPeriodMs / adaptiveperiodMAX_SHRINK ) )
+        {
+            ullNext = ulPeriodMs / adaptiveperiodMAX_SHRINK;
+        }
+    }
+    else if( ( xSteady == true ) && ( pxController->xHaveLast == true ) )
+    {
+        ullNext = ( uint64_t ) ulPeriodMs + ( ulPeriodMs / adaptiveperiodGROWTH );
+    }
+
+    for( i = 0; i < pxConfig->uxChannels; i++ )
+    {
+        pxController->lLast[ i ] = plValues[ i ];
+    }
+
+    pxController->xHaveLast = true;
+
+    /* A period set by other means is kept as it is, if within bounds. */
+    if( ullNext != ulPeriodMs )
+    {
+        ullNext = ( ( ullNext + ( adaptiveperiodROUNDING_MS / 2 ) ) / adaptiveperiodROUNDING_MS ) * adaptiveperiodROUNDING_MS;
+    }
+
+    if( ullNext < pxConfig->ulMinMs )
+    {
+        ullNext = pxConfig->ulMinMs;
+    }
+    else if( ullNext > pxConfig->ulMaxMs )
+    {
+        ullNext = pxConfig->ulMaxMs;
+    }
+
+    return ( uint32_t ) ullNext;
+}
@@ -0,0 +1,764 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file dlog.c
+ * @brief Deferred logging: printf-style calls that only copy their
+ * arguments.
+ */
+
+#include "driver/dlog.h"
+
+#if ( dlogENABLED == 1 )
+
+/* Standard includes. */
+    #include <stdarg.h>
+    #include <stdbool.h>
+    #include <stddef.h>
+    #include <stdio.h>
+    #include <string.h>
+
+/* FreeRTOS includes. */
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+
+    #include "esp_timer.h"
+
+    #if ( dlogBUFFER_SIZE & ( dlogBUFFER_SIZE - 1 ) ) != 0
+        #error "dlogBUFFER_SIZE must be a power of two."
+    #endif
+
+    #if ( dlogBUFFER_SIZE > 65536 ) || ( dlogMAX_RECORD_SIZE > dlogBUFFER_SIZE / 2 )
+        #error "dlogBUFFER_SIZE must be at most 64 KB and twice dlogMAX_RECORD_SIZE."
+    #endif
+
+/**
+ * @brief Bytes of the header, timestamp and format address.
+ */
+    #define dlogRECORD_PREFIX_SIZE    ( 12 )
+
+/**
+ * @brief Longest formatted line.
+ */
+    #define dlogMAX_LINE_LENGTH       ( 2 * dlogMAX_RECORD_SIZE )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief How an argument is stored.
+ */
+    typedef enum
+    {
+        eDLogArgNone,     /**< %% */
+        eDLogArgInt,      /**< int and smaller, 4 bytes. */
+        eDLogArgLong,     /**< long, size_t, ptrdiff_t, 4 bytes on the ESP32. */
+        eDLogArgLongLong, /**< long long and intmax_t, 8 bytes. */
+        eDLogArgDouble,   /**< Any floating point, as an 8-byte double. */
+        eDLogArgString,   /**< Length and bytes. */
+        eDLogArgPointer   /**< 4 bytes. */
+    } DLogArg_t;
+
+/**
+ * @brief One conversion of a format string.
+ */
+    typedef struct DLogConversion
+    {
+        const char * pcStart;   /**< The '%'. */
+        size_t xLength;         /**< Up to and including the conversion character. */
+        uint8_t ucStars;        /**< '*' width and precision, each an int argument. */
+        char cModifier;         /**< 'H' for hh, 'h', 'l', 'q' for ll, 'j', 'z', 't', 'L' or 0. */
+        char cConversion;
+        DLogArg_t xArg;
+    } DLogConversion_t;
+
+    static uint32_t ulRing[ dlogBUFFER_SIZE / sizeof( uint32_t ) ];
+    static uint32_t ulHead = 0; /**< Bytes reserved by writers, free running. */
+    static uint32_t ulTail = 0; /**< Bytes released by the drain task, free running. */
+    static uint32_t ulLost = 0;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse the conversion that starts at pcFormat[ 0 ] == '%'.
+ */
+    static void prvParseConversion( const char * pcFormat,
+                                    DLogConversion_t * pxConversion )
+    {
+        const char * pc = pcFormat + 1;
+
+        memset( pxConversion, 0x00, sizeof( DLogConversion_t ) );
+        pxConversion->pcStart = pcFormat;
+
+        while( ( *pc != '\0' ) && ( strchr( "-+ #0", *pc ) != NULL ) )
+        {
+            pc++;
+        }
+
+        /* Width, then precision. */
+        if( *pc == '*' )
+        {
+            pxConversion->ucStars++;
+            pc++;
+        }
+
+        while( ( *pc >= '0' ) && ( *pc <= '9' ) )
+        {
+            pc++;
+        }
+
+        if( *pc == '.' )
+        {
+            pc++;
+
+            if( *pc == '*' )
+            {
+                pxConversion->ucStars++;
+                pc++;
+            }
+
+            while( ( *pc >= '0' ) && ( *pc <= '9' ) )
+            {
+                pc++;
+            }
+        }
+
+        if( ( ( pc[ 0 ] == 'h' ) && ( pc[ 1 ] == 'h' ) ) || ( ( pc[ 0 ] == 'l' ) && ( pc[ 1 ] == 'l' ) ) )
+        {
+            pxConversion->cModifier = ( pc[ 0 ] == 'h' ) ? 'H' : 'q';
+            pc += 2;
+        }
+        else if( ( *pc != '\0' ) && ( strchr( "hljztL", *pc ) != NULL ) )
+        {
+            pxConversion->cModifier = *pc++;
+        }
+
+        pxConversion->cConversion = *pc;
+
+        switch( *pc )
+        {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            case 'c':
+
+                if( ( pxConversion->cModifier == 'q' ) || ( pxConversion->cModifier == 'j' ) )
+                {
+                    pxConversion->xArg = eDLogArgLongLong;
+                }
+                else if( ( pxConversion->cModifier == 'l' ) || ( pxConversion->cModifier == 'z' ) ||
+                         ( pxConversion->cModifier == 't' ) )
+                {
+                    pxConversion->xArg = eDLogArgLong;
+                }
+                else
+                {
+                    pxConversion->xArg = eDLogArgInt;
+                }
+
+                break;
+
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                pxConversion->xArg = eDLogArgDouble;
+                break;
+
+            case 's':
+                pxConversion->xArg = eDLogArgString;
+                break;
+
+            case 'p':
+                pxConversion->xArg = eDLogArgPointer;
+                break;
+
+            default:
+                /* %%, and anything unsupported, which is printed as is. */
+                pxConversion->xArg = eDLogArgNone;
+                pxConversion->ucStars = 0;
+                break;
+        }
+
+        pxConversion->xLength = ( size_t ) ( pc - pcFormat ) + ( ( *pc != '\0' ) ? 1 : 0 );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append xSize bytes to a record being built.
+ *
+ * @return false if the record is full.
+ */
+    static bool prvPut( uint8_t * pucRecord,
+                        size_t * pxLength,
+                        const void * pvData,
+                        size_t xSize )
+    {
+        if( *pxLength + xSize > dlogMAX_RECORD_SIZE )
+        {
+            return false;
+        }
+
+        memcpy( pucRecord + *pxLength, pvData, xSize );
+        *pxLength += xSize;
+
+        return true;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reserve room for a record and copy it in.
+ */
+    static void prvCommit( const uint32_t * pulRecord,
+                           uint32_t ulLength )
+    {
+        uint32_t ulHeadNow, ulTailNow, ulOffset, ulPad, ulNeed;
+        uint32_t * pulSlot;
+
+        ulHeadNow = __atomic_load_n( &ulHead, __ATOMIC_RELAXED );
+
+        do
+        {
+            ulTailNow = __atomic_load_n( &ulTail, __ATOMIC_ACQUIRE );
+            ulOffset = ulHeadNow & ( dlogBUFFER_SIZE - 1 );
+
+            /* Records never wrap; the end of the ring is padded instead. */
+            ulPad = ( dlogBUFFER_SIZE - ulOffset < ulLength ) ? dlogBUFFER_SIZE - ulOffset : 0;
+            ulNeed = ulPad + ulLength;
+
+            if( ulHeadNow + ulNeed - ulTailNow > dlogBUFFER_SIZE )
+            {
+                ( void ) __atomic_add_fetch( &ulLost, 1, __ATOMIC_RELAXED );
+
+                return;
+            }
+        } while( __atomic_compare_exchange_n( &ulHead, &ulHeadNow, ulHeadNow + ulNeed,
+                                              true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) == false );
+
+        if( ulPad > 0 )
+        {
+            __atomic_store_n( &( ulRing[ ulOffset / 4 ] ),
+                              ulPad | ( ( uint32_t ) dlogRECORD_PADDING << 16 ),
+                              __ATOMIC_RELEASE );
+            ulOffset = 0;
+        }
+
+        /* The header goes in last: a non-zero header marks a complete
+         * record to the drain task. */
+        pulSlot = &( ulRing[ ulOffset / 4 ] );
+        memcpy( pulSlot + 1, pulRecord + 1, ulLength - 4 );
+        __atomic_store_n( pulSlot, pulRecord[ 0 ], __ATOMIC_RELEASE );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void DLog_Printf( const char * pcFormat,
+                      ... )
+    {
+        uint32_t ulRecord[ dlogMAX_RECORD_SIZE / sizeof( uint32_t ) ];
+        uint8_t * pucRecord = ( uint8_t * ) ulRecord;
+        size_t xLength = dlogRECORD_PREFIX_SIZE;
+        DLogConversion_t xConversion;
+        const char * pc = pcFormat;
+        const char * pcString;
+        size_t xStringLength;
+        int32_t lPrecision = -1;
+        int32_t lValue;
+        uint32_t ulValue;
+        long long llValue;
+        double dValue;
+        uint16_t usStringLength;
+        uint8_t ucStar;
+        bool xFits = true;
+        va_list xArgs;
+
+        ulRecord[ 1 ] = ( uint32_t ) esp_timer_get_time();
+        ulRecord[ 2 ] = ( uint32_t ) ( uintptr_t ) pcFormat;
+
+        va_start( xArgs, pcFormat );
+
+        while( ( xFits == true ) && ( ( pc = strchr( pc, '%' ) ) != NULL ) )
+        {
+            prvParseConversion( pc, &xConversion );
+            pc += xConversion.xLength;
+            lPrecision = -1;
+
+            for( ucStar = 0; ucStar < xConversion.ucStars; ucStar++ )
+            {
+                lValue = ( int32_t ) va_arg( xArgs, int );
+                lPrecision = lValue;
+                xFits = xFits && prvPut( pucRecord, &xLength, &lValue, sizeof( lValue ) );
+            }
+
+            switch( xConversion.xArg )
+            {
+                case eDLogArgInt:
+                    ulValue = ( uint32_t ) va_arg( xArgs, int );
+                    xFits = xFits && prvPut( pucRecord, &xLength, &ulValue, sizeof( ulValue ) );
+                    break;
+
+                case eDLogArgLong:
+
+                    if( xConversion.cModifier == 'z' )
+                    {
+                        ulValue = ( uint32_t ) va_arg( xArgs, size_t );
+                    }
+                    else if( xConversion.cModifier == 't' )
+                    {
+                        ulValue = ( uint32_t ) va_arg( xArgs, ptrdiff_t );
+                    }
+                    else
+                    {
+                        ulValue = ( uint32_t ) va_arg( xArgs, long );
+                    }
+
+                    xFits = xFits && prvPut( pucRecord, &xLength, &ulValue, sizeof( ulValue ) );
+                    break;
+
+                case eDLogArgLongLong:
+                    llValue = ( xConversion.cModifier == 'j' ) ? ( long long ) va_arg( xArgs, intmax_t ) :
+                              va_arg( xArgs, long long );
+                    xFits = xFits && prvPut( pucRecord, &xLength, &llValue, sizeof( llValue ) );
+                    break;
+
+                case eDLogArgDouble:
+                    dValue = ( xConversion.cModifier == 'L' ) ? ( double ) va_arg( xArgs, long double ) :
+                             va_arg( xArgs, double );
+                    xFits = xFits && prvPut( pucRecord, &xLength, &dValue, sizeof( dValue ) );
+                    break;
+
+                case eDLogArgPointer:
+                    ulValue = ( uint32_t ) ( uintptr_t ) va_arg( xArgs, void * );
+                    xFits = xFits && prvPut( pucRecord, &xLength, &ulValue, sizeof( ulValue ) );
+                    break;
+
+                case eDLogArgString:
+                    pcString = va_arg( xArgs, const char * );
+
+                    if( pcString == NULL )
+                    {
+                        pcString = "(null)";
+                    }
+
+                    /* Only a precision bounds a string that need not be
+                     * terminated, as with %.*s. */
+                    if( lPrecision < 0 )
+                    {
+                        for( xStringLength = 0;
+                             ( xStringLength < dlogMAX_STRING_LENGTH ) && ( pcString[ xStringLength ] != '\0' );
+                             xStringLength++ )
+                        {
+                        }
+                    }
+                    else
+                    {
+                        for( xStringLength = 0;
+                             ( xStringLength < ( size_t ) lPrecision ) &&
+                             ( xStringLength < dlogMAX_STRING_LENGTH ) && ( pcString[ xStringLength ] != '\0' );
+                             xStringLength++ )
+                        {
+                        }
+                    }
+
+                    usStringLength = ( uint16_t ) xStringLength;
+                    xFits = xFits &&
+                            prvPut( pucRecord, &xLength, &usStringLength, sizeof( usStringLength ) ) &&
+                            prvPut( pucRecord, &xLength, pcString, xStringLength );
+
+                    /* Keep the next argument aligned. */
+                    while( ( xFits == true ) && ( ( xLength & 3 ) != 0 ) )
+                    {
+                        pucRecord[ xLength++ ] = 0;
+                    }
+
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        va_end( xArgs );
+
+        /* A record cut short keeps the arguments that fit; the rest of
+         * the line is marked when it is formatted. */
+        xLength = ( xLength + 3 ) & ~( ( size_t ) 3 );
+
+        if( xLength > dlogMAX_RECORD_SIZE )
+        {
+            xLength = dlogMAX_RECORD_SIZE;
+        }
+
+        ulRecord[ 0 ] = ( uint32_t ) xLength | ( ( uint32_t ) dlogRECORD_MESSAGE << 16 );
+
+        prvCommit( ulRecord, ( uint32_t ) xLength );
+    }
+
+/*-----------------------------------------------------------*/
+
+    #if ( dlogRAW_OUTPUT == 0 )
+
+/**
+ * @brief Take xSize bytes of a record being formatted.
+ *
+ * @return NULL once the record is exhausted.
+ */
+        static const uint8_t * prvTake( const uint8_t * pucRecord,
+                                        size_t xLength,
+                                        size_t * pxOffset,
+                                        size_t xSize )
+        {
+            const uint8_t * pucData = pucRecord + *pxOffset;
+
+            if( *pxOffset + xSize > xLength )
+            {
+                return NULL;
+            }
+
+            *pxOffset += xSize;
+
+            return pucData;
+        }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Format one record.
+ */
+        static void prvFormat( const uint8_t * pucRecord,
+                               size_t xLength,
+                               char * pcLine,
+                               size_t xLineSize )
+        {
+            const char * pcFormat = ( const char * ) ( uintptr_t ) ( ( const uint32_t * ) pucRecord )[ 2 ];
+            const char * pc = pcFormat;
+            const char * pcPercent;
+            const uint8_t * pucArg;
+            DLogConversion_t xConversion;
+            char cSpec[ 24 ];
+            char cString[ dlogMAX_STRING_LENGTH + 1 ];
+            size_t xOffset = dlogRECORD_PREFIX_SIZE;
+            size_t xOut = 0;
+            size_t xSpecLength;
+            size_t xSize;
+            int32_t lStars[ 2 ] = { 0 };
+            uint16_t usStringLength;
+            uint32_t ulValue;
+            long long llValue;
+            double dValue;
+            uint8_t ucStar;
+            int lWritten = 0;
+            bool xComplete = true;
+
+            while( ( xOut < xLineSize - 1 ) && ( *pc != '\0' ) )
+            {
+                pcPercent = strchr( pc, '%' );
+                xSize = ( pcPercent == NULL ) ? strlen( pc ) : ( size_t ) ( pcPercent - pc );
+
+                if( xSize > xLineSize - 1 - xOut )
+                {
+                    xSize = xLineSize - 1 - xOut;
+                }
+
+                memcpy( pcLine + xOut, pc, xSize );
+                xOut += xSize;
+
+                if( pcPercent == NULL )
+                {
+                    break;
+                }
+
+                prvParseConversion( pcPercent, &xConversion );
+                pc = pcPercent + xConversion.xLength;
+
+                if( xConversion.xArg == eDLogArgNone )
+                {
+                    pcLine[ xOut++ ] = ( xConversion.cConversion == '%' ) ? '%' : '?';
+                    continue;
+                }
+
+                for( ucStar = 0; ( ucStar < xConversion.ucStars ) && ( xComplete == true ); ucStar++ )
+                {
+                    pucArg = prvTake( pucRecord, xLength, &xOffset, sizeof( int32_t ) );
+                    xComplete = ( pucArg != NULL );
+
+                    if( xComplete == true )
+                    {
+                        memcpy( &( lStars[ ucStar ] ), pucArg, sizeof( int32_t ) );
+                    }
+                }
+
+                /* Rebuild the conversion with the length modifier matching
+                 * the stored argument. */
+                xSpecLength = xConversion.xLength - 1;
+
+                while( ( xSpecLength > 1 ) &&
+                       ( strchr( "hljztL", xConversion.pcStart[ xSpecLength - 1 ] ) != NULL ) )
+                {
+                    xSpecLength--;
+                }
+
+                if( xSpecLength > sizeof( cSpec ) - 4 )
+                {
+                    xComplete = false;
+                }
+
+                if( xComplete == true )
+                {
+                    memcpy( cSpec, xConversion.pcStart, xSpecLength );
+
+                    if( xConversion.xArg == eDLogArgLong )
+                    {
+                        cSpec[ xSpecLength++ ] = 'l';
+                    }
+                    else if( xConversion.xArg == eDLogArgLongLong )
+                    {
+                        cSpec[ xSpecLength++ ] = 'l';
+                        cSpec[ xSpecLength++ ] = 'l';
+                    }
+
+                    cSpec[ xSpecLength++ ] = xConversion.cConversion;
+                    cSpec[ xSpecLength ] = '\0';
+
+                    pucArg = prvTake( pucRecord, xLength, &xOffset,
+                                      ( ( xConversion.xArg == eDLogArgLongLong ) ||
+                                        ( xConversion.xArg == eDLogArgDouble ) ) ? 8 :
+                                      ( xConversion.xArg == eDLogArgString ) ? 2 : 4 );
+                    xComplete = ( pucArg != NULL );
+                }
+
+                if( xComplete == false )
+                {
+                    break;
+                }
+
+                #define dlogFORMAT_ARG( xValue )                                                                    \
+    ( ( xConversion.ucStars == 2 ) ? snprintf( pcLine + xOut, xLineSize - xOut, cSpec, lStars[ 0 ], lStars[ 1 ], xValue ) : \
+      ( xConversion.ucStars == 1 ) ? snprintf( pcLine + xOut, xLineSize - xOut, cSpec, lStars[ 0 ], xValue ) :              \
+      snprintf( pcLine + xOut, xLineSize - xOut, cSpec, xValue ) )
+
+                switch( xConversion.xArg )
+                {
+                    case eDLogArgInt:
+                        memcpy( &ulValue, pucArg, sizeof( ulValue ) );
+                        lWritten = dlogFORMAT_ARG( ( int ) ulValue );
+                        break;
+
+                    case eDLogArgLong:
+                        memcpy( &ulValue, pucArg, sizeof( ulValue ) );
+
+                        if( ( xConversion.cConversion == 'd' ) || ( xConversion.cConversion == 'i' ) )
+                        {
+                            lWritten = dlogFORMAT_ARG( ( long ) ( int32_t ) ulValue );
+                        }
+                        else
+                        {
+                            lWritten = dlogFORMAT_ARG( ( unsigned long ) ulValue );
+                        }
+
+                        break;
+
+                    case eDLogArgLongLong:
+                        memcpy( &llValue, pucArg, sizeof( llValue ) );
+                        lWritten = dlogFORMAT_ARG( llValue );
+                        break;
+
+                    case eDLogArgDouble:
+                        memcpy( &dValue, pucArg, sizeof( dValue ) );
+                        lWritten = dlogFORMAT_ARG( dValue );
+                        break;
+
+                    case eDLogArgPointer:
+                        memcpy( &ulValue, pucArg, sizeof( ulValue ) );
+                        lWritten = dlogFORMAT_ARG( ( void * ) ( uintptr_t ) ulValue );
+                        break;
+
+                    case eDLogArgString:
+                    default:
+                        memcpy( &usStringLength, pucArg, sizeof( usStringLength ) );
+                        pucArg = ( usStringLength <= dlogMAX_STRING_LENGTH ) ?
+                                 prvTake( pucRecord, xLength, &xOffset, ( ( usStringLength + 2U + 3U ) & ~3U ) - 2U ) :
+                                 NULL;
+
+                        if( pucArg == NULL )
+                        {
+                            xComplete = false;
+                            break;
+                        }
+
+                        memcpy( cString, pucArg, usStringLength );
+                        cString[ usStringLength ] = '\0';
+                        lWritten = dlogFORMAT_ARG( cString );
+                        break;
+                }
+
+                #undef dlogFORMAT_ARG
+
+                if( xComplete == false )
+                {
+                    break;
+                }
+
+                if( lWritten > 0 )
+                {
+                    xOut += ( ( size_t ) lWritten < xLineSize - xOut ) ? ( size_t ) lWritten : xLineSize - 1 - xOut;
+                }
+            }
+
+            if( xComplete == false )
+            {
+                lWritten = snprintf( pcLine + xOut, xLineSize - xOut, "<truncated>\n" );
+                xOut += ( lWritten > 0 ) ? ( size_t ) lWritten : 0;
+            }
+
+            pcLine[ ( xOut < xLineSize ) ? xOut : xLineSize - 1 ] = '\0';
+        }
+
+    #endif /* if ( dlogRAW_OUTPUT == 0 ) */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write one record to the console.
+ */
+    static void prvOutput( const uint8_t * pucRecord,
+                           size_t xLength )
+    {
+        #if ( dlogRAW_OUTPUT == 1 )
+            static const char cHex[] = "0123456789abcdef";
+            static char cLine[ 5 + 2 * dlogMAX_RECORD_SIZE + 2 ];
+            size_t x, xOut = 0;
+
+            memcpy( cLine, "DLOG ", 5 );
+            xOut = 5;
+
+            for( x = 0; x < xLength; x++ )
+            {
+                cLine[ xOut++ ] = cHex[ pucRecord[ x ] >> 4 ];
+                cLine[ xOut++ ] = cHex[ pucRecord[ x ] & 0x0F ];
+            }
+
+            cLine[ xOut++ ] = '\n';
+            cLine[ xOut ] = '\0';
+        #else
+            static char cLine[ dlogMAX_LINE_LENGTH ];
+
+            prvFormat( pucRecord, xLength, cLine, sizeof( cLine ) );
+        #endif
+
+        fputs( cLine, stdout );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvDrainTask( void * pvParameters )
+    {
+        uint32_t ulTailNow = __atomic_load_n( &ulTail, __ATOMIC_RELAXED );
+        uint32_t ulHeader, ulLength, ulOffset;
+        uint32_t ulLostReported = 0, ulLostNow;
+
+        ( void ) pvParameters;
+
+        for( ; ; )
+        {
+            while( ulTailNow != __atomic_load_n( &ulHead, __ATOMIC_ACQUIRE ) )
+            {
+                ulOffset = ulTailNow & ( dlogBUFFER_SIZE - 1 );
+                ulHeader = __atomic_load_n( &( ulRing[ ulOffset / 4 ] ), __ATOMIC_ACQUIRE );
+
+                /* Reserved but still being written. */
+                if( ulHeader == 0 )
+                {
+                    break;
+                }
+
+                ulLength = ulHeader & 0xFFFF;
+
+                if( ( ulHeader >> 16 ) == dlogRECORD_MESSAGE )
+                {
+                    prvOutput( ( const uint8_t * ) &( ulRing[ ulOffset / 4 ] ), ulLength );
+                }
+
+                /* Writers rely on free space reading as zero, so that a
+                 * stale word is never taken for a header. */
+                memset( &( ulRing[ ulOffset / 4 ] ), 0x00, ulLength );
+                ulTailNow += ulLength;
+                __atomic_store_n( &ulTail, ulTailNow, __ATOMIC_RELEASE );
+            }
+
+            ulLostNow = __atomic_load_n( &ulLost, __ATOMIC_RELAXED );
+
+            if( ulLostNow != ulLostReported )
+            {
+                printf( "dlog: %lu records lost\n", ( unsigned long ) ( ulLostNow - ulLostReported ) );
+                ulLostReported = ulLostNow;
+            }
+
+            vTaskDelay( pdMS_TO_TICKS( dlogDRAIN_PERIOD_MS ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    int DLog_Init( void )
+    {
+        static bool xStarted = false;
+
+        if( xStarted == true )
+        {
+            return 0;
+        }
+
+        if( xTaskCreate( prvDrainTask,
+                         "DLog",
+                         dlogTASK_STACK_SIZE,
+                         NULL,
+                         dlogTASK_PRIORITY,
+                         NULL ) != pdPASS )
+        {
+            return -1;
+        }
+
+        xStarted = true;
+
+        return 0;
+    }
+
+/*-----------------------------------------------------------*/
+
+    uint32_t DLog_Lost( void )
+    {
+        return __atomic_load_n( &ulLost, __ATOMIC_RELAXED );
+    }
+
+#endif /* if ( dlogENABLED == 1 ) */
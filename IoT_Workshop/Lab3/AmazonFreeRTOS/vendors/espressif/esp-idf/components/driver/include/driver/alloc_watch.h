@@ -0,0 +1,90 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file alloc_watch.h
+ * @brief Count heap allocations once the application is in its steady state.
+ *
+ * With every object allocated at startup, a demo that keeps running should
+ * not touch the heap again. The demo calls AllocWatch_Start() when its
+ * startup is over, typically after the first publish. It calls
+ * AllocWatch_Report() once a number of messages have been published, which
+ * prints:
+ *
+ *     {"steady_state_allocs":0}
+ *
+ * followed by one ALLOC line per allocation seen, with its size and caller
+ * address for addr2line. A CI job can assert the count is 0.
+ *
+ * Counting uses the heap tracing of ESP-IDF. Set "Heap memory debugging >
+ * Heap tracing" to Standalone in menuconfig (CONFIG_HEAP_TRACING). Without
+ * it, the count is -1 and the report says so.
+ */
+
+#ifndef _ALLOC_WATCH_H_
+#define _ALLOC_WATCH_H_
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#ifndef allocwatchENABLED
+    #if defined( CONFIG_HEAP_TRACING )
+        #define allocwatchENABLED    ( 1 )
+    #else
+        #define allocwatchENABLED    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Allocations kept with their caller. Later ones are still counted,
+ * up to this many; the count then reads as "at least".
+ */
+#ifndef allocwatchMAX_RECORDS
+    #define allocwatchMAX_RECORDS    ( 16 )
+#endif
+
+/**
+ * @brief Start counting. Only the first call counts; later calls do
+ * nothing.
+ */
+void AllocWatch_Start( void );
+
+/**
+ * @brief Allocations since AllocWatch_Start().
+ *
+ * @return The count, at most allocwatchMAX_RECORDS; 0 before the start;
+ * -1 if heap tracing is not configured.
+ */
+int32_t AllocWatch_Count( void );
+
+/**
+ * @brief Print the count and the allocations kept. Only the first call
+ * prints.
+ */
+void AllocWatch_Report( void );
+
+#endif /* _ALLOC_WATCH_H_ */
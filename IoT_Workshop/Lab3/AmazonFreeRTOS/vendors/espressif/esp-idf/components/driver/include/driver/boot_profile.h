@@ -0,0 +1,66 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file boot_profile.h
+ * @brief Timestamps of the startup phases, from reset to the first publish.
+ *
+ * The demos mark each phase as it completes: demo task start, GPIO setup,
+ * first sensor reading, connection and first publish. Only the first mark of
+ * a phase counts, so a mark can sit in a loop or a callback. The report is
+ * one line, printed once per boot:
+ *
+ *     {"startup_ms":{"demo_start":612,"gpio":613,"connected":2840,...}}
+ *
+ * Times are milliseconds since reset, in the order the phases completed.
+ * Phases that run in parallel, such as the sensor warm-up and the network
+ * bring-up, therefore show up interleaved.
+ */
+
+#ifndef _BOOT_PROFILE_H_
+#define _BOOT_PROFILE_H_
+
+/**
+ * @brief Phases kept; later ones are ignored.
+ */
+#ifndef bootprofileMAX_PHASES
+    #define bootprofileMAX_PHASES    ( 12 )
+#endif
+
+/**
+ * @brief Record the completion of a phase, unless already recorded.
+ *
+ * Safe from any task, and cheap after the first call.
+ *
+ * @param[in] pcPhase Name of the phase; must be a string literal.
+ */
+void BootProfile_Mark( const char * pcPhase );
+
+/**
+ * @brief Print the phases recorded so far. Only the first call prints.
+ */
+void BootProfile_Report( void );
+
+#endif /* _BOOT_PROFILE_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file cmd_dispatch.h
+ * @brief Apply the keys of a JSON command message through a table of
+ * handlers.
+ *
+ * The demos take commands on an MQTT topic, as a flat JSON object such as
+ *
+ *     {"led":"on","period_ms":10000,"deadband":0.5}
+ *
+ * CmdDispatch_Run() scans the payload twice, from left to right. The first
+ * scan checks the syntax of the whole object, after which only blanks may
+ * come; a payload that is malformed or cut short, such as
+ * {"period_ms":2000,"qos":, is rejected as a whole and no handler runs. The second scan looks each key up in the table and
+ * passes its value to the handler of its entry, which checks and applies
+ * it. Keys the table does not know are counted and skipped, nested values
+ * included. The value of a key is not copied; strings are passed without
+ * their quotes and escapes are left as they are.
+ *
+ * CmdDispatch_FormatAck() then writes the reply: the keys that were applied
+ * and rejected, and the current value of every setting, as reported by the
+ * entries themselves:
+ *
+ *     {"applied":["led","period_ms"],"rejected":["deadband"],"unknown":0,
+ *      "settings":{"led":"on","period_ms":10000,"deadband":0.0}}
+ *
+ * The module keeps no state. Handlers run in the task that calls
+ * CmdDispatch_Run(); the settings they write are usually read by other
+ * tasks, so they are stored with atomics.
+ */
+
+#ifndef _CMD_DISPATCH_H_
+#define _CMD_DISPATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Entries a table may have; one bit each in #CmdResult_t.
+ */
+#define cmddispatchMAX_ENTRIES    ( 32 )
+
+/**
+ * @brief Kinds of JSON value.
+ */
+typedef enum CmdValueType
+{
+    eCmdValueString,  /**< Text without the quotes. */
+    eCmdValueNumber,  /**< Text of the number. */
+    eCmdValueLiteral, /**< true, false or null. */
+    eCmdValueNested   /**< An object or an array, brackets included. */
+} CmdValueType_t;
+
+/**
+ * @brief A value in the payload being scanned.
+ */
+typedef struct CmdValue
+{
+    CmdValueType_t xType;
+    const char * pcText;
+    size_t xLength;
+} CmdValue_t;
+
+/**
+ * @brief Check and apply a value.
+ *
+ * @return false to reject the value; the setting must then be unchanged.
+ */
+typedef bool ( * CmdApply_t )( const CmdValue_t * pxValue );
+
+/**
+ * @brief Write the current value of a setting as a JSON value, the way
+ * snprintf() does.
+ */
+typedef int ( * CmdReport_t )( char * pcBuffer,
+                               size_t xLength );
+
+/**
+ * @brief An entry of a table.
+ */
+typedef struct CmdEntry
+{
+    const char * pcKey;
+    size_t xKeyLength;
+    CmdApply_t xApply;
+    CmdReport_t xReport; /**< NULL to leave the setting out of the ack. */
+} CmdEntry_t;
+
+/**
+ * @brief Initializer of an entry whose key is a string literal.
+ */
+#define cmddispatchENTRY( key, apply, report )    { ( key ), sizeof( key ) - 1, ( apply ), ( report ) }
+
+/**
+ * @brief What CmdDispatch_Run() did; bit i stands for entry i.
+ */
+typedef struct CmdResult
+{
+    uint32_t ulApplied;
+    uint32_t ulRejected;
+    uint32_t ulUnknown; /**< Keys not in the table. */
+    bool xMalformed;    /**< The payload has a syntax error; nothing was applied. */
+} CmdResult_t;
+
+/**
+ * @brief Check a payload, then apply each key it holds.
+ *
+ * A key given twice is applied twice; the last value stays. A malformed
+ * payload applies nothing.
+ *
+ * @param[in] pxTable The table, of at most #cmddispatchMAX_ENTRIES entries.
+ * @param[in] uxEntries Number of entries.
+ * @param[in] pcPayload The payload; it need not be terminated.
+ * @param[in] xLength Length of pcPayload.
+ * @param[out] pxResult What was done.
+ *
+ * @return true if at least one key of the table was found.
+ */
+bool CmdDispatch_Run( const CmdEntry_t * pxTable,
+                      size_t uxEntries,
+                      const char * pcPayload,
+                      size_t xLength,
+                      CmdResult_t * pxResult );
+
+/**
+ * @brief Write the ack of a command, terminated.
+ *
+ * @return Length written, without the terminator; 0 if it did not fit.
+ */
+size_t CmdDispatch_FormatAck( const CmdEntry_t * pxTable,
+                              size_t uxEntries,
+                              const CmdResult_t * pxResult,
+                              char * pcBuffer,
+                              size_t xLength );
+
+/**
+ * @brief Read a number as a fixed-point integer.
+ *
+ * The value is multiplied by ulScale, a power of ten, and further digits
+ * are dropped; with a scale of 10, "0.55" gives 5. Exponents are not
+ * accepted.
+ *
+ * @return false if the value is not a number, or does not fit.
+ */
+bool CmdDispatch_ToFixed( const CmdValue_t * pxValue,
+                          uint32_t ulScale,
+                          int32_t * plResult );
+
+/**
+ * @brief Whether a value is this string.
+ */
+bool CmdDispatch_IsString( const CmdValue_t * pxValue,
+                           const char * pcString );
+
+#endif /* _CMD_DISPATCH_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file dlog.h
+ * @brief Deferred logging: printf-style calls that only copy their
+ * arguments.
+ *
+ * dlogPRINTF( ( "Hum %.1f\n", fHumidity ) ) stores a binary record in a
+ * lock-free ring. The record holds a timestamp, the address of the format
+ * string and the raw arguments. Strings are copied, since they may change
+ * before the record is drained. A low priority task formats the records
+ * and writes them to the console, so number formatting and the UART no
+ * longer run in the timer daemon or in MQTT callbacks.
+ *
+ * With dlogRAW_OUTPUT set to 1 the task skips formatting as well. It
+ * prints each record as a "DLOG <hex>" line, and tools/dlog_decode.c renders
+ * a captured console log using the application ELF, which holds the format
+ * strings.
+ *
+ * Format strings must be string literals, because only their address is
+ * stored. Conversions of printf are supported except %n. Do not call from
+ * interrupts.
+ */
+
+#ifndef _DLOG_H_
+#define _DLOG_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Set to 0 to make dlogPRINTF a plain printf.
+ */
+#ifndef dlogENABLED
+    #define dlogENABLED                 ( 1 )
+#endif
+
+/**
+ * @brief Size of the ring; a power of two.
+ */
+#ifndef dlogBUFFER_SIZE
+    #define dlogBUFFER_SIZE             ( 4096 )
+#endif
+
+/**
+ * @brief Longest string copied for a %s argument; longer ones are cut.
+ */
+#ifndef dlogMAX_STRING_LENGTH
+    #define dlogMAX_STRING_LENGTH       ( 96 )
+#endif
+
+/**
+ * @brief Largest record. Formatted lines may be twice as long.
+ */
+#ifndef dlogMAX_RECORD_SIZE
+    #define dlogMAX_RECORD_SIZE         ( 384 )
+#endif
+
+/**
+ * @brief Set to 1 to print records as hex for tools/dlog_decode.c.
+ */
+#ifndef dlogRAW_OUTPUT
+    #define dlogRAW_OUTPUT              ( 0 )
+#endif
+
+/**
+ * @brief How long the drain task sleeps when the ring is empty.
+ */
+#ifndef dlogDRAIN_PERIOD_MS
+    #define dlogDRAIN_PERIOD_MS         ( 20 )
+#endif
+
+#ifndef dlogTASK_STACK_SIZE
+    #define dlogTASK_STACK_SIZE         ( 3072 )
+#endif
+
+#ifndef dlogTASK_PRIORITY
+    #define dlogTASK_PRIORITY           ( tskIDLE_PRIORITY + 1 )
+#endif
+
+/**
+ * @brief Record layout, shared with tools/dlog_decode.c. Every field is
+ * little endian and records are padded to four bytes.
+ *
+ *     uint32_t header     length in bytes | type << 16; 0 while being written
+ *     uint32_t timestamp  microseconds since boot
+ *     uint32_t format     address of the format string
+ *     arguments           in order: integers and pointers as 4 bytes, long
+ *                         long as 8, floating point as an 8-byte double,
+ *                         strings as a 2-byte length and the bytes, padded
+ */
+#define dlogRECORD_MESSAGE              ( 1 )
+#define dlogRECORD_PADDING              ( 2 )
+
+#if ( dlogENABLED == 1 )
+
+/**
+ * @brief Log without formatting; see the file description.
+ */
+    #define dlogPRINTF( X )    DLog_Printf X
+
+/**
+ * @brief Start the task that drains the ring. Records written before are
+ * kept until it runs.
+ *
+ * @return 0 on success.
+ */
+    int DLog_Init( void );
+
+/**
+ * @brief Store a record. Prefer dlogPRINTF.
+ */
+    void DLog_Printf( const char * pcFormat,
+                      ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+/**
+ * @brief Records dropped because the ring was full.
+ */
+    uint32_t DLog_Lost( void );
+
+#else /* if ( dlogENABLED == 1 ) */
+
+    #include <stdio.h>
+
+    #define dlogPRINTF( X )    printf X
+    #define DLog_Init()        ( 0 )
+    #define DLog_Lost()        ( 0 )
+
+#endif /* if ( dlogENABLED == 1 ) */
+
+#endif /* _DLOG_H_ */
@@ -0,0 +1,190 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file sched_trace.h
+ * @brief Scheduler trace: which task ran when, on which core.
+ *
+ * The FreeRTOS trace hooks record these events in a RAM ring:
+ * - context switches
+ * - task creation
+ * - sends to and receives from queues, and blocking on a receive
+ *
+ * The application adds interrupt entry and exit, and named spans such as
+ * readDHT() or a publish. Each event is 16 bytes: a microsecond timestamp,
+ * the core, the type, an object and a value. Recording costs a few hundred
+ * cycles and takes no lock.
+ *
+ * SchedTrace_Dump() prints the ring as SCHED lines on the console. The
+ * tools/sched_trace_json.c program converts a capture into the Chrome trace
+ * format, for chrome://tracing or ui.perfetto.dev.
+ *
+ * To enable, add these lines at the end of the board's FreeRTOSConfig.h,
+ * so that the kernel is built with the hooks:
+ *
+ *     #define schedtraceENABLED    1
+ *     #include "driver/sched_trace.h"
+ *
+ * Application files include this header after FreeRTOS.h.
+ *
+ * Semaphores and mutexes are queues without items; they are not recorded,
+ * which keeps the MQTT library's locking out of the trace.
+ */
+
+#ifndef _SCHED_TRACE_H_
+#define _SCHED_TRACE_H_
+
+#ifndef schedtraceENABLED
+    #define schedtraceENABLED    ( 0 )
+#endif
+
+#if ( schedtraceENABLED == 1 ) && !defined( __ASSEMBLER__ )
+
+    #include <stdint.h>
+
+/**
+ * @brief Events kept; a power of two.
+ */
+    #ifndef schedtraceBUFFER_EVENTS
+        #define schedtraceBUFFER_EVENTS    ( 1024 )
+    #endif
+
+/**
+ * @brief 1 to stop recording when the ring is full, so that the trace
+ * covers the start of the run. 0 to overwrite the oldest events, so that it
+ * covers the end.
+ */
+    #ifndef schedtraceSTOP_WHEN_FULL
+        #define schedtraceSTOP_WHEN_FULL    ( 1 )
+    #endif
+
+/**
+ * @brief Tasks and queues whose names are kept for the dump.
+ */
+    #ifndef schedtraceMAX_NAMES
+        #define schedtraceMAX_NAMES         ( 32 )
+    #endif
+
+/**
+ * @brief The task running on this core, as seen from inside tasks.c.
+ * The ESP32 port keeps one per core.
+ */
+    #ifndef schedtraceCURRENT_TCB
+        #define schedtraceCURRENT_TCB()     ( pxCurrentTCB[ xPortGetCoreID() ] )
+    #endif
+
+/**
+ * @brief Event types, also the letters of the dump.
+ */
+    typedef enum
+    {
+        eSchedTraceSwitch = 'S',       /**< Task switched in; value unused. */
+        eSchedTraceQueueSend = 'Q',    /**< Value is the depth before the send. */
+        eSchedTraceQueueFull = 'F',    /**< Send failed, the queue was full. */
+        eSchedTraceQueueReceive = 'R', /**< Value is the depth before the receive. */
+        eSchedTraceQueueWait = 'W',    /**< Receiving task blocks on an empty queue. */
+        eSchedTraceIsrEnter = 'I',     /**< Object is the interrupt number. */
+        eSchedTraceIsrExit = 'X',
+        eSchedTraceSpanBegin = 'B',    /**< Object is the span name. */
+        eSchedTraceSpanEnd = 'E'
+    } SchedTraceEvent_t;
+
+/**
+ * @brief Record one event. Safe from tasks, interrupts and critical sections.
+ */
+    void SchedTrace_Record( SchedTraceEvent_t xEvent,
+                            const void * pvObject,
+                            uint32_t ulValue );
+
+/**
+ * @brief Keep the name of a task or queue for the dump. Names are copied.
+ */
+    void SchedTrace_Name( const void * pvObject,
+                          const char * pcName );
+
+/**
+ * @brief Print the ring on the console, oldest event first. Recording is
+ * paused meanwhile, then the ring is emptied and recording restarts.
+ */
+    void SchedTrace_Dump( void );
+
+/**
+ * @brief Dump once, the first time the ring has filled. Cheap enough to call
+ * from a demo loop.
+ */
+    void SchedTrace_Poll( void );
+
+    #define SchedTrace_SpanBegin( pcName )    SchedTrace_Record( eSchedTraceSpanBegin, ( pcName ), 0 )
+    #define SchedTrace_SpanEnd( pcName )      SchedTrace_Record( eSchedTraceSpanEnd, ( pcName ), 0 )
+    #define SchedTrace_IsrEnter( ulNumber )   SchedTrace_Record( eSchedTraceIsrEnter, ( const void * ) ( uintptr_t ) ( ulNumber ), 0 )
+    #define SchedTrace_IsrExit( ulNumber )    SchedTrace_Record( eSchedTraceIsrExit, ( const void * ) ( uintptr_t ) ( ulNumber ), 0 )
+
+/* Kernel hooks. Only queues that carry items are recorded. */
+    #if defined( traceTASK_SWITCHED_IN ) || defined( traceQUEUE_SEND )
+        #error "sched_trace.h: the FreeRTOS trace hooks are already in use, e.g. by SystemView."
+    #endif
+
+    #define traceTASK_SWITCHED_IN() \
+    SchedTrace_Record( eSchedTraceSwitch, schedtraceCURRENT_TCB(), 0 )
+
+    #define traceTASK_CREATE( pxNewTCB ) \
+    SchedTrace_Name( ( pxNewTCB ), ( pxNewTCB )->pcTaskName )
+
+    #define schedtraceQUEUE_EVENT( xEvent, pxQueue )                                  \
+    do {                                                                              \
+        if( ( pxQueue )->uxItemSize != 0 )                                            \
+        {                                                                             \
+            SchedTrace_Record( ( xEvent ), ( pxQueue ), ( pxQueue )->uxMessagesWaiting ); \
+        }                                                                             \
+    } while( 0 )
+
+    #define traceQUEUE_SEND( pxQueue )                  schedtraceQUEUE_EVENT( eSchedTraceQueueSend, pxQueue )
+    #define traceQUEUE_SEND_FROM_ISR( pxQueue )         schedtraceQUEUE_EVENT( eSchedTraceQueueSend, pxQueue )
+    #define traceQUEUE_SEND_FAILED( pxQueue )           schedtraceQUEUE_EVENT( eSchedTraceQueueFull, pxQueue )
+    #define traceQUEUE_SEND_FROM_ISR_FAILED( pxQueue )  schedtraceQUEUE_EVENT( eSchedTraceQueueFull, pxQueue )
+    #define traceQUEUE_RECEIVE( pxQueue )               schedtraceQUEUE_EVENT( eSchedTraceQueueReceive, pxQueue )
+    #define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )      schedtraceQUEUE_EVENT( eSchedTraceQueueReceive, pxQueue )
+    #define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )   schedtraceQUEUE_EVENT( eSchedTraceQueueWait, pxQueue )
+
+    #define traceQUEUE_REGISTRY_ADD( xQueue, pcQueueName ) \
+    SchedTrace_Name( ( xQueue ), ( pcQueueName ) )
+
+/* Ports that report interrupts call these. */
+    #define traceISR_ENTER( n )    SchedTrace_IsrEnter( n )
+    #define traceISR_EXIT()        SchedTrace_IsrExit( 0 )
+
+#else /* if ( schedtraceENABLED == 1 ) && !defined( __ASSEMBLER__ ) */
+
+    #define SchedTrace_Name( pvObject, pcName )
+    #define SchedTrace_Dump()
+    #define SchedTrace_Poll()
+    #define SchedTrace_SpanBegin( pcName )
+    #define SchedTrace_SpanEnd( pcName )
+    #define SchedTrace_IsrEnter( ulNumber )
+    #define SchedTrace_IsrExit( ulNumber )
+
+#endif /* if ( schedtraceENABLED == 1 ) && !defined( __ASSEMBLER__ ) */
+
+#endif /* _SCHED_TRACE_H_ */
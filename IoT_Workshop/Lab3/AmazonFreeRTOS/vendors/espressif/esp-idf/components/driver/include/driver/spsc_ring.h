@@ -0,0 +1,127 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free ring of fixed-size items, for one producer task and one
+ * consumer task.
+ *
+ * The demos sample on one core and publish from the other. Readings cross
+ * through this ring instead of a FreeRTOS queue. Neither side takes a lock
+ * or enters a critical section, so a push never spins on the queue lock
+ * held by the other core.
+ *
+ * The producer writes only the head and the consumer only the tail. Each
+ * index sits in its own cache line, next to the copy of the other index
+ * that its owner last read. A side reads the other's index only when its
+ * copy says the ring is full or empty. The ESP32 does not cache internal
+ * RAM; the layout still halves the traffic on the shared bus, and keeps
+ * the ring correct on hosts that do cache.
+ *
+ * The consumer takes several items at once with SpscRing_PopBatch(). The
+ * ring does not block; the demos pair it with a task notification.
+ *
+ * One task may push and one task may pop. Interrupts must not use the ring;
+ * they notify the producing task instead.
+ */
+
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Alignment of the producer and consumer indexes.
+ */
+#ifndef spscringCACHE_LINE
+    #define spscringCACHE_LINE    ( 32 )
+#endif
+
+/**
+ * @brief A ring. Members are private; use the functions below.
+ */
+typedef struct SpscRing
+{
+    /* Set by SpscRing_Init(), then read only. */
+    uint8_t * pucStorage;
+    size_t uxItemSize;
+    uint32_t ulMask;
+
+    /* Written by the producer. */
+    uint32_t ulHead __attribute__( ( aligned( spscringCACHE_LINE ) ) ); /**< Items pushed, free running. */
+    uint32_t ulTailCache;                                               /**< Last tail seen by the producer. */
+
+    /* Written by the consumer. */
+    uint32_t ulTail __attribute__( ( aligned( spscringCACHE_LINE ) ) ); /**< Items popped, free running. */
+    uint32_t ulHeadCache;                                               /**< Last head seen by the consumer. */
+} __attribute__( ( aligned( spscringCACHE_LINE ) ) ) SpscRing_t;
+
+/**
+ * @brief Set up an empty ring over caller-provided storage, before either
+ * task that uses it is created.
+ *
+ * @param[out] pxRing The ring.
+ * @param[in] pvStorage Room for uxLength items.
+ * @param[in] uxItemSize Size of one item, in bytes.
+ * @param[in] uxLength Number of items; a power of two.
+ *
+ * @return false if uxLength is not a power of two, true otherwise.
+ */
+bool SpscRing_Init( SpscRing_t * pxRing,
+                    void * pvStorage,
+                    size_t uxItemSize,
+                    size_t uxLength );
+
+/**
+ * @brief Copy an item into the ring. Producer only.
+ *
+ * @return false if the ring is full; the item is then not stored.
+ */
+bool SpscRing_Push( SpscRing_t * pxRing,
+                    const void * pvItem );
+
+/**
+ * @brief Copy out up to uxMaxItems items, oldest first. Consumer only.
+ *
+ * @return Number of items copied to pvItems; 0 if the ring is empty.
+ */
+size_t SpscRing_PopBatch( SpscRing_t * pxRing,
+                          void * pvItems,
+                          size_t uxMaxItems );
+
+/**
+ * @brief Items in the ring. From any task; the value may already be stale.
+ */
+size_t SpscRing_Count( const SpscRing_t * pxRing );
+
+/**
+ * @brief Items the ring holds when full.
+ */
+size_t SpscRing_Capacity( const SpscRing_t * pxRing );
+
+#endif /* _SPSC_RING_H_ */
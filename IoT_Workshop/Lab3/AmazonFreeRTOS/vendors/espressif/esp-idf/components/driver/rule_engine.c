@@ -0,0 +1,775 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file rule_engine.c
+ * @brief Compiler and stack machine of the local rules.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "driver/rule_engine.h"
+
+/*-----------------------------------------------------------*/
+
+/* Instructions. Operands follow the opcode, multi-byte ones little endian. */
+typedef enum RuleOpcode
+{
+    eRuleOpPush16 = 1, /* int16 operand: push it. */
+    eRuleOpPush32,     /* int32 operand: push it. */
+    eRuleOpLoad,       /* Input index: push its value. */
+    eRuleOpHeld,       /* held() slot: pop a condition, push how long it has been true. */
+    eRuleOpAdd,        /* Pop b and a, push a + b. */
+    eRuleOpSub,
+    eRuleOpGt,         /* Pop b and a, push 1 if a > b, else 0. */
+    eRuleOpGe,
+    eRuleOpLt,
+    eRuleOpLe,
+    eRuleOpEq,
+    eRuleOpNe,
+    eRuleOpAnd,        /* Pop b and a, push 1 if both are not 0. */
+    eRuleOpOr,
+    eRuleOpNot,        /* Pop a, push 1 if it is 0. */
+    eRuleOpAct         /* Output index and level: pop the condition of the next rule. */
+} RuleOpcode_t;
+
+/* State of a compilation. */
+typedef struct RuleCompiler
+{
+    const char * const * ppcInputs;
+    size_t uxInputs;
+    const char * const * ppcOutputs;
+    size_t uxOutputs;
+    const char * pcText;
+    size_t xLength;
+    size_t xIndex;
+    RuleProgram_t * pxProgram;
+    uint32_t ulDepth;   /* Values on the stack at this point of the code. */
+    uint32_t ulNesting;
+} RuleCompiler_t;
+
+static bool prvExpression( RuleCompiler_t * pxCompiler );
+
+/*-----------------------------------------------------------*/
+
+static bool prvIsNameStart( char c )
+{
+    return ( ( c >= 'a' ) && ( c <= 'z' ) ) ||
+           ( ( c >= 'A' ) && ( c <= 'Z' ) ) ||
+           ( c == '_' );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvIsNameChar( char c )
+{
+    return prvIsNameStart( c ) || ( ( c >= '0' ) && ( c <= '9' ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSkipSpace( RuleCompiler_t * pxCompiler )
+{
+    char c;
+
+    while( pxCompiler->xIndex < pxCompiler->xLength )
+    {
+        c = pxCompiler->pcText[ pxCompiler->xIndex ];
+
+        if( ( c != ' ' ) && ( c != '\t' ) && ( c != '\r' ) && ( c != '\n' ) )
+        {
+            break;
+        }
+
+        pxCompiler->xIndex++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take the next symbol if it is pcSymbol. */
+static bool prvAccept( RuleCompiler_t * pxCompiler,
+                       const char * pcSymbol )
+{
+    size_t xSymbolLength = strlen( pcSymbol );
+
+    prvSkipSpace( pxCompiler );
+
+    if( ( pxCompiler->xLength - pxCompiler->xIndex >= xSymbolLength ) &&
+        ( memcmp( &( pxCompiler->pcText[ pxCompiler->xIndex ] ), pcSymbol, xSymbolLength ) == 0 ) )
+    {
+        pxCompiler->xIndex += xSymbolLength;
+
+        return true;
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take the next name, whatever it is. */
+static bool prvName( RuleCompiler_t * pxCompiler,
+                     const char ** ppcName,
+                     size_t * pxNameLength )
+{
+    size_t xStart;
+
+    prvSkipSpace( pxCompiler );
+    xStart = pxCompiler->xIndex;
+
+    if( ( xStart == pxCompiler->xLength ) ||
+        ( prvIsNameStart( pxCompiler->pcText[ xStart ] ) == false ) )
+    {
+        return false;
+    }
+
+    while( ( pxCompiler->xIndex < pxCompiler->xLength ) &&
+           ( prvIsNameChar( pxCompiler->pcText[ pxCompiler->xIndex ] ) == true ) )
+    {
+        pxCompiler->xIndex++;
+    }
+
+    *ppcName = &( pxCompiler->pcText[ xStart ] );
+    *pxNameLength = pxCompiler->xIndex - xStart;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvNameIs( const char * pcName,
+                       size_t xNameLength,
+                       const char * pcWord )
+{
+    return ( strlen( pcWord ) == xNameLength ) && ( memcmp( pcName, pcWord, xNameLength ) == 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take the next name if it is pcWord. */
+static bool prvAcceptWord( RuleCompiler_t * pxCompiler,
+                           const char * pcWord )
+{
+    size_t xStart = pxCompiler->xIndex;
+    const char * pcName;
+    size_t xNameLength;
+
+    if( ( prvName( pxCompiler, &pcName, &xNameLength ) == true ) &&
+        ( prvNameIs( pcName, xNameLength, pcWord ) == true ) )
+    {
+        return true;
+    }
+
+    pxCompiler->xIndex = xStart;
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvLookUp( const char * const * ppcNames,
+                       size_t uxNames,
+                       const char * pcName,
+                       size_t xNameLength,
+                       uint8_t * pucIndex )
+{
+    size_t i;
+
+    for( i = 0; ( i < uxNames ) && ( i <= UINT8_MAX ); i++ )
+    {
+        if( prvNameIs( pcName, xNameLength, ppcNames[ i ] ) == true )
+        {
+            *pucIndex = ( uint8_t ) i;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvEmit( RuleCompiler_t * pxCompiler,
+                     uint8_t ucByte )
+{
+    RuleProgram_t * pxProgram = pxCompiler->pxProgram;
+
+    if( pxProgram->usLength == rulesMAX_CODE )
+    {
+        return false;
+    }
+
+    pxProgram->ucCode[ pxProgram->usLength++ ] = ucByte;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Emit an instruction and account for what it does to the stack. */
+static bool prvEmitOp( RuleCompiler_t * pxCompiler,
+                       RuleOpcode_t xOpcode,
+                       int32_t lStackChange )
+{
+    pxCompiler->ulDepth = ( uint32_t ) ( ( int32_t ) pxCompiler->ulDepth + lStackChange );
+
+    return ( pxCompiler->ulDepth <= rulesMAX_STACK ) &&
+           ( prvEmit( pxCompiler, ( uint8_t ) xOpcode ) == true );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvPushNumber( RuleCompiler_t * pxCompiler,
+                           int32_t lValue )
+{
+    uint32_t ulValue = ( uint32_t ) lValue;
+
+    if( ( lValue >= INT16_MIN ) && ( lValue <= INT16_MAX ) )
+    {
+        return prvEmitOp( pxCompiler, eRuleOpPush16, 1 ) &&
+               prvEmit( pxCompiler, ( uint8_t ) ulValue ) &&
+               prvEmit( pxCompiler, ( uint8_t ) ( ulValue >> 8 ) );
+    }
+
+    return prvEmitOp( pxCompiler, eRuleOpPush32, 1 ) &&
+           prvEmit( pxCompiler, ( uint8_t ) ulValue ) &&
+           prvEmit( pxCompiler, ( uint8_t ) ( ulValue >> 8 ) ) &&
+           prvEmit( pxCompiler, ( uint8_t ) ( ulValue >> 16 ) ) &&
+           prvEmit( pxCompiler, ( uint8_t ) ( ulValue >> 24 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/* A number in tenths. Further digits are dropped, as by CmdDispatch_ToFixed(). */
+static bool prvNumber( RuleCompiler_t * pxCompiler )
+{
+    const char * pcText = pxCompiler->pcText;
+    bool xNegative = false, xDigits = false;
+    int64_t llTenths = 0;
+    uint32_t ulFraction = 0;
+
+    prvSkipSpace( pxCompiler );
+
+    if( ( pxCompiler->xIndex < pxCompiler->xLength ) && ( pcText[ pxCompiler->xIndex ] == '-' ) )
+    {
+        xNegative = true;
+        pxCompiler->xIndex++;
+    }
+
+    while( ( pxCompiler->xIndex < pxCompiler->xLength ) &&
+           ( pcText[ pxCompiler->xIndex ] >= '0' ) && ( pcText[ pxCompiler->xIndex ] <= '9' ) )
+    {
+        llTenths = ( llTenths * 10 ) + ( ( pcText[ pxCompiler->xIndex ] - '0' ) * 10 );
+        xDigits = true;
+        pxCompiler->xIndex++;
+
+        if( llTenths > INT32_MAX )
+        {
+            return false;
+        }
+    }
+
+    if( ( pxCompiler->xIndex < pxCompiler->xLength ) && ( pcText[ pxCompiler->xIndex ] == '.' ) )
+    {
+        pxCompiler->xIndex++;
+
+        while( ( pxCompiler->xIndex < pxCompiler->xLength ) &&
+               ( pcText[ pxCompiler->xIndex ] >= '0' ) && ( pcText[ pxCompiler->xIndex ] <= '9' ) )
+        {
+            if( ulFraction++ == 0 )
+            {
+                llTenths += pcText[ pxCompiler->xIndex ] - '0';
+            }
+
+            xDigits = true;
+            pxCompiler->xIndex++;
+        }
+    }
+
+    if( ( xDigits == false ) || ( llTenths > INT32_MAX ) )
+    {
+        return false;
+    }
+
+    return prvPushNumber( pxCompiler, ( int32_t ) ( ( xNegative == true ) ? -llTenths : llTenths ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/* term := number | input | held( expression ) | ( expression ) */
+static bool prvTerm( RuleCompiler_t * pxCompiler )
+{
+    const char * pcName;
+    size_t xNameLength;
+    uint8_t ucIndex;
+    RuleProgram_t * pxProgram = pxCompiler->pxProgram;
+    bool xResult = false;
+
+    if( pxCompiler->ulNesting++ == rulesMAX_NESTING )
+    {
+        return false;
+    }
+
+    if( prvAccept( pxCompiler, "(" ) == true )
+    {
+        xResult = prvExpression( pxCompiler ) &&
+                  prvAccept( pxCompiler, ")" );
+    }
+    else if( prvName( pxCompiler, &pcName, &xNameLength ) == false )
+    {
+        xResult = prvNumber( pxCompiler );
+    }
+    else if( prvNameIs( pcName, xNameLength, "held" ) == true )
+    {
+        if( pxProgram->ucHeld < rulesMAX_HELD )
+        {
+            ucIndex = pxProgram->ucHeld++;
+            xResult = prvAccept( pxCompiler, "(" ) &&
+                      prvExpression( pxCompiler ) &&
+                      prvAccept( pxCompiler, ")" ) &&
+                      prvEmitOp( pxCompiler, eRuleOpHeld, 0 ) &&
+                      prvEmit( pxCompiler, ucIndex );
+        }
+    }
+    else if( prvLookUp( pxCompiler->ppcInputs, pxCompiler->uxInputs, pcName, xNameLength, &ucIndex ) == true )
+    {
+        xResult = prvEmitOp( pxCompiler, eRuleOpLoad, 1 ) &&
+                  prvEmit( pxCompiler, ucIndex );
+    }
+
+    pxCompiler->ulNesting--;
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* sum := term { ( + | - ) term } */
+static bool prvSum( RuleCompiler_t * pxCompiler )
+{
+    RuleOpcode_t xOpcode;
+
+    if( prvTerm( pxCompiler ) == false )
+    {
+        return false;
+    }
+
+    for( ; ; )
+    {
+        /* The arrow of the action is not a minus. */
+        if( prvAccept( pxCompiler, "->" ) == true )
+        {
+            pxCompiler->xIndex -= 2;
+
+            return true;
+        }
+        else if( prvAccept( pxCompiler, "+" ) == true )
+        {
+            xOpcode = eRuleOpAdd;
+        }
+        else if( prvAccept( pxCompiler, "-" ) == true )
+        {
+            xOpcode = eRuleOpSub;
+        }
+        else
+        {
+            return true;
+        }
+
+        if( ( prvTerm( pxCompiler ) == false ) ||
+            ( prvEmitOp( pxCompiler, xOpcode, -1 ) == false ) )
+        {
+            return false;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* comparison := sum [ ( > | >= | < | <= | == | != ) sum ] */
+static bool prvComparison( RuleCompiler_t * pxCompiler )
+{
+    RuleOpcode_t xOpcode;
+
+    if( prvSum( pxCompiler ) == false )
+    {
+        return false;
+    }
+
+    /* The two-character operators are tried first. */
+    if( prvAccept( pxCompiler, ">=" ) == true )
+    {
+        xOpcode = eRuleOpGe;
+    }
+    else if( prvAccept( pxCompiler, "<=" ) == true )
+    {
+        xOpcode = eRuleOpLe;
+    }
+    else if( prvAccept( pxCompiler, "==" ) == true )
+    {
+        xOpcode = eRuleOpEq;
+    }
+    else if( prvAccept( pxCompiler, "!=" ) == true )
+    {
+        xOpcode = eRuleOpNe;
+    }
+    else if( prvAccept( pxCompiler, ">" ) == true )
+    {
+        xOpcode = eRuleOpGt;
+    }
+    else if( prvAccept( pxCompiler, "<" ) == true )
+    {
+        xOpcode = eRuleOpLt;
+    }
+    else
+    {
+        return true;
+    }
+
+    return prvSum( pxCompiler ) &&
+           prvEmitOp( pxCompiler, xOpcode, -1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* negation := ( not | ! ) negation | comparison */
+static bool prvNegation( RuleCompiler_t * pxCompiler )
+{
+    bool xResult;
+
+    if( prvAccept( pxCompiler, "!=" ) == true )
+    {
+        /* Left for the comparison to reject. */
+        pxCompiler->xIndex -= 2;
+
+        return prvComparison( pxCompiler );
+    }
+
+    if( ( prvAcceptWord( pxCompiler, "not" ) == false ) &&
+        ( prvAccept( pxCompiler, "!" ) == false ) )
+    {
+        return prvComparison( pxCompiler );
+    }
+
+    if( pxCompiler->ulNesting++ == rulesMAX_NESTING )
+    {
+        return false;
+    }
+
+    xResult = prvNegation( pxCompiler ) &&
+              prvEmitOp( pxCompiler, eRuleOpNot, 0 );
+    pxCompiler->ulNesting--;
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* conjunction := negation { ( and | && ) negation } */
+static bool prvConjunction( RuleCompiler_t * pxCompiler )
+{
+    if( prvNegation( pxCompiler ) == false )
+    {
+        return false;
+    }
+
+    while( ( prvAcceptWord( pxCompiler, "and" ) == true ) ||
+           ( prvAccept( pxCompiler, "&&" ) == true ) )
+    {
+        if( ( prvNegation( pxCompiler ) == false ) ||
+            ( prvEmitOp( pxCompiler, eRuleOpAnd, -1 ) == false ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* expression := conjunction { ( or | || ) conjunction } */
+static bool prvExpression( RuleCompiler_t * pxCompiler )
+{
+    if( prvConjunction( pxCompiler ) == false )
+    {
+        return false;
+    }
+
+    while( ( prvAcceptWord( pxCompiler, "or" ) == true ) ||
+           ( prvAccept( pxCompiler, "||" ) == true ) )
+    {
+        if( ( prvConjunction( pxCompiler ) == false ) ||
+            ( prvEmitOp( pxCompiler, eRuleOpOr, -1 ) == false ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* rule := expression -> output = ( on | off | 1 | 0 ) */
+static bool prvRule( RuleCompiler_t * pxCompiler )
+{
+    const char * pcName;
+    size_t xNameLength;
+    uint8_t ucOutput, ucLevel;
+
+    if( ( pxCompiler->pxProgram->ucRules == rulesMAX_RULES ) ||
+        ( prvExpression( pxCompiler ) == false ) ||
+        ( prvAccept( pxCompiler, "->" ) == false ) ||
+        ( prvName( pxCompiler, &pcName, &xNameLength ) == false ) ||
+        ( prvLookUp( pxCompiler->ppcOutputs, pxCompiler->uxOutputs, pcName, xNameLength, &ucOutput ) == false ) ||
+        ( prvAccept( pxCompiler, "=" ) == false ) )
+    {
+        return false;
+    }
+
+    if( ( prvAcceptWord( pxCompiler, "on" ) == true ) || ( prvAccept( pxCompiler, "1" ) == true ) )
+    {
+        ucLevel = 1;
+    }
+    else if( ( prvAcceptWord( pxCompiler, "off" ) == true ) || ( prvAccept( pxCompiler, "0" ) == true ) )
+    {
+        ucLevel = 0;
+    }
+    else
+    {
+        return false;
+    }
+
+    pxCompiler->pxProgram->ucRules++;
+
+    return prvEmitOp( pxCompiler, eRuleOpAct, -1 ) &&
+           prvEmit( pxCompiler, ucOutput ) &&
+           prvEmit( pxCompiler, ucLevel );
+}
+
+/*-----------------------------------------------------------*/
+
+bool Rules_Compile( const char * const * ppcInputs,
+                    size_t uxInputs,
+                    const char * const * ppcOutputs,
+                    size_t uxOutputs,
+                    const char * pcSource,
+                    size_t xLength,
+                    RuleProgram_t * pxProgram,
+                    size_t * pxErrorOffset )
+{
+    RuleCompiler_t xCompiler =
+    {
+        .ppcInputs  = ppcInputs,
+        .uxInputs   = uxInputs,
+        .ppcOutputs = ppcOutputs,
+        .uxOutputs  = uxOutputs,
+        .pcText     = pcSource,
+        .xLength    = xLength,
+        .xIndex     = 0,
+        .pxProgram  = pxProgram,
+        .ulDepth    = 0,
+        .ulNesting  = 0
+    };
+    bool xCompiled = true;
+
+    pxProgram->usLength = 0;
+    pxProgram->ucRules = 0;
+    pxProgram->ucHeld = 0;
+
+    prvSkipSpace( &xCompiler );
+
+    while( ( xCompiled == true ) && ( xCompiler.xIndex < xCompiler.xLength ) )
+    {
+        /* A rule leaves nothing on the stack; a value left over means the
+         * code is wrong, not the rule. */
+        xCompiled = prvRule( &xCompiler ) &&
+                    ( xCompiler.ulDepth == 0 );
+
+        if( ( xCompiled == true ) && ( prvAccept( &xCompiler, ";" ) == false ) )
+        {
+            /* Only the end of the text may follow the last rule. */
+            prvSkipSpace( &xCompiler );
+            xCompiled = ( xCompiler.xIndex == xCompiler.xLength );
+        }
+
+        prvSkipSpace( &xCompiler );
+    }
+
+    if( ( xCompiled == false ) && ( pxErrorOffset != NULL ) )
+    {
+        *pxErrorOffset = xCompiler.xIndex;
+    }
+
+    return xCompiled;
+}
+
+/*-----------------------------------------------------------*/
+
+void Rules_Reset( RuleState_t * pxState )
+{
+    ( void ) memset( pxState, 0x00, sizeof( *pxState ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void Rules_Evaluate( const RuleProgram_t * pxProgram,
+                     RuleState_t * pxState,
+                     const int32_t * plInputs,
+                     uint32_t ulNowMs,
+                     RuleAction_t xAction,
+                     void * pvContext )
+{
+    const uint8_t * pucCode = pxProgram->ucCode;
+    const uint8_t * const pucEnd = &( pxProgram->ucCode[ pxProgram->usLength ] );
+    int32_t lStack[ rulesMAX_STACK ];
+    size_t uxTop = 0;
+    uint32_t ulRule = 0, ulBit, ulValue;
+    int32_t a, b;
+
+    /* The compiler has checked the code, the operands and the stack depth. */
+    while( pucCode < pucEnd )
+    {
+        switch( ( RuleOpcode_t ) *pucCode++ )
+        {
+            case eRuleOpPush16:
+                lStack[ uxTop++ ] = ( int16_t ) ( ( uint16_t ) pucCode[ 0 ] |
+                                                  ( ( uint16_t ) pucCode[ 1 ] << 8 ) );
+                pucCode += 2;
+                break;
+
+            case eRuleOpPush32:
+                lStack[ uxTop++ ] = ( int32_t ) ( ( uint32_t ) pucCode[ 0 ] |
+                                                  ( ( uint32_t ) pucCode[ 1 ] << 8 ) |
+                                                  ( ( uint32_t ) pucCode[ 2 ] << 16 ) |
+                                                  ( ( uint32_t ) pucCode[ 3 ] << 24 ) );
+                pucCode += 4;
+                break;
+
+            case eRuleOpLoad:
+                lStack[ uxTop++ ] = plInputs[ *pucCode++ ];
+                break;
+
+            case eRuleOpHeld:
+                ulBit = 1UL << *pucCode;
+
+                if( lStack[ uxTop - 1 ] == 0 )
+                {
+                    pxState->ulHeld &= ~ulBit;
+                    lStack[ uxTop - 1 ] = 0;
+                }
+                else
+                {
+                    if( ( pxState->ulHeld & ulBit ) == 0 )
+                    {
+                        pxState->ulHeld |= ulBit;
+                        pxState->ulSince[ *pucCode ] = ulNowMs;
+                    }
+
+                    /* In tenths of a second, like the other values. */
+                    ulValue = ( ulNowMs - pxState->ulSince[ *pucCode ] ) / 100;
+                    lStack[ uxTop - 1 ] = ( int32_t ) ( ( ulValue > INT32_MAX ) ? INT32_MAX : ulValue );
+                }
+
+                pucCode++;
+                break;
+
+            case eRuleOpNot:
+                lStack[ uxTop - 1 ] = ( lStack[ uxTop - 1 ] == 0 );
+                break;
+
+            case eRuleOpAct:
+                ulBit = 1UL << ulRule++;
+                a = lStack[ --uxTop ];
+
+                /* Act when the condition changes, and the first time. */
+                if( ( ( pxState->ulKnown & ulBit ) == 0 ) ||
+                    ( ( ( pxState->ulTrue & ulBit ) != 0 ) != ( a != 0 ) ) )
+                {
+                    pxState->ulKnown |= ulBit;
+                    pxState->ulTrue = ( a != 0 ) ? ( pxState->ulTrue | ulBit ) : ( pxState->ulTrue & ~ulBit );
+                    xAction( pvContext, pucCode[ 0 ], ( a != 0 ) ? pucCode[ 1 ] : !pucCode[ 1 ] );
+                }
+
+                pucCode += 2;
+                break;
+
+            default:
+                /* Binary operators. */
+                b = lStack[ --uxTop ];
+                a = lStack[ uxTop - 1 ];
+
+                switch( ( RuleOpcode_t ) pucCode[ -1 ] )
+                {
+                    case eRuleOpAdd:
+                        a = ( int32_t ) ( ( uint32_t ) a + ( uint32_t ) b );
+                        break;
+
+                    case eRuleOpSub:
+                        a = ( int32_t ) ( ( uint32_t ) a - ( uint32_t ) b );
+                        break;
+
+                    case eRuleOpGt:
+                        a = ( a > b );
+                        break;
+
+                    case eRuleOpGe:
+                        a = ( a >= b );
+                        break;
+
+                    case eRuleOpLt:
+                        a = ( a < b );
+                        break;
+
+                    case eRuleOpLe:
+                        a = ( a <= b );
+                        break;
+
+                    case eRuleOpEq:
+                        a = ( a == b );
+                        break;
+
+                    case eRuleOpNe:
+                        a = ( a != b );
+                        break;
+
+                    case eRuleOpAnd:
+                        a = ( ( a != 0 ) && ( b != 0 ) );
+                        break;
+
+                    default:
+                        a = ( ( a != 0 ) || ( b != 0 ) );
+                        break;
+                }
+
+                lStack[ uxTop - 1 ] = a;
+                break;
+        }
+    }
+}
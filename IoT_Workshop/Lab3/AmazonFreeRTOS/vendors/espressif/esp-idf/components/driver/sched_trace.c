@@ -0,0 +1,244 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file sched_trace.c
+ * @brief Scheduler trace ring and its console dump.
+ */
+
+/* FreeRTOS includes; FreeRTOSConfig.h decides whether tracing is on. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "driver/sched_trace.h"
+
+#if ( schedtraceENABLED == 1 )
+
+/* Standard includes. */
+    #include <stdbool.h>
+    #include <stdio.h>
+    #include <string.h>
+
+    #include "esp_attr.h"
+    #include "esp_timer.h"
+
+    #if ( schedtraceBUFFER_EVENTS & ( schedtraceBUFFER_EVENTS - 1 ) ) != 0
+        #error "schedtraceBUFFER_EVENTS must be a power of two."
+    #endif
+
+/**
+ * @brief Longest name kept, including the terminator.
+ */
+    #define schedtraceNAME_LENGTH    ( 16 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief One event; 16 bytes.
+ */
+    typedef struct SchedTraceRecord
+    {
+        uint32_t ulTime;        /**< Microseconds since boot, low 32 bits. */
+        const void * pvObject;  /**< Task, queue, interrupt number or span name. */
+        uint32_t ulValue;
+        uint8_t ucCore;
+        uint8_t ucEvent;        /**< SchedTraceEvent_t; written last, 0 while incomplete. */
+        uint16_t usReserved;
+    } SchedTraceRecord_t;
+
+    typedef struct SchedTraceName
+    {
+        const void * pvObject;
+        char cName[ schedtraceNAME_LENGTH ];
+    } SchedTraceName_t;
+
+    static SchedTraceRecord_t xRing[ schedtraceBUFFER_EVENTS ];
+    static SchedTraceName_t xNames[ schedtraceMAX_NAMES ];
+    static uint32_t ulNext = 0;    /**< Events reserved, free running. */
+    static uint32_t ulDropped = 0; /**< Events not kept because the ring was full. */
+    static uint32_t ulPaused = 0;  /**< Non-zero while the ring is being dumped. */
+    static bool xPolled = false;
+
+/*-----------------------------------------------------------*/
+
+    void IRAM_ATTR SchedTrace_Record( SchedTraceEvent_t xEvent,
+                                      const void * pvObject,
+                                      uint32_t ulValue )
+    {
+        SchedTraceRecord_t * pxRecord;
+        uint32_t ulIndex;
+
+        if( __atomic_load_n( &ulPaused, __ATOMIC_RELAXED ) != 0 )
+        {
+            return;
+        }
+
+        #if ( schedtraceSTOP_WHEN_FULL == 1 )
+            /* Checked first so that the counter stops growing. */
+            if( __atomic_load_n( &ulNext, __ATOMIC_RELAXED ) >= schedtraceBUFFER_EVENTS )
+            {
+                ( void ) __atomic_add_fetch( &ulDropped, 1, __ATOMIC_RELAXED );
+
+                return;
+            }
+        #endif
+
+        ulIndex = __atomic_fetch_add( &ulNext, 1, __ATOMIC_RELAXED );
+
+        #if ( schedtraceSTOP_WHEN_FULL == 1 )
+            if( ulIndex >= schedtraceBUFFER_EVENTS )
+            {
+                ( void ) __atomic_add_fetch( &ulDropped, 1, __ATOMIC_RELAXED );
+
+                return;
+            }
+        #endif
+
+        pxRecord = &( xRing[ ulIndex & ( schedtraceBUFFER_EVENTS - 1 ) ] );
+
+        __atomic_store_n( &( pxRecord->ucEvent ), 0, __ATOMIC_RELAXED );
+        pxRecord->ulTime = ( uint32_t ) esp_timer_get_time();
+        pxRecord->pvObject = pvObject;
+        pxRecord->ulValue = ulValue;
+        pxRecord->ucCore = ( uint8_t ) xPortGetCoreID();
+        __atomic_store_n( &( pxRecord->ucEvent ), ( uint8_t ) xEvent, __ATOMIC_RELEASE );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IRAM_ATTR SchedTrace_Name( const void * pvObject,
+                                    const char * pcName )
+    {
+        const void * pvExpected;
+        size_t x, xChar;
+
+        for( x = 0; x < schedtraceMAX_NAMES; x++ )
+        {
+            pvExpected = NULL;
+
+            /* A slot is either free or taken for good; a new task may reuse
+             * the address of a deleted one, and then renames its slot. */
+            if( ( __atomic_load_n( &( xNames[ x ].pvObject ), __ATOMIC_ACQUIRE ) == pvObject ) ||
+                ( __atomic_compare_exchange_n( &( xNames[ x ].pvObject ), &pvExpected, pvObject,
+                                               false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) == true ) )
+            {
+                for( xChar = 0; ( xChar < schedtraceNAME_LENGTH - 1 ) && ( pcName[ xChar ] != '\0' ); xChar++ )
+                {
+                    xNames[ x ].cName[ xChar ] = pcName[ xChar ];
+                }
+
+                xNames[ x ].cName[ xChar ] = '\0';
+                break;
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void SchedTrace_Dump( void )
+    {
+        const SchedTraceRecord_t * pxRecord;
+        uint32_t ulEnd, ulCount, ulIndex;
+        size_t x;
+
+        __atomic_store_n( &ulPaused, 1, __ATOMIC_SEQ_CST );
+
+        /* Let an event being written on the other core complete. */
+        vTaskDelay( 1 );
+
+        ulEnd = __atomic_load_n( &ulNext, __ATOMIC_ACQUIRE );
+
+        #if ( schedtraceSTOP_WHEN_FULL == 1 )
+            /* Reservations past the end were refused, and already counted
+             * as dropped. */
+            if( ulEnd > schedtraceBUFFER_EVENTS )
+            {
+                ulEnd = schedtraceBUFFER_EVENTS;
+            }
+        #endif
+
+        ulCount = ( ulEnd < schedtraceBUFFER_EVENTS ) ? ulEnd : schedtraceBUFFER_EVENTS;
+
+        printf( "SCHED,BEGIN,%u,%lu,%lu\n",
+                ( unsigned ) portNUM_PROCESSORS,
+                ( unsigned long ) ulCount,
+                ( unsigned long ) ( ulDropped + ( ulEnd - ulCount ) ) );
+
+        for( x = 0; x < schedtraceMAX_NAMES; x++ )
+        {
+            if( xNames[ x ].pvObject != NULL )
+            {
+                printf( "SCHED,N,%08lx,%s\n",
+                        ( unsigned long ) ( uintptr_t ) xNames[ x ].pvObject,
+                        xNames[ x ].cName );
+            }
+        }
+
+        for( ulIndex = ulEnd - ulCount; ulIndex != ulEnd; ulIndex++ )
+        {
+            pxRecord = &( xRing[ ulIndex & ( schedtraceBUFFER_EVENTS - 1 ) ] );
+
+            if( pxRecord->ucEvent == 0 )
+            {
+                continue;
+            }
+
+            printf( "SCHED,%lu,%u,%c,%08lx,%lu",
+                    ( unsigned long ) pxRecord->ulTime,
+                    ( unsigned ) pxRecord->ucCore,
+                    ( char ) pxRecord->ucEvent,
+                    ( unsigned long ) ( uintptr_t ) pxRecord->pvObject,
+                    ( unsigned long ) pxRecord->ulValue );
+
+            /* Span names are string literals; print them in place. */
+            if( ( pxRecord->ucEvent == eSchedTraceSpanBegin ) || ( pxRecord->ucEvent == eSchedTraceSpanEnd ) )
+            {
+                printf( ",%s", ( const char * ) pxRecord->pvObject );
+            }
+
+            printf( "\n" );
+        }
+
+        printf( "SCHED,END\n" );
+
+        memset( xRing, 0x00, sizeof( xRing ) );
+        ulDropped = 0;
+        __atomic_store_n( &ulNext, 0, __ATOMIC_RELEASE );
+        __atomic_store_n( &ulPaused, 0, __ATOMIC_SEQ_CST );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void SchedTrace_Poll( void )
+    {
+        if( ( xPolled == false ) &&
+            ( __atomic_load_n( &ulNext, __ATOMIC_RELAXED ) >= schedtraceBUFFER_EVENTS ) )
+        {
+            xPolled = true;
+            SchedTrace_Dump();
+        }
+    }
+
+#endif /* if ( schedtraceENABLED == 1 ) */
@@ -0,0 +1,155 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file spsc_ring.c
+ * @brief Single-producer, single-consumer ring.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "driver/spsc_ring.h"
+
+/*-----------------------------------------------------------*/
+
+bool SpscRing_Init( SpscRing_t * pxRing,
+                    void * pvStorage,
+                    size_t uxItemSize,
+                    size_t uxLength )
+{
+    if( ( uxLength == 0 ) || ( ( uxLength & ( uxLength - 1 ) ) != 0 ) )
+    {
+        return false;
+    }
+
+    ( void ) memset( pxRing, 0x00, sizeof( SpscRing_t ) );
+    pxRing->pucStorage = ( uint8_t * ) pvStorage;
+    pxRing->uxItemSize = uxItemSize;
+    pxRing->ulMask = ( uint32_t ) ( uxLength - 1 );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool SpscRing_Push( SpscRing_t * pxRing,
+                    const void * pvItem )
+{
+    uint32_t ulHead = __atomic_load_n( &( pxRing->ulHead ), __ATOMIC_RELAXED );
+
+    if( ( ulHead - pxRing->ulTailCache ) > pxRing->ulMask )
+    {
+        /* Full as far as the producer knows; look at the real tail. */
+        pxRing->ulTailCache = __atomic_load_n( &( pxRing->ulTail ), __ATOMIC_ACQUIRE );
+
+        if( ( ulHead - pxRing->ulTailCache ) > pxRing->ulMask )
+        {
+            return false;
+        }
+    }
+
+    ( void ) memcpy( pxRing->pucStorage + ( ( ulHead & pxRing->ulMask ) * pxRing->uxItemSize ),
+                     pvItem,
+                     pxRing->uxItemSize );
+
+    /* The item is complete before the consumer can see it. */
+    __atomic_store_n( &( pxRing->ulHead ), ulHead + 1, __ATOMIC_RELEASE );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t SpscRing_PopBatch( SpscRing_t * pxRing,
+                          void * pvItems,
+                          size_t uxMaxItems )
+{
+    uint32_t ulTail = __atomic_load_n( &( pxRing->ulTail ), __ATOMIC_RELAXED );
+    uint32_t ulAvailable = pxRing->ulHeadCache - ulTail;
+    uint32_t ulIndex, ulFirst;
+    size_t uxCount;
+
+    if( ulAvailable == 0 )
+    {
+        /* Empty as far as the consumer knows; look at the real head. */
+        pxRing->ulHeadCache = __atomic_load_n( &( pxRing->ulHead ), __ATOMIC_ACQUIRE );
+        ulAvailable = pxRing->ulHeadCache - ulTail;
+
+        if( ulAvailable == 0 )
+        {
+            return 0;
+        }
+    }
+
+    uxCount = ( ulAvailable < uxMaxItems ) ? ulAvailable : uxMaxItems;
+
+    /* At most two copies: up to the end of the storage, then from its
+     * start. */
+    ulIndex = ulTail & pxRing->ulMask;
+    ulFirst = pxRing->ulMask + 1 - ulIndex;
+
+    if( ulFirst > uxCount )
+    {
+        ulFirst = ( uint32_t ) uxCount;
+    }
+
+    ( void ) memcpy( pvItems,
+                     pxRing->pucStorage + ( ulIndex * pxRing->uxItemSize ),
+                     ulFirst * pxRing->uxItemSize );
+
+    if( ulFirst < uxCount )
+    {
+        ( void ) memcpy( ( uint8_t * ) pvItems + ( ulFirst * pxRing->uxItemSize ),
+                         pxRing->pucStorage,
+                         ( uxCount - ulFirst ) * pxRing->uxItemSize );
+    }
+
+    /* The slots are copied out before the producer can reuse them. */
+    __atomic_store_n( &( pxRing->ulTail ), ulTail + ( uint32_t ) uxCount, __ATOMIC_RELEASE );
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t SpscRing_Count( const SpscRing_t * pxRing )
+{
+    /* Tail first: the head read after it is never behind it, but both
+     * sides may have moved in between. */
+    uint32_t ulTail = __atomic_load_n( &( pxRing->ulTail ), __ATOMIC_ACQUIRE );
+    uint32_t ulHead = __atomic_load_n( &( pxRing->ulHead ), __ATOMIC_ACQUIRE );
+    uint32_t ulCount = ulHead - ulTail;
+
+    return ( size_t ) ( ( ulCount > pxRing->ulMask ) ? pxRing->ulMask + 1 : ulCount );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t SpscRing_Capacity( const SpscRing_t * pxRing )
+{
+    return ( size_t ) pxRing->ulMask + 1;
+}
@@ -0,0 +1,256 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file stack_budget.c
+ * @brief Peak stack use of the demo tasks, printed as a config header.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "driver/stack_budget.h"
+
+/*-----------------------------------------------------------*/
+
+typedef struct StackBudgetTask
+{
+    TaskHandle_t xTask;     /**< NULL once the task has exited. */
+    const char * pcMacro;   /**< NULL while the slot is free. */
+    char cName[ configMAX_TASK_NAME_LEN ];
+    uint32_t ulStackSize;
+    uint32_t ulPeak;
+} StackBudgetTask_t;
+
+static StackBudgetTask_t xTasks[ stackbudgetMAX_TASKS ];
+static bool xReported = false;
+
+/* Held while a handle is read, so that a task cannot exit, and its stack
+ * be freed, while it is measured. */
+static portMUX_TYPE xLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the lock held. */
+static void prvSample( StackBudgetTask_t * pxEntry )
+{
+    uint32_t ulUnused;
+
+    if( pxEntry->xTask != NULL )
+    {
+        ulUnused = ( uint32_t ) uxTaskGetStackHighWaterMark( pxEntry->xTask );
+
+        if( ( ulUnused < pxEntry->ulStackSize ) &&
+            ( pxEntry->ulStackSize - ulUnused > pxEntry->ulPeak ) )
+        {
+            pxEntry->ulPeak = pxEntry->ulStackSize - ulUnused;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBudget( uint32_t ulPeak )
+{
+    uint32_t ulBudget = ulPeak + ( ulPeak * stackbudgetMARGIN_PERCENT + 99 ) / 100;
+
+    ulBudget = ( ulBudget + stackbudgetGRANULE - 1 ) / stackbudgetGRANULE * stackbudgetGRANULE;
+
+    return ( ulBudget < configMINIMAL_STACK_SIZE ) ? configMINIMAL_STACK_SIZE : ulBudget;
+}
+
+/*-----------------------------------------------------------*/
+
+void StackBudget_Register( TaskHandle_t xTask,
+                           const char * pcMacro,
+                           uint32_t ulStackSize )
+{
+    const char * pcName;
+    StackBudgetTask_t * pxFree = NULL;
+    StackBudgetTask_t * pxEntry = NULL;
+    size_t x;
+
+    if( xTask == NULL )
+    {
+        xTask = xTaskGetCurrentTaskHandle();
+    }
+
+    pcName = pcTaskGetTaskName( xTask );
+
+    taskENTER_CRITICAL( &xLock );
+
+    for( x = 0; ( x < stackbudgetMAX_TASKS ) && ( pxEntry == NULL ); x++ )
+    {
+        if( xTasks[ x ].pcMacro == NULL )
+        {
+            pxFree = ( pxFree == NULL ) ? &( xTasks[ x ] ) : pxFree;
+        }
+        else if( ( xTasks[ x ].xTask == xTask ) ||
+                 ( ( xTasks[ x ].xTask == NULL ) &&
+                   ( strcmp( xTasks[ x ].pcMacro, pcMacro ) == 0 ) &&
+                   ( strncmp( xTasks[ x ].cName, pcName, sizeof( xTasks[ x ].cName ) ) == 0 ) ) )
+        {
+            pxEntry = &( xTasks[ x ] );
+        }
+    }
+
+    if( pxEntry == NULL )
+    {
+        pxEntry = pxFree;
+
+        if( pxEntry != NULL )
+        {
+            pxEntry->pcMacro = pcMacro;
+            strncpy( pxEntry->cName, pcName, sizeof( pxEntry->cName ) - 1 );
+            pxEntry->ulPeak = 0;
+        }
+    }
+
+    if( pxEntry != NULL )
+    {
+        pxEntry->xTask = xTask;
+        pxEntry->ulStackSize = ulStackSize;
+    }
+
+    taskEXIT_CRITICAL( &xLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void StackBudget_TaskExit( void )
+{
+    TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+    size_t x;
+
+    taskENTER_CRITICAL( &xLock );
+
+    for( x = 0; x < stackbudgetMAX_TASKS; x++ )
+    {
+        if( xTasks[ x ].xTask == xTask )
+        {
+            prvSample( &( xTasks[ x ] ) );
+            xTasks[ x ].xTask = NULL;
+        }
+    }
+
+    taskEXIT_CRITICAL( &xLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void StackBudget_Report( void )
+{
+    static StackBudgetTask_t xCopy[ stackbudgetMAX_TASKS ];
+    uint32_t ulBudget;
+    size_t x, y;
+
+    if( __atomic_exchange_n( &xReported, true, __ATOMIC_ACQ_REL ) == true )
+    {
+        return;
+    }
+
+    /* Sample under the lock, print from a copy. */
+    taskENTER_CRITICAL( &xLock );
+
+    for( x = 0; x < stackbudgetMAX_TASKS; x++ )
+    {
+        prvSample( &( xTasks[ x ] ) );
+    }
+
+    memcpy( xCopy, xTasks, sizeof( xCopy ) );
+
+    taskEXIT_CRITICAL( &xLock );
+
+    printf( "/* stack_budget begin */\n"
+            "#ifndef _AWS_DEMO_STACK_BUDGET_H_\n"
+            "#define _AWS_DEMO_STACK_BUDGET_H_\n\n"
+            "/* Peak stack use plus %u%%, measured by driver/stack_budget.c. */\n"
+            "/* Heap: %u bytes free at the low watermark. */\n",
+            ( unsigned ) stackbudgetMARGIN_PERCENT,
+            ( unsigned ) xPortGetMinimumEverFreeHeapSize() );
+
+    for( x = 0; x < stackbudgetMAX_TASKS; x++ )
+    {
+        if( xCopy[ x ].pcMacro == NULL )
+        {
+            continue;
+        }
+
+        /* A macro may size several tasks; it is printed at its first one. */
+        for( y = 0; y < x; y++ )
+        {
+            if( ( xCopy[ y ].pcMacro != NULL ) && ( strcmp( xCopy[ y ].pcMacro, xCopy[ x ].pcMacro ) == 0 ) )
+            {
+                break;
+            }
+        }
+
+        if( y < x )
+        {
+            continue;
+        }
+
+        printf( "\n" );
+        ulBudget = 0;
+
+        for( y = x; y < stackbudgetMAX_TASKS; y++ )
+        {
+            if( ( xCopy[ y ].pcMacro != NULL ) && ( strcmp( xCopy[ y ].pcMacro, xCopy[ x ].pcMacro ) == 0 ) )
+            {
+                printf( "/* %s: %lu of %lu used. */\n",
+                        xCopy[ y ].cName,
+                        ( unsigned long ) xCopy[ y ].ulPeak,
+                        ( unsigned long ) xCopy[ y ].ulStackSize );
+
+                if( ( xCopy[ y ].ulPeak > 0 ) && ( prvBudget( xCopy[ y ].ulPeak ) > ulBudget ) )
+                {
+                    ulBudget = prvBudget( xCopy[ y ].ulPeak );
+                }
+            }
+        }
+
+        /* A task deleted without StackBudget_TaskExit() was never read. */
+        if( ulBudget == 0 )
+        {
+            printf( "/* %s not measured; left as is. */\n", xCopy[ x ].pcMacro );
+        }
+        else
+        {
+            printf( "#undef %s\n#define %s    ( %lu )\n",
+                    xCopy[ x ].pcMacro,
+                    xCopy[ x ].pcMacro,
+                    ( unsigned long ) ulBudget );
+        }
+    }
+
+    printf( "\n#endif /* _AWS_DEMO_STACK_BUDGET_H_ */\n"
+            "/* stack_budget end */\n" );
+}
@@ -0,0 +1,271 @@
+/*
+ * Amazon FreeRTOS V201906.00 Major
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file tls_session_cache.c
+ * @brief Per endpoint TLS sessions for abbreviated handshakes.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "driver/tls_session_cache.h"
+
+/*-----------------------------------------------------------*/
+
+typedef struct TlsSessionEntry
+{
+    char cHost[ tlssessionMAX_HOST_LENGTH ]; /**< Empty while the slot is free. */
+    uint16_t usPort;
+    uint32_t ulTrustHash;
+    BaseType_t xValid;                       /**< pdTRUE while xSession holds a session. */
+    mbedtls_ssl_session xSession;
+    TlsSessionStats_t xStats;
+} TlsSessionEntry_t;
+
+static TlsSessionEntry_t xEntries[ tlssessionMAX_ENDPOINTS ];
+static size_t xNextEviction = 0;
+
+/* A mutex rather than a critical section: copying a session allocates. */
+static SemaphoreHandle_t xLock = NULL;
+
+/*-----------------------------------------------------------*/
+
+/* FNV-1a, enough to tell the CAs of two discovery documents apart. */
+static uint32_t prvHash( const char * pcData,
+                         size_t xLength )
+{
+    uint32_t ulHash = 2166136261UL;
+    size_t x;
+
+    for( x = 0; ( pcData != NULL ) && ( x < xLength ); x++ )
+    {
+        ulHash = ( ulHash ^ ( uint8_t ) pcData[ x ] ) * 16777619UL;
+    }
+
+    return ulHash;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Called for each certificate of the server's chain, which a resumed
+ * handshake does not send. The verification result is left alone. */
+static int prvVerify( void * pvHandshake,
+                      mbedtls_x509_crt * pxCertificate,
+                      int lDepth,
+                      uint32_t * pulFlags )
+{
+    ( void ) pxCertificate;
+    ( void ) lDepth;
+    ( void ) pulFlags;
+
+    ( ( TlsSessionHandshake_t * ) pvHandshake )->xCertificateVerified = pdTRUE;
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the lock held. */
+static TlsSessionEntry_t * prvFind( const char * pcHost,
+                                    uint16_t usPort )
+{
+    size_t x;
+
+    for( x = 0; x < tlssessionMAX_ENDPOINTS; x++ )
+    {
+        if( ( xEntries[ x ].cHost[ 0 ] != '\0' ) &&
+            ( xEntries[ x ].usPort == usPort ) &&
+            ( strncmp( xEntries[ x ].cHost, pcHost, sizeof( xEntries[ x ].cHost ) - 1 ) == 0 ) )
+        {
+            return &( xEntries[ x ] );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the lock held. */
+static void prvForget( TlsSessionEntry_t * pxEntry )
+{
+    if( pxEntry->xValid == pdTRUE )
+    {
+        mbedtls_ssl_session_free( &( pxEntry->xSession ) );
+        pxEntry->xValid = pdFALSE;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void TlsSessionCache_Init( void )
+{
+    if( xLock == NULL )
+    {
+        xLock = xSemaphoreCreateMutex();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void TlsSessionCache_Begin( TlsSessionHandshake_t * pxHandshake,
+                            mbedtls_ssl_config * pxConfig,
+                            mbedtls_ssl_context * pxSsl,
+                            const char * pcHost,
+                            uint16_t usPort,
+                            const char * pcTrustedCa,
+                            size_t xTrustedCaLength )
+{
+    TlsSessionEntry_t * pxEntry;
+
+    memset( pxHandshake, 0x00, sizeof( TlsSessionHandshake_t ) );
+    pxHandshake->pcHost = pcHost;
+    pxHandshake->usPort = usPort;
+    pxHandshake->ulTrustHash = prvHash( pcTrustedCa, xTrustedCaLength );
+
+    mbedtls_ssl_conf_verify( pxConfig, prvVerify, pxHandshake );
+
+    if( ( pcHost == NULL ) || ( xLock == NULL ) )
+    {
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    pxEntry = prvFind( pcHost, usPort );
+
+    if( ( pxEntry != NULL ) && ( pxEntry->xValid == pdTRUE ) &&
+        ( pxEntry->ulTrustHash == pxHandshake->ulTrustHash ) )
+    {
+        pxHandshake->xOffered = ( mbedtls_ssl_set_session( pxSsl, &( pxEntry->xSession ) ) == 0 ) ? pdTRUE : pdFALSE;
+    }
+
+    xSemaphoreGive( xLock );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TlsSessionCache_End( TlsSessionHandshake_t * pxHandshake,
+                                const mbedtls_ssl_context * pxSsl,
+                                int lResult )
+{
+    TlsSessionEntry_t * pxEntry;
+    BaseType_t xResumed = ( ( lResult == 0 ) &&
+                            ( pxHandshake->xOffered == pdTRUE ) &&
+                            ( pxHandshake->xCertificateVerified == pdFALSE ) ) ? pdTRUE : pdFALSE;
+
+    if( ( pxHandshake->pcHost == NULL ) || ( xLock == NULL ) )
+    {
+        return xResumed;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    pxEntry = prvFind( pxHandshake->pcHost, pxHandshake->usPort );
+
+    if( lResult != 0 )
+    {
+        /* The server may have failed on the session; the next attempt
+         * starts afresh. */
+        if( ( pxEntry != NULL ) && ( pxHandshake->xOffered == pdTRUE ) )
+        {
+            prvForget( pxEntry );
+        }
+    }
+    else
+    {
+        if( pxEntry == NULL )
+        {
+            pxEntry = &( xEntries[ xNextEviction ] );
+            xNextEviction = ( xNextEviction + 1 ) % tlssessionMAX_ENDPOINTS;
+
+            prvForget( pxEntry );
+            memset( pxEntry, 0x00, sizeof( TlsSessionEntry_t ) );
+            strncpy( pxEntry->cHost, pxHandshake->pcHost, sizeof( pxEntry->cHost ) - 1 );
+            pxEntry->usPort = pxHandshake->usPort;
+        }
+
+        /* Kept after a resumed handshake too, for a renewed ticket. */
+        prvForget( pxEntry );
+        mbedtls_ssl_session_init( &( pxEntry->xSession ) );
+
+        if( mbedtls_ssl_get_session( pxSsl, &( pxEntry->xSession ) ) == 0 )
+        {
+            pxEntry->xValid = pdTRUE;
+            pxEntry->ulTrustHash = pxHandshake->ulTrustHash;
+        }
+        else
+        {
+            mbedtls_ssl_session_free( &( pxEntry->xSession ) );
+        }
+
+        if( xResumed == pdTRUE )
+        {
+            pxEntry->xStats.ulResumed++;
+        }
+        else
+        {
+            pxEntry->xStats.ulFull++;
+        }
+
+        pxEntry->xStats.xLastResumed = xResumed;
+    }
+
+    xSemaphoreGive( xLock );
+
+    return xResumed;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TlsSessionCache_GetStats( const char * pcHost,
+                                     uint16_t usPort,
+                                     TlsSessionStats_t * pxStats )
+{
+    const TlsSessionEntry_t * pxEntry;
+
+    if( ( pcHost == NULL ) || ( xLock == NULL ) )
+    {
+        return pdFAIL;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    pxEntry = prvFind( pcHost, usPort );
+
+    if( pxEntry != NULL )
+    {
+        *pxStats = pxEntry->xStats;
+    }
+
+    xSemaphoreGive( xLock );
+
+    return ( pxEntry != NULL ) ? pdPASS : pdFAIL;
+}
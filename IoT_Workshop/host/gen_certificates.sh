@@ -0,0 +1,33 @@
+#!/bin/sh
+# Writes to stdout the C file of the certificates declared in host_port.h:
+# a CA, and a server certificate it signs for "localhost" and 127.0.0.1.
+# The keys and PEM files are left in the directory given.
+
+set -e
+
+OPENSSL=${OPENSSL:-openssl}
+DIR=$1
+
+"$OPENSSL" req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+    -keyout "$DIR/ca.key" -out "$DIR/ca.pem" -days 3650 \
+    -subj "/CN=Host stand-in CA" 2> /dev/null
+"$OPENSSL" req -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+    -keyout "$DIR/server.key" -out "$DIR/server.csr" \
+    -subj "/CN=localhost" 2> /dev/null
+printf 'subjectAltName=DNS:localhost,IP:127.0.0.1\n' > "$DIR/server.ext"
+"$OPENSSL" x509 -req -in "$DIR/server.csr" -CA "$DIR/ca.pem" -CAkey "$DIR/ca.key" \
+    -CAcreateserial -out "$DIR/server.pem" -days 3650 -extfile "$DIR/server.ext" 2> /dev/null
+"$OPENSSL" pkey -in "$DIR/server.key" -out "$DIR/server_key.pem"
+
+# Each PEM as a C string; the size counts the terminating NUL.
+pem()
+{
+    printf 'const char %s[] =\n' "$2"
+    sed 's/.*/    "&\\n"/' "$1"
+    printf ';\nconst uint32_t %s = sizeof( %s );\n\n' "$3" "$2"
+}
+
+printf '/* Generated by gen_certificates.sh. */\n\n#include <stdint.h>\n\n'
+pem "$DIR/ca.pem" pcHostCaCertificate ulHostCaCertificateSize
+pem "$DIR/server.pem" pcHostServerCertificate ulHostServerCertificateSize
+pem "$DIR/server_key.pem" pcHostServerKey ulHostServerKeySize
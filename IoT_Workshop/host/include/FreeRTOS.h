@@ -0,0 +1,116 @@
+/*
+ * FreeRTOS.h of the host build.
+ *
+ * The kernel types and the configuration the demos read, for the FreeRTOS
+ * API of port/freertos_posix.c, which runs every task on a POSIX thread.
+ * The values follow the ESP32 build of the labs where the demos depend on
+ * them (stack sizes in bytes, two cores); the tick is 1 ms.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef int32_t    BaseType_t;
+typedef uint32_t   UBaseType_t;
+typedef uint32_t   TickType_t;
+typedef uint8_t    StackType_t;
+
+#define pdFALSE                                ( ( BaseType_t ) 0 )
+#define pdTRUE                                 ( ( BaseType_t ) 1 )
+#define pdFAIL                                 ( pdFALSE )
+#define pdPASS                                 ( pdTRUE )
+#define errQUEUE_EMPTY                         ( ( BaseType_t ) 0 )
+#define errQUEUE_FULL                          ( ( BaseType_t ) 0 )
+#define pdFREERTOS_ERRNO_NONE                  ( 0 )
+#define pdFREERTOS_ERRNO_ENOMEM                ( 12 )
+
+#define configTICK_RATE_HZ                     ( 1000 )
+#define configCPU_CLOCK_HZ                     ( 240000000UL )
+#define configMAX_PRIORITIES                   ( 25 )
+#define configMINIMAL_STACK_SIZE               ( 768 )
+#define configMAX_TASK_NAME_LEN                ( 16 )
+#define configUSE_TRACE_FACILITY               ( 1 )
+#define configGENERATE_RUN_TIME_STATS          ( 1 )
+#define configSUPPORT_STATIC_ALLOCATION        ( 1 )
+#define configSUPPORT_DYNAMIC_ALLOCATION       ( 1 )
+#define INCLUDE_uxTaskGetStackHighWaterMark    ( 1 )
+
+#define configASSERT( x )                      assert( x )
+#define configPRINTF( X )                      vLoggingPrintf X
+
+#define portMAX_DELAY                          ( ( TickType_t ) 0xffffffffUL )
+#define portTICK_PERIOD_MS                     ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portNUM_PROCESSORS                     ( 2 )
+#define pdMS_TO_TICKS( xTimeInMs )             ( ( TickType_t ) ( ( ( uint64_t ) ( xTimeInMs ) * configTICK_RATE_HZ ) / 1000 ) )
+
+#define tskIDLE_PRIORITY                       ( ( UBaseType_t ) 0 )
+#define tskNO_AFFINITY                         ( ( BaseType_t ) 0x7fffffff )
+
+/* Interrupts are host threads too; a critical section is one process-wide
+ * recursive lock, whatever spinlock the ESP32 code names. */
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED           ( 0 )
+#define portENTER_CRITICAL( pxMux )            ( ( void ) ( pxMux ), vPortEnterCritical() )
+#define portEXIT_CRITICAL( pxMux )             ( ( void ) ( pxMux ), vPortExitCritical() )
+#define portENTER_CRITICAL_ISR( pxMux )        ( ( void ) ( pxMux ), vPortEnterCritical() )
+#define portEXIT_CRITICAL_ISR( pxMux )         ( ( void ) ( pxMux ), vPortExitCritical() )
+#define portYIELD_FROM_ISR()                   vPortYield()
+
+#ifndef IRAM_ATTR
+    #define IRAM_ATTR
+#endif
+
+void vPortEnterCritical( void );
+void vPortExitCritical( void );
+void vPortYield( void );
+BaseType_t xPortGetCoreID( void );
+
+void * pvPortMalloc( size_t xSize );
+void vPortFree( void * pv );
+size_t xPortGetFreeHeapSize( void );
+size_t xPortGetMinimumEverFreeHeapSize( void );
+
+/* Lines of configPRINTF are written whole, with the tick in front. */
+void vLoggingPrintf( const char * pcFormat,
+                     ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+#include "task.h"
+#include "queue.h"
+#include "timers.h"
+
+/* The scheduler trace of driver/sched_trace.h, turned on with
+ * -DschedtraceENABLED=1 as FreeRTOSConfig.h does on the ESP32. Tasks are
+ * threads here, so port/freertos_posix.c reports one as switched in when
+ * it starts and whenever it wakes from a wait in the port. */
+#if defined( schedtraceENABLED ) && ( schedtraceENABLED == 1 )
+    #define schedtraceCURRENT_TCB()    xTaskGetCurrentTaskHandle()
+    #include "driver/sched_trace.h"
+#endif
+
+#ifndef traceTASK_SWITCHED_IN
+    #define traceTASK_SWITCHED_IN()
+#endif
+#ifndef traceTASK_CREATE
+    #define traceTASK_CREATE( pxNewTCB )
+#endif
+#ifndef traceQUEUE_SEND
+    #define traceQUEUE_SEND( pxQueue )
+#endif
+#ifndef traceQUEUE_SEND_FAILED
+    #define traceQUEUE_SEND_FAILED( pxQueue )
+#endif
+#ifndef traceQUEUE_RECEIVE
+    #define traceQUEUE_RECEIVE( pxQueue )
+#endif
+#ifndef traceBLOCKING_ON_QUEUE_RECEIVE
+    #define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )
+#endif
+
+#endif /* ifndef HOST_FREERTOS_H_ */
@@ -0,0 +1,23 @@
+/*
+ * aws_clientcredential.h of the host build. The endpoint is this host,
+ * where the stand-ins of host_port.h listen in place of AWS IoT Core and
+ * its Greengrass discovery service. Define the ports on the compiler
+ * command line to move them.
+ */
+
+#ifndef HOST_AWS_CLIENTCREDENTIAL_H_
+#define HOST_AWS_CLIENTCREDENTIAL_H_
+
+#define clientcredentialMQTT_BROKER_ENDPOINT          "localhost"
+
+#ifndef clientcredentialMQTT_BROKER_PORT
+    #define clientcredentialMQTT_BROKER_PORT          18883
+#endif
+
+#ifndef clientcredentialGREENGRASS_DISCOVERY_PORT
+    #define clientcredentialGREENGRASS_DISCOVERY_PORT    18443
+#endif
+
+#define clientcredentialIOT_THING_NAME                "HostThing"
+
+#endif /* ifndef HOST_AWS_CLIENTCREDENTIAL_H_ */
@@ -0,0 +1,9 @@
+/*
+ * aws_ggd_config.h of the host build: the defaults of
+ * aws_ggd_config_defaults.h are kept.
+ */
+
+#ifndef HOST_AWS_GGD_CONFIG_H_
+#define HOST_AWS_GGD_CONFIG_H_
+
+#endif /* ifndef HOST_AWS_GGD_CONFIG_H_ */
@@ -0,0 +1,9 @@
+/*
+ * aws_ggd_config_defaults.h of the host build. The demo reads none of the
+ * settings of the discovery library, which it no longer calls.
+ */
+
+#ifndef HOST_AWS_GGD_CONFIG_DEFAULTS_H_
+#define HOST_AWS_GGD_CONFIG_DEFAULTS_H_
+
+#endif /* ifndef HOST_AWS_GGD_CONFIG_DEFAULTS_H_ */
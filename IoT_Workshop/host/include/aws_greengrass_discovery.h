@@ -0,0 +1,19 @@
+/*
+ * aws_greengrass_discovery.h of the host build. The demo only takes the
+ * address type from the library; the discovery document is fetched and
+ * parsed by the demo itself (aws_ggd_parser.h).
+ */
+
+#ifndef HOST_AWS_GREENGRASS_DISCOVERY_H_
+#define HOST_AWS_GREENGRASS_DISCOVERY_H_
+
+#include "FreeRTOS.h"
+
+typedef struct
+{
+    char * pcHostAddress;
+    char * pcCertificate;
+    uint32_t ulCertificateSize;
+} GGD_HostAddressData_t;
+
+#endif /* ifndef HOST_AWS_GREENGRASS_DISCOVERY_H_ */
@@ -0,0 +1,123 @@
+/*
+ * aws_mqtt_agent.h of the host build: the MQTT agent of Amazon FreeRTOS
+ * V201906, which wraps the MQTT v4 library, over the client of
+ * port/mqtt_client.c and the network of port/network_afr.c
+ * (port/mqtt_agent.c). At most mqttconfigMAX_BROKERS agents exist at once.
+ */
+
+#ifndef HOST_AWS_MQTT_AGENT_H_
+#define HOST_AWS_MQTT_AGENT_H_
+
+#include "FreeRTOS.h"
+
+typedef void * MQTTAgentHandle_t;
+
+typedef enum
+{
+    eMQTTFalse = 0,
+    eMQTTTrue = 1
+} MQTTBool_t;
+
+typedef enum
+{
+    eMQTTQoS0 = 0,
+    eMQTTQoS1 = 1,
+    eMQTTQoS2 = 2
+} MQTTQoS_t;
+
+typedef enum
+{
+    eMQTTAgentSuccess,
+    eMQTTAgentFailure,
+    eMQTTAgentTimeout,
+    eMQTTAgentAPICalledFromCallback
+} MQTTAgentReturnCode_t;
+
+typedef enum
+{
+    eMQTTAgentPublish,
+    eMQTTAgentDisconnect
+} MQTTAgentEvent_t;
+
+typedef struct MQTTPublishData
+{
+    const void * pxBuffer;
+    MQTTQoS_t xQos;
+    const uint8_t * pucTopic;
+    uint16_t usTopicLength;
+    const void * pvData;
+    uint32_t ulDataLength;
+} MQTTPublishData_t;
+
+typedef struct MQTTAgentCallbackParams
+{
+    MQTTAgentEvent_t xMQTTEvent;
+    MQTTPublishData_t xPublishData;
+} MQTTAgentCallbackParams_t;
+
+typedef BaseType_t ( * MQTTAgentCallback_t )( void * pvUserData,
+                                              const MQTTAgentCallbackParams_t * const pxCallbackParams );
+typedef MQTTBool_t ( * MQTTPublishCallback_t )( void * pvPublishCallbackContext,
+                                                const MQTTPublishData_t * const pxPublishData );
+
+#define mqttagentURL_IS_IP_ADDRESS       0x00000001
+#define mqttagentREQUIRE_TLS             0x00000002
+#define mqttagentUSE_AWS_IOT_ALPN_443    0x00000004
+
+typedef struct MQTTAgentConnectParams
+{
+    const char * pcURL;
+    BaseType_t xFlags;
+    BaseType_t xURLIsIPAddress;
+    uint16_t usPort;
+    const uint8_t * pucClientId;
+    uint16_t usClientIdLength;
+    BaseType_t xSecuredConnection;
+    void * pvUserData;
+    MQTTAgentCallback_t pxCallback;
+    char * pcCertificate;
+    uint32_t ulCertificateSize;
+} MQTTAgentConnectParams_t;
+
+typedef struct MQTTAgentSubscribeParams
+{
+    const uint8_t * pucTopic;
+    uint16_t usTopicLength;
+    MQTTQoS_t xQoS;
+    void * pvPublishCallbackContext;
+    MQTTPublishCallback_t pxPublishCallback;
+} MQTTAgentSubscribeParams_t;
+
+typedef struct MQTTAgentUnsubscribeParams
+{
+    const uint8_t * pucTopic;
+    uint16_t usTopicLength;
+} MQTTAgentUnsubscribeParams_t;
+
+typedef struct MQTTAgentPublishParams
+{
+    const uint8_t * pucTopic;
+    uint16_t usTopicLength;
+    MQTTQoS_t xQoS;
+    const void * pvData;
+    uint32_t ulDataLength;
+} MQTTAgentPublishParams_t;
+
+MQTTAgentReturnCode_t MQTT_AGENT_Create( MQTTAgentHandle_t * const pxMQTTHandle );
+MQTTAgentReturnCode_t MQTT_AGENT_Delete( MQTTAgentHandle_t xMQTTHandle );
+MQTTAgentReturnCode_t MQTT_AGENT_Connect( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentConnectParams_t * const pxConnectParams,
+                                          TickType_t xTimeoutTicks );
+MQTTAgentReturnCode_t MQTT_AGENT_Disconnect( MQTTAgentHandle_t xMQTTHandle,
+                                             TickType_t xTimeoutTicks );
+MQTTAgentReturnCode_t MQTT_AGENT_Subscribe( MQTTAgentHandle_t xMQTTHandle,
+                                            const MQTTAgentSubscribeParams_t * const pxSubscribeParams,
+                                            TickType_t xTimeoutTicks );
+MQTTAgentReturnCode_t MQTT_AGENT_Unsubscribe( MQTTAgentHandle_t xMQTTHandle,
+                                              const MQTTAgentUnsubscribeParams_t * const pxUnsubscribeParams,
+                                              TickType_t xTimeoutTicks );
+MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentPublishParams_t * const pxPublishParams,
+                                          TickType_t xTimeoutTicks );
+
+#endif /* ifndef HOST_AWS_MQTT_AGENT_H_ */
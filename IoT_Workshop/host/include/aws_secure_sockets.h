@@ -0,0 +1,87 @@
+/*
+ * aws_secure_sockets.h of the host build: the secure sockets of Amazon
+ * FreeRTOS over POSIX TCP (port/sockets_posix.c), with TLS through mbedTLS
+ * (port/iot_tls.c) once SOCKETS_SO_REQUIRE_TLS is set.
+ *
+ * As on the device, SOCKETS_Connect() completes the TLS handshake. Without
+ * SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE the server is verified against the
+ * CA of the host stand-ins, which takes the place of the Amazon root CAs.
+ */
+
+#ifndef HOST_AWS_SECURE_SOCKETS_H_
+#define HOST_AWS_SECURE_SOCKETS_H_
+
+#include "FreeRTOS.h"
+
+typedef void * Socket_t;
+typedef uint32_t Socklen_t;
+
+#define SOCKETS_INVALID_SOCKET                  ( ( Socket_t ) ~0U )
+
+#define SOCKETS_ERROR_NONE                      ( 0 )
+#define SOCKETS_SOCKET_ERROR                    ( -1 )
+#define SOCKETS_EWOULDBLOCK                     ( -11 )
+#define SOCKETS_ENOMEM                          ( -12 )
+#define SOCKETS_EINVAL                          ( -22 )
+#define SOCKETS_ENOPROTOOPT                     ( -109 )
+#define SOCKETS_ENOTCONN                        ( -126 )
+#define SOCKETS_EISCONN                         ( -127 )
+#define SOCKETS_ECLOSED                         ( -128 )
+#define SOCKETS_TLS_INIT_ERROR                  ( -1001 )
+#define SOCKETS_TLS_HANDSHAKE_ERROR             ( -1002 )
+#define SOCKETS_TLS_SERVER_UNVERIFIED           ( -1003 )
+#define SOCKETS_TLS_RECV_ERROR                  ( -1004 )
+#define SOCKETS_TLS_SEND_ERROR                  ( -1005 )
+
+#define SOCKETS_AF_INET                         ( 2 )
+#define SOCKETS_SOCK_STREAM                     ( 1 )
+#define SOCKETS_IPPROTO_TCP                     ( 6 )
+
+#define SOCKETS_SO_RCVTIMEO                     ( 0 )
+#define SOCKETS_SO_SNDTIMEO                     ( 1 )
+#define SOCKETS_SO_SERVER_NAME_INDICATION       ( 6 )
+#define SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE   ( 7 )
+#define SOCKETS_SO_REQUIRE_TLS                  ( 8 )
+#define SOCKETS_SO_NONBLOCK                     ( 9 )
+
+#define SOCKETS_SHUT_RD                         ( 0 )
+#define SOCKETS_SHUT_WR                         ( 1 )
+#define SOCKETS_SHUT_RDWR                       ( 2 )
+
+typedef struct SocketsSockaddr
+{
+    uint8_t ucLength;
+    uint8_t ucSocketDomain;
+    uint16_t usPort;       /* Network byte order. */
+    uint32_t ulAddress;    /* Network byte order. */
+} SocketsSockaddr_t;
+
+BaseType_t SOCKETS_Init( void );
+Socket_t SOCKETS_Socket( int32_t lDomain,
+                         int32_t lType,
+                         int32_t lProtocol );
+int32_t SOCKETS_Connect( Socket_t xSocket,
+                         SocketsSockaddr_t * pxAddress,
+                         Socklen_t xAddressLength );
+int32_t SOCKETS_Recv( Socket_t xSocket,
+                      void * pvBuffer,
+                      size_t xBufferLength,
+                      uint32_t ulFlags );
+int32_t SOCKETS_Send( Socket_t xSocket,
+                      const void * pvBuffer,
+                      size_t xDataLength,
+                      uint32_t ulFlags );
+int32_t SOCKETS_Shutdown( Socket_t xSocket,
+                          uint32_t ulHow );
+int32_t SOCKETS_Close( Socket_t xSocket );
+int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
+                            int32_t lLevel,
+                            int32_t lOptionName,
+                            const void * pvOptionValue,
+                            size_t xOptionLength );
+uint32_t SOCKETS_GetHostByName( const char * pcHostName );
+
+#define SOCKETS_htons( usIn )    ( ( uint16_t ) ( ( ( ( usIn ) & 0x00ffU ) << 8 ) | ( ( ( usIn ) & 0xff00U ) >> 8 ) ) )
+#define SOCKETS_ntohs( usIn )    SOCKETS_htons( usIn )
+
+#endif /* ifndef HOST_AWS_SECURE_SOCKETS_H_ */
@@ -0,0 +1,83 @@
+/*
+ * driver/gpio.h of the host build: the GPIO calls of the demos, on pins
+ * that only exist in memory (port/esp_posix.c). Outputs keep their level;
+ * edges on inputs are injected with HostGpio_Edge() (host_port.h), which
+ * runs the handler of the pin as the GPIO interrupt would.
+ */
+
+#ifndef HOST_DRIVER_GPIO_H_
+#define HOST_DRIVER_GPIO_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum
+{
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_13 = 13,
+    GPIO_NUM_14 = 14,
+    GPIO_NUM_25 = 25,
+    GPIO_NUM_MAX = 40
+} gpio_num_t;
+
+#define GPIO_SEL_4     ( 1ULL << 4 )
+#define GPIO_SEL_13    ( 1ULL << 13 )
+#define GPIO_SEL_14    ( 1ULL << 14 )
+#define GPIO_SEL_25    ( 1ULL << 25 )
+
+typedef enum
+{
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+    GPIO_MODE_INPUT_OUTPUT = 3
+} gpio_mode_t;
+
+typedef enum
+{
+    GPIO_PULLUP_DISABLE = 0,
+    GPIO_PULLUP_ENABLE = 1
+} gpio_pullup_t;
+
+typedef enum
+{
+    GPIO_PULLDOWN_DISABLE = 0,
+    GPIO_PULLDOWN_ENABLE = 1
+} gpio_pulldown_t;
+
+typedef enum
+{
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE = 1,
+    GPIO_INTR_NEGEDGE = 2,
+    GPIO_INTR_ANYEDGE = 3
+} gpio_int_type_t;
+
+typedef struct
+{
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    gpio_pullup_t pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (* gpio_isr_t)( void * arg );
+
+esp_err_t gpio_config( const gpio_config_t * pGPIOConfig );
+esp_err_t gpio_set_intr_type( gpio_num_t gpio_num,
+                              gpio_int_type_t intr_type );
+esp_err_t gpio_set_direction( gpio_num_t gpio_num,
+                              gpio_mode_t mode );
+esp_err_t gpio_set_level( gpio_num_t gpio_num,
+                          uint32_t level );
+int gpio_get_level( gpio_num_t gpio_num );
+esp_err_t gpio_install_isr_service( int intr_alloc_flags );
+esp_err_t gpio_isr_handler_add( gpio_num_t gpio_num,
+                                gpio_isr_t isr_handler,
+                                void * args );
+esp_err_t gpio_isr_handler_remove( gpio_num_t gpio_num );
+
+#endif /* ifndef HOST_DRIVER_GPIO_H_ */
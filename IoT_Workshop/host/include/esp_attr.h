@@ -0,0 +1,13 @@
+/*
+ * esp_attr.h of the host build: code and data placement mean nothing here.
+ */
+
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#ifndef IRAM_ATTR
+    #define IRAM_ATTR
+#endif
+#define DRAM_ATTR
+
+#endif /* ifndef HOST_ESP_ATTR_H_ */
@@ -0,0 +1,18 @@
+/*
+ * esp_err.h of the host build.
+ */
+
+#ifndef HOST_ESP_ERR_H_
+#define HOST_ESP_ERR_H_
+
+#include <stdint.h>
+
+typedef int32_t esp_err_t;
+
+#define ESP_OK                     ( 0 )
+#define ESP_FAIL                   ( -1 )
+#define ESP_ERR_NO_MEM             ( 0x101 )
+#define ESP_ERR_INVALID_ARG        ( 0x102 )
+#define ESP_ERR_INVALID_STATE      ( 0x103 )
+
+#endif /* ifndef HOST_ESP_ERR_H_ */
@@ -0,0 +1,13 @@
+/*
+ * esp_timer.h of the host build: microseconds since the program started,
+ * on the monotonic clock.
+ */
+
+#ifndef HOST_ESP_TIMER_H_
+#define HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time( void );
+
+#endif /* ifndef HOST_ESP_TIMER_H_ */
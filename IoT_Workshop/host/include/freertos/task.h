@@ -0,0 +1,2 @@
+/* ESP-IDF spelling of the FreeRTOS includes. */
+#include "../task.h"
@@ -0,0 +1,87 @@
+/*
+ * host_port.h: what the host build adds to the device API, for the mains of
+ * the host target and for host tests.
+ *
+ * The stand-ins listen on this host in place of the services the demos
+ * reach on the device: an MQTT broker for AWS IoT Core and for each
+ * Greengrass core (port/broker_posix.c), and the Greengrass discovery
+ * service (port/discovery_posix.c). Their TLS certificates are signed by
+ * the CA of pcHostCaCertificate, which the secure sockets trust by
+ * default, and they name "localhost" and 127.0.0.1.
+ */
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+/* PEM, NUL terminated; the sizes count the terminator, as mbedTLS and the
+ * discovery document want them. Generated by the Makefile. */
+extern const char pcHostCaCertificate[];
+extern const uint32_t ulHostCaCertificateSize;
+extern const char pcHostServerCertificate[];
+extern const uint32_t ulHostServerCertificateSize;
+extern const char pcHostServerKey[];
+extern const uint32_t ulHostServerKeySize;
+
+/*
+ * Start the kernel port: the calling thread becomes a task and the timer
+ * service starts. Call before anything else.
+ */
+void HostPort_Init( void );
+
+/*
+ * Run the handler of a GPIO input as its interrupt would on an edge, if the
+ * pin is configured for that edge.
+ */
+void HostGpio_Edge( gpio_num_t xPin,
+                    uint32_t ulLevel );
+
+/* Read the whole NVS from a file, or write it there, to model a reboot. */
+bool HostNvs_Load( const char * pcPath );
+bool HostNvs_Save( const char * pcPath );
+
+typedef struct HostBroker * HostBrokerHandle_t;
+
+typedef struct HostBrokerStats
+{
+    uint32_t ulConnections;    /* TCP connections accepted. */
+    uint32_t ulHandshakes;     /* TLS handshakes completed. */
+    uint32_t ulResumed;        /* Of which resumed a cached session. */
+    uint32_t ulConnects;       /* MQTT CONNECTs accepted. */
+    uint32_t ulPublishes;      /* PUBLISHes received from clients. */
+    uint32_t ulDelivered;      /* PUBLISHes sent to subscribers. */
+} HostBrokerStats_t;
+
+/*
+ * Start an MQTT 3.1.1 broker on 127.0.0.1:usPort, with TLS if xTls. Every
+ * TLS handshake is held back by ulHandshakeDelayMs, for an endpoint that
+ * is further away. Each broker has its own subscriptions.
+ *
+ * @return NULL if the port could not be listened on.
+ */
+HostBrokerHandle_t HostBroker_Start( uint16_t usPort,
+                                     bool xTls,
+                                     uint32_t ulHandshakeDelayMs );
+void HostBroker_GetStats( HostBrokerHandle_t xBroker,
+                          HostBrokerStats_t * pxStats );
+
+/* Close every connection of the broker, as a core that goes away would;
+ * it keeps listening. */
+void HostBroker_DropConnections( HostBrokerHandle_t xBroker );
+
+/*
+ * Serve pcDocument over TLS on 127.0.0.1:usPort for every GET of the
+ * Greengrass discovery path. The document is copied.
+ */
+bool HostDiscovery_Start( uint16_t usPort,
+                          const char * pcDocument );
+
+/* Requests served so far. */
+uint32_t HostDiscovery_Requests( void );
+
+#endif /* ifndef HOST_PORT_H_ */
@@ -0,0 +1,24 @@
+/*
+ * iot_config.h of the host build: the settings of the MQTT library that
+ * the demos read, for the client of port/mqtt_client.c.
+ */
+
+#ifndef HOST_IOT_CONFIG_H_
+#define HOST_IOT_CONFIG_H_
+
+/* The demos reach the kernel through the FreeRTOS headers. */
+#include "FreeRTOS.h"
+
+/* Operations and packets come from the heap. */
+#define IOT_STATIC_MEMORY_ONLY                    ( 0 )
+
+/* The client honours the serializer of the network info, so that the
+ * PUBLISH templates of the MQTT demo can be tried with
+ * CPPFLAGS="-DdlogENABLED=0 -DIOT_DEMO_MQTT_PUBLISH_TEMPLATE=1". */
+#define IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES      ( 1 )
+
+/* Most MQTT agent clients at a time: the Greengrass demo keeps one for the
+ * core and one for AWS IoT Core. */
+#define mqttconfigMAX_BROKERS                     ( 2 )
+
+#endif /* ifndef HOST_IOT_CONFIG_H_ */
@@ -0,0 +1,20 @@
+/*
+ * iot_demo_logging.h of the host build. Every line names its level and
+ * ends with a line break, as with the logging of the IoT SDK.
+ */
+
+#ifndef HOST_IOT_DEMO_LOGGING_H_
+#define HOST_IOT_DEMO_LOGGING_H_
+
+#include "FreeRTOS.h"
+
+void IotLog_Host( const char * pLevel,
+                  const char * pFormat,
+                  ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+
+#define IotLogError( ... )    IotLog_Host( "ERROR", __VA_ARGS__ )
+#define IotLogWarn( ... )     IotLog_Host( "WARN ", __VA_ARGS__ )
+#define IotLogInfo( ... )     IotLog_Host( "INFO ", __VA_ARGS__ )
+#define IotLogDebug( ... )    do {} while( 0 )
+
+#endif /* ifndef HOST_IOT_DEMO_LOGGING_H_ */
@@ -0,0 +1,217 @@
+/*
+ * iot_mqtt.h of the host build: the MQTT v4 API of the IoT SDK, as far as
+ * the demos use it, implemented by port/mqtt_client.c.
+ *
+ * The client speaks MQTT 3.1.1 at QoS 0 and 1 over any network interface.
+ * Incoming PUBLISHes and completed operations are reported on the thread
+ * of the network's receive callback, as the library's task pool would.
+ */
+
+#ifndef HOST_IOT_MQTT_H_
+#define HOST_IOT_MQTT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform/iot_network.h"
+
+typedef struct _mqttConnection * IotMqttConnection_t;
+typedef struct _mqttOperation * IotMqttOperation_t;
+
+typedef enum IotMqttError
+{
+    IOT_MQTT_SUCCESS = 0,
+    IOT_MQTT_STATUS_PENDING,
+    IOT_MQTT_INIT_FAILED,
+    IOT_MQTT_BAD_PARAMETER,
+    IOT_MQTT_NO_MEMORY,
+    IOT_MQTT_NETWORK_ERROR,
+    IOT_MQTT_SCHEDULING_ERROR,
+    IOT_MQTT_BAD_RESPONSE,
+    IOT_MQTT_TIMEOUT,
+    IOT_MQTT_SERVER_REFUSED,
+    IOT_MQTT_RETRY_NO_RESPONSE
+} IotMqttError_t;
+
+typedef enum IotMqttOperationType
+{
+    IOT_MQTT_CONNECT,
+    IOT_MQTT_PUBLISH_TO_SERVER,
+    IOT_MQTT_PUBACK,
+    IOT_MQTT_SUBSCRIBE,
+    IOT_MQTT_UNSUBSCRIBE,
+    IOT_MQTT_PINGREQ,
+    IOT_MQTT_DISCONNECT
+} IotMqttOperationType_t;
+
+typedef enum IotMqttQos
+{
+    IOT_MQTT_QOS_0 = 0,
+    IOT_MQTT_QOS_1 = 1,
+    IOT_MQTT_QOS_2 = 2
+} IotMqttQos_t;
+
+typedef enum IotMqttDisconnectReason
+{
+    IOT_MQTT_DISCONNECT_CALLED,
+    IOT_MQTT_BAD_PACKET_RECEIVED,
+    IOT_MQTT_KEEP_ALIVE_TIMEOUT
+} IotMqttDisconnectReason_t;
+
+typedef struct IotMqttPublishInfo
+{
+    IotMqttQos_t qos;
+    bool retain;
+    const char * pTopicName;
+    uint16_t topicNameLength;
+    const void * pPayload;
+    size_t payloadLength;
+    uint32_t retryMs;
+    uint32_t retryLimit;
+} IotMqttPublishInfo_t;
+
+typedef struct IotMqttCallbackParam
+{
+    IotMqttConnection_t mqttConnection;
+
+    union
+    {
+        struct
+        {
+            IotMqttOperationType_t type;
+            IotMqttOperation_t reference;
+            IotMqttError_t result;
+        } operation;
+
+        struct
+        {
+            const char * pTopicFilter;
+            uint16_t topicFilterLength;
+            IotMqttPublishInfo_t info;
+        } message;
+
+        IotMqttDisconnectReason_t disconnectReason;
+    } u;
+} IotMqttCallbackParam_t;
+
+typedef struct IotMqttCallbackInfo
+{
+    void * pCallbackContext;
+    void ( * function )( void * pCallbackContext,
+                         IotMqttCallbackParam_t * pCallbackParam );
+} IotMqttCallbackInfo_t;
+
+typedef struct IotMqttSubscription
+{
+    IotMqttQos_t qos;
+    const char * pTopicFilter;
+    uint16_t topicFilterLength;
+    IotMqttCallbackInfo_t callback;
+} IotMqttSubscription_t;
+
+typedef struct IotMqttConnectInfo
+{
+    bool awsIotMqttMode;
+    bool cleanSession;
+    const IotMqttSubscription_t * pPreviousSubscriptions;
+    size_t previousSubscriptionCount;
+    const IotMqttPublishInfo_t * pWillInfo;
+    uint16_t keepAliveSeconds;
+    const char * pClientIdentifier;
+    uint16_t clientIdentifierLength;
+    const char * pUserName;
+    uint16_t userNameLength;
+    const char * pPassword;
+    uint16_t passwordLength;
+} IotMqttConnectInfo_t;
+
+/* Only the PUBLISH serializer and the matching free can be overridden. */
+typedef struct IotMqttSerializer
+{
+    struct
+    {
+        IotMqttError_t ( * publish )( const IotMqttPublishInfo_t * pPublishInfo,
+                                      uint8_t ** pPublishPacket,
+                                      size_t * pPacketSize,
+                                      uint16_t * pPacketIdentifier,
+                                      uint8_t ** pPacketIdentifierHigh );
+    } serialize;
+
+    void ( * freePacket )( uint8_t * pPacket );
+} IotMqttSerializer_t;
+
+typedef struct IotMqttNetworkInfo
+{
+    bool createNetworkConnection;
+
+    union
+    {
+        struct
+        {
+            void * pNetworkServerInfo;
+            void * pNetworkCredentialInfo;
+        } setup;
+
+        void * pNetworkConnection;
+    } u;
+
+    const IotNetworkInterface_t * pNetworkInterface;
+    IotMqttCallbackInfo_t disconnectCallback;
+    const IotMqttSerializer_t * pMqttSerializer;
+} IotMqttNetworkInfo_t;
+
+#define IOT_MQTT_CONNECTION_INITIALIZER      NULL
+#define IOT_MQTT_OPERATION_INITIALIZER       NULL
+#define IOT_MQTT_NETWORK_INFO_INITIALIZER    { .createNetworkConnection = true }
+#define IOT_MQTT_CONNECT_INFO_INITIALIZER    { .cleanSession = true }
+#define IOT_MQTT_PUBLISH_INFO_INITIALIZER    { .qos = IOT_MQTT_QOS_0 }
+#define IOT_MQTT_CALLBACK_INFO_INITIALIZER   { 0 }
+#define IOT_MQTT_SUBSCRIPTION_INITIALIZER    { .qos = IOT_MQTT_QOS_0 }
+
+#define IOT_MQTT_FLAG_WAITABLE               ( 0x00000001 )
+#define IOT_MQTT_FLAG_CLEANUP_ONLY           ( 0x00000001 )
+
+IotMqttError_t IotMqtt_Init( void );
+void IotMqtt_Cleanup( void );
+void IotMqtt_ReceiveCallback( void * pNetworkConnection,
+                              void * pReceiveContext );
+
+IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
+                                const IotMqttConnectInfo_t * pConnectInfo,
+                                uint32_t timeoutMs,
+                                IotMqttConnection_t * const pMqttConnection );
+void IotMqtt_Disconnect( IotMqttConnection_t mqttConnection,
+                         uint32_t flags );
+
+IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
+                                const IotMqttPublishInfo_t * pPublishInfo,
+                                uint32_t flags,
+                                const IotMqttCallbackInfo_t * pCallbackInfo,
+                                IotMqttOperation_t * const pPublishOperation );
+IotMqttError_t IotMqtt_TimedPublish( IotMqttConnection_t mqttConnection,
+                                     const IotMqttPublishInfo_t * pPublishInfo,
+                                     uint32_t flags,
+                                     uint32_t timeoutMs );
+IotMqttError_t IotMqtt_TimedSubscribe( IotMqttConnection_t mqttConnection,
+                                       const IotMqttSubscription_t * pSubscriptionList,
+                                       size_t subscriptionCount,
+                                       uint32_t flags,
+                                       uint32_t timeoutMs );
+IotMqttError_t IotMqtt_TimedUnsubscribe( IotMqttConnection_t mqttConnection,
+                                         const IotMqttSubscription_t * pSubscriptionList,
+                                         size_t subscriptionCount,
+                                         uint32_t flags,
+                                         uint32_t timeoutMs );
+IotMqttError_t IotMqtt_Wait( IotMqttOperation_t operation,
+                             uint32_t timeoutMs );
+
+bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
+                           const char * pTopicFilter,
+                           uint16_t topicFilterLength,
+                           IotMqttSubscription_t * pCurrentSubscription );
+
+const char * IotMqtt_strerror( IotMqttError_t status );
+const char * IotMqtt_OperationType( IotMqttOperationType_t operation );
+
+#endif /* ifndef HOST_IOT_MQTT_H_ */
@@ -0,0 +1,45 @@
+/*
+ * iot_tls.h of the host build: the TLS layer under the secure sockets, as
+ * in Amazon FreeRTOS, implemented with mbedTLS by port/iot_tls.c. The
+ * caller moves the bytes; TLS_Connect() runs the handshake, resuming the
+ * session of the last connection to the same endpoint when it can
+ * (driver/tls_session_cache.h).
+ */
+
+#ifndef HOST_IOT_TLS_H_
+#define HOST_IOT_TLS_H_
+
+#include "FreeRTOS.h"
+
+typedef BaseType_t ( * NetworkRecv_t )( void * pvCallerContext,
+                                        unsigned char * pucReceiveBuffer,
+                                        size_t xReceiveLength );
+typedef BaseType_t ( * NetworkSend_t )( void * pvCallerContext,
+                                        const unsigned char * pucData,
+                                        size_t xDataLength );
+
+typedef struct xTLS_PARAMS
+{
+    uint32_t ulSize;
+    const char * pcDestination;          /* SNI, and the name checked in the certificate. */
+    const char * pcEndpoint;             /* Name or address the session is cached under; NULL for none. */
+    uint16_t usPort;                     /* Port of the endpoint. */
+    const char * pcServerCertificate;    /* PEM; NULL for the default root CA. */
+    uint32_t ulServerCertificateLength;
+    void * pvCallerContext;
+    NetworkRecv_t pxNetworkRecv;         /* Returns 0 on timeout, < 0 on error. */
+    NetworkSend_t pxNetworkSend;
+} TLSParams_t;
+
+BaseType_t TLS_Init( void ** ppvContext,
+                     TLSParams_t * pxParams );
+BaseType_t TLS_Connect( void * pvContext );
+BaseType_t TLS_Recv( void * pvContext,
+                     unsigned char * pucReadBuffer,
+                     size_t xReadLength );
+BaseType_t TLS_Send( void * pvContext,
+                     const unsigned char * pucMsg,
+                     size_t xMsgLength );
+void TLS_Cleanup( void * pvContext );
+
+#endif /* ifndef HOST_IOT_TLS_H_ */
@@ -0,0 +1,28 @@
+/*
+ * mbedtls/ctr_drbg.h of the host build, against mbedTLS 2.28 as shipped by
+ * the distribution (libmbedcrypto.so.7); see mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_CTR_DRBG_H_
+#define HOST_MBEDTLS_CTR_DRBG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mbedtls_ctr_drbg_context
+{
+    uint64_t opaque[ 64 ];
+} mbedtls_ctr_drbg_context;
+
+void mbedtls_ctr_drbg_init( mbedtls_ctr_drbg_context * ctx );
+void mbedtls_ctr_drbg_free( mbedtls_ctr_drbg_context * ctx );
+int mbedtls_ctr_drbg_seed( mbedtls_ctr_drbg_context * ctx,
+                           int ( * f_entropy )( void *, unsigned char *, size_t ),
+                           void * p_entropy,
+                           const unsigned char * custom,
+                           size_t len );
+int mbedtls_ctr_drbg_random( void * p_rng,
+                             unsigned char * output,
+                             size_t output_len );
+
+#endif /* ifndef HOST_MBEDTLS_CTR_DRBG_H_ */
@@ -0,0 +1,24 @@
+/*
+ * mbedtls/entropy.h of the host build, against mbedTLS 2.28 as shipped by
+ * the distribution (libmbedcrypto.so.7); see mbedtls/sha256.h. The 2.28
+ * context takes 38 KB there, with the HAVEGE state.
+ */
+
+#ifndef HOST_MBEDTLS_ENTROPY_H_
+#define HOST_MBEDTLS_ENTROPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mbedtls_entropy_context
+{
+    uint64_t opaque[ 5120 ];
+} mbedtls_entropy_context;
+
+void mbedtls_entropy_init( mbedtls_entropy_context * ctx );
+void mbedtls_entropy_free( mbedtls_entropy_context * ctx );
+int mbedtls_entropy_func( void * data,
+                          unsigned char * output,
+                          size_t len );
+
+#endif /* ifndef HOST_MBEDTLS_ENTROPY_H_ */
@@ -0,0 +1,15 @@
+/*
+ * mbedtls/error.h of the host build, against mbedTLS 2.28 as shipped by the
+ * distribution (libmbedcrypto.so.7); see mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_ERROR_H_
+#define HOST_MBEDTLS_ERROR_H_
+
+#include <stddef.h>
+
+void mbedtls_strerror( int errnum,
+                       char * buffer,
+                       size_t buflen );
+
+#endif /* ifndef HOST_MBEDTLS_ERROR_H_ */
@@ -0,0 +1,43 @@
+/*
+ * mbedtls/gcm.h of the host build: AES-GCM of mbedTLS 2.28 as shipped by
+ * the distribution (libmbedcrypto.so.7), declared as in mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_GCM_H_
+#define HOST_MBEDTLS_GCM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_GCM_ENCRYPT      ( 1 )
+#define MBEDTLS_GCM_DECRYPT      ( 0 )
+#define MBEDTLS_CIPHER_ID_AES    ( 2 )
+
+typedef int mbedtls_cipher_id_t;
+
+typedef struct mbedtls_gcm_context
+{
+    uint64_t opaque[ 128 ];
+} mbedtls_gcm_context;
+
+void mbedtls_gcm_init( mbedtls_gcm_context * ctx );
+void mbedtls_gcm_free( mbedtls_gcm_context * ctx );
+int mbedtls_gcm_setkey( mbedtls_gcm_context * ctx,
+                        mbedtls_cipher_id_t cipher,
+                        const unsigned char * key,
+                        unsigned int keybits );
+int mbedtls_gcm_starts( mbedtls_gcm_context * ctx,
+                        int mode,
+                        const unsigned char * iv,
+                        size_t iv_len,
+                        const unsigned char * add,
+                        size_t add_len );
+int mbedtls_gcm_update( mbedtls_gcm_context * ctx,
+                        size_t length,
+                        const unsigned char * input,
+                        unsigned char * output );
+int mbedtls_gcm_finish( mbedtls_gcm_context * ctx,
+                        unsigned char * tag,
+                        size_t tag_len );
+
+#endif /* ifndef HOST_MBEDTLS_GCM_H_ */
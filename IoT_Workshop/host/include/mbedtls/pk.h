@@ -0,0 +1,27 @@
+/*
+ * mbedtls/pk.h of the host build, against mbedTLS 2.28 as shipped by the
+ * distribution (libmbedcrypto.so.7); see mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_PK_H_
+#define HOST_MBEDTLS_PK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mbedtls_pk_context
+{
+    uint64_t opaque[ 4 ];
+} mbedtls_pk_context;
+
+void mbedtls_pk_init( mbedtls_pk_context * ctx );
+void mbedtls_pk_free( mbedtls_pk_context * ctx );
+
+/* A PEM key is parsed with its NUL terminator counted in keylen. */
+int mbedtls_pk_parse_key( mbedtls_pk_context * ctx,
+                          const unsigned char * key,
+                          size_t keylen,
+                          const unsigned char * pwd,
+                          size_t pwdlen );
+
+#endif /* ifndef HOST_MBEDTLS_PK_H_ */
@@ -0,0 +1,32 @@
+/*
+ * mbedtls/sha256.h of the host build.
+ *
+ * Declares the SHA-256 calls of the demos against mbedTLS 2.28 as shipped
+ * by the distribution (libmbedcrypto.so.7), for hosts that have the library
+ * but not its development package. The context is left opaque: it is only
+ * ever handled by the library, and the storage is larger than the 2.28
+ * context.
+ */
+
+#ifndef HOST_MBEDTLS_SHA256_H_
+#define HOST_MBEDTLS_SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mbedtls_sha256_context
+{
+    uint64_t opaque[ 32 ];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init( mbedtls_sha256_context * ctx );
+void mbedtls_sha256_free( mbedtls_sha256_context * ctx );
+int mbedtls_sha256_starts_ret( mbedtls_sha256_context * ctx,
+                               int is224 );
+int mbedtls_sha256_update_ret( mbedtls_sha256_context * ctx,
+                               const unsigned char * input,
+                               size_t ilen );
+int mbedtls_sha256_finish_ret( mbedtls_sha256_context * ctx,
+                               unsigned char output[ 32 ] );
+
+#endif /* ifndef HOST_MBEDTLS_SHA256_H_ */
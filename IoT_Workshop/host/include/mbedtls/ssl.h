@@ -0,0 +1,124 @@
+/*
+ * mbedtls/ssl.h of the host build, against mbedTLS 2.28 as shipped by the
+ * distribution (libmbedtls.so.14); see mbedtls/sha256.h. Only the calls of
+ * port/iot_tls.c, driver/tls_session_cache.c and of the TLS listeners of the
+ * stand-ins are declared.
+ */
+
+#ifndef HOST_MBEDTLS_SSL_H_
+#define HOST_MBEDTLS_SSL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbedtls/pk.h"
+#include "mbedtls/x509_crt.h"
+
+#define MBEDTLS_ERR_SSL_CONN_EOF                -0x7280
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY       -0x7880
+#define MBEDTLS_ERR_SSL_TIMEOUT                 -0x6800
+#define MBEDTLS_ERR_SSL_WANT_READ               -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE              -0x6880
+#define MBEDTLS_ERR_NET_RECV_FAILED             -0x004C
+#define MBEDTLS_ERR_NET_SEND_FAILED             -0x004E
+#define MBEDTLS_ERR_NET_CONN_RESET              -0x0050
+
+#define MBEDTLS_SSL_IS_CLIENT                   0
+#define MBEDTLS_SSL_IS_SERVER                   1
+#define MBEDTLS_SSL_TRANSPORT_STREAM            0
+#define MBEDTLS_SSL_PRESET_DEFAULT              0
+#define MBEDTLS_SSL_VERIFY_NONE                 0
+#define MBEDTLS_SSL_VERIFY_OPTIONAL             1
+#define MBEDTLS_SSL_VERIFY_REQUIRED             2
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED    0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED     1
+
+typedef struct mbedtls_ssl_context
+{
+    uint64_t opaque[ 192 ];
+} mbedtls_ssl_context;
+
+typedef struct mbedtls_ssl_config
+{
+    uint64_t opaque[ 128 ];
+} mbedtls_ssl_config;
+
+typedef struct mbedtls_ssl_session
+{
+    uint64_t opaque[ 32 ];
+} mbedtls_ssl_session;
+
+typedef int mbedtls_ssl_send_t ( void * ctx,
+                                 const unsigned char * buf,
+                                 size_t len );
+typedef int mbedtls_ssl_recv_t ( void * ctx,
+                                 unsigned char * buf,
+                                 size_t len );
+typedef int mbedtls_ssl_recv_timeout_t ( void * ctx,
+                                         unsigned char * buf,
+                                         size_t len,
+                                         uint32_t timeout );
+
+void mbedtls_ssl_config_init( mbedtls_ssl_config * conf );
+void mbedtls_ssl_config_free( mbedtls_ssl_config * conf );
+int mbedtls_ssl_config_defaults( mbedtls_ssl_config * conf,
+                                 int endpoint,
+                                 int transport,
+                                 int preset );
+void mbedtls_ssl_conf_authmode( mbedtls_ssl_config * conf,
+                                int authmode );
+void mbedtls_ssl_conf_ca_chain( mbedtls_ssl_config * conf,
+                                mbedtls_x509_crt * ca_chain,
+                                mbedtls_x509_crl * ca_crl );
+int mbedtls_ssl_conf_own_cert( mbedtls_ssl_config * conf,
+                               mbedtls_x509_crt * own_cert,
+                               mbedtls_pk_context * pk_key );
+void mbedtls_ssl_conf_rng( mbedtls_ssl_config * conf,
+                           int ( * f_rng )( void *, unsigned char *, size_t ),
+                           void * p_rng );
+void mbedtls_ssl_conf_verify( mbedtls_ssl_config * conf,
+                              int ( * f_vrfy )( void *, mbedtls_x509_crt *, int, uint32_t * ),
+                              void * p_vrfy );
+void mbedtls_ssl_conf_read_timeout( mbedtls_ssl_config * conf,
+                                    uint32_t timeout );
+void mbedtls_ssl_conf_session_tickets( mbedtls_ssl_config * conf,
+                                       int use_tickets );
+void mbedtls_ssl_conf_session_cache( mbedtls_ssl_config * conf,
+                                     void * p_cache,
+                                     int ( * f_get_cache )( void *, mbedtls_ssl_session * ),
+                                     int ( * f_set_cache )( void *, const mbedtls_ssl_session * ) );
+
+void mbedtls_ssl_init( mbedtls_ssl_context * ssl );
+void mbedtls_ssl_free( mbedtls_ssl_context * ssl );
+int mbedtls_ssl_setup( mbedtls_ssl_context * ssl,
+                       const mbedtls_ssl_config * conf );
+int mbedtls_ssl_set_hostname( mbedtls_ssl_context * ssl,
+                              const char * hostname );
+void mbedtls_ssl_set_bio( mbedtls_ssl_context * ssl,
+                          void * p_bio,
+                          mbedtls_ssl_send_t * f_send,
+                          mbedtls_ssl_recv_t * f_recv,
+                          mbedtls_ssl_recv_timeout_t * f_recv_timeout );
+int mbedtls_ssl_handshake( mbedtls_ssl_context * ssl );
+int mbedtls_ssl_read( mbedtls_ssl_context * ssl,
+                      unsigned char * buf,
+                      size_t len );
+int mbedtls_ssl_write( mbedtls_ssl_context * ssl,
+                       const unsigned char * buf,
+                       size_t len );
+int mbedtls_ssl_close_notify( mbedtls_ssl_context * ssl );
+size_t mbedtls_ssl_get_bytes_avail( const mbedtls_ssl_context * ssl );
+uint32_t mbedtls_ssl_get_verify_result( const mbedtls_ssl_context * ssl );
+
+void mbedtls_ssl_session_init( mbedtls_ssl_session * session );
+void mbedtls_ssl_session_free( mbedtls_ssl_session * session );
+int mbedtls_ssl_get_session( const mbedtls_ssl_context * ssl,
+                             mbedtls_ssl_session * session );
+int mbedtls_ssl_set_session( mbedtls_ssl_context * ssl,
+                             const mbedtls_ssl_session * session );
+int mbedtls_ssl_session_save( const mbedtls_ssl_session * session,
+                              unsigned char * buf,
+                              size_t buf_len,
+                              size_t * olen );
+
+#endif /* ifndef HOST_MBEDTLS_SSL_H_ */
@@ -0,0 +1,24 @@
+/*
+ * mbedtls/ssl_cache.h of the host build: the session-ID cache of a TLS
+ * server, against mbedTLS 2.28 as shipped by the distribution
+ * (libmbedtls.so.14); see mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_SSL_CACHE_H_
+#define HOST_MBEDTLS_SSL_CACHE_H_
+
+#include "mbedtls/ssl.h"
+
+typedef struct mbedtls_ssl_cache_context
+{
+    uint64_t opaque[ 16 ];
+} mbedtls_ssl_cache_context;
+
+void mbedtls_ssl_cache_init( mbedtls_ssl_cache_context * cache );
+void mbedtls_ssl_cache_free( mbedtls_ssl_cache_context * cache );
+int mbedtls_ssl_cache_get( void * data,
+                           mbedtls_ssl_session * session );
+int mbedtls_ssl_cache_set( void * data,
+                           const mbedtls_ssl_session * session );
+
+#endif /* ifndef HOST_MBEDTLS_SSL_CACHE_H_ */
@@ -0,0 +1,30 @@
+/*
+ * mbedtls/x509_crt.h of the host build, against mbedTLS 2.28 as shipped by
+ * the distribution (libmbedx509.so.1); see mbedtls/sha256.h.
+ */
+
+#ifndef HOST_MBEDTLS_X509_CRT_H_
+#define HOST_MBEDTLS_X509_CRT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mbedtls_x509_crt
+{
+    uint64_t opaque[ 128 ];
+} mbedtls_x509_crt;
+
+typedef struct mbedtls_x509_crl
+{
+    uint64_t opaque[ 64 ];
+} mbedtls_x509_crl;
+
+void mbedtls_x509_crt_init( mbedtls_x509_crt * crt );
+void mbedtls_x509_crt_free( mbedtls_x509_crt * crt );
+
+/* PEM is parsed with its NUL terminator counted in buflen. */
+int mbedtls_x509_crt_parse( mbedtls_x509_crt * chain,
+                            const unsigned char * buf,
+                            size_t buflen );
+
+#endif /* ifndef HOST_MBEDTLS_X509_CRT_H_ */
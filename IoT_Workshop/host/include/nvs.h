@@ -0,0 +1,53 @@
+/*
+ * nvs.h of the host build: the part of the ESP-IDF key-value store the
+ * demos use, kept in memory by port/esp_posix.c. Nothing survives the
+ * process, unless HostNvs_Load() and HostNvs_Save() (host_port.h) are used
+ * to model a reboot.
+ */
+
+#ifndef HOST_NVS_H_
+#define HOST_NVS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle;
+
+#define ESP_ERR_NVS_BASE                 ( 0x1100 )
+#define ESP_ERR_NVS_NOT_FOUND            ( ESP_ERR_NVS_BASE + 0x02 )
+#define ESP_ERR_NVS_INVALID_HANDLE       ( ESP_ERR_NVS_BASE + 0x07 )
+#define ESP_ERR_NVS_READ_ONLY            ( ESP_ERR_NVS_BASE + 0x04 )
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE     ( ESP_ERR_NVS_BASE + 0x05 )
+#define ESP_ERR_NVS_INVALID_LENGTH       ( ESP_ERR_NVS_BASE + 0x0c )
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode;
+
+esp_err_t nvs_open( const char * name,
+                    nvs_open_mode open_mode,
+                    nvs_handle * out_handle );
+void nvs_close( nvs_handle handle );
+esp_err_t nvs_commit( nvs_handle handle );
+esp_err_t nvs_get_u16( nvs_handle handle,
+                       const char * key,
+                       uint16_t * out_value );
+esp_err_t nvs_set_u16( nvs_handle handle,
+                       const char * key,
+                       uint16_t value );
+esp_err_t nvs_get_blob( nvs_handle handle,
+                        const char * key,
+                        void * out_value,
+                        size_t * length );
+esp_err_t nvs_set_blob( nvs_handle handle,
+                        const char * key,
+                        const void * value,
+                        size_t length );
+esp_err_t nvs_erase_key( nvs_handle handle,
+                         const char * key );
+
+#endif /* ifndef HOST_NVS_H_ */
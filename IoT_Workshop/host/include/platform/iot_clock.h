@@ -0,0 +1,19 @@
+/*
+ * platform/iot_clock.h of the host build: milliseconds on the monotonic
+ * clock, since the program started (port/platform_posix.c).
+ */
+
+#ifndef HOST_IOT_CLOCK_H_
+#define HOST_IOT_CLOCK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t IotClock_GetTimeMs( void );
+void IotClock_SleepMs( uint32_t sleepTimeMs );
+bool IotClock_GetTimestring( char * pBuffer,
+                             size_t bufferSize,
+                             size_t * pTimestringLength );
+
+#endif /* ifndef HOST_IOT_CLOCK_H_ */
@@ -0,0 +1,46 @@
+/*
+ * platform/iot_network.h of the host build: the network interface the MQTT
+ * library is given, as in the IoT SDK.
+ *
+ * A connection calls its receive callback whenever data arrives; the
+ * callback reads one packet with `receive`, which blocks until all the
+ * bytes asked for are there or the connection is closed.
+ */
+
+#ifndef HOST_IOT_NETWORK_H_
+#define HOST_IOT_NETWORK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum IotNetworkError
+{
+    IOT_NETWORK_SUCCESS = 0,
+    IOT_NETWORK_FAILURE,
+    IOT_NETWORK_BAD_PARAMETER,
+    IOT_NETWORK_NO_MEMORY,
+    IOT_NETWORK_SYSTEM_ERROR
+} IotNetworkError_t;
+
+typedef void (* IotNetworkReceiveCallback_t)( void * pConnection,
+                                              void * pContext );
+
+typedef struct IotNetworkInterface
+{
+    IotNetworkError_t ( * create )( void * pConnectionInfo,
+                                    void * pCredentialInfo,
+                                    void ** pConnection );
+    IotNetworkError_t ( * close )( void * pConnection );
+    size_t ( * send )( void * pConnection,
+                       const uint8_t * pMessage,
+                       size_t messageLength );
+    size_t ( * receive )( void * pConnection,
+                          uint8_t * pBuffer,
+                          size_t bytesRequested );
+    IotNetworkError_t ( * setReceiveCallback )( void * pConnection,
+                                                IotNetworkReceiveCallback_t receiveCallback,
+                                                void * pContext );
+    IotNetworkError_t ( * destroy )( void * pConnection );
+} IotNetworkInterface_t;
+
+#endif /* ifndef HOST_IOT_NETWORK_H_ */
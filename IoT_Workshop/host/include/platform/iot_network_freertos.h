@@ -0,0 +1,45 @@
+/*
+ * platform/iot_network_freertos.h of the host build: the network interface
+ * of Amazon FreeRTOS, over the secure sockets of port/sockets_posix.c
+ * (port/network_afr.c).
+ */
+
+#ifndef HOST_IOT_NETWORK_FREERTOS_H_
+#define HOST_IOT_NETWORK_FREERTOS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform/iot_network.h"
+
+typedef struct IotNetworkServerInfo
+{
+    const char * pHostName;
+    uint16_t port;
+} IotNetworkServerInfo_t;
+
+/* Without credentials, the connection is plain TCP; with them but without
+ * pRootCa, the server is verified against the default root CA. */
+typedef struct IotNetworkCredentials
+{
+    const char * pAlpnProtos;
+    size_t maxFragmentLength;
+    bool disableSni;
+    const char * pRootCa;
+    size_t rootCaSize;
+    const char * pClientCert;
+    size_t clientCertSize;
+    const char * pPrivateKey;
+    size_t privateKeySize;
+    const char * pUserName;
+    size_t userNameSize;
+    const char * pPassword;
+    size_t passwordSize;
+} IotNetworkCredentials_t;
+
+extern const IotNetworkInterface_t IotNetworkAfr;
+
+#define IOT_NETWORK_INTERFACE_AFR    ( &( IotNetworkAfr ) )
+
+#endif /* ifndef HOST_IOT_NETWORK_FREERTOS_H_ */
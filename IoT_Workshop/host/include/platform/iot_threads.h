@@ -0,0 +1,47 @@
+/*
+ * platform/iot_threads.h of the host build: the semaphores and mutexes of
+ * the IoT SDK platform layer, on POSIX threads (port/platform_posix.c).
+ */
+
+#ifndef HOST_IOT_THREADS_H_
+#define HOST_IOT_THREADS_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct IotSemaphore
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t posted;
+    uint32_t count;
+    uint32_t maxValue;
+} IotSemaphore_t;
+
+typedef pthread_mutex_t IotMutex_t;
+
+typedef void (* IotThreadRoutine_t)( void * pArgument );
+
+bool Iot_CreateDetachedThread( IotThreadRoutine_t threadRoutine,
+                               void * pArgument,
+                               int32_t priority,
+                               size_t stackSize );
+
+bool IotMutex_Create( IotMutex_t * pNewMutex,
+                      bool recursive );
+void IotMutex_Destroy( IotMutex_t * pMutex );
+void IotMutex_Lock( IotMutex_t * pMutex );
+void IotMutex_Unlock( IotMutex_t * pMutex );
+
+bool IotSemaphore_Create( IotSemaphore_t * pNewSemaphore,
+                          uint32_t initialValue,
+                          uint32_t maxValue );
+void IotSemaphore_Destroy( IotSemaphore_t * pSemaphore );
+uint32_t IotSemaphore_GetCount( IotSemaphore_t * pSemaphore );
+void IotSemaphore_Wait( IotSemaphore_t * pSemaphore );
+bool IotSemaphore_TryWait( IotSemaphore_t * pSemaphore );
+bool IotSemaphore_TimedWait( IotSemaphore_t * pSemaphore,
+                             uint32_t timeoutMs );
+void IotSemaphore_Post( IotSemaphore_t * pSemaphore );
+
+#endif /* ifndef HOST_IOT_THREADS_H_ */
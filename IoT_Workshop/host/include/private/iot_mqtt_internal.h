@@ -0,0 +1,19 @@
+/*
+ * private/iot_mqtt_internal.h of the host build: the serializer of the
+ * client (port/mqtt_client.c), for serializer overrides that fall back on
+ * it. Packets it returns are freed with _IotMqtt_FreePacket().
+ */
+
+#ifndef HOST_IOT_MQTT_INTERNAL_H_
+#define HOST_IOT_MQTT_INTERNAL_H_
+
+#include "iot_mqtt.h"
+
+IotMqttError_t _IotMqtt_SerializePublish( const IotMqttPublishInfo_t * pPublishInfo,
+                                          uint8_t ** pPublishPacket,
+                                          size_t * pPacketSize,
+                                          uint16_t * pPacketIdentifier,
+                                          uint8_t ** pPacketIdentifierHigh );
+void _IotMqtt_FreePacket( uint8_t * pPacket );
+
+#endif /* ifndef HOST_IOT_MQTT_INTERNAL_H_ */
@@ -0,0 +1,40 @@
+/*
+ * queue.h of the host build: queues of fixed-size items, copied in and
+ * out, as implemented by port/freertos_posix.c.
+ */
+
+#ifndef HOST_QUEUE_H_
+#define HOST_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+typedef struct QueueDefinition * QueueHandle_t;
+
+typedef struct xSTATIC_QUEUE
+{
+    void * pvDummy;
+} StaticQueue_t;
+
+QueueHandle_t xQueueCreate( const UBaseType_t uxQueueLength,
+                            const UBaseType_t uxItemSize );
+QueueHandle_t xQueueCreateStatic( const UBaseType_t uxQueueLength,
+                                  const UBaseType_t uxItemSize,
+                                  uint8_t * pucQueueStorage,
+                                  StaticQueue_t * pxStaticQueue );
+void vQueueDelete( QueueHandle_t xQueue );
+
+BaseType_t xQueueSend( QueueHandle_t xQueue,
+                       const void * const pvItemToQueue,
+                       TickType_t xTicksToWait );
+BaseType_t xQueueSendFromISR( QueueHandle_t xQueue,
+                              const void * const pvItemToQueue,
+                              BaseType_t * const pxHigherPriorityTaskWoken );
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * const pvBuffer,
+                          TickType_t xTicksToWait );
+UBaseType_t uxQueueMessagesWaiting( const QueueHandle_t xQueue );
+UBaseType_t uxQueueSpacesAvailable( const QueueHandle_t xQueue );
+
+#define xQueueSendToBack( xQueue, pvItemToQueue, xTicksToWait )    xQueueSend( ( xQueue ), ( pvItemToQueue ), ( xTicksToWait ) )
+
+#endif /* ifndef HOST_QUEUE_H_ */
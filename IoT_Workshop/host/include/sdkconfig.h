@@ -0,0 +1,10 @@
+/*
+ * sdkconfig.h of the host build. No menuconfig option is set; in
+ * particular CONFIG_HEAP_TRACING is not, so driver/alloc_watch.h counts
+ * nothing.
+ */
+
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+
+#endif /* ifndef HOST_SDKCONFIG_H_ */
@@ -0,0 +1,28 @@
+/*
+ * semphr.h of the host build. As in FreeRTOS, semaphores and mutexes are
+ * queues of items of no size; a mutex starts given and has no priority
+ * inheritance, which the host scheduler would not honour anyway.
+ */
+
+#ifndef HOST_SEMPHR_H_
+#define HOST_SEMPHR_H_
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+typedef QueueHandle_t    SemaphoreHandle_t;
+typedef StaticQueue_t    StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void );
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount );
+SemaphoreHandle_t xSemaphoreCreateMutex( void );
+SemaphoreHandle_t xSemaphoreCreateMutexStatic( StaticSemaphore_t * pxMutexBuffer );
+
+#define xSemaphoreTake( xSemaphore, xBlockTime )                      xQueueReceive( ( xSemaphore ), NULL, ( xBlockTime ) )
+#define xSemaphoreGive( xSemaphore )                                  xQueueSend( ( xSemaphore ), NULL, 0 )
+#define xSemaphoreGiveFromISR( xSemaphore, pxHigherPriorityTaskWoken )    xQueueSendFromISR( ( xSemaphore ), NULL, ( pxHigherPriorityTaskWoken ) )
+#define vSemaphoreDelete( xSemaphore )                                vQueueDelete( ( xSemaphore ) )
+#define uxSemaphoreGetCount( xSemaphore )                             uxQueueMessagesWaiting( ( xSemaphore ) )
+
+#endif /* ifndef HOST_SEMPHR_H_ */
@@ -0,0 +1,27 @@
+/*
+ * stream_buffer.h of the host build: byte streams between one writer and
+ * one reader, as implemented by port/freertos_posix.c.
+ */
+
+#ifndef HOST_STREAM_BUFFER_H_
+#define HOST_STREAM_BUFFER_H_
+
+#include "FreeRTOS.h"
+
+typedef struct StreamBufferDef_t * StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate( size_t xBufferSizeBytes,
+                                          size_t xTriggerLevelBytes );
+void vStreamBufferDelete( StreamBufferHandle_t xStreamBuffer );
+size_t xStreamBufferSend( StreamBufferHandle_t xStreamBuffer,
+                          const void * pvTxData,
+                          size_t xDataLengthBytes,
+                          TickType_t xTicksToWait );
+size_t xStreamBufferReceive( StreamBufferHandle_t xStreamBuffer,
+                             void * pvRxData,
+                             size_t xBufferLengthBytes,
+                             TickType_t xTicksToWait );
+size_t xStreamBufferBytesAvailable( StreamBufferHandle_t xStreamBuffer );
+size_t xStreamBufferSpacesAvailable( StreamBufferHandle_t xStreamBuffer );
+
+#endif /* ifndef HOST_STREAM_BUFFER_H_ */
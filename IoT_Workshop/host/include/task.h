@@ -0,0 +1,125 @@
+/*
+ * task.h of the host build: tasks, delays, notifications and the system
+ * state, as port/freertos_posix.c implements them on POSIX threads.
+ *
+ * Every task is a thread. Priorities and core affinities are recorded but
+ * left to the host scheduler, so tasks really run in parallel, as they do
+ * on the two cores of the ESP32.
+ */
+
+#ifndef HOST_TASK_H_
+#define HOST_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock * TaskHandle_t;
+typedef void (* TaskFunction_t)( void * pvParameters );
+
+/* The host allocates its own control block; the buffer only has to exist. */
+typedef struct xSTATIC_TCB
+{
+    void * pvDummy;
+} StaticTask_t;
+
+typedef enum
+{
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+typedef enum
+{
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+typedef struct xTASK_STATUS
+{
+    TaskHandle_t xHandle;
+    const char * pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;     /* CPU time of the thread, in microseconds. */
+    StackType_t * pxStackBase;
+    uint16_t usStackHighWaterMark; /* Not measured; the stack size asked for. */
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+#define taskENTER_CRITICAL( pxMux )    portENTER_CRITICAL( pxMux )
+#define taskEXIT_CRITICAL( pxMux )     portEXIT_CRITICAL( pxMux )
+#define taskYIELD()                    vPortYield()
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask );
+BaseType_t xTaskCreatePinnedToCore( TaskFunction_t pxTaskCode,
+                                    const char * const pcName,
+                                    const uint32_t usStackDepth,
+                                    void * const pvParameters,
+                                    UBaseType_t uxPriority,
+                                    TaskHandle_t * const pxCreatedTask,
+                                    const BaseType_t xCoreID );
+TaskHandle_t xTaskCreateStatic( TaskFunction_t pxTaskCode,
+                                const char * const pcName,
+                                const uint32_t ulStackDepth,
+                                void * const pvParameters,
+                                UBaseType_t uxPriority,
+                                StackType_t * const puxStackBuffer,
+                                StaticTask_t * const pxTaskBuffer );
+TaskHandle_t xTaskCreateStaticPinnedToCore( TaskFunction_t pxTaskCode,
+                                            const char * const pcName,
+                                            const uint32_t ulStackDepth,
+                                            void * const pvParameters,
+                                            UBaseType_t uxPriority,
+                                            StackType_t * const puxStackBuffer,
+                                            StaticTask_t * const pxTaskBuffer,
+                                            const BaseType_t xCoreID );
+
+/* Only a task can delete itself (xTask NULL). */
+void vTaskDelete( TaskHandle_t xTask );
+void vTaskDelay( const TickType_t xTicksToDelay );
+void vTaskDelayUntil( TickType_t * const pxPreviousWakeTime,
+                      const TickType_t xTimeIncrement );
+
+TickType_t xTaskGetTickCount( void );
+TickType_t xTaskGetTickCountFromISR( void );
+TaskHandle_t xTaskGetCurrentTaskHandle( void );
+char * pcTaskGetTaskName( TaskHandle_t xTaskToQuery );
+UBaseType_t uxTaskPriorityGet( TaskHandle_t xTask );
+UBaseType_t uxTaskGetStackHighWaterMark( TaskHandle_t xTask );
+UBaseType_t uxTaskGetNumberOfTasks( void );
+UBaseType_t uxTaskGetSystemState( TaskStatus_t * const pxTaskStatusArray,
+                                  const UBaseType_t uxArraySize,
+                                  uint32_t * const pulTotalRunTime );
+
+BaseType_t xTaskNotify( TaskHandle_t xTaskToNotify,
+                        uint32_t ulValue,
+                        eNotifyAction eAction );
+BaseType_t xTaskNotifyFromISR( TaskHandle_t xTaskToNotify,
+                               uint32_t ulValue,
+                               eNotifyAction eAction,
+                               BaseType_t * pxHigherPriorityTaskWoken );
+BaseType_t xTaskNotifyWait( uint32_t ulBitsToClearOnEntry,
+                            uint32_t ulBitsToClearOnExit,
+                            uint32_t * pulNotificationValue,
+                            TickType_t xTicksToWait );
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait );
+void vTaskNotifyGiveFromISR( TaskHandle_t xTaskToNotify,
+                             BaseType_t * pxHigherPriorityTaskWoken );
+
+#define xTaskNotifyGive( xTaskToNotify )    xTaskNotify( ( xTaskToNotify ), 0, eIncrement )
+
+#endif /* ifndef HOST_TASK_H_ */
@@ -0,0 +1,57 @@
+/*
+ * timers.h of the host build. Callbacks run on one timer thread, in the
+ * order the timers expire, like those of the FreeRTOS timer task.
+ */
+
+#ifndef HOST_TIMERS_H_
+#define HOST_TIMERS_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct tmrTimerControl * TimerHandle_t;
+typedef void (* TimerCallbackFunction_t)( TimerHandle_t xTimer );
+typedef void (* PendedFunction_t)( void * pvParameter1,
+                                   uint32_t ulParameter2 );
+
+typedef struct xSTATIC_TIMER
+{
+    void * pvDummy;
+} StaticTimer_t;
+
+TimerHandle_t xTimerCreate( const char * const pcTimerName,
+                            const TickType_t xTimerPeriodInTicks,
+                            const UBaseType_t uxAutoReload,
+                            void * const pvTimerID,
+                            TimerCallbackFunction_t pxCallbackFunction );
+TimerHandle_t xTimerCreateStatic( const char * const pcTimerName,
+                                  const TickType_t xTimerPeriodInTicks,
+                                  const UBaseType_t uxAutoReload,
+                                  void * const pvTimerID,
+                                  TimerCallbackFunction_t pxCallbackFunction,
+                                  StaticTimer_t * pxTimerBuffer );
+
+BaseType_t xTimerStart( TimerHandle_t xTimer,
+                        TickType_t xTicksToWait );
+BaseType_t xTimerStop( TimerHandle_t xTimer,
+                       TickType_t xTicksToWait );
+BaseType_t xTimerReset( TimerHandle_t xTimer,
+                        TickType_t xTicksToWait );
+BaseType_t xTimerChangePeriod( TimerHandle_t xTimer,
+                               TickType_t xNewPeriod,
+                               TickType_t xTicksToWait );
+BaseType_t xTimerDelete( TimerHandle_t xTimer,
+                         TickType_t xTicksToWait );
+BaseType_t xTimerIsTimerActive( TimerHandle_t xTimer );
+void * pvTimerGetTimerID( const TimerHandle_t xTimer );
+BaseType_t xTimerPendFunctionCall( PendedFunction_t xFunctionToPend,
+                                   void * pvParameter1,
+                                   uint32_t ulParameter2,
+                                   TickType_t xTicksToWait );
+TaskHandle_t xTimerGetTimerDaemonTaskHandle( void );
+
+#define xTimerStartFromISR( xTimer, pxHigherPriorityTaskWoken )    xTimerStart( ( xTimer ), 0 )
+#define xTimerPendFunctionCallFromISR( xFunctionToPend, pvParameter1, ulParameter2, pxHigherPriorityTaskWoken ) \
+    xTimerPendFunctionCall( ( xFunctionToPend ), ( pvParameter1 ), ( ulParameter2 ), 0 )
+
+#endif /* ifndef HOST_TIMERS_H_ */
@@ -0,0 +1,14 @@
+/*
+ * xtensa/hal.h of the host build. The cycle counter is derived from the
+ * monotonic clock at configCPU_CLOCK_HZ, so cycle costs read as they would
+ * on an ESP32 running as fast as the host.
+ */
+
+#ifndef HOST_XTENSA_HAL_H_
+#define HOST_XTENSA_HAL_H_
+
+#include <stdint.h>
+
+uint32_t xthal_get_ccount( void );
+
+#endif /* ifndef HOST_XTENSA_HAL_H_ */
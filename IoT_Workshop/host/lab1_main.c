@@ -0,0 +1,260 @@
+/*
+ * lab1_main.c: runs RunMqttDemo() of Lab1 on this host.
+ *
+ * The demo connects over TLS to the broker stand-in of host_port.h, which
+ * takes the place of AWS IoT Core. The vibration sensor on GPIO14 gives an
+ * edge every second, and the DHT22 is the simulated one. With -d the broker
+ * drops its connections after that many seconds; the demo should connect
+ * again and resume its TLS session. After the given number of seconds the
+ * broker's counters are printed and the process exits; the demo itself
+ * publishes for as long as it runs.
+ *
+ * Built with IOT_DEMO_MQTT_BENCHMARK=1 (lab1-bench), the demo measures its
+ * pipeline against the in-process loopback broker instead, and prints its
+ * JSON lines; no edges are given, and the loopback broker's counters are
+ * printed at the end. The full run of rates takes under two minutes.
+ *
+ * Built with IOT_DEMO_MQTT_FAULT_INJECTION=1 and IOT_DEMO_MQTT_LOOPBACK=1
+ * (lab1-faults), the demo goes through the fault schedule of
+ * iot_demo_fault.h against the loopback broker. At the end the readings
+ * stop, those still queued or in flight are given time to be acknowledged,
+ * and the readings lost are printed. Those dropped on a full ring, as the
+ * slow link of the schedule must, are counted apart; the exit status is a
+ * failure if any other was lost.
+ *
+ * With CPPFLAGS="-DdlogENABLED=0 -DschedtraceENABLED=1" the scheduler trace
+ * (driver/sched_trace.h) is recorded and printed as SCHED lines at the end;
+ * tools/sched_trace_json.c converts them.
+ *
+ *   ./lab1 [-t seconds] [-d seconds]
+ *   ./lab1-bench [-t seconds]
+ *   ./lab1-faults [-t seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "aws_demo_config.h"
+#include "aws_clientcredential.h"
+#include "platform/iot_network_freertos.h"
+#include "host_port.h"
+
+#include "driver/sched_trace.h"
+
+#include "iot_demo_bench.h"
+#include "iot_demo_fault.h"
+#include "iot_demo_loopback_broker.h"
+
+#if IOT_DEMO_MQTT_BENCHMARK == 1
+    #define hostDEFAULT_RUN_SECONDS    ( 120 )
+#elif IOT_DEMO_MQTT_FAULT_INJECTION == 1
+    /* The default schedule is back to clean at 310 s. */
+    #define hostDEFAULT_RUN_SECONDS    ( 330 )
+#else
+    #define hostDEFAULT_RUN_SECONDS    ( 30 )
+#endif
+#define hostEDGE_PERIOD_MS             ( 1000 )
+#define hostDRAIN_SECONDS              ( 60 )
+
+int RunMqttDemo( bool awsIotMqttMode,
+                 const char * pIdentifier,
+                 void * pNetworkServerInfo,
+                 void * pNetworkCredentialInfo,
+                 const IotNetworkInterface_t * pNetworkInterface );
+
+static IotNetworkServerInfo_t xServerInfo =
+{
+    .pHostName = clientcredentialMQTT_BROKER_ENDPOINT,
+    .port      = clientcredentialMQTT_BROKER_PORT
+};
+
+static IotNetworkCredentials_t xCredentials = { 0 };
+
+#if IOT_DEMO_MQTT_FAULT_INJECTION == 1
+    /* The demo's sampling timer. */
+    extern TimerHandle_t xRequestTimer;
+#endif
+
+/*-----------------------------------------------------------*/
+
+static void prvDemoRunner( void * pvParameters )
+{
+    int lStatus;
+
+    ( void ) pvParameters;
+
+    lStatus = RunMqttDemo( true,
+                           clientcredentialIOT_THING_NAME,
+                           &xServerInfo,
+                           &xCredentials,
+                           IOT_NETWORK_INTERFACE_AFR );
+
+    configPRINTF( ( "RunMqttDemo returned %s.\r\n", ( lStatus == EXIT_SUCCESS ) ? "EXIT_SUCCESS" : "EXIT_FAILURE" ) );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+#if IOT_DEMO_MQTT_FAULT_INJECTION == 1
+
+/* Stop the readings, wait for those queued or in flight to be acknowledged,
+ * and print what the faults cost. */
+    static int prvDrainReadings( void )
+    {
+        IotDemoFaultStats_t xFaults;
+        TickType_t xEnd = xTaskGetTickCount() + pdMS_TO_TICKS( hostDRAIN_SECONDS * 1000U );
+        uint32_t ulLost, ulUnacked;
+
+        /* The adaptive period may start the timer again with a reading
+         * already taken, so it is stopped until the end. */
+        do
+        {
+            if( xRequestTimer != NULL )
+            {
+                ( void ) xTimerStop( xRequestTimer, 0 );
+            }
+
+            vTaskDelay( pdMS_TO_TICKS( 500 ) );
+            IotDemoFault_GetStats( &xFaults );
+        } while( ( xFaults.readingsAcked + xFaults.readingsDropped < xFaults.readingsProduced ) &&
+                 ( xTaskGetTickCount() < xEnd ) );
+
+        IotDemoFault_Print();
+        ulLost = xFaults.readingsProduced - xFaults.readingsAcked;
+        ulUnacked = ulLost - xFaults.readingsDropped;
+
+        printf( "faults: disconnects %u, refusals %u, recoveries %u (max %u ms); "
+                "readings produced %u, acknowledged %u, lost %u (%u to a full ring)\n",
+                ( unsigned ) xFaults.disconnects, ( unsigned ) xFaults.refusals,
+                ( unsigned ) xFaults.recoveries, ( unsigned ) xFaults.maxRecoveryMs,
+                ( unsigned ) xFaults.readingsProduced, ( unsigned ) xFaults.readingsAcked,
+                ( unsigned ) ulLost, ( unsigned ) xFaults.readingsDropped );
+        fflush( stdout );
+
+        /* A bounded ring drops readings that the link cannot carry; one
+         * taken into the ring must not be lost. */
+        return ( ( ulUnacked == 0 ) && ( xFaults.readingsProduced > 0 ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+#endif /* if IOT_DEMO_MQTT_FAULT_INJECTION == 1 */
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    TickType_t xStart, xEnd;
+    long lSeconds = hostDEFAULT_RUN_SECONDS;
+    int iOption, iStatus = EXIT_SUCCESS;
+
+    #if IOT_DEMO_MQTT_LOOPBACK == 0
+        TickType_t xDrop = portMAX_DELAY;
+        const char * pcOptions = "t:d:";
+    #else
+        const char * pcOptions = "t:";
+    #endif
+
+    while( ( iOption = getopt( argc, argv, pcOptions ) ) != -1 )
+    {
+        if( iOption == 't' )
+        {
+            lSeconds = strtol( optarg, NULL, 10 );
+        }
+
+        #if IOT_DEMO_MQTT_LOOPBACK == 0
+            else if( iOption == 'd' )
+            {
+                xDrop = pdMS_TO_TICKS( ( TickType_t ) strtol( optarg, NULL, 10 ) * 1000U );
+            }
+        #endif
+        else
+        {
+            fprintf( stderr, "usage: %s [-t seconds]%s\n", argv[ 0 ],
+                     ( IOT_DEMO_MQTT_LOOPBACK == 0 ) ? " [-d seconds]" : "" );
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    HostPort_Init();
+
+    #if IOT_DEMO_MQTT_LOOPBACK == 0
+        HostBrokerHandle_t xBroker = HostBroker_Start( clientcredentialMQTT_BROKER_PORT, true, 0 );
+        HostBrokerStats_t xStats;
+
+        if( xBroker == NULL )
+        {
+            return EXIT_FAILURE;
+        }
+    #elif IOT_DEMO_MQTT_BENCHMARK == 1
+        IotDemoLoopbackBrokerStats_t xStats;
+    #endif
+
+    xCredentials.pRootCa = pcHostCaCertificate;
+    xCredentials.rootCaSize = ulHostCaCertificateSize;
+
+    if( xTaskCreate( prvDemoRunner, "DemoRunner", democonfigDEMO_STACKSIZE, NULL,
+                     tskIDLE_PRIORITY + 5, NULL ) != pdPASS )
+    {
+        return EXIT_FAILURE;
+    }
+
+    xStart = xTaskGetTickCount();
+    xEnd = xStart + pdMS_TO_TICKS( ( TickType_t ) lSeconds * 1000U );
+
+    while( xTaskGetTickCount() < xEnd )
+    {
+        vTaskDelay( pdMS_TO_TICKS( hostEDGE_PERIOD_MS ) );
+
+        /* A rising edge on the vibration input, as the sensor gives when
+         * shaken; the benchmark offers its own events. */
+        #if IOT_DEMO_MQTT_BENCHMARK == 0
+            HostGpio_Edge( GPIO_NUM_14, 0 );
+            HostGpio_Edge( GPIO_NUM_14, 1 );
+        #endif
+
+        #if IOT_DEMO_MQTT_LOOPBACK == 0
+            if( ( xDrop != portMAX_DELAY ) && ( xTaskGetTickCount() - xStart >= xDrop ) )
+            {
+                configPRINTF( ( "Host: the broker drops its connections.\r\n" ) );
+                HostBroker_DropConnections( xBroker );
+                xDrop = portMAX_DELAY;
+            }
+        #endif
+    }
+
+    /* Built with -DschedtraceENABLED=1, the SCHED lines of the run. */
+    SchedTrace_Dump();
+
+    #if IOT_DEMO_MQTT_FAULT_INJECTION == 1
+        iStatus = prvDrainReadings();
+    #endif
+
+    #if IOT_DEMO_MQTT_LOOPBACK == 0
+        HostBroker_GetStats( xBroker, &xStats );
+        printf( "broker: connections %u, handshakes %u (resumed %u), CONNECTs %u, PUBLISHes %u, delivered %u\n",
+                ( unsigned ) xStats.ulConnections, ( unsigned ) xStats.ulHandshakes,
+                ( unsigned ) xStats.ulResumed, ( unsigned ) xStats.ulConnects,
+                ( unsigned ) xStats.ulPublishes, ( unsigned ) xStats.ulDelivered );
+        fflush( stdout );
+
+        /* The demo tasks never return; leave them running. */
+        _exit( ( xStats.ulPublishes > 0 ) ? iStatus : EXIT_FAILURE );
+    #elif IOT_DEMO_MQTT_BENCHMARK == 1
+        IotDemoLoopbackBroker_GetStats( &xStats );
+        printf( "loopback broker: PUBLISHes %lu (%lu bytes), sends %lu, wire bytes %lu\n",
+                ( unsigned long ) xStats.publishes, ( unsigned long ) xStats.publishBytes,
+                ( unsigned long ) xStats.sends, ( unsigned long ) xStats.wireBytes );
+        fflush( stdout );
+
+        _exit( ( xStats.publishes > 0 ) ? iStatus : EXIT_FAILURE );
+    #else
+        _exit( iStatus );
+    #endif
+}
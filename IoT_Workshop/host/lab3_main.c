@@ -0,0 +1,202 @@
+/*
+ * lab3_main.c: runs vStartGreenGrassDiscoveryTask() of Lab3 on this host.
+ *
+ * The discovery service stand-in answers for one group with two cores,
+ * each a broker stand-in on 127.0.0.1: the nearer one answers the TLS
+ * handshake at once, the further one after hostFAR_CORE_DELAY_MS. The
+ * demo should probe both, connect to the nearer one and move to the other
+ * when the nearer core drops its connections (-d). A third broker takes
+ * the place of AWS IoT Core for the fan-out of readings.
+ *
+ * With CPPFLAGS="-DdlogENABLED=0 -DschedtraceENABLED=1" the scheduler trace
+ * (driver/sched_trace.h) is recorded and printed as SCHED lines at the end;
+ * tools/sched_trace_json.c converts them.
+ *
+ *   ./lab3 [-t seconds] [-d seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "aws_demo_config.h"
+#include "aws_clientcredential.h"
+#include "platform/iot_network.h"
+#include "host_port.h"
+
+#include "driver/sched_trace.h"
+
+#define hostDEFAULT_RUN_SECONDS    ( 30 )
+#define hostEDGE_PERIOD_MS         ( 1000 )
+#define hostNEAR_CORE_PORT         ( 18884 )
+#define hostFAR_CORE_PORT          ( 18885 )
+#define hostFAR_CORE_DELAY_MS      ( 200 )
+
+int vStartGreenGrassDiscoveryTask( bool awsIotMqttMode,
+                                   const char * pIdentifier,
+                                   void * pNetworkServerInfo,
+                                   void * pNetworkCredentialInfo,
+                                   const IotNetworkInterface_t * pNetworkInterface );
+
+/*-----------------------------------------------------------*/
+
+/* The discovery document of a group whose cores are on this host; the CA
+ * is that of the stand-ins, escaped as the service escapes it. */
+static char * prvDiscoveryDocument( void )
+{
+    static const char cFormat[] =
+        "{\"GGGroups\":[{\"GGGroupId\":\"host-group\","
+        "\"Cores\":[{\"thingArn\":\"arn:aws:iot:host:000000000000:thing/FarCore\","
+        "\"Connectivity\":[{\"Id\":\"far\",\"HostAddress\":\"127.0.0.1\",\"PortNumber\":%u,\"Metadata\":\"\"}]},"
+        "{\"thingArn\":\"arn:aws:iot:host:000000000000:thing/NearCore\","
+        "\"Connectivity\":[{\"Id\":\"near\",\"HostAddress\":\"127.0.0.1\",\"PortNumber\":%u,\"Metadata\":\"\"}]}],"
+        "\"CAs\":[\"%s\"]}]}";
+    char * pcEscaped = malloc( 2 * ulHostCaCertificateSize );
+    char * pcDocument;
+    size_t xIn, xOut = 0, xSize;
+
+    if( pcEscaped == NULL )
+    {
+        return NULL;
+    }
+
+    for( xIn = 0; pcHostCaCertificate[ xIn ] != '\0'; xIn++ )
+    {
+        if( pcHostCaCertificate[ xIn ] == '\n' )
+        {
+            pcEscaped[ xOut++ ] = '\\';
+            pcEscaped[ xOut++ ] = 'n';
+        }
+        else
+        {
+            pcEscaped[ xOut++ ] = pcHostCaCertificate[ xIn ];
+        }
+    }
+
+    pcEscaped[ xOut ] = '\0';
+
+    xSize = sizeof( cFormat ) + xOut + 16;
+    pcDocument = malloc( xSize );
+
+    if( pcDocument != NULL )
+    {
+        ( void ) snprintf( pcDocument, xSize, cFormat, hostFAR_CORE_PORT, hostNEAR_CORE_PORT, pcEscaped );
+    }
+
+    free( pcEscaped );
+
+    return pcDocument;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDemoRunner( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    ( void ) vStartGreenGrassDiscoveryTask( true, clientcredentialIOT_THING_NAME, NULL, NULL, NULL );
+    configPRINTF( ( "vStartGreenGrassDiscoveryTask returned.\r\n" ) );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintStats( const char * pcName,
+                           HostBrokerHandle_t xBroker )
+{
+    HostBrokerStats_t xStats;
+
+    HostBroker_GetStats( xBroker, &xStats );
+    printf( "%s: connections %u, handshakes %u (resumed %u), CONNECTs %u, PUBLISHes %u, delivered %u\n",
+            pcName, ( unsigned ) xStats.ulConnections, ( unsigned ) xStats.ulHandshakes,
+            ( unsigned ) xStats.ulResumed, ( unsigned ) xStats.ulConnects,
+            ( unsigned ) xStats.ulPublishes, ( unsigned ) xStats.ulDelivered );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    HostBrokerHandle_t xCloud, xNearCore, xFarCore;
+    HostBrokerStats_t xNearStats, xFarStats;
+    TickType_t xStart, xEnd, xDrop = portMAX_DELAY;
+    long lSeconds = hostDEFAULT_RUN_SECONDS;
+    char * pcDocument;
+    int iOption;
+
+    while( ( iOption = getopt( argc, argv, "t:d:" ) ) != -1 )
+    {
+        if( iOption == 't' )
+        {
+            lSeconds = strtol( optarg, NULL, 10 );
+        }
+        else if( iOption == 'd' )
+        {
+            xDrop = pdMS_TO_TICKS( ( TickType_t ) strtol( optarg, NULL, 10 ) * 1000U );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [-t seconds] [-d seconds]\n", argv[ 0 ] );
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    HostPort_Init();
+
+    xCloud = HostBroker_Start( clientcredentialMQTT_BROKER_PORT, true, 0 );
+    xNearCore = HostBroker_Start( hostNEAR_CORE_PORT, true, 0 );
+    xFarCore = HostBroker_Start( hostFAR_CORE_PORT, true, hostFAR_CORE_DELAY_MS );
+    pcDocument = prvDiscoveryDocument();
+
+    if( ( xCloud == NULL ) || ( xNearCore == NULL ) || ( xFarCore == NULL ) || ( pcDocument == NULL ) ||
+        ( HostDiscovery_Start( clientcredentialGREENGRASS_DISCOVERY_PORT, pcDocument ) == false ) )
+    {
+        return EXIT_FAILURE;
+    }
+
+    free( pcDocument );
+
+    if( xTaskCreate( prvDemoRunner, "DemoRunner", democonfigDEMO_STACKSIZE, NULL,
+                     tskIDLE_PRIORITY + 5, NULL ) != pdPASS )
+    {
+        return EXIT_FAILURE;
+    }
+
+    xStart = xTaskGetTickCount();
+    xEnd = xStart + pdMS_TO_TICKS( ( TickType_t ) lSeconds * 1000U );
+
+    while( xTaskGetTickCount() < xEnd )
+    {
+        vTaskDelay( pdMS_TO_TICKS( hostEDGE_PERIOD_MS ) );
+        HostGpio_Edge( GPIO_NUM_14, 0 );
+        HostGpio_Edge( GPIO_NUM_14, 1 );
+
+        if( ( xDrop != portMAX_DELAY ) && ( xTaskGetTickCount() - xStart >= xDrop ) )
+        {
+            configPRINTF( ( "Host: the near core drops its connections.\r\n" ) );
+            HostBroker_DropConnections( xNearCore );
+            xDrop = portMAX_DELAY;
+        }
+    }
+
+    /* Built with -DschedtraceENABLED=1, the SCHED lines of the run. */
+    SchedTrace_Dump();
+
+    printf( "discovery: requests %u\n", ( unsigned ) HostDiscovery_Requests() );
+    prvPrintStats( "near core", xNearCore );
+    prvPrintStats( "far core", xFarCore );
+    prvPrintStats( "cloud", xCloud );
+    fflush( stdout );
+
+    HostBroker_GetStats( xNearCore, &xNearStats );
+    HostBroker_GetStats( xFarCore, &xFarStats );
+
+    /* The demo tasks never return; leave them running. */
+    _exit( ( xNearStats.ulPublishes + xFarStats.ulPublishes > 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
@@ -0,0 +1,496 @@
+/*
+ * broker_posix.c: an MQTT 3.1.1 broker on this host, in place of AWS IoT
+ * Core and of the Greengrass cores.
+ *
+ * Each connection has a thread that reads its packets. A PUBLISH goes to
+ * every connection with a matching subscription, the sender's included, at
+ * the lower of the two QoS levels. QoS 2 and retained messages are not
+ * supported, and acknowledgements of what the broker delivers are ignored.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+
+#include "host_listener.h"
+#include "host_port.h"
+
+/* Most topic filters a connection subscribes to. */
+#define brokerMAX_FILTERS        ( 16 )
+#define brokerMAX_FILTER_LENGTH  ( 128 )
+
+/* Largest packet accepted. */
+#define brokerMAX_PACKET_SIZE    ( 16384 )
+
+typedef struct BrokerConnection
+{
+    struct BrokerConnection * pxNext;
+    struct HostBroker * pxBroker;
+    HostLink_t xLink;
+    uint16_t usNextPacketIdentifier;
+    size_t xFilterCount;
+    uint8_t ucFilterQoS[ brokerMAX_FILTERS ];
+    char cFilters[ brokerMAX_FILTERS ][ brokerMAX_FILTER_LENGTH ];
+} BrokerConnection_t;
+
+struct HostBroker
+{
+    HostListener_t xListener;
+    pthread_mutex_t xLock;    /* Guards the connections and the stats. */
+    BrokerConnection_t * pxConnections;
+    HostBrokerStats_t xStats;
+};
+
+/*-----------------------------------------------------------*/
+
+static bool prvTopicMatches( const char * pcFilter,
+                             const char * pcTopic,
+                             size_t xTopicLength )
+{
+    size_t xFilter = 0, xTopic = 0;
+    size_t xFilterLength = strlen( pcFilter );
+
+    while( ( xFilter < xFilterLength ) && ( xTopic < xTopicLength ) )
+    {
+        if( pcFilter[ xFilter ] == '#' )
+        {
+            return true;
+        }
+
+        if( pcFilter[ xFilter ] == '+' )
+        {
+            while( ( xTopic < xTopicLength ) && ( pcTopic[ xTopic ] != '/' ) )
+            {
+                xTopic++;
+            }
+
+            xFilter++;
+        }
+        else if( pcFilter[ xFilter++ ] != pcTopic[ xTopic++ ] )
+        {
+            return false;
+        }
+    }
+
+    return ( xTopic == xTopicLength ) &&
+           ( ( xFilter == xFilterLength ) ||
+             ( strcmp( &( pcFilter[ xFilter ] ), "/#" ) == 0 ) ||
+             ( strcmp( &( pcFilter[ xFilter ] ), "#" ) == 0 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvEncodeLength( uint8_t * pucBuffer,
+                               size_t xLength )
+{
+    size_t xBytes = 0;
+
+    do
+    {
+        pucBuffer[ xBytes ] = ( uint8_t ) ( xLength % 128U );
+        xLength /= 128U;
+
+        if( xLength > 0 )
+        {
+            pucBuffer[ xBytes ] |= 0x80;
+        }
+
+        xBytes++;
+    } while( xLength > 0 );
+
+    return xBytes;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Send a PUBLISH to every subscriber; called with the broker locked. */
+static void prvDeliver( struct HostBroker * pxBroker,
+                        uint8_t ucQoS,
+                        const uint8_t * pucTopic,
+                        uint16_t usTopicLength,
+                        const uint8_t * pucPayload,
+                        size_t xPayloadLength )
+{
+    BrokerConnection_t * pxConnection;
+    uint8_t * pucPacket = malloc( 5 + 2 + usTopicLength + 2 + xPayloadLength );
+    uint8_t ucDeliveredQoS = 0;
+    size_t xFilter, xHeader, xRemaining;
+
+    if( pucPacket == NULL )
+    {
+        return;
+    }
+
+    for( pxConnection = pxBroker->pxConnections; pxConnection != NULL; pxConnection = pxConnection->pxNext )
+    {
+        for( xFilter = 0; xFilter < pxConnection->xFilterCount; xFilter++ )
+        {
+            if( prvTopicMatches( pxConnection->cFilters[ xFilter ], ( const char * ) pucTopic, usTopicLength ) == true )
+            {
+                break;
+            }
+        }
+
+        if( xFilter == pxConnection->xFilterCount )
+        {
+            continue;
+        }
+
+        ucDeliveredQoS = ( ucQoS < pxConnection->ucFilterQoS[ xFilter ] ) ? ucQoS : pxConnection->ucFilterQoS[ xFilter ];
+        xRemaining = 2U + usTopicLength + ( ( ucDeliveredQoS > 0 ) ? 2U : 0U ) + xPayloadLength;
+
+        pucPacket[ 0 ] = ( uint8_t ) ( 0x30 | ( ucDeliveredQoS << 1 ) );
+        xHeader = 1 + prvEncodeLength( &( pucPacket[ 1 ] ), xRemaining );
+        pucPacket[ xHeader++ ] = ( uint8_t ) ( usTopicLength >> 8 );
+        pucPacket[ xHeader++ ] = ( uint8_t ) ( usTopicLength & 0xFF );
+        memcpy( &( pucPacket[ xHeader ] ), pucTopic, usTopicLength );
+        xHeader += usTopicLength;
+
+        if( ucDeliveredQoS > 0 )
+        {
+            pxConnection->usNextPacketIdentifier += 2;
+            pucPacket[ xHeader++ ] = ( uint8_t ) ( pxConnection->usNextPacketIdentifier >> 8 );
+            pucPacket[ xHeader++ ] = ( uint8_t ) ( pxConnection->usNextPacketIdentifier & 0xFF );
+        }
+
+        memcpy( &( pucPacket[ xHeader ] ), pucPayload, xPayloadLength );
+
+        if( HostLink_Write( &( pxConnection->xLink ), pucPacket, xHeader + xPayloadLength ) == true )
+        {
+            pxBroker->xStats.ulDelivered++;
+        }
+    }
+
+    free( pucPacket );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvHandlePublish( BrokerConnection_t * pxConnection,
+                              uint8_t ucType,
+                              const uint8_t * pucBody,
+                              size_t xLength )
+{
+    struct HostBroker * pxBroker = pxConnection->pxBroker;
+    uint8_t ucQoS = ( ucType >> 1 ) & 0x03;
+    uint8_t ucPuback[ 4 ] = { 0x40, 2, 0, 0 };
+    uint16_t usTopicLength;
+    size_t xOffset;
+
+    if( ( xLength < 2 ) || ( ucQoS > 1 ) )
+    {
+        return false;
+    }
+
+    usTopicLength = ( uint16_t ) ( ( pucBody[ 0 ] << 8 ) | pucBody[ 1 ] );
+    xOffset = 2U + usTopicLength + ( ( ucQoS > 0 ) ? 2U : 0U );
+
+    if( xOffset > xLength )
+    {
+        return false;
+    }
+
+    if( ucQoS > 0 )
+    {
+        ucPuback[ 2 ] = pucBody[ xOffset - 2 ];
+        ucPuback[ 3 ] = pucBody[ xOffset - 1 ];
+        ( void ) HostLink_Write( &( pxConnection->xLink ), ucPuback, sizeof( ucPuback ) );
+    }
+
+    pthread_mutex_lock( &( pxBroker->xLock ) );
+    pxBroker->xStats.ulPublishes++;
+    prvDeliver( pxBroker, ucQoS, &( pucBody[ 2 ] ), usTopicLength, &( pucBody[ xOffset ] ), xLength - xOffset );
+    pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvHandleSubscription( BrokerConnection_t * pxConnection,
+                                   bool xSubscribe,
+                                   const uint8_t * pucBody,
+                                   size_t xLength )
+{
+    struct HostBroker * pxBroker = pxConnection->pxBroker;
+    uint8_t ucAck[ 4 + brokerMAX_FILTERS ];
+    size_t xOffset = 2, xCodes = 0, xFilter = 0;
+    uint16_t usFilterLength;
+    char cFilter[ brokerMAX_FILTER_LENGTH ];
+    uint8_t ucQoS = 0;
+
+    if( xLength < 2 )
+    {
+        return false;
+    }
+
+    pthread_mutex_lock( &( pxBroker->xLock ) );
+
+    while( xOffset + 2 <= xLength )
+    {
+        usFilterLength = ( uint16_t ) ( ( pucBody[ xOffset ] << 8 ) | pucBody[ xOffset + 1 ] );
+        xOffset += 2;
+
+        if( ( xOffset + usFilterLength + ( xSubscribe ? 1U : 0U ) > xLength ) ||
+            ( usFilterLength >= sizeof( cFilter ) ) || ( xCodes == brokerMAX_FILTERS ) )
+        {
+            pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+            return false;
+        }
+
+        memcpy( cFilter, &( pucBody[ xOffset ] ), usFilterLength );
+        cFilter[ usFilterLength ] = '\0';
+        xOffset += usFilterLength;
+
+        /* A filter subscribed to again replaces the old one. */
+        for( xFilter = 0; xFilter < pxConnection->xFilterCount; xFilter++ )
+        {
+            if( strcmp( pxConnection->cFilters[ xFilter ], cFilter ) == 0 )
+            {
+                pxConnection->xFilterCount--;
+                memmove( &( pxConnection->cFilters[ xFilter ] ), &( pxConnection->cFilters[ xFilter + 1 ] ),
+                         ( pxConnection->xFilterCount - xFilter ) * brokerMAX_FILTER_LENGTH );
+                memmove( &( pxConnection->ucFilterQoS[ xFilter ] ), &( pxConnection->ucFilterQoS[ xFilter + 1 ] ),
+                         pxConnection->xFilterCount - xFilter );
+                break;
+            }
+        }
+
+        if( xSubscribe == true )
+        {
+            ucQoS = ( pucBody[ xOffset++ ] > 0 ) ? 1 : 0;
+
+            if( pxConnection->xFilterCount < brokerMAX_FILTERS )
+            {
+                strcpy( pxConnection->cFilters[ pxConnection->xFilterCount ], cFilter );
+                pxConnection->ucFilterQoS[ pxConnection->xFilterCount++ ] = ucQoS;
+            }
+            else
+            {
+                ucQoS = 0x80;
+            }
+
+            ucAck[ 4 + xCodes ] = ucQoS;
+        }
+
+        xCodes++;
+    }
+
+    pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+    ucAck[ 0 ] = xSubscribe ? 0x90 : 0xB0;
+    ucAck[ 1 ] = ( uint8_t ) ( 2 + ( xSubscribe ? xCodes : 0 ) );
+    ucAck[ 2 ] = pucBody[ 0 ];
+    ucAck[ 3 ] = pucBody[ 1 ];
+
+    return HostLink_Write( &( pxConnection->xLink ), ucAck, 2U + ucAck[ 1 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvConnectionThread( void * pvArgument )
+{
+    BrokerConnection_t * pxConnection = pvArgument;
+    struct HostBroker * pxBroker = pxConnection->pxBroker;
+    BrokerConnection_t ** ppxLink;
+    uint8_t ucType, ucByte;
+    uint8_t * pucBody = malloc( brokerMAX_PACKET_SIZE );
+    size_t xLength, xMultiplier, xBytes;
+    bool xOpen = ( pucBody != NULL );
+    static const uint8_t ucConnack[ 4 ] = { 0x20, 2, 0, 0 };
+    static const uint8_t ucPingresp[ 2 ] = { 0xD0, 0 };
+
+    while( xOpen == true )
+    {
+        xOpen = HostLink_ReadAll( &( pxConnection->xLink ), &ucType, 1 );
+        xLength = 0;
+        xMultiplier = 1;
+
+        for( xBytes = 0; ( xOpen == true ) && ( xBytes < 4 ); xBytes++ )
+        {
+            xOpen = HostLink_ReadAll( &( pxConnection->xLink ), &ucByte, 1 );
+            xLength += ( size_t ) ( ucByte & 0x7F ) * xMultiplier;
+            xMultiplier *= 128U;
+
+            if( ( ucByte & 0x80 ) == 0 )
+            {
+                break;
+            }
+        }
+
+        if( ( xOpen == false ) || ( xLength > brokerMAX_PACKET_SIZE ) ||
+            ( HostLink_ReadAll( &( pxConnection->xLink ), pucBody, xLength ) == false ) )
+        {
+            break;
+        }
+
+        switch( ucType & 0xF0 )
+        {
+            case 0x10: /* CONNECT */
+                pthread_mutex_lock( &( pxBroker->xLock ) );
+                pxBroker->xStats.ulConnects++;
+                pthread_mutex_unlock( &( pxBroker->xLock ) );
+                xOpen = HostLink_Write( &( pxConnection->xLink ), ucConnack, sizeof( ucConnack ) );
+                break;
+
+            case 0x30: /* PUBLISH */
+                xOpen = prvHandlePublish( pxConnection, ucType, pucBody, xLength );
+                break;
+
+            case 0x40: /* PUBACK of a delivery */
+                break;
+
+            case 0x80: /* SUBSCRIBE */
+                xOpen = prvHandleSubscription( pxConnection, true, pucBody, xLength );
+                break;
+
+            case 0xA0: /* UNSUBSCRIBE */
+                xOpen = prvHandleSubscription( pxConnection, false, pucBody, xLength );
+                break;
+
+            case 0xC0: /* PINGREQ */
+                xOpen = HostLink_Write( &( pxConnection->xLink ), ucPingresp, sizeof( ucPingresp ) );
+                break;
+
+            default: /* DISCONNECT, or something the broker does not take. */
+                xOpen = false;
+                break;
+        }
+    }
+
+    pthread_mutex_lock( &( pxBroker->xLock ) );
+
+    for( ppxLink = &( pxBroker->pxConnections ); *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+    {
+        if( *ppxLink == pxConnection )
+        {
+            *ppxLink = pxConnection->pxNext;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+    HostLink_Close( &( pxConnection->xLink ) );
+    free( pxConnection );
+    free( pucBody );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvAcceptThread( void * pvArgument )
+{
+    struct HostBroker * pxBroker = pvArgument;
+    BrokerConnection_t * pxConnection;
+    pthread_t xThread;
+    int iSocket;
+
+    while( ( iSocket = HostListener_Accept( &( pxBroker->xListener ) ) ) >= 0 )
+    {
+        pthread_mutex_lock( &( pxBroker->xLock ) );
+        pxBroker->xStats.ulConnections++;
+        pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+        pxConnection = calloc( 1, sizeof( BrokerConnection_t ) );
+
+        if( pxConnection == NULL )
+        {
+            ( void ) close( iSocket );
+            continue;
+        }
+
+        pxConnection->pxBroker = pxBroker;
+        pxConnection->usNextPacketIdentifier = 0;
+
+        /* The handshake runs here, so a slow one holds up the next
+         * connection as a busy endpoint would. */
+        if( HostLink_Open( &( pxConnection->xLink ), &( pxBroker->xListener ), iSocket ) == false )
+        {
+            free( pxConnection );
+            continue;
+        }
+
+        pthread_mutex_lock( &( pxBroker->xLock ) );
+        pxConnection->pxNext = pxBroker->pxConnections;
+        pxBroker->pxConnections = pxConnection;
+        pthread_mutex_unlock( &( pxBroker->xLock ) );
+
+        if( pthread_create( &xThread, NULL, prvConnectionThread, pxConnection ) == 0 )
+        {
+            ( void ) pthread_detach( xThread );
+        }
+        else
+        {
+            HostLink_Shutdown( &( pxConnection->xLink ) );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+HostBrokerHandle_t HostBroker_Start( uint16_t usPort,
+                                     bool xTls,
+                                     uint32_t ulHandshakeDelayMs )
+{
+    struct HostBroker * pxBroker = calloc( 1, sizeof( struct HostBroker ) );
+    pthread_t xThread;
+
+    if( pxBroker == NULL )
+    {
+        return NULL;
+    }
+
+    pthread_mutex_init( &( pxBroker->xLock ), NULL );
+
+    if( ( HostListener_Start( &( pxBroker->xListener ), usPort, xTls, ulHandshakeDelayMs ) == false ) ||
+        ( pthread_create( &xThread, NULL, prvAcceptThread, pxBroker ) != 0 ) )
+    {
+        /* The listener's TLS state is left: the process is about to fail. */
+        return NULL;
+    }
+
+    ( void ) pthread_detach( xThread );
+
+    return pxBroker;
+}
+
+/*-----------------------------------------------------------*/
+
+void HostBroker_GetStats( HostBrokerHandle_t xBroker,
+                          HostBrokerStats_t * pxStats )
+{
+    pthread_mutex_lock( &( xBroker->xListener.xLock ) );
+    xBroker->xStats.ulHandshakes = xBroker->xListener.ulHandshakes;
+    xBroker->xStats.ulResumed = xBroker->xListener.ulResumed;
+    pthread_mutex_unlock( &( xBroker->xListener.xLock ) );
+
+    pthread_mutex_lock( &( xBroker->xLock ) );
+    *pxStats = xBroker->xStats;
+    pthread_mutex_unlock( &( xBroker->xLock ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void HostBroker_DropConnections( HostBrokerHandle_t xBroker )
+{
+    BrokerConnection_t * pxConnection;
+
+    pthread_mutex_lock( &( xBroker->xLock ) );
+
+    for( pxConnection = xBroker->pxConnections; pxConnection != NULL; pxConnection = pxConnection->pxNext )
+    {
+        HostLink_Shutdown( &( pxConnection->xLink ) );
+    }
+
+    pthread_mutex_unlock( &( xBroker->xLock ) );
+}
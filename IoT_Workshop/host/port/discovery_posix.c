@@ -0,0 +1,137 @@
+/*
+ * discovery_posix.c: the Greengrass discovery service on this host.
+ *
+ * Each request is served on its own TLS connection, which is closed after
+ * the reply, as the demo asks with "Connection: close".
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "host_listener.h"
+#include "host_port.h"
+
+#define discoveryPATH            "/greengrass/discover/thing/"
+#define discoveryMAX_REQUEST     ( 2048 )
+
+static HostListener_t xListener;
+static char * pcServedDocument;
+static pthread_mutex_t xRequestsLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t ulRequests;
+
+/*-----------------------------------------------------------*/
+
+static void prvServe( HostLink_t * pxLink )
+{
+    char cRequest[ discoveryMAX_REQUEST + 1 ];
+    char cHeader[ 128 ];
+    size_t xLength = 0;
+    ssize_t xRead;
+    int lHeaderLength;
+
+    /* Read the request line and headers; a request has no body. */
+    do
+    {
+        xRead = HostLink_Read( pxLink, ( uint8_t * ) &( cRequest[ xLength ] ), discoveryMAX_REQUEST - xLength );
+
+        if( xRead <= 0 )
+        {
+            return;
+        }
+
+        xLength += ( size_t ) xRead;
+        cRequest[ xLength ] = '\0';
+    } while( ( strstr( cRequest, "\r\n\r\n" ) == NULL ) && ( xLength < discoveryMAX_REQUEST ) );
+
+    if( strncmp( cRequest, "GET " discoveryPATH, strlen( "GET " discoveryPATH ) ) == 0 )
+    {
+        pthread_mutex_lock( &xRequestsLock );
+        ulRequests++;
+        pthread_mutex_unlock( &xRequestsLock );
+
+        lHeaderLength = snprintf( cHeader, sizeof( cHeader ),
+                                  "HTTP/1.1 200 OK\r\n"
+                                  "Content-Type: application/json\r\n"
+                                  "Content-Length: %u\r\n"
+                                  "Connection: close\r\n\r\n",
+                                  ( unsigned ) strlen( pcServedDocument ) );
+
+        if( HostLink_Write( pxLink, ( const uint8_t * ) cHeader, ( size_t ) lHeaderLength ) == true )
+        {
+            ( void ) HostLink_Write( pxLink, ( const uint8_t * ) pcServedDocument, strlen( pcServedDocument ) );
+        }
+    }
+    else
+    {
+        static const char cNotFound[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+        ( void ) HostLink_Write( pxLink, ( const uint8_t * ) cNotFound, sizeof( cNotFound ) - 1 );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvDiscoveryThread( void * pvArgument )
+{
+    HostLink_t xLink;
+    int iSocket;
+
+    ( void ) pvArgument;
+
+    while( ( iSocket = HostListener_Accept( &xListener ) ) >= 0 )
+    {
+        if( HostLink_Open( &xLink, &xListener, iSocket ) == true )
+        {
+            prvServe( &xLink );
+
+            if( xListener.xTls == true )
+            {
+                ( void ) mbedtls_ssl_close_notify( &( xLink.xSsl ) );
+            }
+
+            HostLink_Close( &xLink );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostDiscovery_Start( uint16_t usPort,
+                          const char * pcDocument )
+{
+    pthread_t xThread;
+
+    pcServedDocument = strdup( pcDocument );
+
+    if( ( pcServedDocument == NULL ) ||
+        ( HostListener_Start( &xListener, usPort, true, 0 ) == false ) ||
+        ( pthread_create( &xThread, NULL, prvDiscoveryThread, NULL ) != 0 ) )
+    {
+        return false;
+    }
+
+    ( void ) pthread_detach( xThread );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t HostDiscovery_Requests( void )
+{
+    uint32_t ulServed;
+
+    pthread_mutex_lock( &xRequestsLock );
+    ulServed = ulRequests;
+    pthread_mutex_unlock( &xRequestsLock );
+
+    return ulServed;
+}
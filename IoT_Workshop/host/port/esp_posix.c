@@ -0,0 +1,646 @@
+/*
+ * esp_posix.c: the ESP-IDF calls of the demos on the host: GPIO pins in
+ * memory, whose interrupt handlers run on the thread that injects an edge
+ * (HostGpio_Edge()); a key-value store in memory, which can be written to
+ * and read from a file (HostNvs_Save(), HostNvs_Load()); the microsecond
+ * timer and the cycle counter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "xtensa/hal.h"
+
+#include "host_port.h"
+
+#define espNVS_NAME_LENGTH       ( 16 )
+#define espNVS_MAX_NAMESPACES    ( 8 )
+#define espNVS_TYPE_U16          ( 0x02 )
+#define espNVS_TYPE_BLOB         ( 0x42 )
+
+/* The largest blob, as with the default ESP-IDF partition. */
+#define espNVS_MAX_BLOB_SIZE     ( 1984 )
+
+typedef struct GpioPin
+{
+    gpio_mode_t xMode;
+    gpio_int_type_t xIntrType;
+    uint32_t ulLevel;
+    gpio_isr_t pxHandler;
+    void * pvArgument;
+} GpioPin_t;
+
+typedef struct NvsEntry
+{
+    struct NvsEntry * pxNext;
+    uint8_t ucNamespace;
+    uint8_t ucType;
+    char cKey[ espNVS_NAME_LENGTH ];
+    size_t xLength;
+    uint8_t ucData[];
+} NvsEntry_t;
+
+/*-----------------------------------------------------------*/
+
+static GpioPin_t xPins[ GPIO_NUM_MAX ];
+static BaseType_t xIsrServiceInstalled = pdFALSE;
+
+static char cNamespaces[ espNVS_MAX_NAMESPACES ][ espNVS_NAME_LENGTH ];
+static NvsEntry_t * pxNvsEntries = NULL;
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_config( const gpio_config_t * pGPIOConfig )
+{
+    uint32_t ulPin;
+
+    if( ( pGPIOConfig == NULL ) || ( ( pGPIOConfig->pin_bit_mask >> GPIO_NUM_MAX ) != 0 ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( NULL );
+
+    for( ulPin = 0; ulPin < GPIO_NUM_MAX; ulPin++ )
+    {
+        if( ( pGPIOConfig->pin_bit_mask & ( 1ULL << ulPin ) ) != 0 )
+        {
+            xPins[ ulPin ].xMode = pGPIOConfig->mode;
+            xPins[ ulPin ].xIntrType = pGPIOConfig->intr_type;
+
+            /* An input idles at the level of its pull. */
+            if( ( pGPIOConfig->mode & GPIO_MODE_INPUT ) != 0 )
+            {
+                xPins[ ulPin ].ulLevel = ( pGPIOConfig->pull_up_en == GPIO_PULLUP_ENABLE ) ? 1 : 0;
+            }
+        }
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_set_intr_type( gpio_num_t gpio_num,
+                              gpio_int_type_t intr_type )
+{
+    if( ( gpio_num < 0 ) || ( gpio_num >= GPIO_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( NULL );
+    xPins[ gpio_num ].xIntrType = intr_type;
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_set_direction( gpio_num_t gpio_num,
+                              gpio_mode_t mode )
+{
+    if( ( gpio_num < 0 ) || ( gpio_num >= GPIO_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( NULL );
+    xPins[ gpio_num ].xMode = mode;
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_set_level( gpio_num_t gpio_num,
+                          uint32_t level )
+{
+    if( ( gpio_num < 0 ) || ( gpio_num >= GPIO_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( NULL );
+
+    if( ( xPins[ gpio_num ].xMode & GPIO_MODE_OUTPUT ) != 0 )
+    {
+        xPins[ gpio_num ].ulLevel = ( level != 0 ) ? 1 : 0;
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+int gpio_get_level( gpio_num_t gpio_num )
+{
+    int iLevel;
+
+    if( ( gpio_num < 0 ) || ( gpio_num >= GPIO_NUM_MAX ) )
+    {
+        return 0;
+    }
+
+    portENTER_CRITICAL( NULL );
+    iLevel = ( int ) xPins[ gpio_num ].ulLevel;
+    portEXIT_CRITICAL( NULL );
+
+    return iLevel;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_install_isr_service( int intr_alloc_flags )
+{
+    ( void ) intr_alloc_flags;
+
+    if( xIsrServiceInstalled == pdTRUE )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xIsrServiceInstalled = pdTRUE;
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_isr_handler_add( gpio_num_t gpio_num,
+                                gpio_isr_t isr_handler,
+                                void * args )
+{
+    if( ( gpio_num < 0 ) || ( gpio_num >= GPIO_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if( xIsrServiceInstalled == pdFALSE )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL( NULL );
+    xPins[ gpio_num ].pxHandler = isr_handler;
+    xPins[ gpio_num ].pvArgument = args;
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t gpio_isr_handler_remove( gpio_num_t gpio_num )
+{
+    return gpio_isr_handler_add( gpio_num, NULL, NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+void HostGpio_Edge( gpio_num_t xPin,
+                    uint32_t ulLevel )
+{
+    gpio_isr_t pxHandler = NULL;
+    void * pvArgument = NULL;
+    gpio_int_type_t xIntrType;
+
+    if( ( xPin < 0 ) || ( xPin >= GPIO_NUM_MAX ) )
+    {
+        return;
+    }
+
+    ulLevel = ( ulLevel != 0 ) ? 1 : 0;
+
+    portENTER_CRITICAL( NULL );
+
+    if( ( ( xPins[ xPin ].xMode & GPIO_MODE_INPUT ) != 0 ) && ( xPins[ xPin ].ulLevel != ulLevel ) )
+    {
+        xPins[ xPin ].ulLevel = ulLevel;
+        xIntrType = xPins[ xPin ].xIntrType;
+
+        if( ( xIntrType == GPIO_INTR_ANYEDGE ) ||
+            ( ( xIntrType == GPIO_INTR_POSEDGE ) && ( ulLevel == 1 ) ) ||
+            ( ( xIntrType == GPIO_INTR_NEGEDGE ) && ( ulLevel == 0 ) ) )
+        {
+            pxHandler = xPins[ xPin ].pxHandler;
+            pvArgument = xPins[ xPin ].pvArgument;
+        }
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    if( pxHandler != NULL )
+    {
+        pxHandler( pvArgument );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int64_t esp_timer_get_time( void )
+{
+    static struct timespec xStart;
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    if( ( xStart.tv_sec == 0 ) && ( xStart.tv_nsec == 0 ) )
+    {
+        xStart = xNow;
+    }
+
+    return ( int64_t ) ( xNow.tv_sec - xStart.tv_sec ) * 1000000LL +
+           ( ( int64_t ) xNow.tv_nsec - xStart.tv_nsec ) / 1000LL;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t xthal_get_ccount( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    /* Wraps, as the 32-bit counter of the ESP32 does. */
+    return ( uint32_t ) ( ( uint64_t ) xNow.tv_sec * configCPU_CLOCK_HZ +
+                          ( uint64_t ) xNow.tv_nsec * ( configCPU_CLOCK_HZ / 1000000UL ) / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Handles are the namespace index plus one. */
+static BaseType_t prvNvsNamespace( nvs_handle handle,
+                                   uint8_t * pucNamespace )
+{
+    if( ( handle == 0 ) || ( handle > espNVS_MAX_NAMESPACES ) ||
+        ( cNamespaces[ handle - 1 ][ 0 ] == '\0' ) )
+    {
+        return pdFAIL;
+    }
+
+    *pucNamespace = ( uint8_t ) ( handle - 1 );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Called with the critical section held. */
+static NvsEntry_t ** prvNvsFind( uint8_t ucNamespace,
+                                 const char * key )
+{
+    NvsEntry_t ** ppxLink;
+
+    for( ppxLink = &pxNvsEntries; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+    {
+        if( ( ( *ppxLink )->ucNamespace == ucNamespace ) &&
+            ( strncmp( ( *ppxLink )->cKey, key, espNVS_NAME_LENGTH ) == 0 ) )
+        {
+            return ppxLink;
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvNvsSet( nvs_handle handle,
+                            const char * key,
+                            uint8_t ucType,
+                            const void * pvValue,
+                            size_t xLength )
+{
+    NvsEntry_t ** ppxLink;
+    NvsEntry_t * pxEntry;
+    uint8_t ucNamespace;
+
+    if( prvNvsNamespace( handle, &ucNamespace ) == pdFAIL )
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if( ( key == NULL ) || ( strlen( key ) >= espNVS_NAME_LENGTH ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if( xLength > espNVS_MAX_BLOB_SIZE )
+    {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    pxEntry = malloc( sizeof( NvsEntry_t ) + xLength );
+
+    if( pxEntry == NULL )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset( pxEntry, 0x00, sizeof( NvsEntry_t ) );
+    pxEntry->ucNamespace = ucNamespace;
+    pxEntry->ucType = ucType;
+    strncpy( pxEntry->cKey, key, espNVS_NAME_LENGTH - 1 );
+    pxEntry->xLength = xLength;
+    memcpy( pxEntry->ucData, pvValue, xLength );
+
+    portENTER_CRITICAL( NULL );
+    ppxLink = prvNvsFind( ucNamespace, key );
+
+    if( ppxLink != NULL )
+    {
+        NvsEntry_t * pxOld = *ppxLink;
+
+        pxEntry->pxNext = pxOld->pxNext;
+        *ppxLink = pxEntry;
+        free( pxOld );
+    }
+    else
+    {
+        pxEntry->pxNext = pxNvsEntries;
+        pxNvsEntries = pxEntry;
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvNvsGet( nvs_handle handle,
+                            const char * key,
+                            uint8_t ucType,
+                            void * pvValue,
+                            size_t * pxLength )
+{
+    NvsEntry_t ** ppxLink;
+    uint8_t ucNamespace;
+    esp_err_t xResult = ESP_OK;
+
+    if( prvNvsNamespace( handle, &ucNamespace ) == pdFAIL )
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    portENTER_CRITICAL( NULL );
+    ppxLink = prvNvsFind( ucNamespace, key );
+
+    if( ( ppxLink == NULL ) || ( ( *ppxLink )->ucType != ucType ) )
+    {
+        xResult = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if( pvValue == NULL )
+    {
+        /* As in ESP-IDF, a NULL buffer asks for the length. */
+        *pxLength = ( *ppxLink )->xLength;
+    }
+    else if( *pxLength < ( *ppxLink )->xLength )
+    {
+        xResult = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy( pvValue, ( *ppxLink )->ucData, ( *ppxLink )->xLength );
+        *pxLength = ( *ppxLink )->xLength;
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_open( const char * name,
+                    nvs_open_mode open_mode,
+                    nvs_handle * out_handle )
+{
+    esp_err_t xResult = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    uint32_t x;
+
+    if( ( name == NULL ) || ( name[ 0 ] == '\0' ) || ( strlen( name ) >= espNVS_NAME_LENGTH ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( NULL );
+
+    for( x = 0; x < espNVS_MAX_NAMESPACES; x++ )
+    {
+        if( strcmp( cNamespaces[ x ], name ) == 0 )
+        {
+            break;
+        }
+    }
+
+    if( x == espNVS_MAX_NAMESPACES )
+    {
+        if( open_mode == NVS_READONLY )
+        {
+            xResult = ESP_ERR_NVS_NOT_FOUND;
+        }
+        else
+        {
+            for( x = 0; ( x < espNVS_MAX_NAMESPACES ) && ( cNamespaces[ x ][ 0 ] != '\0' ); x++ )
+            {
+            }
+
+            if( x < espNVS_MAX_NAMESPACES )
+            {
+                strcpy( cNamespaces[ x ], name );
+            }
+        }
+    }
+
+    if( x < espNVS_MAX_NAMESPACES )
+    {
+        *out_handle = x + 1;
+        xResult = ESP_OK;
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void nvs_close( nvs_handle handle )
+{
+    ( void ) handle;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_commit( nvs_handle handle )
+{
+    uint8_t ucNamespace;
+
+    /* Writes are kept as they are made. */
+    return ( prvNvsNamespace( handle, &ucNamespace ) == pdPASS ) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_get_u16( nvs_handle handle,
+                       const char * key,
+                       uint16_t * out_value )
+{
+    size_t xLength = sizeof( uint16_t );
+
+    return prvNvsGet( handle, key, espNVS_TYPE_U16, out_value, &xLength );
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_set_u16( nvs_handle handle,
+                       const char * key,
+                       uint16_t value )
+{
+    return prvNvsSet( handle, key, espNVS_TYPE_U16, &value, sizeof( value ) );
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_get_blob( nvs_handle handle,
+                        const char * key,
+                        void * out_value,
+                        size_t * length )
+{
+    return prvNvsGet( handle, key, espNVS_TYPE_BLOB, out_value, length );
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_set_blob( nvs_handle handle,
+                        const char * key,
+                        const void * value,
+                        size_t length )
+{
+    return prvNvsSet( handle, key, espNVS_TYPE_BLOB, value, length );
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t nvs_erase_key( nvs_handle handle,
+                         const char * key )
+{
+    NvsEntry_t ** ppxLink;
+    NvsEntry_t * pxEntry = NULL;
+    uint8_t ucNamespace;
+
+    if( prvNvsNamespace( handle, &ucNamespace ) == pdFAIL )
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    portENTER_CRITICAL( NULL );
+    ppxLink = prvNvsFind( ucNamespace, key );
+
+    if( ppxLink != NULL )
+    {
+        pxEntry = *ppxLink;
+        *ppxLink = pxEntry->pxNext;
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    if( pxEntry == NULL )
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    free( pxEntry );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The file is a list of records: namespace, key, type, 32-bit length and
+ * the value, in host byte order.
+ */
+bool HostNvs_Save( const char * pcPath )
+{
+    FILE * pxFile = fopen( pcPath, "wb" );
+    NvsEntry_t * pxEntry;
+    uint32_t ulLength;
+    bool xResult = true;
+
+    if( pxFile == NULL )
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL( NULL );
+
+    for( pxEntry = pxNvsEntries; ( pxEntry != NULL ) && ( xResult == true ); pxEntry = pxEntry->pxNext )
+    {
+        ulLength = ( uint32_t ) pxEntry->xLength;
+        xResult = ( fwrite( cNamespaces[ pxEntry->ucNamespace ], espNVS_NAME_LENGTH, 1, pxFile ) == 1 ) &&
+                  ( fwrite( pxEntry->cKey, espNVS_NAME_LENGTH, 1, pxFile ) == 1 ) &&
+                  ( fwrite( &( pxEntry->ucType ), 1, 1, pxFile ) == 1 ) &&
+                  ( fwrite( &ulLength, sizeof( ulLength ), 1, pxFile ) == 1 ) &&
+                  ( fwrite( pxEntry->ucData, 1, pxEntry->xLength, pxFile ) == pxEntry->xLength );
+    }
+
+    portEXIT_CRITICAL( NULL );
+
+    return ( fclose( pxFile ) == 0 ) && xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostNvs_Load( const char * pcPath )
+{
+    FILE * pxFile = fopen( pcPath, "rb" );
+    char cNamespace[ espNVS_NAME_LENGTH ];
+    char cKey[ espNVS_NAME_LENGTH ];
+    uint8_t ucType;
+    uint32_t ulLength;
+    uint8_t ucData[ espNVS_MAX_BLOB_SIZE ];
+    nvs_handle xHandle;
+    bool xResult = true;
+
+    if( pxFile == NULL )
+    {
+        return false;
+    }
+
+    while( ( xResult == true ) && ( fread( cNamespace, espNVS_NAME_LENGTH, 1, pxFile ) == 1 ) )
+    {
+        cNamespace[ espNVS_NAME_LENGTH - 1 ] = '\0';
+        xResult = ( fread( cKey, espNVS_NAME_LENGTH, 1, pxFile ) == 1 ) &&
+                  ( fread( &ucType, 1, 1, pxFile ) == 1 ) &&
+                  ( fread( &ulLength, sizeof( ulLength ), 1, pxFile ) == 1 ) &&
+                  ( ulLength <= sizeof( ucData ) ) &&
+                  ( fread( ucData, 1, ulLength, pxFile ) == ulLength );
+
+        if( xResult == true )
+        {
+            cKey[ espNVS_NAME_LENGTH - 1 ] = '\0';
+            xResult = ( nvs_open( cNamespace, NVS_READWRITE, &xHandle ) == ESP_OK ) &&
+                      ( prvNvsSet( xHandle, cKey, ucType, ucData, ulLength ) == ESP_OK );
+        }
+    }
+
+    ( void ) fclose( pxFile );
+
+    return xResult;
+}
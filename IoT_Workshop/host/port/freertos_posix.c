@@ -0,0 +1,1588 @@
+/*
+ * freertos_posix.c: the FreeRTOS API of the demos on POSIX threads.
+ *
+ * Every task is a detached thread with its control block in thread-local
+ * storage; threads the kernel did not create (main, and those of the
+ * stand-ins) get a control block the first time they call into it. Queues,
+ * semaphores, notifications and stream buffers are a mutex and condition
+ * variables each, timed on the monotonic clock. Timer callbacks and pended
+ * functions run on one timer task, started with the first timer.
+ *
+ * The tick is 1 ms, counted from the start of the program. Priorities are
+ * recorded and left to the host scheduler.
+ *
+ * The kernel trace hooks are called as tasks.c and queue.c call them, so
+ * that driver/sched_trace.h records this host too; a task is switched in
+ * when its thread starts and when it returns from a wait.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+#include "stream_buffer.h"
+
+#include "host_port.h"
+
+/* Host threads run mbedTLS and stdio, which need more than the demos ask
+ * for on the device. */
+#define portHOST_MIN_STACK_SIZE    ( 512U * 1024U )
+
+/* The heap the free size is reported against, about what an ESP32 has left
+ * once WiFi is up. */
+#define portHOST_HEAP_SIZE         ( 256U * 1024U )
+
+/* Allocations carry their size in front, aligned for any type. */
+#define portHEAP_HEADER_SIZE       ( 16U )
+
+struct tskTaskControlBlock
+{
+    struct tskTaskControlBlock * pxNext;
+    pthread_t xThread;
+    char pcTaskName[ configMAX_TASK_NAME_LEN ];
+    TaskFunction_t pxTaskCode;
+    void * pvParameters;
+    UBaseType_t uxPriority;
+    UBaseType_t uxTaskNumber;
+    uint32_t ulStackDepth;
+    BaseType_t xCoreID;
+    eTaskState eState;
+
+    pthread_mutex_t xNotifyLock;
+    pthread_cond_t xNotified;
+    uint32_t ulNotifiedValue;
+    BaseType_t xNotifyPending;
+};
+
+typedef struct tskTaskControlBlock TCB_t;
+
+struct QueueDefinition
+{
+    pthread_mutex_t xLock;
+    pthread_cond_t xNotEmpty;
+    pthread_cond_t xNotFull;
+    uint8_t * pucStorage;
+    UBaseType_t uxLength;
+    UBaseType_t uxItemSize;
+    UBaseType_t uxHead;
+    UBaseType_t uxMessagesWaiting;
+};
+
+struct tmrTimerControl
+{
+    struct tmrTimerControl * pxNext;
+    const char * pcTimerName;
+    TickType_t xPeriod;
+    UBaseType_t uxAutoReload;
+    void * pvTimerID;
+    TimerCallbackFunction_t pxCallbackFunction;
+    uint64_t ullExpiry;
+    BaseType_t xActive;
+    BaseType_t xDeleted;
+};
+
+typedef struct PendedCall
+{
+    struct PendedCall * pxNext;
+    PendedFunction_t xFunctionToPend;
+    void * pvParameter1;
+    uint32_t ulParameter2;
+} PendedCall_t;
+
+struct StreamBufferDef_t
+{
+    pthread_mutex_t xLock;
+    pthread_cond_t xChanged;
+    uint8_t * pucBuffer;
+    size_t xLength;    /* One more than the capacity. */
+    size_t xTriggerLevel;
+    size_t xHead;
+    size_t xTail;
+};
+
+/*-----------------------------------------------------------*/
+
+static __thread TCB_t * pxCurrentTCB = NULL;
+
+static pthread_mutex_t xTaskListLock = PTHREAD_MUTEX_INITIALIZER;
+static TCB_t * pxTaskList = NULL;
+static UBaseType_t uxTaskCount = 0;
+static UBaseType_t uxNextTaskNumber = 1;
+
+static pthread_mutex_t xCriticalLock;
+static pthread_condattr_t xMonotonicAttr;
+static struct timespec xStartTime;
+
+static pthread_mutex_t xTimerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xTimerChanged;
+static pthread_once_t xTimerTaskOnce = PTHREAD_ONCE_INIT;
+static TaskHandle_t xTimerTaskHandle = NULL;
+static struct tmrTimerControl * pxTimerList = NULL;
+static PendedCall_t * pxPendedHead = NULL;
+static PendedCall_t * pxPendedTail = NULL;
+
+static size_t xHeapUsed = 0;
+static size_t xHeapMaxUsed = 0;
+
+static pthread_mutex_t xLoggingLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t ulLogLine = 0;
+
+/*-----------------------------------------------------------*/
+
+__attribute__( ( constructor ) ) static void prvPortStart( void )
+{
+    pthread_mutexattr_t xAttr;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xStartTime );
+
+    pthread_mutexattr_init( &xAttr );
+    pthread_mutexattr_settype( &xAttr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &xCriticalLock, &xAttr );
+    pthread_mutexattr_destroy( &xAttr );
+
+    pthread_condattr_init( &xMonotonicAttr );
+    pthread_condattr_setclock( &xMonotonicAttr, CLOCK_MONOTONIC );
+    pthread_cond_init( &xTimerChanged, &xMonotonicAttr );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( uint64_t ) ( ( int64_t ) ( xNow.tv_sec - xStartTime.tv_sec ) * 1000000LL +
+                          ( ( int64_t ) xNow.tv_nsec - xStartTime.tv_nsec ) / 1000LL );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowMs( void )
+{
+    return prvNowUs() / 1000ULL;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The absolute monotonic time of a tick count since the start. */
+static void prvTickToTimespec( uint64_t ullTick,
+                               struct timespec * pxTime )
+{
+    uint64_t ullNs = ( uint64_t ) xStartTime.tv_nsec + ( ullTick % 1000ULL ) * 1000000ULL;
+
+    pxTime->tv_sec = xStartTime.tv_sec + ( time_t ) ( ullTick / 1000ULL ) + ( time_t ) ( ullNs / 1000000000ULL );
+    pxTime->tv_nsec = ( long ) ( ullNs % 1000000000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Wait on a condition until the deadline, or for ever if there is none.
+ *
+ * @return pdFALSE once the deadline has passed.
+ */
+static BaseType_t prvWait( pthread_cond_t * pxCondition,
+                           pthread_mutex_t * pxLock,
+                           const struct timespec * pxDeadline )
+{
+    BaseType_t xReturn = pdTRUE;
+
+    if( pxDeadline == NULL )
+    {
+        pthread_cond_wait( pxCondition, pxLock );
+    }
+    else if( pthread_cond_timedwait( pxCondition, pxLock, pxDeadline ) == ETIMEDOUT )
+    {
+        xReturn = pdFALSE;
+    }
+
+    /* The thread runs again, as a task switched in would. */
+    traceTASK_SWITCHED_IN();
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The deadline of a wait of xTicksToWait from now; NULL for portMAX_DELAY. */
+static const struct timespec * prvDeadline( TickType_t xTicksToWait,
+                                            struct timespec * pxDeadline )
+{
+    if( xTicksToWait == portMAX_DELAY )
+    {
+        return NULL;
+    }
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, pxDeadline );
+    pxDeadline->tv_sec += ( time_t ) ( xTicksToWait / 1000U );
+    pxDeadline->tv_nsec += ( long ) ( xTicksToWait % 1000U ) * 1000000L;
+
+    if( pxDeadline->tv_nsec >= 1000000000L )
+    {
+        pxDeadline->tv_sec++;
+        pxDeadline->tv_nsec -= 1000000000L;
+    }
+
+    return pxDeadline;
+}
+
+/*-----------------------------------------------------------*/
+
+static TCB_t * prvAllocateTCB( const char * pcName,
+                               TaskFunction_t pxTaskCode,
+                               void * pvParameters,
+                               uint32_t ulStackDepth,
+                               UBaseType_t uxPriority,
+                               BaseType_t xCoreID )
+{
+    TCB_t * pxTCB = calloc( 1, sizeof( TCB_t ) );
+
+    if( pxTCB == NULL )
+    {
+        return NULL;
+    }
+
+    strncpy( pxTCB->pcTaskName, ( pcName != NULL ) ? pcName : "", configMAX_TASK_NAME_LEN - 1 );
+    pxTCB->pxTaskCode = pxTaskCode;
+    pxTCB->pvParameters = pvParameters;
+    pxTCB->ulStackDepth = ulStackDepth;
+    pxTCB->uxPriority = uxPriority;
+    pxTCB->xCoreID = xCoreID;
+    pxTCB->eState = eReady;
+    pthread_mutex_init( &( pxTCB->xNotifyLock ), NULL );
+    pthread_cond_init( &( pxTCB->xNotified ), &xMonotonicAttr );
+
+    pthread_mutex_lock( &xTaskListLock );
+    pxTCB->uxTaskNumber = uxNextTaskNumber++;
+    pxTCB->pxNext = pxTaskList;
+    pxTaskList = pxTCB;
+    uxTaskCount++;
+    pthread_mutex_unlock( &xTaskListLock );
+
+    traceTASK_CREATE( pxTCB );
+
+    return pxTCB;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFreeTCB( TCB_t * pxTCB )
+{
+    TCB_t ** ppxLink;
+
+    pthread_mutex_lock( &xTaskListLock );
+
+    for( ppxLink = &pxTaskList; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+    {
+        if( *ppxLink == pxTCB )
+        {
+            *ppxLink = pxTCB->pxNext;
+            uxTaskCount--;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &xTaskListLock );
+
+    pthread_cond_destroy( &( pxTCB->xNotified ) );
+    pthread_mutex_destroy( &( pxTCB->xNotifyLock ) );
+    free( pxTCB );
+}
+
+/*-----------------------------------------------------------*/
+
+/* The running task, which is given a control block if it has none. */
+static TCB_t * prvCurrentTCB( void )
+{
+    if( pxCurrentTCB == NULL )
+    {
+        pxCurrentTCB = prvAllocateTCB( "host", NULL, NULL, 0, tskIDLE_PRIORITY + 1, tskNO_AFFINITY );
+        configASSERT( pxCurrentTCB != NULL );
+        pxCurrentTCB->xThread = pthread_self();
+        pxCurrentTCB->eState = eRunning;
+    }
+
+    return pxCurrentTCB;
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTaskStart( void * pvTCB )
+{
+    TCB_t * pxTCB = pvTCB;
+
+    pxCurrentTCB = pxTCB;
+    pxTCB->eState = eRunning;
+    traceTASK_SWITCHED_IN();
+    pxTCB->pxTaskCode( pxTCB->pvParameters );
+
+    /* A task must not return; treat it as deleting itself. */
+    vTaskDelete( NULL );
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+void HostPort_Init( void )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+
+    strncpy( pxTCB->pcTaskName, "main", configMAX_TASK_NAME_LEN - 1 );
+    traceTASK_CREATE( pxTCB );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreatePinnedToCore( TaskFunction_t pxTaskCode,
+                                    const char * const pcName,
+                                    const uint32_t usStackDepth,
+                                    void * const pvParameters,
+                                    UBaseType_t uxPriority,
+                                    TaskHandle_t * const pxCreatedTask,
+                                    const BaseType_t xCoreID )
+{
+    TCB_t * pxTCB;
+    pthread_attr_t xAttr;
+    size_t xStackSize = usStackDepth;
+    int iError;
+
+    pxTCB = prvAllocateTCB( pcName, pxTaskCode, pvParameters, usStackDepth, uxPriority, xCoreID );
+
+    if( pxTCB == NULL )
+    {
+        return pdFAIL;
+    }
+
+    /* As in FreeRTOS, the handle is stored before the task can run. */
+    if( pxCreatedTask != NULL )
+    {
+        *pxCreatedTask = pxTCB;
+    }
+
+    if( xStackSize < portHOST_MIN_STACK_SIZE )
+    {
+        xStackSize = portHOST_MIN_STACK_SIZE;
+    }
+
+    pthread_attr_init( &xAttr );
+    pthread_attr_setdetachstate( &xAttr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &xAttr, xStackSize );
+    iError = pthread_create( &( pxTCB->xThread ), &xAttr, prvTaskStart, pxTCB );
+    pthread_attr_destroy( &xAttr );
+
+    if( iError != 0 )
+    {
+        if( pxCreatedTask != NULL )
+        {
+            *pxCreatedTask = NULL;
+        }
+
+        prvFreeTCB( pxTCB );
+
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    return xTaskCreatePinnedToCore( pxTaskCode, pcName, usStackDepth, pvParameters,
+                                    uxPriority, pxCreatedTask, tskNO_AFFINITY );
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskCreateStaticPinnedToCore( TaskFunction_t pxTaskCode,
+                                            const char * const pcName,
+                                            const uint32_t ulStackDepth,
+                                            void * const pvParameters,
+                                            UBaseType_t uxPriority,
+                                            StackType_t * const puxStackBuffer,
+                                            StaticTask_t * const pxTaskBuffer,
+                                            const BaseType_t xCoreID )
+{
+    TaskHandle_t xHandle = NULL;
+
+    ( void ) puxStackBuffer;
+    ( void ) pxTaskBuffer;
+
+    /* The handle only reaches the caller once creation returns. */
+    ( void ) xTaskCreatePinnedToCore( pxTaskCode, pcName, ulStackDepth, pvParameters,
+                                      uxPriority, &xHandle, xCoreID );
+
+    return xHandle;
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskCreateStatic( TaskFunction_t pxTaskCode,
+                                const char * const pcName,
+                                const uint32_t ulStackDepth,
+                                void * const pvParameters,
+                                UBaseType_t uxPriority,
+                                StackType_t * const puxStackBuffer,
+                                StaticTask_t * const pxTaskBuffer )
+{
+    return xTaskCreateStaticPinnedToCore( pxTaskCode, pcName, ulStackDepth, pvParameters,
+                                          uxPriority, puxStackBuffer, pxTaskBuffer, tskNO_AFFINITY );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskDelete( TaskHandle_t xTask )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+
+    configASSERT( ( xTask == NULL ) || ( xTask == pxTCB ) );
+
+    pxCurrentTCB = NULL;
+    prvFreeTCB( pxTCB );
+    pthread_exit( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    TickType_t xWakeTime = xTaskGetTickCount();
+
+    vTaskDelayUntil( &xWakeTime, xTicksToDelay );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskDelayUntil( TickType_t * const pxPreviousWakeTime,
+                      const TickType_t xTimeIncrement )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+    uint64_t ullNow = prvNowMs();
+    uint64_t ullWake;
+    struct timespec xWake;
+
+    /* Ticks wrap after 49 days; rebuild the full count of the wake time. */
+    ullWake = ( ullNow & ~( uint64_t ) UINT32_MAX ) | *pxPreviousWakeTime;
+
+    if( ullWake > ullNow + UINT32_MAX / 2 )
+    {
+        ullWake -= ( uint64_t ) UINT32_MAX + 1;
+    }
+
+    ullWake += xTimeIncrement;
+    *pxPreviousWakeTime = ( TickType_t ) ullWake;
+
+    if( ullWake > ullNow )
+    {
+        prvTickToTimespec( ullWake, &xWake );
+        pxTCB->eState = eBlocked;
+
+        while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xWake, NULL ) == EINTR )
+        {
+        }
+
+        pxTCB->eState = eRunning;
+        traceTASK_SWITCHED_IN();
+    }
+    else
+    {
+        sched_yield();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+TickType_t xTaskGetTickCount( void )
+{
+    return ( TickType_t ) prvNowMs();
+}
+
+/*-----------------------------------------------------------*/
+
+TickType_t xTaskGetTickCountFromISR( void )
+{
+    return xTaskGetTickCount();
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return prvCurrentTCB();
+}
+
+/*-----------------------------------------------------------*/
+
+char * pcTaskGetTaskName( TaskHandle_t xTaskToQuery )
+{
+    TCB_t * pxTCB = ( xTaskToQuery != NULL ) ? xTaskToQuery : prvCurrentTCB();
+
+    return pxTCB->pcTaskName;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTaskPriorityGet( TaskHandle_t xTask )
+{
+    TCB_t * pxTCB = ( xTask != NULL ) ? xTask : prvCurrentTCB();
+
+    return pxTCB->uxPriority;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTaskGetStackHighWaterMark( TaskHandle_t xTask )
+{
+    TCB_t * pxTCB = ( xTask != NULL ) ? xTask : prvCurrentTCB();
+
+    /* Host stacks are not painted; nothing of the stack counts as used. */
+    return pxTCB->ulStackDepth;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTaskGetNumberOfTasks( void )
+{
+    UBaseType_t uxCount;
+
+    pthread_mutex_lock( &xTaskListLock );
+    uxCount = uxTaskCount;
+    pthread_mutex_unlock( &xTaskListLock );
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTaskGetSystemState( TaskStatus_t * const pxTaskStatusArray,
+                                  const UBaseType_t uxArraySize,
+                                  uint32_t * const pulTotalRunTime )
+{
+    TCB_t * pxTCB;
+    UBaseType_t uxTask = 0;
+    clockid_t xClock;
+    struct timespec xCpuTime;
+
+    pthread_mutex_lock( &xTaskListLock );
+
+    if( uxTaskCount <= uxArraySize )
+    {
+        for( pxTCB = pxTaskList; pxTCB != NULL; pxTCB = pxTCB->pxNext, uxTask++ )
+        {
+            TaskStatus_t * pxStatus = &( pxTaskStatusArray[ uxTask ] );
+
+            pxStatus->xHandle = pxTCB;
+            pxStatus->pcTaskName = pxTCB->pcTaskName;
+            pxStatus->xTaskNumber = pxTCB->uxTaskNumber;
+            pxStatus->eCurrentState = pxTCB->eState;
+            pxStatus->uxCurrentPriority = pxTCB->uxPriority;
+            pxStatus->uxBasePriority = pxTCB->uxPriority;
+            pxStatus->ulRunTimeCounter = 0;
+            pxStatus->pxStackBase = NULL;
+            pxStatus->usStackHighWaterMark = ( uint16_t ) ( ( pxTCB->ulStackDepth > UINT16_MAX ) ? UINT16_MAX : pxTCB->ulStackDepth );
+            pxStatus->xCoreID = pxTCB->xCoreID;
+
+            if( ( pthread_getcpuclockid( pxTCB->xThread, &xClock ) == 0 ) &&
+                ( clock_gettime( xClock, &xCpuTime ) == 0 ) )
+            {
+                pxStatus->ulRunTimeCounter = ( uint32_t ) ( ( uint64_t ) xCpuTime.tv_sec * 1000000ULL +
+                                                            ( uint64_t ) xCpuTime.tv_nsec / 1000ULL );
+            }
+        }
+    }
+
+    pthread_mutex_unlock( &xTaskListLock );
+
+    if( pulTotalRunTime != NULL )
+    {
+        *pulTotalRunTime = ( uint32_t ) prvNowUs();
+    }
+
+    return uxTask;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskNotify( TaskHandle_t xTaskToNotify,
+                        uint32_t ulValue,
+                        eNotifyAction eAction )
+{
+    TCB_t * pxTCB = xTaskToNotify;
+    BaseType_t xReturn = pdPASS;
+
+    pthread_mutex_lock( &( pxTCB->xNotifyLock ) );
+
+    switch( eAction )
+    {
+        case eSetBits:
+            pxTCB->ulNotifiedValue |= ulValue;
+            break;
+
+        case eIncrement:
+            pxTCB->ulNotifiedValue++;
+            break;
+
+        case eSetValueWithOverwrite:
+            pxTCB->ulNotifiedValue = ulValue;
+            break;
+
+        case eSetValueWithoutOverwrite:
+
+            if( pxTCB->xNotifyPending == pdTRUE )
+            {
+                xReturn = pdFAIL;
+            }
+            else
+            {
+                pxTCB->ulNotifiedValue = ulValue;
+            }
+
+            break;
+
+        case eNoAction:
+        default:
+            break;
+    }
+
+    pxTCB->xNotifyPending = pdTRUE;
+    pthread_cond_broadcast( &( pxTCB->xNotified ) );
+    pthread_mutex_unlock( &( pxTCB->xNotifyLock ) );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskNotifyFromISR( TaskHandle_t xTaskToNotify,
+                               uint32_t ulValue,
+                               eNotifyAction eAction,
+                               BaseType_t * pxHigherPriorityTaskWoken )
+{
+    if( pxHigherPriorityTaskWoken != NULL )
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+
+    return xTaskNotify( xTaskToNotify, ulValue, eAction );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTaskNotifyGiveFromISR( TaskHandle_t xTaskToNotify,
+                             BaseType_t * pxHigherPriorityTaskWoken )
+{
+    ( void ) xTaskNotifyFromISR( xTaskToNotify, 0, eIncrement, pxHigherPriorityTaskWoken );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskNotifyWait( uint32_t ulBitsToClearOnEntry,
+                            uint32_t ulBitsToClearOnExit,
+                            uint32_t * pulNotificationValue,
+                            TickType_t xTicksToWait )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    BaseType_t xReturn;
+
+    pthread_mutex_lock( &( pxTCB->xNotifyLock ) );
+
+    if( pxTCB->xNotifyPending == pdFALSE )
+    {
+        pxTCB->ulNotifiedValue &= ~ulBitsToClearOnEntry;
+        pxTCB->eState = eBlocked;
+
+        while( ( pxTCB->xNotifyPending == pdFALSE ) && ( xTicksToWait != 0 ) )
+        {
+            if( prvWait( &( pxTCB->xNotified ), &( pxTCB->xNotifyLock ), pxDeadline ) == pdFALSE )
+            {
+                break;
+            }
+        }
+
+        pxTCB->eState = eRunning;
+    }
+
+    if( pulNotificationValue != NULL )
+    {
+        *pulNotificationValue = pxTCB->ulNotifiedValue;
+    }
+
+    xReturn = pxTCB->xNotifyPending;
+
+    if( xReturn == pdTRUE )
+    {
+        pxTCB->ulNotifiedValue &= ~ulBitsToClearOnExit;
+    }
+
+    pxTCB->xNotifyPending = pdFALSE;
+    pthread_mutex_unlock( &( pxTCB->xNotifyLock ) );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    uint32_t ulReturn;
+
+    pthread_mutex_lock( &( pxTCB->xNotifyLock ) );
+    pxTCB->eState = eBlocked;
+
+    while( ( pxTCB->ulNotifiedValue == 0 ) && ( xTicksToWait != 0 ) )
+    {
+        if( prvWait( &( pxTCB->xNotified ), &( pxTCB->xNotifyLock ), pxDeadline ) == pdFALSE )
+        {
+            break;
+        }
+    }
+
+    pxTCB->eState = eRunning;
+    ulReturn = pxTCB->ulNotifiedValue;
+
+    if( ulReturn != 0 )
+    {
+        pxTCB->ulNotifiedValue = ( xClearCountOnExit != pdFALSE ) ? 0 : ulReturn - 1;
+    }
+
+    pxTCB->xNotifyPending = pdFALSE;
+    pthread_mutex_unlock( &( pxTCB->xNotifyLock ) );
+
+    return ulReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    pthread_mutex_lock( &xCriticalLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    pthread_mutex_unlock( &xCriticalLock );
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+    sched_yield();
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortGetCoreID( void )
+{
+    TCB_t * pxTCB = prvCurrentTCB();
+
+    return ( pxTCB->xCoreID == tskNO_AFFINITY ) ? 0 : pxTCB->xCoreID;
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvPortMalloc( size_t xSize )
+{
+    uint8_t * pucBlock = malloc( xSize + portHEAP_HEADER_SIZE );
+    size_t xUsed;
+
+    if( pucBlock == NULL )
+    {
+        return NULL;
+    }
+
+    memcpy( pucBlock, &xSize, sizeof( xSize ) );
+    xUsed = __atomic_add_fetch( &xHeapUsed, xSize, __ATOMIC_RELAXED );
+
+    /* The highest use seen; a lost race only makes it lag by one block. */
+    if( xUsed > __atomic_load_n( &xHeapMaxUsed, __ATOMIC_RELAXED ) )
+    {
+        __atomic_store_n( &xHeapMaxUsed, xUsed, __ATOMIC_RELAXED );
+    }
+
+    return pucBlock + portHEAP_HEADER_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortFree( void * pv )
+{
+    uint8_t * pucBlock;
+    size_t xSize;
+
+    if( pv == NULL )
+    {
+        return;
+    }
+
+    pucBlock = ( uint8_t * ) pv - portHEAP_HEADER_SIZE;
+    memcpy( &xSize, pucBlock, sizeof( xSize ) );
+    ( void ) __atomic_sub_fetch( &xHeapUsed, xSize, __ATOMIC_RELAXED );
+    free( pucBlock );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xPortGetFreeHeapSize( void )
+{
+    size_t xUsed = __atomic_load_n( &xHeapUsed, __ATOMIC_RELAXED );
+
+    return ( xUsed < portHOST_HEAP_SIZE ) ? portHOST_HEAP_SIZE - xUsed : 0;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xPortGetMinimumEverFreeHeapSize( void )
+{
+    size_t xUsed = __atomic_load_n( &xHeapMaxUsed, __ATOMIC_RELAXED );
+
+    return ( xUsed < portHOST_HEAP_SIZE ) ? portHOST_HEAP_SIZE - xUsed : 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static QueueHandle_t prvQueueCreate( UBaseType_t uxQueueLength,
+                                     UBaseType_t uxItemSize,
+                                     UBaseType_t uxInitialCount )
+{
+    struct QueueDefinition * pxQueue = calloc( 1, sizeof( struct QueueDefinition ) );
+
+    if( pxQueue == NULL )
+    {
+        return NULL;
+    }
+
+    if( uxItemSize > 0 )
+    {
+        pxQueue->pucStorage = malloc( ( size_t ) uxQueueLength * uxItemSize );
+
+        if( pxQueue->pucStorage == NULL )
+        {
+            free( pxQueue );
+
+            return NULL;
+        }
+    }
+
+    pxQueue->uxLength = uxQueueLength;
+    pxQueue->uxItemSize = uxItemSize;
+    pxQueue->uxMessagesWaiting = uxInitialCount;
+    pthread_mutex_init( &( pxQueue->xLock ), NULL );
+    pthread_cond_init( &( pxQueue->xNotEmpty ), &xMonotonicAttr );
+    pthread_cond_init( &( pxQueue->xNotFull ), &xMonotonicAttr );
+
+    return pxQueue;
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueCreate( const UBaseType_t uxQueueLength,
+                            const UBaseType_t uxItemSize )
+{
+    return prvQueueCreate( uxQueueLength, uxItemSize, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueCreateStatic( const UBaseType_t uxQueueLength,
+                                  const UBaseType_t uxItemSize,
+                                  uint8_t * pucQueueStorage,
+                                  StaticQueue_t * pxStaticQueue )
+{
+    ( void ) pucQueueStorage;
+    ( void ) pxStaticQueue;
+
+    return prvQueueCreate( uxQueueLength, uxItemSize, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+void vQueueDelete( QueueHandle_t xQueue )
+{
+    pthread_cond_destroy( &( xQueue->xNotFull ) );
+    pthread_cond_destroy( &( xQueue->xNotEmpty ) );
+    pthread_mutex_destroy( &( xQueue->xLock ) );
+    free( xQueue->pucStorage );
+    free( xQueue );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueSend( QueueHandle_t xQueue,
+                       const void * const pvItemToQueue,
+                       TickType_t xTicksToWait )
+{
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    UBaseType_t uxTail;
+    BaseType_t xReturn = errQUEUE_FULL;
+
+    pthread_mutex_lock( &( xQueue->xLock ) );
+
+    while( ( xQueue->uxMessagesWaiting == xQueue->uxLength ) && ( xTicksToWait != 0 ) )
+    {
+        if( prvWait( &( xQueue->xNotFull ), &( xQueue->xLock ), pxDeadline ) == pdFALSE )
+        {
+            break;
+        }
+    }
+
+    if( xQueue->uxMessagesWaiting < xQueue->uxLength )
+    {
+        if( xQueue->uxItemSize > 0 )
+        {
+            uxTail = ( xQueue->uxHead + xQueue->uxMessagesWaiting ) % xQueue->uxLength;
+            memcpy( xQueue->pucStorage + ( size_t ) uxTail * xQueue->uxItemSize,
+                    pvItemToQueue, xQueue->uxItemSize );
+        }
+
+        traceQUEUE_SEND( xQueue );
+        xQueue->uxMessagesWaiting++;
+        pthread_cond_signal( &( xQueue->xNotEmpty ) );
+        xReturn = pdPASS;
+    }
+    else
+    {
+        traceQUEUE_SEND_FAILED( xQueue );
+    }
+
+    pthread_mutex_unlock( &( xQueue->xLock ) );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueSendFromISR( QueueHandle_t xQueue,
+                              const void * const pvItemToQueue,
+                              BaseType_t * const pxHigherPriorityTaskWoken )
+{
+    if( pxHigherPriorityTaskWoken != NULL )
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+
+    return xQueueSend( xQueue, pvItemToQueue, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * const pvBuffer,
+                          TickType_t xTicksToWait )
+{
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    BaseType_t xReturn = errQUEUE_EMPTY;
+
+    pthread_mutex_lock( &( xQueue->xLock ) );
+
+    if( ( xQueue->uxMessagesWaiting == 0 ) && ( xTicksToWait != 0 ) )
+    {
+        traceBLOCKING_ON_QUEUE_RECEIVE( xQueue );
+    }
+
+    while( ( xQueue->uxMessagesWaiting == 0 ) && ( xTicksToWait != 0 ) )
+    {
+        if( prvWait( &( xQueue->xNotEmpty ), &( xQueue->xLock ), pxDeadline ) == pdFALSE )
+        {
+            break;
+        }
+    }
+
+    if( xQueue->uxMessagesWaiting > 0 )
+    {
+        if( xQueue->uxItemSize > 0 )
+        {
+            memcpy( pvBuffer,
+                    xQueue->pucStorage + ( size_t ) xQueue->uxHead * xQueue->uxItemSize,
+                    xQueue->uxItemSize );
+            xQueue->uxHead = ( xQueue->uxHead + 1 ) % xQueue->uxLength;
+        }
+
+        traceQUEUE_RECEIVE( xQueue );
+        xQueue->uxMessagesWaiting--;
+        pthread_cond_signal( &( xQueue->xNotFull ) );
+        xReturn = pdPASS;
+    }
+
+    pthread_mutex_unlock( &( xQueue->xLock ) );
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxQueueMessagesWaiting( const QueueHandle_t xQueue )
+{
+    UBaseType_t uxCount;
+
+    pthread_mutex_lock( &( xQueue->xLock ) );
+    uxCount = xQueue->uxMessagesWaiting;
+    pthread_mutex_unlock( &( xQueue->xLock ) );
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxQueueSpacesAvailable( const QueueHandle_t xQueue )
+{
+    return xQueue->uxLength - uxQueueMessagesWaiting( xQueue );
+}
+
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void )
+{
+    return prvQueueCreate( 1, 0, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount )
+{
+    return prvQueueCreate( uxMaxCount, 0, uxInitialCount );
+}
+
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateMutex( void )
+{
+    return prvQueueCreate( 1, 0, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic( StaticSemaphore_t * pxMutexBuffer )
+{
+    ( void ) pxMutexBuffer;
+
+    return prvQueueCreate( 1, 0, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTimerTask( void * pvParameters );
+
+static void prvStartTimerTask( void )
+{
+    BaseType_t xCreated = xTaskCreate( prvTimerTask, "Tmr Svc", 2048, NULL,
+                                       configMAX_PRIORITIES - 1, &xTimerTaskHandle );
+
+    configASSERT( xCreated == pdPASS );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTimerTask( void * pvParameters )
+{
+    struct tmrTimerControl ** ppxLink;
+    struct tmrTimerControl * pxTimer;
+    struct tmrTimerControl * pxNextTimer;
+    PendedCall_t * pxCall;
+    struct timespec xWake;
+    uint64_t ullNow;
+
+    ( void ) pvParameters;
+
+    pthread_mutex_lock( &xTimerLock );
+
+    for( ; ; )
+    {
+        if( pxPendedHead != NULL )
+        {
+            pxCall = pxPendedHead;
+            pxPendedHead = pxCall->pxNext;
+
+            if( pxPendedHead == NULL )
+            {
+                pxPendedTail = NULL;
+            }
+
+            pthread_mutex_unlock( &xTimerLock );
+            pxCall->xFunctionToPend( pxCall->pvParameter1, pxCall->ulParameter2 );
+            free( pxCall );
+            pthread_mutex_lock( &xTimerLock );
+            continue;
+        }
+
+        /* Release deleted timers, then find the next to expire. */
+        pxNextTimer = NULL;
+        ppxLink = &pxTimerList;
+
+        while( *ppxLink != NULL )
+        {
+            pxTimer = *ppxLink;
+
+            if( pxTimer->xDeleted == pdTRUE )
+            {
+                *ppxLink = pxTimer->pxNext;
+                free( pxTimer );
+                continue;
+            }
+
+            if( ( pxTimer->xActive == pdTRUE ) &&
+                ( ( pxNextTimer == NULL ) || ( pxTimer->ullExpiry < pxNextTimer->ullExpiry ) ) )
+            {
+                pxNextTimer = pxTimer;
+            }
+
+            ppxLink = &( pxTimer->pxNext );
+        }
+
+        if( pxNextTimer == NULL )
+        {
+            ( void ) prvWait( &xTimerChanged, &xTimerLock, NULL );
+            continue;
+        }
+
+        ullNow = prvNowMs();
+
+        if( pxNextTimer->ullExpiry > ullNow )
+        {
+            prvTickToTimespec( pxNextTimer->ullExpiry, &xWake );
+            ( void ) prvWait( &xTimerChanged, &xTimerLock, &xWake );
+            continue;
+        }
+
+        if( pxNextTimer->uxAutoReload == pdFALSE )
+        {
+            pxNextTimer->xActive = pdFALSE;
+        }
+        else
+        {
+            pxNextTimer->ullExpiry += pxNextTimer->xPeriod;
+
+            /* A late timer does not make up for the periods it missed. */
+            if( pxNextTimer->ullExpiry <= ullNow )
+            {
+                pxNextTimer->ullExpiry = ullNow + pxNextTimer->xPeriod;
+            }
+        }
+
+        pthread_mutex_unlock( &xTimerLock );
+        pxNextTimer->pxCallbackFunction( pxNextTimer );
+        pthread_mutex_lock( &xTimerLock );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreate( const char * const pcTimerName,
+                            const TickType_t xTimerPeriodInTicks,
+                            const UBaseType_t uxAutoReload,
+                            void * const pvTimerID,
+                            TimerCallbackFunction_t pxCallbackFunction )
+{
+    struct tmrTimerControl * pxTimer;
+
+    if( xTimerPeriodInTicks == 0 )
+    {
+        return NULL;
+    }
+
+    pxTimer = calloc( 1, sizeof( struct tmrTimerControl ) );
+
+    if( pxTimer == NULL )
+    {
+        return NULL;
+    }
+
+    pthread_once( &xTimerTaskOnce, prvStartTimerTask );
+
+    pxTimer->pcTimerName = pcTimerName;
+    pxTimer->xPeriod = xTimerPeriodInTicks;
+    pxTimer->uxAutoReload = uxAutoReload;
+    pxTimer->pvTimerID = pvTimerID;
+    pxTimer->pxCallbackFunction = pxCallbackFunction;
+
+    pthread_mutex_lock( &xTimerLock );
+    pxTimer->pxNext = pxTimerList;
+    pxTimerList = pxTimer;
+    pthread_mutex_unlock( &xTimerLock );
+
+    return pxTimer;
+}
+
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreateStatic( const char * const pcTimerName,
+                                  const TickType_t xTimerPeriodInTicks,
+                                  const UBaseType_t uxAutoReload,
+                                  void * const pvTimerID,
+                                  TimerCallbackFunction_t pxCallbackFunction,
+                                  StaticTimer_t * pxTimerBuffer )
+{
+    ( void ) pxTimerBuffer;
+
+    return xTimerCreate( pcTimerName, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerStart( TimerHandle_t xTimer,
+                        TickType_t xTicksToWait )
+{
+    ( void ) xTicksToWait;
+
+    pthread_mutex_lock( &xTimerLock );
+    xTimer->ullExpiry = prvNowMs() + xTimer->xPeriod;
+    xTimer->xActive = pdTRUE;
+    pthread_cond_signal( &xTimerChanged );
+    pthread_mutex_unlock( &xTimerLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerReset( TimerHandle_t xTimer,
+                        TickType_t xTicksToWait )
+{
+    return xTimerStart( xTimer, xTicksToWait );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerStop( TimerHandle_t xTimer,
+                       TickType_t xTicksToWait )
+{
+    ( void ) xTicksToWait;
+
+    pthread_mutex_lock( &xTimerLock );
+    xTimer->xActive = pdFALSE;
+    pthread_cond_signal( &xTimerChanged );
+    pthread_mutex_unlock( &xTimerLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerChangePeriod( TimerHandle_t xTimer,
+                               TickType_t xNewPeriod,
+                               TickType_t xTicksToWait )
+{
+    if( xNewPeriod == 0 )
+    {
+        return pdFAIL;
+    }
+
+    pthread_mutex_lock( &xTimerLock );
+    xTimer->xPeriod = xNewPeriod;
+    pthread_mutex_unlock( &xTimerLock );
+
+    /* As in FreeRTOS, a dormant timer is started too. */
+    return xTimerStart( xTimer, xTicksToWait );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerDelete( TimerHandle_t xTimer,
+                         TickType_t xTicksToWait )
+{
+    ( void ) xTicksToWait;
+
+    /* Freed by the timer task, which may be running its callback. */
+    pthread_mutex_lock( &xTimerLock );
+    xTimer->xActive = pdFALSE;
+    xTimer->xDeleted = pdTRUE;
+    pthread_cond_signal( &xTimerChanged );
+    pthread_mutex_unlock( &xTimerLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerIsTimerActive( TimerHandle_t xTimer )
+{
+    BaseType_t xActive;
+
+    pthread_mutex_lock( &xTimerLock );
+    xActive = xTimer->xActive;
+    pthread_mutex_unlock( &xTimerLock );
+
+    return xActive;
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvTimerGetTimerID( const TimerHandle_t xTimer )
+{
+    return xTimer->pvTimerID;
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTimerGetTimerDaemonTaskHandle( void )
+{
+    pthread_once( &xTimerTaskOnce, prvStartTimerTask );
+
+    return xTimerTaskHandle;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerPendFunctionCall( PendedFunction_t xFunctionToPend,
+                                   void * pvParameter1,
+                                   uint32_t ulParameter2,
+                                   TickType_t xTicksToWait )
+{
+    PendedCall_t * pxCall = malloc( sizeof( PendedCall_t ) );
+
+    ( void ) xTicksToWait;
+
+    if( pxCall == NULL )
+    {
+        return pdFAIL;
+    }
+
+    pthread_once( &xTimerTaskOnce, prvStartTimerTask );
+
+    pxCall->pxNext = NULL;
+    pxCall->xFunctionToPend = xFunctionToPend;
+    pxCall->pvParameter1 = pvParameter1;
+    pxCall->ulParameter2 = ulParameter2;
+
+    pthread_mutex_lock( &xTimerLock );
+
+    if( pxPendedTail == NULL )
+    {
+        pxPendedHead = pxCall;
+    }
+    else
+    {
+        pxPendedTail->pxNext = pxCall;
+    }
+
+    pxPendedTail = pxCall;
+    pthread_cond_signal( &xTimerChanged );
+    pthread_mutex_unlock( &xTimerLock );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+StreamBufferHandle_t xStreamBufferCreate( size_t xBufferSizeBytes,
+                                          size_t xTriggerLevelBytes )
+{
+    struct StreamBufferDef_t * pxStream = calloc( 1, sizeof( struct StreamBufferDef_t ) );
+
+    if( pxStream == NULL )
+    {
+        return NULL;
+    }
+
+    pxStream->pucBuffer = malloc( xBufferSizeBytes + 1 );
+
+    if( pxStream->pucBuffer == NULL )
+    {
+        free( pxStream );
+
+        return NULL;
+    }
+
+    pxStream->xLength = xBufferSizeBytes + 1;
+    pxStream->xTriggerLevel = ( xTriggerLevelBytes == 0 ) ? 1 : xTriggerLevelBytes;
+    pthread_mutex_init( &( pxStream->xLock ), NULL );
+    pthread_cond_init( &( pxStream->xChanged ), &xMonotonicAttr );
+
+    return pxStream;
+}
+
+/*-----------------------------------------------------------*/
+
+void vStreamBufferDelete( StreamBufferHandle_t xStreamBuffer )
+{
+    pthread_cond_destroy( &( xStreamBuffer->xChanged ) );
+    pthread_mutex_destroy( &( xStreamBuffer->xLock ) );
+    free( xStreamBuffer->pucBuffer );
+    free( xStreamBuffer );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvBytesInBuffer( const struct StreamBufferDef_t * pxStream )
+{
+    return ( pxStream->xHead + pxStream->xLength - pxStream->xTail ) % pxStream->xLength;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSend( StreamBufferHandle_t xStreamBuffer,
+                          const void * pvTxData,
+                          size_t xDataLengthBytes,
+                          TickType_t xTicksToWait )
+{
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    const uint8_t * pucData = pvTxData;
+    size_t xSpace, xSent = 0;
+
+    pthread_mutex_lock( &( xStreamBuffer->xLock ) );
+
+    /* As in FreeRTOS: wait for room for all of it, then send what fits. */
+    while( ( xStreamBuffer->xLength - 1 - prvBytesInBuffer( xStreamBuffer ) < xDataLengthBytes ) &&
+           ( xTicksToWait != 0 ) )
+    {
+        if( prvWait( &( xStreamBuffer->xChanged ), &( xStreamBuffer->xLock ), pxDeadline ) == pdFALSE )
+        {
+            break;
+        }
+    }
+
+    xSpace = xStreamBuffer->xLength - 1 - prvBytesInBuffer( xStreamBuffer );
+
+    while( ( xSent < xDataLengthBytes ) && ( xSent < xSpace ) )
+    {
+        xStreamBuffer->pucBuffer[ xStreamBuffer->xHead ] = pucData[ xSent++ ];
+        xStreamBuffer->xHead = ( xStreamBuffer->xHead + 1 ) % xStreamBuffer->xLength;
+    }
+
+    if( xSent > 0 )
+    {
+        pthread_cond_broadcast( &( xStreamBuffer->xChanged ) );
+    }
+
+    pthread_mutex_unlock( &( xStreamBuffer->xLock ) );
+
+    return xSent;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferReceive( StreamBufferHandle_t xStreamBuffer,
+                             void * pvRxData,
+                             size_t xBufferLengthBytes,
+                             TickType_t xTicksToWait )
+{
+    struct timespec xDeadline;
+    const struct timespec * pxDeadline = prvDeadline( xTicksToWait, &xDeadline );
+    uint8_t * pucData = pvRxData;
+    size_t xAvailable, xReceived = 0;
+
+    pthread_mutex_lock( &( xStreamBuffer->xLock ) );
+
+    while( ( prvBytesInBuffer( xStreamBuffer ) < xStreamBuffer->xTriggerLevel ) && ( xTicksToWait != 0 ) )
+    {
+        if( prvWait( &( xStreamBuffer->xChanged ), &( xStreamBuffer->xLock ), pxDeadline ) == pdFALSE )
+        {
+            break;
+        }
+    }
+
+    xAvailable = prvBytesInBuffer( xStreamBuffer );
+
+    while( ( xReceived < xBufferLengthBytes ) && ( xReceived < xAvailable ) )
+    {
+        pucData[ xReceived++ ] = xStreamBuffer->pucBuffer[ xStreamBuffer->xTail ];
+        xStreamBuffer->xTail = ( xStreamBuffer->xTail + 1 ) % xStreamBuffer->xLength;
+    }
+
+    if( xReceived > 0 )
+    {
+        pthread_cond_broadcast( &( xStreamBuffer->xChanged ) );
+    }
+
+    pthread_mutex_unlock( &( xStreamBuffer->xLock ) );
+
+    return xReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferBytesAvailable( StreamBufferHandle_t xStreamBuffer )
+{
+    size_t xBytes;
+
+    pthread_mutex_lock( &( xStreamBuffer->xLock ) );
+    xBytes = prvBytesInBuffer( xStreamBuffer );
+    pthread_mutex_unlock( &( xStreamBuffer->xLock ) );
+
+    return xBytes;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSpacesAvailable( StreamBufferHandle_t xStreamBuffer )
+{
+    return xStreamBuffer->xLength - 1 - xStreamBufferBytesAvailable( xStreamBuffer );
+}
+
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    char cLine[ 512 ];
+    va_list xArgs;
+    int iLength;
+    size_t x, xOut = 0;
+
+    va_start( xArgs, pcFormat );
+    iLength = vsnprintf( cLine, sizeof( cLine ), pcFormat, xArgs );
+    va_end( xArgs );
+
+    if( iLength < 0 )
+    {
+        return;
+    }
+
+    if( ( size_t ) iLength >= sizeof( cLine ) )
+    {
+        iLength = sizeof( cLine ) - 1;
+    }
+
+    /* Lines end in "\r\n" on the device console; keep the "\n". */
+    for( x = 0; x < ( size_t ) iLength; x++ )
+    {
+        if( cLine[ x ] != '\r' )
+        {
+            cLine[ xOut++ ] = cLine[ x ];
+        }
+    }
+
+    pthread_mutex_lock( &xLoggingLock );
+    printf( "%u %u [%s] %.*s", ( unsigned ) ulLogLine++, ( unsigned ) xTaskGetTickCount(),
+            pcTaskGetTaskName( NULL ), ( int ) xOut, cLine );
+
+    if( ( xOut == 0 ) || ( cLine[ xOut - 1 ] != '\n' ) )
+    {
+        putchar( '\n' );
+    }
+
+    fflush( stdout );
+    pthread_mutex_unlock( &xLoggingLock );
+}
@@ -0,0 +1,372 @@
+/*
+ * host_listener.c: the TCP and TLS server side of the stand-ins.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+
+#include "host_listener.h"
+#include "host_port.h"
+
+#include "mbedtls/error.h"
+
+/*-----------------------------------------------------------*/
+
+static int prvSend( void * pvContext,
+                    const unsigned char * pucData,
+                    size_t xLength )
+{
+    HostLink_t * pxLink = pvContext;
+    ssize_t xSent;
+
+    do
+    {
+        xSent = send( pxLink->iSocket, pucData, xLength, MSG_NOSIGNAL );
+    } while( ( xSent < 0 ) && ( errno == EINTR ) );
+
+    return ( xSent < 0 ) ? MBEDTLS_ERR_NET_SEND_FAILED : ( int ) xSent;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvRecv( void * pvContext,
+                    unsigned char * pucBuffer,
+                    size_t xLength )
+{
+    HostLink_t * pxLink = pvContext;
+    ssize_t xReceived;
+
+    do
+    {
+        xReceived = recv( pxLink->iSocket, pucBuffer, xLength, 0 );
+    } while( ( xReceived < 0 ) && ( errno == EINTR ) );
+
+    if( xReceived < 0 )
+    {
+        return MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+
+    /* A shutdown reads as a reset, so that a reader of a dropped link
+     * stops whatever state the TLS record layer is in. */
+    return ( xReceived == 0 ) ? MBEDTLS_ERR_NET_CONN_RESET : ( int ) xReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The session cache is shared by the connection threads of a listener. */
+static int prvCacheGet( void * pvContext,
+                        mbedtls_ssl_session * pxSession )
+{
+    HostListener_t * pxListener = pvContext;
+    int lResult;
+
+    pthread_mutex_lock( &( pxListener->xLock ) );
+    lResult = mbedtls_ssl_cache_get( &( pxListener->xCache ), pxSession );
+
+    if( lResult == 0 )
+    {
+        pxListener->ulResumed++;
+    }
+
+    pthread_mutex_unlock( &( pxListener->xLock ) );
+
+    return lResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCacheSet( void * pvContext,
+                        const mbedtls_ssl_session * pxSession )
+{
+    HostListener_t * pxListener = pvContext;
+    int lResult;
+
+    pthread_mutex_lock( &( pxListener->xLock ) );
+    lResult = mbedtls_ssl_cache_set( &( pxListener->xCache ), pxSession );
+    pthread_mutex_unlock( &( pxListener->xLock ) );
+
+    return lResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSetUpTls( HostListener_t * pxListener )
+{
+    int lResult;
+
+    mbedtls_entropy_init( &( pxListener->xEntropy ) );
+    mbedtls_ctr_drbg_init( &( pxListener->xCtrDrbg ) );
+    mbedtls_x509_crt_init( &( pxListener->xCertificate ) );
+    mbedtls_pk_init( &( pxListener->xKey ) );
+    mbedtls_ssl_config_init( &( pxListener->xConfig ) );
+    mbedtls_ssl_cache_init( &( pxListener->xCache ) );
+
+    lResult = mbedtls_ctr_drbg_seed( &( pxListener->xCtrDrbg ), mbedtls_entropy_func,
+                                     &( pxListener->xEntropy ), NULL, 0 );
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509_crt_parse( &( pxListener->xCertificate ),
+                                          ( const unsigned char * ) pcHostServerCertificate,
+                                          ulHostServerCertificateSize );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_pk_parse_key( &( pxListener->xKey ),
+                                        ( const unsigned char * ) pcHostServerKey,
+                                        ulHostServerKeySize, NULL, 0 );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_config_defaults( &( pxListener->xConfig ), MBEDTLS_SSL_IS_SERVER,
+                                               MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT );
+    }
+
+    if( lResult == 0 )
+    {
+        mbedtls_ssl_conf_rng( &( pxListener->xConfig ), mbedtls_ctr_drbg_random, &( pxListener->xCtrDrbg ) );
+        mbedtls_ssl_conf_session_cache( &( pxListener->xConfig ), pxListener, prvCacheGet, prvCacheSet );
+        lResult = mbedtls_ssl_conf_own_cert( &( pxListener->xConfig ), &( pxListener->xCertificate ),
+                                             &( pxListener->xKey ) );
+    }
+
+    if( lResult != 0 )
+    {
+        char cError[ 96 ];
+
+        mbedtls_strerror( lResult, cError, sizeof( cError ) );
+        configPRINTF( ( "ERROR: listener TLS setup failed: -0x%04x %s\r\n", ( unsigned ) -lResult, cError ) );
+    }
+
+    return lResult == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostListener_Start( HostListener_t * pxListener,
+                         uint16_t usPort,
+                         bool xTls,
+                         uint32_t ulHandshakeDelayMs )
+{
+    struct sockaddr_in xAddress = { 0 };
+    int iReuse = 1;
+
+    memset( pxListener, 0x00, sizeof( HostListener_t ) );
+    pthread_mutex_init( &( pxListener->xLock ), NULL );
+    pxListener->xTls = xTls;
+    pxListener->ulHandshakeDelayMs = ulHandshakeDelayMs;
+
+    if( ( xTls == true ) && ( prvSetUpTls( pxListener ) == false ) )
+    {
+        return false;
+    }
+
+    xAddress.sin_family = AF_INET;
+    xAddress.sin_port = htons( usPort );
+    xAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    pxListener->iSocket = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+    if( pxListener->iSocket < 0 )
+    {
+        return false;
+    }
+
+    ( void ) setsockopt( pxListener->iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof( iReuse ) );
+
+    if( ( bind( pxListener->iSocket, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) ) != 0 ) ||
+        ( listen( pxListener->iSocket, 16 ) != 0 ) )
+    {
+        configPRINTF( ( "ERROR: cannot listen on port %u: %s\r\n", ( unsigned ) usPort, strerror( errno ) ) );
+        ( void ) close( pxListener->iSocket );
+        pxListener->iSocket = -1;
+
+        return false;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+int HostListener_Accept( HostListener_t * pxListener )
+{
+    int iSocket;
+    int iNoDelay = 1;
+
+    do
+    {
+        iSocket = accept( pxListener->iSocket, NULL, NULL );
+    } while( ( iSocket < 0 ) && ( ( errno == EINTR ) || ( errno == ECONNABORTED ) ) );
+
+    if( iSocket >= 0 )
+    {
+        ( void ) setsockopt( iSocket, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof( iNoDelay ) );
+    }
+
+    return iSocket;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostLink_Open( HostLink_t * pxLink,
+                    HostListener_t * pxListener,
+                    int iSocket )
+{
+    struct timespec xDelay;
+    int lResult;
+
+    memset( pxLink, 0x00, sizeof( HostLink_t ) );
+    pxLink->iSocket = iSocket;
+    pxLink->pxListener = pxListener;
+    pthread_mutex_init( &( pxLink->xWriteLock ), NULL );
+
+    if( pxListener->xTls == false )
+    {
+        return true;
+    }
+
+    /* A further endpoint answers the ClientHello later. */
+    if( pxListener->ulHandshakeDelayMs > 0 )
+    {
+        xDelay.tv_sec = ( time_t ) ( pxListener->ulHandshakeDelayMs / 1000U );
+        xDelay.tv_nsec = ( long ) ( pxListener->ulHandshakeDelayMs % 1000U ) * 1000000L;
+        ( void ) nanosleep( &xDelay, NULL );
+    }
+
+    mbedtls_ssl_init( &( pxLink->xSsl ) );
+    lResult = mbedtls_ssl_setup( &( pxLink->xSsl ), &( pxListener->xConfig ) );
+
+    if( lResult == 0 )
+    {
+        mbedtls_ssl_set_bio( &( pxLink->xSsl ), pxLink, prvSend, prvRecv, NULL );
+        lResult = mbedtls_ssl_handshake( &( pxLink->xSsl ) );
+    }
+
+    if( lResult != 0 )
+    {
+        HostLink_Close( pxLink );
+
+        return false;
+    }
+
+    pthread_mutex_lock( &( pxListener->xLock ) );
+    pxListener->ulHandshakes++;
+    pthread_mutex_unlock( &( pxListener->xLock ) );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+ssize_t HostLink_Read( HostLink_t * pxLink,
+                       uint8_t * pucBuffer,
+                       size_t xLength )
+{
+    int lResult;
+
+    if( pxLink->pxListener->xTls == false )
+    {
+        return prvRecv( pxLink, pucBuffer, xLength );
+    }
+
+    do
+    {
+        lResult = mbedtls_ssl_read( &( pxLink->xSsl ), pucBuffer, xLength );
+    } while( ( lResult == MBEDTLS_ERR_SSL_WANT_READ ) || ( lResult == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+
+    return lResult;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostLink_ReadAll( HostLink_t * pxLink,
+                       uint8_t * pucBuffer,
+                       size_t xLength )
+{
+    size_t xRead = 0;
+    ssize_t xResult;
+
+    while( xRead < xLength )
+    {
+        xResult = HostLink_Read( pxLink, pucBuffer + xRead, xLength - xRead );
+
+        if( xResult <= 0 )
+        {
+            return false;
+        }
+
+        xRead += ( size_t ) xResult;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool HostLink_Write( HostLink_t * pxLink,
+                     const uint8_t * pucData,
+                     size_t xLength )
+{
+    size_t xWritten = 0;
+    int lResult = 0;
+
+    pthread_mutex_lock( &( pxLink->xWriteLock ) );
+
+    while( ( xWritten < xLength ) && ( lResult >= 0 ) )
+    {
+        if( pxLink->pxListener->xTls == false )
+        {
+            lResult = prvSend( pxLink, pucData + xWritten, xLength - xWritten );
+        }
+        else
+        {
+            lResult = mbedtls_ssl_write( &( pxLink->xSsl ), pucData + xWritten, xLength - xWritten );
+
+            if( lResult == MBEDTLS_ERR_SSL_WANT_WRITE )
+            {
+                lResult = 0;
+            }
+        }
+
+        if( lResult > 0 )
+        {
+            xWritten += ( size_t ) lResult;
+        }
+    }
+
+    pthread_mutex_unlock( &( pxLink->xWriteLock ) );
+
+    return xWritten == xLength;
+}
+
+/*-----------------------------------------------------------*/
+
+void HostLink_Shutdown( HostLink_t * pxLink )
+{
+    ( void ) shutdown( pxLink->iSocket, SHUT_RDWR );
+}
+
+/*-----------------------------------------------------------*/
+
+void HostLink_Close( HostLink_t * pxLink )
+{
+    if( pxLink->pxListener->xTls == true )
+    {
+        mbedtls_ssl_free( &( pxLink->xSsl ) );
+    }
+
+    ( void ) close( pxLink->iSocket );
+    pthread_mutex_destroy( &( pxLink->xWriteLock ) );
+}
@@ -0,0 +1,96 @@
+/*
+ * host_listener.h: the TCP and TLS server side shared by the stand-ins of
+ * the host build (port/host_listener.c). Not part of the device API.
+ *
+ * A listener accepts on 127.0.0.1 and, with TLS, presents the server
+ * certificate of host_port.h. Sessions are cached, as by AWS IoT Core and
+ * the Greengrass core, so that a client may resume one; the lookups that
+ * found a session are counted.
+ */
+
+#ifndef HOST_LISTENER_H_
+#define HOST_LISTENER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_cache.h"
+#include "mbedtls/x509_crt.h"
+
+typedef struct HostListener
+{
+    int iSocket;
+    bool xTls;
+    uint32_t ulHandshakeDelayMs;
+
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+    mbedtls_x509_crt xCertificate;
+    mbedtls_pk_context xKey;
+    mbedtls_ssl_config xConfig;
+    mbedtls_ssl_cache_context xCache;
+
+    pthread_mutex_t xLock;      /* Guards the cache and the counters. */
+    uint32_t ulHandshakes;
+    uint32_t ulResumed;
+} HostListener_t;
+
+typedef struct HostLink
+{
+    int iSocket;
+    HostListener_t * pxListener;
+    mbedtls_ssl_context xSsl;
+    pthread_mutex_t xWriteLock;
+} HostLink_t;
+
+/*
+ * Listen on 127.0.0.1:usPort.
+ *
+ * @return false if the port could not be listened on.
+ */
+bool HostListener_Start( HostListener_t * pxListener,
+                         uint16_t usPort,
+                         bool xTls,
+                         uint32_t ulHandshakeDelayMs );
+
+/* Wait for the next connection; < 0 once the listener fails. */
+int HostListener_Accept( HostListener_t * pxListener );
+
+/*
+ * Take over an accepted socket, and complete the TLS handshake if the
+ * listener has TLS.
+ *
+ * @return false if the handshake failed; the socket is closed.
+ */
+bool HostLink_Open( HostLink_t * pxLink,
+                    HostListener_t * pxListener,
+                    int iSocket );
+
+/* Read what has arrived, blocking for the first byte. <= 0 once closed. */
+ssize_t HostLink_Read( HostLink_t * pxLink,
+                       uint8_t * pucBuffer,
+                       size_t xLength );
+
+/* Read exactly xLength bytes. */
+bool HostLink_ReadAll( HostLink_t * pxLink,
+                       uint8_t * pucBuffer,
+                       size_t xLength );
+
+/* Write all of it; safe from any thread. */
+bool HostLink_Write( HostLink_t * pxLink,
+                     const uint8_t * pucData,
+                     size_t xLength );
+
+/* Wake a reader of the link with end of file; the link stays open. */
+void HostLink_Shutdown( HostLink_t * pxLink );
+
+void HostLink_Close( HostLink_t * pxLink );
+
+#endif /* ifndef HOST_LISTENER_H_ */
@@ -0,0 +1,279 @@
+/*
+ * iot_tls.c: the TLS layer of the secure sockets on the host, with mbedTLS
+ * as in Amazon FreeRTOS. The server is verified against the certificate
+ * given by the caller, or else against the CA of the host stand-ins, and
+ * its name against pcDestination when there is one. No client certificate
+ * is sent: the stand-ins do not ask for one.
+ *
+ * The session agreed with an endpoint is kept by driver/tls_session_cache.h
+ * and offered on the next connection to it, which then skips the server's
+ * certificate and the key exchange.
+ *
+ * The caller's receive function blocks for at most the socket's receive
+ * timeout. A timeout fails the handshake; after it, TLS_Recv() returns
+ * what has arrived so far.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "iot_tls.h"
+#include "host_port.h"
+
+#include "driver/tls_session_cache.h"
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/error.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+typedef struct TLSContext
+{
+    const char * pcDestination;
+    const char * pcEndpoint;
+    uint16_t usPort;
+    const char * pcServerCertificate;
+    uint32_t ulServerCertificateLength;
+    void * pvCallerContext;
+    NetworkRecv_t pxNetworkRecv;
+    NetworkSend_t pxNetworkSend;
+
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+    mbedtls_x509_crt xRootCa;
+    mbedtls_ssl_config xConfig;
+    mbedtls_ssl_context xSsl;
+    TlsSessionHandshake_t xSession;
+} TLSContext_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintError( const char * pcWhat,
+                           int lError )
+{
+    char cError[ 96 ];
+
+    mbedtls_strerror( lError, cError, sizeof( cError ) );
+    configPRINTF( ( "ERROR: TLS %s failed: -0x%04x %s\r\n", pcWhat, ( unsigned ) -lError, cError ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvNetworkSend( void * pvContext,
+                           const unsigned char * pucData,
+                           size_t xDataLength )
+{
+    TLSContext_t * pxContext = pvContext;
+    BaseType_t xSent = pxContext->pxNetworkSend( pxContext->pvCallerContext, pucData, xDataLength );
+
+    /* Zero is the send timeout, which fails the connection too. */
+    return ( xSent <= 0 ) ? MBEDTLS_ERR_NET_SEND_FAILED : ( int ) xSent;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvNetworkRecv( void * pvContext,
+                           unsigned char * pucReceiveBuffer,
+                           size_t xReceiveLength )
+{
+    TLSContext_t * pxContext = pvContext;
+    BaseType_t xReceived = pxContext->pxNetworkRecv( pxContext->pvCallerContext, pucReceiveBuffer, xReceiveLength );
+
+    if( xReceived < 0 )
+    {
+        return MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+
+    /* Zero is the receive timeout. */
+    return ( xReceived == 0 ) ? MBEDTLS_ERR_SSL_WANT_READ : ( int ) xReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Init( void ** ppvContext,
+                     TLSParams_t * pxParams )
+{
+    TLSContext_t * pxContext = pvPortMalloc( sizeof( TLSContext_t ) );
+
+    if( pxContext == NULL )
+    {
+        return pdFREERTOS_ERRNO_ENOMEM;
+    }
+
+    memset( pxContext, 0x00, sizeof( TLSContext_t ) );
+    pxContext->pcDestination = pxParams->pcDestination;
+    pxContext->pcEndpoint = pxParams->pcEndpoint;
+    pxContext->usPort = pxParams->usPort;
+    pxContext->pcServerCertificate = pxParams->pcServerCertificate;
+    pxContext->ulServerCertificateLength = pxParams->ulServerCertificateLength;
+    pxContext->pvCallerContext = pxParams->pvCallerContext;
+    pxContext->pxNetworkRecv = pxParams->pxNetworkRecv;
+    pxContext->pxNetworkSend = pxParams->pxNetworkSend;
+
+    mbedtls_entropy_init( &( pxContext->xEntropy ) );
+    mbedtls_ctr_drbg_init( &( pxContext->xCtrDrbg ) );
+    mbedtls_x509_crt_init( &( pxContext->xRootCa ) );
+    mbedtls_ssl_config_init( &( pxContext->xConfig ) );
+    mbedtls_ssl_init( &( pxContext->xSsl ) );
+
+    *ppvContext = pxContext;
+
+    return pdFREERTOS_ERRNO_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Connect( void * pvContext )
+{
+    TLSContext_t * pxContext = pvContext;
+    const char * pcRootCa = pcHostCaCertificate;
+    size_t xRootCaSize = ulHostCaCertificateSize;
+    int lResult;
+
+    if( pxContext->pcServerCertificate != NULL )
+    {
+        pcRootCa = pxContext->pcServerCertificate;
+        xRootCaSize = pxContext->ulServerCertificateLength;
+    }
+
+    lResult = mbedtls_ctr_drbg_seed( &( pxContext->xCtrDrbg ), mbedtls_entropy_func,
+                                     &( pxContext->xEntropy ), NULL, 0 );
+
+    if( lResult != 0 )
+    {
+        prvPrintError( "seed", lResult );
+
+        return lResult;
+    }
+
+    lResult = mbedtls_x509_crt_parse( &( pxContext->xRootCa ),
+                                      ( const unsigned char * ) pcRootCa, xRootCaSize );
+
+    if( lResult != 0 )
+    {
+        prvPrintError( "root CA", lResult );
+
+        return lResult;
+    }
+
+    lResult = mbedtls_ssl_config_defaults( &( pxContext->xConfig ), MBEDTLS_SSL_IS_CLIENT,
+                                           MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT );
+
+    if( lResult == 0 )
+    {
+        mbedtls_ssl_conf_authmode( &( pxContext->xConfig ), MBEDTLS_SSL_VERIFY_REQUIRED );
+        mbedtls_ssl_conf_ca_chain( &( pxContext->xConfig ), &( pxContext->xRootCa ), NULL );
+        mbedtls_ssl_conf_rng( &( pxContext->xConfig ), mbedtls_ctr_drbg_random, &( pxContext->xCtrDrbg ) );
+        lResult = mbedtls_ssl_setup( &( pxContext->xSsl ), &( pxContext->xConfig ) );
+    }
+
+    if( ( lResult == 0 ) && ( pxContext->pcDestination != NULL ) )
+    {
+        lResult = mbedtls_ssl_set_hostname( &( pxContext->xSsl ), pxContext->pcDestination );
+    }
+
+    if( lResult != 0 )
+    {
+        prvPrintError( "setup", lResult );
+
+        return lResult;
+    }
+
+    mbedtls_ssl_set_bio( &( pxContext->xSsl ), pxContext, prvNetworkSend, prvNetworkRecv, NULL );
+
+    TlsSessionCache_Begin( &( pxContext->xSession ), &( pxContext->xConfig ), &( pxContext->xSsl ),
+                           pxContext->pcEndpoint, pxContext->usPort, pcRootCa, xRootCaSize );
+
+    lResult = mbedtls_ssl_handshake( &( pxContext->xSsl ) );
+
+    ( void ) TlsSessionCache_End( &( pxContext->xSession ), &( pxContext->xSsl ), lResult );
+
+    if( lResult != 0 )
+    {
+        prvPrintError( "handshake", lResult );
+    }
+
+    return lResult;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Recv( void * pvContext,
+                     unsigned char * pucReadBuffer,
+                     size_t xReadLength )
+{
+    TLSContext_t * pxContext = pvContext;
+    size_t xRead = 0;
+    int lResult;
+
+    /* Wait for the first bytes, then take only what is already decrypted
+     * or buffered, so that a short message is not held up. */
+    do
+    {
+        lResult = mbedtls_ssl_read( &( pxContext->xSsl ), pucReadBuffer + xRead, xReadLength - xRead );
+
+        if( lResult > 0 )
+        {
+            xRead += ( size_t ) lResult;
+        }
+        else if( ( lResult == MBEDTLS_ERR_SSL_WANT_READ ) || ( lResult == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+        {
+            break;
+        }
+        else
+        {
+            return ( xRead > 0 ) ? ( BaseType_t ) xRead :
+                   ( lResult == 0 ) ? MBEDTLS_ERR_SSL_CONN_EOF : lResult;
+        }
+    } while( ( xRead < xReadLength ) && ( mbedtls_ssl_get_bytes_avail( &( pxContext->xSsl ) ) > 0 ) );
+
+    return ( BaseType_t ) xRead;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_Send( void * pvContext,
+                     const unsigned char * pucMsg,
+                     size_t xMsgLength )
+{
+    TLSContext_t * pxContext = pvContext;
+    size_t xWritten = 0;
+    int lResult;
+
+    while( xWritten < xMsgLength )
+    {
+        lResult = mbedtls_ssl_write( &( pxContext->xSsl ), pucMsg + xWritten, xMsgLength - xWritten );
+
+        if( lResult > 0 )
+        {
+            xWritten += ( size_t ) lResult;
+        }
+        else if( lResult != MBEDTLS_ERR_SSL_WANT_WRITE )
+        {
+            return lResult;
+        }
+    }
+
+    return ( BaseType_t ) xWritten;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_Cleanup( void * pvContext )
+{
+    TLSContext_t * pxContext = pvContext;
+
+    if( pxContext == NULL )
+    {
+        return;
+    }
+
+    mbedtls_ssl_free( &( pxContext->xSsl ) );
+    mbedtls_ssl_config_free( &( pxContext->xConfig ) );
+    mbedtls_x509_crt_free( &( pxContext->xRootCa ) );
+    mbedtls_ctr_drbg_free( &( pxContext->xCtrDrbg ) );
+    mbedtls_entropy_free( &( pxContext->xEntropy ) );
+    vPortFree( pxContext );
+}
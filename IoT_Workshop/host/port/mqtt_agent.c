@@ -0,0 +1,339 @@
+/*
+ * mqtt_agent.c: the MQTT agent of Amazon FreeRTOS V201906 on the host.
+ *
+ * As on the device, the agent is a thin layer over the MQTT v4 client: a
+ * connect creates a network connection of IotNetworkAfr, and the agent's
+ * callback hears of a dropped connection through the client's disconnect
+ * callback. The callbacks run on the receive task of the connection, which
+ * stands in for the agent task.
+ */
+
+#include <string.h>
+
+#include "iot_config.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "aws_mqtt_agent.h"
+#include "iot_mqtt.h"
+#include "platform/iot_network_freertos.h"
+
+/* The MQTT keep-alive of the agent, as mqttconfigKEEP_ALIVE_INTERVAL_SECONDS. */
+#define mqttagentKEEP_ALIVE_SECONDS    ( 1200 )
+
+typedef struct MQTTAgentContext
+{
+    BaseType_t xInUse;
+    IotMqttConnection_t xMQTTConnection;
+    MQTTAgentCallback_t pxCallback;
+    void * pvUserData;
+    IotNetworkServerInfo_t xServerInfo;
+    IotNetworkCredentials_t xCredentials;
+    char cClientId[ 128 ];
+} MQTTAgentContext_t;
+
+/* A subscription's callback, kept until the agent is deleted. */
+typedef struct MQTTAgentSubscription
+{
+    struct MQTTAgentSubscription * pxNext;
+    MQTTPublishCallback_t pxPublishCallback;
+    void * pvPublishCallbackContext;
+} MQTTAgentSubscription_t;
+
+static MQTTAgentContext_t xAgents[ mqttconfigMAX_BROKERS ];
+static MQTTAgentSubscription_t * pxSubscriptions[ mqttconfigMAX_BROKERS ];
+
+static portMUX_TYPE xAgentsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+static void prvDisconnectCallback( void * pvContext,
+                                   IotMqttCallbackParam_t * pxParam )
+{
+    MQTTAgentContext_t * pxAgent = pvContext;
+    MQTTAgentCallbackParams_t xParams;
+
+    ( void ) pxParam;
+
+    memset( &xParams, 0x00, sizeof( xParams ) );
+    xParams.xMQTTEvent = eMQTTAgentDisconnect;
+
+    if( pxAgent->pxCallback != NULL )
+    {
+        ( void ) pxAgent->pxCallback( pxAgent->pvUserData, &xParams );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPublishCallback( void * pvContext,
+                                IotMqttCallbackParam_t * pxParam )
+{
+    MQTTAgentSubscription_t * pxSubscription = pvContext;
+    MQTTPublishData_t xPublishData;
+
+    xPublishData.pxBuffer = NULL;
+    xPublishData.xQos = ( MQTTQoS_t ) pxParam->u.message.info.qos;
+    xPublishData.pucTopic = ( const uint8_t * ) pxParam->u.message.info.pTopicName;
+    xPublishData.usTopicLength = pxParam->u.message.info.topicNameLength;
+    xPublishData.pvData = pxParam->u.message.info.pPayload;
+    xPublishData.ulDataLength = ( uint32_t ) pxParam->u.message.info.payloadLength;
+
+    /* The buffer is the client's and is released when the callback returns,
+     * so there is nothing to take ownership of. */
+    ( void ) pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, &xPublishData );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Create( MQTTAgentHandle_t * const pxMQTTHandle )
+{
+    MQTTAgentReturnCode_t xReturnCode = eMQTTAgentFailure;
+    BaseType_t x;
+
+    portENTER_CRITICAL( &xAgentsMux );
+
+    for( x = 0; x < mqttconfigMAX_BROKERS; x++ )
+    {
+        if( xAgents[ x ].xInUse == pdFALSE )
+        {
+            memset( &( xAgents[ x ] ), 0x00, sizeof( MQTTAgentContext_t ) );
+            xAgents[ x ].xInUse = pdTRUE;
+            *pxMQTTHandle = &( xAgents[ x ] );
+            xReturnCode = eMQTTAgentSuccess;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL( &xAgentsMux );
+
+    return xReturnCode;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Delete( MQTTAgentHandle_t xMQTTHandle )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+    MQTTAgentSubscription_t * pxSubscription;
+    BaseType_t xIndex = pxAgent - xAgents;
+
+    if( pxAgent->xMQTTConnection != NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    while( pxSubscriptions[ xIndex ] != NULL )
+    {
+        pxSubscription = pxSubscriptions[ xIndex ];
+        pxSubscriptions[ xIndex ] = pxSubscription->pxNext;
+        vPortFree( pxSubscription );
+    }
+
+    portENTER_CRITICAL( &xAgentsMux );
+    pxAgent->xInUse = pdFALSE;
+    portEXIT_CRITICAL( &xAgentsMux );
+
+    return eMQTTAgentSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Connect( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentConnectParams_t * const pxConnectParams,
+                                          TickType_t xTimeoutTicks )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+    IotMqttNetworkInfo_t xNetworkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+    IotMqttConnectInfo_t xConnectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+    IotMqttError_t xStatus;
+
+    if( ( pxAgent->xMQTTConnection != NULL ) ||
+        ( pxConnectParams->usClientIdLength >= sizeof( pxAgent->cClientId ) ) )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    pxAgent->pxCallback = pxConnectParams->pxCallback;
+    pxAgent->pvUserData = pxConnectParams->pvUserData;
+    memcpy( pxAgent->cClientId, pxConnectParams->pucClientId, pxConnectParams->usClientIdLength );
+    pxAgent->cClientId[ pxConnectParams->usClientIdLength ] = '\0';
+
+    pxAgent->xServerInfo.pHostName = pxConnectParams->pcURL;
+    pxAgent->xServerInfo.port = pxConnectParams->usPort;
+
+    /* An IP address is not a name to send as SNI. */
+    memset( &( pxAgent->xCredentials ), 0x00, sizeof( pxAgent->xCredentials ) );
+    pxAgent->xCredentials.disableSni = ( ( pxConnectParams->xFlags & mqttagentURL_IS_IP_ADDRESS ) != 0 );
+    pxAgent->xCredentials.pRootCa = pxConnectParams->pcCertificate;
+    pxAgent->xCredentials.rootCaSize = pxConnectParams->ulCertificateSize;
+
+    xNetworkInfo.createNetworkConnection = true;
+    xNetworkInfo.u.setup.pNetworkServerInfo = &( pxAgent->xServerInfo );
+    xNetworkInfo.u.setup.pNetworkCredentialInfo =
+        ( ( pxConnectParams->xFlags & mqttagentREQUIRE_TLS ) != 0 ) ? &( pxAgent->xCredentials ) : NULL;
+    xNetworkInfo.pNetworkInterface = IOT_NETWORK_INTERFACE_AFR;
+    xNetworkInfo.disconnectCallback.function = prvDisconnectCallback;
+    xNetworkInfo.disconnectCallback.pCallbackContext = pxAgent;
+
+    xConnectInfo.awsIotMqttMode = true;
+    xConnectInfo.cleanSession = true;
+    xConnectInfo.keepAliveSeconds = mqttagentKEEP_ALIVE_SECONDS;
+    xConnectInfo.pClientIdentifier = pxAgent->cClientId;
+    xConnectInfo.clientIdentifierLength = pxConnectParams->usClientIdLength;
+
+    xStatus = IotMqtt_Connect( &xNetworkInfo,
+                               &xConnectInfo,
+                               xTimeoutTicks * portTICK_PERIOD_MS,
+                               &( pxAgent->xMQTTConnection ) );
+
+    if( xStatus != IOT_MQTT_SUCCESS )
+    {
+        pxAgent->xMQTTConnection = NULL;
+
+        return ( xStatus == IOT_MQTT_TIMEOUT ) ? eMQTTAgentTimeout : eMQTTAgentFailure;
+    }
+
+    return eMQTTAgentSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Disconnect( MQTTAgentHandle_t xMQTTHandle,
+                                             TickType_t xTimeoutTicks )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+
+    ( void ) xTimeoutTicks;
+
+    if( pxAgent->xMQTTConnection == NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    IotMqtt_Disconnect( pxAgent->xMQTTConnection, 0 );
+    pxAgent->xMQTTConnection = NULL;
+
+    return eMQTTAgentSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Subscribe( MQTTAgentHandle_t xMQTTHandle,
+                                            const MQTTAgentSubscribeParams_t * const pxSubscribeParams,
+                                            TickType_t xTimeoutTicks )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+    IotMqttSubscription_t xSubscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    MQTTAgentSubscription_t * pxSubscription;
+    IotMqttError_t xStatus;
+    BaseType_t xIndex = pxAgent - xAgents;
+
+    if( pxAgent->xMQTTConnection == NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    pxSubscription = pvPortMalloc( sizeof( MQTTAgentSubscription_t ) );
+
+    if( pxSubscription == NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    pxSubscription->pxPublishCallback = pxSubscribeParams->pxPublishCallback;
+    pxSubscription->pvPublishCallbackContext = pxSubscribeParams->pvPublishCallbackContext;
+
+    xSubscription.qos = ( IotMqttQos_t ) pxSubscribeParams->xQoS;
+    xSubscription.pTopicFilter = ( const char * ) pxSubscribeParams->pucTopic;
+    xSubscription.topicFilterLength = pxSubscribeParams->usTopicLength;
+    xSubscription.callback.function = prvPublishCallback;
+    xSubscription.callback.pCallbackContext = pxSubscription;
+
+    xStatus = IotMqtt_TimedSubscribe( pxAgent->xMQTTConnection,
+                                      &xSubscription,
+                                      1,
+                                      0,
+                                      xTimeoutTicks * portTICK_PERIOD_MS );
+
+    if( xStatus != IOT_MQTT_SUCCESS )
+    {
+        vPortFree( pxSubscription );
+
+        return ( xStatus == IOT_MQTT_TIMEOUT ) ? eMQTTAgentTimeout : eMQTTAgentFailure;
+    }
+
+    /* The client may call it until the connection goes, so the callback
+     * context lives as long as the agent. */
+    pxSubscription->pxNext = pxSubscriptions[ xIndex ];
+    pxSubscriptions[ xIndex ] = pxSubscription;
+
+    return eMQTTAgentSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Unsubscribe( MQTTAgentHandle_t xMQTTHandle,
+                                              const MQTTAgentUnsubscribeParams_t * const pxUnsubscribeParams,
+                                              TickType_t xTimeoutTicks )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+    IotMqttSubscription_t xSubscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    IotMqttError_t xStatus;
+
+    if( pxAgent->xMQTTConnection == NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    xSubscription.pTopicFilter = ( const char * ) pxUnsubscribeParams->pucTopic;
+    xSubscription.topicFilterLength = pxUnsubscribeParams->usTopicLength;
+
+    xStatus = IotMqtt_TimedUnsubscribe( pxAgent->xMQTTConnection,
+                                        &xSubscription,
+                                        1,
+                                        0,
+                                        xTimeoutTicks * portTICK_PERIOD_MS );
+
+    return ( xStatus == IOT_MQTT_SUCCESS ) ? eMQTTAgentSuccess :
+           ( xStatus == IOT_MQTT_TIMEOUT ) ? eMQTTAgentTimeout : eMQTTAgentFailure;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentPublishParams_t * const pxPublishParams,
+                                          TickType_t xTimeoutTicks )
+{
+    MQTTAgentContext_t * pxAgent = xMQTTHandle;
+    IotMqttPublishInfo_t xPublishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttError_t xStatus;
+
+    if( pxAgent->xMQTTConnection == NULL )
+    {
+        return eMQTTAgentFailure;
+    }
+
+    xPublishInfo.qos = ( IotMqttQos_t ) pxPublishParams->xQoS;
+    xPublishInfo.pTopicName = ( const char * ) pxPublishParams->pucTopic;
+    xPublishInfo.topicNameLength = pxPublishParams->usTopicLength;
+    xPublishInfo.pPayload = pxPublishParams->pvData;
+    xPublishInfo.payloadLength = pxPublishParams->ulDataLength;
+
+    /* As the agent, a QoS 1 publish returns once it is acknowledged. */
+    if( xPublishInfo.qos == IOT_MQTT_QOS_0 )
+    {
+        xStatus = IotMqtt_Publish( pxAgent->xMQTTConnection, &xPublishInfo, 0, NULL, NULL );
+    }
+    else
+    {
+        xStatus = IotMqtt_TimedPublish( pxAgent->xMQTTConnection,
+                                        &xPublishInfo,
+                                        0,
+                                        xTimeoutTicks * portTICK_PERIOD_MS );
+    }
+
+    return ( xStatus == IOT_MQTT_SUCCESS ) ? eMQTTAgentSuccess :
+           ( xStatus == IOT_MQTT_TIMEOUT ) ? eMQTTAgentTimeout : eMQTTAgentFailure;
+}
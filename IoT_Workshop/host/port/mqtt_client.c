@@ -0,0 +1,1505 @@
+/*
+ * mqtt_client.c: the MQTT v4 client of the IoT SDK on the host, as far as
+ * the demos use it. MQTT 3.1.1 at QoS 0 and 1, over any network interface.
+ *
+ * Packets are read on the network's receive callback, one per call, and
+ * incoming PUBLISHes and completed operations are reported there too.
+ * Packet identifiers are odd, as in the library. A service timer sends the
+ * keep-alive PINGREQs and retransmits unacknowledged QoS 1 PUBLISHes with
+ * the DUP flag, doubling the interval each time, up to the retry limit.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_config.h"
+
+#include "iot_mqtt.h"
+#include "private/iot_mqtt_internal.h"
+#include "iot_demo_logging.h"
+
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+#include "timers.h"
+
+/* MQTT control packet types, shifted into the fixed header. */
+#define _MQTT_CONNECT        ( 0x10 )
+#define _MQTT_CONNACK        ( 0x20 )
+#define _MQTT_PUBLISH        ( 0x30 )
+#define _MQTT_PUBACK         ( 0x40 )
+#define _MQTT_SUBSCRIBE      ( 0x82 )
+#define _MQTT_SUBACK         ( 0x90 )
+#define _MQTT_UNSUBSCRIBE    ( 0xA2 )
+#define _MQTT_UNSUBACK       ( 0xB0 )
+#define _MQTT_PINGREQ        ( 0xC0 )
+#define _MQTT_PINGRESP       ( 0xD0 )
+#define _MQTT_DISCONNECT     ( 0xE0 )
+
+#define _PUBLISH_DUP_FLAG    ( 0x08 )
+
+/* How often the service timer looks at keep-alive and retransmissions. */
+#define _SERVICE_PERIOD_MS   ( 100 )
+
+/* How long a PINGRESP may take before the connection is given up. */
+#define _PINGRESP_TIMEOUT_MS ( 5000 )
+
+typedef struct _mqttSubscription
+{
+    struct _mqttSubscription * pNext;
+    IotMqttCallbackInfo_t callback;
+    uint16_t topicFilterLength;
+    char pTopicFilter[];
+} _mqttSubscription_t;
+
+typedef struct _mqttOperation
+{
+    struct _mqttOperation * pNext;
+    struct _mqttConnection * pMqttConnection;
+    IotMqttOperationType_t type;
+    uint16_t packetIdentifier;
+    bool waitable;
+    IotMqttError_t status;
+    IotSemaphore_t notify;
+    IotMqttCallbackInfo_t callback;
+
+    /* A QoS 1 PUBLISH, kept for retransmission. */
+    uint8_t * pPacket;
+    size_t packetSize;
+    void ( * freePacket )( uint8_t * pPacket );
+    uint32_t retryLimit;
+    uint32_t retryCount;
+    uint32_t retryPeriodMs;
+    uint64_t nextRetryMs;
+} _mqttOperation_t;
+
+typedef struct _mqttConnection
+{
+    const IotNetworkInterface_t * pNetworkInterface;
+    void * pNetworkConnection;
+    bool ownNetworkConnection;
+    const IotMqttSerializer_t * pSerializer;
+    IotMqttCallbackInfo_t disconnectCallback;
+
+    IotMutex_t referencesMutex;     /* Guards the lists and the flags. */
+    IotMutex_t sendMutex;           /* One packet on the network at a time. */
+    IotMutex_t subscriptionMutex;   /* Held while subscription callbacks run. */
+    _mqttOperation_t * pOperations;
+    _mqttSubscription_t * pSubscriptions;
+    bool disconnected;
+
+    TimerHandle_t serviceTimer;
+    uint32_t keepAliveMs;
+    uint64_t lastSendMs;
+    uint64_t pingSentMs;
+    bool pingPending;
+    bool keepAliveFailed;
+} _mqttConnection_t;
+
+static uint16_t _nextPacketIdentifier = 1;
+
+/*-----------------------------------------------------------*/
+
+static uint16_t _newPacketIdentifier( void )
+{
+    uint16_t packetIdentifier = __atomic_fetch_add( &_nextPacketIdentifier, 2, __ATOMIC_RELAXED );
+
+    /* Odd identifiers wrap from 65535 to 1, never to 0. */
+    return packetIdentifier;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _remainingLengthSize( size_t remainingLength )
+{
+    return ( remainingLength < 128U ) ? 1U :
+           ( remainingLength < 16384U ) ? 2U :
+           ( remainingLength < 2097152U ) ? 3U : 4U;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * _encodeRemainingLength( uint8_t * pBuffer,
+                                         size_t remainingLength )
+{
+    uint8_t encodedByte = 0;
+
+    do
+    {
+        encodedByte = ( uint8_t ) ( remainingLength % 128U );
+        remainingLength /= 128U;
+
+        if( remainingLength > 0 )
+        {
+            encodedByte |= 0x80;
+        }
+
+        *pBuffer++ = encodedByte;
+    } while( remainingLength > 0 );
+
+    return pBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * _encodeString( uint8_t * pBuffer,
+                                const char * pString,
+                                uint16_t stringLength )
+{
+    *pBuffer++ = ( uint8_t ) ( stringLength >> 8 );
+    *pBuffer++ = ( uint8_t ) ( stringLength & 0xFF );
+
+    if( stringLength > 0 )
+    {
+        memcpy( pBuffer, pString, stringLength );
+    }
+
+    return pBuffer + stringLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Allocate a packet with room for its fixed header, and fill that in. */
+static uint8_t * _newPacket( uint8_t packetType,
+                             size_t remainingLength,
+                             size_t * pPacketSize,
+                             uint8_t ** pBody )
+{
+    size_t packetSize = 1 + _remainingLengthSize( remainingLength ) + remainingLength;
+    uint8_t * pPacket = malloc( packetSize );
+
+    if( pPacket != NULL )
+    {
+        pPacket[ 0 ] = packetType;
+        *pBody = _encodeRemainingLength( pPacket + 1, remainingLength );
+        *pPacketSize = packetSize;
+    }
+
+    return pPacket;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t _IotMqtt_SerializePublish( const IotMqttPublishInfo_t * pPublishInfo,
+                                          uint8_t ** pPublishPacket,
+                                          size_t * pPacketSize,
+                                          uint16_t * pPacketIdentifier,
+                                          uint8_t ** pPacketIdentifierHigh )
+{
+    uint8_t packetType = _MQTT_PUBLISH | ( uint8_t ) ( pPublishInfo->qos << 1 );
+    size_t remainingLength = 2 + pPublishInfo->topicNameLength + pPublishInfo->payloadLength;
+    uint16_t packetIdentifier = 0;
+    uint8_t * pBody = NULL;
+    uint8_t * pPacket = NULL;
+
+    if( pPublishInfo->retain == true )
+    {
+        packetType |= 0x01;
+    }
+
+    if( pPublishInfo->qos != IOT_MQTT_QOS_0 )
+    {
+        remainingLength += 2;
+    }
+
+    pPacket = _newPacket( packetType, remainingLength, pPacketSize, &pBody );
+
+    if( pPacket == NULL )
+    {
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    pBody = _encodeString( pBody, pPublishInfo->pTopicName, pPublishInfo->topicNameLength );
+
+    if( pPublishInfo->qos != IOT_MQTT_QOS_0 )
+    {
+        packetIdentifier = _newPacketIdentifier();
+
+        if( pPacketIdentifierHigh != NULL )
+        {
+            *pPacketIdentifierHigh = pBody;
+        }
+
+        *pBody++ = ( uint8_t ) ( packetIdentifier >> 8 );
+        *pBody++ = ( uint8_t ) ( packetIdentifier & 0xFF );
+    }
+
+    if( pPublishInfo->payloadLength > 0 )
+    {
+        memcpy( pBody, pPublishInfo->pPayload, pPublishInfo->payloadLength );
+    }
+
+    *pPublishPacket = pPacket;
+    *pPacketIdentifier = packetIdentifier;
+
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_FreePacket( uint8_t * pPacket )
+{
+    free( pPacket );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _sendPacket( _mqttConnection_t * pMqttConnection,
+                         const uint8_t * pPacket,
+                         size_t packetSize )
+{
+    size_t bytesSent = 0;
+
+    IotMutex_Lock( &( pMqttConnection->sendMutex ) );
+    bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
+                                                          pPacket,
+                                                          packetSize );
+    pMqttConnection->lastSendMs = IotClock_GetTimeMs();
+    IotMutex_Unlock( &( pMqttConnection->sendMutex ) );
+
+    return bytesSent == packetSize;
+}
+
+/*-----------------------------------------------------------*/
+
+static _mqttOperation_t * _newOperation( _mqttConnection_t * pMqttConnection,
+                                         IotMqttOperationType_t type,
+                                         uint32_t flags,
+                                         const IotMqttCallbackInfo_t * pCallbackInfo )
+{
+    _mqttOperation_t * pOperation = calloc( 1, sizeof( _mqttOperation_t ) );
+
+    if( pOperation == NULL )
+    {
+        return NULL;
+    }
+
+    pOperation->pMqttConnection = pMqttConnection;
+    pOperation->type = type;
+    pOperation->status = IOT_MQTT_STATUS_PENDING;
+    pOperation->waitable = ( ( flags & IOT_MQTT_FLAG_WAITABLE ) != 0 );
+
+    if( pCallbackInfo != NULL )
+    {
+        pOperation->callback = *pCallbackInfo;
+    }
+
+    if( ( pOperation->waitable == true ) && ( IotSemaphore_Create( &( pOperation->notify ), 0, 1 ) == false ) )
+    {
+        free( pOperation );
+        pOperation = NULL;
+    }
+
+    return pOperation;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _freeOperation( _mqttOperation_t * pOperation )
+{
+    if( pOperation->pPacket != NULL )
+    {
+        pOperation->freePacket( pOperation->pPacket );
+    }
+
+    if( pOperation->waitable == true )
+    {
+        IotSemaphore_Destroy( &( pOperation->notify ) );
+    }
+
+    free( pOperation );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Add an operation to the pending list, if the connection is still up. */
+static bool _addOperation( _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    bool added = false;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    if( pMqttConnection->disconnected == false )
+    {
+        pOperation->pNext = pMqttConnection->pOperations;
+        pMqttConnection->pOperations = pOperation;
+        added = true;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return added;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take a pending operation off the list, by packet identifier or, with an
+ * identifier of 0, by type. NULL if there is none. */
+static _mqttOperation_t * _takeOperation( _mqttConnection_t * pMqttConnection,
+                                          IotMqttOperationType_t type,
+                                          uint16_t packetIdentifier )
+{
+    _mqttOperation_t ** ppOperation = NULL;
+    _mqttOperation_t * pOperation = NULL;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    for( ppOperation = &( pMqttConnection->pOperations ); *ppOperation != NULL; ppOperation = &( ( *ppOperation )->pNext ) )
+    {
+        if( ( ( *ppOperation )->type == type ) && ( ( *ppOperation )->packetIdentifier == packetIdentifier ) )
+        {
+            pOperation = *ppOperation;
+            *ppOperation = pOperation->pNext;
+            pOperation->pNext = NULL;
+            break;
+        }
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return pOperation;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Take an operation off the list if it is still on it. */
+static bool _removeOperation( _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    _mqttOperation_t ** ppOperation = NULL;
+    bool removed = false;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    for( ppOperation = &( pMqttConnection->pOperations ); *ppOperation != NULL; ppOperation = &( ( *ppOperation )->pNext ) )
+    {
+        if( *ppOperation == pOperation )
+        {
+            *ppOperation = pOperation->pNext;
+            pOperation->pNext = NULL;
+            removed = true;
+            break;
+        }
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return removed;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Finish an operation that is no longer on the pending list. */
+static void _completeOperation( _mqttOperation_t * pOperation,
+                                IotMqttError_t status )
+{
+    IotMqttCallbackParam_t callbackParam = { 0 };
+
+    pOperation->status = status;
+
+    /* The retained PUBLISH is no longer needed. */
+    if( pOperation->pPacket != NULL )
+    {
+        pOperation->freePacket( pOperation->pPacket );
+        pOperation->pPacket = NULL;
+    }
+
+    if( pOperation->waitable == true )
+    {
+        IotSemaphore_Post( &( pOperation->notify ) );
+
+        return;
+    }
+
+    if( pOperation->callback.function != NULL )
+    {
+        callbackParam.mqttConnection = pOperation->pMqttConnection;
+        callbackParam.u.operation.type = pOperation->type;
+        callbackParam.u.operation.reference = pOperation;
+        callbackParam.u.operation.result = status;
+        pOperation->callback.function( pOperation->callback.pCallbackContext, &callbackParam );
+    }
+
+    _freeOperation( pOperation );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _invokeDisconnectCallback( _mqttConnection_t * pMqttConnection,
+                                       IotMqttDisconnectReason_t reason )
+{
+    IotMqttCallbackParam_t callbackParam = { 0 };
+
+    if( pMqttConnection->disconnectCallback.function != NULL )
+    {
+        callbackParam.mqttConnection = pMqttConnection;
+        callbackParam.u.disconnectReason = reason;
+        pMqttConnection->disconnectCallback.function( pMqttConnection->disconnectCallback.pCallbackContext,
+                                                      &callbackParam );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Mark the connection down and fail everything pending on it.
+ *
+ * @return false if it was already down. */
+static bool _markDisconnected( _mqttConnection_t * pMqttConnection )
+{
+    _mqttOperation_t * pOperations = NULL;
+    _mqttOperation_t * pNext = NULL;
+    bool wasConnected = false;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+    wasConnected = ( pMqttConnection->disconnected == false );
+    pMqttConnection->disconnected = true;
+    pOperations = pMqttConnection->pOperations;
+    pMqttConnection->pOperations = NULL;
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    for( ; pOperations != NULL; pOperations = pNext )
+    {
+        pNext = pOperations->pNext;
+        _completeOperation( pOperations, IOT_MQTT_NETWORK_ERROR );
+    }
+
+    return wasConnected;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The network failed under the connection, or the server misbehaved. */
+static void _closeNetworkConnection( _mqttConnection_t * pMqttConnection,
+                                     IotMqttDisconnectReason_t reason )
+{
+    if( _markDisconnected( pMqttConnection ) == true )
+    {
+        IotLogWarn( "MQTT connection %p lost (reason %d).", ( void * ) pMqttConnection, ( int ) reason );
+        ( void ) pMqttConnection->pNetworkInterface->close( pMqttConnection->pNetworkConnection );
+        _invokeDisconnectCallback( pMqttConnection, reason );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _serviceTimerCallback( TimerHandle_t xTimer )
+{
+    _mqttConnection_t * pMqttConnection = pvTimerGetTimerID( xTimer );
+    static const uint8_t pingreq[ 2 ] = { _MQTT_PINGREQ, 0 };
+    _mqttOperation_t * pOperation = NULL;
+    uint64_t nowMs = IotClock_GetTimeMs();
+    bool sendPing = false, keepAliveFailed = false;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    if( pMqttConnection->disconnected == true )
+    {
+        IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+        return;
+    }
+
+    if( pMqttConnection->pingPending == true )
+    {
+        keepAliveFailed = ( nowMs - pMqttConnection->pingSentMs > _PINGRESP_TIMEOUT_MS );
+    }
+    else if( ( pMqttConnection->keepAliveMs > 0 ) &&
+             ( nowMs - pMqttConnection->lastSendMs >= pMqttConnection->keepAliveMs ) )
+    {
+        sendPing = true;
+        pMqttConnection->pingPending = true;
+        pMqttConnection->pingSentMs = nowMs;
+    }
+
+    /* Retransmit with the send lock taken inside the references lock, as
+     * _sendPacket does not take the references lock. */
+    for( pOperation = pMqttConnection->pOperations; pOperation != NULL; pOperation = pOperation->pNext )
+    {
+        if( ( pOperation->pPacket != NULL ) && ( pOperation->retryCount < pOperation->retryLimit ) &&
+            ( nowMs >= pOperation->nextRetryMs ) )
+        {
+            pOperation->pPacket[ 0 ] |= _PUBLISH_DUP_FLAG;
+            pOperation->retryCount++;
+            pOperation->retryPeriodMs *= 2;
+            pOperation->nextRetryMs = nowMs + pOperation->retryPeriodMs;
+            ( void ) _sendPacket( pMqttConnection, pOperation->pPacket, pOperation->packetSize );
+        }
+    }
+
+    /* The last retransmission gets one more period to be acknowledged. */
+    for( pOperation = pMqttConnection->pOperations; pOperation != NULL; pOperation = pOperation->pNext )
+    {
+        if( ( pOperation->pPacket != NULL ) && ( pOperation->retryLimit > 0 ) &&
+            ( pOperation->retryCount == pOperation->retryLimit ) && ( nowMs >= pOperation->nextRetryMs ) )
+        {
+            break;
+        }
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    if( ( pOperation != NULL ) && ( _removeOperation( pOperation ) == true ) )
+    {
+        _completeOperation( pOperation, IOT_MQTT_RETRY_NO_RESPONSE );
+    }
+
+    if( sendPing == true )
+    {
+        ( void ) _sendPacket( pMqttConnection, pingreq, sizeof( pingreq ) );
+    }
+
+    if( keepAliveFailed == true )
+    {
+        pMqttConnection->keepAliveFailed = true;
+        _closeNetworkConnection( pMqttConnection, IOT_MQTT_KEEP_ALIVE_TIMEOUT );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _topicMatches( const char * pTopicFilter,
+                           uint16_t topicFilterLength,
+                           const char * pTopicName,
+                           uint16_t topicNameLength )
+{
+    uint16_t filterIndex = 0, nameIndex = 0;
+
+    while( ( filterIndex < topicFilterLength ) && ( nameIndex < topicNameLength ) )
+    {
+        if( pTopicFilter[ filterIndex ] == '#' )
+        {
+            return true;
+        }
+
+        if( pTopicFilter[ filterIndex ] == '+' )
+        {
+            /* One whole level of the name. */
+            while( ( nameIndex < topicNameLength ) && ( pTopicName[ nameIndex ] != '/' ) )
+            {
+                nameIndex++;
+            }
+
+            filterIndex++;
+        }
+        else if( pTopicFilter[ filterIndex ] == pTopicName[ nameIndex ] )
+        {
+            filterIndex++;
+            nameIndex++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if( nameIndex < topicNameLength )
+    {
+        return false;
+    }
+
+    /* "a/#" also matches "a", and "a/+" matches "a/". */
+    return ( filterIndex == topicFilterLength ) ||
+           ( ( topicFilterLength - filterIndex == 2 ) && ( pTopicFilter[ filterIndex ] == '/' ) &&
+             ( pTopicFilter[ filterIndex + 1 ] == '#' ) ) ||
+           ( ( topicFilterLength - filterIndex == 1 ) && ( pTopicFilter[ filterIndex ] == '#' ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _handlePublish( _mqttConnection_t * pMqttConnection,
+                            uint8_t packetType,
+                            const uint8_t * pBody,
+                            size_t remainingLength )
+{
+    IotMqttCallbackParam_t callbackParam = { 0 };
+    _mqttSubscription_t * pSubscription = NULL;
+    uint8_t puback[ 4 ] = { _MQTT_PUBACK, 2, 0, 0 };
+    size_t offset = 0;
+
+    callbackParam.mqttConnection = pMqttConnection;
+    callbackParam.u.message.info.qos = ( IotMqttQos_t ) ( ( packetType >> 1 ) & 0x03 );
+    callbackParam.u.message.info.retain = ( ( packetType & 0x01 ) != 0 );
+
+    if( ( remainingLength < 2 ) || ( callbackParam.u.message.info.qos == IOT_MQTT_QOS_2 ) )
+    {
+        return false;
+    }
+
+    callbackParam.u.message.info.topicNameLength = ( uint16_t ) ( ( pBody[ 0 ] << 8 ) | pBody[ 1 ] );
+    callbackParam.u.message.info.pTopicName = ( const char * ) ( pBody + 2 );
+    offset = 2U + callbackParam.u.message.info.topicNameLength;
+
+    if( callbackParam.u.message.info.qos == IOT_MQTT_QOS_1 )
+    {
+        if( offset + 2 > remainingLength )
+        {
+            return false;
+        }
+
+        puback[ 2 ] = pBody[ offset ];
+        puback[ 3 ] = pBody[ offset + 1 ];
+        offset += 2;
+    }
+
+    if( offset > remainingLength )
+    {
+        return false;
+    }
+
+    callbackParam.u.message.info.pPayload = pBody + offset;
+    callbackParam.u.message.info.payloadLength = remainingLength - offset;
+
+    /* Acknowledge first, so that a slow callback does not hold the
+     * sender's retransmission timer. */
+    if( callbackParam.u.message.info.qos == IOT_MQTT_QOS_1 )
+    {
+        ( void ) _sendPacket( pMqttConnection, puback, sizeof( puback ) );
+    }
+
+    IotMutex_Lock( &( pMqttConnection->subscriptionMutex ) );
+
+    for( pSubscription = pMqttConnection->pSubscriptions; pSubscription != NULL; pSubscription = pSubscription->pNext )
+    {
+        if( _topicMatches( pSubscription->pTopicFilter,
+                           pSubscription->topicFilterLength,
+                           callbackParam.u.message.info.pTopicName,
+                           callbackParam.u.message.info.topicNameLength ) == true )
+        {
+            callbackParam.u.message.pTopicFilter = pSubscription->pTopicFilter;
+            callbackParam.u.message.topicFilterLength = pSubscription->topicFilterLength;
+            pSubscription->callback.function( pSubscription->callback.pCallbackContext, &callbackParam );
+        }
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->subscriptionMutex ) );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _removeSubscription( _mqttConnection_t * pMqttConnection,
+                                 const char * pTopicFilter,
+                                 uint16_t topicFilterLength )
+{
+    _mqttSubscription_t ** ppSubscription = &( pMqttConnection->pSubscriptions );
+    _mqttSubscription_t * pRemoved = NULL;
+
+    while( *ppSubscription != NULL )
+    {
+        if( ( ( *ppSubscription )->topicFilterLength == topicFilterLength ) &&
+            ( memcmp( ( *ppSubscription )->pTopicFilter, pTopicFilter, topicFilterLength ) == 0 ) )
+        {
+            pRemoved = *ppSubscription;
+            *ppSubscription = pRemoved->pNext;
+            free( pRemoved );
+        }
+        else
+        {
+            ppSubscription = &( ( *ppSubscription )->pNext );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _handleAck( _mqttConnection_t * pMqttConnection,
+                        uint8_t packetType,
+                        const uint8_t * pBody,
+                        size_t remainingLength )
+{
+    _mqttOperation_t * pOperation = NULL;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    uint16_t packetIdentifier = 0;
+    size_t i = 0;
+
+    if( packetType == _MQTT_CONNACK )
+    {
+        if( remainingLength != 2 )
+        {
+            return false;
+        }
+
+        pOperation = _takeOperation( pMqttConnection, IOT_MQTT_CONNECT, 0 );
+        status = ( pBody[ 1 ] == 0 ) ? IOT_MQTT_SUCCESS : IOT_MQTT_SERVER_REFUSED;
+    }
+    else if( packetType == _MQTT_PINGRESP )
+    {
+        pMqttConnection->pingPending = false;
+
+        return remainingLength == 0;
+    }
+    else
+    {
+        if( remainingLength < 2 )
+        {
+            return false;
+        }
+
+        packetIdentifier = ( uint16_t ) ( ( pBody[ 0 ] << 8 ) | pBody[ 1 ] );
+
+        if( packetType == _MQTT_PUBACK )
+        {
+            pOperation = _takeOperation( pMqttConnection, IOT_MQTT_PUBLISH_TO_SERVER, packetIdentifier );
+        }
+        else if( packetType == _MQTT_UNSUBACK )
+        {
+            pOperation = _takeOperation( pMqttConnection, IOT_MQTT_UNSUBSCRIBE, packetIdentifier );
+        }
+        else
+        {
+            pOperation = _takeOperation( pMqttConnection, IOT_MQTT_SUBSCRIBE, packetIdentifier );
+
+            /* Refused filters are reported by the caller's IsSubscribed. */
+            for( i = 2; ( pOperation != NULL ) && ( i < remainingLength ); i++ )
+            {
+                if( pBody[ i ] == 0x80 )
+                {
+                    status = IOT_MQTT_SERVER_REFUSED;
+                }
+            }
+        }
+    }
+
+    /* A late acknowledgement of an operation that timed out is ignored. */
+    if( pOperation != NULL )
+    {
+        _completeOperation( pOperation, status );
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_ReceiveCallback( void * pNetworkConnection,
+                              void * pReceiveContext )
+{
+    _mqttConnection_t * pMqttConnection = pReceiveContext;
+    const IotNetworkInterface_t * pNetworkInterface = pMqttConnection->pNetworkInterface;
+    uint8_t packetType = 0, encodedByte = 0;
+    size_t remainingLength = 0, multiplier = 1, lengthBytes = 0;
+    uint8_t * pBody = NULL;
+    bool packetValid = false;
+
+    if( pNetworkInterface->receive( pNetworkConnection, &packetType, 1 ) == 1 )
+    {
+        do
+        {
+            if( pNetworkInterface->receive( pNetworkConnection, &encodedByte, 1 ) != 1 )
+            {
+                break;
+            }
+
+            remainingLength += ( size_t ) ( encodedByte & 0x7F ) * multiplier;
+            multiplier *= 128U;
+            lengthBytes++;
+        } while( ( ( encodedByte & 0x80 ) != 0 ) && ( lengthBytes < 4 ) );
+
+        packetValid = ( lengthBytes > 0 ) && ( ( encodedByte & 0x80 ) == 0 );
+    }
+
+    if( ( packetValid == true ) && ( remainingLength > 0 ) )
+    {
+        pBody = malloc( remainingLength );
+        packetValid = ( pBody != NULL ) &&
+                      ( pNetworkInterface->receive( pNetworkConnection, pBody, remainingLength ) == remainingLength );
+    }
+
+    if( packetValid == true )
+    {
+        switch( packetType & 0xF0 )
+        {
+            case _MQTT_PUBLISH:
+                packetValid = _handlePublish( pMqttConnection, packetType, pBody, remainingLength );
+                break;
+
+            case _MQTT_CONNACK:
+            case _MQTT_PUBACK:
+            case _MQTT_SUBACK:
+            case _MQTT_UNSUBACK:
+            case _MQTT_PINGRESP:
+                packetValid = _handleAck( pMqttConnection, packetType, pBody, remainingLength );
+                break;
+
+            default:
+                packetValid = false;
+                break;
+        }
+    }
+
+    free( pBody );
+
+    /* A connection that read nothing, or garbage, is closed; the demos learn
+     * of it through the disconnect callback. */
+    if( packetValid == false )
+    {
+        _closeNetworkConnection( pMqttConnection,
+                                 ( pMqttConnection->keepAliveFailed == true ) ? IOT_MQTT_KEEP_ALIVE_TIMEOUT :
+                                 IOT_MQTT_BAD_PACKET_RECEIVED );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Init( void )
+{
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_Cleanup( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+static void _timerBarrier( void * pArgument,
+                           uint32_t unused )
+{
+    ( void ) unused;
+
+    IotSemaphore_Post( pArgument );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _destroyConnection( _mqttConnection_t * pMqttConnection )
+{
+    _mqttSubscription_t * pSubscription = NULL;
+    IotSemaphore_t timerIdle;
+
+    if( pMqttConnection->serviceTimer != NULL )
+    {
+        ( void ) xTimerDelete( pMqttConnection->serviceTimer, portMAX_DELAY );
+
+        /* Once a call pended after the delete has run, the service timer
+         * callback is not running and will not run again. On the timer task
+         * itself, the callback has nothing left to do with the connection. */
+        if( ( xTaskGetCurrentTaskHandle() != xTimerGetTimerDaemonTaskHandle() ) &&
+            ( IotSemaphore_Create( &timerIdle, 0, 1 ) == true ) )
+        {
+            if( xTimerPendFunctionCall( _timerBarrier, &timerIdle, 0, portMAX_DELAY ) == pdPASS )
+            {
+                IotSemaphore_Wait( &timerIdle );
+            }
+
+            IotSemaphore_Destroy( &timerIdle );
+        }
+    }
+
+    if( pMqttConnection->ownNetworkConnection == true )
+    {
+        ( void ) pMqttConnection->pNetworkInterface->destroy( pMqttConnection->pNetworkConnection );
+    }
+
+    while( pMqttConnection->pSubscriptions != NULL )
+    {
+        pSubscription = pMqttConnection->pSubscriptions;
+        pMqttConnection->pSubscriptions = pSubscription->pNext;
+        free( pSubscription );
+    }
+
+    IotMutex_Destroy( &( pMqttConnection->subscriptionMutex ) );
+    IotMutex_Destroy( &( pMqttConnection->sendMutex ) );
+    IotMutex_Destroy( &( pMqttConnection->referencesMutex ) );
+    free( pMqttConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * _serializeConnect( const IotMqttConnectInfo_t * pConnectInfo,
+                                    size_t * pPacketSize )
+{
+    const IotMqttPublishInfo_t * pWillInfo = pConnectInfo->pWillInfo;
+    size_t remainingLength = 10 + 2 + pConnectInfo->clientIdentifierLength;
+    uint8_t connectFlags = 0;
+    uint8_t * pBody = NULL;
+    uint8_t * pPacket = NULL;
+
+    if( pConnectInfo->cleanSession == true )
+    {
+        connectFlags |= 0x02;
+    }
+
+    if( pWillInfo != NULL )
+    {
+        connectFlags |= 0x04 | ( uint8_t ) ( pWillInfo->qos << 3 ) | ( ( pWillInfo->retain == true ) ? 0x20 : 0x00 );
+        remainingLength += 2 + pWillInfo->topicNameLength + 2 + pWillInfo->payloadLength;
+    }
+
+    if( pConnectInfo->pUserName != NULL )
+    {
+        connectFlags |= 0x80;
+        remainingLength += 2 + pConnectInfo->userNameLength;
+    }
+
+    if( pConnectInfo->pPassword != NULL )
+    {
+        connectFlags |= 0x40;
+        remainingLength += 2 + pConnectInfo->passwordLength;
+    }
+
+    pPacket = _newPacket( _MQTT_CONNECT, remainingLength, pPacketSize, &pBody );
+
+    if( pPacket != NULL )
+    {
+        pBody = _encodeString( pBody, "MQTT", 4 );
+        *pBody++ = 4;
+        *pBody++ = connectFlags;
+        *pBody++ = ( uint8_t ) ( pConnectInfo->keepAliveSeconds >> 8 );
+        *pBody++ = ( uint8_t ) ( pConnectInfo->keepAliveSeconds & 0xFF );
+        pBody = _encodeString( pBody, pConnectInfo->pClientIdentifier, pConnectInfo->clientIdentifierLength );
+
+        if( pWillInfo != NULL )
+        {
+            pBody = _encodeString( pBody, pWillInfo->pTopicName, pWillInfo->topicNameLength );
+            pBody = _encodeString( pBody, pWillInfo->pPayload, ( uint16_t ) pWillInfo->payloadLength );
+        }
+
+        if( pConnectInfo->pUserName != NULL )
+        {
+            pBody = _encodeString( pBody, pConnectInfo->pUserName, pConnectInfo->userNameLength );
+        }
+
+        if( pConnectInfo->pPassword != NULL )
+        {
+            ( void ) _encodeString( pBody, pConnectInfo->pPassword, pConnectInfo->passwordLength );
+        }
+    }
+
+    return pPacket;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Wait for a waitable operation, and free it. */
+static IotMqttError_t _waitOperation( _mqttOperation_t * pOperation,
+                                      uint32_t timeoutMs )
+{
+    IotMqttError_t status = IOT_MQTT_TIMEOUT;
+
+    if( IotSemaphore_TimedWait( &( pOperation->notify ), timeoutMs ) == true )
+    {
+        status = pOperation->status;
+    }
+    else if( _removeOperation( pOperation ) == false )
+    {
+        /* Completed while the wait was giving up. */
+        IotSemaphore_Wait( &( pOperation->notify ) );
+        status = pOperation->status;
+    }
+
+    _freeOperation( pOperation );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
+                                const IotMqttConnectInfo_t * pConnectInfo,
+                                uint32_t timeoutMs,
+                                IotMqttConnection_t * const pMqttConnection )
+{
+    _mqttConnection_t * pNewConnection = NULL;
+    _mqttOperation_t * pOperation = NULL;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    uint8_t * pPacket = NULL;
+    size_t packetSize = 0;
+
+    if( ( pNetworkInfo == NULL ) || ( pNetworkInfo->pNetworkInterface == NULL ) ||
+        ( pConnectInfo == NULL ) || ( pMqttConnection == NULL ) ||
+        ( ( pConnectInfo->clientIdentifierLength > 0 ) && ( pConnectInfo->pClientIdentifier == NULL ) ) )
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+
+    pNewConnection = calloc( 1, sizeof( _mqttConnection_t ) );
+
+    if( pNewConnection == NULL )
+    {
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    ( void ) IotMutex_Create( &( pNewConnection->referencesMutex ), false );
+    ( void ) IotMutex_Create( &( pNewConnection->sendMutex ), false );
+    ( void ) IotMutex_Create( &( pNewConnection->subscriptionMutex ), true );
+    pNewConnection->pNetworkInterface = pNetworkInfo->pNetworkInterface;
+    pNewConnection->disconnectCallback = pNetworkInfo->disconnectCallback;
+    pNewConnection->pSerializer = pNetworkInfo->pMqttSerializer;
+    pNewConnection->keepAliveMs = pConnectInfo->keepAliveSeconds * 1000U;
+
+    if( pNetworkInfo->createNetworkConnection == true )
+    {
+        if( pNetworkInfo->pNetworkInterface->create( pNetworkInfo->u.setup.pNetworkServerInfo,
+                                                     pNetworkInfo->u.setup.pNetworkCredentialInfo,
+                                                     &( pNewConnection->pNetworkConnection ) ) != IOT_NETWORK_SUCCESS )
+        {
+            IotMutex_Destroy( &( pNewConnection->subscriptionMutex ) );
+            IotMutex_Destroy( &( pNewConnection->sendMutex ) );
+            IotMutex_Destroy( &( pNewConnection->referencesMutex ) );
+            free( pNewConnection );
+
+            return IOT_MQTT_NETWORK_ERROR;
+        }
+
+        pNewConnection->ownNetworkConnection = true;
+    }
+    else
+    {
+        pNewConnection->pNetworkConnection = pNetworkInfo->u.pNetworkConnection;
+    }
+
+    pNewConnection->serviceTimer = xTimerCreate( "MqttService",
+                                                 pdMS_TO_TICKS( _SERVICE_PERIOD_MS ),
+                                                 pdTRUE,
+                                                 pNewConnection,
+                                                 _serviceTimerCallback );
+    pOperation = _newOperation( pNewConnection, IOT_MQTT_CONNECT, IOT_MQTT_FLAG_WAITABLE, NULL );
+    pPacket = _serializeConnect( pConnectInfo, &packetSize );
+
+    if( ( pNewConnection->serviceTimer == NULL ) || ( pOperation == NULL ) || ( pPacket == NULL ) )
+    {
+        status = IOT_MQTT_NO_MEMORY;
+    }
+    else if( pNetworkInfo->pNetworkInterface->setReceiveCallback( pNewConnection->pNetworkConnection,
+                                                                  IotMqtt_ReceiveCallback,
+                                                                  pNewConnection ) != IOT_NETWORK_SUCCESS )
+    {
+        status = IOT_MQTT_NETWORK_ERROR;
+    }
+    else
+    {
+        ( void ) _addOperation( pOperation );
+
+        if( _sendPacket( pNewConnection, pPacket, packetSize ) == false )
+        {
+            ( void ) _removeOperation( pOperation );
+            status = IOT_MQTT_NETWORK_ERROR;
+        }
+        else
+        {
+            status = _waitOperation( pOperation, timeoutMs );
+        }
+
+        pOperation = NULL;
+    }
+
+    free( pPacket );
+
+    if( pOperation != NULL )
+    {
+        _freeOperation( pOperation );
+    }
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        ( void ) xTimerStart( pNewConnection->serviceTimer, portMAX_DELAY );
+        *pMqttConnection = pNewConnection;
+    }
+    else
+    {
+        ( void ) _markDisconnected( pNewConnection );
+        ( void ) pNewConnection->pNetworkInterface->close( pNewConnection->pNetworkConnection );
+        _destroyConnection( pNewConnection );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_Disconnect( IotMqttConnection_t mqttConnection,
+                         uint32_t flags )
+{
+    static const uint8_t disconnect[ 2 ] = { _MQTT_DISCONNECT, 0 };
+    bool wasConnected = false;
+
+    if( mqttConnection == NULL )
+    {
+        return;
+    }
+
+    IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+    wasConnected = ( mqttConnection->disconnected == false );
+    IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+    if( ( wasConnected == true ) && ( ( flags & IOT_MQTT_FLAG_CLEANUP_ONLY ) == 0 ) )
+    {
+        ( void ) _sendPacket( mqttConnection, disconnect, sizeof( disconnect ) );
+    }
+
+    ( void ) _markDisconnected( mqttConnection );
+    ( void ) mqttConnection->pNetworkInterface->close( mqttConnection->pNetworkConnection );
+
+    if( wasConnected == true )
+    {
+        _invokeDisconnectCallback( mqttConnection, IOT_MQTT_DISCONNECT_CALLED );
+    }
+
+    _destroyConnection( mqttConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
+                                const IotMqttPublishInfo_t * pPublishInfo,
+                                uint32_t flags,
+                                const IotMqttCallbackInfo_t * pCallbackInfo,
+                                IotMqttOperation_t * const pPublishOperation )
+{
+    IotMqttError_t ( * serializePublish )( const IotMqttPublishInfo_t *, uint8_t **, size_t *, uint16_t *, uint8_t ** ) =
+        _IotMqtt_SerializePublish;
+    void ( * freePacket )( uint8_t * ) = _IotMqtt_FreePacket;
+    _mqttOperation_t * pOperation = NULL;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    uint8_t * pPacket = NULL;
+    size_t packetSize = 0;
+    uint16_t packetIdentifier = 0;
+
+    if( ( mqttConnection == NULL ) || ( pPublishInfo == NULL ) || ( pPublishInfo->qos == IOT_MQTT_QOS_2 ) ||
+        ( ( ( flags & IOT_MQTT_FLAG_WAITABLE ) != 0 ) && ( pPublishOperation == NULL ) ) )
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+
+    #if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1
+        if( mqttConnection->pSerializer != NULL )
+        {
+            if( mqttConnection->pSerializer->serialize.publish != NULL )
+            {
+                serializePublish = mqttConnection->pSerializer->serialize.publish;
+            }
+
+            if( mqttConnection->pSerializer->freePacket != NULL )
+            {
+                freePacket = mqttConnection->pSerializer->freePacket;
+            }
+        }
+    #endif
+
+    status = serializePublish( pPublishInfo, &pPacket, &packetSize, &packetIdentifier, NULL );
+
+    if( status != IOT_MQTT_SUCCESS )
+    {
+        return status;
+    }
+
+    pOperation = _newOperation( mqttConnection, IOT_MQTT_PUBLISH_TO_SERVER, flags, pCallbackInfo );
+
+    if( pOperation == NULL )
+    {
+        freePacket( pPacket );
+
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    pOperation->packetIdentifier = packetIdentifier;
+    pOperation->freePacket = freePacket;
+
+    if( pPublishInfo->qos == IOT_MQTT_QOS_1 )
+    {
+        /* Kept until the PUBACK, for retransmission. */
+        pOperation->pPacket = pPacket;
+        pOperation->packetSize = packetSize;
+        pOperation->retryLimit = pPublishInfo->retryLimit;
+        pOperation->retryPeriodMs = pPublishInfo->retryMs;
+        pOperation->nextRetryMs = IotClock_GetTimeMs() + pPublishInfo->retryMs;
+
+        if( _addOperation( pOperation ) == false )
+        {
+            _freeOperation( pOperation );
+
+            return IOT_MQTT_NETWORK_ERROR;
+        }
+
+        if( pPublishOperation != NULL )
+        {
+            *pPublishOperation = pOperation;
+        }
+
+        /* A failed send is retransmitted, or fails with the connection.
+         * The packet may be completed and freed by now, so the send works
+         * on the operation under the references lock. */
+        IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+
+        if( pOperation->pPacket != NULL )
+        {
+            ( void ) _sendPacket( mqttConnection, pOperation->pPacket, pOperation->packetSize );
+        }
+
+        IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+        return IOT_MQTT_STATUS_PENDING;
+    }
+
+    /* QoS 0 is done once sent. */
+    if( _sendPacket( mqttConnection, pPacket, packetSize ) == false )
+    {
+        status = IOT_MQTT_NETWORK_ERROR;
+    }
+
+    freePacket( pPacket );
+
+    if( pPublishOperation != NULL )
+    {
+        *pPublishOperation = pOperation;
+    }
+
+    _completeOperation( pOperation, status );
+
+    return ( ( flags & IOT_MQTT_FLAG_WAITABLE ) != 0 ) ? IOT_MQTT_STATUS_PENDING : status;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedPublish( IotMqttConnection_t mqttConnection,
+                                     const IotMqttPublishInfo_t * pPublishInfo,
+                                     uint32_t flags,
+                                     uint32_t timeoutMs )
+{
+    IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
+    IotMqttError_t status = IotMqtt_Publish( mqttConnection,
+                                             pPublishInfo,
+                                             flags | IOT_MQTT_FLAG_WAITABLE,
+                                             NULL,
+                                             &publishOperation );
+
+    if( status == IOT_MQTT_STATUS_PENDING )
+    {
+        status = IotMqtt_Wait( publishOperation, timeoutMs );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotMqttError_t _subscriptionCommon( IotMqttOperationType_t type,
+                                           IotMqttConnection_t mqttConnection,
+                                           const IotMqttSubscription_t * pSubscriptionList,
+                                           size_t subscriptionCount,
+                                           uint32_t timeoutMs )
+{
+    _mqttOperation_t * pOperation = NULL;
+    _mqttSubscription_t * pSubscription = NULL;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    size_t remainingLength = 2, packetSize = 0, i = 0;
+    uint8_t * pPacket = NULL;
+    uint8_t * pBody = NULL;
+
+    if( ( mqttConnection == NULL ) || ( pSubscriptionList == NULL ) || ( subscriptionCount == 0 ) )
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+
+    for( i = 0; i < subscriptionCount; i++ )
+    {
+        if( ( pSubscriptionList[ i ].qos == IOT_MQTT_QOS_2 ) ||
+            ( ( type == IOT_MQTT_SUBSCRIBE ) && ( pSubscriptionList[ i ].callback.function == NULL ) ) )
+        {
+            return IOT_MQTT_BAD_PARAMETER;
+        }
+
+        remainingLength += 2U + pSubscriptionList[ i ].topicFilterLength + ( ( type == IOT_MQTT_SUBSCRIBE ) ? 1U : 0U );
+    }
+
+    pPacket = _newPacket( ( type == IOT_MQTT_SUBSCRIBE ) ? _MQTT_SUBSCRIBE : _MQTT_UNSUBSCRIBE,
+                          remainingLength, &packetSize, &pBody );
+    pOperation = _newOperation( mqttConnection, type, IOT_MQTT_FLAG_WAITABLE, NULL );
+
+    if( ( pPacket == NULL ) || ( pOperation == NULL ) )
+    {
+        free( pPacket );
+
+        if( pOperation != NULL )
+        {
+            _freeOperation( pOperation );
+        }
+
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    pOperation->packetIdentifier = _newPacketIdentifier();
+    *pBody++ = ( uint8_t ) ( pOperation->packetIdentifier >> 8 );
+    *pBody++ = ( uint8_t ) ( pOperation->packetIdentifier & 0xFF );
+
+    /* The subscriptions are in place before the SUBSCRIBE goes out, so that
+     * nothing the server sends in between is missed; they are taken back if
+     * the server refuses. Unsubscribed filters go at once. */
+    IotMutex_Lock( &( mqttConnection->subscriptionMutex ) );
+
+    for( i = 0; i < subscriptionCount; i++ )
+    {
+        pBody = _encodeString( pBody, pSubscriptionList[ i ].pTopicFilter, pSubscriptionList[ i ].topicFilterLength );
+
+        if( type == IOT_MQTT_UNSUBSCRIBE )
+        {
+            _removeSubscription( mqttConnection, pSubscriptionList[ i ].pTopicFilter,
+                                 pSubscriptionList[ i ].topicFilterLength );
+            continue;
+        }
+
+        *pBody++ = ( uint8_t ) pSubscriptionList[ i ].qos;
+        _removeSubscription( mqttConnection, pSubscriptionList[ i ].pTopicFilter,
+                             pSubscriptionList[ i ].topicFilterLength );
+        pSubscription = malloc( sizeof( _mqttSubscription_t ) + pSubscriptionList[ i ].topicFilterLength + 1 );
+
+        if( pSubscription != NULL )
+        {
+            pSubscription->callback = pSubscriptionList[ i ].callback;
+            pSubscription->topicFilterLength = pSubscriptionList[ i ].topicFilterLength;
+            memcpy( pSubscription->pTopicFilter, pSubscriptionList[ i ].pTopicFilter, pSubscription->topicFilterLength );
+            pSubscription->pTopicFilter[ pSubscription->topicFilterLength ] = '\0';
+            pSubscription->pNext = mqttConnection->pSubscriptions;
+            mqttConnection->pSubscriptions = pSubscription;
+        }
+        else
+        {
+            status = IOT_MQTT_NO_MEMORY;
+        }
+    }
+
+    IotMutex_Unlock( &( mqttConnection->subscriptionMutex ) );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        if( _addOperation( pOperation ) == false )
+        {
+            status = IOT_MQTT_NETWORK_ERROR;
+        }
+        else if( _sendPacket( mqttConnection, pPacket, packetSize ) == false )
+        {
+            ( void ) _removeOperation( pOperation );
+            status = IOT_MQTT_NETWORK_ERROR;
+        }
+        else
+        {
+            status = _waitOperation( pOperation, timeoutMs );
+            pOperation = NULL;
+        }
+    }
+
+    free( pPacket );
+
+    if( pOperation != NULL )
+    {
+        _freeOperation( pOperation );
+    }
+
+    if( ( type == IOT_MQTT_SUBSCRIBE ) && ( status != IOT_MQTT_SUCCESS ) )
+    {
+        IotMutex_Lock( &( mqttConnection->subscriptionMutex ) );
+
+        for( i = 0; i < subscriptionCount; i++ )
+        {
+            _removeSubscription( mqttConnection, pSubscriptionList[ i ].pTopicFilter,
+                                 pSubscriptionList[ i ].topicFilterLength );
+        }
+
+        IotMutex_Unlock( &( mqttConnection->subscriptionMutex ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedSubscribe( IotMqttConnection_t mqttConnection,
+                                       const IotMqttSubscription_t * pSubscriptionList,
+                                       size_t subscriptionCount,
+                                       uint32_t flags,
+                                       uint32_t timeoutMs )
+{
+    ( void ) flags;
+
+    return _subscriptionCommon( IOT_MQTT_SUBSCRIBE, mqttConnection, pSubscriptionList, subscriptionCount, timeoutMs );
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_TimedUnsubscribe( IotMqttConnection_t mqttConnection,
+                                         const IotMqttSubscription_t * pSubscriptionList,
+                                         size_t subscriptionCount,
+                                         uint32_t flags,
+                                         uint32_t timeoutMs )
+{
+    ( void ) flags;
+
+    return _subscriptionCommon( IOT_MQTT_UNSUBSCRIBE, mqttConnection, pSubscriptionList, subscriptionCount, timeoutMs );
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_Wait( IotMqttOperation_t operation,
+                             uint32_t timeoutMs )
+{
+    if( ( operation == NULL ) || ( operation->waitable == false ) )
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+
+    return _waitOperation( operation, timeoutMs );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
+                           const char * pTopicFilter,
+                           uint16_t topicFilterLength,
+                           IotMqttSubscription_t * pCurrentSubscription )
+{
+    _mqttSubscription_t * pSubscription = NULL;
+
+    IotMutex_Lock( &( mqttConnection->subscriptionMutex ) );
+
+    for( pSubscription = mqttConnection->pSubscriptions; pSubscription != NULL; pSubscription = pSubscription->pNext )
+    {
+        if( ( pSubscription->topicFilterLength == topicFilterLength ) &&
+            ( memcmp( pSubscription->pTopicFilter, pTopicFilter, topicFilterLength ) == 0 ) )
+        {
+            if( pCurrentSubscription != NULL )
+            {
+                pCurrentSubscription->pTopicFilter = pSubscription->pTopicFilter;
+                pCurrentSubscription->topicFilterLength = pSubscription->topicFilterLength;
+                pCurrentSubscription->callback = pSubscription->callback;
+                pCurrentSubscription->qos = IOT_MQTT_QOS_1;
+            }
+
+            break;
+        }
+    }
+
+    IotMutex_Unlock( &( mqttConnection->subscriptionMutex ) );
+
+    return pSubscription != NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+const char * IotMqtt_strerror( IotMqttError_t status )
+{
+    static const char * const pMessages[] =
+    {
+        "SUCCESS",       "PENDING",        "INITIALIZATION FAILED", "BAD PARAMETER",
+        "NO MEMORY",     "NETWORK ERROR",  "SCHEDULING ERROR",      "BAD RESPONSE RECEIVED",
+        "TIMEOUT",       "SERVER REFUSED", "NO RESPONSE"
+    };
+
+    return ( ( size_t ) status < sizeof( pMessages ) / sizeof( pMessages[ 0 ] ) ) ? pMessages[ status ] : "INVALID STATUS";
+}
+
+/*-----------------------------------------------------------*/
+
+const char * IotMqtt_OperationType( IotMqttOperationType_t operation )
+{
+    static const char * const pTypes[] =
+    {
+        "CONNECT", "PUBLISH", "PUBACK", "SUBSCRIBE", "UNSUBSCRIBE", "PINGREQ", "DISCONNECT"
+    };
+
+    return ( ( size_t ) operation < sizeof( pTypes ) / sizeof( pTypes[ 0 ] ) ) ? pTypes[ operation ] : "INVALID OPERATION";
+}
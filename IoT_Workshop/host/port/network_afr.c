@@ -0,0 +1,327 @@
+/*
+ * network_afr.c: the network interface of Amazon FreeRTOS (IotNetworkAfr)
+ * over the secure sockets, as platform/freertos/iot_network_freertos.c of
+ * the device build.
+ *
+ * Each connection has a receive task, which waits for the first byte of
+ * each packet and then calls the receive callback; the callback reads the
+ * rest of the packet with `receive`. Only that task reads the socket, so
+ * nothing is read while the TLS layer has bytes buffered that the socket
+ * no longer shows.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "platform/iot_network_freertos.h"
+#include "aws_secure_sockets.h"
+
+/* The receive task runs just above the demos, as in the device build. */
+#define _NETWORK_TASK_PRIORITY      ( tskIDLE_PRIORITY + 6 )
+#define _NETWORK_TASK_STACK_SIZE    ( 4096 )
+
+typedef struct _networkConnection
+{
+    Socket_t socket;
+    TaskHandle_t receiveTask;
+    SemaphoreHandle_t receiveTaskExited;
+    IotNetworkReceiveCallback_t receiveCallback;
+    void * pReceiveContext;
+
+    uint8_t bufferedByte;         /* The byte the receive task waited for. */
+    bool bufferedByteValid;
+    volatile bool closed;         /* Set by close(); the task stops reading. */
+    volatile bool peerClosed;     /* The socket failed under the task. */
+    volatile bool destroyed;      /* destroy() ran on the receive task. */
+} _networkConnection_t;
+
+/*-----------------------------------------------------------*/
+
+static void _receiveTask( void * pArgument )
+{
+    _networkConnection_t * pConnection = pArgument;
+    int32_t socketStatus = 0;
+
+    while( pConnection->closed == false )
+    {
+        socketStatus = SOCKETS_Recv( pConnection->socket, &( pConnection->bufferedByte ), 1, 0 );
+
+        if( socketStatus == 0 )
+        {
+            /* Receive timeout: nothing arrived. */
+            continue;
+        }
+
+        if( socketStatus < 0 )
+        {
+            pConnection->peerClosed = true;
+        }
+        else
+        {
+            pConnection->bufferedByteValid = true;
+        }
+
+        /* On an unexpected close, the callback reads nothing, which tells
+         * the MQTT library that the connection is gone. */
+        if( ( pConnection->closed == false ) && ( pConnection->receiveCallback != NULL ) )
+        {
+            pConnection->receiveCallback( pConnection, pConnection->pReceiveContext );
+        }
+
+        if( pConnection->peerClosed == true )
+        {
+            break;
+        }
+    }
+
+    if( pConnection->destroyed == true )
+    {
+        /* The connection was destroyed from the callback. */
+        ( void ) SOCKETS_Close( pConnection->socket );
+        vSemaphoreDelete( pConnection->receiveTaskExited );
+        vPortFree( pConnection );
+    }
+    else
+    {
+        ( void ) xSemaphoreGive( pConnection->receiveTaskExited );
+    }
+
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _create( void * pConnectionInfo,
+                                  void * pCredentialInfo,
+                                  void ** pConnection )
+{
+    const IotNetworkServerInfo_t * pServerInfo = pConnectionInfo;
+    const IotNetworkCredentials_t * pCredentials = pCredentialInfo;
+    _networkConnection_t * pNewConnection = NULL;
+    SocketsSockaddr_t serverAddress = { 0 };
+    IotNetworkError_t status = IOT_NETWORK_SUCCESS;
+
+    if( ( pServerInfo == NULL ) || ( pServerInfo->pHostName == NULL ) )
+    {
+        return IOT_NETWORK_BAD_PARAMETER;
+    }
+
+    pNewConnection = pvPortMalloc( sizeof( _networkConnection_t ) );
+
+    if( pNewConnection == NULL )
+    {
+        return IOT_NETWORK_NO_MEMORY;
+    }
+
+    memset( pNewConnection, 0x00, sizeof( _networkConnection_t ) );
+    pNewConnection->receiveTaskExited = xSemaphoreCreateBinary();
+    pNewConnection->socket = SOCKETS_Socket( SOCKETS_AF_INET, SOCKETS_SOCK_STREAM, SOCKETS_IPPROTO_TCP );
+
+    if( ( pNewConnection->receiveTaskExited == NULL ) || ( pNewConnection->socket == SOCKETS_INVALID_SOCKET ) )
+    {
+        status = IOT_NETWORK_SYSTEM_ERROR;
+    }
+
+    /* TLS whenever there are credentials; without a root CA of their own,
+     * the server is verified against the default one. */
+    if( ( status == IOT_NETWORK_SUCCESS ) && ( pCredentials != NULL ) )
+    {
+        if( SOCKETS_SetSockOpt( pNewConnection->socket, 0, SOCKETS_SO_REQUIRE_TLS, NULL, 0 ) != SOCKETS_ERROR_NONE )
+        {
+            status = IOT_NETWORK_SYSTEM_ERROR;
+        }
+        else if( ( pCredentials->pRootCa != NULL ) &&
+                 ( SOCKETS_SetSockOpt( pNewConnection->socket, 0, SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE,
+                                       pCredentials->pRootCa, pCredentials->rootCaSize ) != SOCKETS_ERROR_NONE ) )
+        {
+            status = IOT_NETWORK_SYSTEM_ERROR;
+        }
+        else if( ( pCredentials->disableSni == false ) &&
+                 ( SOCKETS_SetSockOpt( pNewConnection->socket, 0, SOCKETS_SO_SERVER_NAME_INDICATION,
+                                       pServerInfo->pHostName, strlen( pServerInfo->pHostName ) ) != SOCKETS_ERROR_NONE ) )
+        {
+            status = IOT_NETWORK_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == IOT_NETWORK_SUCCESS )
+    {
+        serverAddress.ulAddress = SOCKETS_GetHostByName( pServerInfo->pHostName );
+        serverAddress.usPort = SOCKETS_htons( pServerInfo->port );
+        serverAddress.ucSocketDomain = SOCKETS_AF_INET;
+        serverAddress.ucLength = ( uint8_t ) sizeof( serverAddress );
+
+        if( ( serverAddress.ulAddress == 0 ) ||
+            ( SOCKETS_Connect( pNewConnection->socket, &serverAddress, sizeof( serverAddress ) ) != SOCKETS_ERROR_NONE ) )
+        {
+            status = IOT_NETWORK_FAILURE;
+        }
+    }
+
+    if( ( status == IOT_NETWORK_SUCCESS ) &&
+        ( xTaskCreate( _receiveTask,
+                       "NetRecv",
+                       _NETWORK_TASK_STACK_SIZE,
+                       pNewConnection,
+                       _NETWORK_TASK_PRIORITY,
+                       &( pNewConnection->receiveTask ) ) != pdPASS ) )
+    {
+        status = IOT_NETWORK_SYSTEM_ERROR;
+    }
+
+    if( status != IOT_NETWORK_SUCCESS )
+    {
+        if( pNewConnection->socket != SOCKETS_INVALID_SOCKET )
+        {
+            ( void ) SOCKETS_Close( pNewConnection->socket );
+        }
+
+        if( pNewConnection->receiveTaskExited != NULL )
+        {
+            vSemaphoreDelete( pNewConnection->receiveTaskExited );
+        }
+
+        vPortFree( pNewConnection );
+    }
+    else
+    {
+        *pConnection = pNewConnection;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _close( void * pConnection )
+{
+    _networkConnection_t * pNetworkConnection = pConnection;
+
+    /* Shutting the socket down wakes the receive task. */
+    pNetworkConnection->closed = true;
+    ( void ) SOCKETS_Shutdown( pNetworkConnection->socket, SOCKETS_SHUT_RDWR );
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _send( void * pConnection,
+                     const uint8_t * pMessage,
+                     size_t messageLength )
+{
+    _networkConnection_t * pNetworkConnection = pConnection;
+    size_t bytesSent = 0;
+    int32_t socketStatus = 0;
+
+    while( ( bytesSent < messageLength ) && ( pNetworkConnection->closed == false ) )
+    {
+        socketStatus = SOCKETS_Send( pNetworkConnection->socket,
+                                     pMessage + bytesSent,
+                                     messageLength - bytesSent,
+                                     0 );
+
+        if( socketStatus <= 0 )
+        {
+            break;
+        }
+
+        bytesSent += ( size_t ) socketStatus;
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _receive( void * pConnection,
+                        uint8_t * pBuffer,
+                        size_t bytesRequested )
+{
+    _networkConnection_t * pNetworkConnection = pConnection;
+    size_t bytesReceived = 0;
+    int32_t socketStatus = 0;
+
+    if( ( bytesRequested > 0 ) && ( pNetworkConnection->bufferedByteValid == true ) )
+    {
+        pBuffer[ 0 ] = pNetworkConnection->bufferedByte;
+        pNetworkConnection->bufferedByteValid = false;
+        bytesReceived = 1;
+    }
+
+    /* Block until the rest is there; a timeout is not the end of a packet. */
+    while( ( bytesReceived < bytesRequested ) &&
+           ( pNetworkConnection->closed == false ) &&
+           ( pNetworkConnection->peerClosed == false ) )
+    {
+        socketStatus = SOCKETS_Recv( pNetworkConnection->socket,
+                                     pBuffer + bytesReceived,
+                                     bytesRequested - bytesReceived,
+                                     0 );
+
+        if( socketStatus < 0 )
+        {
+            pNetworkConnection->peerClosed = true;
+        }
+        else
+        {
+            bytesReceived += ( size_t ) socketStatus;
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _setReceiveCallback( void * pConnection,
+                                              IotNetworkReceiveCallback_t receiveCallback,
+                                              void * pContext )
+{
+    _networkConnection_t * pNetworkConnection = pConnection;
+
+    pNetworkConnection->pReceiveContext = pContext;
+    pNetworkConnection->receiveCallback = receiveCallback;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static IotNetworkError_t _destroy( void * pConnection )
+{
+    _networkConnection_t * pNetworkConnection = pConnection;
+
+    pNetworkConnection->closed = true;
+
+    if( xTaskGetCurrentTaskHandle() == pNetworkConnection->receiveTask )
+    {
+        /* The receive task frees the connection once the callback returns. */
+        pNetworkConnection->destroyed = true;
+
+        return IOT_NETWORK_SUCCESS;
+    }
+
+    ( void ) SOCKETS_Shutdown( pNetworkConnection->socket, SOCKETS_SHUT_RDWR );
+    ( void ) xSemaphoreTake( pNetworkConnection->receiveTaskExited, portMAX_DELAY );
+    ( void ) SOCKETS_Close( pNetworkConnection->socket );
+    vSemaphoreDelete( pNetworkConnection->receiveTaskExited );
+    vPortFree( pNetworkConnection );
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+const IotNetworkInterface_t IotNetworkAfr =
+{
+    .create             = _create,
+    .close              = _close,
+    .send               = _send,
+    .receive            = _receive,
+    .setReceiveCallback = _setReceiveCallback,
+    .destroy            = _destroy
+};
@@ -0,0 +1,284 @@
+/*
+ * platform_posix.c: the platform layer of the IoT SDK on the host (clock,
+ * threads, semaphores, mutexes and logging), over the kernel port of
+ * freertos_posix.c so that SDK threads are tasks like any other.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+#include "iot_demo_logging.h"
+
+/* Arguments of a detached thread, until it starts. */
+typedef struct _threadInfo
+{
+    IotThreadRoutine_t threadRoutine;
+    void * pArgument;
+} _threadInfo_t;
+
+static pthread_mutex_t _logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*-----------------------------------------------------------*/
+
+uint64_t IotClock_GetTimeMs( void )
+{
+    return ( uint64_t ) xTaskGetTickCount();
+}
+
+/*-----------------------------------------------------------*/
+
+void IotClock_SleepMs( uint32_t sleepTimeMs )
+{
+    vTaskDelay( pdMS_TO_TICKS( sleepTimeMs ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotClock_GetTimestring( char * pBuffer,
+                             size_t bufferSize,
+                             size_t * pTimestringLength )
+{
+    int length = snprintf( pBuffer, bufferSize, "%u", ( unsigned ) xTaskGetTickCount() );
+
+    if( ( length < 0 ) || ( ( size_t ) length >= bufferSize ) )
+    {
+        return false;
+    }
+
+    *pTimestringLength = ( size_t ) length;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _threadRoutineWrapper( void * pArgument )
+{
+    _threadInfo_t threadInfo = *( _threadInfo_t * ) pArgument;
+
+    vPortFree( pArgument );
+    threadInfo.threadRoutine( threadInfo.pArgument );
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+bool Iot_CreateDetachedThread( IotThreadRoutine_t threadRoutine,
+                               void * pArgument,
+                               int32_t priority,
+                               size_t stackSize )
+{
+    _threadInfo_t * pThreadInfo = pvPortMalloc( sizeof( _threadInfo_t ) );
+
+    if( pThreadInfo == NULL )
+    {
+        return false;
+    }
+
+    pThreadInfo->threadRoutine = threadRoutine;
+    pThreadInfo->pArgument = pArgument;
+
+    if( xTaskCreate( _threadRoutineWrapper,
+                     "iot_thread",
+                     ( uint32_t ) stackSize,
+                     pThreadInfo,
+                     ( UBaseType_t ) priority,
+                     NULL ) != pdPASS )
+    {
+        vPortFree( pThreadInfo );
+
+        return false;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMutex_Create( IotMutex_t * pNewMutex,
+                      bool recursive )
+{
+    pthread_mutexattr_t attributes;
+    bool status;
+
+    pthread_mutexattr_init( &attributes );
+    pthread_mutexattr_settype( &attributes,
+                               ( recursive == true ) ? PTHREAD_MUTEX_RECURSIVE : PTHREAD_MUTEX_NORMAL );
+    status = ( pthread_mutex_init( pNewMutex, &attributes ) == 0 );
+    pthread_mutexattr_destroy( &attributes );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMutex_Destroy( IotMutex_t * pMutex )
+{
+    pthread_mutex_destroy( pMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMutex_Lock( IotMutex_t * pMutex )
+{
+    pthread_mutex_lock( pMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMutex_Unlock( IotMutex_t * pMutex )
+{
+    pthread_mutex_unlock( pMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotSemaphore_Create( IotSemaphore_t * pNewSemaphore,
+                          uint32_t initialValue,
+                          uint32_t maxValue )
+{
+    pthread_condattr_t attributes;
+
+    if( initialValue > maxValue )
+    {
+        return false;
+    }
+
+    pthread_condattr_init( &attributes );
+    pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+    pthread_mutex_init( &( pNewSemaphore->mutex ), NULL );
+    pthread_cond_init( &( pNewSemaphore->posted ), &attributes );
+    pthread_condattr_destroy( &attributes );
+
+    pNewSemaphore->count = initialValue;
+    pNewSemaphore->maxValue = maxValue;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotSemaphore_Destroy( IotSemaphore_t * pSemaphore )
+{
+    pthread_cond_destroy( &( pSemaphore->posted ) );
+    pthread_mutex_destroy( &( pSemaphore->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t IotSemaphore_GetCount( IotSemaphore_t * pSemaphore )
+{
+    uint32_t count;
+
+    pthread_mutex_lock( &( pSemaphore->mutex ) );
+    count = pSemaphore->count;
+    pthread_mutex_unlock( &( pSemaphore->mutex ) );
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotSemaphore_Wait( IotSemaphore_t * pSemaphore )
+{
+    pthread_mutex_lock( &( pSemaphore->mutex ) );
+
+    while( pSemaphore->count == 0 )
+    {
+        pthread_cond_wait( &( pSemaphore->posted ), &( pSemaphore->mutex ) );
+    }
+
+    pSemaphore->count--;
+    pthread_mutex_unlock( &( pSemaphore->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotSemaphore_TryWait( IotSemaphore_t * pSemaphore )
+{
+    return IotSemaphore_TimedWait( pSemaphore, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotSemaphore_TimedWait( IotSemaphore_t * pSemaphore,
+                             uint32_t timeoutMs )
+{
+    struct timespec deadline;
+    bool status = false;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &deadline );
+    deadline.tv_sec += ( time_t ) ( timeoutMs / 1000U );
+    deadline.tv_nsec += ( long ) ( timeoutMs % 1000U ) * 1000000L;
+
+    if( deadline.tv_nsec >= 1000000000L )
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock( &( pSemaphore->mutex ) );
+
+    while( ( pSemaphore->count == 0 ) && ( timeoutMs > 0 ) )
+    {
+        if( pthread_cond_timedwait( &( pSemaphore->posted ), &( pSemaphore->mutex ), &deadline ) == ETIMEDOUT )
+        {
+            break;
+        }
+    }
+
+    if( pSemaphore->count > 0 )
+    {
+        pSemaphore->count--;
+        status = true;
+    }
+
+    pthread_mutex_unlock( &( pSemaphore->mutex ) );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotSemaphore_Post( IotSemaphore_t * pSemaphore )
+{
+    pthread_mutex_lock( &( pSemaphore->mutex ) );
+
+    if( pSemaphore->count < pSemaphore->maxValue )
+    {
+        pSemaphore->count++;
+    }
+
+    pthread_cond_signal( &( pSemaphore->posted ) );
+    pthread_mutex_unlock( &( pSemaphore->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotLog_Host( const char * pLevel,
+                  const char * pFormat,
+                  ... )
+{
+    va_list arguments;
+
+    pthread_mutex_lock( &_logMutex );
+    printf( "[%s][%s][%u] ", pLevel, pcTaskGetTaskName( NULL ), ( unsigned ) xTaskGetTickCount() );
+
+    va_start( arguments, pFormat );
+    vprintf( pFormat, arguments );
+    va_end( arguments );
+
+    putchar( '\n' );
+    fflush( stdout );
+    pthread_mutex_unlock( &_logMutex );
+}
@@ -0,0 +1,543 @@
+/*
+ * sockets_posix.c: the secure sockets of Amazon FreeRTOS over POSIX TCP,
+ * with TLS through iot_tls.c once SOCKETS_SO_REQUIRE_TLS is set.
+ *
+ * As on the device, one task may receive while another sends. The TLS
+ * context of a socket is locked for each call into it, except while the
+ * receive side waits for bytes, so that a send is not held up by a receive
+ * waiting out its timeout.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+
+#include "aws_secure_sockets.h"
+#include "iot_tls.h"
+
+/* The timeouts a socket starts with, as socketsconfigDEFAULT_*_TIMEOUT. */
+#define socketsDEFAULT_RECV_TIMEOUT    pdMS_TO_TICKS( 10000 )
+#define socketsDEFAULT_SEND_TIMEOUT    pdMS_TO_TICKS( 10000 )
+
+typedef struct SSOCKETContext
+{
+    int iSocket;
+    BaseType_t xConnected;
+    BaseType_t xRequireTLS;
+    char * pcDestination;
+    char * pcServerCertificate;
+    uint32_t ulServerCertificateLength;
+    TickType_t xReceiveTimeout;
+    TickType_t xSendTimeout;
+    void * pvTLSContext;
+    pthread_mutex_t xTLSLock;
+} SSOCKETContext_t;
+
+/*-----------------------------------------------------------*/
+
+static int prvPollTimeout( TickType_t xTimeout )
+{
+    return ( xTimeout == portMAX_DELAY ) ? -1 : ( int ) ( xTimeout * portTICK_PERIOD_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Wait until the socket can be read.
+ *
+ * @return 1 if it can, 0 on timeout, negative on error.
+ */
+static int prvWaitReadable( SSOCKETContext_t * pxContext )
+{
+    struct pollfd xPoll = { .fd = pxContext->iSocket, .events = POLLIN };
+    int iReady;
+
+    do
+    {
+        iReady = poll( &xPoll, 1, prvPollTimeout( pxContext->xReceiveTimeout ) );
+    } while( ( iReady < 0 ) && ( errno == EINTR ) );
+
+    return iReady;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Receive at most xReceiveLength bytes: 0 on timeout, < 0 once closed. */
+static BaseType_t prvRecvFromSocket( SSOCKETContext_t * pxContext,
+                                     unsigned char * pucReceiveBuffer,
+                                     size_t xReceiveLength )
+{
+    ssize_t xReceived;
+    int iReady = prvWaitReadable( pxContext );
+
+    if( iReady <= 0 )
+    {
+        return ( iReady == 0 ) ? 0 : SOCKETS_SOCKET_ERROR;
+    }
+
+    do
+    {
+        xReceived = recv( pxContext->iSocket, pucReceiveBuffer, xReceiveLength, MSG_DONTWAIT );
+    } while( ( xReceived < 0 ) && ( errno == EINTR ) );
+
+    if( xReceived < 0 )
+    {
+        return ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) ? 0 : SOCKETS_SOCKET_ERROR;
+    }
+
+    return ( xReceived == 0 ) ? SOCKETS_ECLOSED : ( BaseType_t ) xReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSendToSocket( SSOCKETContext_t * pxContext,
+                                   const unsigned char * pucData,
+                                   size_t xDataLength )
+{
+    ssize_t xSent;
+    size_t xTotal = 0;
+
+    while( xTotal < xDataLength )
+    {
+        xSent = send( pxContext->iSocket, pucData + xTotal, xDataLength - xTotal, MSG_NOSIGNAL );
+
+        if( xSent < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+
+            /* EAGAIN is the send timeout. */
+            return ( xTotal > 0 ) ? ( BaseType_t ) xTotal :
+                   ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) ? 0 : SOCKETS_SOCKET_ERROR;
+        }
+
+        xTotal += ( size_t ) xSent;
+    }
+
+    return ( BaseType_t ) xTotal;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Receive for the TLS layer, which is called with the TLS lock held. */
+static BaseType_t prvNetworkRecv( void * pvContext,
+                                  unsigned char * pucReceiveBuffer,
+                                  size_t xReceiveLength )
+{
+    SSOCKETContext_t * pxContext = pvContext;
+    int iReady;
+
+    pthread_mutex_unlock( &( pxContext->xTLSLock ) );
+    iReady = prvWaitReadable( pxContext );
+    pthread_mutex_lock( &( pxContext->xTLSLock ) );
+
+    if( iReady <= 0 )
+    {
+        return ( iReady == 0 ) ? 0 : SOCKETS_SOCKET_ERROR;
+    }
+
+    return prvRecvFromSocket( pxContext, pucReceiveBuffer, xReceiveLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvNetworkSend( void * pvContext,
+                                  const unsigned char * pucData,
+                                  size_t xDataLength )
+{
+    return prvSendToSocket( pvContext, pucData, xDataLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvApplySendTimeout( SSOCKETContext_t * pxContext )
+{
+    struct timeval xTimeout = { 0 };
+    uint32_t ulMs = pxContext->xSendTimeout * portTICK_PERIOD_MS;
+
+    /* Zero is no timeout for the host as for FreeRTOS. */
+    if( pxContext->xSendTimeout != portMAX_DELAY )
+    {
+        xTimeout.tv_sec = ( time_t ) ( ulMs / 1000U );
+        xTimeout.tv_usec = ( suseconds_t ) ( ulMs % 1000U ) * 1000;
+    }
+
+    ( void ) setsockopt( pxContext->iSocket, SOL_SOCKET, SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t SOCKETS_Init( void )
+{
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+Socket_t SOCKETS_Socket( int32_t lDomain,
+                         int32_t lType,
+                         int32_t lProtocol )
+{
+    SSOCKETContext_t * pxContext;
+    int iNoDelay = 1;
+
+    if( ( lDomain != SOCKETS_AF_INET ) || ( lType != SOCKETS_SOCK_STREAM ) || ( lProtocol != SOCKETS_IPPROTO_TCP ) )
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    pxContext = pvPortMalloc( sizeof( SSOCKETContext_t ) );
+
+    if( pxContext == NULL )
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    memset( pxContext, 0x00, sizeof( SSOCKETContext_t ) );
+    pxContext->iSocket = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+    if( pxContext->iSocket < 0 )
+    {
+        vPortFree( pxContext );
+
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    /* lwIP sends small segments straight away too. */
+    ( void ) setsockopt( pxContext->iSocket, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof( iNoDelay ) );
+
+    pxContext->xReceiveTimeout = socketsDEFAULT_RECV_TIMEOUT;
+    pxContext->xSendTimeout = socketsDEFAULT_SEND_TIMEOUT;
+    pthread_mutex_init( &( pxContext->xTLSLock ), NULL );
+    prvApplySendTimeout( pxContext );
+
+    return pxContext;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Connect( Socket_t xSocket,
+                         SocketsSockaddr_t * pxAddress,
+                         Socklen_t xAddressLength )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+    struct sockaddr_in xAddress = { 0 };
+    TLSParams_t xTLSParams = { 0 };
+    char cAddress[ INET_ADDRSTRLEN ];
+    int32_t lStatus = SOCKETS_ERROR_NONE;
+    int iResult;
+
+    ( void ) xAddressLength;
+
+    if( ( pxContext == SOCKETS_INVALID_SOCKET ) || ( pxAddress == NULL ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    if( pxContext->xConnected == pdTRUE )
+    {
+        return SOCKETS_EISCONN;
+    }
+
+    xAddress.sin_family = AF_INET;
+    xAddress.sin_port = pxAddress->usPort;
+    xAddress.sin_addr.s_addr = pxAddress->ulAddress;
+
+    do
+    {
+        iResult = connect( pxContext->iSocket, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) );
+    } while( ( iResult < 0 ) && ( errno == EINTR ) );
+
+    if( iResult < 0 )
+    {
+        return SOCKETS_SOCKET_ERROR;
+    }
+
+    pxContext->xConnected = pdTRUE;
+
+    if( pxContext->xRequireTLS == pdTRUE )
+    {
+        xTLSParams.ulSize = sizeof( xTLSParams );
+        xTLSParams.pcDestination = pxContext->pcDestination;
+
+        /* The session is kept under the name sent, or else the address. */
+        xTLSParams.pcEndpoint = pxContext->pcDestination;
+        xTLSParams.usPort = ntohs( xAddress.sin_port );
+
+        if( xTLSParams.pcEndpoint == NULL )
+        {
+            xTLSParams.pcEndpoint = inet_ntop( AF_INET, &( xAddress.sin_addr ), cAddress, sizeof( cAddress ) );
+        }
+
+        xTLSParams.pcServerCertificate = pxContext->pcServerCertificate;
+        xTLSParams.ulServerCertificateLength = pxContext->ulServerCertificateLength;
+        xTLSParams.pvCallerContext = pxContext;
+        xTLSParams.pxNetworkRecv = prvNetworkRecv;
+        xTLSParams.pxNetworkSend = prvNetworkSend;
+
+        pthread_mutex_lock( &( pxContext->xTLSLock ) );
+
+        if( TLS_Init( &( pxContext->pvTLSContext ), &xTLSParams ) != pdFREERTOS_ERRNO_NONE )
+        {
+            lStatus = SOCKETS_TLS_INIT_ERROR;
+        }
+        else if( TLS_Connect( pxContext->pvTLSContext ) != 0 )
+        {
+            lStatus = SOCKETS_TLS_HANDSHAKE_ERROR;
+        }
+
+        pthread_mutex_unlock( &( pxContext->xTLSLock ) );
+    }
+
+    return lStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Recv( Socket_t xSocket,
+                      void * pvBuffer,
+                      size_t xBufferLength,
+                      uint32_t ulFlags )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+    BaseType_t xReceived;
+
+    ( void ) ulFlags;
+
+    if( ( pxContext == SOCKETS_INVALID_SOCKET ) || ( pvBuffer == NULL ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    if( pxContext->xConnected == pdFALSE )
+    {
+        return SOCKETS_ENOTCONN;
+    }
+
+    if( pxContext->xRequireTLS == pdFALSE )
+    {
+        xReceived = prvRecvFromSocket( pxContext, pvBuffer, xBufferLength );
+
+        return ( xReceived < 0 ) ? SOCKETS_ECLOSED : ( int32_t ) xReceived;
+    }
+
+    pthread_mutex_lock( &( pxContext->xTLSLock ) );
+    xReceived = TLS_Recv( pxContext->pvTLSContext, pvBuffer, xBufferLength );
+    pthread_mutex_unlock( &( pxContext->xTLSLock ) );
+
+    /* The peer closing, however it does, reads as closed. */
+    return ( xReceived < 0 ) ? SOCKETS_ECLOSED : ( int32_t ) xReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Send( Socket_t xSocket,
+                      const void * pvBuffer,
+                      size_t xDataLength,
+                      uint32_t ulFlags )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+    BaseType_t xSent;
+
+    ( void ) ulFlags;
+
+    if( ( pxContext == SOCKETS_INVALID_SOCKET ) || ( pvBuffer == NULL ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    if( pxContext->xConnected == pdFALSE )
+    {
+        return SOCKETS_ENOTCONN;
+    }
+
+    if( pxContext->xRequireTLS == pdFALSE )
+    {
+        xSent = prvSendToSocket( pxContext, pvBuffer, xDataLength );
+
+        return ( xSent < 0 ) ? SOCKETS_SOCKET_ERROR : ( int32_t ) xSent;
+    }
+
+    pthread_mutex_lock( &( pxContext->xTLSLock ) );
+    xSent = TLS_Send( pxContext->pvTLSContext, pvBuffer, xDataLength );
+    pthread_mutex_unlock( &( pxContext->xTLSLock ) );
+
+    return ( xSent < 0 ) ? SOCKETS_TLS_SEND_ERROR : ( int32_t ) xSent;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Shutdown( Socket_t xSocket,
+                          uint32_t ulHow )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+    int iHow = ( ulHow == SOCKETS_SHUT_RD ) ? SHUT_RD : ( ulHow == SOCKETS_SHUT_WR ) ? SHUT_WR : SHUT_RDWR;
+
+    if( pxContext == SOCKETS_INVALID_SOCKET )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    return ( shutdown( pxContext->iSocket, iHow ) == 0 ) ? SOCKETS_ERROR_NONE : SOCKETS_ENOTCONN;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_Close( Socket_t xSocket )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+
+    if( pxContext == SOCKETS_INVALID_SOCKET )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    TLS_Cleanup( pxContext->pvTLSContext );
+    ( void ) close( pxContext->iSocket );
+    pthread_mutex_destroy( &( pxContext->xTLSLock ) );
+    vPortFree( pxContext->pcDestination );
+    vPortFree( pxContext->pcServerCertificate );
+    vPortFree( pxContext );
+
+    return SOCKETS_ERROR_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+/* A copy of an option value, always NUL terminated. */
+static char * prvCopyOption( const void * pvOptionValue,
+                             size_t xOptionLength )
+{
+    char * pcCopy = pvPortMalloc( xOptionLength + 1 );
+
+    if( pcCopy != NULL )
+    {
+        memcpy( pcCopy, pvOptionValue, xOptionLength );
+        pcCopy[ xOptionLength ] = '\0';
+    }
+
+    return pcCopy;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
+                            int32_t lLevel,
+                            int32_t lOptionName,
+                            const void * pvOptionValue,
+                            size_t xOptionLength )
+{
+    SSOCKETContext_t * pxContext = xSocket;
+
+    ( void ) lLevel;
+
+    if( pxContext == SOCKETS_INVALID_SOCKET )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    switch( lOptionName )
+    {
+        case SOCKETS_SO_RCVTIMEO:
+            pxContext->xReceiveTimeout = *( const TickType_t * ) pvOptionValue;
+            break;
+
+        case SOCKETS_SO_SNDTIMEO:
+            pxContext->xSendTimeout = *( const TickType_t * ) pvOptionValue;
+            prvApplySendTimeout( pxContext );
+            break;
+
+        case SOCKETS_SO_NONBLOCK:
+            pxContext->xReceiveTimeout = 0;
+            pxContext->xSendTimeout = 0;
+            prvApplySendTimeout( pxContext );
+            break;
+
+        case SOCKETS_SO_SERVER_NAME_INDICATION:
+
+            if( pxContext->xConnected == pdTRUE )
+            {
+                return SOCKETS_EISCONN;
+            }
+
+            vPortFree( pxContext->pcDestination );
+            pxContext->pcDestination = prvCopyOption( pvOptionValue, xOptionLength );
+
+            if( pxContext->pcDestination == NULL )
+            {
+                return SOCKETS_ENOMEM;
+            }
+
+            break;
+
+        case SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE:
+
+            if( pxContext->xConnected == pdTRUE )
+            {
+                return SOCKETS_EISCONN;
+            }
+
+            /* The length counts the terminator of a PEM certificate. */
+            vPortFree( pxContext->pcServerCertificate );
+            pxContext->pcServerCertificate = prvCopyOption( pvOptionValue, xOptionLength );
+            pxContext->ulServerCertificateLength = ( uint32_t ) xOptionLength;
+
+            if( pxContext->pcServerCertificate == NULL )
+            {
+                return SOCKETS_ENOMEM;
+            }
+
+            break;
+
+        case SOCKETS_SO_REQUIRE_TLS:
+
+            if( pxContext->xConnected == pdTRUE )
+            {
+                return SOCKETS_EISCONN;
+            }
+
+            pxContext->xRequireTLS = pdTRUE;
+            break;
+
+        default:
+
+            return SOCKETS_ENOPROTOOPT;
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SOCKETS_GetHostByName( const char * pcHostName )
+{
+    struct addrinfo xHints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo * pxResult = NULL;
+    uint32_t ulAddress = 0;
+
+    if( ( getaddrinfo( pcHostName, NULL, &xHints, &pxResult ) == 0 ) && ( pxResult != NULL ) )
+    {
+        ulAddress = ( ( struct sockaddr_in * ) pxResult->ai_addr )->sin_addr.s_addr;
+    }
+
+    if( pxResult != NULL )
+    {
+        freeaddrinfo( pxResult );
+    }
+
+    return ulAddress;
+}
@@ -0,0 +1,572 @@
+/*
+ * cmd_dispatch_check - check the command dispatcher of the demos on
+ * well-formed, malformed, truncated and nested payloads.
+ *
+ * The dispatcher (driver/cmd_dispatch.h) is compiled into this program with
+ * a table like the demo's: period_ms, qos, led and deadband, whose handlers
+ * check their values and count their calls. Each payload is copied into a
+ * buffer of its exact length, so that a read past the end is caught when
+ * built with -fsanitize=address. The checks:
+ *
+ *     - payloads with known results: keys applied, rejected and unknown,
+ *       a key given twice, nested values and brackets inside strings;
+ *     - every prefix of every well-formed payload, and a set of malformed
+ *       ones, must be reported malformed with no handler called;
+ *     - -n random mutations of the well-formed payloads: a payload reported
+ *       malformed must not have called a handler, and one that is not must
+ *       give the same result as the payload scanned a second time;
+ *     - CmdDispatch_ToFixed on scales, signs, dropped digits and the bounds
+ *       of int32_t;
+ *     - CmdDispatch_FormatAck whole, and into buffers too short for it.
+ *
+ * Any failure is printed and the program exits with status 1.
+ *
+ * Build:
+ *     cc -O2 -g -fsanitize=address,undefined \
+ *         -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o cmd_dispatch_check cmd_dispatch_check.c
+ *
+ * Examples:
+ *     ./cmd_dispatch_check
+ *     ./cmd_dispatch_check -n 10000000 -s 7
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/cmd_dispatch.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/cmd_dispatch.c"
+
+#define ENTRY_PERIOD      ( 1UL << 0 )
+#define ENTRY_QOS         ( 1UL << 1 )
+#define ENTRY_LED         ( 1UL << 2 )
+#define ENTRY_DEADBAND    ( 1UL << 3 )
+
+/*-----------------------------------------------------------*/
+
+static uint32_t randomState = 1;
+static unsigned failures;
+
+/* The settings, as the demo keeps them, and the handler calls. */
+static int32_t periodMs = 3000;
+static int32_t qos = 1;
+static bool ledOn = false;
+static int32_t deadbandTenths = 0;
+static unsigned calls;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( void )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static void fail( const char * pPayload,
+                  size_t length,
+                  const char * pWhat )
+{
+    if( failures++ < 20 )
+    {
+        printf( "FAIL %.*s: %s\n", ( int ) length, pPayload, pWhat );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool applyPeriod( const CmdValue_t * pValue )
+{
+    int32_t value;
+
+    calls++;
+
+    if( ( CmdDispatch_ToFixed( pValue, 1, &value ) == false ) || ( value < 2000 ) || ( value > 3600000 ) )
+    {
+        return false;
+    }
+
+    periodMs = value;
+
+    return true;
+}
+
+static bool applyQos( const CmdValue_t * pValue )
+{
+    int32_t value;
+
+    calls++;
+
+    if( ( CmdDispatch_ToFixed( pValue, 1, &value ) == false ) || ( value < 0 ) || ( value > 1 ) )
+    {
+        return false;
+    }
+
+    qos = value;
+
+    return true;
+}
+
+static bool applyLed( const CmdValue_t * pValue )
+{
+    calls++;
+
+    if( CmdDispatch_IsString( pValue, "on" ) )
+    {
+        ledOn = true;
+    }
+    else if( CmdDispatch_IsString( pValue, "off" ) )
+    {
+        ledOn = false;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static bool applyDeadband( const CmdValue_t * pValue )
+{
+    int32_t value;
+
+    calls++;
+
+    if( ( CmdDispatch_ToFixed( pValue, 10, &value ) == false ) || ( value < 0 ) || ( value > 1000 ) )
+    {
+        return false;
+    }
+
+    deadbandTenths = value;
+
+    return true;
+}
+
+static int reportPeriod( char * pBuffer,
+                         size_t length )
+{
+    return snprintf( pBuffer, length, "%ld", ( long ) periodMs );
+}
+
+static int reportLed( char * pBuffer,
+                      size_t length )
+{
+    return snprintf( pBuffer, length, "\"%s\"", ledOn ? "on" : "off" );
+}
+
+static int reportDeadband( char * pBuffer,
+                           size_t length )
+{
+    return snprintf( pBuffer, length, "%ld.%ld", ( long ) ( deadbandTenths / 10 ), ( long ) ( deadbandTenths % 10 ) );
+}
+
+static const CmdEntry_t table[] =
+{
+    cmddispatchENTRY( "period_ms", applyPeriod,   reportPeriod   ),
+    cmddispatchENTRY( "qos",       applyQos,      NULL           ),
+    cmddispatchENTRY( "led",       applyLed,      reportLed      ),
+    cmddispatchENTRY( "deadband",  applyDeadband, reportDeadband )
+};
+
+#define ENTRIES    ( sizeof( table ) / sizeof( table[ 0 ] ) )
+
+/*-----------------------------------------------------------*/
+
+static void resetSettings( void )
+{
+    periodMs = 3000;
+    qos = 1;
+    ledOn = false;
+    deadbandTenths = 0;
+    calls = 0;
+}
+
+/* Run a payload from a buffer of its exact length. */
+static bool run( const char * pPayload,
+                 size_t length,
+                 CmdResult_t * pResult )
+{
+    char * pCopy = malloc( length ? length : 1 );
+    bool found;
+
+    if( pCopy == NULL )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 2 );
+    }
+
+    memcpy( pCopy, pPayload, length );
+    found = CmdDispatch_Run( table, ENTRIES, pCopy, length, pResult );
+    free( pCopy );
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct Case
+{
+    const char * pPayload;
+    uint32_t applied;
+    uint32_t rejected;
+    uint32_t unknown;
+    unsigned calls;
+} Case_t;
+
+/* Well-formed payloads and what they must do. */
+static const Case_t wellFormed[] =
+{
+    { "{}",                                                   0,                                   0,              0, 0 },
+    { " { } ",                                                0,                                   0,              0, 0 },
+    { "{\"period_ms\":10000}",                                ENTRY_PERIOD,                        0,              0, 1 },
+    { "{\"period_ms\":2000,\"qos\":0,\"led\":\"on\",\"deadband\":0.5}",
+      ENTRY_PERIOD | ENTRY_QOS | ENTRY_LED | ENTRY_DEADBAND,  0,                                   0,              4 },
+    { "{ \"led\" : \"off\" ,\n\t\"qos\" : 1 }",               ENTRY_LED | ENTRY_QOS,               0,              0, 2 },
+    { "{\"period_ms\":1000}",                                 0,                                   ENTRY_PERIOD,   0, 1 },
+    { "{\"period_ms\":\"5000\"}",                             0,                                   ENTRY_PERIOD,   0, 1 },
+    { "{\"qos\":2,\"led\":\"blink\"}",                        0,                                   ENTRY_QOS | ENTRY_LED, 0, 2 },
+    { "{\"led\":\"o\\\"n\"}",                                 0,                                   ENTRY_LED,      0, 1 },
+    { "{\"deadband\":-0.1}",                                  0,                                   ENTRY_DEADBAND, 0, 1 },
+    { "{\"deadband\":100.0}",                                 ENTRY_DEADBAND,                      0,              0, 1 },
+    { "{\"deadband\":100.1}",                                 0,                                   ENTRY_DEADBAND, 0, 1 },
+    { "{\"qos\":5,\"qos\":0}",                                ENTRY_QOS,                           0,              0, 2 },
+    { "{\"qos\":0,\"qos\":5}",                                0,                                   ENTRY_QOS,      0, 2 },
+    { "{\"color\":\"red\",\"qos\":0}",                        ENTRY_QOS,                           0,              1, 1 },
+    { "{\"x\":{\"a\":[1,{\"b\":\"}]\"}],\"c\":null},\"qos\":0}", ENTRY_QOS,                       0,              1, 1 },
+    { "{\"x\":[[[[[[]]]]]],\"y\":true,\"z\":null}",           0,                                   0,              3, 0 },
+    { "{\"led\":{\"on\":true}}",                              0,                                   ENTRY_LED,      0, 1 },
+    { "{\"period_ms\":true}",                                  0,                                   ENTRY_PERIOD,   0, 1 },
+    { "{\"Qos\":0,\"qos \":0}",                               0,                                   0,              2, 0 }
+};
+
+/* Malformed payloads: none may call a handler. */
+static const char * const malformed[] =
+{
+    "",
+    " ",
+    "[]",
+    "\"qos\":0",
+    "{\"period_ms\":2000,\"qos\":",
+    "{\"period_ms\":2000,\"qos\":0",
+    "{\"period_ms\":2000,\"qos\":0,",
+    "{\"period_ms\":2000,\"qos\":0,}",
+    "{\"period_ms\":2000 \"qos\":0}",
+    "{\"period_ms\" 2000}",
+    "{period_ms:2000}",
+    "{\"period_ms\":}",
+    "{\"period_ms\":2000,,\"qos\":0}",
+    "{,\"qos\":0}",
+    "{\"qos\":0}}",
+    "{\"led\":\"on}",
+    "{\"led\":\"on\\\"}",
+    "{\"x\":{\"a\":[1,2}",
+    "{\"x\":[\"]\"}",
+    "{\"x\":{\"y\":\"}\",\"qos\":0}",
+    "{\"qos\":0]"
+};
+
+/*-----------------------------------------------------------*/
+
+static bool checkCases( void )
+{
+    CmdResult_t result;
+    size_t i, length, prefix;
+    bool found;
+    char what[ 160 ];
+
+    for( i = 0; i < sizeof( wellFormed ) / sizeof( wellFormed[ 0 ] ); i++ )
+    {
+        const Case_t * pCase = &( wellFormed[ i ] );
+
+        length = strlen( pCase->pPayload );
+        resetSettings();
+        found = run( pCase->pPayload, length, &result );
+
+        if( ( result.xMalformed == true ) || ( result.ulApplied != pCase->applied ) ||
+            ( result.ulRejected != pCase->rejected ) || ( result.ulUnknown != pCase->unknown ) ||
+            ( calls != pCase->calls ) || ( found != ( ( pCase->applied | pCase->rejected ) != 0 ) ) )
+        {
+            snprintf( what, sizeof( what ),
+                      "malformed %d applied %#lx rejected %#lx unknown %lu calls %u, expected %#lx %#lx %lu %u",
+                      result.xMalformed, ( unsigned long ) result.ulApplied, ( unsigned long ) result.ulRejected,
+                      ( unsigned long ) result.ulUnknown, calls, ( unsigned long ) pCase->applied,
+                      ( unsigned long ) pCase->rejected, ( unsigned long ) pCase->unknown, pCase->calls );
+            fail( pCase->pPayload, length, what );
+        }
+
+        /* Every truncation is malformed and applies nothing. Trailing
+         * blanks do not count as the end being cut off. */
+        while( ( length > 0 ) && ( pCase->pPayload[ length - 1 ] == ' ' ) )
+        {
+            length--;
+        }
+
+        for( prefix = 0; prefix < length; prefix++ )
+        {
+            resetSettings();
+
+            if( ( run( pCase->pPayload, prefix, &result ) == true ) || ( result.xMalformed == false ) ||
+                ( calls != 0 ) || ( periodMs != 3000 ) || ( qos != 1 ) || ( ledOn == true ) || ( deadbandTenths != 0 ) )
+            {
+                fail( pCase->pPayload, prefix, "a truncation was not rejected whole" );
+            }
+        }
+    }
+
+    for( i = 0; i < sizeof( malformed ) / sizeof( malformed[ 0 ] ); i++ )
+    {
+        resetSettings();
+        found = run( malformed[ i ], strlen( malformed[ i ] ), &result );
+
+        if( ( found == true ) || ( result.xMalformed == false ) || ( calls != 0 ) ||
+            ( result.ulApplied != 0 ) || ( result.ulRejected != 0 ) || ( result.ulUnknown != 0 ) )
+        {
+            fail( malformed[ i ], strlen( malformed[ i ] ), "not rejected whole" );
+        }
+    }
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Random mutations of the well-formed payloads. */
+static bool checkMutations( uint64_t count )
+{
+    static const char alphabet[] = "{}[]\",: \\0123456789.-qosledtrunfa";
+    CmdResult_t first, second;
+    char payload[ 128 ];
+    size_t length, edits, position;
+    unsigned firstCalls;
+    uint64_t n, rejected = 0;
+
+    for( n = 0; n < count; n++ )
+    {
+        const char * pSource = wellFormed[ nextRandom() % ( sizeof( wellFormed ) / sizeof( wellFormed[ 0 ] ) ) ].pPayload;
+
+        length = strlen( pSource );
+        memcpy( payload, pSource, length );
+
+        for( edits = 1 + nextRandom() % 3; edits > 0; edits-- )
+        {
+            position = nextRandom() % ( length + 1 );
+
+            switch( nextRandom() % 3 )
+            {
+                case 0: /* Replace. */
+
+                    if( position < length )
+                    {
+                        payload[ position ] = alphabet[ nextRandom() % ( sizeof( alphabet ) - 1 ) ];
+                    }
+
+                    break;
+
+                case 1: /* Insert. */
+
+                    if( length < sizeof( payload ) )
+                    {
+                        memmove( payload + position + 1, payload + position, length - position );
+                        payload[ position ] = alphabet[ nextRandom() % ( sizeof( alphabet ) - 1 ) ];
+                        length++;
+                    }
+
+                    break;
+
+                default: /* Cut. */
+                    length = position;
+                    break;
+            }
+        }
+
+        resetSettings();
+        ( void ) run( payload, length, &first );
+        firstCalls = calls;
+
+        if( first.xMalformed == true )
+        {
+            rejected++;
+
+            if( ( calls != 0 ) || ( first.ulApplied != 0 ) || ( first.ulRejected != 0 ) || ( first.ulUnknown != 0 ) )
+            {
+                fail( payload, length, "malformed but a handler was called" );
+            }
+
+            continue;
+        }
+
+        /* Accepted: scanning it again gives the same result. */
+        calls = 0;
+        ( void ) run( payload, length, &second );
+
+        if( ( second.xMalformed == true ) || ( second.ulApplied != first.ulApplied ) ||
+            ( second.ulRejected != first.ulRejected ) || ( second.ulUnknown != first.ulUnknown ) ||
+            ( calls != firstCalls ) )
+        {
+            fail( payload, length, "a second scan gave another result" );
+        }
+    }
+
+    printf( "mutations: %llu, %llu rejected as malformed\n",
+            ( unsigned long long ) count, ( unsigned long long ) rejected );
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct FixedCase
+{
+    const char * pText;
+    CmdValueType_t type;
+    uint32_t scale;
+    bool ok;
+    int32_t expected;
+} FixedCase_t;
+
+static bool checkToFixed( void )
+{
+    static const FixedCase_t cases[] =
+    {
+        { "0",                       eCmdValueNumber, 1,    true,  0           },
+        { "0.55",                    eCmdValueNumber, 10,   true,  5           },
+        { "-1.25",                   eCmdValueNumber, 100,  true,  -125        },
+        { "1.",                      eCmdValueNumber, 10,   true,  10          },
+        { ".5",                      eCmdValueNumber, 10,   true,  5           },
+        { "-0.09",                   eCmdValueNumber, 10,   true,  0           },
+        { "0.123456789012345678901", eCmdValueNumber, 1000, true,  123         },
+        { "2147483647",              eCmdValueNumber, 1,    true,  INT32_MAX   },
+        { "-2147483647",             eCmdValueNumber, 1,    true,  -INT32_MAX  },
+        { "214748364.7",             eCmdValueNumber, 10,   true,  INT32_MAX   },
+        { "2147483648",              eCmdValueNumber, 1,    false, 0           },
+        { "-2147483648",             eCmdValueNumber, 1,    false, 0           },
+        { "214748364.8",             eCmdValueNumber, 10,   false, 0           },
+        { "214748365",               eCmdValueNumber, 10,   false, 0           },
+        { "99999999999999999999999", eCmdValueNumber, 1,    false, 0           },
+        { "-",                       eCmdValueNumber, 1,    false, 0           },
+        { ".",                       eCmdValueNumber, 10,   false, 0           },
+        { "-.",                      eCmdValueNumber, 10,   false, 0           },
+        { "1.2.3",                   eCmdValueNumber, 10,   false, 0           },
+        { "1e3",                     eCmdValueNumber, 1,    false, 0           },
+        { "--1",                     eCmdValueNumber, 1,    false, 0           },
+        { "12a",                     eCmdValueNumber, 1,    false, 0           },
+        { "5",                       eCmdValueString, 1,    false, 0           },
+        { "true",                    eCmdValueLiteral, 1,   false, 0           }
+    };
+    CmdValue_t value;
+    int32_t result;
+    bool ok;
+    size_t i;
+    char what[ 96 ];
+
+    for( i = 0; i < sizeof( cases ) / sizeof( cases[ 0 ] ); i++ )
+    {
+        value.xType = cases[ i ].type;
+        value.pcText = cases[ i ].pText;
+        value.xLength = strlen( cases[ i ].pText );
+        result = 12345;
+        ok = CmdDispatch_ToFixed( &value, cases[ i ].scale, &result );
+
+        if( ( ok != cases[ i ].ok ) || ( ok && ( result != cases[ i ].expected ) ) || ( !ok && ( result != 12345 ) ) )
+        {
+            snprintf( what, sizeof( what ), "ToFixed at scale %lu gives %d, %ld",
+                      ( unsigned long ) cases[ i ].scale, ok, ( long ) result );
+            fail( cases[ i ].pText, value.xLength, what );
+        }
+    }
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkAck( void )
+{
+    static const char payload[] = "{\"period_ms\":10000,\"qos\":0,\"deadband\":200,\"color\":1}";
+    static const char expected[] =
+        "{\"applied\":[\"period_ms\",\"qos\"],\"rejected\":[\"deadband\"],\"unknown\":1,"
+        "\"settings\":{\"period_ms\":10000,\"led\":\"off\",\"deadband\":0.0}}";
+    CmdResult_t result;
+    char buffer[ 256 ];
+    size_t length, size;
+
+    resetSettings();
+    ( void ) run( payload, sizeof( payload ) - 1, &result );
+    length = CmdDispatch_FormatAck( table, ENTRIES, &result, buffer, sizeof( buffer ) );
+
+    if( ( length != sizeof( expected ) - 1 ) || ( strcmp( buffer, expected ) != 0 ) )
+    {
+        fail( buffer, strlen( buffer ), "is not the expected ack" );
+    }
+
+    /* Too short by any amount: nothing is written. */
+    for( size = 1; size <= sizeof( expected ) - 1; size++ )
+    {
+        memset( buffer, 'x', sizeof( buffer ) );
+
+        if( ( CmdDispatch_FormatAck( table, ENTRIES, &result, buffer, size ) != 0 ) || ( buffer[ 0 ] != '\0' ) )
+        {
+            fail( expected, size, "an ack that did not fit was written" );
+        }
+    }
+
+    /* A malformed payload is acked as such. */
+    ( void ) run( "{\"qos\":", 7, &result );
+    length = CmdDispatch_FormatAck( table, ENTRIES, &result, buffer, sizeof( buffer ) );
+
+    if( ( length == 0 ) || ( strstr( buffer, "\"applied\":[],\"rejected\":[]" ) == NULL ) ||
+        ( strstr( buffer, "\"error\":\"malformed\"" ) == NULL ) )
+    {
+        fail( buffer, strlen( buffer ), "is not the ack of a malformed payload" );
+    }
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    uint64_t mutations = 1000000;
+    int option;
+    bool ok;
+
+    while( ( option = getopt( argc, argv, "n:s:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                mutations = strtoull( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                randomState = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n mutations] [-s seed]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    ok = checkCases();
+    ok = checkToFixed() && ok;
+    ok = checkAck() && ok;
+    ok = checkMutations( mutations ) && ok;
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+
+    return ok ? 0 : 1;
+}
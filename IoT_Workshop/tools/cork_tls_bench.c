@@ -0,0 +1,471 @@
+/*
+ * cork_tls_bench - bytes on the wire and sender CPU per MQTT PUBLISH when
+ * packets are coalesced into TLS records, as the Lab1 MQTT demo does with
+ * IOT_DEMO_MQTT_CORK (see demos/mqtt/iot_demo_cork.h).
+ *
+ * A client and a server thread talk TLS 1.2 over a loopback TCP connection
+ * with the cipher of AWS IoT (AES-128-GCM; PSK instead of certificates, so
+ * no key files are needed and the records are the same). The client sends
+ * the same QoS 1 PUBLISH packets as the demo, to its topic and with its
+ * payload, grouping them into one SSL_write per group:
+ *
+ *     group 1    one record per packet, as without corking
+ *     group k    up to k packets per record, never more than the cork
+ *                buffer (1400 bytes) in one record
+ *
+ * Measured for each group size:
+ *     tls bytes    bytes written to the socket per message: MQTT packets,
+ *                  TLS record headers, nonces and tags
+ *     wire bytes   tls bytes plus 40 bytes of IPv4 and TCP headers per
+ *                  1436 byte segment, the ESP32's MSS, each record in
+ *                  segments of its own (the loopback MSS is far larger)
+ *     cpu ns       CPU time of the sending thread per message: record
+ *                  encryption and authentication and the socket write
+ *
+ * Host CPU times are not ESP32 times, but the share of the per-record cost
+ * is what corking removes, and it shows here.
+ *
+ * Build:
+ *     cc -O2 -pthread -o cork_tls_bench cork_tls_bench.c -lssl -lcrypto
+ *
+ * Examples:
+ *     ./cork_tls_bench
+ *     ./cork_tls_bench -n 200000 -g 1 -g 4 -g 16
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Same topic and payload as the demo. */
+#define TOPIC                 "iotdemo/topic/pub"
+#define DHT_PAYLOAD_FORMAT    "{\"Humidity\":%.1f,\"Temperature\":%.1f}"
+
+#define CORK_BUFFER_SIZE      1400
+#define DEVICE_MSS            1436
+#define TCP_IP_OVERHEAD       40
+#define TLS_RECORD_OVERHEAD   ( 5 + 8 + 16 )
+#define MAX_GROUPS            16
+#define PACKET_SIZE           128
+
+/*-----------------------------------------------------------*/
+
+static const unsigned char psk[ 16 ] = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE,
+                                         0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+
+/*-----------------------------------------------------------*/
+
+static unsigned int clientPsk( SSL * pSsl,
+                               const char * pHint,
+                               char * pIdentity,
+                               unsigned int maxIdentityLength,
+                               unsigned char * pPsk,
+                               unsigned int maxPskLength )
+{
+    ( void ) pSsl;
+    ( void ) pHint;
+
+    if( ( maxIdentityLength < 8 ) || ( maxPskLength < sizeof( psk ) ) )
+    {
+        return 0;
+    }
+
+    strcpy( pIdentity, "device" );
+    memcpy( pPsk, psk, sizeof( psk ) );
+
+    return sizeof( psk );
+}
+
+static unsigned int serverPsk( SSL * pSsl,
+                               const char * pIdentity,
+                               unsigned char * pPsk,
+                               unsigned int maxPskLength )
+{
+    ( void ) pSsl;
+    ( void ) pIdentity;
+
+    if( maxPskLength < sizeof( psk ) )
+    {
+        return 0;
+    }
+
+    memcpy( pPsk, psk, sizeof( psk ) );
+
+    return sizeof( psk );
+}
+
+/*-----------------------------------------------------------*/
+
+static SSL_CTX * newContext( bool server )
+{
+    SSL_CTX * pContext = SSL_CTX_new( server ? TLS_server_method() : TLS_client_method() );
+
+    if( pContext == NULL )
+    {
+        return NULL;
+    }
+
+    SSL_CTX_set_min_proto_version( pContext, TLS1_2_VERSION );
+    SSL_CTX_set_max_proto_version( pContext, TLS1_2_VERSION );
+
+    if( SSL_CTX_set_cipher_list( pContext, "PSK-AES128-GCM-SHA256" ) != 1 )
+    {
+        SSL_CTX_free( pContext );
+
+        return NULL;
+    }
+
+    if( server )
+    {
+        SSL_CTX_set_psk_server_callback( pContext, serverPsk );
+    }
+    else
+    {
+        SSL_CTX_set_psk_client_callback( pContext, clientPsk );
+    }
+
+    return pContext;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The broker side: read and discard until the client closes. */
+static void * serverThread( void * pArgument )
+{
+    SSL * pSsl = pArgument;
+    char buffer[ 16384 ];
+
+    if( SSL_accept( pSsl ) == 1 )
+    {
+        while( SSL_read( pSsl, buffer, sizeof( buffer ) ) > 0 )
+        {
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t putRemainingLength( uint8_t * pBuffer,
+                                  size_t length )
+{
+    size_t i = 0;
+
+    do
+    {
+        pBuffer[ i ] = ( uint8_t ) ( length & 0x7F );
+        length >>= 7;
+
+        if( length > 0 )
+        {
+            pBuffer[ i ] |= 0x80;
+        }
+
+        i++;
+    } while( length > 0 );
+
+    return i;
+}
+
+/* A QoS 1 PUBLISH of one reading, as the demo sends it. */
+static size_t makePublish( uint8_t * pPacket,
+                           uint16_t packetIdentifier,
+                           unsigned reading )
+{
+    char payload[ 64 ];
+    int payloadLength = snprintf( payload, sizeof( payload ), DHT_PAYLOAD_FORMAT,
+                                  40.0 + ( reading % 200 ) / 10.0, 20.0 + ( reading % 70 ) / 10.0 );
+    size_t topicLength = sizeof( TOPIC ) - 1, length = 0;
+
+    pPacket[ length++ ] = 0x32;
+    length += putRemainingLength( pPacket + length, 2 + topicLength + 2 + ( size_t ) payloadLength );
+    pPacket[ length++ ] = ( uint8_t ) ( topicLength >> 8 );
+    pPacket[ length++ ] = ( uint8_t ) ( topicLength & 0xFF );
+    memcpy( pPacket + length, TOPIC, topicLength );
+    length += topicLength;
+    pPacket[ length++ ] = ( uint8_t ) ( packetIdentifier >> 8 );
+    pPacket[ length++ ] = ( uint8_t ) ( packetIdentifier & 0xFF );
+    memcpy( pPacket + length, payload, ( size_t ) payloadLength );
+
+    return length + ( size_t ) payloadLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t threadCpuNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct Result
+{
+    uint64_t records;
+    uint64_t tlsBytes;
+    uint64_t wireBytes;
+    uint64_t cpuNs;
+} Result_t;
+
+/* Open a TLS connection over loopback TCP and send `messages` PUBLISHes in
+ * groups of up to `group`. */
+static bool run( SSL_CTX * pClientContext,
+                 SSL_CTX * pServerContext,
+                 long messages,
+                 int group,
+                 Result_t * pResult )
+{
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl( INADDR_LOOPBACK ) };
+    socklen_t addressLength = sizeof( address );
+    int listener = socket( AF_INET, SOCK_STREAM, 0 ), client = -1, server = -1, one = 1;
+    SSL * pClient = NULL, * pServer = NULL;
+    pthread_t thread;
+    uint8_t buffer[ CORK_BUFFER_SIZE + PACKET_SIZE ], packet[ PACKET_SIZE ];
+    size_t held = 0, length = 0, record = 0;
+    uint64_t writtenBefore = 0, start = 0;
+    long i = 0;
+    int inGroup = 0;
+    bool ok = false;
+
+    memset( pResult, 0, sizeof( *pResult ) );
+
+    if( ( listener < 0 ) ||
+        ( bind( listener, ( struct sockaddr * ) &address, sizeof( address ) ) != 0 ) ||
+        ( listen( listener, 1 ) != 0 ) ||
+        ( getsockname( listener, ( struct sockaddr * ) &address, &addressLength ) != 0 ) )
+    {
+        perror( "listen" );
+        goto done;
+    }
+
+    client = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if( ( client < 0 ) || ( connect( client, ( struct sockaddr * ) &address, sizeof( address ) ) != 0 ) )
+    {
+        perror( "connect" );
+        goto done;
+    }
+
+    server = accept( listener, NULL, NULL );
+
+    /* Every record leaves at once, as the MQTT library's sends do. */
+    setsockopt( client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+    pClient = SSL_new( pClientContext );
+    pServer = SSL_new( pServerContext );
+    SSL_set_fd( pClient, client );
+    SSL_set_fd( pServer, server );
+
+    if( pthread_create( &thread, NULL, serverThread, pServer ) != 0 )
+    {
+        goto done;
+    }
+
+    if( SSL_connect( pClient ) != 1 )
+    {
+        ERR_print_errors_fp( stderr );
+        SSL_shutdown( pClient );
+        close( client );
+        client = -1;
+        pthread_join( thread, NULL );
+        goto done;
+    }
+
+    writtenBefore = BIO_number_written( SSL_get_wbio( pClient ) );
+    start = threadCpuNs();
+
+    for( i = 0; i <= messages; i++ )
+    {
+        length = ( i < messages ) ? makePublish( packet, ( uint16_t ) ( ( i % 65535 ) + 1 ), ( unsigned ) i ) : 0;
+
+        /* Write what is held when the group is complete, the next packet
+         * would overflow the cork buffer, or there is nothing more. */
+        if( ( held > 0 ) &&
+            ( ( inGroup == group ) || ( held + length > CORK_BUFFER_SIZE ) || ( length == 0 ) ) )
+        {
+            if( SSL_write( pClient, buffer, ( int ) held ) != ( int ) held )
+            {
+                ERR_print_errors_fp( stderr );
+                break;
+            }
+
+            record = held + TLS_RECORD_OVERHEAD;
+            pResult->records++;
+            pResult->wireBytes += record + ( ( record + DEVICE_MSS - 1 ) / DEVICE_MSS ) * TCP_IP_OVERHEAD;
+            held = 0;
+            inGroup = 0;
+        }
+
+        memcpy( buffer + held, packet, length );
+        held += length;
+        inGroup++;
+    }
+
+    pResult->cpuNs = threadCpuNs() - start;
+    pResult->tlsBytes = BIO_number_written( SSL_get_wbio( pClient ) ) - writtenBefore;
+    ok = ( i > messages );
+
+    SSL_shutdown( pClient );
+    shutdown( client, SHUT_WR );
+    pthread_join( thread, NULL );
+
+done:
+
+    if( pClient != NULL )
+    {
+        SSL_free( pClient );
+    }
+
+    if( pServer != NULL )
+    {
+        SSL_free( pServer );
+    }
+
+    if( client >= 0 )
+    {
+        close( client );
+    }
+
+    if( server >= 0 )
+    {
+        close( server );
+    }
+
+    if( listener >= 0 )
+    {
+        close( listener );
+    }
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+static void usage( const char * pName )
+{
+    fprintf( stderr,
+             "usage: %s [-n messages] [-g group size]...\n"
+             "  default: -n 100000 -g 1 -g 2 -g 4 -g 8 -g 16\n",
+             pName );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    int groups[ MAX_GROUPS ] = { 0 }, groupCount = 0, option = 0, i = 0;
+    long messages = 100000;
+    SSL_CTX * pClientContext = NULL, * pServerContext = NULL;
+    Result_t result, baseline = { 0 };
+
+    while( ( option = getopt( argc, argv, "n:g:h" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                messages = strtol( optarg, NULL, 0 );
+                break;
+
+            case 'g':
+
+                if( groupCount < MAX_GROUPS )
+                {
+                    groups[ groupCount++ ] = atoi( optarg );
+                }
+
+                break;
+
+            default:
+                usage( argv[ 0 ] );
+
+                return ( option == 'h' ) ? 0 : 2;
+        }
+    }
+
+    if( groupCount == 0 )
+    {
+        groups[ 0 ] = 1;
+        groups[ 1 ] = 2;
+        groups[ 2 ] = 4;
+        groups[ 3 ] = 8;
+        groups[ 4 ] = 16;
+        groupCount = 5;
+    }
+
+    for( i = 0; i < groupCount; i++ )
+    {
+        if( groups[ i ] < 1 )
+        {
+            usage( argv[ 0 ] );
+
+            return 2;
+        }
+    }
+
+    if( messages <= 0 )
+    {
+        usage( argv[ 0 ] );
+
+        return 2;
+    }
+
+    pClientContext = newContext( false );
+    pServerContext = newContext( true );
+
+    if( ( pClientContext == NULL ) || ( pServerContext == NULL ) )
+    {
+        fprintf( stderr, "TLS setup failed\n" );
+        ERR_print_errors_fp( stderr );
+
+        return 1;
+    }
+
+    printf( "topic %s, QoS 1, TLS 1.2 AES-128-GCM, %ld messages\n", TOPIC, messages );
+    printf( "%6s %9s %12s %12s %10s %9s\n",
+            "group", "records", "tls bytes", "wire bytes", "cpu ns", "cpu" );
+
+    for( i = 0; i < groupCount; i++ )
+    {
+        if( run( pClientContext, pServerContext, messages, groups[ i ], &result ) == false )
+        {
+            fprintf( stderr, "group %d: run failed\n", groups[ i ] );
+
+            return 1;
+        }
+
+        if( i == 0 )
+        {
+            baseline = result;
+        }
+
+        printf( "%6d %9llu %12.1f %12.1f %10.0f %8.2fx\n",
+                groups[ i ],
+                ( unsigned long long ) result.records,
+                ( double ) result.tlsBytes / messages,
+                ( double ) result.wireBytes / messages,
+                ( double ) result.cpuNs / messages,
+                ( double ) baseline.cpuNs / ( double ) result.cpuNs );
+    }
+
+    SSL_CTX_free( pClientContext );
+    SSL_CTX_free( pServerContext );
+
+    return 0;
+}
@@ -0,0 +1,694 @@
+/*
+ * dlog_decode - render deferred log records captured from a device.
+ *
+ * The driver component's deferred logger (driver/dlog.h) stores the address
+ * of each format string and the raw arguments. Built with dlogRAW_OUTPUT=1
+ * it writes every record to the console as a hex line:
+ *
+ *     DLOG <record bytes in hex>
+ *
+ * This tool reads a console capture, looks the format strings up in the
+ * application ELF (build/aws_demos.elf), and prints the lines the device
+ * would have printed. Other console lines are passed through unchanged so
+ * that ESP-IDF and IotLog output stays in place; -q drops them. With -b the
+ * input is a raw stream of records instead, e.g. a dump of the ring.
+ *
+ * The record layout is described in driver/dlog.h.
+ *
+ * Build:
+ *     cc -O2 -o dlog_decode dlog_decode.c
+ *
+ * Examples:
+ *     ./dlog_decode -e build/aws_demos.elf capture.log
+ *     ./dlog_decode -e build/aws_demos.elf -t -q < capture.log
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_MESSAGE       1
+#define RECORD_PADDING       2
+#define RECORD_PREFIX_SIZE   12
+#define MAX_RECORD_SIZE      65536
+#define MAX_LINE_LENGTH      ( 2 * MAX_RECORD_SIZE )
+
+/*-----------------------------------------------------------*/
+
+/* An allocated section of the ELF that holds data, such as .rodata. */
+typedef struct Section
+{
+    uint32_t address;
+    uint32_t size;
+    const uint8_t * pData;
+} Section_t;
+
+typedef enum
+{
+    ARG_NONE,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LONG_LONG,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER
+} Arg_t;
+
+/* One conversion of a format string; mirrors the device's parser. */
+typedef struct Conversion
+{
+    const char * pStart;
+    size_t length;
+    int stars;
+    char modifier;
+    char conversion;
+    Arg_t arg;
+} Conversion_t;
+
+static uint8_t * pElf = NULL;
+static Section_t * pSections = NULL;
+static size_t sectionCount = 0;
+static bool printTimestamps = false;
+static unsigned long unknownFormats = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t _read32( const uint8_t * p )
+{
+    return ( uint32_t ) p[ 0 ] | ( ( uint32_t ) p[ 1 ] << 8 ) |
+           ( ( uint32_t ) p[ 2 ] << 16 ) | ( ( uint32_t ) p[ 3 ] << 24 );
+}
+
+static uint16_t _read16( const uint8_t * p )
+{
+    return ( uint16_t ) ( p[ 0 ] | ( p[ 1 ] << 8 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _loadElf( const char * pPath )
+{
+    FILE * pFile = fopen( pPath, "rb" );
+    long size = 0;
+    uint32_t sectionOffset;
+    uint16_t entrySize, entryCount, i;
+
+    if( pFile == NULL )
+    {
+        perror( pPath );
+        return false;
+    }
+
+    fseek( pFile, 0, SEEK_END );
+    size = ftell( pFile );
+    fseek( pFile, 0, SEEK_SET );
+    pElf = malloc( ( size_t ) size );
+
+    if( ( pElf == NULL ) || ( fread( pElf, 1, ( size_t ) size, pFile ) != ( size_t ) size ) )
+    {
+        fprintf( stderr, "%s: read failed\n", pPath );
+        fclose( pFile );
+        return false;
+    }
+
+    fclose( pFile );
+
+    /* 32-bit little endian, as built for the ESP32. */
+    if( ( size < 52 ) || ( memcmp( pElf, "\177ELF", 4 ) != 0 ) || ( pElf[ 4 ] != 1 ) || ( pElf[ 5 ] != 1 ) )
+    {
+        fprintf( stderr, "%s: not a 32-bit little endian ELF file\n", pPath );
+        return false;
+    }
+
+    sectionOffset = _read32( pElf + 32 );
+    entrySize = _read16( pElf + 46 );
+    entryCount = _read16( pElf + 48 );
+
+    if( ( entrySize < 40 ) || ( ( uint64_t ) sectionOffset + ( uint64_t ) entrySize * entryCount > ( uint64_t ) size ) )
+    {
+        fprintf( stderr, "%s: bad section table\n", pPath );
+        return false;
+    }
+
+    pSections = calloc( entryCount, sizeof( Section_t ) );
+
+    for( i = 0; i < entryCount; i++ )
+    {
+        const uint8_t * pHeader = pElf + sectionOffset + ( size_t ) i * entrySize;
+        uint32_t type = _read32( pHeader + 4 );
+        uint32_t flags = _read32( pHeader + 8 );
+        uint32_t address = _read32( pHeader + 12 );
+        uint32_t offset = _read32( pHeader + 16 );
+        uint32_t sectionSize = _read32( pHeader + 20 );
+
+        /* SHT_PROGBITS sections with SHF_ALLOC. */
+        if( ( type == 1 ) && ( ( flags & 2 ) != 0 ) && ( sectionSize > 0 ) &&
+            ( ( uint64_t ) offset + sectionSize <= ( uint64_t ) size ) )
+        {
+            pSections[ sectionCount ].address = address;
+            pSections[ sectionCount ].size = sectionSize;
+            pSections[ sectionCount ].pData = pElf + offset;
+            sectionCount++;
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static const char * _lookupFormat( uint32_t address )
+{
+    size_t i;
+
+    for( i = 0; i < sectionCount; i++ )
+    {
+        if( ( address >= pSections[ i ].address ) &&
+            ( address - pSections[ i ].address < pSections[ i ].size ) )
+        {
+            const char * pFormat = ( const char * ) pSections[ i ].pData + ( address - pSections[ i ].address );
+            size_t remaining = pSections[ i ].size - ( address - pSections[ i ].address );
+
+            /* The string must end inside the section. */
+            return ( memchr( pFormat, '\0', remaining ) != NULL ) ? pFormat : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _parseConversion( const char * pFormat,
+                              Conversion_t * pConversion )
+{
+    const char * p = pFormat + 1;
+
+    memset( pConversion, 0, sizeof( Conversion_t ) );
+    pConversion->pStart = pFormat;
+
+    while( ( *p != '\0' ) && ( strchr( "-+ #0", *p ) != NULL ) )
+    {
+        p++;
+    }
+
+    if( *p == '*' )
+    {
+        pConversion->stars++;
+        p++;
+    }
+
+    while( ( *p >= '0' ) && ( *p <= '9' ) )
+    {
+        p++;
+    }
+
+    if( *p == '.' )
+    {
+        p++;
+
+        if( *p == '*' )
+        {
+            pConversion->stars++;
+            p++;
+        }
+
+        while( ( *p >= '0' ) && ( *p <= '9' ) )
+        {
+            p++;
+        }
+    }
+
+    if( ( ( p[ 0 ] == 'h' ) && ( p[ 1 ] == 'h' ) ) || ( ( p[ 0 ] == 'l' ) && ( p[ 1 ] == 'l' ) ) )
+    {
+        pConversion->modifier = ( p[ 0 ] == 'h' ) ? 'H' : 'q';
+        p += 2;
+    }
+    else if( ( *p != '\0' ) && ( strchr( "hljztL", *p ) != NULL ) )
+    {
+        pConversion->modifier = *p++;
+    }
+
+    pConversion->conversion = *p;
+
+    if( ( *p != '\0' ) && ( strchr( "diuxXoc", *p ) != NULL ) )
+    {
+        if( ( pConversion->modifier == 'q' ) || ( pConversion->modifier == 'j' ) )
+        {
+            pConversion->arg = ARG_LONG_LONG;
+        }
+        else if( ( pConversion->modifier == 'l' ) || ( pConversion->modifier == 'z' ) ||
+                 ( pConversion->modifier == 't' ) )
+        {
+            pConversion->arg = ARG_LONG;
+        }
+        else
+        {
+            pConversion->arg = ARG_INT;
+        }
+    }
+    else if( ( *p != '\0' ) && ( strchr( "fFeEgGaA", *p ) != NULL ) )
+    {
+        pConversion->arg = ARG_DOUBLE;
+    }
+    else if( *p == 's' )
+    {
+        pConversion->arg = ARG_STRING;
+    }
+    else if( *p == 'p' )
+    {
+        pConversion->arg = ARG_POINTER;
+    }
+    else
+    {
+        pConversion->arg = ARG_NONE;
+        pConversion->stars = 0;
+    }
+
+    pConversion->length = ( size_t ) ( p - pFormat ) + ( ( *p != '\0' ) ? 1 : 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Render one record into pLine; the format walk matches DLog_Printf. */
+static void _render( const uint8_t * pRecord,
+                     size_t length,
+                     const char * pFormat,
+                     char * pLine,
+                     size_t lineSize )
+{
+    const char * p = pFormat;
+    size_t offset = RECORD_PREFIX_SIZE;
+    size_t out = 0;
+    Conversion_t conversion;
+    char spec[ 64 ];
+    char * pString = NULL;
+    int stars[ 2 ] = { 0 };
+    int written = 0;
+    bool complete = true;
+
+    #define ROOM()    ( lineSize - out )
+    #define EMIT( value )                                                                                 \
+    ( ( conversion.stars == 2 ) ? snprintf( pLine + out, ROOM(), spec, stars[ 0 ], stars[ 1 ], value ) : \
+      ( conversion.stars == 1 ) ? snprintf( pLine + out, ROOM(), spec, stars[ 0 ], value ) :              \
+      snprintf( pLine + out, ROOM(), spec, value ) )
+
+    while( ( *p != '\0' ) && ( out < lineSize - 1 ) )
+    {
+        const char * pPercent = strchr( p, '%' );
+        size_t literal = ( pPercent == NULL ) ? strlen( p ) : ( size_t ) ( pPercent - p );
+        size_t specLength;
+        int i;
+
+        if( literal > lineSize - 1 - out )
+        {
+            literal = lineSize - 1 - out;
+        }
+
+        memcpy( pLine + out, p, literal );
+        out += literal;
+
+        if( pPercent == NULL )
+        {
+            break;
+        }
+
+        _parseConversion( pPercent, &conversion );
+        p = pPercent + conversion.length;
+
+        if( conversion.arg == ARG_NONE )
+        {
+            if( out < lineSize - 1 )
+            {
+                pLine[ out++ ] = ( conversion.conversion == '%' ) ? '%' : '?';
+            }
+
+            continue;
+        }
+
+        for( i = 0; i < conversion.stars; i++ )
+        {
+            if( offset + 4 > length )
+            {
+                complete = false;
+                break;
+            }
+
+            stars[ i ] = ( int ) ( int32_t ) _read32( pRecord + offset );
+            offset += 4;
+        }
+
+        /* Same conversion, with the length modifier of the host type. */
+        specLength = conversion.length - 1;
+
+        while( ( specLength > 1 ) && ( strchr( "hljztL", conversion.pStart[ specLength - 1 ] ) != NULL ) )
+        {
+            specLength--;
+        }
+
+        if( ( complete == false ) || ( specLength > sizeof( spec ) - 4 ) )
+        {
+            complete = false;
+            break;
+        }
+
+        memcpy( spec, conversion.pStart, specLength );
+
+        if( conversion.arg == ARG_LONG )
+        {
+            spec[ specLength++ ] = 'l';
+        }
+        else if( conversion.arg == ARG_LONG_LONG )
+        {
+            spec[ specLength++ ] = 'l';
+            spec[ specLength++ ] = 'l';
+        }
+
+        spec[ specLength++ ] = conversion.conversion;
+        spec[ specLength ] = '\0';
+
+        if( conversion.arg == ARG_LONG_LONG )
+        {
+            int64_t value;
+
+            if( offset + 8 > length )
+            {
+                complete = false;
+                break;
+            }
+
+            value = ( int64_t ) ( ( uint64_t ) _read32( pRecord + offset ) |
+                                  ( ( uint64_t ) _read32( pRecord + offset + 4 ) << 32 ) );
+            offset += 8;
+            written = EMIT( ( long long ) value );
+        }
+        else if( conversion.arg == ARG_DOUBLE )
+        {
+            double value;
+
+            if( offset + 8 > length )
+            {
+                complete = false;
+                break;
+            }
+
+            memcpy( &value, pRecord + offset, sizeof( value ) );
+            offset += 8;
+            written = EMIT( value );
+        }
+        else if( conversion.arg == ARG_STRING )
+        {
+            uint16_t stringLength;
+            size_t padded;
+
+            if( offset + 2 > length )
+            {
+                complete = false;
+                break;
+            }
+
+            stringLength = _read16( pRecord + offset );
+            padded = ( ( size_t ) stringLength + 2 + 3 ) & ~( size_t ) 3;
+
+            if( offset + padded > length )
+            {
+                complete = false;
+                break;
+            }
+
+            pString = realloc( pString, ( size_t ) stringLength + 1 );
+            memcpy( pString, pRecord + offset + 2, stringLength );
+            pString[ stringLength ] = '\0';
+            offset += padded;
+            written = EMIT( pString );
+        }
+        else
+        {
+            uint32_t value;
+
+            if( offset + 4 > length )
+            {
+                complete = false;
+                break;
+            }
+
+            value = _read32( pRecord + offset );
+            offset += 4;
+
+            if( conversion.arg == ARG_POINTER )
+            {
+                spec[ specLength - 1 ] = 'x';
+                memmove( spec + 3, spec + 1, specLength );
+                memcpy( spec, "0x%", 3 );
+                written = EMIT( value );
+            }
+            else if( conversion.arg == ARG_LONG )
+            {
+                if( ( conversion.conversion == 'd' ) || ( conversion.conversion == 'i' ) )
+                {
+                    written = EMIT( ( long ) ( int32_t ) value );
+                }
+                else
+                {
+                    written = EMIT( ( unsigned long ) value );
+                }
+            }
+            else
+            {
+                written = EMIT( ( int ) value );
+            }
+        }
+
+        if( written > 0 )
+        {
+            out += ( ( size_t ) written < ROOM() ) ? ( size_t ) written : ROOM() - 1;
+        }
+    }
+
+    #undef EMIT
+    #undef ROOM
+
+    if( complete == false )
+    {
+        written = snprintf( pLine + out, lineSize - out, "<truncated>\n" );
+        out += ( written > 0 ) ? ( size_t ) written : 0;
+    }
+
+    pLine[ ( out < lineSize ) ? out : lineSize - 1 ] = '\0';
+    free( pString );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _printRecord( const uint8_t * pRecord,
+                          size_t length )
+{
+    static char line[ MAX_LINE_LENGTH ];
+    uint32_t header, timestamp, address;
+    const char * pFormat;
+
+    if( length < RECORD_PREFIX_SIZE )
+    {
+        return;
+    }
+
+    header = _read32( pRecord );
+    timestamp = _read32( pRecord + 4 );
+    address = _read32( pRecord + 8 );
+
+    if( ( header >> 16 ) != RECORD_MESSAGE )
+    {
+        return;
+    }
+
+    if( ( header & 0xFFFF ) < length )
+    {
+        length = header & 0xFFFF;
+    }
+
+    if( printTimestamps == true )
+    {
+        printf( "[%6u.%06u] ", timestamp / 1000000, timestamp % 1000000 );
+    }
+
+    pFormat = _lookupFormat( address );
+
+    if( pFormat == NULL )
+    {
+        unknownFormats++;
+        printf( "<format 0x%08x not in the ELF>\n", address );
+        return;
+    }
+
+    _render( pRecord, length, pFormat, line, sizeof( line ) );
+    fputs( line, stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+static int _hexValue( char c )
+{
+    if( ( c >= '0' ) && ( c <= '9' ) )
+    {
+        return c - '0';
+    }
+
+    if( ( c >= 'a' ) && ( c <= 'f' ) )
+    {
+        return c - 'a' + 10;
+    }
+
+    if( ( c >= 'A' ) && ( c <= 'F' ) )
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static void _decodeText( FILE * pInput,
+                         bool quiet )
+{
+    static uint8_t record[ MAX_RECORD_SIZE ];
+    char * pLine = NULL;
+    size_t capacity = 0;
+
+    while( getline( &pLine, &capacity, pInput ) > 0 )
+    {
+        /* The serial monitor may prefix lines, so look anywhere. */
+        const char * pHex = strstr( pLine, "DLOG " );
+        size_t length = 0;
+
+        if( pHex == NULL )
+        {
+            if( quiet == false )
+            {
+                fputs( pLine, stdout );
+            }
+
+            continue;
+        }
+
+        for( pHex += 5; ( length < sizeof( record ) ) &&
+             ( _hexValue( pHex[ 0 ] ) >= 0 ) && ( _hexValue( pHex[ 1 ] ) >= 0 ); pHex += 2 )
+        {
+            record[ length++ ] = ( uint8_t ) ( ( _hexValue( pHex[ 0 ] ) << 4 ) | _hexValue( pHex[ 1 ] ) );
+        }
+
+        _printRecord( record, length );
+    }
+
+    free( pLine );
+}
+
+static void _decodeBinary( FILE * pInput )
+{
+    static uint8_t record[ MAX_RECORD_SIZE ];
+    uint32_t header, length;
+
+    while( fread( record, 1, 4, pInput ) == 4 )
+    {
+        header = _read32( record );
+        length = header & 0xFFFF;
+
+        /* Zero words are free ring space. */
+        if( header == 0 )
+        {
+            continue;
+        }
+
+        if( ( length < 4 ) || ( fread( record + 4, 1, length - 4, pInput ) != length - 4 ) )
+        {
+            fprintf( stderr, "truncated record\n" );
+            break;
+        }
+
+        _printRecord( record, length );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _usage( const char * pName )
+{
+    fprintf( stderr,
+             "usage: %s -e app.elf [-b] [-q] [-t] [input]\n"
+             "  -e  application ELF holding the format strings\n"
+             "  -b  input is a binary record stream, not a console log\n"
+             "  -q  drop console lines that are not records\n"
+             "  -t  prefix lines with the device timestamp in seconds\n",
+             pName );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    const char * pElfPath = NULL;
+    bool binary = false, quiet = false;
+    FILE * pInput = stdin;
+    int option;
+
+    while( ( option = getopt( argc, argv, "e:bqth" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'e':
+                pElfPath = optarg;
+                break;
+
+            case 'b':
+                binary = true;
+                break;
+
+            case 'q':
+                quiet = true;
+                break;
+
+            case 't':
+                printTimestamps = true;
+                break;
+
+            default:
+                _usage( argv[ 0 ] );
+                return 2;
+        }
+    }
+
+    if( ( pElfPath == NULL ) || ( _loadElf( pElfPath ) == false ) )
+    {
+        _usage( argv[ 0 ] );
+        return 2;
+    }
+
+    if( optind < argc )
+    {
+        pInput = fopen( argv[ optind ], binary ? "rb" : "r" );
+
+        if( pInput == NULL )
+        {
+            perror( argv[ optind ] );
+            return 1;
+        }
+    }
+
+    if( binary == true )
+    {
+        _decodeBinary( pInput );
+    }
+    else
+    {
+        _decodeText( pInput, quiet );
+    }
+
+    if( unknownFormats > 0 )
+    {
+        fprintf( stderr, "%lu records with unknown formats; is the ELF from the same build?\n", unknownFormats );
+    }
+
+    return 0;
+}
@@ -0,0 +1,1661 @@
+/*
+ * fleet_loadgen - a virtual fleet of workshop sensor devices.
+ *
+ * Every virtual device behaves like the publish loop of the Lab1 and Lab3
+ * demos: it connects with its own client identifier, samples a simulated
+ * DHT22 on a timer (with jitter), reports vibration edges as they occur and
+ * publishes both with the demos' payload formats. Devices are multiplexed
+ * over one epoll loop per worker thread, so a few threads drive thousands of
+ * connections.
+ *
+ * Reported every interval and at the end: connected devices, publish and
+ * PUBACK rates, PUBACK latency percentiles and connection churn (connects,
+ * refusals, drops by the broker, planned disconnects).
+ *
+ * MQTT 3.1.1 over TCP, or over TLS with -C: the broker is verified against
+ * that CA and the host name (or address) it is reached at, and -E and -K
+ * give the device certificate and key that AWS IoT Core and Greengrass
+ * cores require. The host stand-ins need only the CA that
+ * host/gen_certificates.sh leaves in host/build/ca.pem. With -R each device
+ * offers the session of its last connection, as the demos do
+ * (driver/tls_session_cache.h). Full and resumed handshakes are counted
+ * apart, with their times from the TCP connection to the finished
+ * handshake, since with churn they are most of the cost of a connection.
+ *
+ * Build:
+ *     cc -O2 -pthread -o fleet_loadgen fleet_loadgen.c -lm -lssl -lcrypto
+ *
+ * Example, 2000 devices sampling every 3 s +/- 500 ms, with each connection
+ * living a minute on average:
+ *     ./fleet_loadgen -h 127.0.0.1 -n 2000 -s 3000 -j 500 -c 60 -d 300
+ *
+ * Example, 50 devices over TLS to the broker stand-in of a running
+ * host/lab1, reconnecting every 10 s on average with resumed sessions:
+ *     ./fleet_loadgen -C ../host/build/ca.pem -h localhost -p 18883 -n 50 -c 10 -R -d 60
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+/* Same payloads as the demos. */
+#define DHT_PAYLOAD_FORMAT    "{\"Humidity\":%.1f,\"Temperature\":%.1f}"
+#define VIB_PAYLOAD           "{\"Detect\":\"Vibrating\"}"
+
+#define MAX_INFLIGHT          64      /* QoS 1 PUBLISHes awaiting PUBACK per device. */
+#define RX_BUFFER_SIZE        512
+#define TX_BUFFER_SIZE        2048
+#define CONNACK_TIMEOUT_US    10000000ULL
+#define MIN_BACKOFF_MS        100
+#define MAX_BACKOFF_MS        10000
+#define NEVER                 UINT64_MAX
+
+/* Latency histogram: 16 linear sub-buckets per power of two, in microseconds. */
+#define HIST_SUB_BITS         4
+#define HIST_SUB              ( 1 << HIST_SUB_BITS )
+#define HIST_BUCKETS          ( 40 * HIST_SUB )
+
+/*-----------------------------------------------------------*/
+
+typedef struct Config
+{
+    const char * pHost;
+    const char * pPort;
+    const char * pClientPrefix;
+    const char * pTopic;
+    bool topicPerDevice;
+    int devices;
+    int threads;
+    int qos;
+    int sampleMs;
+    int jitterMs;
+    double vibrationsPerMinute;
+    double churnSeconds;      /* Mean connection lifetime, 0 = keep connected. */
+    double rampPerSecond;     /* New connections per second at start. */
+    int keepAliveSeconds;
+    int durationSeconds;      /* 0 = until interrupted. */
+    int intervalSeconds;
+    bool json;
+    uint32_t seed;
+    const char * pCaFile;     /* TLS when set. */
+    const char * pCertFile;   /* Device certificate, for mutual TLS. */
+    const char * pKeyFile;
+    bool resume;              /* Offer the session of the last connection. */
+} Config_t;
+
+static Config_t config =
+{
+    .pHost               = "127.0.0.1",
+    .pPort               = "1883",
+    .pClientPrefix       = "fleet",
+    .pTopic              = "iotdemo/topic/pub",
+    .topicPerDevice      = false,
+    .devices             = 100,
+    .threads             = 2,
+    .qos                 = 1,
+    .sampleMs            = 3000,
+    .jitterMs            = 0,
+    .vibrationsPerMinute = 0.5,
+    .churnSeconds        = 0.0,
+    .rampPerSecond       = 200.0,
+    .keepAliveSeconds    = 60,
+    .durationSeconds     = 60,
+    .intervalSeconds     = 1,
+    .json                = false,
+    .seed                = 1,
+    .pCaFile             = NULL,
+    .pCertFile           = NULL,
+    .pKeyFile            = NULL,
+    .resume              = false
+};
+
+typedef enum
+{
+    DEVICE_IDLE,
+    DEVICE_CONNECTING,
+    DEVICE_HANDSHAKE,
+    DEVICE_WAIT_CONNACK,
+    DEVICE_ONLINE
+} DeviceState_t;
+
+typedef struct Device
+{
+    int index;
+    int fd;
+    SSL * pSsl;               /* NULL without TLS or while disconnected. */
+    SSL_SESSION * pSession;   /* Of the last connection, offered with -R. */
+    uint64_t handshakeStart;
+    DeviceState_t state;
+    char clientId[ 24 ];
+    char topic[ 128 ];
+
+    /* Timers, absolute microseconds. */
+    uint64_t reconnectAt;
+    uint64_t connackTimeoutAt;
+    uint64_t nextSample;
+    uint64_t nextVibration;
+    uint64_t nextPing;
+    uint64_t disconnectAt;
+    uint64_t deadline;        /* Earliest of the above; the heap key. */
+    size_t heapIndex;
+
+    uint32_t backoffMs;
+    uint32_t random;          /* xorshift32 state. */
+    uint32_t sample;          /* Simulated DHT22 sample count. */
+    uint16_t nextPacketId;
+    uint16_t inflightId[ MAX_INFLIGHT ];
+    uint64_t inflightSentAt[ MAX_INFLIGHT ];
+
+    uint8_t rx[ RX_BUFFER_SIZE ];
+    size_t rxLength;
+    uint8_t tx[ TX_BUFFER_SIZE ];
+    size_t txLength;
+    bool wantWrite;
+} Device_t;
+
+/* Counters are written by one worker and read by the reporter. */
+typedef struct Stats
+{
+    uint64_t connectAttempts;
+    uint64_t connects;
+    uint64_t connectFailures;  /* TCP errors, refusals and CONNACK timeouts. */
+    uint64_t drops;            /* Connection lost while online. */
+    uint64_t plannedDisconnects;
+    uint64_t online;
+    uint64_t publishes;
+    uint64_t pubacks;
+    uint64_t ackLost;          /* In-flight slot reused or connection closed. */
+    uint64_t txOverflows;      /* PUBLISH skipped: socket not draining. */
+    uint64_t handshakes;       /* Finished TLS handshakes. */
+    uint64_t resumed;          /* Of those, resuming a session. */
+    uint64_t latency[ HIST_BUCKETS ];
+    uint64_t fullHandshake[ HIST_BUCKETS ];
+    uint64_t resumedHandshake[ HIST_BUCKETS ];
+} Stats_t;
+
+typedef struct Worker
+{
+    pthread_t thread;
+    int epollFd;
+    Device_t * pDevices;
+    int deviceCount;
+    Device_t ** pHeap;
+    size_t heapSize;
+    Stats_t stats;
+} Worker_t;
+
+static volatile sig_atomic_t stopRequested = 0;
+static struct addrinfo * pBrokerAddress = NULL;
+static SSL_CTX * pTlsContext = NULL;
+static uint64_t startTime = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowUs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000ULL + ( uint64_t ) now.tv_nsec / 1000ULL;
+}
+
+static void count( uint64_t * pCounter,
+                   int64_t delta )
+{
+    __atomic_add_fetch( pCounter, ( uint64_t ) delta, __ATOMIC_RELAXED );
+}
+
+static uint64_t load( const uint64_t * pCounter )
+{
+    return __atomic_load_n( pCounter, __ATOMIC_RELAXED );
+}
+
+static uint32_t nextRandom( Device_t * pDevice )
+{
+    uint32_t x = pDevice->random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pDevice->random = x;
+
+    return x;
+}
+
+/* Uniform in [0, 1). */
+static double uniform( Device_t * pDevice )
+{
+    return ( double ) ( nextRandom( pDevice ) >> 8 ) / ( double ) ( 1U << 24 );
+}
+
+static uint64_t exponentialUs( Device_t * pDevice,
+                               double meanSeconds )
+{
+    return ( uint64_t ) ( -log( 1.0 - uniform( pDevice ) ) * meanSeconds * 1e6 );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t histIndex( uint64_t value )
+{
+    int msb;
+    size_t index;
+
+    if( value < HIST_SUB )
+    {
+        return ( size_t ) value;
+    }
+
+    msb = 63 - __builtin_clzll( value );
+    index = ( size_t ) ( msb - HIST_SUB_BITS + 1 ) * HIST_SUB +
+            ( size_t ) ( ( value >> ( msb - HIST_SUB_BITS ) ) & ( HIST_SUB - 1 ) );
+
+    return ( index < HIST_BUCKETS ) ? index : HIST_BUCKETS - 1;
+}
+
+/* Midpoint of a bucket. */
+static double histValue( size_t index )
+{
+    size_t shift;
+    uint64_t low;
+
+    if( index < HIST_SUB )
+    {
+        return ( double ) index;
+    }
+
+    shift = index / HIST_SUB - 1;
+    low = ( ( uint64_t ) HIST_SUB + index % HIST_SUB ) << shift;
+
+    return ( double ) low + ( double ) ( 1ULL << shift ) / 2.0;
+}
+
+static uint64_t histTotal( const uint64_t * pBuckets )
+{
+    uint64_t total = 0;
+    size_t i;
+
+    for( i = 0; i < HIST_BUCKETS; i++ )
+    {
+        total += pBuckets[ i ];
+    }
+
+    return total;
+}
+
+static double histPercentile( const uint64_t * pBuckets,
+                              uint64_t total,
+                              double fraction )
+{
+    uint64_t target = ( uint64_t ) ceil( fraction * ( double ) total );
+    uint64_t seen = 0;
+    size_t i;
+
+    if( total == 0 )
+    {
+        return 0.0;
+    }
+
+    for( i = 0; i < HIST_BUCKETS; i++ )
+    {
+        seen += pBuckets[ i ];
+
+        if( seen >= target )
+        {
+            return histValue( i );
+        }
+    }
+
+    return histValue( HIST_BUCKETS - 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Min-heap of devices by deadline. */
+
+static void heapSwap( Worker_t * pWorker,
+                      size_t a,
+                      size_t b )
+{
+    Device_t * pTemp = pWorker->pHeap[ a ];
+
+    pWorker->pHeap[ a ] = pWorker->pHeap[ b ];
+    pWorker->pHeap[ b ] = pTemp;
+    pWorker->pHeap[ a ]->heapIndex = a;
+    pWorker->pHeap[ b ]->heapIndex = b;
+}
+
+static void heapFix( Worker_t * pWorker,
+                     size_t i )
+{
+    size_t child;
+
+    while( ( i > 0 ) && ( pWorker->pHeap[ ( i - 1 ) / 2 ]->deadline > pWorker->pHeap[ i ]->deadline ) )
+    {
+        heapSwap( pWorker, i, ( i - 1 ) / 2 );
+        i = ( i - 1 ) / 2;
+    }
+
+    for( ; ; )
+    {
+        child = 2 * i + 1;
+
+        if( child >= pWorker->heapSize )
+        {
+            break;
+        }
+
+        if( ( child + 1 < pWorker->heapSize ) &&
+            ( pWorker->pHeap[ child + 1 ]->deadline < pWorker->pHeap[ child ]->deadline ) )
+        {
+            child++;
+        }
+
+        if( pWorker->pHeap[ i ]->deadline <= pWorker->pHeap[ child ]->deadline )
+        {
+            break;
+        }
+
+        heapSwap( pWorker, i, child );
+        i = child;
+    }
+}
+
+static void updateDeadline( Worker_t * pWorker,
+                            Device_t * pDevice )
+{
+    uint64_t deadline = NEVER;
+
+    switch( pDevice->state )
+    {
+        case DEVICE_IDLE:
+            deadline = pDevice->reconnectAt;
+            break;
+
+        case DEVICE_CONNECTING:
+        case DEVICE_HANDSHAKE:
+        case DEVICE_WAIT_CONNACK:
+            deadline = pDevice->connackTimeoutAt;
+            break;
+
+        case DEVICE_ONLINE:
+            deadline = pDevice->nextSample;
+
+            if( pDevice->nextVibration < deadline )
+            {
+                deadline = pDevice->nextVibration;
+            }
+
+            if( pDevice->nextPing < deadline )
+            {
+                deadline = pDevice->nextPing;
+            }
+
+            if( pDevice->disconnectAt < deadline )
+            {
+                deadline = pDevice->disconnectAt;
+            }
+
+            break;
+    }
+
+    pDevice->deadline = deadline;
+    heapFix( pWorker, pDevice->heapIndex );
+}
+
+/*-----------------------------------------------------------*/
+
+/* MQTT 3.1.1 encoding. */
+
+static size_t putRemainingLength( uint8_t * pBuffer,
+                                  size_t length )
+{
+    size_t i = 0;
+
+    do
+    {
+        pBuffer[ i ] = ( uint8_t ) ( length % 128 );
+        length /= 128;
+
+        if( length > 0 )
+        {
+            pBuffer[ i ] |= 0x80;
+        }
+
+        i++;
+    } while( length > 0 );
+
+    return i;
+}
+
+static size_t putString( uint8_t * pBuffer,
+                         const char * pString,
+                         size_t length )
+{
+    pBuffer[ 0 ] = ( uint8_t ) ( length >> 8 );
+    pBuffer[ 1 ] = ( uint8_t ) ( length & 0xFF );
+    memcpy( pBuffer + 2, pString, length );
+
+    return length + 2;
+}
+
+/*-----------------------------------------------------------*/
+
+static void closeDevice( Worker_t * pWorker,
+                         Device_t * pDevice,
+                         bool planned );
+
+/* The socket calls, through TLS when it is on. As for send() and recv(),
+ * -1 with errno EAGAIN means that the socket is not ready; TLS may need to
+ * read before it can write, which the level triggered loop retries. */
+static ssize_t tlsResult( SSL * pSsl,
+                          int result )
+{
+    if( result > 0 )
+    {
+        return result;
+    }
+
+    switch( SSL_get_error( pSsl, result ) )
+    {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+
+        default:
+            errno = ECONNRESET;
+            return -1;
+    }
+}
+
+static ssize_t sendBytes( Device_t * pDevice,
+                          const uint8_t * pBuffer,
+                          size_t length )
+{
+    if( pDevice->pSsl == NULL )
+    {
+        return send( pDevice->fd, pBuffer, length, MSG_NOSIGNAL );
+    }
+
+    ERR_clear_error();
+
+    return tlsResult( pDevice->pSsl, SSL_write( pDevice->pSsl, pBuffer, ( int ) length ) );
+}
+
+static ssize_t receiveBytes( Device_t * pDevice,
+                             uint8_t * pBuffer,
+                             size_t length )
+{
+    if( pDevice->pSsl == NULL )
+    {
+        return recv( pDevice->fd, pBuffer, length, 0 );
+    }
+
+    ERR_clear_error();
+
+    return tlsResult( pDevice->pSsl, SSL_read( pDevice->pSsl, pBuffer, ( int ) length ) );
+}
+
+/* Wait for the socket to be writable as well as readable, or not. */
+static void watchWrite( Worker_t * pWorker,
+                        Device_t * pDevice,
+                        bool wantWrite )
+{
+    struct epoll_event event = { 0 };
+
+    if( wantWrite != pDevice->wantWrite )
+    {
+        event.events = EPOLLIN | ( wantWrite ? EPOLLOUT : 0 );
+        event.data.ptr = pDevice;
+        epoll_ctl( pWorker->epollFd, EPOLL_CTL_MOD, pDevice->fd, &event );
+        pDevice->wantWrite = wantWrite;
+    }
+}
+
+static bool flushTx( Worker_t * pWorker,
+                     Device_t * pDevice )
+{
+    ssize_t written;
+
+    while( pDevice->txLength > 0 )
+    {
+        written = sendBytes( pDevice, pDevice->tx, pDevice->txLength );
+
+        if( written < 0 )
+        {
+            if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+            {
+                break;
+            }
+
+            return false;
+        }
+
+        memmove( pDevice->tx, pDevice->tx + written, pDevice->txLength - ( size_t ) written );
+        pDevice->txLength -= ( size_t ) written;
+    }
+
+    watchWrite( pWorker, pDevice, pDevice->txLength > 0 );
+
+    return true;
+}
+
+/* Queue a packet; false if the socket is not draining. */
+static bool queuePacket( Device_t * pDevice,
+                         const uint8_t * pPacket,
+                         size_t length )
+{
+    if( pDevice->txLength + length > TX_BUFFER_SIZE )
+    {
+        return false;
+    }
+
+    memcpy( pDevice->tx + pDevice->txLength, pPacket, length );
+    pDevice->txLength += length;
+
+    return true;
+}
+
+static void sendConnect( Device_t * pDevice )
+{
+    uint8_t packet[ 64 ];
+    uint8_t body[ 48 ];
+    size_t bodyLength = 0, length = 0;
+    size_t idLength = strlen( pDevice->clientId );
+
+    bodyLength += putString( body, "MQTT", 4 );
+    body[ bodyLength++ ] = 4;    /* Protocol level 3.1.1. */
+    body[ bodyLength++ ] = 0x02; /* Clean session. */
+    body[ bodyLength++ ] = ( uint8_t ) ( config.keepAliveSeconds >> 8 );
+    body[ bodyLength++ ] = ( uint8_t ) ( config.keepAliveSeconds & 0xFF );
+    bodyLength += putString( body + bodyLength, pDevice->clientId, idLength );
+
+    packet[ length++ ] = 0x10;
+    length += putRemainingLength( packet + length, bodyLength );
+    memcpy( packet + length, body, bodyLength );
+    length += bodyLength;
+
+    ( void ) queuePacket( pDevice, packet, length );
+}
+
+static void sendSimple( Device_t * pDevice,
+                        uint8_t type )
+{
+    uint8_t packet[ 2 ] = { type, 0 };
+
+    ( void ) queuePacket( pDevice, packet, sizeof( packet ) );
+}
+
+static void publish( Worker_t * pWorker,
+                     Device_t * pDevice,
+                     const char * pPayload,
+                     size_t payloadLength )
+{
+    uint8_t packet[ 320 ];
+    size_t topicLength = strlen( pDevice->topic );
+    size_t remaining = 2 + topicLength + payloadLength + ( config.qos > 0 ? 2 : 0 );
+    size_t length = 0;
+    size_t slot = 0;
+    uint16_t packetId = 0;
+
+    if( remaining + 5 > sizeof( packet ) )
+    {
+        return;
+    }
+
+    packet[ length++ ] = ( uint8_t ) ( 0x30 | ( config.qos > 0 ? 0x02 : 0x00 ) );
+    length += putRemainingLength( packet + length, remaining );
+    length += putString( packet + length, pDevice->topic, topicLength );
+
+    if( config.qos > 0 )
+    {
+        if( ++pDevice->nextPacketId == 0 )
+        {
+            pDevice->nextPacketId = 1;
+        }
+
+        packetId = pDevice->nextPacketId;
+        packet[ length++ ] = ( uint8_t ) ( packetId >> 8 );
+        packet[ length++ ] = ( uint8_t ) ( packetId & 0xFF );
+    }
+
+    memcpy( packet + length, pPayload, payloadLength );
+    length += payloadLength;
+
+    if( queuePacket( pDevice, packet, length ) == false )
+    {
+        count( &pWorker->stats.txOverflows, 1 );
+        return;
+    }
+
+    if( config.qos > 0 )
+    {
+        slot = packetId % MAX_INFLIGHT;
+
+        if( pDevice->inflightId[ slot ] != 0 )
+        {
+            count( &pWorker->stats.ackLost, 1 );
+        }
+
+        pDevice->inflightId[ slot ] = packetId;
+        pDevice->inflightSentAt[ slot ] = nowUs();
+    }
+
+    count( &pWorker->stats.publishes, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Same signal model as DHT22_sim.c, one instance per device. */
+static void publishReading( Worker_t * pWorker,
+                            Device_t * pDevice )
+{
+    char payload[ 64 ];
+    double phase, temperature, humidity;
+    int length;
+
+    pDevice->sample++;
+    phase = 2.0 * M_PI * ( double ) ( pDevice->sample % 1200 ) / 1200.0;
+    temperature = round( 10.0 * ( 22.0 + 3.0 * sin( phase ) + 0.4 * ( uniform( pDevice ) - 0.5 ) ) ) / 10.0;
+    humidity = round( 10.0 * ( 45.0 - 8.0 * sin( phase ) + 1.0 * ( uniform( pDevice ) - 0.5 ) ) ) / 10.0;
+
+    length = snprintf( payload, sizeof( payload ), DHT_PAYLOAD_FORMAT, humidity, temperature );
+    publish( pWorker, pDevice, payload, ( size_t ) length );
+}
+
+static uint64_t nextSampleDelayUs( Device_t * pDevice )
+{
+    int64_t delayMs = config.sampleMs;
+
+    if( config.jitterMs > 0 )
+    {
+        delayMs += ( int64_t ) ( nextRandom( pDevice ) % ( uint32_t ) ( 2 * config.jitterMs + 1 ) ) - config.jitterMs;
+    }
+
+    return ( uint64_t ) ( delayMs > 1 ? delayMs : 1 ) * 1000ULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void scheduleReconnect( Device_t * pDevice,
+                               uint64_t now )
+{
+    pDevice->reconnectAt = now + ( uint64_t ) pDevice->backoffMs * 1000ULL +
+                           ( uint64_t ) ( nextRandom( pDevice ) % ( pDevice->backoffMs + 1 ) ) * 1000ULL;
+
+    pDevice->backoffMs *= 2;
+
+    if( pDevice->backoffMs > MAX_BACKOFF_MS )
+    {
+        pDevice->backoffMs = MAX_BACKOFF_MS;
+    }
+}
+
+static void closeDevice( Worker_t * pWorker,
+                         Device_t * pDevice,
+                         bool planned )
+{
+    size_t i;
+    uint64_t now = nowUs();
+
+    if( pDevice->state == DEVICE_ONLINE )
+    {
+        count( &pWorker->stats.online, -1 );
+        count( planned ? &pWorker->stats.plannedDisconnects : &pWorker->stats.drops, 1 );
+    }
+    else
+    {
+        count( &pWorker->stats.connectFailures, 1 );
+    }
+
+    for( i = 0; i < MAX_INFLIGHT; i++ )
+    {
+        if( pDevice->inflightId[ i ] != 0 )
+        {
+            count( &pWorker->stats.ackLost, 1 );
+            pDevice->inflightId[ i ] = 0;
+        }
+    }
+
+    if( pDevice->pSsl != NULL )
+    {
+        /* A planned disconnect ends the session cleanly; a broken one has
+         * nothing left to send. */
+        if( planned )
+        {
+            ERR_clear_error();
+            ( void ) SSL_shutdown( pDevice->pSsl );
+        }
+
+        SSL_free( pDevice->pSsl );
+        pDevice->pSsl = NULL;
+    }
+
+    if( pDevice->fd >= 0 )
+    {
+        epoll_ctl( pWorker->epollFd, EPOLL_CTL_DEL, pDevice->fd, NULL );
+        close( pDevice->fd );
+        pDevice->fd = -1;
+    }
+
+    pDevice->state = DEVICE_IDLE;
+    pDevice->rxLength = 0;
+    pDevice->txLength = 0;
+    pDevice->wantWrite = false;
+
+    if( planned )
+    {
+        pDevice->backoffMs = MIN_BACKOFF_MS;
+    }
+
+    scheduleReconnect( pDevice, now );
+    updateDeadline( pWorker, pDevice );
+}
+
+static void startConnect( Worker_t * pWorker,
+                          Device_t * pDevice )
+{
+    struct epoll_event event = { 0 };
+    int one = 1;
+
+    count( &pWorker->stats.connectAttempts, 1 );
+
+    pDevice->fd = socket( pBrokerAddress->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+
+    if( pDevice->fd < 0 )
+    {
+        closeDevice( pWorker, pDevice, false );
+        return;
+    }
+
+    setsockopt( pDevice->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+    if( ( connect( pDevice->fd, pBrokerAddress->ai_addr, pBrokerAddress->ai_addrlen ) < 0 ) &&
+        ( errno != EINPROGRESS ) )
+    {
+        closeDevice( pWorker, pDevice, false );
+        return;
+    }
+
+    pDevice->state = DEVICE_CONNECTING;
+    pDevice->connackTimeoutAt = nowUs() + CONNACK_TIMEOUT_US;
+    pDevice->wantWrite = true;
+
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = pDevice;
+    epoll_ctl( pWorker->epollFd, EPOLL_CTL_ADD, pDevice->fd, &event );
+
+    updateDeadline( pWorker, pDevice );
+}
+
+/* Kept for the next connection of the device; called by OpenSSL once the
+ * session can be resumed, which with TLS 1.3 is after the handshake. */
+static int onNewSession( SSL * pSsl,
+                         SSL_SESSION * pSession )
+{
+    Device_t * pDevice = SSL_get_app_data( pSsl );
+
+    if( pDevice->pSession != NULL )
+    {
+        SSL_SESSION_free( pDevice->pSession );
+    }
+
+    pDevice->pSession = pSession;
+
+    return 1;
+}
+
+/* Begin the TLS handshake on a connected socket; false if the device was
+ * closed. */
+static bool startTls( Worker_t * pWorker,
+                      Device_t * pDevice )
+{
+    struct in6_addr address;
+    bool isAddress = ( inet_pton( AF_INET, config.pHost, &address ) == 1 ) ||
+                     ( inet_pton( AF_INET6, config.pHost, &address ) == 1 );
+
+    pDevice->pSsl = SSL_new( pTlsContext );
+
+    /* The broker's certificate must name the host it is reached at; an
+     * address is not a name to send as SNI. */
+    if( ( pDevice->pSsl == NULL ) ||
+        ( SSL_set_fd( pDevice->pSsl, pDevice->fd ) != 1 ) ||
+        ( SSL_set1_host( pDevice->pSsl, config.pHost ) != 1 ) ||
+        ( ( isAddress == false ) && ( SSL_set_tlsext_host_name( pDevice->pSsl, config.pHost ) != 1 ) ) )
+    {
+        closeDevice( pWorker, pDevice, false );
+        return false;
+    }
+
+    SSL_set_app_data( pDevice->pSsl, pDevice );
+
+    if( config.resume && ( pDevice->pSession != NULL ) )
+    {
+        ( void ) SSL_set_session( pDevice->pSsl, pDevice->pSession );
+    }
+
+    pDevice->state = DEVICE_HANDSHAKE;
+    pDevice->handshakeStart = nowUs();
+
+    return true;
+}
+
+/* Carry the handshake on; true once it is done and CONNECT is queued,
+ * false while it waits for the socket or if the device was closed. */
+static bool continueHandshake( Worker_t * pWorker,
+                               Device_t * pDevice )
+{
+    uint64_t elapsed;
+    bool resumed;
+    int result;
+
+    ERR_clear_error();
+    result = SSL_connect( pDevice->pSsl );
+
+    if( result == 1 )
+    {
+        elapsed = nowUs() - pDevice->handshakeStart;
+        resumed = ( SSL_session_reused( pDevice->pSsl ) == 1 );
+        count( &pWorker->stats.handshakes, 1 );
+
+        if( resumed )
+        {
+            count( &pWorker->stats.resumed, 1 );
+            count( &pWorker->stats.resumedHandshake[ histIndex( elapsed ) ], 1 );
+        }
+        else
+        {
+            count( &pWorker->stats.fullHandshake[ histIndex( elapsed ) ], 1 );
+        }
+
+        pDevice->state = DEVICE_WAIT_CONNACK;
+        sendConnect( pDevice );
+
+        return true;
+    }
+
+    switch( SSL_get_error( pDevice->pSsl, result ) )
+    {
+        case SSL_ERROR_WANT_READ:
+            watchWrite( pWorker, pDevice, false );
+            break;
+
+        case SSL_ERROR_WANT_WRITE:
+            watchWrite( pWorker, pDevice, true );
+            break;
+
+        default:
+            closeDevice( pWorker, pDevice, false );
+            break;
+    }
+
+    return false;
+}
+
+static void goOnline( Worker_t * pWorker,
+                      Device_t * pDevice )
+{
+    uint64_t now = nowUs();
+
+    pDevice->state = DEVICE_ONLINE;
+    pDevice->backoffMs = MIN_BACKOFF_MS;
+
+    /* Spread the first sample over one period so devices do not sample in
+     * lockstep after a mass reconnect. */
+    pDevice->nextSample = now + ( uint64_t ) ( uniform( pDevice ) * config.sampleMs * 1000.0 );
+    pDevice->nextVibration = ( config.vibrationsPerMinute > 0.0 ) ?
+                             now + exponentialUs( pDevice, 60.0 / config.vibrationsPerMinute ) : NEVER;
+    pDevice->nextPing = now + ( uint64_t ) config.keepAliveSeconds * 1000000ULL;
+    pDevice->disconnectAt = ( config.churnSeconds > 0.0 ) ?
+                            now + exponentialUs( pDevice, config.churnSeconds ) : NEVER;
+
+    count( &pWorker->stats.connects, 1 );
+    count( &pWorker->stats.online, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Handle complete packets in the receive buffer. */
+static bool processRx( Worker_t * pWorker,
+                       Device_t * pDevice )
+{
+    size_t offset = 0, remaining, header, multiplier;
+    uint8_t type;
+    uint16_t packetId;
+    size_t slot;
+
+    for( ; ; )
+    {
+        if( pDevice->rxLength - offset < 2 )
+        {
+            break;
+        }
+
+        /* Decode the remaining length. */
+        remaining = 0;
+        multiplier = 1;
+        header = 1;
+
+        do
+        {
+            if( offset + header >= pDevice->rxLength )
+            {
+                goto incomplete;
+            }
+
+            remaining += ( pDevice->rx[ offset + header ] & 0x7F ) * multiplier;
+            multiplier *= 128;
+        } while( ( pDevice->rx[ offset + header++ ] & 0x80 ) && ( header < 5 ) );
+
+        if( header + remaining > RX_BUFFER_SIZE )
+        {
+            return false;
+        }
+
+        if( offset + header + remaining > pDevice->rxLength )
+        {
+            break;
+        }
+
+        type = pDevice->rx[ offset ] >> 4;
+
+        if( ( type == 2 ) && ( remaining >= 2 ) )
+        {
+            /* CONNACK */
+            if( ( pDevice->state != DEVICE_WAIT_CONNACK ) || ( pDevice->rx[ offset + header + 1 ] != 0 ) )
+            {
+                return false;
+            }
+
+            goOnline( pWorker, pDevice );
+        }
+        else if( ( type == 4 ) && ( remaining >= 2 ) )
+        {
+            /* PUBACK */
+            packetId = ( uint16_t ) ( ( pDevice->rx[ offset + header ] << 8 ) | pDevice->rx[ offset + header + 1 ] );
+            slot = packetId % MAX_INFLIGHT;
+
+            if( pDevice->inflightId[ slot ] == packetId )
+            {
+                count( &pWorker->stats.latency[ histIndex( nowUs() - pDevice->inflightSentAt[ slot ] ) ], 1 );
+                count( &pWorker->stats.pubacks, 1 );
+                pDevice->inflightId[ slot ] = 0;
+            }
+        }
+
+        /* PINGRESP and anything else is ignored. */
+        offset += header + remaining;
+    }
+
+incomplete:
+    memmove( pDevice->rx, pDevice->rx + offset, pDevice->rxLength - offset );
+    pDevice->rxLength -= offset;
+
+    return true;
+}
+
+static void onEvent( Worker_t * pWorker,
+                     Device_t * pDevice,
+                     uint32_t events )
+{
+    int error = 0;
+    socklen_t errorLength = sizeof( error );
+    ssize_t received;
+
+    if( pDevice->state == DEVICE_CONNECTING )
+    {
+        if( ( events & ( EPOLLOUT | EPOLLERR | EPOLLHUP ) ) == 0 )
+        {
+            return;
+        }
+
+        getsockopt( pDevice->fd, SOL_SOCKET, SO_ERROR, &error, &errorLength );
+
+        if( error != 0 )
+        {
+            closeDevice( pWorker, pDevice, false );
+            return;
+        }
+
+        if( pTlsContext == NULL )
+        {
+            pDevice->state = DEVICE_WAIT_CONNACK;
+            sendConnect( pDevice );
+        }
+        else if( startTls( pWorker, pDevice ) == false )
+        {
+            return;
+        }
+    }
+
+    if( ( pDevice->state == DEVICE_HANDSHAKE ) &&
+        ( continueHandshake( pWorker, pDevice ) == false ) )
+    {
+        return;
+    }
+
+    if( events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) )
+    {
+        for( ; ; )
+        {
+            received = receiveBytes( pDevice, pDevice->rx + pDevice->rxLength,
+                                     RX_BUFFER_SIZE - pDevice->rxLength );
+
+            if( received > 0 )
+            {
+                pDevice->rxLength += ( size_t ) received;
+
+                if( processRx( pWorker, pDevice ) == false )
+                {
+                    closeDevice( pWorker, pDevice, false );
+                    return;
+                }
+
+                if( pDevice->state == DEVICE_IDLE )
+                {
+                    return;
+                }
+            }
+            else if( ( received < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+            {
+                break;
+            }
+            else
+            {
+                /* Closed by the broker or failed. */
+                closeDevice( pWorker, pDevice, false );
+                return;
+            }
+        }
+    }
+
+    if( flushTx( pWorker, pDevice ) == false )
+    {
+        closeDevice( pWorker, pDevice, false );
+        return;
+    }
+
+    updateDeadline( pWorker, pDevice );
+}
+
+/* Run every timer of a device that is due. */
+static void onTimer( Worker_t * pWorker,
+                     Device_t * pDevice,
+                     uint64_t now )
+{
+    switch( pDevice->state )
+    {
+        case DEVICE_IDLE:
+            startConnect( pWorker, pDevice );
+            return;
+
+        case DEVICE_CONNECTING:
+        case DEVICE_HANDSHAKE:
+        case DEVICE_WAIT_CONNACK:
+            closeDevice( pWorker, pDevice, false );
+            return;
+
+        case DEVICE_ONLINE:
+
+            if( pDevice->disconnectAt <= now )
+            {
+                sendSimple( pDevice, 0xE0 );
+                ( void ) flushTx( pWorker, pDevice );
+                closeDevice( pWorker, pDevice, true );
+                return;
+            }
+
+            while( pDevice->nextSample <= now )
+            {
+                publishReading( pWorker, pDevice );
+                pDevice->nextSample += nextSampleDelayUs( pDevice );
+            }
+
+            while( pDevice->nextVibration <= now )
+            {
+                publish( pWorker, pDevice, VIB_PAYLOAD, sizeof( VIB_PAYLOAD ) - 1 );
+                pDevice->nextVibration += exponentialUs( pDevice, 60.0 / config.vibrationsPerMinute );
+            }
+
+            if( pDevice->nextPing <= now )
+            {
+                sendSimple( pDevice, 0xC0 );
+                pDevice->nextPing = now + ( uint64_t ) config.keepAliveSeconds * 1000000ULL;
+            }
+
+            if( flushTx( pWorker, pDevice ) == false )
+            {
+                closeDevice( pWorker, pDevice, false );
+                return;
+            }
+
+            break;
+    }
+
+    updateDeadline( pWorker, pDevice );
+}
+
+static void * workerMain( void * pArgument )
+{
+    Worker_t * pWorker = ( Worker_t * ) pArgument;
+    struct epoll_event events[ 256 ];
+    int ready, i, timeoutMs;
+    uint64_t now;
+    Device_t * pDevice;
+
+    while( stopRequested == 0 )
+    {
+        now = nowUs();
+
+        while( ( pWorker->heapSize > 0 ) && ( pWorker->pHeap[ 0 ]->deadline <= now ) )
+        {
+            onTimer( pWorker, pWorker->pHeap[ 0 ], now );
+        }
+
+        timeoutMs = 100;
+
+        if( ( pWorker->heapSize > 0 ) && ( pWorker->pHeap[ 0 ]->deadline != NEVER ) )
+        {
+            uint64_t waitUs = pWorker->pHeap[ 0 ]->deadline - now;
+
+            if( waitUs / 1000 < ( uint64_t ) timeoutMs )
+            {
+                timeoutMs = ( int ) ( ( waitUs + 999 ) / 1000 );
+            }
+        }
+
+        ready = epoll_wait( pWorker->epollFd, events, 256, timeoutMs );
+
+        for( i = 0; i < ready; i++ )
+        {
+            pDevice = ( Device_t * ) events[ i ].data.ptr;
+
+            if( pDevice->fd >= 0 )
+            {
+                onEvent( pWorker, pDevice, events[ i ].events );
+            }
+        }
+    }
+
+    /* Disconnect cleanly so the broker does not count the stop as a drop. */
+    for( i = 0; i < pWorker->deviceCount; i++ )
+    {
+        pDevice = &( pWorker->pDevices[ i ] );
+
+        if( pDevice->state == DEVICE_ONLINE )
+        {
+            sendSimple( pDevice, 0xE0 );
+            ( void ) flushTx( pWorker, pDevice );
+        }
+
+        if( pDevice->pSsl != NULL )
+        {
+            SSL_free( pDevice->pSsl );
+        }
+
+        if( pDevice->pSession != NULL )
+        {
+            SSL_SESSION_free( pDevice->pSession );
+        }
+
+        if( pDevice->fd >= 0 )
+        {
+            close( pDevice->fd );
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void sumStats( const Worker_t * pWorkers,
+                      Stats_t * pTotal )
+{
+    int w;
+    size_t i;
+
+    memset( pTotal, 0, sizeof( Stats_t ) );
+
+    for( w = 0; w < config.threads; w++ )
+    {
+        const Stats_t * pStats = &( pWorkers[ w ].stats );
+
+        pTotal->connectAttempts += load( &pStats->connectAttempts );
+        pTotal->connects += load( &pStats->connects );
+        pTotal->connectFailures += load( &pStats->connectFailures );
+        pTotal->drops += load( &pStats->drops );
+        pTotal->plannedDisconnects += load( &pStats->plannedDisconnects );
+        pTotal->online += load( &pStats->online );
+        pTotal->publishes += load( &pStats->publishes );
+        pTotal->pubacks += load( &pStats->pubacks );
+        pTotal->ackLost += load( &pStats->ackLost );
+        pTotal->txOverflows += load( &pStats->txOverflows );
+        pTotal->handshakes += load( &pStats->handshakes );
+        pTotal->resumed += load( &pStats->resumed );
+
+        for( i = 0; i < HIST_BUCKETS; i++ )
+        {
+            pTotal->latency[ i ] += load( &pStats->latency[ i ] );
+            pTotal->fullHandshake[ i ] += load( &pStats->fullHandshake[ i ] );
+            pTotal->resumedHandshake[ i ] += load( &pStats->resumedHandshake[ i ] );
+        }
+    }
+}
+
+static void report( const Stats_t * pTotal,
+                    const Stats_t * pPrevious,
+                    double elapsed,
+                    double interval,
+                    bool final )
+{
+    static uint64_t window[ HIST_BUCKETS ], fullWindow[ HIST_BUCKETS ], resumedWindow[ HIST_BUCKETS ];
+    const uint64_t * pBuckets = pTotal->latency;
+    const uint64_t * pFull = pTotal->fullHandshake;
+    const uint64_t * pResumed = pTotal->resumedHandshake;
+    uint64_t acks = pTotal->pubacks, fulls, resumes;
+    double publishRate, ackRate;
+    size_t i;
+
+    /* Interval lines show the latency and handshake times of the interval,
+     * the final line those of the whole run. */
+    if( final == false )
+    {
+        for( i = 0; i < HIST_BUCKETS; i++ )
+        {
+            window[ i ] = pTotal->latency[ i ] - pPrevious->latency[ i ];
+            fullWindow[ i ] = pTotal->fullHandshake[ i ] - pPrevious->fullHandshake[ i ];
+            resumedWindow[ i ] = pTotal->resumedHandshake[ i ] - pPrevious->resumedHandshake[ i ];
+        }
+
+        pBuckets = window;
+        pFull = fullWindow;
+        pResumed = resumedWindow;
+        acks = pTotal->pubacks - pPrevious->pubacks;
+    }
+
+    fulls = histTotal( pFull );
+    resumes = histTotal( pResumed );
+
+    publishRate = ( double ) ( pTotal->publishes - pPrevious->publishes ) / interval;
+    ackRate = ( double ) ( pTotal->pubacks - pPrevious->pubacks ) / interval;
+
+    if( config.json )
+    {
+        printf( "{\"type\":\"%s\",\"t\":%.1f,\"online\":%llu,\"publish_per_s\":%.1f,\"puback_per_s\":%.1f,"
+                "\"puback_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f},"
+                "\"connect_attempts\":%llu,\"connects\":%llu,\"connect_failures\":%llu,"
+                "\"drops\":%llu,\"planned_disconnects\":%llu,\"publishes\":%llu,\"pubacks\":%llu,"
+                "\"ack_lost\":%llu,\"tx_overflows\":%llu",
+                final ? "summary" : "interval",
+                elapsed,
+                ( unsigned long long ) pTotal->online,
+                publishRate,
+                ackRate,
+                histPercentile( pBuckets, acks, 0.50 ) / 1000.0,
+                histPercentile( pBuckets, acks, 0.90 ) / 1000.0,
+                histPercentile( pBuckets, acks, 0.99 ) / 1000.0,
+                histPercentile( pBuckets, acks, 0.999 ) / 1000.0,
+                ( unsigned long long ) pTotal->connectAttempts,
+                ( unsigned long long ) pTotal->connects,
+                ( unsigned long long ) pTotal->connectFailures,
+                ( unsigned long long ) pTotal->drops,
+                ( unsigned long long ) pTotal->plannedDisconnects,
+                ( unsigned long long ) pTotal->publishes,
+                ( unsigned long long ) pTotal->pubacks,
+                ( unsigned long long ) pTotal->ackLost,
+                ( unsigned long long ) pTotal->txOverflows );
+
+        if( pTlsContext != NULL )
+        {
+            printf( ",\"handshakes\":%llu,\"resumed\":%llu,"
+                    "\"full_handshake_ms\":{\"p50\":%.3f,\"p99\":%.3f},"
+                    "\"resumed_handshake_ms\":{\"p50\":%.3f,\"p99\":%.3f}",
+                    ( unsigned long long ) pTotal->handshakes,
+                    ( unsigned long long ) pTotal->resumed,
+                    histPercentile( pFull, fulls, 0.50 ) / 1000.0,
+                    histPercentile( pFull, fulls, 0.99 ) / 1000.0,
+                    histPercentile( pResumed, resumes, 0.50 ) / 1000.0,
+                    histPercentile( pResumed, resumes, 0.99 ) / 1000.0 );
+        }
+
+        printf( "}\n" );
+    }
+    else
+    {
+        printf( "%s%7.1fs online %6llu  pub/s %8.1f  ack/s %8.1f  "
+                "ack ms p50 %7.2f p99 %7.2f p99.9 %7.2f  "
+                "conn %llu fail %llu drop %llu churn %llu lost %llu ovf %llu",
+                final ? "total " : "",
+                elapsed,
+                ( unsigned long long ) pTotal->online,
+                publishRate,
+                ackRate,
+                histPercentile( pBuckets, acks, 0.50 ) / 1000.0,
+                histPercentile( pBuckets, acks, 0.99 ) / 1000.0,
+                histPercentile( pBuckets, acks, 0.999 ) / 1000.0,
+                ( unsigned long long ) pTotal->connects,
+                ( unsigned long long ) pTotal->connectFailures,
+                ( unsigned long long ) pTotal->drops,
+                ( unsigned long long ) pTotal->plannedDisconnects,
+                ( unsigned long long ) pTotal->ackLost,
+                ( unsigned long long ) pTotal->txOverflows );
+
+        if( pTlsContext != NULL )
+        {
+            printf( "  tls %llu resumed %llu  hs ms full p50 %.2f p99 %.2f resumed p50 %.2f p99 %.2f",
+                    ( unsigned long long ) pTotal->handshakes,
+                    ( unsigned long long ) pTotal->resumed,
+                    histPercentile( pFull, fulls, 0.50 ) / 1000.0,
+                    histPercentile( pFull, fulls, 0.99 ) / 1000.0,
+                    histPercentile( pResumed, resumes, 0.50 ) / 1000.0,
+                    histPercentile( pResumed, resumes, 0.99 ) / 1000.0 );
+        }
+
+        printf( "\n" );
+    }
+
+    fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+static void onSignal( int signalNumber )
+{
+    ( void ) signalNumber;
+    stopRequested = 1;
+}
+
+/* The TLS context shared by every device. */
+static bool setUpTls( void )
+{
+    pTlsContext = SSL_CTX_new( TLS_client_method() );
+
+    if( ( pTlsContext == NULL ) ||
+        ( SSL_CTX_load_verify_locations( pTlsContext, config.pCaFile, NULL ) != 1 ) ||
+        ( ( config.pCertFile != NULL ) &&
+          ( ( SSL_CTX_use_certificate_chain_file( pTlsContext, config.pCertFile ) != 1 ) ||
+            ( SSL_CTX_use_PrivateKey_file( pTlsContext, config.pKeyFile, SSL_FILETYPE_PEM ) != 1 ) ||
+            ( SSL_CTX_check_private_key( pTlsContext ) != 1 ) ) ) )
+    {
+        ERR_print_errors_fp( stderr );
+        return false;
+    }
+
+    SSL_CTX_set_verify( pTlsContext, SSL_VERIFY_PEER, NULL );
+
+    /* The transmit buffer moves down as it drains. */
+    SSL_CTX_set_mode( pTlsContext, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER );
+
+    /* Each device keeps its own session, as a device would, and nothing
+     * is shared through the cache of the context. */
+    if( config.resume )
+    {
+        SSL_CTX_set_session_cache_mode( pTlsContext, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+        SSL_CTX_sess_set_new_cb( pTlsContext, onNewSession );
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode( pTlsContext, SSL_SESS_CACHE_OFF );
+    }
+
+    return true;
+}
+
+static void usage( const char * pProgram )
+{
+    fprintf( stderr,
+             "usage: %s [options]\n"
+             "  -h host      broker address (%s)\n"
+             "  -p port      broker port (%s, 8883 with TLS)\n"
+             "  -C file      CA of the broker, PEM: connect over TLS\n"
+             "  -E file      device certificate, PEM, for mutual TLS\n"
+             "  -K file      key of the device certificate, PEM\n"
+             "  -R           resume the session of the last connection\n"
+             "  -n count     virtual devices (%d)\n"
+             "  -T threads   worker threads (%d)\n"
+             "  -i prefix    client identifier prefix (%s)\n"
+             "  -t topic     publish topic (%s)\n"
+             "  -u           append /<client id> to the topic\n"
+             "  -q qos       0 or 1 (%d)\n"
+             "  -s ms        sampling period (%d)\n"
+             "  -j ms        sampling jitter, +/- (%d)\n"
+             "  -v rate      vibration edges per device per minute (%.1f)\n"
+             "  -c seconds   mean connection lifetime, 0 = no churn (%.0f)\n"
+             "  -r rate      connections opened per second at start (%.0f)\n"
+             "  -k seconds   keep alive (%d)\n"
+             "  -d seconds   run time, 0 = until interrupted (%d)\n"
+             "  -I seconds   report interval (%d)\n"
+             "  -S seed      random seed (%u)\n"
+             "  -J           JSON lines output\n",
+             pProgram, config.pHost, config.pPort, config.devices, config.threads,
+             config.pClientPrefix, config.pTopic, config.qos, config.sampleMs,
+             config.jitterMs, config.vibrationsPerMinute, config.churnSeconds,
+             config.rampPerSecond, config.keepAliveSeconds, config.durationSeconds,
+             config.intervalSeconds, config.seed );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    struct addrinfo hints = { 0 };
+    Worker_t * pWorkers;
+    Device_t * pDevices;
+    Device_t * pDevice;
+    Worker_t * pWorker;
+    Stats_t total, previous;
+    uint64_t now, lastReport;
+    int option, i, status;
+    bool portGiven = false;
+
+    while( ( option = getopt( argc, argv, "h:p:C:E:K:Rn:T:i:t:uq:s:j:v:c:r:k:d:I:S:J" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'h': config.pHost = optarg; break;
+            case 'p': config.pPort = optarg; portGiven = true; break;
+            case 'C': config.pCaFile = optarg; break;
+            case 'E': config.pCertFile = optarg; break;
+            case 'K': config.pKeyFile = optarg; break;
+            case 'R': config.resume = true; break;
+            case 'n': config.devices = atoi( optarg ); break;
+            case 'T': config.threads = atoi( optarg ); break;
+            case 'i': config.pClientPrefix = optarg; break;
+            case 't': config.pTopic = optarg; break;
+            case 'u': config.topicPerDevice = true; break;
+            case 'q': config.qos = atoi( optarg ); break;
+            case 's': config.sampleMs = atoi( optarg ); break;
+            case 'j': config.jitterMs = atoi( optarg ); break;
+            case 'v': config.vibrationsPerMinute = atof( optarg ); break;
+            case 'c': config.churnSeconds = atof( optarg ); break;
+            case 'r': config.rampPerSecond = atof( optarg ); break;
+            case 'k': config.keepAliveSeconds = atoi( optarg ); break;
+            case 'd': config.durationSeconds = atoi( optarg ); break;
+            case 'I': config.intervalSeconds = atoi( optarg ); break;
+            case 'S': config.seed = ( uint32_t ) strtoul( optarg, NULL, 0 ); break;
+            case 'J': config.json = true; break;
+            default: usage( argv[ 0 ] ); return 2;
+        }
+    }
+
+    if( ( config.devices < 1 ) || ( config.threads < 1 ) || ( config.qos < 0 ) || ( config.qos > 1 ) ||
+        ( config.sampleMs < 1 ) || ( config.jitterMs < 0 ) || ( config.rampPerSecond <= 0.0 ) ||
+        ( config.intervalSeconds < 1 ) || ( strlen( config.pClientPrefix ) > 16 ) ||
+        ( ( config.pCaFile == NULL ) && ( ( config.pCertFile != NULL ) || config.resume ) ) ||
+        ( ( config.pCertFile == NULL ) != ( config.pKeyFile == NULL ) ) )
+    {
+        usage( argv[ 0 ] );
+        return 2;
+    }
+
+    if( config.pCaFile != NULL )
+    {
+        if( setUpTls() == false )
+        {
+            return 1;
+        }
+
+        if( portGiven == false )
+        {
+            config.pPort = "8883";
+        }
+    }
+
+    if( config.threads > config.devices )
+    {
+        config.threads = config.devices;
+    }
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    status = getaddrinfo( config.pHost, config.pPort, &hints, &pBrokerAddress );
+
+    if( status != 0 )
+    {
+        fprintf( stderr, "%s: %s\n", config.pHost, gai_strerror( status ) );
+        return 1;
+    }
+
+    signal( SIGINT, onSignal );
+    signal( SIGTERM, onSignal );
+    signal( SIGPIPE, SIG_IGN );
+
+    pWorkers = calloc( ( size_t ) config.threads, sizeof( Worker_t ) );
+    pDevices = calloc( ( size_t ) config.devices, sizeof( Device_t ) );
+
+    if( ( pWorkers == NULL ) || ( pDevices == NULL ) )
+    {
+        fprintf( stderr, "out of memory\n" );
+        return 1;
+    }
+
+    startTime = nowUs();
+
+    /* Devices are split into contiguous blocks, one per worker. */
+    for( i = 0; i < config.threads; i++ )
+    {
+        pWorker = &( pWorkers[ i ] );
+        pWorker->epollFd = epoll_create1( 0 );
+        pWorker->pDevices = &( pDevices[ ( size_t ) i * config.devices / config.threads ] );
+        pWorker->deviceCount = ( int ) ( ( size_t ) ( i + 1 ) * config.devices / config.threads -
+                                         ( size_t ) i * config.devices / config.threads );
+        pWorker->pHeap = calloc( ( size_t ) pWorker->deviceCount, sizeof( Device_t * ) );
+
+        if( ( pWorker->epollFd < 0 ) || ( pWorker->pHeap == NULL ) )
+        {
+            fprintf( stderr, "worker setup failed\n" );
+            return 1;
+        }
+    }
+
+    for( i = 0; i < config.devices; i++ )
+    {
+        pDevice = &( pDevices[ i ] );
+        pWorker = &( pWorkers[ ( size_t ) i * config.threads / config.devices ] );
+
+        /* Blocks are contiguous, so map back by range. */
+        while( pDevice >= pWorker->pDevices + pWorker->deviceCount )
+        {
+            pWorker++;
+        }
+
+        pDevice->index = i;
+        pDevice->fd = -1;
+        pDevice->state = DEVICE_IDLE;
+        pDevice->backoffMs = MIN_BACKOFF_MS;
+        pDevice->random = ( config.seed * 2654435761U ) ^ ( ( uint32_t ) i * 40503U + 0x9E3779B9U );
+
+        if( pDevice->random == 0 )
+        {
+            pDevice->random = 1;
+        }
+
+        snprintf( pDevice->clientId, sizeof( pDevice->clientId ), "%s%d", config.pClientPrefix, i );
+
+        if( config.topicPerDevice )
+        {
+            snprintf( pDevice->topic, sizeof( pDevice->topic ), "%s/%s", config.pTopic, pDevice->clientId );
+        }
+        else
+        {
+            snprintf( pDevice->topic, sizeof( pDevice->topic ), "%s", config.pTopic );
+        }
+
+        /* Ramp up the initial connections. */
+        pDevice->reconnectAt = startTime + ( uint64_t ) ( ( double ) i * 1e6 / config.rampPerSecond );
+        pDevice->deadline = pDevice->reconnectAt;
+        pDevice->heapIndex = pWorker->heapSize;
+        pWorker->pHeap[ pWorker->heapSize++ ] = pDevice;
+    }
+
+    for( i = 0; i < config.threads; i++ )
+    {
+        pthread_create( &( pWorkers[ i ].thread ), NULL, workerMain, &( pWorkers[ i ] ) );
+    }
+
+    memset( &previous, 0, sizeof( previous ) );
+    lastReport = startTime;
+
+    while( stopRequested == 0 )
+    {
+        usleep( 50000 );
+        now = nowUs();
+
+        if( now - lastReport >= ( uint64_t ) config.intervalSeconds * 1000000ULL )
+        {
+            sumStats( pWorkers, &total );
+            report( &total, &previous, ( double ) ( now - startTime ) / 1e6,
+                    ( double ) ( now - lastReport ) / 1e6, false );
+            previous = total;
+            lastReport = now;
+        }
+
+        if( ( config.durationSeconds > 0 ) &&
+            ( now - startTime >= ( uint64_t ) config.durationSeconds * 1000000ULL ) )
+        {
+            stopRequested = 1;
+        }
+    }
+
+    for( i = 0; i < config.threads; i++ )
+    {
+        pthread_join( pWorkers[ i ].thread, NULL );
+    }
+
+    now = nowUs();
+    sumStats( pWorkers, &total );
+    memset( &previous, 0, sizeof( previous ) );
+    report( &total, &previous, ( double ) ( now - startTime ) / 1e6,
+            ( double ) ( now - startTime ) / 1e6, true );
+
+    freeaddrinfo( pBrokerAddress );
+    SSL_CTX_free( pTlsContext );
+
+    return 0;
+}
@@ -0,0 +1,762 @@
+/*
+ * ggd_parser_check - check the streaming parser of the Greengrass discovery
+ * document against what the documents it is fed hold.
+ *
+ * The parser (demos/greengrass_connectivity/aws_ggd_parser.h) is compiled
+ * into this program. Random discovery documents of several KB are built
+ * with what the parser must extract recorded alongside: groups beyond
+ * ggdprobeMAX_GROUPS, endpoints beyond ggdprobeMAX_CANDIDATES, CA bundles
+ * with \n, \/, \" and \u escapes, ports as numbers and as strings, invalid
+ * ports and hosts, groups without a CA, and fields the parser must skip
+ * holding the same keys, nested containers and every kind of primitive.
+ *
+ * Each document is fed whole, split in two at every byte, and in random
+ * chunks of 1 to 300 bytes, so that every string, escape, \u sequence and
+ * number is also split between chunks; the list must be the same each
+ * time. Every proper prefix of the document must fail GGDParser_Finish,
+ * as a truncated download does, and documents with a bad close, trailing
+ * text or a certificate over ggdparserMAX_CERTIFICATE_SIZE must fail too.
+ * Every allocation of the parser must be released after each parse.
+ *
+ * Any failure is printed and the program exits with status 1.
+ *
+ * Build:
+ *     cc -O2 -I../host/include \
+ *         -I../Lab3/AmazonFreeRTOS/vendors/espressif/boards/esp32/aws_demos/config_files \
+ *         -I../Lab3/AmazonFreeRTOS/demos/greengrass_connectivity \
+ *         -o ggd_parser_check ggd_parser_check.c
+ *
+ * Examples:
+ *     ./ggd_parser_check
+ *     ./ggd_parser_check -n 2000 -s 7
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The parser's allocations are counted. */
+static long outstanding;
+
+static void * countedMalloc( size_t size )
+{
+    outstanding++;
+
+    return malloc( size );
+}
+
+static void countedFree( void * pointer )
+{
+    outstanding--;
+    free( pointer );
+}
+
+#define ggdparserMALLOC    countedMalloc
+#define ggdparserFREE      countedFree
+
+#include "aws_ggd_parser.h"
+#include "../Lab3/AmazonFreeRTOS/demos/greengrass_connectivity/aws_ggd_parser.c"
+
+#define MAX_DOCUMENT               ( 64 * 1024 )
+#define DOCUMENT_GROUPS            ( ggdprobeMAX_GROUPS + 1 )
+
+/*-----------------------------------------------------------*/
+
+/* A document and what the parser must make of it. */
+typedef struct Document
+{
+    char text[ MAX_DOCUMENT ];
+    size_t length;
+
+    GGDCandidate_t candidates[ ggdprobeMAX_CANDIDATES ];
+    size_t candidateCount;
+    char certificates[ ggdprobeMAX_GROUPS ][ ggdparserMAX_CERTIFICATE_SIZE ];
+    size_t certificateLengths[ ggdprobeMAX_GROUPS ];
+    bool hasCertificate[ ggdprobeMAX_GROUPS ];
+} Document_t;
+
+static uint32_t randomState = 1;
+static unsigned failures;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( void )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool fail( unsigned document,
+                  const char * pFormat,
+                  ... )
+{
+    va_list arguments;
+
+    if( failures++ < 20 )
+    {
+        printf( "FAIL document %u: ", document );
+        va_start( arguments, pFormat );
+        vprintf( pFormat, arguments );
+        va_end( arguments );
+        printf( "\n" );
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static void emit( Document_t * pDocument,
+                  const char * pFormat,
+                  ... )
+{
+    va_list arguments;
+    int written;
+
+    va_start( arguments, pFormat );
+    written = vsnprintf( pDocument->text + pDocument->length,
+                         MAX_DOCUMENT - pDocument->length, pFormat, arguments );
+    va_end( arguments );
+
+    if( ( written < 0 ) || ( ( size_t ) written >= MAX_DOCUMENT - pDocument->length ) )
+    {
+        fprintf( stderr, "document too long\n" );
+        exit( 2 );
+    }
+
+    pDocument->length += ( size_t ) written;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Whitespace between tokens, as pretty printers leave it. */
+static void space( Document_t * pDocument )
+{
+    static const char * const spaces[] = { "", "", "", " ", "\n  ", "\r\n\t", "  " };
+
+    emit( pDocument, "%s", spaces[ nextRandom() % ( sizeof( spaces ) / sizeof( spaces[ 0 ] ) ) ] );
+}
+
+/*-----------------------------------------------------------*/
+
+/* A value the parser must skip: any primitive, a string with escapes, or
+ * a container holding keys it does extract elsewhere. */
+static void skippedValue( Document_t * pDocument,
+                          int depth )
+{
+    static const char * const primitives[] =
+    {
+        "true", "false", "null", "0", "-12", "3.25e+2", "1E-7", "8883", "\"8883\"",
+        "\"caf\\u00e9 \\\"quoted\\\" back\\\\slash \\/path\"", "\"\\u0048ostAddress\""
+    };
+
+    switch( ( depth > 2 ) ? 0 : nextRandom() % 3 )
+    {
+        case 0:
+            emit( pDocument, "%s", primitives[ nextRandom() % ( sizeof( primitives ) / sizeof( primitives[ 0 ] ) ) ] );
+            break;
+
+        case 1:
+            emit( pDocument, "{" );
+            space( pDocument );
+            emit( pDocument, "\"HostAddress\":" );
+            space( pDocument );
+            emit( pDocument, "\"10.9.9.9\",\"PortNumber\":1,\"CAs\":[\"not a CA\"],\"Nested\":" );
+            skippedValue( pDocument, depth + 1 );
+            space( pDocument );
+            emit( pDocument, "}" );
+            break;
+
+        default:
+            emit( pDocument, "[" );
+            skippedValue( pDocument, depth + 1 );
+            emit( pDocument, "," );
+            space( pDocument );
+            skippedValue( pDocument, depth + 1 );
+            emit( pDocument, "]" );
+            break;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* One CA of a group: a PEM block of a random number of base64 lines,
+ * escaped as the discovery service escapes it, and the decoded text. */
+static void certificate( Document_t * pDocument,
+                         char * pDecoded,
+                         size_t * pDecodedLength,
+                         size_t lines )
+{
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char line[ 65 ];
+    size_t i, j, length;
+
+    /* A comment line with the escapes that do not occur in base64. */
+    emit( pDocument, "# Issuer: \\\"Caf\\u00E9\\\" \\\\ CA\\n-----BEGIN CERTIFICATE-----\\n" );
+    length = ( size_t ) sprintf( pDecoded + *pDecodedLength,
+                                 "# Issuer: \"Caf?\" \\ CA\n-----BEGIN CERTIFICATE-----\n" );
+    *pDecodedLength += length;
+
+    for( i = 0; i < lines; i++ )
+    {
+        length = ( i + 1 < lines ) ? 64 : 4 + nextRandom() % 60;
+
+        for( j = 0; j < length; j++ )
+        {
+            line[ j ] = base64[ nextRandom() % 64 ];
+        }
+
+        line[ length ] = '\0';
+        memcpy( pDecoded + *pDecodedLength, line, length );
+        *pDecodedLength += length;
+        pDecoded[ ( *pDecodedLength )++ ] = '\n';
+
+        /* The service escapes '/', though JSON does not require it. */
+        for( j = 0; j < length; j++ )
+        {
+            if( ( line[ j ] == '/' ) && ( nextRandom() & 1 ) )
+            {
+                emit( pDocument, "\\/" );
+            }
+            else
+            {
+                emit( pDocument, "%c", line[ j ] );
+            }
+        }
+
+        emit( pDocument, "\\n" );
+    }
+
+    emit( pDocument, "-----END CERTIFICATE-----\\n" );
+    length = ( size_t ) sprintf( pDecoded + *pDecodedLength, "-----END CERTIFICATE-----\n" );
+    *pDecodedLength += length;
+}
+
+/*-----------------------------------------------------------*/
+
+/* One endpoint of a core; records it if the parser must keep it. */
+static void endpoint( Document_t * pDocument,
+                      size_t group,
+                      size_t * pKept )
+{
+    char host[ 128 ];
+    unsigned long port = 1 + nextRandom() % 65535;
+    uint32_t kind = nextRandom() % 12;
+    bool valid = true;
+    size_t i;
+
+    snprintf( host, sizeof( host ), "10.%u.%u.%u",
+              ( unsigned ) ( nextRandom() % 256 ), ( unsigned ) ( nextRandom() % 256 ),
+              ( unsigned ) ( nextRandom() % 256 ) );
+
+    emit( pDocument, "{" );
+    space( pDocument );
+    emit( pDocument, "\"Id\":\"ep-%u\",", ( unsigned ) ( nextRandom() % 1000 ) );
+    space( pDocument );
+
+    switch( kind )
+    {
+        case 0: /* No port. */
+            emit( pDocument, "\"HostAddress\":\"%s\"", host );
+            valid = false;
+            break;
+
+        case 1: /* No host. */
+            emit( pDocument, "\"PortNumber\":%lu", port );
+            valid = false;
+            break;
+
+        case 2: /* Port out of range. */
+            emit( pDocument, "\"HostAddress\":\"%s\",\"PortNumber\":%s", host, ( nextRandom() & 1 ) ? "0" : "70000" );
+            valid = false;
+            break;
+
+        case 3: /* A host longer than is kept. */
+
+            for( i = 0; i < ggdprobeMAX_HOST_ADDRESS_LENGTH + 8; i++ )
+            {
+                host[ i ] = 'a' + ( char ) ( i % 26 );
+            }
+
+            host[ i ] = '\0';
+            emit( pDocument, "\"HostAddress\":\"%s\",\"PortNumber\":%lu", host, port );
+            valid = false;
+            break;
+
+        case 4: /* The port as a string, after the host. */
+            emit( pDocument, "\"HostAddress\":\"%s\",\"PortNumber\":\"%lu\"", host, port );
+            break;
+
+        case 5: /* An escaped host, and the port first. */
+            snprintf( host, sizeof( host ), "core-%u.example\\/x", ( unsigned ) ( nextRandom() % 100 ) );
+            emit( pDocument, "\"PortNumber\":%lu,", port );
+            space( pDocument );
+            emit( pDocument, "\"HostAddress\":\"%s\"", host );
+            memmove( strstr( host, "\\/" ), strstr( host, "\\/" ) + 1, strlen( strstr( host, "\\/" ) ) );
+            break;
+
+        case 6: /* The longest host that is kept. */
+
+            for( i = 0; i < ggdprobeMAX_HOST_ADDRESS_LENGTH - 1; i++ )
+            {
+                host[ i ] = 'A' + ( char ) ( i % 26 );
+            }
+
+            host[ i ] = '\0';
+            emit( pDocument, "\"HostAddress\":\"%s\",\"PortNumber\":%lu", host, port );
+            break;
+
+        default:
+            emit( pDocument, "\"HostAddress\":\"%s\",", host );
+            space( pDocument );
+            emit( pDocument, "\"PortNumber\":%lu", port );
+            break;
+    }
+
+    emit( pDocument, ",\"Metadata\":" );
+    skippedValue( pDocument, 0 );
+    space( pDocument );
+    emit( pDocument, "}" );
+
+    /* The parser keeps endpoints of the first groups in document order until
+     * the list is full; Finish drops those of groups without a CA. */
+    if( valid && ( group < ggdprobeMAX_GROUPS ) && ( *pKept < ggdprobeMAX_CANDIDATES ) )
+    {
+        GGDCandidate_t * pCandidate = &( pDocument->candidates[ ( *pKept )++ ] );
+
+        memset( pCandidate, 0, sizeof( GGDCandidate_t ) );
+        strcpy( pCandidate->cHostAddress, host );
+        pCandidate->usPort = ( uint16_t ) port;
+        pCandidate->ucGroup = ( uint8_t ) group;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void build( Document_t * pDocument,
+                   size_t certificateLines )
+{
+    size_t groups = 1 + nextRandom() % DOCUMENT_GROUPS;
+    size_t group, core, cores, endpoints, i, count, cas, kept = 0, write = 0;
+    bool casFirst;
+    char * pDecoded;
+    size_t * pDecodedLength;
+    static char discard[ ggdparserMAX_CERTIFICATE_SIZE * 4 ];
+    size_t discardLength;
+
+    memset( pDocument->hasCertificate, 0, sizeof( pDocument->hasCertificate ) );
+    memset( pDocument->certificateLengths, 0, sizeof( pDocument->certificateLengths ) );
+    pDocument->length = 0;
+
+    emit( pDocument, "{" );
+    space( pDocument );
+
+    if( nextRandom() & 1 )
+    {
+        emit( pDocument, "\"VeryLongKeyThatIsSkipped\":" );
+        skippedValue( pDocument, 0 );
+        emit( pDocument, "," );
+    }
+
+    emit( pDocument, "\"GGGroups\":" );
+    space( pDocument );
+    emit( pDocument, "[" );
+
+    for( group = 0; group < groups; group++ )
+    {
+        emit( pDocument, "%s{", ( group > 0 ) ? "," : "" );
+        space( pDocument );
+        emit( pDocument, "\"GGGroupId\":\"group-%zu\",", group );
+        space( pDocument );
+
+        if( group < ggdprobeMAX_GROUPS )
+        {
+            pDecoded = pDocument->certificates[ group ];
+            pDecodedLength = &( pDocument->certificateLengths[ group ] );
+        }
+        else
+        {
+            discardLength = 0;
+            pDecoded = discard;
+            pDecodedLength = &discardLength;
+        }
+
+        /* The CAs come before or after the cores; a group may have none. */
+        cas = nextRandom() % 5;
+        cas = ( cas == 0 ) ? 0 : ( cas < 4 ) ? 1 : 2;
+        casFirst = ( nextRandom() & 1 ) != 0;
+
+        for( i = 0; i < 2; i++ )
+        {
+            if( ( i == 0 ) == casFirst )
+            {
+                emit( pDocument, "\"CAs\":[" );
+
+                for( count = 0; count < cas; count++ )
+                {
+                    emit( pDocument, "%s\"", ( count > 0 ) ? "," : "" );
+                    certificate( pDocument, pDecoded, pDecodedLength, certificateLines );
+                    emit( pDocument, "\"" );
+                }
+
+                emit( pDocument, "]," );
+                space( pDocument );
+
+                if( ( group < ggdprobeMAX_GROUPS ) && ( cas > 0 ) )
+                {
+                    pDocument->hasCertificate[ group ] = true;
+                }
+            }
+            else
+            {
+                emit( pDocument, "\"Cores\":" );
+                space( pDocument );
+                emit( pDocument, "[" );
+                cores = nextRandom() % 4;
+
+                for( core = 0; core < cores; core++ )
+                {
+                    emit( pDocument, "%s{\"thingArn\":\"arn:aws:iot:eu-west-1:000000000000:thing\\/Core%zu\",",
+                          ( core > 0 ) ? "," : "", core );
+                    space( pDocument );
+                    emit( pDocument, "\"Connectivity\":[" );
+                    count = nextRandom() % 4;
+
+                    for( endpoints = 0; endpoints < count; endpoints++ )
+                    {
+                        if( endpoints > 0 )
+                        {
+                            emit( pDocument, "," );
+                            space( pDocument );
+                        }
+
+                        endpoint( pDocument, group, &kept );
+                    }
+
+                    emit( pDocument, "]" );
+                    space( pDocument );
+                    emit( pDocument, "}" );
+                }
+
+                emit( pDocument, "]," );
+                space( pDocument );
+            }
+        }
+
+        emit( pDocument, "\"Extra\":" );
+        skippedValue( pDocument, 0 );
+        space( pDocument );
+        emit( pDocument, "}" );
+    }
+
+    emit( pDocument, "]" );
+    space( pDocument );
+    emit( pDocument, "}" );
+    space( pDocument );
+
+    /* What Finish keeps. */
+    for( i = 0; i < kept; i++ )
+    {
+        if( pDocument->hasCertificate[ pDocument->candidates[ i ].ucGroup ] )
+        {
+            pDocument->candidates[ write++ ] = pDocument->candidates[ i ];
+        }
+    }
+
+    pDocument->candidateCount = write;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Feed the document in the given chunks, and compare the list. */
+static bool parse( unsigned number,
+                   const Document_t * pDocument,
+                   const size_t * pChunks,
+                   size_t chunkCount,
+                   const char * pHow )
+{
+    GGDParser_t parser;
+    GGDCandidateList_t list;
+    BaseType_t result = pdPASS;
+    size_t offset = 0, i, group;
+    bool ok = true;
+
+    GGDParser_Init( &parser, &list );
+
+    for( i = 0; ( i < chunkCount ) && ( result == pdPASS ); i++ )
+    {
+        result = GGDParser_Feed( &parser, pDocument->text + offset, pChunks[ i ] );
+        offset += pChunks[ i ];
+    }
+
+    if( result != pdPASS )
+    {
+        ok = fail( number, "%s: Feed failed at byte %zu", pHow, offset );
+    }
+
+    result = GGDParser_Finish( &parser );
+
+    if( ( result == pdPASS ) != ( pDocument->candidateCount > 0 ) )
+    {
+        ok = fail( number, "%s: Finish returned %s with %zu endpoints expected", pHow,
+                   ( result == pdPASS ) ? "pdPASS" : "pdFAIL", pDocument->candidateCount );
+    }
+    else if( list.xCount != pDocument->candidateCount )
+    {
+        ok = fail( number, "%s: %zu endpoints, expected %zu", pHow, list.xCount, pDocument->candidateCount );
+    }
+
+    for( i = 0; ok && ( i < list.xCount ); i++ )
+    {
+        const GGDCandidate_t * pGot = &( list.xCandidates[ i ] );
+        const GGDCandidate_t * pExpected = &( pDocument->candidates[ i ] );
+
+        if( ( strcmp( pGot->cHostAddress, pExpected->cHostAddress ) != 0 ) ||
+            ( pGot->usPort != pExpected->usPort ) || ( pGot->ucGroup != pExpected->ucGroup ) ||
+            ( list.ucRanked[ i ] != i ) )
+        {
+            ok = fail( number, "%s: endpoint %zu is %s:%u of group %u, expected %s:%u of group %u",
+                       pHow, i, pGot->cHostAddress, pGot->usPort, pGot->ucGroup,
+                       pExpected->cHostAddress, pExpected->usPort, pExpected->ucGroup );
+        }
+    }
+
+    for( group = 0; ok && ( result == pdPASS ) && ( group < ggdprobeMAX_GROUPS ); group++ )
+    {
+        if( !pDocument->hasCertificate[ group ] )
+        {
+            if( list.pcCertificates[ group ] != NULL )
+            {
+                ok = fail( number, "%s: group %zu has a CA it was not given", pHow, group );
+            }
+        }
+        else if( ( list.pcCertificates[ group ] == NULL ) ||
+                 ( list.ulCertificateSizes[ group ] != pDocument->certificateLengths[ group ] + 1 ) ||
+                 ( memcmp( list.pcCertificates[ group ], pDocument->certificates[ group ],
+                           pDocument->certificateLengths[ group ] ) != 0 ) ||
+                 ( list.pcCertificates[ group ][ pDocument->certificateLengths[ group ] ] != '\0' ) )
+        {
+            ok = fail( number, "%s: the CA of group %zu differs (%u bytes, expected %zu)", pHow, group,
+                       ( unsigned ) list.ulCertificateSizes[ group ], pDocument->certificateLengths[ group ] + 1 );
+        }
+    }
+
+    GGDParser_FreeList( &list );
+
+    if( outstanding != 0 )
+    {
+        ok = fail( number, "%s: %ld allocations not released", pHow, outstanding );
+        outstanding = 0;
+    }
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Feed bytes that must not make a complete document. */
+static bool reject( unsigned number,
+                    const char * pText,
+                    size_t length,
+                    size_t chunk,
+                    const char * pHow )
+{
+    GGDParser_t parser;
+    GGDCandidateList_t list;
+    size_t offset;
+    bool ok = true;
+
+    GGDParser_Init( &parser, &list );
+
+    for( offset = 0; offset < length; offset += chunk )
+    {
+        ( void ) GGDParser_Feed( &parser, pText + offset, ( length - offset < chunk ) ? length - offset : chunk );
+    }
+
+    if( ( GGDParser_Finish( &parser ) != pdFAIL ) || ( list.xCount != 0 ) )
+    {
+        ok = fail( number, "%s: accepted", pHow );
+    }
+
+    GGDParser_FreeList( &list );
+
+    if( outstanding != 0 )
+    {
+        ok = fail( number, "%s: %ld allocations not released", pHow, outstanding );
+        outstanding = 0;
+    }
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkDocument( unsigned number,
+                           Document_t * pDocument )
+{
+    static size_t chunks[ MAX_DOCUMENT ];
+    static char damaged[ MAX_DOCUMENT ];
+    char how[ 64 ];
+    size_t split, count, offset, size;
+    bool ok = true;
+
+    chunks[ 0 ] = pDocument->length;
+    ok = parse( number, pDocument, chunks, 1, "whole" ) && ok;
+
+    for( split = 1; ok && ( split < pDocument->length ); split++ )
+    {
+        chunks[ 0 ] = split;
+        chunks[ 1 ] = pDocument->length - split;
+        snprintf( how, sizeof( how ), "split at %zu", split );
+        ok = parse( number, pDocument, chunks, 2, how ) && ok;
+    }
+
+    for( size = 0; ok && ( size < 8 ); size++ )
+    {
+        for( count = 0, offset = 0; offset < pDocument->length; count++ )
+        {
+            chunks[ count ] = 1 + nextRandom() % ( ( size == 0 ) ? 1 : 300 );
+
+            if( chunks[ count ] > pDocument->length - offset )
+            {
+                chunks[ count ] = pDocument->length - offset;
+            }
+
+            offset += chunks[ count ];
+        }
+
+        snprintf( how, sizeof( how ), "%s chunks", ( size == 0 ) ? "1-byte" : "random" );
+        ok = parse( number, pDocument, chunks, count, how ) && ok;
+    }
+
+    /* A download cut short anywhere; the last byte of the document closes
+     * its root unless whitespace follows. */
+    size = pDocument->length;
+
+    while( ( size > 0 ) && prvIsWhitespace( pDocument->text[ size - 1 ] ) )
+    {
+        size--;
+    }
+
+    for( split = 0; ok && ( split < size ); split++ )
+    {
+        snprintf( how, sizeof( how ), "truncated to %zu", split );
+        ok = reject( number, pDocument->text, split, 1 + split % 97, how ) && ok;
+    }
+
+    memcpy( damaged, pDocument->text, size );
+    damaged[ size - 1 ] = ']';
+    ok = reject( number, damaged, size, 256, "closed with ]" ) && ok;
+
+    damaged[ size - 1 ] = '}';
+    damaged[ size ] = '{';
+    ok = reject( number, damaged, size + 1, 256, "text after the root" ) && ok;
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+/* A certificate over the limit fails the parse, and its memory is freed. */
+static bool checkCertificateLimit( Document_t * pDocument )
+{
+    size_t lines = ggdparserMAX_CERTIFICATE_SIZE / 65 + 1;
+    GGDParser_t parser;
+    GGDCandidateList_t list;
+    char decoded[ ggdparserMAX_CERTIFICATE_SIZE * 2 ];
+    size_t decodedLength = 0;
+    bool ok = true;
+
+    pDocument->length = 0;
+    emit( pDocument, "{\"GGGroups\":[{\"Cores\":[{\"Connectivity\":[{\"HostAddress\":\"10.0.0.1\",\"PortNumber\":8883}]}]," );
+    emit( pDocument, "\"CAs\":[\"" );
+    certificate( pDocument, decoded, &decodedLength, lines );
+    emit( pDocument, "\"]}]}" );
+
+    GGDParser_Init( &parser, &list );
+
+    if( GGDParser_Feed( &parser, pDocument->text, pDocument->length ) != pdFAIL )
+    {
+        ok = fail( 0, "a CA of %zu bytes was accepted", decodedLength );
+    }
+
+    if( ( GGDParser_Finish( &parser ) != pdFAIL ) || ( list.xCount != 0 ) )
+    {
+        ok = fail( 0, "a document with a CA of %zu bytes was accepted", decodedLength );
+    }
+
+    GGDParser_FreeList( &list );
+
+    if( outstanding != 0 )
+    {
+        ok = fail( 0, "%ld allocations not released after an oversized CA", outstanding );
+        outstanding = 0;
+    }
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    static Document_t document;
+    unsigned long documents = 50;
+    unsigned long number;
+    size_t longest = 0, multiKb = 0, endpoints = 0, cutoffs = 0;
+    char groupId[ 16 ];
+    int option;
+    bool ok = true;
+
+    while( ( option = getopt( argc, argv, "n:s:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                documents = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                randomState = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n documents] [-s seed]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    for( number = 0; number < documents; number++ )
+    {
+        /* CAs of 1 to 30 lines: documents of about 1 to 15 KB. */
+        build( &document, 1 + nextRandom() % 30 );
+        ok = checkDocument( ( unsigned ) number, &document ) && ok;
+
+        longest = ( document.length > longest ) ? document.length : longest;
+        multiKb += ( document.length > 2500 ) ? 1 : 0;
+        endpoints += document.candidateCount;
+        snprintf( groupId, sizeof( groupId ), "\"group-%d\"", ggdprobeMAX_GROUPS );
+        cutoffs += ( strstr( document.text, groupId ) != NULL ) ? 1 : 0;
+    }
+
+    ok = checkCertificateLimit( &document ) && ok;
+
+    printf( "%lu documents up to %zu bytes, %zu over 2500 bytes, %zu endpoints kept, %zu with more than %d groups\n",
+            documents, longest, multiKb, endpoints, cutoffs, ggdprobeMAX_GROUPS );
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*
+ * ggd_probe_check - check the latency ranking and failover of the
+ * Greengrass core probe against real TLS listeners on this host.
+ *
+ * The probe (demos/greengrass_connectivity/aws_ggd_probe.h) is compiled
+ * into this program with the secure sockets and kernel of the host build
+ * (host/), and a round timeout of 1.5 s. The candidates of the list are
+ * broker stand-ins of host/include/host_port.h on 127.0.0.1, each holding
+ * back its TLS handshake by a different delay, and endpoints that cannot
+ * be reached:
+ *     slow     handshake after 400 ms
+ *     fast     handshake at once
+ *     medium   handshake after 150 ms
+ *     refused  a port nobody listens on
+ *     unknown  a host name that does not resolve
+ *     stalled  handshake 100 ms before the round timeout
+ * GGDProbe_Rank must find three healthy, rank them fast, medium, slow with
+ * probe times that cover their delays, and put the other three after them
+ * in document order. GGDProbe_Next must then hand out the candidates in
+ * that order with the certificate of their group, and fail once they are
+ * all used.
+ *
+ * The stalled listener is probed last, once the fast ones are done, so
+ * its handshake completes within the receive timeout but after the round.
+ * A second round right after the first must rank the same: the late,
+ * healthy result of the first round must be ignored.
+ *
+ * Any failure is printed and the program exits with status 1.
+ *
+ * Build (the certificates of the stand-ins come from host/):
+ *     sh ../host/gen_certificates.sh /tmp > /tmp/host_certificates.c
+ *     cc -O2 -pthread -DggdprobeROUND_TIMEOUT_MS=1500UL -DdlogENABLED=0 \
+ *         -I../host/include -I../host/port \
+ *         -I../Lab3/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -I../Lab3/AmazonFreeRTOS/vendors/espressif/boards/esp32/aws_demos/config_files \
+ *         -I../Lab3/AmazonFreeRTOS/demos/greengrass_connectivity \
+ *         -o ggd_probe_check ggd_probe_check.c /tmp/host_certificates.c \
+ *         ../host/port/freertos_posix.c ../host/port/esp_posix.c ../host/port/sockets_posix.c \
+ *         ../host/port/iot_tls.c ../host/port/host_listener.c ../host/port/broker_posix.c \
+ *         ../Lab3/AmazonFreeRTOS/demos/greengrass_connectivity/aws_tls_metrics.c \
+ *         ../Lab3/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/stack_budget.c \
+ *         ../Lab3/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/tls_session_cache.c \
+ *         -l:libmbedtls.so.14 -l:libmbedx509.so.1 -l:libmbedcrypto.so.7
+ *
+ * Examples:
+ *     ./ggd_probe_check
+ *     ./ggd_probe_check -p 19300
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "host_port.h"
+
+#include "aws_ggd_probe.h"
+#include "../Lab3/AmazonFreeRTOS/demos/greengrass_connectivity/aws_ggd_probe.c"
+
+typedef struct Listener
+{
+    const char * pName;
+    const char * pHost;
+    int32_t delayMs;           /* < 0: nothing listens. */
+} Listener_t;
+
+static const Listener_t listeners[] =
+{
+    { "slow",    "127.0.0.1",             400                               },
+    { "fast",    "127.0.0.1",             0                                 },
+    { "medium",  "127.0.0.1",             150                               },
+    { "refused", "127.0.0.1",             -1                                },
+    { "unknown", "core.host.invalid",     0                                 },
+    { "stalled", "127.0.0.1",             ggdprobeROUND_TIMEOUT_MS - 100    },
+};
+
+#define LISTENERS                 ( sizeof( listeners ) / sizeof( listeners[ 0 ] ) )
+
+/* The order GGDProbe_Rank must give, as indices of listeners[]. */
+static const uint8_t expectedRank[ LISTENERS ] = { 1, 2, 0, 3, 4, 5 };
+#define HEALTHY                   ( 3 )
+
+static unsigned failures;
+
+/*-----------------------------------------------------------*/
+
+static bool fail( unsigned round,
+                  const char * pFormat,
+                  ... )
+{
+    va_list arguments;
+
+    if( failures++ < 20 )
+    {
+        printf( "FAIL round %u: ", round );
+        va_start( arguments, pFormat );
+        vprintf( pFormat, arguments );
+        va_end( arguments );
+        printf( "\n" );
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkRound( unsigned round,
+                        GGDCandidateList_t * pList )
+{
+    GGD_HostAddressData_t hostAddressData;
+    const GGDCandidate_t * pCandidate;
+    TickType_t start = xTaskGetTickCount();
+    uint32_t elapsedMs;
+    uint16_t port;
+    size_t healthy, rank;
+    bool ok = true;
+
+    healthy = GGDProbe_Rank( pList );
+    elapsedMs = ( uint32_t ) ( ( xTaskGetTickCount() - start ) * portTICK_PERIOD_MS );
+
+    if( healthy != HEALTHY )
+    {
+        ok = fail( round, "%zu healthy candidates, expected %d", healthy, HEALTHY );
+    }
+
+    /* The stalled probe must not hold the round past its timeout. */
+    if( elapsedMs > ggdprobeROUND_TIMEOUT_MS + 200 )
+    {
+        ok = fail( round, "the round took %u ms, over its timeout of %u ms",
+                   ( unsigned ) elapsedMs, ( unsigned ) ggdprobeROUND_TIMEOUT_MS );
+    }
+
+    for( rank = 0; rank < LISTENERS; rank++ )
+    {
+        pCandidate = &( pList->xCandidates[ pList->ucRanked[ rank ] ] );
+
+        if( pList->ucRanked[ rank ] != expectedRank[ rank ] )
+        {
+            ok = fail( round, "rank %zu is %s, expected %s", rank,
+                       listeners[ pList->ucRanked[ rank ] ].pName, listeners[ expectedRank[ rank ] ].pName );
+        }
+        else if( ( rank < HEALTHY ) &&
+                 ( ( pCandidate->xHealthy != pdTRUE ) ||
+                   ( pCandidate->xProbeTicks * portTICK_PERIOD_MS < ( uint32_t ) listeners[ pList->ucRanked[ rank ] ].delayMs ) ) )
+        {
+            ok = fail( round, "%s probed in %u ms, under its handshake delay",
+                       listeners[ pList->ucRanked[ rank ] ].pName,
+                       ( unsigned ) ( pCandidate->xProbeTicks * portTICK_PERIOD_MS ) );
+        }
+        else if( ( rank >= HEALTHY ) &&
+                 ( ( pCandidate->xHealthy != pdFALSE ) || ( pCandidate->xProbeTicks != portMAX_DELAY ) ) )
+        {
+            ok = fail( round, "%s is healthy", listeners[ pList->ucRanked[ rank ] ].pName );
+        }
+    }
+
+    /* Failover hands out the ranking in order, then nothing. */
+    for( rank = 0; rank < LISTENERS; rank++ )
+    {
+        pCandidate = &( pList->xCandidates[ expectedRank[ rank ] ] );
+
+        if( GGDProbe_Next( pList, &hostAddressData, &port ) != pdPASS )
+        {
+            ok = fail( round, "GGDProbe_Next failed at rank %zu", rank );
+            break;
+        }
+
+        if( ( hostAddressData.pcHostAddress != pCandidate->cHostAddress ) ||
+            ( port != pCandidate->usPort ) ||
+            ( hostAddressData.pcCertificate != pList->pcCertificates[ pCandidate->ucGroup ] ) ||
+            ( hostAddressData.ulCertificateSize != pList->ulCertificateSizes[ pCandidate->ucGroup ] ) )
+        {
+            ok = fail( round, "GGDProbe_Next gave %s:%u at rank %zu, expected %s:%u (%s)", hostAddressData.pcHostAddress,
+                       port, rank, pCandidate->cHostAddress, pCandidate->usPort, listeners[ expectedRank[ rank ] ].pName );
+        }
+    }
+
+    if( GGDProbe_Next( pList, &hostAddressData, &port ) != pdFAIL )
+    {
+        ok = fail( round, "GGDProbe_Next went past the end of the list" );
+    }
+
+    printf( "round %u: %zu healthy in %u ms\n", round, healthy, ( unsigned ) elapsedMs );
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    static GGDCandidateList_t list;
+    unsigned long basePort = 19200;
+    size_t i;
+    int option;
+    bool ok = true;
+
+    while( ( option = getopt( argc, argv, "p:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'p':
+                basePort = strtoul( optarg, NULL, 0 );
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-p first port]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    HostPort_Init();
+
+    /* Two groups with the same CA, so that the certificate handed out can
+     * be told apart by its address. */
+    for( i = 0; i < ggdprobeMAX_GROUPS; i++ )
+    {
+        list.pcCertificates[ i ] = strdup( pcHostCaCertificate );
+        list.ulCertificateSizes[ i ] = ulHostCaCertificateSize;
+    }
+
+    for( i = 0; i < LISTENERS; i++ )
+    {
+        strcpy( list.xCandidates[ i ].cHostAddress, listeners[ i ].pHost );
+        list.xCandidates[ i ].usPort = ( uint16_t ) ( basePort + i );
+        list.xCandidates[ i ].ucGroup = ( uint8_t ) ( i % ggdprobeMAX_GROUPS );
+
+        if( ( listeners[ i ].delayMs >= 0 ) &&
+            ( HostBroker_Start( ( uint16_t ) ( basePort + i ), true, ( uint32_t ) listeners[ i ].delayMs ) == NULL ) )
+        {
+            fprintf( stderr, "cannot listen on port %lu\n", basePort + i );
+
+            return 2;
+        }
+    }
+
+    list.xCount = LISTENERS;
+
+    ok = checkRound( 1, &list ) && ok;
+    ok = checkRound( 2, &list ) && ok;
+
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+    fflush( stdout );
+
+    /* Probes of the stalled listener may still be running. */
+    _exit( ok ? 0 : 1 );
+}
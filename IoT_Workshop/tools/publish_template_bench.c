@@ -0,0 +1,492 @@
+/*
+ * publish_template_bench - time PUBLISH serialization with and without the
+ * pre-serialized templates of the Lab1 MQTT demo.
+ *
+ * Two paths build the same QoS 1 PUBLISH for the demo topic:
+ *     library    what the MQTT library's default serializer does for every
+ *                message: validate, size the packet, malloc, encode the
+ *                fixed header, topic, packet identifier and payload, and
+ *                free the packet once it is sent
+ *     template   what demos/mqtt/iot_demo_publish_template.c does: take a
+ *                packet from a pool whose topic was written once, patch in
+ *                the remaining length, packet identifier and payload, and
+ *                return the packet to the pool
+ *
+ * The library path is a model of _IotMqtt_SerializePublish and
+ * _IotMqtt_FreePacket, whose sources are not part of this tree. Both paths
+ * are checked to produce the same bytes (apart from the packet identifier)
+ * before anything is timed.
+ *
+ * The ESP-IDF heap takes a spinlock around every malloc and free, while
+ * glibc serves small blocks from a per-thread cache without any locked
+ * instruction. By default the library path takes a spinlock around both
+ * calls as the device does; -g times it with glibc alone. The template path
+ * takes the same two locked instructions (take and return a pool packet)
+ * either way, so -g gives the worst case for templates.
+ *
+ * Build:
+ *     cc -O2 -o publish_template_bench publish_template_bench.c
+ *
+ * Examples:
+ *     ./publish_template_bench
+ *     ./publish_template_bench -g -n 5000000 -p 40 -p 120 -p 200
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOPIC            "iotdemo/topic/pub"
+#define POOL_PACKETS     8
+#define PACKET_SIZE      256
+#define TOPIC_OFFSET     5
+#define MAX_PAYLOADS     16
+#define MAX_REMAINING    268435455UL
+#define SLOT_BITS        6
+
+/*-----------------------------------------------------------*/
+
+typedef struct Template
+{
+    uint16_t topicLength;
+    size_t variableLength;
+    size_t payloadCapacity;
+    uint32_t freePackets;
+    uint16_t generation[ POOL_PACKETS ];
+    uint8_t packets[ POOL_PACKETS ][ PACKET_SIZE ];
+} Template_t;
+
+static bool heapLock = true;
+static uint32_t heapLocked;
+
+/*-----------------------------------------------------------*/
+
+/* Stands in for the network send: the compiler must assume every byte of
+ * the packet is read, or it may drop the stores to a buffer that is freed
+ * right after. */
+static inline void send( const uint8_t * pPacket,
+                         size_t packetSize )
+{
+    __asm__ volatile ( "" : : "r" ( pPacket ), "r" ( packetSize ) : "memory" );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+static size_t putRemainingLength( uint8_t * pBuffer,
+                                  size_t length )
+{
+    size_t i = 0;
+
+    do
+    {
+        pBuffer[ i ] = ( uint8_t ) ( length & 0x7F );
+        length >>= 7;
+
+        if( length > 0 )
+        {
+            pBuffer[ i ] |= 0x80;
+        }
+
+        i++;
+    } while( length > 0 );
+
+    return i;
+}
+
+static size_t remainingLengthSize( size_t length )
+{
+    return ( length < 128 ) ? 1 : ( length < 16384 ) ? 2 : ( length < 2097152 ) ? 3 : 4;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The library's default serializer. */
+
+static void * heapAlloc( size_t size )
+{
+    void * pBlock = NULL;
+
+    if( heapLock == false )
+    {
+        return malloc( size );
+    }
+
+    while( __atomic_exchange_n( &heapLocked, 1, __ATOMIC_ACQUIRE ) != 0 )
+    {
+    }
+
+    pBlock = malloc( size );
+    __atomic_store_n( &heapLocked, 0, __ATOMIC_RELEASE );
+
+    return pBlock;
+}
+
+static void heapFree( void * pBlock )
+{
+    if( heapLock == false )
+    {
+        free( pBlock );
+
+        return;
+    }
+
+    while( __atomic_exchange_n( &heapLocked, 1, __ATOMIC_ACQUIRE ) != 0 )
+    {
+    }
+
+    free( pBlock );
+    __atomic_store_n( &heapLocked, 0, __ATOMIC_RELEASE );
+}
+
+static uint8_t * libraryPublish( const char * pTopic,
+                                 uint16_t topicLength,
+                                 const uint8_t * pPayload,
+                                 size_t payloadLength,
+                                 size_t * pPacketSize )
+{
+    static uint16_t packetIdentifier = 1;
+    size_t remaining = 0, size = 0, i = 0;
+    uint8_t * pPacket = NULL;
+
+    /* The library rejects topics that are empty or hold wildcards. */
+    if( topicLength == 0 )
+    {
+        return NULL;
+    }
+
+    for( i = 0; i < topicLength; i++ )
+    {
+        if( ( pTopic[ i ] == '+' ) || ( pTopic[ i ] == '#' ) )
+        {
+            return NULL;
+        }
+    }
+
+    remaining = 2 + topicLength + 2 + payloadLength;
+
+    if( remaining > MAX_REMAINING )
+    {
+        return NULL;
+    }
+
+    size = 1 + remainingLengthSize( remaining ) + remaining;
+    pPacket = heapAlloc( size );
+
+    if( pPacket == NULL )
+    {
+        return NULL;
+    }
+
+    i = 0;
+    pPacket[ i++ ] = 0x32;
+    i += putRemainingLength( pPacket + i, remaining );
+    pPacket[ i++ ] = ( uint8_t ) ( topicLength >> 8 );
+    pPacket[ i++ ] = ( uint8_t ) ( topicLength & 0xFF );
+    memcpy( pPacket + i, pTopic, topicLength );
+    i += topicLength;
+
+    /* Odd identifiers, never 0. */
+    pPacket[ i++ ] = ( uint8_t ) ( packetIdentifier >> 8 );
+    pPacket[ i++ ] = ( uint8_t ) ( packetIdentifier & 0xFF );
+    packetIdentifier = ( uint16_t ) ( packetIdentifier + 2 );
+
+    memcpy( pPacket + i, pPayload, payloadLength );
+    *pPacketSize = i + payloadLength;
+
+    return pPacket;
+}
+
+static void libraryFree( uint8_t * pPacket )
+{
+    heapFree( pPacket );
+}
+
+/*-----------------------------------------------------------*/
+
+/* The template path, as in iot_demo_publish_template.c. */
+
+static void templateInit( Template_t * pTemplate,
+                          const char * pTopic,
+                          uint16_t topicLength )
+{
+    size_t headerLength = TOPIC_OFFSET + 2 + topicLength + 2;
+    int i = 0;
+
+    pTemplate->topicLength = topicLength;
+    pTemplate->variableLength = headerLength - TOPIC_OFFSET;
+    pTemplate->payloadCapacity = PACKET_SIZE - headerLength;
+
+    for( i = 0; i < POOL_PACKETS; i++ )
+    {
+        pTemplate->packets[ i ][ TOPIC_OFFSET ] = ( uint8_t ) ( topicLength >> 8 );
+        pTemplate->packets[ i ][ TOPIC_OFFSET + 1 ] = ( uint8_t ) ( topicLength & 0xFF );
+        memcpy( &( pTemplate->packets[ i ][ TOPIC_OFFSET + 2 ] ), pTopic, topicLength );
+    }
+
+    pTemplate->freePackets = ( 1U << POOL_PACKETS ) - 1;
+}
+
+static uint8_t * templatePublish( Template_t * pTemplate,
+                                  const uint8_t * pPayload,
+                                  size_t payloadLength,
+                                  size_t * pPacketSize )
+{
+    uint16_t packetIdentifier = 0;
+    uint32_t freePackets = __atomic_load_n( &( pTemplate->freePackets ), __ATOMIC_ACQUIRE ), index = 0;
+    uint8_t lengthBytes[ 4 ];
+    uint8_t * pPacket = NULL, * pStart = NULL, * pIdentifier = NULL;
+    size_t lengthSize = 0;
+
+    if( payloadLength > pTemplate->payloadCapacity )
+    {
+        return NULL;
+    }
+
+    do
+    {
+        if( freePackets == 0 )
+        {
+            return NULL;
+        }
+
+        index = ( uint32_t ) __builtin_ctz( freePackets );
+    } while( __atomic_compare_exchange_n( &( pTemplate->freePackets ), &freePackets, freePackets & ~( 1U << index ),
+                                          false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) == false );
+
+    pPacket = pTemplate->packets[ index ];
+    lengthSize = putRemainingLength( lengthBytes, pTemplate->variableLength + payloadLength );
+    pStart = pPacket + TOPIC_OFFSET - 1 - lengthSize;
+    pStart[ 0 ] = 0x32;
+    memcpy( pStart + 1, lengthBytes, lengthSize );
+
+    /* Even identifiers from the slot and its generation, never 0. */
+    do
+    {
+        pTemplate->generation[ index ]++;
+        packetIdentifier = ( uint16_t ) ( ( ( ( uint32_t ) pTemplate->generation[ index ] << SLOT_BITS ) | index ) << 1 );
+    } while( packetIdentifier == 0 );
+
+    pIdentifier = pPacket + TOPIC_OFFSET + 2 + pTemplate->topicLength;
+    pIdentifier[ 0 ] = ( uint8_t ) ( packetIdentifier >> 8 );
+    pIdentifier[ 1 ] = ( uint8_t ) ( packetIdentifier & 0xFF );
+    memcpy( pIdentifier + 2, pPayload, payloadLength );
+
+    *pPacketSize = ( size_t ) ( pIdentifier + 2 + payloadLength - pStart );
+
+    return pStart;
+}
+
+static void templateFree( Template_t * pTemplate,
+                          uint8_t * pPacket )
+{
+    uint32_t index = ( uint32_t ) ( ( size_t ) ( pPacket - pTemplate->packets[ 0 ] ) / PACKET_SIZE );
+
+    ( void ) __atomic_fetch_or( &( pTemplate->freePackets ), 1U << index, __ATOMIC_RELEASE );
+}
+
+/*-----------------------------------------------------------*/
+
+/* A reading as the demo formats it, padded or cut to the wanted length. */
+static void makePayload( uint8_t * pPayload,
+                         size_t length )
+{
+    static const char reading[] = "{\"temperature\":23.4,\"humidity\":41.0,\"vibration\":0,\"seq\":12345}";
+    size_t i = 0;
+
+    for( i = 0; i < length; i++ )
+    {
+        pPayload[ i ] = ( uint8_t ) ( ( i < sizeof( reading ) - 1 ) ? reading[ i ] : ' ' );
+    }
+}
+
+static bool check( Template_t * pTemplate,
+                   const uint8_t * pPayload,
+                   size_t payloadLength )
+{
+    size_t librarySize = 0, templateSize = 0, identifier = 0;
+    uint8_t * pLibrary = libraryPublish( TOPIC, sizeof( TOPIC ) - 1, pPayload, payloadLength, &librarySize );
+    uint8_t * pTemplatePacket = templatePublish( pTemplate, pPayload, payloadLength, &templateSize );
+    bool same = false;
+
+    if( ( pLibrary != NULL ) && ( pTemplatePacket != NULL ) && ( librarySize == templateSize ) )
+    {
+        /* Compare around the packet identifier. */
+        identifier = librarySize - payloadLength - 2;
+        same = ( memcmp( pLibrary, pTemplatePacket, identifier ) == 0 ) &&
+               ( memcmp( pLibrary + identifier + 2, pTemplatePacket + identifier + 2, librarySize - identifier - 2 ) == 0 );
+    }
+
+    if( pLibrary != NULL )
+    {
+        libraryFree( pLibrary );
+    }
+
+    if( pTemplatePacket != NULL )
+    {
+        templateFree( pTemplate, pTemplatePacket );
+    }
+
+    return same;
+}
+
+/*-----------------------------------------------------------*/
+
+static double timeLibrary( const uint8_t * pPayload,
+                           size_t payloadLength,
+                           long iterations )
+{
+    uint64_t start = nowNs();
+    size_t size = 0;
+    uint8_t * pPacket = NULL;
+    long i = 0;
+
+    for( i = 0; i < iterations; i++ )
+    {
+        pPacket = libraryPublish( TOPIC, sizeof( TOPIC ) - 1, pPayload, payloadLength, &size );
+        send( pPacket, size );
+        libraryFree( pPacket );
+    }
+
+    return ( double ) ( nowNs() - start ) / ( double ) iterations;
+}
+
+static double timeTemplate( Template_t * pTemplate,
+                            const uint8_t * pPayload,
+                            size_t payloadLength,
+                            long iterations )
+{
+    uint64_t start = nowNs();
+    size_t size = 0;
+    uint8_t * pPacket = NULL;
+    long i = 0;
+
+    for( i = 0; i < iterations; i++ )
+    {
+        pPacket = templatePublish( pTemplate, pPayload, payloadLength, &size );
+        send( pPacket, size );
+        templateFree( pTemplate, pPacket );
+    }
+
+    return ( double ) ( nowNs() - start ) / ( double ) iterations;
+}
+
+/*-----------------------------------------------------------*/
+
+static void usage( const char * pName )
+{
+    fprintf( stderr,
+             "usage: %s [-g] [-n iterations] [-p payload bytes]...\n"
+             "  -g  no heap lock around malloc and free (glibc alone)\n"
+             "  default: -n 2000000 -p 40 -p 64 -p 120 -p 200\n",
+             pName );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    static Template_t template;
+    size_t payloads[ MAX_PAYLOADS ] = { 0 }, payloadCount = 0, i = 0;
+    uint8_t payload[ PACKET_SIZE ];
+    long iterations = 2000000;
+    double libraryNs = 0, templateNs = 0;
+    int option = 0;
+
+    while( ( option = getopt( argc, argv, "gn:p:h" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'g':
+                heapLock = false;
+                break;
+
+            case 'n':
+                iterations = strtol( optarg, NULL, 0 );
+                break;
+
+            case 'p':
+
+                if( payloadCount < MAX_PAYLOADS )
+                {
+                    payloads[ payloadCount++ ] = ( size_t ) strtoul( optarg, NULL, 0 );
+                }
+
+                break;
+
+            default:
+                usage( argv[ 0 ] );
+
+                return ( option == 'h' ) ? 0 : 2;
+        }
+    }
+
+    if( iterations <= 0 )
+    {
+        usage( argv[ 0 ] );
+
+        return 2;
+    }
+
+    if( payloadCount == 0 )
+    {
+        payloads[ 0 ] = 40;
+        payloads[ 1 ] = 64;
+        payloads[ 2 ] = 120;
+        payloads[ 3 ] = 200;
+        payloadCount = 4;
+    }
+
+    templateInit( &template, TOPIC, sizeof( TOPIC ) - 1 );
+
+    printf( "topic %s, QoS 1, %ld iterations, %s\n",
+            TOPIC, iterations, heapLock ? "heap lock" : "no heap lock" );
+    printf( "%8s %8s %12s %12s %8s\n", "payload", "packet", "library ns", "template ns", "speedup" );
+
+    for( i = 0; i < payloadCount; i++ )
+    {
+        if( payloads[ i ] > template.payloadCapacity )
+        {
+            printf( "%8zu  does not fit a template packet (at most %zu bytes)\n",
+                    payloads[ i ], template.payloadCapacity );
+            continue;
+        }
+
+        makePayload( payload, payloads[ i ] );
+
+        if( check( &template, payload, payloads[ i ] ) == false )
+        {
+            fprintf( stderr, "%zu bytes: template packet differs from the library packet\n", payloads[ i ] );
+
+            return 1;
+        }
+
+        /* Warm up both paths, then time them. */
+        ( void ) timeLibrary( payload, payloads[ i ], iterations / 10 + 1 );
+        ( void ) timeTemplate( &template, payload, payloads[ i ], iterations / 10 + 1 );
+        libraryNs = timeLibrary( payload, payloads[ i ], iterations );
+        templateNs = timeTemplate( &template, payload, payloads[ i ], iterations );
+
+        printf( "%8zu %8zu %12.1f %12.1f %7.2fx\n",
+                payloads[ i ],
+                TOPIC_OFFSET - 4 + remainingLengthSize( template.variableLength + payloads[ i ] ) + template.variableLength + payloads[ i ],
+                libraryNs,
+                templateNs,
+                libraryNs / templateNs );
+    }
+
+    return 0;
+}
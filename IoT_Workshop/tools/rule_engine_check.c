@@ -0,0 +1,1006 @@
+/*
+ * rule_engine_check - check the compiler and the stack machine of the local
+ * rules against a reference, and time their evaluation.
+ *
+ * The rules (driver/rule_engine.h) are compiled into this program with the
+ * inputs of the Lab1 demo (temp, humidity, vibration) and two outputs. The
+ * checks:
+ *
+ *     - sources that must not compile: syntax errors, unknown names,
+ *       numbers out of range, and one past each limit (rulesMAX_RULES,
+ *       rulesMAX_HELD, rulesMAX_NESTING, rulesMAX_STACK, rulesMAX_CODE),
+ *       next to the same at the limit, which must compile; each copied
+ *       into a buffer of its exact length, so that a read past the end is
+ *       caught when built with -fsanitize=address;
+ *     - evaluation: the first evaluation acts, a rule acts again only when
+ *       its condition changes, held() counts in tenths of a second from the
+ *       evaluation at which its condition became true, starts again after
+ *       it was false, keeps counting across the wrap of the clock, and is
+ *       kept up to date when the rest of an and is false;
+ *     - -n random programs, written from the grammar with a reference tree
+ *       kept alongside: each must compile exactly when the reference finds
+ *       it within the limits, and then take the same actions as the
+ *       reference over a run of random inputs and times.
+ *
+ * Then the demo's default rule and a full program of rulesMAX_RULES rules
+ * are evaluated -t million times each and the time per evaluation printed.
+ * rule_engine.h puts an evaluation at a few microseconds on the device: it
+ * is one pass over the bytecode, and a 240 MHz ESP32 runs it some 15 to 30
+ * times slower than a desktop host, so the host figure times that is what
+ * to expect there. Build without the sanitizers for this.
+ *
+ * Any failure is printed and the program exits with status 1.
+ *
+ * Build:
+ *     cc -O2 -g -fsanitize=address,undefined \
+ *         -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o rule_engine_check rule_engine_check.c
+ *
+ * Examples:
+ *     ./rule_engine_check
+ *     ./rule_engine_check -n 1000000 -s 7 -t 10
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/rule_engine.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/rule_engine.c"
+
+#define INPUTS         ( 3 )
+#define OUTPUTS        ( 2 )
+#define MAX_SOURCE     ( 4096 )
+#define MAX_NODES      ( 1024 )
+#define MAX_ACTIONS    ( 64 )
+
+/*-----------------------------------------------------------*/
+
+static const char * const inputs[ INPUTS ] = { "temp", "humidity", "vibration" };
+static const char * const outputs[ OUTPUTS ] = { "led", "fan" };
+
+static uint32_t randomState = 1;
+static unsigned failures;
+
+/* What an evaluation did. */
+typedef struct Action
+{
+    size_t output;
+    int32_t level;
+} Action_t;
+
+typedef struct Actions
+{
+    Action_t actions[ MAX_ACTIONS ];
+    size_t count;
+} Actions_t;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( void )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+static void fail( const char * pSource,
+                  const char * pWhat )
+{
+    if( failures++ < 20 )
+    {
+        printf( "FAIL \"%s\": %s\n", pSource, pWhat );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void recordAction( void * pContext,
+                          size_t output,
+                          int32_t level )
+{
+    Actions_t * pActions = pContext;
+
+    if( pActions->count < MAX_ACTIONS )
+    {
+        pActions->actions[ pActions->count ].output = output;
+        pActions->actions[ pActions->count ].level = level;
+    }
+
+    pActions->count++;
+}
+
+/* Compile from a buffer of the exact length of the source. */
+static bool compile( const char * pSource,
+                     RuleProgram_t * pProgram,
+                     size_t * pErrorOffset )
+{
+    size_t length = strlen( pSource );
+    char * pCopy = malloc( length ? length : 1 );
+    bool compiled;
+
+    if( pCopy == NULL )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 2 );
+    }
+
+    memcpy( pCopy, pSource, length );
+    *pErrorOffset = SIZE_MAX;
+    compiled = Rules_Compile( inputs, INPUTS, outputs, OUTPUTS, pCopy, length, pProgram, pErrorOffset );
+    free( pCopy );
+
+    if( ( compiled == false ) && ( *pErrorOffset > length ) )
+    {
+        fail( pSource, "the error offset is past the end" );
+    }
+
+    return compiled;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Sources that take a limit to its end, and one past it: pText count
+ * times at the end of what the buffer holds. */
+static void append( char * pBuffer,
+                    size_t size,
+                    size_t * pUsed,
+                    const char * pText,
+                    size_t count )
+{
+    size_t length = strlen( pText );
+
+    while( ( count-- > 0 ) && ( *pUsed + length < size ) )
+    {
+        memcpy( pBuffer + *pUsed, pText, length + 1 );
+        *pUsed += length;
+    }
+}
+
+static void nest( char * pBuffer,
+                  size_t size,
+                  const char * pOpen,
+                  const char * pInner,
+                  const char * pClose,
+                  size_t count,
+                  const char * pTail )
+{
+    size_t used = 0;
+
+    pBuffer[ 0 ] = '\0';
+    append( pBuffer, size, &used, pOpen, count );
+    append( pBuffer, size, &used, pInner, 1 );
+    append( pBuffer, size, &used, pClose, count );
+    append( pBuffer, size, &used, pTail, 1 );
+}
+
+static bool checkCompile( void )
+{
+    static const char * const good[] =
+    {
+        "",
+        " \n\t",
+        "temp > 30 -> led = on",
+        "temp > 30 -> led = on;",
+        "temp>30->led=1;humidity<=40.5->fan=0",
+        "not vibration -> led = off",
+        "!vibration && temp != 0 || humidity == 50 -> fan = on",
+        "held(vibration) > 5 -> led = on; held(temp > 30 and not vibration) >= 60 -> fan = on",
+        "temp - -1 > humidity + 2.59 -> led = on",
+        "temp > 214748364.7 -> led = on",
+        "temp > -214748364.7 -> led = on",
+        "(((1))) -> led = on",
+        "not not not 1 -> led = on",
+        "1 or 1 and 1 > 1 + (1 and 1 > 1 + 1) -> led = on"
+    };
+    static const char * const bad[] =
+    {
+        ";",
+        "temp >",
+        "temp > 30",
+        "temp > 30 ->",
+        "temp > 30 -> led",
+        "temp > 30 -> led =",
+        "temp > 30 -> led = maybe",
+        "temp > 30 -> led = 2",
+        "temp > 30 -> led = on x",
+        "temp > 30 -> led = on;;",
+        "temp > 30 -> lamp = on",
+        "tmp > 30 -> led = on",
+        "temp > 30 led = on",
+        "temp > > 30 -> led = on",
+        "temp > 30 > 20 -> led = on",
+        "(temp > 30 -> led = on",
+        "temp > 30) -> led = on",
+        "held temp -> led = on",
+        "held() -> led = on",
+        "nothing > 0 -> led = on",
+        "held(temp -> led = on",
+        "not -> led = on",
+        "!= 1 -> led = on",
+        "- 5 > 0 -> led = on",
+        ". > 0 -> led = on",
+        "temp > 214748364.8 -> led = on",
+        "temp > 99999999999 -> led = on",
+        "temp ! 30 -> led = on",
+        "temp & 30 -> led = on",
+        "temp > 30 -> led = on led = off",
+        "((((1)))) -> led = on",
+        "not not not not 1 -> led = on",
+        "1 or 1 and 1 > 1 + (1 or 1 and 1 > 1 + (1 or 1 and 1 > 1 + 1)) -> led = on"
+    };
+    /* Stacking one to four values, for the last level of the stack. */
+    static const char * const stacked[] = { "1", "1 + 1", "1 > 1 + 1", "1 and 1 > 1 + 1" };
+    RuleProgram_t program;
+    char source[ MAX_SOURCE ];
+    size_t offset, i, depth, terms;
+    char what[ 96 ];
+
+    for( i = 0; i < sizeof( good ) / sizeof( good[ 0 ] ); i++ )
+    {
+        if( compile( good[ i ], &program, &offset ) == false )
+        {
+            snprintf( what, sizeof( what ), "did not compile, stopped at %zu", offset );
+            fail( good[ i ], what );
+        }
+    }
+
+    for( i = 0; i < sizeof( bad ) / sizeof( bad[ 0 ] ); i++ )
+    {
+        if( compile( bad[ i ], &program, &offset ) == true )
+        {
+            fail( bad[ i ], "compiled" );
+        }
+    }
+
+    /* The limits, at and one past. */
+    for( i = 0; i < 2; i++ )
+    {
+        nest( source, sizeof( source ), "temp > 30 -> led = on;", "", "", rulesMAX_RULES + i, "" );
+
+        if( compile( source, &program, &offset ) != ( i == 0 ) )
+        {
+            fail( source, "rulesMAX_RULES is not the limit of rules" );
+        }
+
+        nest( source, sizeof( source ), "held(vibration) > 5 or ", "held(vibration) > 5", "",
+              rulesMAX_HELD - 1 + i, " -> led = on" );
+
+        if( compile( source, &program, &offset ) != ( i == 0 ) )
+        {
+            fail( source, "rulesMAX_HELD is not the limit of held()" );
+        }
+
+        nest( source, sizeof( source ), "(", "1", ")", rulesMAX_NESTING - 1 + i, " -> led = on" );
+
+        if( compile( source, &program, &offset ) != ( i == 0 ) )
+        {
+            fail( source, "rulesMAX_NESTING is not the limit of parentheses" );
+        }
+
+        nest( source, sizeof( source ), "held(", "vibration", ")", rulesMAX_NESTING - 1 + i, " -> led = on" );
+
+        if( compile( source, &program, &offset ) != ( i == 0 ) )
+        {
+            fail( source, "rulesMAX_NESTING is not the limit of held()" );
+        }
+
+        nest( source, sizeof( source ), "not ", "1", "", rulesMAX_NESTING - 1 + i, " -> led = on" );
+
+        if( compile( source, &program, &offset ) != ( i == 0 ) )
+        {
+            fail( source, "rulesMAX_NESTING is not the limit of not" );
+        }
+
+        /* Each level of 1 or 1 and 1 > 1 + ( ... ) stacks four values. */
+        depth = rulesMAX_STACK + i;
+        nest( source, sizeof( source ), "1 or 1 and 1 > 1 + (", stacked[ ( depth - 1 ) % 4 ], ")",
+              ( depth - 1 ) / 4, " -> led = on" );
+
+        if( ( ( depth - 1 ) / 4 < rulesMAX_NESTING ) &&
+            ( compile( source, &program, &offset ) != ( i == 0 ) ) )
+        {
+            fail( source, "rulesMAX_STACK is not the limit of the stack" );
+        }
+
+        /* A load and an add per term, then push, compare and act: three
+         * bytes a term and six more. */
+        terms = ( rulesMAX_CODE - 6 ) / 3 + i;
+        nest( source, sizeof( source ), "temp + ", "temp", "", terms - 1, " > 0 -> led = on" );
+
+        if( compile( source, &program, &offset ) != ( 3 * terms + 6 <= rulesMAX_CODE ) )
+        {
+            fail( source, "rulesMAX_CODE is not the limit of the code" );
+        }
+    }
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Evaluate at a time with inputs, and compare the actions. */
+static void expectActions( const char * pSource,
+                           const RuleProgram_t * pProgram,
+                           RuleState_t * pState,
+                           int32_t temp,
+                           int32_t humidity,
+                           int32_t vibration,
+                           uint32_t nowMs,
+                           size_t count,
+                           const Action_t * pExpected )
+{
+    int32_t values[ INPUTS ] = { temp, humidity, vibration };
+    Actions_t actions = { .count = 0 };
+    char what[ 128 ];
+    size_t i;
+
+    Rules_Evaluate( pProgram, pState, values, nowMs, recordAction, &actions );
+
+    for( i = 0; i < count; i++ )
+    {
+        if( ( i >= actions.count ) || ( actions.actions[ i ].output != pExpected[ i ].output ) ||
+            ( actions.actions[ i ].level != pExpected[ i ].level ) )
+        {
+            break;
+        }
+    }
+
+    if( ( i != count ) || ( actions.count != count ) )
+    {
+        snprintf( what, sizeof( what ), "at %lu ms with %ld, %ld, %ld: %zu actions, %zu expected",
+                  ( unsigned long ) nowMs, ( long ) temp, ( long ) humidity, ( long ) vibration,
+                  actions.count, count );
+        fail( pSource, what );
+    }
+}
+
+static const Action_t ledOff[] = { { 0, 0 } };
+static const Action_t ledOn[] = { { 0, 1 } };
+
+static bool checkSemantics( void )
+{
+    static const char threshold[] = "temp > 30 -> led = on";
+    static const char held[] = "held(vibration) > 5 -> led = on";
+    static const char both[] = "temp > 30 and held(vibration) > 5 -> led = on";
+    static const char two[] = "vibration -> led = on; not vibration -> fan = off";
+    static const Action_t twoFirst[] = { { 0, 0 }, { 1, 0 } };
+    static const Action_t twoChange[] = { { 0, 1 }, { 1, 1 } };
+    RuleProgram_t program;
+    RuleState_t state;
+    size_t offset;
+    uint32_t start;
+
+    /* The first evaluation acts either way; then only changes do. A
+     * command may change the output in between. */
+    ( void ) compile( threshold, &program, &offset );
+    Rules_Reset( &state );
+    expectActions( threshold, &program, &state, 250, 0, 0, 0, 1, ledOff );
+    expectActions( threshold, &program, &state, 300, 0, 0, 100, 0, NULL );
+    expectActions( threshold, &program, &state, 301, 0, 0, 200, 1, ledOn );
+    expectActions( threshold, &program, &state, 400, 0, 0, 300, 0, NULL );
+    expectActions( threshold, &program, &state, 300, 0, 0, 400, 1, ledOff );
+    Rules_Reset( &state );
+    expectActions( threshold, &program, &state, 250, 0, 0, 500, 1, ledOff );
+
+    /* Rules act in order, each on its own change. */
+    ( void ) compile( two, &program, &offset );
+    Rules_Reset( &state );
+    expectActions( two, &program, &state, 0, 0, 0, 0, 2, twoFirst );
+    expectActions( two, &program, &state, 0, 0, 1, 100, 2, twoChange );
+    expectActions( two, &program, &state, 0, 0, 5, 200, 0, NULL );
+
+    /* held() is in tenths of a second: more than 5 s, so 5.1 s after the
+     * evaluation that saw the vibration start. Clocks just before the wrap
+     * count through it. */
+    ( void ) compile( held, &program, &offset );
+
+    for( start = 1000; start != 0; start = ( start == 1000 ) ? UINT32_MAX - 2000 : 0 )
+    {
+        Rules_Reset( &state );
+        expectActions( held, &program, &state, 0, 0, 0, start - 1000, 1, ledOff );
+        expectActions( held, &program, &state, 0, 0, 1, start, 0, NULL );
+        expectActions( held, &program, &state, 0, 0, 1, start + 5000, 0, NULL );
+        expectActions( held, &program, &state, 0, 0, 1, start + 5099, 0, NULL );
+        expectActions( held, &program, &state, 0, 0, 1, start + 5100, 1, ledOn );
+        expectActions( held, &program, &state, 0, 0, 0, start + 6000, 1, ledOff );
+
+        /* A break starts the count again. */
+        expectActions( held, &program, &state, 0, 0, 1, start + 7000, 0, NULL );
+        expectActions( held, &program, &state, 0, 0, 1, start + 12000, 0, NULL );
+        expectActions( held, &program, &state, 0, 0, 1, start + 12100, 1, ledOn );
+    }
+
+    /* Every term is evaluated: the timer runs while the temperature keeps
+     * the and false, so the rule acts as soon as the temperature rises. */
+    ( void ) compile( both, &program, &offset );
+    Rules_Reset( &state );
+    expectActions( both, &program, &state, 200, 0, 1, 0, 1, ledOff );
+    expectActions( both, &program, &state, 200, 0, 1, 6000, 0, NULL );
+    expectActions( both, &program, &state, 310, 0, 1, 6100, 1, ledOn );
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Random programs with a reference tree. */
+
+typedef enum NodeType
+{
+    NODE_NUMBER,
+    NODE_INPUT,
+    NODE_HELD,
+    NODE_NOT,
+    NODE_ADD,
+    NODE_SUB,
+    NODE_GT,
+    NODE_GE,
+    NODE_LT,
+    NODE_LE,
+    NODE_EQ,
+    NODE_NE,
+    NODE_AND,
+    NODE_OR
+} NodeType_t;
+
+typedef struct Node
+{
+    NodeType_t type;
+    int32_t value;             /* The number, the input or the held() slot. */
+    int a;
+    int b;
+} Node_t;
+
+typedef struct Generator
+{
+    char source[ MAX_SOURCE ];
+    size_t length;
+    Node_t nodes[ MAX_NODES ];
+    int nodeCount;
+    int rules[ rulesMAX_RULES + 2 ];
+    size_t outputs[ rulesMAX_RULES + 2 ];
+    int32_t levels[ rulesMAX_RULES + 2 ];
+    int ruleCount;
+    int held;
+    uint32_t maxNesting;
+    uint32_t maxDepth;
+    size_t codeBytes;
+    bool full;                 /* Out of room for source or nodes. */
+} Generator_t;
+
+static void emitText( Generator_t * pGen,
+                      const char * pText )
+{
+    size_t length = strlen( pText );
+
+    if( pGen->length + length >= sizeof( pGen->source ) )
+    {
+        pGen->full = true;
+
+        return;
+    }
+
+    memcpy( pGen->source + pGen->length, pText, length + 1 );
+    pGen->length += length;
+}
+
+static int newNode( Generator_t * pGen,
+                    NodeType_t type,
+                    int32_t value,
+                    int a,
+                    int b )
+{
+    if( pGen->nodeCount == MAX_NODES )
+    {
+        pGen->full = true;
+
+        return 0;
+    }
+
+    pGen->nodes[ pGen->nodeCount ].type = type;
+    pGen->nodes[ pGen->nodeCount ].value = value;
+    pGen->nodes[ pGen->nodeCount ].a = a;
+    pGen->nodes[ pGen->nodeCount ].b = b;
+
+    return pGen->nodeCount++;
+}
+
+/* The stack depth reached by a node whose value lands at depth `base`. */
+static void noteDepth( Generator_t * pGen,
+                       uint32_t depth )
+{
+    pGen->maxDepth = ( depth > pGen->maxDepth ) ? depth : pGen->maxDepth;
+}
+
+static int genExpression( Generator_t * pGen,
+                          uint32_t nesting,
+                          uint32_t base );
+
+/* term := number | input | held( expression ) | ( expression ) */
+static int genTerm( Generator_t * pGen,
+                    uint32_t nesting,
+                    uint32_t base )
+{
+    static const char * const fractions[] = { "", ".0", ".5", ".59", ".05" };
+    uint32_t choice = nextRandom() % 100;
+    int32_t integer, tenths;
+    char text[ 48 ];
+    int node, slot;
+
+    nesting++;
+    pGen->maxNesting = ( nesting > pGen->maxNesting ) ? nesting : pGen->maxNesting;
+
+    /* Deeper terms are rarely nested further. */
+    if( ( choice < 10 ) && ( nesting < rulesMAX_NESTING + 2 ) )
+    {
+        slot = pGen->held++;
+        emitText( pGen, "held(" );
+        node = genExpression( pGen, nesting, base );
+        emitText( pGen, ")" );
+        pGen->codeBytes += 2;
+
+        return newNode( pGen, NODE_HELD, slot, node, 0 );
+    }
+
+    if( ( choice < 20 ) && ( nesting < rulesMAX_NESTING + 2 ) )
+    {
+        emitText( pGen, "(" );
+        node = genExpression( pGen, nesting, base );
+        emitText( pGen, ")" );
+
+        return node;
+    }
+
+    noteDepth( pGen, base + 1 );
+
+    if( choice < 60 )
+    {
+        slot = ( int ) ( nextRandom() % INPUTS );
+        emitText( pGen, inputs[ slot ] );
+        pGen->codeBytes += 2;
+
+        return newNode( pGen, NODE_INPUT, slot, 0, 0 );
+    }
+
+    /* A number in tenths, as the compiler reads it: further digits are
+     * dropped, toward zero. */
+    integer = ( nextRandom() % 8 == 0 ) ? ( int32_t ) ( nextRandom() % 214748364 ) : ( int32_t ) ( nextRandom() % 100 );
+    slot = ( int ) ( nextRandom() % ( sizeof( fractions ) / sizeof( fractions[ 0 ] ) ) );
+    tenths = integer * 10 + ( ( fractions[ slot ][ 0 ] != '\0' ) ? fractions[ slot ][ 1 ] - '0' : 0 );
+
+    if( nextRandom() % 4 == 0 )
+    {
+        snprintf( text, sizeof( text ), "-%ld%s", ( long ) integer, fractions[ slot ] );
+        tenths = -tenths;
+    }
+    else
+    {
+        snprintf( text, sizeof( text ), "%ld%s", ( long ) integer, fractions[ slot ] );
+    }
+
+    emitText( pGen, text );
+    pGen->codeBytes += ( ( tenths >= INT16_MIN ) && ( tenths <= INT16_MAX ) ) ? 3 : 5;
+
+    return newNode( pGen, NODE_NUMBER, tenths, 0, 0 );
+}
+
+/* sum := term { ( + | - ) term } */
+static int genSum( Generator_t * pGen,
+                   uint32_t nesting,
+                   uint32_t base )
+{
+    int node = genTerm( pGen, nesting, base );
+    bool add;
+
+    while( nextRandom() % 4 == 0 )
+    {
+        add = ( nextRandom() % 2 == 0 );
+        emitText( pGen, add ? " + " : " - " );
+        node = newNode( pGen, add ? NODE_ADD : NODE_SUB, 0, node, genTerm( pGen, nesting, base + 1 ) );
+        pGen->codeBytes++;
+    }
+
+    return node;
+}
+
+/* comparison := sum [ operator sum ] */
+static int genComparison( Generator_t * pGen,
+                          uint32_t nesting,
+                          uint32_t base )
+{
+    static const char * const operators[] = { " > ", " >= ", " < ", " <= ", " == ", " != " };
+    int node = genSum( pGen, nesting, base );
+    uint32_t choice;
+
+    if( nextRandom() % 3 != 0 )
+    {
+        choice = nextRandom() % 6;
+        emitText( pGen, operators[ choice ] );
+        node = newNode( pGen, ( NodeType_t ) ( NODE_GT + choice ), 0, node, genSum( pGen, nesting, base + 1 ) );
+        pGen->codeBytes++;
+    }
+
+    return node;
+}
+
+/* negation := ( not | ! ) negation | comparison */
+static int genNegation( Generator_t * pGen,
+                        uint32_t nesting,
+                        uint32_t base )
+{
+    if( ( nextRandom() % 8 == 0 ) && ( nesting < rulesMAX_NESTING + 2 ) )
+    {
+        emitText( pGen, ( nextRandom() % 2 == 0 ) ? "not " : "!" );
+        nesting++;
+        pGen->maxNesting = ( nesting > pGen->maxNesting ) ? nesting : pGen->maxNesting;
+        pGen->codeBytes++;
+
+        return newNode( pGen, NODE_NOT, 0, genNegation( pGen, nesting, base ), 0 );
+    }
+
+    return genComparison( pGen, nesting, base );
+}
+
+/* conjunction := negation { ( and | && ) negation } */
+static int genConjunction( Generator_t * pGen,
+                           uint32_t nesting,
+                           uint32_t base )
+{
+    int node = genNegation( pGen, nesting, base );
+
+    while( nextRandom() % 3 == 0 )
+    {
+        emitText( pGen, ( nextRandom() % 2 == 0 ) ? " and " : " && " );
+        node = newNode( pGen, NODE_AND, 0, node, genNegation( pGen, nesting, base + 1 ) );
+        pGen->codeBytes++;
+    }
+
+    return node;
+}
+
+/* expression := conjunction { ( or | || ) conjunction } */
+static int genExpression( Generator_t * pGen,
+                          uint32_t nesting,
+                          uint32_t base )
+{
+    int node = genConjunction( pGen, nesting, base );
+
+    while( nextRandom() % 4 == 0 )
+    {
+        emitText( pGen, ( nextRandom() % 2 == 0 ) ? " or " : " || " );
+        node = newNode( pGen, NODE_OR, 0, node, genConjunction( pGen, nesting, base + 1 ) );
+        pGen->codeBytes++;
+    }
+
+    return node;
+}
+
+static void genProgram( Generator_t * pGen )
+{
+    static const char * const levels[] = { "on", "off", "1", "0" };
+    int rules = 1 + ( int ) ( nextRandom() % ( rulesMAX_RULES + 1 ) );
+    uint32_t level;
+
+    memset( pGen, 0, sizeof( *pGen ) );
+
+    for( pGen->ruleCount = 0; pGen->ruleCount < rules; pGen->ruleCount++ )
+    {
+        if( pGen->ruleCount > 0 )
+        {
+            emitText( pGen, ( nextRandom() % 2 == 0 ) ? "; " : ";\n" );
+        }
+
+        pGen->rules[ pGen->ruleCount ] = genExpression( pGen, 0, 0 );
+        pGen->outputs[ pGen->ruleCount ] = nextRandom() % OUTPUTS;
+        level = nextRandom() % 4;
+        pGen->levels[ pGen->ruleCount ] = ( level == 0 ) || ( level == 2 );
+        emitText( pGen, " -> " );
+        emitText( pGen, outputs[ pGen->outputs[ pGen->ruleCount ] ] );
+        emitText( pGen, " = " );
+        emitText( pGen, levels[ level ] );
+        pGen->codeBytes += 3;
+    }
+}
+
+/* The reference: every term is evaluated, as the machine does. */
+typedef struct Reference
+{
+    bool active[ rulesMAX_HELD + 64 ];
+    uint32_t since[ rulesMAX_HELD + 64 ];
+    bool known[ rulesMAX_RULES + 2 ];
+    bool isTrue[ rulesMAX_RULES + 2 ];
+} Reference_t;
+
+static int32_t evaluateNode( const Generator_t * pGen,
+                             Reference_t * pRef,
+                             int index,
+                             const int32_t * pInputs,
+                             uint32_t nowMs )
+{
+    const Node_t * pNode = &( pGen->nodes[ index ] );
+    int32_t a, b;
+    uint32_t held;
+
+    switch( pNode->type )
+    {
+        case NODE_NUMBER:
+            return pNode->value;
+
+        case NODE_INPUT:
+            return pInputs[ pNode->value ];
+
+        case NODE_HELD:
+
+            if( evaluateNode( pGen, pRef, pNode->a, pInputs, nowMs ) == 0 )
+            {
+                pRef->active[ pNode->value ] = false;
+
+                return 0;
+            }
+
+            if( pRef->active[ pNode->value ] == false )
+            {
+                pRef->active[ pNode->value ] = true;
+                pRef->since[ pNode->value ] = nowMs;
+            }
+
+            held = ( nowMs - pRef->since[ pNode->value ] ) / 100;
+
+            return ( int32_t ) ( ( held > INT32_MAX ) ? INT32_MAX : held );
+
+        case NODE_NOT:
+            return evaluateNode( pGen, pRef, pNode->a, pInputs, nowMs ) == 0;
+
+        default:
+            break;
+    }
+
+    a = evaluateNode( pGen, pRef, pNode->a, pInputs, nowMs );
+    b = evaluateNode( pGen, pRef, pNode->b, pInputs, nowMs );
+
+    switch( pNode->type )
+    {
+        case NODE_ADD: return ( int32_t ) ( ( uint32_t ) a + ( uint32_t ) b );
+        case NODE_SUB: return ( int32_t ) ( ( uint32_t ) a - ( uint32_t ) b );
+        case NODE_GT: return a > b;
+        case NODE_GE: return a >= b;
+        case NODE_LT: return a < b;
+        case NODE_LE: return a <= b;
+        case NODE_EQ: return a == b;
+        case NODE_NE: return a != b;
+        case NODE_AND: return ( a != 0 ) && ( b != 0 );
+        default: return ( a != 0 ) || ( b != 0 );
+    }
+}
+
+static bool checkRandom( uint64_t count )
+{
+    static Generator_t gen;
+    static const int32_t extremes[] = { INT32_MIN, INT32_MAX, 0, 1, -1 };
+    Reference_t ref;
+    RuleProgram_t program;
+    RuleState_t state;
+    Actions_t actions;
+    int32_t values[ INPUTS ], condition;
+    uint32_t nowMs;
+    uint64_t n, compiled = 0, acted = 0;
+    size_t offset, expected, step, i;
+    bool within, mismatch;
+    int rule;
+
+    for( n = 0; n < count; n++ )
+    {
+        genProgram( &gen );
+
+        if( gen.full )
+        {
+            continue;
+        }
+
+        within = ( gen.ruleCount <= rulesMAX_RULES ) && ( gen.held <= rulesMAX_HELD ) &&
+                 ( gen.maxNesting <= rulesMAX_NESTING ) && ( gen.maxDepth <= rulesMAX_STACK ) &&
+                 ( gen.codeBytes <= rulesMAX_CODE );
+
+        if( compile( gen.source, &program, &offset ) != within )
+        {
+            fail( gen.source, within ? "did not compile within the limits" : "compiled past a limit" );
+            continue;
+        }
+
+        if( within == false )
+        {
+            continue;
+        }
+
+        compiled++;
+
+        if( ( program.ucRules != gen.ruleCount ) || ( program.ucHeld != gen.held ) ||
+            ( program.usLength != gen.codeBytes ) )
+        {
+            fail( gen.source, "rules, held() terms or code length differ from the reference" );
+            continue;
+        }
+
+        memset( &ref, 0, sizeof( ref ) );
+        Rules_Reset( &state );
+        nowMs = ( nextRandom() % 2 == 0 ) ? UINT32_MAX - ( nextRandom() % 100000 ) : nextRandom() % 100000;
+        values[ 0 ] = 250;
+        values[ 1 ] = 450;
+        values[ 2 ] = 0;
+
+        for( step = 0; step < 40; step++ )
+        {
+            /* Inputs mostly hold their value, so that held() builds up. */
+            for( i = 0; i < INPUTS; i++ )
+            {
+                switch( nextRandom() % 8 )
+                {
+                    case 0: values[ i ] = ( int32_t ) ( nextRandom() % 1001 ) - 500; break;
+                    case 1: values[ i ] = ( int32_t ) ( nextRandom() % 2 ); break;
+                    case 2: values[ i ] = extremes[ nextRandom() % 5 ]; break;
+                    default: break;
+                }
+            }
+
+            nowMs += nextRandom() % 3000;
+            actions.count = 0;
+            Rules_Evaluate( &program, &state, values, nowMs, recordAction, &actions );
+
+            expected = 0;
+            mismatch = false;
+
+            for( rule = 0; rule < gen.ruleCount; rule++ )
+            {
+                condition = evaluateNode( &gen, &ref, gen.rules[ rule ], values, nowMs );
+
+                if( ( ref.known[ rule ] == false ) || ( ref.isTrue[ rule ] != ( condition != 0 ) ) )
+                {
+                    ref.known[ rule ] = true;
+                    ref.isTrue[ rule ] = ( condition != 0 );
+
+                    if( ( expected >= actions.count ) ||
+                        ( actions.actions[ expected ].output != gen.outputs[ rule ] ) ||
+                        ( actions.actions[ expected ].level != ( ( condition != 0 ) ? gen.levels[ rule ] : !gen.levels[ rule ] ) ) )
+                    {
+                        mismatch = true;
+                    }
+
+                    expected++;
+                }
+            }
+
+            acted += actions.count;
+
+            if( mismatch || ( expected != actions.count ) )
+            {
+                fail( gen.source, "the actions differ from the reference" );
+                break;
+            }
+        }
+    }
+
+    printf( "random programs: %llu, %llu within the limits, %llu actions compared\n",
+            ( unsigned long long ) count, ( unsigned long long ) compiled, ( unsigned long long ) acted );
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void discardAction( void * pContext,
+                           size_t output,
+                           int32_t level )
+{
+    ( void ) pContext;
+    ( void ) output;
+    ( void ) level;
+}
+
+static void timeProgram( const char * pName,
+                         const char * pSource,
+                         uint64_t evaluations )
+{
+    RuleProgram_t program;
+    RuleState_t state;
+    int32_t values[ INPUTS ] = { 250, 450, 0 };
+    uint64_t start, elapsed, n;
+    size_t offset;
+
+    if( compile( pSource, &program, &offset ) == false )
+    {
+        fail( pSource, "the timed program did not compile" );
+
+        return;
+    }
+
+    if( evaluations == 0 )
+    {
+        return;
+    }
+
+    Rules_Reset( &state );
+    start = nowNs();
+
+    for( n = 0; n < evaluations; n++ )
+    {
+        /* The inputs change, so that rules act now and then. */
+        values[ 0 ] = 250 + ( int32_t ) ( n & 0x7F );
+        values[ 2 ] = ( int32_t ) ( ( n >> 4 ) & 1 );
+        Rules_Evaluate( &program, &state, values, ( uint32_t ) n, discardAction, NULL );
+    }
+
+    elapsed = nowNs() - start;
+
+    printf( "%s: %u rules, %u bytes of code, %.1f ns per evaluation\n",
+            pName, ( unsigned ) program.ucRules, ( unsigned ) program.usLength,
+            ( double ) elapsed / ( double ) evaluations );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    char full[ MAX_SOURCE ];
+    uint64_t programs = 100000, millions = 1;
+    int option;
+    bool ok;
+
+    while( ( option = getopt( argc, argv, "n:s:t:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                programs = strtoull( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                randomState = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            case 't':
+                millions = strtoull( optarg, NULL, 0 );
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n programs] [-s seed] [-t millions]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    ok = checkCompile();
+    ok = checkSemantics() && ok;
+    ok = checkRandom( programs ) && ok;
+
+    nest( full, sizeof( full ), "held(vibration) > 5 and temp > humidity -> led = on; ", "not vibration -> fan = off", "",
+          rulesMAX_RULES - 1, "" );
+    timeProgram( "default rules", "vibration -> led = on", millions * 1000000 );
+    timeProgram( "full program", full, millions * 1000000 );
+
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+
+    return ok ? 0 : 1;
+}
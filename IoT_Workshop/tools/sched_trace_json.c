@@ -0,0 +1,376 @@
+/*
+ * sched_trace_json - convert a scheduler trace dump to the Chrome trace
+ * format.
+ *
+ * The input is a console capture holding one or more dumps printed by
+ * SchedTrace_Dump() (driver/sched_trace.h). Other lines are ignored:
+ *
+ *     SCHED,BEGIN,<cores>,<events>,<dropped>
+ *     SCHED,N,<object>,<name>                       task or queue name
+ *     SCHED,<us>,<core>,<type>,<object>,<value>[,<span name>]
+ *     SCHED,END
+ *
+ * The output, for chrome://tracing or ui.perfetto.dev, has three groups:
+ *     CPU     one track per core showing the running task, and one per
+ *             core for interrupts
+ *     Tasks   one track per task: when it ran, its spans (readDHT,
+ *             publish) and where it blocked on a queue
+ *     Queues  the depth of every queue over time
+ *
+ * Timestamps are microseconds since boot. The device keeps 32 bits; wraps
+ * are undone, so dumps of one run line up on a single time axis.
+ *
+ * Build:
+ *     cc -O2 -o sched_trace_json sched_trace_json.c
+ *
+ * Example:
+ *     ./sched_trace_json capture.log > trace.json
+ */
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CORES     2
+#define MAX_OBJECTS   256
+#define NAME_LENGTH   64
+
+#define PID_CPU       1
+#define PID_TASKS     2
+#define PID_QUEUES    3
+#define TID_ISR       100
+
+/*-----------------------------------------------------------*/
+
+typedef struct Object
+{
+    uint32_t address;
+    char name[ NAME_LENGTH ];
+    int tid;          /* Track in the Tasks group. */
+    bool named;       /* Track name written. */
+} Object_t;
+
+typedef struct Core
+{
+    Object_t * pRunning;
+    uint64_t since;
+    int isrDepth;
+} Core_t;
+
+static Object_t objects[ MAX_OBJECTS ];
+static size_t objectCount = 0;
+static Core_t cores[ MAX_CORES ];
+static int nextTid = 1;
+static bool firstEvent = true;
+static uint64_t lastTime = 0;
+static uint32_t lastRaw = 0;
+static uint64_t epoch = 0;
+
+/*-----------------------------------------------------------*/
+
+static void _emit( const char * pFormat,
+                   ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+static void _emit( const char * pFormat,
+                   ... )
+{
+    va_list args;
+
+    printf( firstEvent ? "\n  " : ",\n  " );
+    firstEvent = false;
+
+    va_start( args, pFormat );
+    vprintf( pFormat, args );
+    va_end( args );
+}
+
+/* Names come from the device; keep them valid inside a JSON string. */
+static const char * _jsonSafe( const char * pName )
+{
+    static char safe[ NAME_LENGTH ];
+    size_t i;
+
+    for( i = 0; ( pName[ i ] != '\0' ) && ( i < sizeof( safe ) - 1 ); i++ )
+    {
+        safe[ i ] = ( ( pName[ i ] == '"' ) || ( pName[ i ] == '\\' ) || ( ( unsigned char ) pName[ i ] < 0x20 ) ) ?
+                    '_' : pName[ i ];
+    }
+
+    safe[ i ] = '\0';
+
+    return safe;
+}
+
+static Object_t * _object( uint32_t address )
+{
+    size_t i;
+
+    for( i = 0; i < objectCount; i++ )
+    {
+        if( objects[ i ].address == address )
+        {
+            return &objects[ i ];
+        }
+    }
+
+    if( objectCount == MAX_OBJECTS )
+    {
+        return &objects[ MAX_OBJECTS - 1 ];
+    }
+
+    objects[ objectCount ].address = address;
+    snprintf( objects[ objectCount ].name, NAME_LENGTH, "0x%08" PRIx32, address );
+
+    return &objects[ objectCount++ ];
+}
+
+static int _taskTrack( Object_t * pTask )
+{
+    if( pTask == NULL )
+    {
+        return 0;
+    }
+
+    if( pTask->tid == 0 )
+    {
+        pTask->tid = nextTid++;
+    }
+
+    if( pTask->named == false )
+    {
+        _emit( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+               PID_TASKS, pTask->tid, _jsonSafe( pTask->name ) );
+        pTask->named = true;
+    }
+
+    return pTask->tid;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Close the running slice of a core at time t. */
+static void _endSlice( int core,
+                       uint64_t t )
+{
+    Core_t * pCore = &cores[ core ];
+
+    if( pCore->pRunning != NULL )
+    {
+        uint64_t duration = ( t > pCore->since ) ? t - pCore->since : 0;
+        const char * pName = _jsonSafe( pCore->pRunning->name );
+
+        _emit( "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 "}",
+               pName, PID_CPU, core, pCore->since, duration );
+        _emit( "{\"name\":\"running\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 ",\"dur\":%" PRIu64
+               ",\"args\":{\"core\":%d}}",
+               PID_TASKS, _taskTrack( pCore->pRunning ), pCore->since, duration, core );
+    }
+
+    pCore->pRunning = NULL;
+}
+
+static uint64_t _unwrap( uint32_t raw )
+{
+    /* Events from two cores may be slightly out of order; only a large
+     * step back is a wrap. */
+    if( ( raw < lastRaw ) && ( lastRaw - raw > 0x80000000u ) )
+    {
+        epoch += 0x100000000ull;
+    }
+
+    lastRaw = raw;
+
+    if( epoch + raw > lastTime )
+    {
+        lastTime = epoch + raw;
+    }
+
+    return epoch + raw;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _event( uint32_t raw,
+                    int core,
+                    char type,
+                    uint32_t address,
+                    uint32_t value,
+                    const char * pSpan )
+{
+    uint64_t t = _unwrap( raw );
+    Core_t * pCore = &cores[ core ];
+    Object_t * pObject;
+    int tid;
+
+    switch( type )
+    {
+        case 'S':
+            pObject = _object( address );
+            _endSlice( core, t );
+            pCore->pRunning = pObject;
+            pCore->since = t;
+            ( void ) _taskTrack( pObject );
+            break;
+
+        case 'Q':
+        case 'R':
+        case 'F':
+        case 'W':
+            pObject = _object( address );
+
+            if( type != 'W' )
+            {
+                long depth = ( long ) value + ( ( type == 'Q' ) ? 1 : ( type == 'R' ) ? -1 : 0 );
+
+                _emit( "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,\"ts\":%" PRIu64 ",\"args\":{\"depth\":%ld}}",
+                       _jsonSafe( pObject->name ), PID_QUEUES, t, depth );
+            }
+
+            if( ( type == 'Q' ) || ( type == 'R' ) )
+            {
+                break;
+            }
+
+            /* A full queue or a task blocking on one is marked where it
+             * happened. */
+            if( pCore->isrDepth > 0 )
+            {
+                _emit( "{\"name\":\"%s %s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}",
+                       ( type == 'F' ) ? "full" : "wait", _jsonSafe( pObject->name ), PID_CPU, TID_ISR + core, t );
+            }
+            else
+            {
+                tid = _taskTrack( pCore->pRunning );
+                _emit( "{\"name\":\"%s %s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}",
+                       ( type == 'F' ) ? "full" : "wait", _jsonSafe( pObject->name ), PID_TASKS, tid, t );
+            }
+
+            break;
+
+        case 'I':
+            pCore->isrDepth++;
+            _emit( "{\"name\":\"ISR %" PRIu32 "\",\"ph\":\"B\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}",
+                   address, PID_CPU, TID_ISR + core, t );
+            break;
+
+        case 'X':
+
+            if( pCore->isrDepth > 0 )
+            {
+                pCore->isrDepth--;
+                _emit( "{\"ph\":\"E\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}", PID_CPU, TID_ISR + core, t );
+            }
+
+            break;
+
+        case 'B':
+        case 'E':
+            tid = _taskTrack( pCore->pRunning );
+            _emit( "{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}",
+                   _jsonSafe( ( pSpan != NULL ) ? pSpan : "span" ), type, PID_TASKS, tid, t );
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    FILE * pInput = stdin;
+    char * pLine = NULL;
+    size_t capacity = 0;
+    unsigned long events = 0, dropped = 0, dumps = 0;
+    int core;
+
+    if( argc > 2 )
+    {
+        fprintf( stderr, "usage: %s [capture.log] > trace.json\n", argv[ 0 ] );
+        return 2;
+    }
+
+    if( argc == 2 )
+    {
+        pInput = fopen( argv[ 1 ], "r" );
+
+        if( pInput == NULL )
+        {
+            perror( argv[ 1 ] );
+            return 1;
+        }
+    }
+
+    printf( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+    _emit( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"CPU\"}}", PID_CPU );
+    _emit( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Tasks\"}}", PID_TASKS );
+    _emit( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Queues\"}}", PID_QUEUES );
+
+    for( core = 0; core < MAX_CORES; core++ )
+    {
+        _emit( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"core %d\"}}",
+               PID_CPU, core, core );
+        _emit( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"core %d ISR\"}}",
+               PID_CPU, TID_ISR + core, core );
+    }
+
+    while( getline( &pLine, &capacity, pInput ) > 0 )
+    {
+        char * pRecord = strstr( pLine, "SCHED," );
+        char name[ NAME_LENGTH ] = "";
+        char type;
+        unsigned long a, b;
+        uint32_t raw, address, value;
+
+        if( pRecord == NULL )
+        {
+            continue;
+        }
+
+        pRecord[ strcspn( pRecord, "\r\n" ) ] = '\0';
+
+        if( sscanf( pRecord, "SCHED,BEGIN,%*u,%lu,%lu", &a, &b ) == 2 )
+        {
+            events += a;
+            dropped += b;
+            dumps++;
+        }
+        else if( strcmp( pRecord, "SCHED,END" ) == 0 )
+        {
+            for( core = 0; core < MAX_CORES; core++ )
+            {
+                _endSlice( core, lastTime );
+                cores[ core ].isrDepth = 0;
+            }
+        }
+        else if( sscanf( pRecord, "SCHED,N,%" SCNx32 ",%63[^\n]", &address, name ) == 2 )
+        {
+            Object_t * pObject = _object( address );
+
+            strcpy( pObject->name, name );
+        }
+        else if( sscanf( pRecord, "SCHED,%" SCNu32 ",%d,%c,%" SCNx32 ",%" SCNu32 ",%63[^\n]",
+                         &raw, &core, &type, &address, &value, name ) >= 5 )
+        {
+            if( ( core >= 0 ) && ( core < MAX_CORES ) )
+            {
+                _event( raw, core, type, address, value, ( name[ 0 ] != '\0' ) ? name : NULL );
+            }
+        }
+    }
+
+    printf( "\n]}\n" );
+    fprintf( stderr, "%lu dumps, %lu events, %lu dropped on the device\n", dumps, events, dropped );
+
+    free( pLine );
+
+    return 0;
+}
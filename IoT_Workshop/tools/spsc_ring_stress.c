@@ -0,0 +1,403 @@
+/*
+ * spsc_ring_stress - run the ring and the start of the sampling task of the
+ * demos on two host threads, for ThreadSanitizer.
+ *
+ * The ring (driver/spsc_ring.h) is compiled into this program. One thread
+ * pushes -n numbered items, retrying while the ring is full; the other pops
+ * them in batches of 1 to 5 items and checks that every item arrives once,
+ * in order and with its content intact. The ring is small (-l slots) so
+ * that both ends wrap and meet all the time.
+ *
+ * The sampling task of the demos installs the vibration interrupt, whose
+ * handler notifies the task through a handle that its creator stores only
+ * once creation returns. The task therefore waits for a start notification
+ * before installing it. That start is then repeated -r times with threads
+ * for the creator, the task and the interrupt, and task notifications as a
+ * mutex and a condition variable. Every edge must be counted. With -u the
+ * interrupt is installed without waiting, as before the fix; this is a
+ * data race on the handle, which ThreadSanitizer reports.
+ *
+ * Any failure is printed and the program exits with status 1.
+ *
+ * Build:
+ *     cc -O1 -g -fsanitize=thread -pthread \
+ *         -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o spsc_ring_stress spsc_ring_stress.c
+ *
+ * Examples:
+ *     ./spsc_ring_stress
+ *     ./spsc_ring_stress -n 10000000 -l 4 -s 7
+ *     ./spsc_ring_stress -u
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/spsc_ring.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/spsc_ring.c"
+
+#define MAX_LENGTH                 ( 1024 )
+#define MAX_BATCH                  ( 5 )
+#define EDGES                      ( 64 )
+
+#define NOTIFY_EDGE                ( 1UL << 1 )
+#define NOTIFY_START               ( 1UL << 3 )
+
+/* An item the size of a demo message, whose content follows from its
+ * number. */
+typedef struct Item
+{
+    uint32_t sequence;
+    uint32_t check;
+    uint8_t fill[ 24 ];
+} Item_t;
+
+/* A task notification value. */
+typedef struct Notify
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint32_t bits;
+} Notify_t;
+
+/*-----------------------------------------------------------*/
+
+static SpscRing_t ring;
+static Item_t storage[ MAX_LENGTH ];
+static size_t itemCount = 2000000;
+static uint32_t seed = 1;
+
+/* As xSamplingTask: written by the creator, read by the interrupt. */
+static Notify_t * samplingTask;
+static uint32_t pendingEdges;
+static bool unsafeStart;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( uint32_t * pState )
+{
+    *pState ^= *pState << 13;
+    *pState ^= *pState >> 17;
+    *pState ^= *pState << 5;
+
+    return *pState;
+}
+
+/*-----------------------------------------------------------*/
+
+static void makeItem( Item_t * pItem,
+                      uint32_t sequence )
+{
+    size_t i;
+
+    pItem->sequence = sequence;
+    pItem->check = sequence * 2654435761UL;
+
+    for( i = 0; i < sizeof( pItem->fill ); i++ )
+    {
+        pItem->fill[ i ] = ( uint8_t ) ( sequence + i );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void * producer( void * pArgument )
+{
+    Item_t item;
+    uint32_t sequence;
+
+    ( void ) pArgument;
+
+    for( sequence = 0; sequence < itemCount; sequence++ )
+    {
+        makeItem( &item, sequence );
+
+        while( SpscRing_Push( &ring, &item ) == false )
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void * consumer( void * pArgument )
+{
+    Item_t batch[ MAX_BATCH ], expected;
+    uint32_t state = seed, sequence = 0;
+    size_t count, i;
+
+    ( void ) pArgument;
+
+    while( sequence < itemCount )
+    {
+        count = SpscRing_PopBatch( &ring, batch, 1 + nextRandom( &state ) % MAX_BATCH );
+
+        if( count == 0 )
+        {
+            sched_yield();
+            continue;
+        }
+
+        if( count > SpscRing_Capacity( &ring ) )
+        {
+            fprintf( stderr, "FAIL: popped %zu items from a ring of %zu\n",
+                     count, SpscRing_Capacity( &ring ) );
+
+            return ( void * ) 1;
+        }
+
+        for( i = 0; i < count; i++, sequence++ )
+        {
+            makeItem( &expected, sequence );
+
+            if( memcmp( &batch[ i ], &expected, sizeof( Item_t ) ) != 0 )
+            {
+                fprintf( stderr, "FAIL: item %u arrived as item %u (check %08x)\n",
+                         ( unsigned ) sequence, ( unsigned ) batch[ i ].sequence,
+                         ( unsigned ) batch[ i ].check );
+
+                return ( void * ) 1;
+            }
+        }
+    }
+
+    if( SpscRing_Count( &ring ) != 0 )
+    {
+        fprintf( stderr, "FAIL: %zu items left over\n", SpscRing_Count( &ring ) );
+
+        return ( void * ) 1;
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void notifySet( Notify_t * pNotify,
+                       uint32_t bits )
+{
+    pthread_mutex_lock( &pNotify->mutex );
+    pNotify->bits |= bits;
+    pthread_cond_signal( &pNotify->changed );
+    pthread_mutex_unlock( &pNotify->mutex );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Wait for any bit, up to 100 ms, then clear the bits given. */
+static uint32_t notifyWait( Notify_t * pNotify,
+                            uint32_t clearOnExit )
+{
+    struct timespec deadline;
+    uint32_t bits;
+
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_nsec += 100000000L;
+
+    if( deadline.tv_nsec >= 1000000000L )
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock( &pNotify->mutex );
+
+    while( pNotify->bits == 0 )
+    {
+        if( pthread_cond_timedwait( &pNotify->changed, &pNotify->mutex, &deadline ) == ETIMEDOUT )
+        {
+            break;
+        }
+    }
+
+    bits = pNotify->bits;
+    pNotify->bits &= ~clearOnExit;
+    pthread_mutex_unlock( &pNotify->mutex );
+
+    return bits;
+}
+
+/*-----------------------------------------------------------*/
+
+/* As gpio_isr_handler. */
+static void * vibrationInterrupt( void * pArgument )
+{
+    Notify_t * pTask;
+    size_t i;
+
+    ( void ) pArgument;
+
+    for( i = 0; i < EDGES; i++ )
+    {
+        ( void ) __atomic_add_fetch( &pendingEdges, 1, __ATOMIC_RELAXED );
+
+        pTask = samplingTask;
+
+        if( pTask != NULL )
+        {
+            notifySet( pTask, NOTIFY_EDGE );
+        }
+
+        if( ( i & 7 ) == 0 )
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+/* As the sampling task up to its loop, then counting edges. */
+static void * samplingTaskMain( void * pArgument )
+{
+    Notify_t * pSelf = pArgument;
+    pthread_t interrupt;
+    uint32_t notified;
+    size_t edges = 0;
+
+    if( unsafeStart == false )
+    {
+        do
+        {
+            notified = notifyWait( pSelf, NOTIFY_START );
+        } while( ( notified & NOTIFY_START ) == 0 );
+    }
+
+    /* gpio_isr_handler_add() */
+    pthread_create( &interrupt, NULL, vibrationInterrupt, NULL );
+
+    while( edges < EDGES )
+    {
+        ( void ) notifyWait( pSelf, UINT32_MAX );
+        edges += __atomic_exchange_n( &pendingEdges, 0, __ATOMIC_RELAXED );
+    }
+
+    pthread_join( interrupt, NULL );
+
+    return ( edges == EDGES ) ? NULL : ( void * ) 1;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool stressStart( size_t rounds )
+{
+    Notify_t task;
+    pthread_t thread;
+    void * pResult;
+    size_t round;
+
+    for( round = 0; round < rounds; round++ )
+    {
+        memset( &task, 0x00, sizeof( task ) );
+        pthread_mutex_init( &task.mutex, NULL );
+        pthread_cond_init( &task.changed, NULL );
+
+        /* xTaskCreateStaticPinnedToCore(), then the handle is stored and
+         * the task told to start. */
+        pthread_create( &thread, NULL, samplingTaskMain, &task );
+        samplingTask = &task;
+        notifySet( &task, NOTIFY_START );
+
+        pthread_join( thread, &pResult );
+        samplingTask = NULL;
+        pthread_cond_destroy( &task.changed );
+        pthread_mutex_destroy( &task.mutex );
+
+        if( pResult != NULL )
+        {
+            fprintf( stderr, "FAIL: round %zu lost edges\n", round );
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    size_t length = 16, rounds = 200;
+    pthread_t producerThread, consumerThread;
+    void * pResult;
+    int option;
+
+    while( ( option = getopt( argc, argv, "n:l:r:s:u" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                itemCount = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'l':
+                length = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'r':
+                rounds = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                seed = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            case 'u':
+                unsafeStart = true;
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n items] [-l slots] [-r rounds] [-s seed] [-u]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    if( ( length > MAX_LENGTH ) || ( itemCount > UINT32_MAX ) ||
+        ( SpscRing_Init( &ring, storage, sizeof( Item_t ), length ) == false ) )
+    {
+        fprintf( stderr, "slots must be a power of two up to %d\n", MAX_LENGTH );
+
+        return 2;
+    }
+
+    pthread_create( &producerThread, NULL, producer, NULL );
+    pthread_create( &consumerThread, NULL, consumer, NULL );
+    pthread_join( producerThread, NULL );
+    pthread_join( consumerThread, &pResult );
+
+    if( pResult != NULL )
+    {
+        return 1;
+    }
+
+    printf( "ring: %zu items through %zu slots in batches of 1 to %d\n",
+            itemCount, SpscRing_Capacity( &ring ), MAX_BATCH );
+
+    if( stressStart( rounds ) == false )
+    {
+        return 1;
+    }
+
+    printf( "start: %zu rounds of %d edges%s\n", rounds, EDGES,
+            unsafeStart ? ", interrupt installed before the handle was stored" : "" );
+
+    return 0;
+}
@@ -0,0 +1,561 @@
+/*
+ * stream_stats_check - check the running statistics of the demos against
+ * exact sums over a long run of readings.
+ *
+ * The statistics (driver/stream_stats.h) are compiled into this program and
+ * fed -n readings of four channels:
+ *     0  a DHT22-like temperature in tenths, a random walk with steps
+ *     1  a small noise on a large offset, near the top of int32_t
+ *     2  values spread over the whole of int32_t
+ *     3  a constant
+ * Every closed tumbling window is compared with its mean and variance
+ * computed from exact integer sums, and its minimum and maximum. After every
+ * reading the sliding window is compared with the same recursion carried
+ * out in long double, its variance must not be negative, and its minimum
+ * and maximum must cover the last -w readings and no more than 2 * -w. The
+ * constant must give a variance of exactly 0 and no anomaly throughout.
+ *
+ * A step is then put into a steady, noisy channel, which must give one
+ * anomaly, at the step and not before, and none while the channel settles.
+ *
+ * The worst errors are printed next to those of the textbook one-pass
+ * float formula, mean of squares less square of mean, over the same
+ * tumbling windows. Any failure is printed and the program exits with
+ * status 1.
+ *
+ * Build:
+ *     cc -O2 -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o stream_stats_check stream_stats_check.c -lm
+ *
+ * Examples:
+ *     ./stream_stats_check
+ *     ./stream_stats_check -n 100000000 -w 60 -s 7
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/stream_stats.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/stream_stats.c"
+
+#define CHANNELS                   ( 4 )
+#define MAX_WINDOW                 ( 10000 )
+
+/* Errors allowed: the summaries are floats, the sliding window doubles.
+ * A double mean near 2^31 is only held to 2^-22, which moves every
+ * deviation from it by as much; the error stays there however long the
+ * run, but reaches about 1e-9 of the variance of channel 1. */
+#define SUMMARY_TOLERANCE          ( 1e-6 )
+#define SLIDING_TOLERANCE          ( 1e-8 )
+
+/*-----------------------------------------------------------*/
+
+typedef struct Reference
+{
+    /* The open tumbling window, exactly. */
+    uint32_t count;
+    int64_t sum;
+    __int128 sumOfSquares;
+    int32_t min;
+    int32_t max;
+
+    /* The same, the textbook way in float. */
+    float naiveSum;
+    float naiveSumOfSquares;
+
+    /* The sliding window in long double. */
+    uint32_t seen;
+    long double mean;
+    long double variance;
+
+    /* The last 2 * window values, for the extremes. */
+    int32_t * pHistory;
+    uint64_t historyCount;
+} Reference_t;
+
+static uint32_t randomState = 1;
+static double worstMean[ CHANNELS ];
+static double worstVariance[ CHANNELS ];
+static double worstNaiveVariance[ CHANNELS ];
+static double worstSliding[ CHANNELS ];
+static unsigned failures;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( void )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+static void fail( uint64_t reading,
+                  size_t channel,
+                  const char * pWhat,
+                  double got,
+                  double expected )
+{
+    if( failures++ < 20 )
+    {
+        printf( "FAIL reading %llu channel %zu: %s is %.17g, expected %.17g\n",
+                ( unsigned long long ) reading, channel, pWhat, got, expected );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static double relativeError( double got,
+                             long double expected,
+                             long double scale )
+{
+    return ( double ) ( fabsl( ( long double ) got - expected ) / ( fabsl( scale ) + 1.0L ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t makeValue( size_t channel,
+                          uint64_t reading )
+{
+    static int32_t walk = 250;
+
+    switch( channel )
+    {
+        case 0:
+            /* A slow walk, a step now and then, and noise of the sensor. */
+            walk += ( int32_t ) ( nextRandom() % 3 ) - 1;
+
+            if( ( nextRandom() % 5000 ) == 0 )
+            {
+                walk += ( int32_t ) ( nextRandom() % 101 ) - 50;
+            }
+
+            if( ( walk < -400 ) || ( walk > 800 ) )
+            {
+                walk = 250;
+            }
+
+            return walk + ( int32_t ) ( nextRandom() % 3 ) - 1;
+
+        case 1:
+            return 2147000000 + ( int32_t ) ( nextRandom() % 2001 );
+
+        case 2:
+            return ( int32_t ) nextRandom();
+
+        default:
+            ( void ) reading;
+
+            return 1234;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void checkClosed( const StreamStats_t * pStats,
+                         Reference_t * pReference,
+                         size_t channel,
+                         uint64_t reading )
+{
+    StreamStatsSummary_t summary;
+    long double n = ( long double ) pReference->count;
+    long double mean = ( long double ) pReference->sum / n;
+    __int128 numerator = ( __int128 ) pReference->count * pReference->sumOfSquares -
+                         ( __int128 ) pReference->sum * pReference->sum;
+    long double variance = ( long double ) numerator / ( n * n );
+    double naiveMean = pReference->naiveSum / ( float ) pReference->count;
+    double naiveVariance = pReference->naiveSumOfSquares / ( float ) pReference->count - naiveMean * naiveMean;
+    double error;
+
+    StreamStats_Tumbling( pStats, channel, &summary );
+
+    if( summary.ulCount != pReference->count )
+    {
+        fail( reading, channel, "the count", summary.ulCount, pReference->count );
+    }
+
+    if( ( summary.lMin != pReference->min ) || ( summary.lMax != pReference->max ) )
+    {
+        fail( reading, channel, "the minimum", summary.lMin, pReference->min );
+        fail( reading, channel, "the maximum", summary.lMax, pReference->max );
+    }
+
+    error = relativeError( summary.fMean, mean, mean );
+    worstMean[ channel ] = fmax( worstMean[ channel ], error );
+
+    if( error > SUMMARY_TOLERANCE )
+    {
+        fail( reading, channel, "the mean", summary.fMean, ( double ) mean );
+    }
+
+    /* Relative to the spread, or to the values when there is none. */
+    error = relativeError( summary.fVariance, variance, ( variance > 0.0L ) ? variance : mean * mean );
+    worstVariance[ channel ] = fmax( worstVariance[ channel ], error );
+    worstNaiveVariance[ channel ] = fmax( worstNaiveVariance[ channel ],
+                                          relativeError( naiveVariance, variance, ( variance > 0.0L ) ? variance : mean * mean ) );
+
+    if( ( error > SUMMARY_TOLERANCE ) || ( ( variance == 0.0L ) && ( summary.fVariance != 0.0f ) ) )
+    {
+        fail( reading, channel, "the variance", summary.fVariance, ( double ) variance );
+    }
+
+    pReference->count = 0;
+    pReference->sum = 0;
+    pReference->sumOfSquares = 0;
+    pReference->naiveSum = 0.0f;
+    pReference->naiveSumOfSquares = 0.0f;
+}
+
+/*-----------------------------------------------------------*/
+
+static void checkSliding( const StreamStats_t * pStats,
+                          const Reference_t * pReference,
+                          size_t channel,
+                          uint32_t window,
+                          uint64_t reading )
+{
+    const StreamStatsChannel_t * pChannel = &( pStats->xChannels[ channel ] );
+    StreamStatsSummary_t summary;
+    int32_t lastMin = INT32_MAX, lastMax = INT32_MIN, allMin = INT32_MAX, allMax = INT32_MIN, value;
+    uint64_t i, available = pReference->historyCount;
+    double error;
+
+    /* The mean relative to the values, or to their spread if larger. */
+    error = fmax( relativeError( pChannel->dSlidingMean, pReference->mean,
+                                 fabsl( pReference->mean ) + sqrtl( pReference->variance ) ),
+                  relativeError( pChannel->dSlidingVariance, pReference->variance,
+                                 ( pReference->variance > 0.0L ) ? pReference->variance : pReference->mean * pReference->mean ) );
+    worstSliding[ channel ] = fmax( worstSliding[ channel ], error );
+
+    if( error > SLIDING_TOLERANCE )
+    {
+        fail( reading, channel, "the sliding mean", pChannel->dSlidingMean, ( double ) pReference->mean );
+        fail( reading, channel, "the sliding variance", pChannel->dSlidingVariance, ( double ) pReference->variance );
+    }
+
+    if( !( pChannel->dSlidingVariance >= 0.0 ) )
+    {
+        fail( reading, channel, "the sliding variance", pChannel->dSlidingVariance, 0.0 );
+    }
+
+    if( available > 2ULL * window )
+    {
+        available = 2ULL * window;
+    }
+
+    for( i = 0; i < available; i++ )
+    {
+        value = pReference->pHistory[ ( pReference->historyCount - 1 - i ) % ( 2ULL * window ) ];
+
+        if( i < window )
+        {
+            lastMin = ( value < lastMin ) ? value : lastMin;
+            lastMax = ( value > lastMax ) ? value : lastMax;
+        }
+
+        allMin = ( value < allMin ) ? value : allMin;
+        allMax = ( value > allMax ) ? value : allMax;
+    }
+
+    StreamStats_Sliding( pStats, channel, &summary );
+
+    if( ( summary.lMin > lastMin ) || ( summary.lMin < allMin ) )
+    {
+        fail( reading, channel, "the sliding minimum", summary.lMin, lastMin );
+    }
+
+    if( ( summary.lMax < lastMax ) || ( summary.lMax > allMax ) )
+    {
+        fail( reading, channel, "the sliding maximum", summary.lMax, lastMax );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void addReference( Reference_t * pReference,
+                          int32_t value,
+                          uint32_t window,
+                          long double alphaFloor )
+{
+    long double alpha, delta;
+
+    if( pReference->count == 0 )
+    {
+        pReference->min = value;
+        pReference->max = value;
+    }
+
+    pReference->min = ( value < pReference->min ) ? value : pReference->min;
+    pReference->max = ( value > pReference->max ) ? value : pReference->max;
+    pReference->count++;
+    pReference->sum += value;
+    pReference->sumOfSquares += ( __int128 ) value * value;
+    pReference->naiveSum += ( float ) value;
+    pReference->naiveSumOfSquares += ( float ) value * ( float ) value;
+
+    if( pReference->seen < window )
+    {
+        pReference->seen++;
+    }
+
+    alpha = 1.0L / ( long double ) pReference->seen;
+    alpha = ( alpha < alphaFloor ) ? alphaFloor : alpha;
+    delta = ( long double ) value - pReference->mean;
+    pReference->mean += alpha * delta;
+    pReference->variance = ( 1.0L - alpha ) * ( pReference->variance + alpha * delta * delta );
+
+    pReference->pHistory[ pReference->historyCount % ( 2ULL * window ) ] = value;
+    pReference->historyCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkLongRun( uint64_t readings,
+                          uint32_t window )
+{
+    static StreamStats_t stats;
+    static Reference_t references[ CHANNELS ];
+    StreamStatsConfig_t config =
+    {
+        .uxChannels    = CHANNELS,
+        .ulWindow      = window,
+        .fZThreshold   = 4.0f,
+        .lMinDeviation = { 2, 2, 2, 2 }
+    };
+    int32_t values[ CHANNELS ];
+    float zScores[ CHANNELS ];
+    uint32_t anomalies;
+    uint64_t reading, addNs = 0, start;
+    long double alphaFloor = 2.0L / ( ( long double ) window + 1.0L );
+    bool closed;
+    size_t channel;
+
+    if( StreamStats_Init( &stats, &config ) == false )
+    {
+        printf( "FAIL: the configuration was refused\n" );
+
+        return false;
+    }
+
+    for( channel = 0; channel < CHANNELS; channel++ )
+    {
+        memset( &references[ channel ], 0, sizeof( Reference_t ) );
+        references[ channel ].pHistory = calloc( 2 * window, sizeof( int32_t ) );
+
+        if( references[ channel ].pHistory == NULL )
+        {
+            printf( "FAIL: out of memory\n" );
+
+            return false;
+        }
+    }
+
+    for( reading = 0; reading < readings; reading++ )
+    {
+        for( channel = 0; channel < CHANNELS; channel++ )
+        {
+            values[ channel ] = makeValue( channel, reading );
+        }
+
+        start = nowNs();
+        closed = StreamStats_Add( &stats, values, zScores, &anomalies );
+        addNs += nowNs() - start;
+
+        for( channel = 0; channel < CHANNELS; channel++ )
+        {
+            addReference( &references[ channel ], values[ channel ], window, alphaFloor );
+        }
+
+        if( closed != ( references[ 0 ].count == window ) )
+        {
+            fail( reading, 0, "the window closing", closed, references[ 0 ].count == window );
+        }
+
+        if( ( ( anomalies & ( 1UL << 3 ) ) != 0 ) || ( zScores[ 3 ] != 0.0f ) )
+        {
+            fail( reading, 3, "the z-score of the constant", zScores[ 3 ], 0.0 );
+        }
+
+        for( channel = 0; channel < CHANNELS; channel++ )
+        {
+            if( closed )
+            {
+                checkClosed( &stats, &references[ channel ], channel, reading );
+            }
+
+            /* Every reading early on, then a sample of them, since the
+             * extremes are checked against the whole history. */
+            if( ( ( reading * window ) < 2000000ULL ) || ( ( nextRandom() & 63 ) == 0 ) )
+            {
+                checkSliding( &stats, &references[ channel ], channel, window, reading );
+            }
+        }
+
+        if( failures > 20 )
+        {
+            break;
+        }
+    }
+
+    printf( "%llu readings of %d channels, window %u, %.1f ns per reading\n",
+            ( unsigned long long ) reading, CHANNELS, window, ( double ) addNs / ( double ) reading );
+    printf( "%-8s %14s %14s %14s %16s\n", "channel", "mean err", "variance err", "sliding err", "float 1-pass err" );
+
+    for( channel = 0; channel < CHANNELS; channel++ )
+    {
+        printf( "%-8zu %14.3g %14.3g %14.3g %16.3g\n",
+                channel, worstMean[ channel ], worstVariance[ channel ],
+                worstSliding[ channel ], worstNaiveVariance[ channel ] );
+        free( references[ channel ].pHistory );
+    }
+
+    return failures == 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkAnomaly( uint32_t window )
+{
+    StreamStats_t stats;
+    StreamStatsConfig_t config =
+    {
+        .uxChannels    = 1,
+        .ulWindow      = window,
+        .fZThreshold   = 3.0f,
+        .lMinDeviation = { 2 }
+    };
+    uint32_t anomalies, events = 0;
+    uint64_t reading, stepAt = 10ULL * window, firstEvent = 0;
+    float z;
+    int32_t value;
+
+    ( void ) StreamStats_Init( &stats, &config );
+
+    for( reading = 0; reading < 20ULL * window; reading++ )
+    {
+        /* Noise of one tenth, then a step of 3 degrees that stays. */
+        value = 250 + ( int32_t ) ( nextRandom() % 3 ) - 1 + ( ( reading >= stepAt ) ? 30 : 0 );
+        ( void ) StreamStats_Add( &stats, &value, &z, &anomalies );
+
+        if( anomalies != 0 )
+        {
+            firstEvent = ( events == 0 ) ? reading : firstEvent;
+            events++;
+        }
+    }
+
+    printf( "step of 30 at reading %llu: %u anomaly event(s), first at %llu\n",
+            ( unsigned long long ) stepAt, events, ( unsigned long long ) firstEvent );
+
+    if( ( events != 1 ) || ( firstEvent != stepAt ) )
+    {
+        printf( "FAIL: expected one anomaly event, at the step\n" );
+
+        return false;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkConfig( void )
+{
+    StreamStats_t stats;
+    StreamStatsConfig_t good = { .uxChannels = 1, .ulWindow = 2, .fZThreshold = 1.0f, .lMinDeviation = { 1 } };
+    StreamStatsConfig_t bad;
+    bool ok = StreamStats_Init( &stats, &good );
+
+    bad = good;
+    bad.uxChannels = 0;
+    ok = ok && ( StreamStats_Init( &stats, &bad ) == false );
+    bad = good;
+    bad.uxChannels = streamstatsMAX_CHANNELS + 1;
+    ok = ok && ( StreamStats_Init( &stats, &bad ) == false );
+    bad = good;
+    bad.ulWindow = 1;
+    ok = ok && ( StreamStats_Init( &stats, &bad ) == false );
+    bad = good;
+    bad.fZThreshold = NAN;
+    ok = ok && ( StreamStats_Init( &stats, &bad ) == false );
+    bad = good;
+    bad.lMinDeviation[ 0 ] = 0;
+    ok = ok && ( StreamStats_Init( &stats, &bad ) == false );
+
+    if( ok == false )
+    {
+        printf( "FAIL: a configuration was wrongly accepted or refused\n" );
+    }
+
+    return ok;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    uint64_t readings = 10000000;
+    unsigned long window = 20;
+    int option;
+    bool ok;
+
+    while( ( option = getopt( argc, argv, "n:w:s:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                readings = strtoull( optarg, NULL, 0 );
+                break;
+
+            case 'w':
+                window = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                randomState = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n readings] [-w window] [-s seed]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    if( ( window < 2 ) || ( window > MAX_WINDOW ) || ( readings == 0 ) )
+    {
+        fprintf( stderr, "window must be 2 to %d, readings at least 1\n", MAX_WINDOW );
+
+        return 2;
+    }
+
+    ok = checkConfig();
+    ok = checkAnomaly( ( uint32_t ) window ) && ok;
+    ok = checkLongRun( readings, ( uint32_t ) window ) && ok;
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+
+    return ok ? 0 : 1;
+}
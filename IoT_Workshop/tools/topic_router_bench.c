@@ -0,0 +1,573 @@
+/*
+ * topic_router_bench - check the topic trie of the demos against a plain
+ * MQTT filter matcher, then time both with thousands of filters.
+ *
+ * The router (driver/topic_router.h) is compiled into this program with
+ * room for a fleet's worth of filters. It is first run on a table of
+ * cases taken from the MQTT 3.1.1 rules ('+', '#', '#' matching its
+ * parent level, empty levels, '$' topics), then on random filters and
+ * topics whose matches are counted by a reference matcher tried against
+ * every filter in turn. Any difference is printed and the program exits
+ * with status 1 before anything is timed.
+ *
+ * The benchmark registers -n filters shaped like per-device and per-group
+ * command topics, with a few wildcards, and routes -m topic names through
+ *     linear   the reference matcher over the whole filter list, as a list
+ *              of subscriptions is searched
+ *     trie     TopicRouter_Dispatch()
+ * reporting the time per message and the handlers called.
+ *
+ * Built with -DDEVICE_DEFAULTS=1 the router keeps the sizes it has on the
+ * device, and only the self-check runs; random filters are then added
+ * until the router is full.
+ *
+ * Build:
+ *     cc -O2 -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o topic_router_bench topic_router_bench.c
+ *     cc -O2 -DDEVICE_DEFAULTS=1 -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o topic_router_check topic_router_bench.c
+ *
+ * Examples:
+ *     ./topic_router_bench
+ *     ./topic_router_bench -n 20000 -m 1000000 -s 7
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DEVICE_DEFAULTS
+    #define DEVICE_DEFAULTS        0
+#endif
+
+/* Room for the largest benchmark. */
+#if DEVICE_DEFAULTS == 0
+    #define topicrouterMAX_NODES     ( 65535 )
+    #define topicrouterMAX_ROUTES    ( 65534 )
+    #define topicrouterHASH_SLOTS    ( 131072 )
+#endif
+
+#include "driver/topic_router.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/topic_router.c"
+
+#define MAX_FILTERS                ( 60000 )
+#define MAX_TOPIC                  ( 64 )
+#define RANDOM_ROUNDS              ( 200 )
+#define RANDOM_FILTERS             ( 40 )
+#define RANDOM_TOPICS              ( 200 )
+
+/*-----------------------------------------------------------*/
+
+static TopicRouter_t router;
+static char filters[ MAX_FILTERS ][ MAX_TOPIC ];
+static size_t filterLengths[ MAX_FILTERS ];
+static size_t filterCount;
+static uint64_t handled;
+static uint32_t randomState = 1;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( void )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/* MQTT 3.1.1 section 4.7, one filter against one topic name. */
+static bool referenceMatch( const char * pFilter,
+                            size_t filterLength,
+                            const char * pTopic,
+                            size_t topicLength )
+{
+    size_t f = 0, t = 0;
+
+    if( ( topicLength > 0 ) && ( pTopic[ 0 ] == '$' ) &&
+        ( filterLength > 0 ) && ( ( pFilter[ 0 ] == '+' ) || ( pFilter[ 0 ] == '#' ) ) )
+    {
+        return false;
+    }
+
+    while( f < filterLength )
+    {
+        if( pFilter[ f ] == '#' )
+        {
+            return true;
+        }
+
+        if( pFilter[ f ] == '+' )
+        {
+            while( ( t < topicLength ) && ( pTopic[ t ] != '/' ) )
+            {
+                t++;
+            }
+
+            f++;
+        }
+        else
+        {
+            while( ( f < filterLength ) && ( pFilter[ f ] != '/' ) )
+            {
+                if( ( t >= topicLength ) || ( pTopic[ t ] != pFilter[ f ] ) )
+                {
+                    return false;
+                }
+
+                f++;
+                t++;
+            }
+
+            if( ( t < topicLength ) && ( pTopic[ t ] != '/' ) )
+            {
+                return false;
+            }
+        }
+
+        if( f == filterLength )
+        {
+            return t == topicLength;
+        }
+
+        /* The filter goes on; a topic that ends here only matches "/#". */
+        if( t == topicLength )
+        {
+            return ( filterLength - f == 2 ) && ( pFilter[ f + 1 ] == '#' );
+        }
+
+        f++;
+        t++;
+    }
+
+    return t == topicLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t referenceDispatch( const char * pTopic,
+                                 size_t topicLength )
+{
+    size_t i, matched = 0;
+
+    for( i = 0; i < filterCount; i++ )
+    {
+        if( referenceMatch( filters[ i ], filterLengths[ i ], pTopic, topicLength ) == true )
+        {
+            handled++;
+            matched++;
+        }
+    }
+
+    return matched;
+}
+
+/*-----------------------------------------------------------*/
+
+static void countHandler( void * pContext,
+                          const char * pTopic,
+                          size_t topicLength,
+                          void * pMessage )
+{
+    ( void ) pContext;
+    ( void ) pTopic;
+    ( void ) topicLength;
+    ( void ) pMessage;
+
+    handled++;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool addFilter( const char * pFilter )
+{
+    if( filterCount >= MAX_FILTERS )
+    {
+        return false;
+    }
+
+    snprintf( filters[ filterCount ], MAX_TOPIC, "%s", pFilter );
+    filterLengths[ filterCount ] = strlen( filters[ filterCount ] );
+
+    if( TopicRouter_Add( &router,
+                         filters[ filterCount ],
+                         filterLengths[ filterCount ],
+                         countHandler,
+                         NULL ) == false )
+    {
+        fprintf( stderr, "cannot add filter %s\n", pFilter );
+
+        return false;
+    }
+
+    filterCount++;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkTopic( const char * pTopic )
+{
+    size_t expected = referenceDispatch( pTopic, strlen( pTopic ) );
+    size_t routed = TopicRouter_Dispatch( &router, pTopic, strlen( pTopic ), NULL );
+    size_t i;
+
+    if( routed == expected )
+    {
+        return true;
+    }
+
+    fprintf( stderr, "topic \"%s\": trie called %zu handlers, expected %zu; filters:\n",
+             pTopic, routed, expected );
+
+    for( i = 0; i < filterCount; i++ )
+    {
+        fprintf( stderr, "    %s%s\n", filters[ i ],
+                 referenceMatch( filters[ i ], strlen( filters[ i ] ), pTopic, strlen( pTopic ) ) ? "  (match)" : "" );
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static void randomName( char * pName,
+                        bool wildcards )
+{
+    static const char * const levels[] = { "a", "b", "c", "", "$a", "+", "#" };
+    size_t depth = 1 + nextRandom() % 4, i, length = 0;
+    const char * pLevel;
+
+    pName[ 0 ] = '\0';
+
+    for( i = 0; i < depth; i++ )
+    {
+        do
+        {
+            pLevel = levels[ nextRandom() % ( wildcards ? 7 : 5 ) ];
+        } while( ( pLevel[ 0 ] == '$' ) && ( i > 0 ) );
+
+        length += snprintf( pName + length, MAX_TOPIC - length, "%s%s", ( i > 0 ) ? "/" : "", pLevel );
+
+        if( pLevel[ 0 ] == '#' )
+        {
+            break;
+        }
+    }
+
+    /* Neither filters nor topic names may be empty. */
+    if( length == 0 )
+    {
+        snprintf( pName, MAX_TOPIC, "a" );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool selfCheck( void )
+{
+    static const char * const cases[][ 2 ] =
+    {
+        { "sport/tennis/player1/#", "sport/tennis/player1"               },
+        { "sport/tennis/player1/#", "sport/tennis/player1/ranking"       },
+        { "sport/tennis/player1/#", "sport/tennis/player1/score/wimbledon" },
+        { "sport/#",                "sport"                              },
+        { "#",                      "sport/tennis"                       },
+        { "sport/tennis/+",         "sport/tennis/player1"               },
+        { "sport/+",                "sport/"                             },
+        { "+/+",                    "/finance"                           },
+        { "/+",                     "/finance"                           },
+        { "+",                      "/finance"                           },
+        { "sport/+",                "sport"                              },
+        { "#",                      "$SYS/monitor"                       },
+        { "+/monitor",              "$SYS/monitor"                       },
+        { "$SYS/#",                 "$SYS/monitor"                       },
+        { "$SYS/monitor/+",         "$SYS/monitor/Clients"               },
+        { "a//b",                   "a//b"                               },
+        { "a/+/b",                  "a//b"                               },
+    };
+    char name[ MAX_TOPIC ];
+    size_t i, round, length;
+
+    for( i = 0; i < sizeof( cases ) / sizeof( cases[ 0 ] ); i++ )
+    {
+        TopicRouter_Init( &router );
+        filterCount = 0;
+
+        if( ( addFilter( cases[ i ][ 0 ] ) == false ) || ( checkTopic( cases[ i ][ 1 ] ) == false ) )
+        {
+            return false;
+        }
+    }
+
+    /* Wildcards that are not a whole level, or '#' before the end. */
+    TopicRouter_Init( &router );
+
+    if( ( TopicRouter_Add( &router, "a/b+", 4, countHandler, NULL ) == true ) ||
+        ( TopicRouter_Add( &router, "a/#/b", 5, countHandler, NULL ) == true ) ||
+        ( TopicRouter_Add( &router, "a#", 2, countHandler, NULL ) == true ) )
+    {
+        fprintf( stderr, "an invalid filter was accepted\n" );
+
+        return false;
+    }
+
+    /* Every filter of {a,+}/{a,+}/{a,+}/{a,+} matches "a/a/a/a": sixteen
+     * nodes are in the running at the last level. This fits the device
+     * sizes. */
+    TopicRouter_Init( &router );
+    filterCount = 0;
+
+    for( i = 0; i < 16; i++ )
+    {
+        snprintf( name, sizeof( name ), "%s/%s/%s/%s",
+                  ( i & 1 ) ? "+" : "a", ( i & 2 ) ? "+" : "a",
+                  ( i & 4 ) ? "+" : "a", ( i & 8 ) ? "+" : "a" );
+
+        if( addFilter( name ) == false )
+        {
+            return false;
+        }
+    }
+
+    if( ( checkTopic( "a/a/a/a" ) == false ) || ( checkTopic( "a/b/a/b" ) == false ) )
+    {
+        return false;
+    }
+
+    for( round = 0; round < RANDOM_ROUNDS; round++ )
+    {
+        TopicRouter_Init( &router );
+        filterCount = 0;
+
+        /* The same filter may come up twice; it then has two handlers. */
+        for( i = 0; i < RANDOM_FILTERS; i++ )
+        {
+            randomName( filters[ filterCount ], true );
+            length = strlen( filters[ filterCount ] );
+
+            /* Only a full router may refuse a valid filter. */
+            if( TopicRouter_Add( &router, filters[ filterCount ], length, countHandler, NULL ) == false )
+            {
+                if( ( router.usRouteCount < topicrouterMAX_ROUTES ) &&
+                    ( router.usNodeCount < topicrouterMAX_NODES ) )
+                {
+                    fprintf( stderr, "filter %s refused with room left\n", filters[ filterCount ] );
+
+                    return false;
+                }
+
+                /* Its levels stay, without a handler. */
+                break;
+            }
+
+            filterLengths[ filterCount++ ] = length;
+        }
+
+        for( i = 0; i < RANDOM_TOPICS; i++ )
+        {
+            randomName( name, false );
+
+            if( checkTopic( name ) == false )
+            {
+                return false;
+            }
+        }
+    }
+
+    printf( "self-check: %zu cases, %d random rounds passed\n",
+            sizeof( cases ) / sizeof( cases[ 0 ] ), RANDOM_ROUNDS );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool buildFleet( size_t count )
+{
+    char name[ MAX_TOPIC ];
+    size_t i, groups = count / 100 + 1;
+
+    TopicRouter_Init( &router );
+    filterCount = 0;
+
+    /* A few broad routes, as the demos register. */
+    if( ( addFilter( "fleet/cmd/all" ) == false ) ||
+        ( addFilter( "fleet/#" ) == false ) ||
+        ( addFilter( "fleet/device/+/ota/#" ) == false ) )
+    {
+        return false;
+    }
+
+    for( i = 0; filterCount < count; i++ )
+    {
+        if( i % 100 < 90 )
+        {
+            snprintf( name, sizeof( name ), "fleet/device/dev%06zu/cmd", i );
+        }
+        else if( i % 100 < 98 )
+        {
+            snprintf( name, sizeof( name ), "fleet/group/g%04zu/+/cmd", i % groups );
+        }
+        else
+        {
+            snprintf( name, sizeof( name ), "fleet/device/dev%06zu/config/+", i );
+        }
+
+        if( addFilter( name ) == false )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void makeTopic( char * pTopic,
+                       size_t count )
+{
+    uint32_t r = nextRandom();
+    size_t device = nextRandom() % count;
+
+    switch( r % 8 )
+    {
+        case 0:
+            snprintf( pTopic, MAX_TOPIC, "fleet/group/g%04zu/dev%06zu/cmd", device % ( count / 100 + 1 ), device );
+            break;
+
+        case 1:
+            snprintf( pTopic, MAX_TOPIC, "fleet/device/dev%06zu/ota/chunk/%u", device, r % 97 );
+            break;
+
+        case 2:
+            snprintf( pTopic, MAX_TOPIC, "other/device/dev%06zu/cmd", device );
+            break;
+
+        default:
+            snprintf( pTopic, MAX_TOPIC, "fleet/device/dev%06zu/cmd", device );
+            break;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    static char topics[ 4096 ][ MAX_TOPIC ];
+    static size_t topicLengths[ 4096 ];
+    size_t count = 5000, messages = 200000, i;
+    uint64_t start, linearNs, trieNs, linearHandled, trieHandled;
+    int option;
+
+    while( ( option = getopt( argc, argv, "n:m:s:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'n':
+                count = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'm':
+                messages = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 's':
+                randomState = ( uint32_t ) strtoul( optarg, NULL, 0 ) | 1;
+                break;
+
+            default:
+                fprintf( stderr, "usage: %s [-n filters] [-m messages] [-s seed]\n", argv[ 0 ] );
+
+                return 2;
+        }
+    }
+
+    if( ( count < 3 ) || ( count > MAX_FILTERS ) || ( messages == 0 ) )
+    {
+        fprintf( stderr, "filters must be 3 to %d, messages at least 1\n", MAX_FILTERS );
+
+        return 2;
+    }
+
+    if( selfCheck() == false )
+    {
+        return 1;
+    }
+
+    #if DEVICE_DEFAULTS != 0
+        printf( "device sizes: %d nodes, %d routes, %d slots\n",
+                topicrouterMAX_NODES, topicrouterMAX_ROUTES, topicrouterHASH_SLOTS );
+
+        return 0;
+    #endif
+
+    if( buildFleet( count ) == false )
+    {
+        return 1;
+    }
+
+    for( i = 0; i < 4096; i++ )
+    {
+        makeTopic( topics[ i ], count );
+        topicLengths[ i ] = strlen( topics[ i ] );
+
+        if( checkTopic( topics[ i ] ) == false )
+        {
+            return 1;
+        }
+    }
+
+    handled = 0;
+    start = nowNs();
+
+    for( i = 0; i < messages; i++ )
+    {
+        ( void ) referenceDispatch( topics[ i & 4095 ], topicLengths[ i & 4095 ] );
+    }
+
+    linearNs = nowNs() - start;
+    linearHandled = handled;
+
+    handled = 0;
+    start = nowNs();
+
+    for( i = 0; i < messages; i++ )
+    {
+        ( void ) TopicRouter_Dispatch( &router, topics[ i & 4095 ], topicLengths[ i & 4095 ], NULL );
+    }
+
+    trieNs = nowNs() - start;
+    trieHandled = handled;
+
+    printf( "filters %zu, trie nodes %u, messages %zu\n",
+            filterCount, ( unsigned ) router.usNodeCount, messages );
+    printf( "%-8s %12s %14s\n", "path", "ns/message", "handlers/msg" );
+    printf( "%-8s %12.1f %14.3f\n", "linear", ( double ) linearNs / messages, ( double ) linearHandled / messages );
+    printf( "%-8s %12.1f %14.3f\n", "trie", ( double ) trieNs / messages, ( double ) trieHandled / messages );
+    printf( "speedup %.1fx\n", ( double ) linearNs / ( double ) trieNs );
+
+    return ( linearHandled == trieHandled ) ? 0 : 1;
+}
@@ -0,0 +1,1293 @@
+/*
+ * trace_replay - replay a recorded demo trace through a model of the
+ * publish pipeline under a virtual clock.
+ *
+ * The trace is the console log of the Lab1 MQTT demo built with
+ * IOT_DEMO_MQTT_TRACE=1 (see demos/mqtt/iot_demo_trace.h); lines other
+ * than TRACE records are ignored, so a raw serial capture can be used:
+ *
+ *     TRACE,<us>,S,<humidity>,<temperature>,<status>   sensor reading
+ *     TRACE,<us>,V                                      vibration edge
+ *     TRACE,<us>,P,<publish number>,<payload bytes>     PUBLISH issued
+ *     TRACE,<us>,A,<publish number>,<result>            PUBLISH completed
+ *
+ * The model follows the demo (demos/mqtt/iot_demo_mqtt.c): a periodic
+ * timer reads the sensor (the recorded signal, sample and hold), and the
+ * reading is pushed to the ring unless both channels are within the
+ * deadband of the last one pushed; the GPIO interrupt pushes vibration
+ * edges to the same ring. One task takes up to IOT_DEMO_MQTT_RING_BATCH
+ * messages at a time, once the ring holds `batch` of them, and publishes
+ * each as its own QoS 1 PUBLISH, keeping at most
+ * IOT_DEMO_MQTT_INFLIGHT_LENGTH in flight; one that fails is published
+ * again before anything new. Payloads are formatted as the demo formats
+ * them. Acknowledgement latencies and failures are taken from the A
+ * records in order, so every configuration sees the same broker.
+ *
+ * With adaptive=1 the period follows the good readings through the
+ * controller of the demo (driver/adaptive_period.h), and each change of
+ * period is published as the demo does; with stats=1 the window summaries
+ * and anomalies of driver/stream_stats.h are published too. Comparing
+ * adaptive with fixed periods shows the readings and publishes saved for
+ * the tracking error of each. Record the trace at the shortest period with
+ * the controller off (IOT_DEMO_MQTT_ADAPTIVE=0,
+ * IOT_DEMO_MQTT_SAMPLE_PERIOD_MS=2000), so that the recorded signal is
+ * finer than any period replayed. The defaults are those of the demo; a
+ * demo built with other IOT_DEMO_MQTT_* values is followed by building
+ * this with the same -D options.
+ *
+ * Events are processed in time order without waiting, so a day of trace
+ * replays in well under a second. Each -c configuration is replayed on the
+ * same input and reported on one line.
+ *
+ * Build:
+ *     cc -O2 -I../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/include \
+ *         -o trace_replay trace_replay.c -lm
+ *
+ * Examples:
+ *     ./trace_replay -c adaptive=0 -c adaptive=0,period=10000 -c adaptive=0,deadband=0.3,batch=4 capture.log
+ *     ./trace_replay -c adaptive=0 -c adaptive=0,period=10000 -c adaptive=1 -c adaptive=1,at=0.5 capture.log
+ *     ./trace_replay -g 86400 > day.trace     (synthetic day from the simulator model)
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/adaptive_period.h"
+#include "driver/stream_stats.h"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/adaptive_period.c"
+#include "../Lab1/AmazonFreeRTOS/vendors/espressif/esp-idf/components/driver/stream_stats.c"
+
+#define MAX_CONFIGS           16
+#define MAX_QUEUE             256
+#define DEFAULT_ACK_US        50000
+#define DRAIN_US              600000000LL  /* After the trace, to finish what is queued. */
+
+/* The demo's defaults, as in demos/mqtt/iot_demo_mqtt.c. */
+#ifndef IOT_DEMO_MQTT_TOPIC_PREFIX
+    #define IOT_DEMO_MQTT_TOPIC_PREFIX                     "iotdemo"
+#endif
+#ifndef IOT_DEMO_MQTT_RING_LENGTH
+    #define IOT_DEMO_MQTT_RING_LENGTH                      ( 16 )
+#endif
+#ifndef IOT_DEMO_MQTT_RING_BATCH
+    #define IOT_DEMO_MQTT_RING_BATCH                       ( 4 )
+#endif
+#ifndef IOT_DEMO_MQTT_INFLIGHT_LENGTH
+    #define IOT_DEMO_MQTT_INFLIGHT_LENGTH                  ( 8 )
+#endif
+#ifndef IOT_DEMO_MQTT_SAMPLE_PERIOD_MS
+    #define IOT_DEMO_MQTT_SAMPLE_PERIOD_MS                 ( 3000 )
+#endif
+#ifndef IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS
+    #define IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS             ( 2000 )
+#endif
+#ifndef IOT_DEMO_MQTT_DEADBAND_TENTHS
+    #define IOT_DEMO_MQTT_DEADBAND_TENTHS                  ( 0 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE
+    #define IOT_DEMO_MQTT_ADAPTIVE                         ( 1 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS
+    #define IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS           ( 30000 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS
+    #define IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS        ( 3 )
+#endif
+#ifndef IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS
+    #define IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS    ( 10 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS
+    #define IOT_DEMO_MQTT_STATS                            ( 1 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_WINDOW
+    #define IOT_DEMO_MQTT_STATS_WINDOW                     ( 20 )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_Z_THRESHOLD
+    #define IOT_DEMO_MQTT_STATS_Z_THRESHOLD                ( 4.0f )
+#endif
+#ifndef IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS
+    #define IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS       ( 2 )
+#endif
+
+/* The demo's topic and payload formats. */
+#define TOPIC_LENGTH          ( sizeof( IOT_DEMO_MQTT_TOPIC_PREFIX "/topic/XXX" ) - 1 )
+#define DHT_FORMAT            "{\"Humidity\":%.1f,\"Temperature\":%.1f}"
+#define VIB_FORMAT            "{\"Detect\":%s}"
+#define PERIOD_FORMAT         "{\"SamplePeriodMs\":%lu}"
+#define SUMMARY_FORMAT        "{\"Window\":\"%s\",\"Count\":%lu,\"Mean\":%.2f,\"Variance\":%.3f,\"Min\":%.1f,\"Max\":%.1f}"
+#define ANOMALY_FORMAT        "{\"Anomaly\":\"%s\",\"Value\":%.1f,\"Z\":%.1f}"
+
+/*-----------------------------------------------------------*/
+
+typedef struct Sample
+{
+    int64_t time;
+    float humidity;
+    float temperature;
+    int status;
+} Sample_t;
+
+typedef struct Trace
+{
+    Sample_t * pSamples;
+    size_t sampleCount;
+    int64_t * pEdges;
+    size_t edgeCount;
+    int64_t * pAckLatencies;   /* By publish number order. */
+    bool * pAckFailed;
+    size_t ackCount;
+    int64_t start;
+    int64_t end;
+} Trace_t;
+
+typedef struct Config
+{
+    char name[ 128 ];
+    int64_t periodUs;          /* Sampling period. */
+    size_t queueLength;        /* Length of the ring. */
+    int64_t formatUs;          /* Demo task time to format a message. */
+    int64_t publishUs;         /* Demo task time per PUBLISH. */
+    size_t batch;              /* Messages gathered in the ring before publishing. */
+    int32_t deadbandTenths;    /* Smallest change of a reading that is published. */
+    bool adaptive;             /* The period follows the readings. */
+    int64_t minPeriodUs;       /* Bounds of the adaptive period. */
+    int64_t maxPeriodUs;
+    double stepT;              /* Temperature change aimed for between readings. */
+    double stepH;              /* Humidity change aimed for between readings. */
+    bool stats;                /* Window summaries and anomalies are published. */
+} Config_t;
+
+typedef enum MessageType
+{
+    MESSAGE_READING,
+    MESSAGE_VIBRATION,
+    MESSAGE_PERIOD,            /* A change of sampling period. */
+    MESSAGE_SUMMARY,
+    MESSAGE_ANOMALY
+} MessageType_t;
+
+typedef struct Message
+{
+    MessageType_t type;
+    int64_t time;              /* When the event happened. */
+    float humidity;
+    float temperature;
+    size_t payloadBytes;       /* As the demo formats it. */
+} Message_t;
+
+/* A slot of the demo's in-flight table. */
+typedef struct Inflight
+{
+    bool used;
+    bool failed;               /* To be published again once completed. */
+    int64_t completedAt;
+    uint64_t number;           /* The oldest failed PUBLISH goes again first. */
+    Message_t message;
+} Inflight_t;
+
+/* A value the cloud side has received. */
+typedef struct Delivery
+{
+    int64_t time;
+    float humidity;
+    float temperature;
+} Delivery_t;
+
+typedef struct Result
+{
+    uint64_t samples;
+    uint64_t suppressed;
+    uint64_t samplesDropped;
+    uint64_t edges;
+    uint64_t edgesDropped;
+    uint64_t periodChanges;
+    uint64_t summaries;
+    uint64_t anomalies;
+    uint64_t publishes;
+    uint64_t failedPublishes;
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t left;             /* Not acknowledged when the replay ended. */
+    uint64_t busyUs;
+    int64_t * pLatencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    Delivery_t * pDeliveries;
+    size_t deliveryCount;
+    size_t deliveryCapacity;
+} Result_t;
+
+/*-----------------------------------------------------------*/
+
+static void * growArray( void * pArray,
+                         size_t * pCapacity,
+                         size_t count,
+                         size_t size )
+{
+    if( count < *pCapacity )
+    {
+        return pArray;
+    }
+
+    *pCapacity = ( *pCapacity == 0 ) ? 1024 : *pCapacity * 2;
+    pArray = realloc( pArray, *pCapacity * size );
+
+    if( pArray == NULL )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 1 );
+    }
+
+    return pArray;
+}
+
+static int compareInt64( const void * a,
+                         const void * b )
+{
+    int64_t x = *( const int64_t * ) a, y = *( const int64_t * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+static int compareSamples( const void * a,
+                           const void * b )
+{
+    return compareInt64( &( ( const Sample_t * ) a )->time, &( ( const Sample_t * ) b )->time );
+}
+
+static int compareDeliveries( const void * a,
+                              const void * b )
+{
+    return compareInt64( &( ( const Delivery_t * ) a )->time, &( ( const Delivery_t * ) b )->time );
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct PublishRecord
+{
+    long number;
+    int64_t issued;
+    int64_t completed;
+    int result;
+} PublishRecord_t;
+
+static int comparePublishes( const void * a,
+                             const void * b )
+{
+    long x = ( ( const PublishRecord_t * ) a )->number, y = ( ( const PublishRecord_t * ) b )->number;
+
+    return ( x > y ) - ( x < y );
+}
+
+static PublishRecord_t * findPublish( PublishRecord_t * pRecords,
+                                      size_t count,
+                                      long number )
+{
+    /* Records usually arrive in order, so look back from the end. */
+    size_t i;
+
+    for( i = count; i > 0; i-- )
+    {
+        if( pRecords[ i - 1 ].number == number )
+        {
+            return &( pRecords[ i - 1 ] );
+        }
+    }
+
+    return NULL;
+}
+
+static void loadTrace( FILE * pFile,
+                       Trace_t * pTrace )
+{
+    char line[ 512 ];
+    char * pRecord;
+    long long time;
+    char type;
+    size_t sampleCapacity = 0, edgeCapacity = 0, publishCapacity = 0, publishCount = 0, i;
+    PublishRecord_t * pPublishes = NULL, * pPublish;
+    Sample_t sample;
+    long number;
+    int value;
+    bool haveTime = false;
+
+    memset( pTrace, 0, sizeof( Trace_t ) );
+
+    while( fgets( line, sizeof( line ), pFile ) != NULL )
+    {
+        pRecord = strstr( line, "TRACE," );
+
+        if( ( pRecord == NULL ) || ( sscanf( pRecord, "TRACE,%lld,%c", &time, &type ) != 2 ) )
+        {
+            continue;
+        }
+
+        pRecord = strchr( strchr( pRecord + 6, ',' ) + 1, ',' );
+
+        switch( type )
+        {
+            case 'S':
+                sample.time = time;
+
+                if( ( pRecord == NULL ) ||
+                    ( sscanf( pRecord, ",%f,%f,%d", &sample.humidity, &sample.temperature, &sample.status ) != 3 ) )
+                {
+                    continue;
+                }
+
+                pTrace->pSamples = growArray( pTrace->pSamples, &sampleCapacity, pTrace->sampleCount, sizeof( Sample_t ) );
+                pTrace->pSamples[ pTrace->sampleCount++ ] = sample;
+                break;
+
+            case 'V':
+                pTrace->pEdges = growArray( pTrace->pEdges, &edgeCapacity, pTrace->edgeCount, sizeof( int64_t ) );
+                pTrace->pEdges[ pTrace->edgeCount++ ] = time;
+                break;
+
+            case 'P':
+            case 'A':
+
+                if( ( pRecord == NULL ) || ( sscanf( pRecord, ",%ld,%d", &number, &value ) != 2 ) )
+                {
+                    continue;
+                }
+
+                pPublish = findPublish( pPublishes, publishCount, number );
+
+                if( pPublish == NULL )
+                {
+                    pPublishes = growArray( pPublishes, &publishCapacity, publishCount, sizeof( PublishRecord_t ) );
+                    pPublish = &( pPublishes[ publishCount++ ] );
+                    memset( pPublish, 0, sizeof( PublishRecord_t ) );
+                    pPublish->number = number;
+                    pPublish->issued = -1;
+                    pPublish->completed = -1;
+                }
+
+                if( type == 'P' )
+                {
+                    pPublish->issued = time;
+                }
+                else
+                {
+                    pPublish->completed = time;
+                    pPublish->result = value;
+                }
+
+                break;
+
+            default:
+                continue;
+        }
+
+        if( ( haveTime == false ) || ( time < pTrace->start ) )
+        {
+            pTrace->start = time;
+            haveTime = true;
+        }
+
+        if( time > pTrace->end )
+        {
+            pTrace->end = time;
+        }
+    }
+
+    qsort( pTrace->pSamples, pTrace->sampleCount, sizeof( Sample_t ), compareSamples );
+    qsort( pTrace->pEdges, pTrace->edgeCount, sizeof( int64_t ), compareInt64 );
+    qsort( pPublishes, publishCount, sizeof( PublishRecord_t ), comparePublishes );
+
+    pTrace->pAckLatencies = calloc( publishCount + 1, sizeof( int64_t ) );
+    pTrace->pAckFailed = calloc( publishCount + 1, sizeof( bool ) );
+
+    for( i = 0; i < publishCount; i++ )
+    {
+        if( ( pPublishes[ i ].issued >= 0 ) && ( pPublishes[ i ].completed >= pPublishes[ i ].issued ) )
+        {
+            pTrace->pAckLatencies[ pTrace->ackCount ] = pPublishes[ i ].completed - pPublishes[ i ].issued;
+            pTrace->pAckFailed[ pTrace->ackCount ] = ( pPublishes[ i ].result != 0 );
+            pTrace->ackCount++;
+        }
+    }
+
+    free( pPublishes );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Pipeline model. */
+
+typedef struct Pipeline
+{
+    const Config_t * pConfig;
+    const Trace_t * pTrace;
+    Result_t * pResult;
+
+    Message_t queue[ MAX_QUEUE ];
+    size_t queueHead;
+    size_t queueCount;
+
+    Message_t batch[ IOT_DEMO_MQTT_RING_BATCH ];
+    size_t batchCount;
+    size_t batchNext;
+
+    Inflight_t inflight[ IOT_DEMO_MQTT_INFLIGHT_LENGTH ];
+
+    int64_t taskFreeAt;        /* The demo task is busy until then. */
+    size_t nextAck;
+
+    bool haveQueued;           /* The deadband is from the last reading pushed. */
+    int32_t queuedHumidity;
+    int32_t queuedTemperature;
+} Pipeline_t;
+
+/* A reading in tenths, rounded as the demo rounds it. */
+static int32_t toTenths( float value )
+{
+    return ( int32_t ) ( ( value * 10.0f ) + ( ( value < 0.0f ) ? -0.5f : 0.5f ) );
+}
+
+static size_t payloadBytes( const char * pFormat,
+                            ... )
+{
+    va_list args;
+    int length;
+
+    va_start( args, pFormat );
+    length = vsnprintf( NULL, 0, pFormat, args );
+    va_end( args );
+
+    return ( length > 0 ) ? ( size_t ) length : 0;
+}
+
+/* A QoS 1 PUBLISH of the payload on the demo's topic: fixed header,
+ * remaining length, topic and packet identifier. */
+static size_t publishBytes( size_t payload )
+{
+    size_t remaining = 2 + TOPIC_LENGTH + 2 + payload;
+
+    return 1 + ( ( remaining < 128 ) ? 1 : ( remaining < 16384 ) ? 2 : 3 ) + remaining;
+}
+
+static void enqueue( Pipeline_t * pPipeline,
+                     const Message_t * pMessage )
+{
+    if( pPipeline->queueCount == pPipeline->pConfig->queueLength )
+    {
+        if( pMessage->type == MESSAGE_VIBRATION )
+        {
+            pPipeline->pResult->edgesDropped++;
+        }
+        else if( pMessage->type == MESSAGE_READING )
+        {
+            pPipeline->pResult->samplesDropped++;
+        }
+
+        return;
+    }
+
+    pPipeline->queue[ ( pPipeline->queueHead + pPipeline->queueCount ) % MAX_QUEUE ] = *pMessage;
+    pPipeline->queueCount++;
+}
+
+/* Free the slots acknowledged by `now`; those that failed stay. */
+static void settleInflight( Pipeline_t * pPipeline,
+                            int64_t now )
+{
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( pPipeline->inflight[ i ].used && ( pPipeline->inflight[ i ].completedAt <= now ) &&
+            ( pPipeline->inflight[ i ].failed == false ) )
+        {
+            pPipeline->inflight[ i ].used = false;
+        }
+    }
+}
+
+/* The oldest PUBLISH that failed by `now`, or NULL. */
+static Inflight_t * nextResend( Pipeline_t * pPipeline,
+                                int64_t now )
+{
+    Inflight_t * pOldest = NULL, * pSlot;
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        pSlot = &( pPipeline->inflight[ i ] );
+
+        if( pSlot->used && pSlot->failed && ( pSlot->completedAt <= now ) &&
+            ( ( pOldest == NULL ) || ( pSlot->number < pOldest->number ) ) )
+        {
+            pOldest = pSlot;
+        }
+    }
+
+    return pOldest;
+}
+
+static Inflight_t * freeInflight( Pipeline_t * pPipeline )
+{
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( pPipeline->inflight[ i ].used == false )
+        {
+            return &( pPipeline->inflight[ i ] );
+        }
+    }
+
+    return NULL;
+}
+
+/* Every completion wakes the task; false if none comes by `until`. */
+static bool waitForCompletion( Pipeline_t * pPipeline,
+                               int64_t until )
+{
+    int64_t next = INT64_MAX;
+    size_t i;
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( pPipeline->inflight[ i ].used && ( pPipeline->inflight[ i ].completedAt > pPipeline->taskFreeAt ) &&
+            ( pPipeline->inflight[ i ].completedAt < next ) )
+        {
+            next = pPipeline->inflight[ i ].completedAt;
+        }
+    }
+
+    if( next > until )
+    {
+        return false;
+    }
+
+    pPipeline->taskFreeAt = next;
+
+    return true;
+}
+
+/* Format and publish the message of a slot, one PUBLISH each. */
+static void publish( Pipeline_t * pPipeline,
+                     Inflight_t * pSlot,
+                     int64_t now )
+{
+    Result_t * pResult = pPipeline->pResult;
+    const Trace_t * pTrace = pPipeline->pTrace;
+    const Message_t * pMessage = &( pSlot->message );
+    int64_t ackLatency = DEFAULT_ACK_US, doneAt;
+    bool failed = false;
+
+    if( pTrace->ackCount > 0 )
+    {
+        ackLatency = pTrace->pAckLatencies[ pPipeline->nextAck % pTrace->ackCount ];
+        failed = pTrace->pAckFailed[ pPipeline->nextAck % pTrace->ackCount ];
+        pPipeline->nextAck++;
+    }
+
+    doneAt = now + pPipeline->pConfig->formatUs + pPipeline->pConfig->publishUs;
+    pPipeline->taskFreeAt = doneAt;
+    pResult->busyUs += ( uint64_t ) ( doneAt - now );
+    pResult->bytes += publishBytes( pMessage->payloadBytes );
+
+    pSlot->used = true;
+    pSlot->failed = failed;
+    pSlot->completedAt = doneAt + ackLatency;
+    pSlot->number = pResult->publishes++;
+
+    if( failed )
+    {
+        pResult->failedPublishes++;
+
+        return;
+    }
+
+    pResult->messages++;
+    pResult->pLatencies = growArray( pResult->pLatencies, &pResult->latencyCapacity,
+                                     pResult->latencyCount, sizeof( int64_t ) );
+    pResult->pLatencies[ pResult->latencyCount++ ] = pSlot->completedAt - pMessage->time;
+
+    if( pMessage->type == MESSAGE_READING )
+    {
+        pResult->pDeliveries = growArray( pResult->pDeliveries, &pResult->deliveryCapacity,
+                                          pResult->deliveryCount, sizeof( Delivery_t ) );
+        pResult->pDeliveries[ pResult->deliveryCount ].time = pSlot->completedAt;
+        pResult->pDeliveries[ pResult->deliveryCount ].humidity = pMessage->humidity;
+        pResult->pDeliveries[ pResult->deliveryCount ].temperature = pMessage->temperature;
+        pResult->deliveryCount++;
+    }
+}
+
+/* Let the demo task work until `until`, or until it blocks. */
+static void runTask( Pipeline_t * pPipeline,
+                     int64_t until )
+{
+    Inflight_t * pSlot;
+    int64_t now;
+
+    for( ; ; )
+    {
+        now = pPipeline->taskFreeAt;
+
+        if( now > until )
+        {
+            return;
+        }
+
+        settleInflight( pPipeline, now );
+        pSlot = nextResend( pPipeline, now );
+
+        if( pSlot == NULL )
+        {
+            /* A new batch once the last is all published, and with a
+             * batch set, once the ring holds that many. */
+            if( pPipeline->batchNext == pPipeline->batchCount )
+            {
+                if( ( pPipeline->queueCount == 0 ) || ( pPipeline->queueCount < pPipeline->pConfig->batch ) )
+                {
+                    if( waitForCompletion( pPipeline, until ) == false )
+                    {
+                        return;
+                    }
+
+                    continue;
+                }
+
+                for( pPipeline->batchCount = 0;
+                     ( pPipeline->batchCount < IOT_DEMO_MQTT_RING_BATCH ) && ( pPipeline->queueCount > 0 );
+                     pPipeline->batchCount++ )
+                {
+                    pPipeline->batch[ pPipeline->batchCount ] = pPipeline->queue[ pPipeline->queueHead ];
+                    pPipeline->queueHead = ( pPipeline->queueHead + 1 ) % MAX_QUEUE;
+                    pPipeline->queueCount--;
+                }
+
+                pPipeline->batchNext = 0;
+            }
+
+            /* With every slot in flight, wait for a completion. */
+            pSlot = freeInflight( pPipeline );
+
+            if( pSlot == NULL )
+            {
+                if( waitForCompletion( pPipeline, until ) == false )
+                {
+                    return;
+                }
+
+                continue;
+            }
+
+            pSlot->message = pPipeline->batch[ pPipeline->batchNext++ ];
+        }
+
+        publish( pPipeline, pSlot, now );
+    }
+}
+
+/* The task wakes when a message arrives while it is idle. */
+static void deliver( Pipeline_t * pPipeline,
+                     const Message_t * pMessage )
+{
+    runTask( pPipeline, pMessage->time );
+
+    if( pPipeline->taskFreeAt < pMessage->time )
+    {
+        pPipeline->taskFreeAt = pMessage->time;
+    }
+
+    enqueue( pPipeline, pMessage );
+}
+
+/* Whether a reading has moved far enough from the last one pushed, on
+ * either channel, to be published. */
+static bool outsideDeadband( Pipeline_t * pPipeline,
+                             const Sample_t * pSample )
+{
+    int32_t humidity = toTenths( pSample->humidity );
+    int32_t temperature = toTenths( pSample->temperature );
+    int32_t deadband = pPipeline->pConfig->deadbandTenths;
+
+    if( pPipeline->haveQueued &&
+        ( abs( humidity - pPipeline->queuedHumidity ) < deadband ) &&
+        ( abs( temperature - pPipeline->queuedTemperature ) < deadband ) )
+    {
+        return false;
+    }
+
+    pPipeline->haveQueued = true;
+    pPipeline->queuedHumidity = humidity;
+    pPipeline->queuedTemperature = temperature;
+
+    return true;
+}
+
+/* The summaries and anomalies of a good reading, pushed after it. */
+static void updateStats( Pipeline_t * pPipeline,
+                         StreamStats_t * pStats,
+                         const Sample_t * pSample,
+                         const int32_t * pValues,
+                         int64_t now )
+{
+    static const char * const channels[ 2 ] = { "Temperature", "Humidity" };
+    StreamStatsSummary_t summary;
+    Message_t message;
+    float zScores[ 2 ];
+    uint32_t anomalies = 0;
+    size_t channel;
+    bool closed;
+
+    closed = StreamStats_Add( pStats, pValues, zScores, &anomalies );
+    memset( &message, 0, sizeof( message ) );
+    message.time = now;
+
+    for( channel = 0; channel < 2; channel++ )
+    {
+        if( ( anomalies & ( 1UL << channel ) ) != 0 )
+        {
+            message.type = MESSAGE_ANOMALY;
+            message.payloadBytes = payloadBytes( ANOMALY_FORMAT, channels[ channel ],
+                                                 ( channel == 0 ) ? pSample->temperature : pSample->humidity,
+                                                 zScores[ channel ] );
+            pPipeline->pResult->anomalies++;
+            deliver( pPipeline, &message );
+        }
+
+        if( closed )
+        {
+            StreamStats_Tumbling( pStats, channel, &summary );
+            message.type = MESSAGE_SUMMARY;
+            message.payloadBytes = payloadBytes( SUMMARY_FORMAT, channels[ channel ],
+                                                 ( unsigned long ) summary.ulCount,
+                                                 summary.fMean / 10.0f, summary.fVariance / 100.0f,
+                                                 ( float ) summary.lMin / 10.0f, ( float ) summary.lMax / 10.0f );
+            pPipeline->pResult->summaries++;
+            deliver( pPipeline, &message );
+        }
+    }
+}
+
+static void replay( const Trace_t * pTrace,
+                    const Config_t * pConfig,
+                    Result_t * pResult )
+{
+    Pipeline_t pipeline;
+    Message_t message;
+    size_t nextSample = 0, nextEdge = 0, i;
+    int64_t periodUs = pConfig->periodUs;
+    int64_t nextTick = pTrace->start + periodUs;
+    const Sample_t * pHeld = NULL;
+    bool good = false;
+    AdaptivePeriod_t controller;
+    AdaptivePeriodConfig_t controllerConfig =
+    {
+        .ulMinMs    = ( uint32_t ) ( pConfig->minPeriodUs / 1000 ),
+        .ulMaxMs    = ( uint32_t ) ( pConfig->maxPeriodUs / 1000 ),
+        .uxChannels = 2,
+        .lStep      = { ( int32_t ) lround( pConfig->stepT * 10.0 ), ( int32_t ) lround( pConfig->stepH * 10.0 ) }
+    };
+    StreamStats_t stats;
+    static const StreamStatsConfig_t statsConfig =
+    {
+        .uxChannels    = 2,
+        .ulWindow      = IOT_DEMO_MQTT_STATS_WINDOW,
+        .fZThreshold   = IOT_DEMO_MQTT_STATS_Z_THRESHOLD,
+        .lMinDeviation = { IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS, IOT_DEMO_MQTT_STATS_MIN_DEVIATION_TENTHS }
+    };
+    int32_t values[ 2 ];
+    uint32_t nextMs;
+
+    /* Checked by parseConfig(). */
+    ( void ) AdaptivePeriod_Init( &controller, &controllerConfig );
+    ( void ) StreamStats_Init( &stats, &statsConfig );
+
+    memset( &pipeline, 0, sizeof( pipeline ) );
+    memset( &message, 0, sizeof( message ) );
+    memset( pResult, 0, sizeof( Result_t ) );
+    pipeline.pConfig = pConfig;
+    pipeline.pTrace = pTrace;
+    pipeline.pResult = pResult;
+    pipeline.taskFreeAt = pTrace->start;
+
+    while( ( nextTick <= pTrace->end ) || ( nextEdge < pTrace->edgeCount ) )
+    {
+        if( ( nextEdge < pTrace->edgeCount ) && ( pTrace->pEdges[ nextEdge ] < nextTick ) )
+        {
+            message.type = MESSAGE_VIBRATION;
+            message.time = pTrace->pEdges[ nextEdge++ ];
+            message.payloadBytes = payloadBytes( VIB_FORMAT, "\"Vibrating\"" );
+            pResult->edges++;
+            deliver( &pipeline, &message );
+            continue;
+        }
+
+        if( nextTick > pTrace->end )
+        {
+            break;
+        }
+
+        /* Timer: read the recorded signal as of now. A failed read gives
+         * the last good values again, and is published as the demo does,
+         * but is not adapted or counted on. */
+        while( ( nextSample < pTrace->sampleCount ) && ( pTrace->pSamples[ nextSample ].time <= nextTick ) )
+        {
+            good = ( pTrace->pSamples[ nextSample ].status == 0 );
+
+            if( good )
+            {
+                pHeld = &( pTrace->pSamples[ nextSample ] );
+            }
+
+            nextSample++;
+        }
+
+        if( pHeld != NULL )
+        {
+            pResult->samples++;
+
+            if( outsideDeadband( &pipeline, pHeld ) )
+            {
+                message.type = MESSAGE_READING;
+                message.time = nextTick;
+                message.humidity = pHeld->humidity;
+                message.temperature = pHeld->temperature;
+                message.payloadBytes = payloadBytes( DHT_FORMAT, pHeld->humidity, pHeld->temperature );
+                deliver( &pipeline, &message );
+            }
+            else
+            {
+                pResult->suppressed++;
+            }
+
+            /* The demo adapts on the readings in tenths, after queueing
+             * the reading, and publishes the new period; then it updates
+             * the statistics. */
+            values[ 0 ] = toTenths( pHeld->temperature );
+            values[ 1 ] = toTenths( pHeld->humidity );
+
+            if( good && pConfig->adaptive )
+            {
+                nextMs = AdaptivePeriod_Next( &controller, ( uint32_t ) ( periodUs / 1000 ), values );
+
+                if( ( int64_t ) nextMs * 1000 != periodUs )
+                {
+                    periodUs = ( int64_t ) nextMs * 1000;
+                    pResult->periodChanges++;
+                    message.type = MESSAGE_PERIOD;
+                    message.time = nextTick;
+                    message.payloadBytes = payloadBytes( PERIOD_FORMAT, ( unsigned long ) nextMs );
+                    deliver( &pipeline, &message );
+                }
+            }
+
+            if( good && pConfig->stats )
+            {
+                updateStats( &pipeline, &stats, pHeld, values, nextTick );
+            }
+        }
+
+        nextTick += periodUs;
+    }
+
+    /* Let the task finish what is queued, for as long as the broker
+     * allows. */
+    runTask( &pipeline, pTrace->end + DRAIN_US );
+
+    pResult->left = pipeline.queueCount + ( pipeline.batchCount - pipeline.batchNext );
+
+    for( i = 0; i < IOT_DEMO_MQTT_INFLIGHT_LENGTH; i++ )
+    {
+        if( pipeline.inflight[ i ].used &&
+            ( pipeline.inflight[ i ].failed || ( pipeline.inflight[ i ].completedAt > pTrace->end + DRAIN_US ) ) )
+        {
+            pResult->left++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static double percentileMs( int64_t * pValues,
+                            size_t count,
+                            double fraction )
+{
+    size_t index;
+
+    if( count == 0 )
+    {
+        return 0.0;
+    }
+
+    index = ( size_t ) ceil( fraction * ( double ) count );
+    index = ( index == 0 ) ? 0 : index - 1;
+
+    return ( double ) pValues[ index ] / 1000.0;
+}
+
+/* How far the cloud's latest temperature and humidity are from the recorded
+ * signal, evaluated at every recorded sample. */
+static void trackingError( const Trace_t * pTrace,
+                           Result_t * pResult,
+                           double * pTemperatureMean,
+                           double * pTemperatureMax,
+                           double * pHumidityMean,
+                           double * pStalenessMax )
+{
+    size_t i, next = 0, count = 0;
+    const Delivery_t * pCurrent = NULL;
+    double errorT, errorH, sumT = 0.0, sumH = 0.0, maxT = 0.0;
+    int64_t lastTime = pTrace->start, gap, maxGap = 0;
+
+    qsort( pResult->pDeliveries, pResult->deliveryCount, sizeof( Delivery_t ), compareDeliveries );
+
+    for( i = 0; i < pResult->deliveryCount; i++ )
+    {
+        gap = pResult->pDeliveries[ i ].time - lastTime;
+        maxGap = ( gap > maxGap ) ? gap : maxGap;
+        lastTime = pResult->pDeliveries[ i ].time;
+    }
+
+    gap = pTrace->end - lastTime;
+    maxGap = ( gap > maxGap ) ? gap : maxGap;
+
+    for( i = 0; i < pTrace->sampleCount; i++ )
+    {
+        const Sample_t * pSample = &( pTrace->pSamples[ i ] );
+
+        if( pSample->status != 0 )
+        {
+            continue;
+        }
+
+        while( ( next < pResult->deliveryCount ) && ( pResult->pDeliveries[ next ].time <= pSample->time ) )
+        {
+            pCurrent = &( pResult->pDeliveries[ next++ ] );
+        }
+
+        if( pCurrent == NULL )
+        {
+            continue;
+        }
+
+        errorT = fabs( pSample->temperature - pCurrent->temperature );
+        errorH = fabs( pSample->humidity - pCurrent->humidity );
+        sumT += errorT;
+        sumH += errorH;
+        maxT = ( errorT > maxT ) ? errorT : maxT;
+        count++;
+    }
+
+    *pTemperatureMean = ( count > 0 ) ? sumT / ( double ) count : 0.0;
+    *pTemperatureMax = maxT;
+    *pHumidityMean = ( count > 0 ) ? sumH / ( double ) count : 0.0;
+    *pStalenessMax = ( double ) maxGap / 1e6;
+}
+
+static void report( const Trace_t * pTrace,
+                    const Config_t * pConfig,
+                    Result_t * pResult,
+                    bool json )
+{
+    double hours = ( double ) ( pTrace->end - pTrace->start ) / 3.6e9;
+    double meanT, maxT, meanH, staleness;
+
+    qsort( pResult->pLatencies, pResult->latencyCount, sizeof( int64_t ), compareInt64 );
+    trackingError( pTrace, pResult, &meanT, &maxT, &meanH, &staleness );
+
+    if( json )
+    {
+        printf( "{\"config\":\"%s\",\"samples\":%llu,\"suppressed\":%llu,\"samples_dropped\":%llu,"
+                "\"edges\":%llu,\"edges_dropped\":%llu,\"period_changes\":%llu,\"summaries\":%llu,\"anomalies\":%llu,"
+                "\"publishes\":%llu,\"failed_publishes\":%llu,\"messages\":%llu,\"bytes\":%llu,\"left\":%llu,\"samples_per_hour\":%.1f,\"publishes_per_hour\":%.1f,\"bytes_per_hour\":%.0f,"
+                "\"task_busy\":%.6f,\"latency_ms\":{\"p50\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+                "\"temperature_error\":{\"mean\":%.3f,\"max\":%.2f},\"humidity_error_mean\":%.3f,"
+                "\"max_staleness_s\":%.1f}\n",
+                pConfig->name,
+                ( unsigned long long ) pResult->samples,
+                ( unsigned long long ) pResult->suppressed,
+                ( unsigned long long ) pResult->samplesDropped,
+                ( unsigned long long ) pResult->edges,
+                ( unsigned long long ) pResult->edgesDropped,
+                ( unsigned long long ) pResult->periodChanges,
+                ( unsigned long long ) pResult->summaries,
+                ( unsigned long long ) pResult->anomalies,
+                ( unsigned long long ) pResult->publishes,
+                ( unsigned long long ) pResult->failedPublishes,
+                ( unsigned long long ) pResult->messages,
+                ( unsigned long long ) pResult->bytes,
+                ( unsigned long long ) pResult->left,
+                hours > 0.0 ? ( double ) pResult->samples / hours : 0.0,
+                hours > 0.0 ? ( double ) pResult->publishes / hours : 0.0,
+                hours > 0.0 ? ( double ) pResult->bytes / hours : 0.0,
+                ( double ) pResult->busyUs / ( double ) ( pTrace->end - pTrace->start + 1 ),
+                percentileMs( pResult->pLatencies, pResult->latencyCount, 0.50 ),
+                percentileMs( pResult->pLatencies, pResult->latencyCount, 0.99 ),
+                percentileMs( pResult->pLatencies, pResult->latencyCount, 1.0 ),
+                meanT, maxT, meanH, staleness );
+    }
+    else
+    {
+        printf( "%-40s samp/h %7.1f  pub/h %8.1f  B/h %9.0f  drop %llu/%llu  supp %llu  left %llu  "
+                "lat ms p50 %7.1f p99 %7.1f  dT mean %.3f max %.2f  dH mean %.3f  stale %.0fs\n",
+                pConfig->name,
+                hours > 0.0 ? ( double ) pResult->samples / hours : 0.0,
+                hours > 0.0 ? ( double ) pResult->publishes / hours : 0.0,
+                hours > 0.0 ? ( double ) pResult->bytes / hours : 0.0,
+                ( unsigned long long ) ( pResult->samplesDropped + pResult->edgesDropped ),
+                ( unsigned long long ) ( pResult->samples - pResult->suppressed + pResult->edges ),
+                ( unsigned long long ) pResult->suppressed,
+                ( unsigned long long ) pResult->left,
+                percentileMs( pResult->pLatencies, pResult->latencyCount, 0.50 ),
+                percentileMs( pResult->pLatencies, pResult->latencyCount, 0.99 ),
+                meanT, maxT, meanH, staleness );
+    }
+
+    free( pResult->pLatencies );
+    free( pResult->pDeliveries );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool parseConfig( const char * pSpec,
+                         Config_t * pConfig )
+{
+    char copy[ 256 ];
+    char * pSave = NULL, * pItem, * pValue;
+    double value;
+
+    AdaptivePeriod_t controller;
+    AdaptivePeriodConfig_t controllerConfig;
+
+    /* The demo as it is. */
+    memset( pConfig, 0, sizeof( Config_t ) );
+    pConfig->periodUs = IOT_DEMO_MQTT_SAMPLE_PERIOD_MS * 1000LL;
+    pConfig->queueLength = IOT_DEMO_MQTT_RING_LENGTH;
+    pConfig->formatUs = 200;
+    pConfig->publishUs = 1500;
+    pConfig->batch = 1;
+    pConfig->deadbandTenths = IOT_DEMO_MQTT_DEADBAND_TENTHS;
+    pConfig->adaptive = ( IOT_DEMO_MQTT_ADAPTIVE == 1 );
+    pConfig->minPeriodUs = IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS * 1000LL;
+    pConfig->maxPeriodUs = IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS * 1000LL;
+    pConfig->stepT = IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS / 10.0;
+    pConfig->stepH = IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS / 10.0;
+    pConfig->stats = ( IOT_DEMO_MQTT_STATS == 1 );
+
+    snprintf( pConfig->name, sizeof( pConfig->name ), "%s", ( pSpec[ 0 ] != '\0' ) ? pSpec : "demo" );
+    snprintf( copy, sizeof( copy ), "%s", pSpec );
+
+    for( pItem = strtok_r( copy, ",", &pSave ); pItem != NULL; pItem = strtok_r( NULL, ",", &pSave ) )
+    {
+        pValue = strchr( pItem, '=' );
+
+        if( pValue == NULL )
+        {
+            return false;
+        }
+
+        *pValue++ = '\0';
+        value = atof( pValue );
+
+        if( strcmp( pItem, "period" ) == 0 ) pConfig->periodUs = ( int64_t ) ( value * 1000 );
+        else if( strcmp( pItem, "queue" ) == 0 ) pConfig->queueLength = ( size_t ) value;
+        else if( strcmp( pItem, "format" ) == 0 ) pConfig->formatUs = ( int64_t ) value;
+        else if( strcmp( pItem, "publish" ) == 0 ) pConfig->publishUs = ( int64_t ) value;
+        else if( strcmp( pItem, "batch" ) == 0 ) pConfig->batch = ( size_t ) value;
+        else if( strcmp( pItem, "deadband" ) == 0 ) pConfig->deadbandTenths = ( int32_t ) lround( value * 10.0 );
+        else if( strcmp( pItem, "adaptive" ) == 0 ) pConfig->adaptive = ( value != 0.0 );
+        else if( strcmp( pItem, "min" ) == 0 ) pConfig->minPeriodUs = ( int64_t ) ( value * 1000 );
+        else if( strcmp( pItem, "max" ) == 0 ) pConfig->maxPeriodUs = ( int64_t ) ( value * 1000 );
+        else if( strcmp( pItem, "at" ) == 0 ) pConfig->stepT = value;
+        else if( strcmp( pItem, "ah" ) == 0 ) pConfig->stepH = value;
+        else if( strcmp( pItem, "stats" ) == 0 ) pConfig->stats = ( value != 0.0 );
+        else return false;
+    }
+
+    /* The controller checks its own configuration. */
+    controllerConfig.ulMinMs = ( uint32_t ) ( pConfig->minPeriodUs / 1000 );
+    controllerConfig.ulMaxMs = ( uint32_t ) ( pConfig->maxPeriodUs / 1000 );
+    controllerConfig.uxChannels = 2;
+    controllerConfig.lStep[ 0 ] = ( int32_t ) lround( pConfig->stepT * 10.0 );
+    controllerConfig.lStep[ 1 ] = ( int32_t ) lround( pConfig->stepH * 10.0 );
+
+    if( AdaptivePeriod_Init( &controller, &controllerConfig ) == false )
+    {
+        return false;
+    }
+
+    /* The bounds the demo and its commands keep to. */
+    if( ( pConfig->periodUs <= 0 ) || ( pConfig->queueLength < 1 ) || ( pConfig->queueLength > MAX_QUEUE ) ||
+        ( ( pConfig->queueLength & ( pConfig->queueLength - 1 ) ) != 0 ) ||
+        ( pConfig->batch < 1 ) || ( pConfig->batch > IOT_DEMO_MQTT_RING_BATCH ) ||
+        ( pConfig->batch > pConfig->queueLength ) ||
+        ( pConfig->deadbandTenths < 0 ) || ( pConfig->deadbandTenths > 1000 ) )
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Synthetic trace from the model of DHT22_sim.c, sampled every 3 s, with
+ * Poisson vibration edges and a fixed acknowledgement latency. */
+static void generate( double seconds,
+                      double edgesPerMinute,
+                      uint32_t seed )
+{
+    uint32_t state = seed ? seed : 1;
+    uint32_t sample = 0;
+    int64_t time, nextEdge = INT64_MAX, end = ( int64_t ) ( seconds * 1e6 );
+    double phase, noise, humidity, temperature;
+    long publish = 0;
+
+#define NEXT()    ( state ^= state << 13, state ^= state >> 17, state ^= state << 5, state )
+#define UNIFORM() ( ( double ) ( NEXT() >> 8 ) / ( double ) ( 1U << 24 ) )
+
+    if( edgesPerMinute > 0.0 )
+    {
+        nextEdge = ( int64_t ) ( -log( 1.0 - UNIFORM() ) * 60e6 / edgesPerMinute );
+    }
+
+    for( time = 3000000; time <= end; time += 3000000 )
+    {
+        while( nextEdge <= time )
+        {
+            printf( "TRACE,%lld,V\n", ( long long ) nextEdge );
+            nextEdge += ( int64_t ) ( -log( 1.0 - UNIFORM() ) * 60e6 / edgesPerMinute ) + 1;
+        }
+
+        phase = 2.0 * M_PI * ( double ) ( sample++ % 1200 ) / 1200.0;
+        noise = UNIFORM() - 0.5;
+        humidity = 45.0 - 8.0 * sin( phase ) + 1.0 * ( UNIFORM() - 0.5 );
+        temperature = 22.0 + 3.0 * sin( phase ) + 0.4 * noise;
+        printf( "TRACE,%lld,S,%.1f,%.1f,0\n", ( long long ) time, humidity, temperature );
+        printf( "TRACE,%lld,P,%ld,%zu\n", ( long long ) time + 300, publish,
+                payloadBytes( DHT_FORMAT, humidity, temperature ) );
+        printf( "TRACE,%lld,A,%ld,0\n", ( long long ) time + 300 + 40000 + ( int64_t ) ( UNIFORM() * 20000 ), publish );
+        publish++;
+    }
+
+#undef NEXT
+#undef UNIFORM
+}
+
+/*-----------------------------------------------------------*/
+
+static void usage( const char * pProgram )
+{
+    fprintf( stderr,
+             "usage: %s [-J] [-c config]... [trace]\n"
+             "       %s -g seconds [-v edges/min] [-S seed]\n"
+             "  -c config   key=value list, repeatable; keys:\n"
+             "              period (ms, %d)  queue (%d)  format (us, 200)  publish (us, 1500)\n"
+             "              batch (1 to %d, 1)  deadband (0 to 100, %.1f)  stats (%d)\n"
+             "              adaptive (%d)  min (ms, %d)  max (ms, %d)  at (%.1f)  ah (%.1f)\n"
+             "  -J          JSON lines output\n"
+             "  -g seconds  write a synthetic trace instead of replaying\n",
+             pProgram, pProgram, IOT_DEMO_MQTT_SAMPLE_PERIOD_MS, IOT_DEMO_MQTT_RING_LENGTH,
+             IOT_DEMO_MQTT_RING_BATCH, IOT_DEMO_MQTT_DEADBAND_TENTHS / 10.0, IOT_DEMO_MQTT_STATS,
+             IOT_DEMO_MQTT_ADAPTIVE, IOT_DEMO_MQTT_MIN_SAMPLE_PERIOD_MS, IOT_DEMO_MQTT_ADAPTIVE_MAX_PERIOD_MS,
+             IOT_DEMO_MQTT_ADAPTIVE_STEP_TEMP_TENTHS / 10.0, IOT_DEMO_MQTT_ADAPTIVE_STEP_HUMIDITY_TENTHS / 10.0 );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    Config_t configs[ MAX_CONFIGS ];
+    size_t configCount = 0, i;
+    Trace_t trace;
+    Result_t result;
+    FILE * pFile = stdin;
+    bool json = false;
+    double generateSeconds = 0.0, edgesPerMinute = 0.5;
+    uint32_t seed = 1;
+    struct timespec wallStart, wallEnd;
+    double wall;
+    int option;
+
+    while( ( option = getopt( argc, argv, "c:Jg:v:S:" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 'c':
+
+                if( ( configCount == MAX_CONFIGS ) || ( parseConfig( optarg, &configs[ configCount ] ) == false ) )
+                {
+                    fprintf( stderr, "bad or too many configurations: %s\n", optarg );
+                    return 2;
+                }
+
+                configCount++;
+                break;
+
+            case 'J': json = true; break;
+            case 'g': generateSeconds = atof( optarg ); break;
+            case 'v': edgesPerMinute = atof( optarg ); break;
+            case 'S': seed = ( uint32_t ) strtoul( optarg, NULL, 0 ); break;
+            default: usage( argv[ 0 ] ); return 2;
+        }
+    }
+
+    if( generateSeconds > 0.0 )
+    {
+        generate( generateSeconds, edgesPerMinute, seed );
+
+        return 0;
+    }
+
+    if( configCount == 0 )
+    {
+        ( void ) parseConfig( "", &configs[ configCount++ ] );
+    }
+
+    if( optind < argc )
+    {
+        pFile = fopen( argv[ optind ], "r" );
+
+        if( pFile == NULL )
+        {
+            perror( argv[ optind ] );
+            return 1;
+        }
+    }
+
+    loadTrace( pFile, &trace );
+
+    if( trace.sampleCount + trace.edgeCount == 0 )
+    {
+        fprintf( stderr, "no TRACE records found\n" );
+        return 1;
+    }
+
+    fprintf( stderr, "trace: %.2f h, %zu readings, %zu vibration edges, %zu acknowledgements\n",
+             ( double ) ( trace.end - trace.start ) / 3.6e9,
+             trace.sampleCount, trace.edgeCount, trace.ackCount );
+
+    clock_gettime( CLOCK_MONOTONIC, &wallStart );
+
+    for( i = 0; i < configCount; i++ )
+    {
+        replay( &trace, &configs[ i ], &result );
+        report( &trace, &configs[ i ], &result, json );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &wallEnd );
+    wall = ( double ) ( wallEnd.tv_sec - wallStart.tv_sec ) + ( double ) ( wallEnd.tv_nsec - wallStart.tv_nsec ) / 1e9;
+
+    fprintf( stderr, "replayed %zu configuration(s) in %.3f s, %.0fx real time\n",
+             configCount, wall,
+             wall > 0.0 ? ( double ) configCount * ( double ) ( trace.end - trace.start ) / 1e6 / wall : 0.0 );
+
+    return 0;
+}